@@ -0,0 +1,35 @@
+# performance regression check, run by the perf_check target (cmake --build <build dir> --target perf_check)
+# generates a small corpus with log_gen, then runs qc_bench --check on it against cmake/perf_baselines.txt, failing if a metric got
+# worse than its baseline allows. with QC_PERF_RECORD set (e.g. -DQC_PERF_RECORD=ON when configuring), the baselines are replaced
+# with this run's measurements instead, which should be done on the machine that runs the check (baselines of another machine mean nothing)
+
+cmake_minimum_required(VERSION 3.22)
+
+foreach (var IN ITEMS QC_SOURCE_DIR QC_BIN_DIR QC_PERF_ROOT)
+	if (NOT DEFINED ${var})
+		message(FATAL_ERROR "${var} must be given (run this through the perf_check target)")
+	endif()
+endforeach()
+
+set(exe_suffix "")
+if (CMAKE_HOST_WIN32)
+	set(exe_suffix ".exe")
+endif()
+set(corpus_dir "${QC_PERF_ROOT}/corpus")
+set(baselines "${QC_SOURCE_DIR}/cmake/perf_baselines.txt")
+
+# the corpus is the same every time (log_gen is seeded), so it's only generated once
+if (NOT EXISTS "${corpus_dir}/logs")
+	file(MAKE_DIRECTORY ${corpus_dir})
+	execute_process(COMMAND "${QC_BIN_DIR}/log_gen${exe_suffix}" --out logs --days 3 --players 100
+		WORKING_DIRECTORY ${corpus_dir} OUTPUT_QUIET COMMAND_ERROR_IS_FATAL ANY)
+endif()
+
+set(record_arg "")
+if (QC_PERF_RECORD)
+	set(record_arg "--record")
+endif()
+execute_process(COMMAND "${QC_BIN_DIR}/qc_bench${exe_suffix}" --check "${corpus_dir}/logs" ${baselines} ${record_arg} RESULT_VARIABLE res)
+if (NOT res EQUAL 0)
+	message(FATAL_ERROR "performance check failed (see above)")
+endif()
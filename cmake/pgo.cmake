@@ -0,0 +1,70 @@
+# profile-guided optimization workflow, run by the pgo target (cmake --build <build dir> --target pgo)
+# 1. builds instrumented binaries (QC_PGO=GENERATE) in ${QC_PGO_ROOT}/instrumented
+# 2. trains them: generates logs with log_gen, then runs the ingestion and render benchmarks and playtime_graphs on them
+# 3. with clang, merges the raw profiles with llvm-profdata
+# 4. builds optimized binaries (QC_PGO=USE) in ${QC_PGO_ROOT}/optimized, they end up in ${QC_PGO_ROOT}/optimized/bin
+# almost every log line is one the parser skips, so real profiles let the compiler lay out the parser for that path
+# QC_PGO_TARGETS can be given to build other targets than playtime_graphs, qc_bench and qc-v2 optimized
+
+cmake_minimum_required(VERSION 3.22)
+
+foreach (var IN ITEMS QC_SOURCE_DIR QC_PGO_ROOT QC_GENERATOR QC_CXX_COMPILER QC_CXX_COMPILER_ID)
+	if (NOT DEFINED ${var})
+		message(FATAL_ERROR "${var} must be given (run this through the pgo target)")
+	endif()
+endforeach()
+if (NOT DEFINED QC_PGO_TARGETS)
+	set(QC_PGO_TARGETS playtime_graphs qc_bench qc-v2)
+endif()
+
+set(profile_dir "${QC_PGO_ROOT}/profiles")
+set(corpus_dir "${QC_PGO_ROOT}/corpus")
+set(exe_suffix "")
+if (CMAKE_HOST_WIN32)
+	set(exe_suffix ".exe")
+endif()
+
+# configure and build `targets` in `dir` with QC_PGO=`mode`
+function(pgo_build dir mode targets)
+	execute_process(
+		COMMAND ${CMAKE_COMMAND} -S ${QC_SOURCE_DIR} -B ${dir} -G ${QC_GENERATOR} -DCMAKE_BUILD_TYPE=Release
+			-DCMAKE_C_COMPILER=${QC_C_COMPILER} -DCMAKE_CXX_COMPILER=${QC_CXX_COMPILER} "-DCMAKE_C_FLAGS=${QC_C_FLAGS}" "-DCMAKE_CXX_FLAGS=${QC_CXX_FLAGS}"
+			-DCMAKE_RUNTIME_OUTPUT_DIRECTORY=${dir}/bin -DCMAKE_RUNTIME_OUTPUT_DIRECTORY_RELEASE=${dir}/bin
+			-DQC_PGO=${mode} -DQC_PGO_DIR=${profile_dir}
+		COMMAND_ERROR_IS_FATAL ANY)
+	execute_process(COMMAND ${CMAKE_COMMAND} --build ${dir} --config Release --target ${targets} COMMAND_ERROR_IS_FATAL ANY)
+endfunction()
+
+# run a training binary of the instrumented build in `dir`
+function(pgo_run dir name)
+	list(JOIN ARGN " " args)
+	message(STATUS "PGO training: ${name} ${args}")
+	execute_process(COMMAND "${QC_PGO_ROOT}/instrumented/bin/${name}${exe_suffix}" ${ARGN} WORKING_DIRECTORY ${dir} OUTPUT_QUIET COMMAND_ERROR_IS_FATAL ANY)
+endfunction()
+
+# profiles of an earlier run would be mixed with the new ones (gcc adds to existing counters)
+file(REMOVE_RECURSE ${profile_dir} ${corpus_dir})
+file(MAKE_DIRECTORY ${profile_dir} ${corpus_dir} ${corpus_dir}/small)
+
+message(STATUS "PGO: building instrumented binaries")
+pgo_build("${QC_PGO_ROOT}/instrumented" GENERATE "log_gen;qc_bench;playtime_graphs")
+
+# a month of a busy server, like bench_ingest is usually run on
+pgo_run(${corpus_dir} log_gen --out logs --days 30 --players 1000)
+pgo_run(${corpus_dir} qc_bench --ingest logs)
+pgo_run(${corpus_dir} qc_bench --render 10000)
+pgo_run(${corpus_dir} qc_bench)
+# playtime_graphs graphs every player, which would be a huge png for the busy server
+pgo_run(${corpus_dir}/small log_gen --out logs --days 30 --players 50)
+pgo_run(${corpus_dir}/small playtime_graphs)
+
+if (QC_CXX_COMPILER_ID MATCHES "Clang")
+	get_filename_component(compiler_dir ${QC_CXX_COMPILER} DIRECTORY)
+	find_program(llvm_profdata NAMES llvm-profdata HINTS ${compiler_dir} REQUIRED)
+	file(GLOB raw_profiles "${profile_dir}/*.profraw")
+	execute_process(COMMAND ${llvm_profdata} merge -output=${profile_dir}/qc.profdata ${raw_profiles} COMMAND_ERROR_IS_FATAL ANY)
+endif()
+
+message(STATUS "PGO: building optimized binaries")
+pgo_build("${QC_PGO_ROOT}/optimized" USE "${QC_PGO_TARGETS}")
+message(STATUS "PGO: optimized binaries are in ${QC_PGO_ROOT}/optimized/bin")
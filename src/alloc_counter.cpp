@@ -0,0 +1,34 @@
+// replaces global operator new and delete with ones that count allocations, for the QC_COUNT_ALLOCATIONS build (see alloc_counter.h)
+// the default array and nothrow versions call these. the aligned ones are replaced too, since std::pmr::new_delete_resource
+// (what memory resources get memory from by default) allocates with them
+
+#include <cstdlib>
+#include <new>
+
+#include "alloc_counter.h"
+
+void* operator new(std::size_t size)
+{
+	count_allocation(size);
+	if (void* ptr = std::malloc(size == 0 ? 1 : size))
+		{ return ptr; }
+	throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept
+	{ std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept
+	{ std::free(ptr); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	count_allocation(size);
+	const auto align = static_cast<std::size_t>(alignment);
+	// aligned_alloc needs a multiple of the alignment
+	if (void* ptr = std::aligned_alloc(align, (size == 0) ? align : (size + align - 1) / align * align))
+		{ return ptr; }
+	throw std::bad_alloc();
+}
+void operator delete(void* ptr, std::align_val_t) noexcept
+	{ std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+	{ std::free(ptr); }
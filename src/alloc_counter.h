@@ -0,0 +1,181 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+// allocation counting, for checking that hot paths don't allocate more than they need to
+// only done when built with QC_COUNT_ALLOCATIONS (the QC_COUNT_ALLOCATIONS cmake option), which replaces operator new and delete
+// with counting ones (see alloc_counter.cpp). otherwise QC_ALLOCATION_SCOPE compiles to nothing
+// each thread counts its own allocations, so counting doesn't make threads contend with each other
+
+#ifdef QC_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+struct allocation_count
+{
+	std::uint64_t allocations = 0;
+	std::uint64_t bytes = 0;
+
+	allocation_count& operator+=(const allocation_count& other) noexcept
+	{
+		allocations += other.allocations;
+		bytes += other.bytes;
+		return *this;
+	}
+	[[nodiscard]] friend allocation_count operator-(const allocation_count& lhs, const allocation_count& rhs) noexcept
+		{ return { lhs.allocations - rhs.allocations, lhs.bytes - rhs.bytes }; }
+};
+
+namespace detail
+{
+	// allocations of one thread, only written by that thread (so updating it needs no atomic read-modify-write)
+	// registered in an intrusive list, since registering can't allocate
+	struct thread_allocation_counter
+	{
+		std::atomic<std::uint64_t> allocations = 0;
+		std::atomic<std::uint64_t> bytes = 0;
+		thread_allocation_counter* prev = nullptr;
+		thread_allocation_counter* next = nullptr;
+
+		thread_allocation_counter();
+		thread_allocation_counter(const thread_allocation_counter&) = delete;
+		thread_allocation_counter& operator=(const thread_allocation_counter&) = delete;
+		~thread_allocation_counter();
+
+		void add(std::size_t size) noexcept
+		{
+			allocations.store(allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			bytes.store(bytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+		}
+
+		[[nodiscard]] allocation_count get() const noexcept
+			{ return { allocations.load(std::memory_order_relaxed), bytes.load(std::memory_order_relaxed) }; }
+	};
+
+	// the counters of all running threads, and what threads that exited allocated
+	class allocation_registry
+	{
+	private:
+		std::mutex mutex;
+		thread_allocation_counter* head = nullptr;
+		allocation_count retired;
+
+	public:
+		void add(thread_allocation_counter& counter) noexcept
+		{
+			std::scoped_lock lock(mutex);
+			counter.next = head;
+			if (head != nullptr)
+				{ head->prev = &counter; }
+			head = &counter;
+		}
+
+		void remove(thread_allocation_counter& counter) noexcept
+		{
+			std::scoped_lock lock(mutex);
+			retired += counter.get();
+			(counter.prev != nullptr ? counter.prev->next : head) = counter.next;
+			if (counter.next != nullptr)
+				{ counter.next->prev = counter.prev; }
+		}
+
+		[[nodiscard]] allocation_count total() noexcept
+		{
+			std::scoped_lock lock(mutex);
+			allocation_count res = retired;
+			for (const thread_allocation_counter* cur = head; cur != nullptr; cur = cur->next)
+				{ res += cur->get(); }
+			return res;
+		}
+	};
+
+	// never destroyed, since detached threads can still allocate while statics are destroyed
+	// constructed in place, since allocating would count an allocation before there is anything to count it
+	[[nodiscard]] inline allocation_registry& get_allocation_registry() noexcept
+	{
+		alignas(allocation_registry) static unsigned char storage[sizeof(allocation_registry)];
+		static allocation_registry* const instance = new (storage) allocation_registry;
+		return *instance;
+	}
+
+	inline thread_allocation_counter::thread_allocation_counter()
+		{ get_allocation_registry().add(*this); }
+	inline thread_allocation_counter::~thread_allocation_counter()
+		{ get_allocation_registry().remove(*this); }
+
+	inline thread_local thread_allocation_counter thread_allocation_count;
+}
+
+// called by the replaced operator new
+inline void count_allocation(std::size_t size) noexcept
+	{ detail::thread_allocation_count.add(size); }
+
+// @return allocations made by the calling thread so far
+[[nodiscard]] inline allocation_count thread_allocations() noexcept
+	{ return detail::thread_allocation_count.get(); }
+
+// @return allocations made by all threads so far
+[[nodiscard]] inline allocation_count total_allocations() noexcept
+	{ return detail::get_allocation_registry().total(); }
+
+// allocations made in some kind of scope (see allocation_scope), with the units of work they were for, like lines parsed
+struct allocation_scope_stats
+{
+	const char* name;
+	const char* unit;
+	std::atomic<std::uint64_t> units = 0;
+	std::atomic<std::uint64_t> allocations = 0;
+	std::atomic<std::uint64_t> bytes = 0;
+};
+
+// the scopes that are counted
+struct allocation_scopes
+{
+	allocation_scope_stats parse{ "parse", "line" };  // parsing lines written to latest.log
+	allocation_scope_stats tail{ "tail", "event" };  // handling a file watcher event, including parsing
+	allocation_scope_stats render{ "render", "graph" };
+};
+
+[[nodiscard]] inline allocation_scopes& get_allocation_scopes() noexcept
+{
+	static allocation_scopes instance;
+	return instance;
+}
+
+// adds the allocations the calling thread makes during its lifetime to `stats`
+class allocation_scope
+{
+private:
+	allocation_scope_stats& stats;
+	allocation_count start = thread_allocations();
+
+public:
+	// @param units  of work done in the scope (e.g. lines parsed)
+	allocation_scope(allocation_scope_stats& stats, std::uint64_t units) noexcept : stats(stats)
+		{ stats.units.fetch_add(units, std::memory_order_relaxed); }
+	allocation_scope(const allocation_scope&) = delete;
+	allocation_scope& operator=(const allocation_scope&) = delete;
+	~allocation_scope()
+	{
+		const allocation_count count = thread_allocations() - start;
+		stats.allocations.fetch_add(count.allocations, std::memory_order_relaxed);
+		stats.bytes.fetch_add(count.bytes, std::memory_order_relaxed);
+	}
+};
+
+#define QC_ALLOCATION_CONCAT_IMPL(a, b) a##b
+#define QC_ALLOCATION_CONCAT(a, b) QC_ALLOCATION_CONCAT_IMPL(a, b)
+// count allocations until the end of the scope: QC_ALLOCATION_SCOPE(member of allocation_scopes, units)
+#define QC_ALLOCATION_SCOPE(scope, units) const allocation_scope QC_ALLOCATION_CONCAT(qc_allocation_scope_, __LINE__)(get_allocation_scopes().scope, units)
+
+#else
+
+// the arguments aren't evaluated
+#define QC_ALLOCATION_SCOPE(scope, units) static_cast<void>(0)
+
+#endif
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef ARCHIVE_RANGES_H
+#define ARCHIVE_RANGES_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "logger.h"
+#include "parse_logs.h"
+#include "session_store.h"
+
+// consumer of log events (see combine_consumers) that summarizes each file parse_log_file_events goes through (see archive_summary)
+// file_done is called from its read_file_cb
+class archive_summary_collector
+{
+private:
+	archive_summary cur;
+	std::unordered_set<std::string> players;  // names of who joined or left in the current file
+
+public:
+	std::vector<archive_summary> summaries;  // of each file done, in order
+
+	void operator()(const log_event& event)
+	{
+		if (event.type != log_event_type::join && event.type != log_event_type::leave)
+			{ return; }
+		cur.first = std::min(cur.first, event.time);
+		cur.last = std::max(cur.last, event.time);
+		if (players.emplace(event.player).second)
+			{ cur.players++; }
+	}
+
+	void file_done()
+	{
+		summaries.push_back(cur);
+		cur = archive_summary();
+		players.clear();
+	}
+};
+
+// @param data  sessions of latest.log, when it is archived
+// @return summary of the archive, from when its sessions started and ended
+[[nodiscard]] inline archive_summary summarize_sessions(const log_data_t& data)
+{
+	archive_summary res;
+	for (const auto& player_data : data | std::views::values)
+	{
+		for (const auto& [start, duration] : player_data.second.first)
+		{
+			res.first = std::min(res.first, start);
+			res.last = std::max(res.last, start + duration);
+		}
+		res.players++;
+	}
+	return res;
+}
+
+namespace detail
+{
+	// identifies an archive, which keeps its date and number when it's compressed (see snapshot_coverage)
+	[[nodiscard]] inline std::pair<std::chrono::year_month_day, unsigned int> archive_key(const log_manifest_entry& file) noexcept
+		{ return { file.date, file.index }; }
+
+	// log4j compresses the archive latest.log was moved to after the move, so an archive that was yyyy-mm-dd-#.log when it was read
+	// may only be yyyy-mm-dd-#.log.gz (or another compressed log) now
+	// @param log_path  of the uncompressed archive
+	// @return the compressed archive, or nullopt if there is none
+	[[nodiscard]] inline std::optional<log_manifest_entry> find_compressed_archive(const std::filesystem::path& log_path)
+	{
+		for (std::size_t i = 1; i < log_codec_extensions.size(); i++)
+		{
+			auto path = log_path;
+			path.replace_extension(log_codec_extensions[i]);
+			std::error_code ec;
+			const std::filesystem::directory_entry dir_entry(path, ec);
+			if (ec)
+				{ continue; }
+			try
+			{
+				if (auto entry = make_log_manifest_entry(dir_entry))
+					{ return entry; }
+			}
+			catch (const std::filesystem::filesystem_error&)
+				{}  // removed since
+		}
+		return {};
+	}
+}
+
+// @param files  an archive that was compressed since it was listed is read compressed (see detail::find_compressed_archive)
+// @param history  segments whose players' uuids are used for those whose uuid line was logged in an earlier file
+// @param summaries  set to the summary of each file, if not null
+// @return sessions of `files`, parsed in one go with a parse context that knows the uuids of the players in `history`
+[[nodiscard]] inline log_data_t parse_archives(std::vector<log_manifest_entry> files, log_format format, const std::chrono::time_zone* timezone,
+	std::chrono::system_clock::duration merge_gap, std::span<const std::shared_ptr<const session_store>> history, std::vector<archive_summary>* summaries = nullptr)
+{
+	for (auto& file : files)
+	{
+		std::error_code ec;
+		if (file.codec != log_codec::none || file.bundle || std::filesystem::exists(file.path, ec))
+			{ continue; }
+		if (auto compressed = detail::find_compressed_archive(file.path))
+		{
+			compressed->summary = file.summary;
+			file = std::move(compressed.value());
+		}
+	}
+	// players whose uuid line is in a file before these are bound by name, as they are to the usercache on startup
+	auto known_uuids = std::make_shared<known_uuids_t>();
+	for (const auto& segment : history)
+	{
+		for (std::size_t i = 0; i < segment->size(); i++)
+		{
+			for (const std::string_view name : segment->player_names(i))
+				{ known_uuids->insert_or_assign(std::string(name), segment->uuid(i)); }
+		}
+	}
+	parse_ctx_t ctx;
+	ctx.known_uuids = std::move(known_uuids);
+	log_data_t data;
+	session_aggregator sessions(data, merge_gap);
+	archive_summary_collector collector;
+	with_log_format(format, [&]<typename line_format>(line_format)
+	{
+		return parse_log_file_events<true, line_format>(std::move(files), timezone, [&collector](const auto&) { collector.file_done(); }, std::move(ctx),
+			combine_consumers(sessions, collector));
+	});
+	if (summaries)
+		{ *summaries = std::move(collector.summaries); }
+	return data;
+}
+
+// sessions parsed again from the archives of a time range, for queries about times whose sessions history has rolled up (see session_history::roll_up)
+// the summaries in the manifest say which archives to parse, so a query about a day only decompresses the few files of that day,
+// and the ranges parsed last are kept (the least recently used one is dropped), so looking around in them doesn't parse them again
+// players still online at the start of the first file joined in an earlier one, so the file before the range and the one after it are parsed too,
+// which gives the sessions that cross from one file into the next (those longer than a whole file are missed)
+class archive_range_cache
+{
+public:
+	// archives whose data is in history, set by the log reading loop whenever they change
+	struct archives_t
+	{
+		std::vector<log_manifest_entry> manifest;  // in order, with their summaries
+		log_format format;
+		const std::chrono::time_zone* timezone;  // of the logs
+		std::chrono::system_clock::duration merge_gap;  // see session_aggregator
+	};
+
+private:
+	static constexpr std::size_t max_ranges = 4;
+
+	struct entry_t
+	{
+		std::shared_ptr<const archives_t> archives;  // that the files are in
+		std::size_t first, last;  // files [first, last) of the manifest
+		std::shared_ptr<const session_store> sessions;
+	};
+
+	std::mutex mutex;
+	std::shared_ptr<const archives_t> archives;
+	std::vector<entry_t> entries;  // least recently used first
+
+public:
+	void set_archives(std::shared_ptr<const archives_t> new_archives)
+	{
+		std::scoped_lock lock(mutex);
+		// ranges are found by their index in the manifest, which changes when an archive is added before the last one (see archive_scanner)
+		if (archives && !std::ranges::equal(archives->manifest, new_archives->manifest | std::views::take(archives->manifest.size()), {},
+			detail::archive_key, detail::archive_key))
+			{ entries.clear(); }
+		archives = std::move(new_archives);
+	}
+
+	// parse the archives with sessions in `range`, or find them among the ranges parsed last. run on the query lane
+	// @param history  of the server, whose players' uuids are used for those whose uuid line was logged before the range
+	// @return sessions of the archives (and of those just around them), or null if no archive has sessions in `range`
+	[[nodiscard]] std::shared_ptr<const session_store> get(const time_range& range, std::span<const std::shared_ptr<const session_store>> history)
+	{
+		std::shared_ptr<const archives_t> cur_archives;
+		{
+			std::scoped_lock lock(mutex);
+			cur_archives = archives;
+		}
+		if (!cur_archives)
+			{ return nullptr; }
+		const auto& manifest = cur_archives->manifest;
+		// players still online at the end of a file may be until the next one's first join or leave
+		std::size_t first = manifest.size(), last = 0;
+		auto next_first = std::chrono::system_clock::time_point::min();
+		for (std::size_t i = manifest.size(); i-- > 0;)
+		{
+			const archive_summary& summary = manifest[i].summary;
+			if (summary.empty())
+				{ continue; }
+			if (summary.first < range.end && std::max(summary.last, next_first) >= range.begin)
+			{
+				first = i;
+				last = std::max(last, i + 1);
+			}
+			next_first = summary.first;
+		}
+		if (first >= last)
+			{ return nullptr; }
+		first = (first == 0) ? 0 : first - 1;
+		last = std::min(last + 1, manifest.size());
+
+		{
+			std::scoped_lock lock(mutex);
+			// files already parsed with the ones needed, in the same or an earlier manifest (which this one only appends to, see set_archives)
+			const auto it = std::ranges::find_if(entries, [&](const entry_t& entry)
+			{
+				return entry.first <= first && entry.last >= last && detail::archive_key(entry.archives->manifest[first]) == detail::archive_key(manifest[first]);
+			});
+			if (it != entries.end())
+			{
+				std::rotate(it, it + 1, entries.end());
+				return entries.back().sessions;
+			}
+		}
+		// parsed without holding the lock, like history_cache, so queries about other ranges don't wait for it
+		log_message(log_severity::info, std::format("Parsing archived log files {} to {} again for an old range", manifest[first].path.filename().string(),
+			manifest[last - 1].path.filename().string()));
+		auto sessions = std::make_shared<const session_store>(parse_archives(std::vector(manifest.begin() + first, manifest.begin() + last), cur_archives->format,
+			cur_archives->timezone, cur_archives->merge_gap, history));
+		std::scoped_lock lock(mutex);
+		if (entries.size() == max_ranges)
+			{ entries.erase(entries.begin()); }
+		entries.push_back({ std::move(cur_archives), first, last, sessions });
+		return sessions;
+	}
+};
+
+// finds archives put in the logs directory after it was read (e.g. old logs restored from a backup), since only latest.log is watched
+// the directory is listed again whenever its modification time changes, and a new file is only taken once it is the same as the last time it was
+// listed, so one that is still being copied isn't read half written
+// it also finds archives that were read uncompressed and have been compressed since (see detail::find_compressed_archive), so the manifest
+// can be pointed at the files that still exist
+class archive_scanner
+{
+public:
+	struct result_t
+	{
+		std::vector<log_manifest_entry> added;  // archives that aren't in the manifest, sorted
+		std::vector<log_manifest_entry> compressed;  // archives in the manifest as .log files that are now only compressed, sorted
+	};
+
+private:
+	std::optional<std::filesystem::file_time_type> dir_mtime;  // when it was listed last
+	// new files that were listed last time, with their size and modification time then
+	std::map<std::filesystem::path, std::pair<std::uintmax_t, std::filesystem::file_time_type>> pending;
+
+public:
+	// @param manifest  archives already read, sorted (see scan_logs_dir)
+	// @param first_day, end_day  archives are taken from dates [first_day, end_day). latest.log is archived on its day, so end_day should be no later,
+	//                            or the archive it was moved to could be found before the move is handled
+	[[nodiscard]] result_t scan(const std::filesystem::path& logs_dir, std::span<const log_manifest_entry> manifest,
+		std::chrono::year_month_day first_day, std::chrono::year_month_day end_day)
+	{
+		std::error_code ec;
+		const auto mtime = std::filesystem::last_write_time(logs_dir, ec);
+		if (ec || (pending.empty() && dir_mtime == mtime))
+			{ return {}; }
+		result_t res;
+		decltype(pending) new_pending;
+		try
+		{
+			for (auto& entry : scan_logs_dir<true>(logs_dir))
+			{
+				// a .log file is listed instead of the compressed one while both exist, so this one is complete
+				if (const auto known = std::ranges::equal_range(manifest, detail::archive_key(entry), {}, detail::archive_key); !known.empty())
+				{
+					if (known.front().codec == log_codec::none && !known.front().bundle && entry.codec != log_codec::none && !entry.bundle)
+						{ res.compressed.push_back(std::move(entry)); }
+					continue;
+				}
+				if (entry.date < first_day || entry.date >= end_day)
+					{ continue; }
+				const auto state = std::pair(entry.size, entry.mtime);
+				if (const auto it = pending.find(entry.path); it != pending.end() && it->second == state)
+					{ res.added.push_back(std::move(entry)); }
+				else
+					{ new_pending.emplace(entry.path, state); }
+			}
+		}
+		catch (const std::filesystem::filesystem_error& e)
+		{
+			log_message(log_severity::error, std::format("Could not look for new log files in {}: {}", logs_dir.string(), e.what()));
+			return {};
+		}
+		dir_mtime = mtime;
+		pending = std::move(new_pending);
+		return res;
+	}
+};
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef ARROW_IPC_H
+#define ARROW_IPC_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// the arrow ipc file format (.arrow, also called feather v2), which pyarrow, pandas (read_feather) and duckdb read without parsing anything,
+// written without the arrow library. its metadata are flatbuffers (see Schema.fbs, Message.fbs and File.fbs in the arrow repository),
+// of which only the few tables needed for flat columns are written
+
+namespace detail
+{
+	// writes a flatbuffer front to back: a table is written before what it refers to, so the offsets to those (which must point forward)
+	// are linked once they are written. scalars are little endian, and positions are aligned from the start of the buffer
+	class flatbuffer_writer
+	{
+	public:
+		struct field
+		{
+			std::uint16_t id;  // index in the table's schema, union types taking two (the type, then the value)
+			std::uint8_t size;  // 1, 2, 4 or 8 bytes. offsets are 4 bytes, and linked after the table is written
+			std::uint64_t value = 0;
+		};
+
+		struct table_t
+		{
+			std::size_t pos;
+			std::vector<std::size_t> fields;  // positions of the fields, in the order they were given
+		};
+
+	private:
+		std::string buf;
+
+		void append(std::uint64_t value, std::size_t size)
+		{
+			for (std::size_t i = 0; i < size; i++)
+				{ buf += static_cast<char>(value >> (8 * i)); }
+		}
+
+		void align(std::size_t alignment)
+			{ buf.resize((buf.size() + alignment - 1) / alignment * alignment, '\0'); }
+
+	public:
+		flatbuffer_writer()
+			{ append(0, 4); }  // offset of the root table, see finish
+
+		// write a table with `fields`, which are laid out in the order given (largest first needs the least padding)
+		table_t table(std::initializer_list<field> fields)
+		{
+			std::uint16_t num_ids = 0;
+			for (const field& f : fields)
+				{ num_ids = std::max<std::uint16_t>(num_ids, f.id + 1); }
+			std::vector<std::uint16_t> offsets(num_ids, 0);  // 0 for fields that aren't there
+			std::uint16_t size = 4;  // the offset to the vtable comes first
+			for (const field& f : fields)
+			{
+				size = static_cast<std::uint16_t>((size + f.size - 1) / f.size * f.size);
+				offsets[f.id] = size;
+				size += f.size;
+			}
+			// vtable: its size, the table's size, and the offset of each field in the table
+			align(2);
+			const std::size_t vtable = buf.size();
+			append(4 + 2 * num_ids, 2);
+			append(size, 2);
+			for (const std::uint16_t offset : offsets)
+				{ append(offset, 2); }
+			align(8);
+			table_t res{ buf.size(), {} };
+			append(res.pos - vtable, 4);  // the vtable is this far before the table
+			for (const field& f : fields)
+			{
+				buf.resize(res.pos + offsets[f.id], '\0');
+				res.fields.push_back(buf.size());
+				append(f.value, f.size);
+			}
+			return res;
+		}
+
+		// @return position of the string, for link
+		std::size_t string(std::string_view str)
+		{
+			align(4);
+			const std::size_t pos = buf.size();
+			append(str.size(), 4);
+			buf += str;
+			buf += '\0';
+			return pos;
+		}
+
+		// write a vector of `count` offsets, linked later to position + 4 * (i + 1)
+		// @return position of the vector, for link
+		std::size_t offsets(std::size_t count)
+		{
+			align(4);
+			const std::size_t pos = buf.size();
+			append(count, 4);
+			buf.resize(buf.size() + 4 * count, '\0');
+			return pos;
+		}
+
+		// write a vector of `count` structs with 8 byte alignment, whose little endian bytes are `data`
+		// @return position of the vector, for link
+		std::size_t structs(std::string_view data, std::size_t count)
+		{
+			// the length comes right before the first struct
+			align(4);
+			if (buf.size() % 8 == 0)
+				{ append(0, 4); }
+			const std::size_t pos = buf.size();
+			append(count, 4);
+			buf += data;
+			return pos;
+		}
+
+		// make the offset at `pos` refer to `target` (a table, vector or string written after it)
+		void link(std::size_t pos, std::size_t target)
+		{
+			const std::uint32_t offset = static_cast<std::uint32_t>(target - pos);
+			for (std::size_t i = 0; i < 4; i++)
+				{ buf[pos + i] = static_cast<char>(offset >> (8 * i)); }
+		}
+
+		// @param root  table the buffer is of
+		// @return the buffer, padded to a multiple of 8 bytes
+		[[nodiscard]] std::string finish(std::size_t root)
+		{
+			link(0, root);
+			align(8);
+			return std::move(buf);
+		}
+	};
+}
+
+enum class arrow_type : std::uint8_t
+{
+	int64,
+	utf8,  // int32 offsets (one more than there are rows), then the characters
+	timestamp_seconds,  // int64 seconds since the unix epoch, in utc
+	uuid  // 16 bytes, big endian (with the arrow.uuid extension, so readers that know it show uuids)
+};
+
+struct arrow_field
+{
+	std::string_view name;
+	arrow_type type;
+};
+
+// writes an arrow ipc file of flat, non-null columns, a record batch at a time
+class arrow_file_writer
+{
+private:
+	// see Message.fbs and Schema.fbs
+	static constexpr std::uint16_t metadata_v5 = 4;
+	static constexpr std::uint8_t header_schema = 1, header_record_batch = 3;
+	static constexpr std::uint8_t type_int = 2, type_utf8 = 5, type_timestamp = 10, type_fixed_size_binary = 15;
+	static constexpr std::string_view magic = "ARROW1";
+
+	// a message in the file (see File.fbs), so readers can go to any record batch
+	struct block
+	{
+		std::int64_t offset;
+		std::int32_t metadata_length;
+		std::int64_t body_length;
+	};
+
+	std::vector<arrow_field> fields;
+	std::function<bool(std::string_view)> sink;
+	std::uint64_t offset = 0;  // written so far
+	std::vector<block> blocks;
+	bool failed = false;
+
+	void write(std::string_view data)
+	{
+		if (!failed)
+			{ failed = !sink(data); }
+		offset += data.size();
+	}
+
+	[[nodiscard]] static std::string little_endian(std::uint64_t value, std::size_t size)
+	{
+		std::string res;
+		for (std::size_t i = 0; i < size; i++)
+			{ res += static_cast<char>(value >> (8 * i)); }
+		return res;
+	}
+
+	// @return position of the schema table
+	[[nodiscard]] std::size_t write_schema(detail::flatbuffer_writer& fb) const
+	{
+		// endianness of the columns: 0 is little, 1 is big
+		const auto schema = fb.table({ { 1, 4 }, { 0, 2, (std::endian::native == std::endian::little) ? 0u : 1u } });
+		const std::size_t field_vector = fb.offsets(fields.size());
+		fb.link(schema.fields[0], field_vector);
+		for (std::size_t i = 0; i < fields.size(); i++)
+		{
+			const auto& [name, type] = fields[i];
+			const std::uint8_t type_id = (type == arrow_type::int64) ? type_int : (type == arrow_type::utf8) ? type_utf8 :
+				(type == arrow_type::timestamp_seconds) ? type_timestamp : type_fixed_size_binary;
+			// name, type, children and custom metadata, then the type of the type and nullable
+			const auto field = fb.table({ { 0, 4 }, { 3, 4 }, { 5, 4 }, { 6, 4 }, { 2, 1, type_id }, { 1, 1, 0 } });
+			fb.link(field_vector + 4 * (i + 1), field.pos);
+			fb.link(field.fields[0], fb.string(name));
+			if (type == arrow_type::int64)
+				{ fb.link(field.fields[1], fb.table({ { 0, 4, 64 }, { 1, 1, 1 } }).pos); }  // bit width and signed
+			else if (type == arrow_type::utf8)
+				{ fb.link(field.fields[1], fb.table({}).pos); }
+			else if (type == arrow_type::timestamp_seconds)
+			{
+				const auto timestamp = fb.table({ { 1, 4 }, { 0, 2, 0 } });  // time zone and unit (seconds)
+				fb.link(field.fields[1], timestamp.pos);
+				fb.link(timestamp.fields[0], fb.string("UTC"));
+			}
+			else
+				{ fb.link(field.fields[1], fb.table({ { 0, 4, 16 } }).pos); }  // byte width
+			fb.link(field.fields[2], fb.offsets(0));
+			const bool extension = (type == arrow_type::uuid);
+			const std::size_t metadata = fb.offsets(extension ? 1 : 0);
+			fb.link(field.fields[3], metadata);
+			if (extension)
+			{
+				const auto key_value = fb.table({ { 0, 4 }, { 1, 4 } });
+				fb.link(metadata + 4, key_value.pos);
+				fb.link(key_value.fields[0], fb.string("ARROW:extension:name"));
+				fb.link(key_value.fields[1], fb.string("arrow.uuid"));
+			}
+		}
+		return schema.pos;
+	}
+
+	// write a message: a continuation marker, the length of its metadata, the metadata, then its body
+	void write_message(const std::string& metadata, std::span<const std::string_view> body_buffers, std::int64_t body_length)
+	{
+		blocks.push_back({ static_cast<std::int64_t>(offset), static_cast<std::int32_t>(8 + metadata.size()), body_length });
+		write(little_endian(0xffffffff, 4) + little_endian(metadata.size(), 4));
+		write(metadata);
+		for (const std::string_view buffer : body_buffers)
+		{
+			write(buffer);
+			write(std::string((8 - buffer.size() % 8) % 8, '\0'));
+		}
+	}
+
+public:
+	// write the start of the file and its schema
+	// @param sink  called with each part of the file, in order. returns false to stop (e.g. on a write error), which finish reports
+	arrow_file_writer(std::span<const arrow_field> fields, std::function<bool(std::string_view)> sink) : fields(fields.begin(), fields.end()), sink(std::move(sink))
+	{
+		write(std::string(magic) + std::string(2, '\0'));
+		detail::flatbuffer_writer fb;
+		const auto message = fb.table({ { 3, 8, 0 }, { 2, 4 }, { 0, 2, metadata_v5 }, { 1, 1, header_schema } });
+		fb.link(message.fields[1], write_schema(fb));
+		write_message(fb.finish(message.pos), {}, 0);
+		blocks.clear();  // the schema isn't a record batch
+	}
+	arrow_file_writer(const arrow_file_writer&) = delete;
+	arrow_file_writer& operator=(const arrow_file_writer&) = delete;
+
+	// write a record batch of `num_rows` rows
+	// @param buffers  of each column in order (offsets then characters for utf8, otherwise values), in native byte order.
+	//                 columns have no validity buffers, since nothing is null
+	void write_batch(std::int64_t num_rows, std::span<const std::string_view> buffers)
+	{
+		// each column has a node, and an empty validity buffer before its own
+		std::string nodes, buffer_locations;
+		std::int64_t body_length = 0;
+		std::size_t buffer_ind = 0;
+		for (const arrow_field& field : fields)
+		{
+			nodes += little_endian(static_cast<std::uint64_t>(num_rows), 8) + little_endian(0, 8);
+			buffer_locations += little_endian(static_cast<std::uint64_t>(body_length), 8) + little_endian(0, 8);
+			for (std::size_t i = 0; i < ((field.type == arrow_type::utf8) ? 2u : 1u); i++)
+			{
+				const std::size_t size = buffers[buffer_ind++].size();
+				buffer_locations += little_endian(static_cast<std::uint64_t>(body_length), 8) + little_endian(size, 8);
+				body_length += static_cast<std::int64_t>((size + 7) / 8 * 8);
+			}
+		}
+
+		detail::flatbuffer_writer fb;
+		const auto message = fb.table({ { 3, 8, static_cast<std::uint64_t>(body_length) }, { 2, 4 }, { 0, 2, metadata_v5 }, { 1, 1, header_record_batch } });
+		const auto batch = fb.table({ { 0, 8, static_cast<std::uint64_t>(num_rows) }, { 1, 4 }, { 2, 4 } });  // length, nodes and buffers
+		fb.link(message.fields[1], batch.pos);
+		fb.link(batch.fields[1], fb.structs(nodes, fields.size()));
+		fb.link(batch.fields[2], fb.structs(buffer_locations, buffer_locations.size() / 16));
+		write_message(fb.finish(message.pos), buffers.first(buffer_ind), body_length);
+	}
+
+	// write the end of the stream and the footer, which has the schema again and where each record batch is
+	// @return false if the sink stopped the file
+	[[nodiscard]] bool finish()
+	{
+		write(little_endian(0xffffffff, 4) + little_endian(0, 4));
+		std::string block_data;
+		for (const auto& [block_offset, metadata_length, body_length] : blocks)
+		{
+			block_data += little_endian(static_cast<std::uint64_t>(block_offset), 8) + little_endian(static_cast<std::uint32_t>(metadata_length), 4) +
+				little_endian(0, 4) + little_endian(static_cast<std::uint64_t>(body_length), 8);
+		}
+		detail::flatbuffer_writer fb;
+		const auto footer = fb.table({ { 1, 4 }, { 2, 4 }, { 3, 4 }, { 0, 2, metadata_v5 } });  // schema, dictionaries, record batches and version
+		fb.link(footer.fields[0], write_schema(fb));
+		fb.link(footer.fields[1], fb.structs({}, 0));
+		fb.link(footer.fields[2], fb.structs(block_data, blocks.size()));
+		const std::string footer_data = fb.finish(footer.pos);
+		write(footer_data);
+		write(little_endian(footer_data.size(), 4) + std::string(magic));
+		return !failed;
+	}
+};
+
+#endif
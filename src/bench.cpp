@@ -0,0 +1,1071 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <libdeflate.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <Psapi.h>
+#undef WIN32_LEAN_AND_MEAN
+#else
+#include <sys/resource.h>
+#endif
+
+#include "alloc_counter.h"
+#include "parse_logs.h"
+#include "playtime_graph.h"
+#include "session_query.h"
+#include "session_store.h"
+
+// microbenchmarks of log parsing, to see whether a change to the parser helps or hurts
+// usage: qc_bench [log file]
+//        qc_bench --ingest <logs dir> [--cold]
+//        qc_bench --render [max sessions in a graph]
+//        qc_bench --check <logs dir> <baselines file> [--record]
+//        any of them with --counters
+// the file (plain or gzipped) is used for the buffer benchmarks instead of generated lines
+// --ingest times reading a whole logs directory instead (see bench_ingest), like the initial parse of the bot
+// --render times drawing playtime graphs of generated history (see bench_render)
+// --check measures smaller versions of ingestion, rendering and tailing, and fails if one got worse than its baseline (see check_baselines)
+// allocations are counted along with the times (see alloc_counter.h)
+// --counters also reads hardware performance counters (see hardware_counters) for the buffer, ingest and render benchmarks, to see why something is slow:
+// whether a change saves instructions, branch misses, cache misses or TLB misses
+
+namespace
+{
+	// keeps the compiler from optimizing away a result that isn't otherwise used
+	volatile std::uint64_t sink;
+
+	// hardware performance counters, read with perf_event_open on linux. they count the thread that opened them, and the threads it starts after
+	// (e.g. parse_log_file_events' scan workers), but not threads that were already running
+	// counters that can't be opened (e.g. in a vm without a pmu, or with kernel.perf_event_paranoid too high) are left out
+	class hardware_counters
+	{
+	public:
+		static constexpr std::array<std::string_view, 6> names = { "cycles", "instructions", "branch misses", "L1d misses", "LLC misses", "dTLB misses" };
+		// of each of names, nullopt for one that couldn't be opened
+		using values_t = std::array<std::optional<double>, names.size()>;
+
+	private:
+		std::array<int, names.size()> fds;
+
+	public:
+		hardware_counters()
+		{
+			fds.fill(-1);
+#ifdef __linux__
+			const auto cache_event = [](std::uint64_t cache, std::uint64_t result)
+				{ return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16); };
+			const std::array<std::pair<std::uint32_t, std::uint64_t>, names.size()> events = { {
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+				{ PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+				{ PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+				{ PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS) }
+			} };
+			for (std::size_t i = 0; i < events.size(); i++)
+			{
+				perf_event_attr attr{};
+				attr.size = sizeof(attr);
+				attr.type = events[i].first;
+				attr.config = events[i].second;
+				attr.disabled = 1;
+				attr.inherit = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				// if there are more counters than the pmu has, they take turns, and the counts are scaled by how long each ran (see stop)
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+			}
+#endif
+		}
+		hardware_counters(const hardware_counters&) = delete;
+		hardware_counters& operator=(const hardware_counters&) = delete;
+		~hardware_counters()
+		{
+#ifdef __linux__
+			for (const int fd : fds)
+			{
+				if (fd >= 0)
+					{ close(fd); }
+			}
+#endif
+		}
+
+		// @return whether any counter could be opened
+		[[nodiscard]] bool available() const noexcept
+			{ return std::ranges::any_of(fds, [](int fd) { return fd >= 0; }); }
+
+		// start counting from zero
+		void start() noexcept
+		{
+#ifdef __linux__
+			for (const int fd : fds)
+			{
+				if (fd >= 0)
+				{
+					ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+					ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+				}
+			}
+#endif
+		}
+
+		// @return counts since start
+		[[nodiscard]] values_t stop() noexcept
+		{
+			values_t res{};
+#ifdef __linux__
+			for (const int fd : fds)
+			{
+				if (fd >= 0)
+					{ ioctl(fd, PERF_EVENT_IOC_DISABLE, 0); }
+			}
+			for (std::size_t i = 0; i < fds.size(); i++)
+			{
+				std::array<std::uint64_t, 3> values;  // count, time enabled, time running
+				if (fds[i] < 0 || read(fds[i], values.data(), sizeof(values)) != sizeof(values) || values[2] == 0)
+					{ continue; }
+				res[i] = static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+			}
+#endif
+			return res;
+		}
+	};
+	hardware_counters* counters = nullptr;  // set by --counters
+
+	// @return `values` divided by `count`, e.g. to get them per line
+	[[nodiscard]] hardware_counters::values_t divide_counters(hardware_counters::values_t values, double count)
+	{
+		for (auto& value : values)
+		{
+			if (value)
+				{ value.value() /= count; }
+		}
+		return values;
+	}
+
+	// print counters per item, with instructions per cycle, if there are any
+	void report_counters(const hardware_counters::values_t& values, std::string_view item)
+	{
+		if (std::ranges::none_of(values, [](const auto& value) { return value.has_value(); }))
+			{ return; }
+		std::string line = std::format("{:<4}per {}:", "", item);
+		for (std::size_t i = 0; i < values.size(); i++)
+		{
+			if (values[i])
+				{ line += std::format(" {:.2f} {},", values[i].value(), hardware_counters::names[i]); }
+		}
+		line.pop_back();
+		if (values[0] && values[1] && values[0].value() > 0)
+			{ line += std::format(" ({:.2f} IPC)", values[1].value() / values[0].value()); }
+		std::cout << line << '\n';
+	}
+
+	struct bench_result
+	{
+		double ns_per_op;
+		double ops;  // how many times the benchmark ran
+		double allocations_per_op;  // by all threads (see alloc_counter.h)
+		hardware_counters::values_t counters_per_op{};  // only with --counters
+	};
+
+	// run `func` repeatedly for at least min_time (after one warmup call), doubling the iterations each round
+	// @return time per call of `func`
+	template<typename F>
+	[[nodiscard]] bench_result run_bench(F&& func)
+	{
+		constexpr auto min_time = std::chrono::milliseconds(300);
+		func();
+		for (std::size_t iterations = 1; ; iterations *= 2)
+		{
+			const std::uint64_t start_allocations = total_allocations().allocations;
+			if (counters)
+				{ counters->start(); }
+			const auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < iterations; i++)
+				{ func(); }
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			const hardware_counters::values_t counts = counters ? counters->stop() : hardware_counters::values_t{};
+			if (elapsed >= min_time)
+			{
+				const auto ops = static_cast<double>(iterations);
+				return { elapsed.count() / ops, ops, static_cast<double>(total_allocations().allocations - start_allocations) / ops, divide_counters(counts, ops) };
+			}
+		}
+	}
+
+	// @param per_op  what one call of the benchmark handles, like "line"
+	void report(std::string_view name, const bench_result& res, std::string_view per_op)
+	{
+		std::cout << std::format("{:<40}{:>12.1f} ns/{}{:>12.2f} allocations/{}\n", name, res.ns_per_op, per_op, res.allocations_per_op, per_op);
+		report_counters(res.counters_per_op, per_op);
+	}
+
+	// @param count  items (e.g. lines) handled by one call, for ns per item
+	// @param bytes  bytes handled by one call, for throughput
+	void report(std::string_view name, const bench_result& res, std::string_view item, std::size_t count, std::size_t bytes)
+	{
+		std::cout << std::format("{:<40}{:>12.1f} ns/{}{:>12.1f} MB/s{:>12.3f} allocations/{}\n", name, res.ns_per_op / static_cast<double>(count), item,
+			static_cast<double>(bytes) / res.ns_per_op * 1e3, res.allocations_per_op / static_cast<double>(count), item);
+		report_counters(divide_counters(res.counters_per_op, static_cast<double>(count)), item);
+	}
+
+	// @return lines like the ones a busy server logs: mostly chat and other messages that don't matter, with players joining and leaving
+	[[nodiscard]] std::string generate_log(std::size_t num_lines)
+	{
+		constexpr std::size_t num_players = 40;
+		std::string res = "[00:00:00] [main/INFO]: Starting minecraft server version 1.20.1\n";
+		std::array<bool, num_players> online{};
+		std::uint64_t rng = 0x9e3779b97f4a7c15;
+		const auto next = [&rng]()
+		{
+			rng ^= rng << 13;
+			rng ^= rng >> 7;
+			rng ^= rng << 17;
+			return rng;
+		};
+		for (std::size_t i = 0; i < num_lines; i++)
+		{
+			const std::size_t secs = i * 86400 / num_lines;
+			const std::string timestamp = std::format("[{:02}:{:02}:{:02}]", secs / 3600, secs / 60 % 60, secs % 60);
+			const std::size_t player = next() % num_players;
+			switch (next() % 16)
+			{
+			case 0:
+				if (online[player])
+					{ res += std::format("{} [Server thread/INFO]: Player{} left the game\n", timestamp, player); }
+				else
+				{
+					res += std::format("{} [User Authenticator #1/INFO]: UUID of player Player{} is {:08x}-0000-4000-8000-{:012x}\n", timestamp, player, player, player);
+					res += std::format("{} [Server thread/INFO]: Player{} joined the game\n", timestamp, player);
+				}
+				online[player] = !online[player];
+				break;
+			case 1:
+				res += std::format("{} [Server thread/WARN]: Can't keep up! Is the server overloaded? Running 2345ms or 46 ticks behind\n", timestamp);
+				break;
+			default:
+				res += std::format("{} [Server thread/INFO]: <Player{}> has anyone joined the game yet?\n", timestamp, player);
+				break;
+			}
+		}
+		return res;
+	}
+
+	// @return contents of `path`, decompressed if it ends with .gz, or nullopt if it can't be read
+	[[nodiscard]] std::optional<std::string> read_log(const std::filesystem::path& path)
+	{
+		std::ifstream fin(path, std::ios::binary);
+		if (!fin)
+			{ return {}; }
+		std::string contents((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+		if (path.extension() != ".gz")
+			{ return contents; }
+		const std::unique_ptr<libdeflate_decompressor, detail::libdeflate_decompressor_deleter> decompressor(libdeflate_alloc_decompressor());
+		std::string res;
+		if (detail::gzip_decompress(decompressor.get(), contents, res) != LIBDEFLATE_SUCCESS)
+			{ return {}; }
+		return res;
+	}
+
+	void bench_parse_line()
+	{
+		// each runs on a fresh context, joining and leaving alternate so no warnings are logged
+		const std::array<std::pair<std::string_view, std::string_view>, 5> lines = { {
+			{ "uuid", "[12:34:56] [User Authenticator #1/INFO]: UUID of player Player1 is 0326324d-fb69-5ffb-3a18-90c78092b4d4" },
+			{ "chat (not matching)", "[12:34:56] [Server thread/INFO]: <Player1> has anyone joined the game yet?" },
+			{ "warning (not matching)", "[12:34:56] [Server thread/WARN]: Can't keep up! Is the server overloaded? Running 2345ms or 46 ticks behind" },
+			{ "stopping server", "[12:34:56] [Server thread/INFO]: Stopping server" },
+			{ "no timestamp (not matching)", "\tat net.minecraft.server.MinecraftServer.runServer(MinecraftServer.java:1000)" }
+		} };
+		for (const auto& [name, line] : lines)
+		{
+			parse_ctx_t ctx;
+			log_data_t data;
+			report(std::format("parse_line {}", name), run_bench([&]() { sink = parse_line(line, ctx, data).read_valid_line; }), "line");
+		}
+
+		parse_ctx_t ctx;
+		log_data_t data;
+		parse_line("[12:34:56] [User Authenticator #1/INFO]: UUID of player Player1 is 0326324d-fb69-5ffb-3a18-90c78092b4d4", ctx, data);
+		const auto join_leave = [&](std::string_view join_line)
+		{
+			parse_line(join_line, ctx, data);
+			sink = parse_line("[12:34:57] [Server thread/INFO]: Player1 left the game", ctx, data).player_join_left;
+			data.clear();
+		};
+		report("parse_line join + leave", run_bench([&]() { join_leave("[12:34:56] [Server thread/INFO]: Player1 joined the game"); }), "pair");
+		report("parse_line formerly known as + leave", run_bench([&]()
+			{ join_leave("[12:34:56] [Server thread/INFO]: Player1 (formerly known as Player0) joined the game"); }), "pair");
+	}
+
+	void bench_uuid()
+	{
+		constexpr std::string_view str = "0326324d-fb69-5ffb-3a18-90c78092b4d4";
+		report("detail::parse_uuid", run_bench([&]() { sink = detail::parse_uuid(std::span<const char, 36>(str.data(), 36))->first; }), "uuid");
+
+		const uuid_t uuid = detail::parse_uuid(std::span<const char, 36>(str.data(), 36)).value();
+		std::array<char, 36> buf;
+		report("format uuid", run_bench([&]()
+		{
+			std::format_to(buf.data(), "{}", uuid);
+			sink = static_cast<unsigned char>(buf[35]);
+		}), "uuid");
+	}
+
+	void bench_timezone()
+	{
+		// a zone with daylight saving time, over ten years of sessions
+		const std::chrono::time_zone* timezone = std::chrono::locate_zone("Europe/Berlin");
+		const std::chrono::sys_days first = std::chrono::year(2015) / 1 / 1, last = std::chrono::year(2025) / 1 / 1;
+		const tz_offset_table table(timezone, first, last);
+		std::chrono::system_clock::time_point cur = first;
+		const auto next = [&cur, first]()
+		{
+			// a step that isn't a whole number of days, wrapping around after about ten years
+			cur += std::chrono::hours(7) + std::chrono::seconds(13);
+			if (cur >= std::chrono::system_clock::time_point(first) + std::chrono::days(3650))
+				{ cur = first; }
+			return cur;
+		};
+		report("time_zone::to_local", run_bench([&]() { sink = static_cast<std::uint64_t>(timezone->to_local(next()).time_since_epoch().count()); }), "time");
+		report("tz_offset_table::to_local", run_bench([&]() { sink = static_cast<std::uint64_t>(table.to_local(next()).time_since_epoch().count()); }), "time");
+		report("time_zone::to_sys (midnight)", run_bench([&]()
+		{
+			const auto day = std::chrono::floor<std::chrono::days>(std::chrono::local_time<std::chrono::system_clock::duration>(next().time_since_epoch()));
+			sink = static_cast<std::uint64_t>(timezone->to_sys(day, std::chrono::choose::earliest).time_since_epoch().count());
+		}), "time");
+		report("tz_offset_table::to_sys (midnight)", run_bench([&]()
+		{
+			const auto day = std::chrono::floor<std::chrono::days>(std::chrono::local_time<std::chrono::system_clock::duration>(next().time_since_epoch()));
+			sink = static_cast<std::uint64_t>(table.to_sys(day, std::chrono::choose::earliest).time_since_epoch().count());
+		}), "time");
+	}
+
+	// @param contents  whole log file
+	void bench_buffer(std::string_view source, const std::string& contents)
+	{
+		const std::size_t num_lines = std::ranges::count(contents, '\n') + 1;
+		std::cout << std::format("\n{}: {} lines, {:.1f} MB\n", source, num_lines, static_cast<double>(contents.size()) / 1e6);
+
+		// below the size parse_lines scans in parallel, so this is the single threaded parser
+		const std::string_view small = std::string_view(contents).substr(0, std::min(contents.size(), detail::parallel_scan_min_chunk));
+		const std::size_t small_lines = std::ranges::count(small, '\n') + 1;
+		report("parse_lines (one thread)", run_bench([&]()
+		{
+			parse_ctx_t ctx;
+			log_data_t data;
+			sink = parse_lines(small, ctx, data);
+		}), "line", small_lines, small.size());
+		report("parse_lines (whole buffer)", run_bench([&]()
+		{
+			parse_ctx_t ctx;
+			log_data_t data;
+			sink = parse_lines(contents, ctx, data);
+		}), "line", num_lines, contents.size());
+
+		const std::unique_ptr<libdeflate_compressor, decltype(&libdeflate_free_compressor)> compressor(libdeflate_alloc_compressor(6), &libdeflate_free_compressor);
+		std::string compressed(libdeflate_gzip_compress_bound(compressor.get(), contents.size()), '\0');
+		compressed.resize(libdeflate_gzip_compress(compressor.get(), contents.data(), contents.size(), compressed.data(), compressed.size()));
+		const std::unique_ptr<libdeflate_decompressor, detail::libdeflate_decompressor_deleter> decompressor(libdeflate_alloc_decompressor());
+		std::string decompressed;
+		report("gzip_decompress (output MB/s)", run_bench([&]()
+			{ sink = detail::gzip_decompress(decompressor.get(), compressed, decompressed); }), "line", num_lines, contents.size());
+	}
+
+	// @return most memory the process has used so far, or 0 if it isn't known
+	[[nodiscard]] std::size_t peak_rss_bytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			{ return 0; }
+#ifdef __APPLE__
+		return static_cast<std::size_t>(usage.ru_maxrss);  // already bytes
+#else
+		return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	// evict the files from the page cache, so they are read from disk like on the first start after a reboot
+	// @return false if that isn't supported here
+	bool drop_page_cache(const std::vector<log_manifest_entry>& manifest)
+	{
+#ifdef __linux__
+		for (const log_manifest_entry& file : manifest)
+		{
+			const int fd = open(file.path.c_str(), O_RDONLY);
+			if (fd < 0)
+				{ continue; }
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+		return true;
+#else
+		std::ignore = manifest;
+		return false;
+#endif
+	}
+
+	// time and allocations of one phase of reading logs (and its hardware counters with --counters), added up over the files
+	struct phase_stats
+	{
+		std::chrono::duration<double> time{};
+		std::uint64_t allocations = 0;
+		hardware_counters::values_t counts{};
+
+		// @return result of `func`, with its time and allocations added
+		decltype(auto) measure(auto&& func)
+		{
+			const std::uint64_t prev_allocations = total_allocations().allocations;
+			if (counters)
+				{ counters->start(); }
+			const auto start = std::chrono::steady_clock::now();
+			struct add_on_exit
+			{
+				phase_stats& stats;
+				std::uint64_t prev_allocations;
+				std::chrono::steady_clock::time_point start;
+				~add_on_exit()
+				{
+					stats.time += std::chrono::steady_clock::now() - start;
+					stats.allocations += total_allocations().allocations - prev_allocations;
+					if (!counters)
+						{ return; }
+					const hardware_counters::values_t counts = counters->stop();
+					for (std::size_t i = 0; i < counts.size(); i++)
+					{
+						if (counts[i])
+							{ stats.counts[i] = stats.counts[i].value_or(0) + counts[i].value(); }
+					}
+				}
+			} on_exit{ *this, prev_allocations, start };
+			return func();
+		}
+	};
+
+	void report_phase(std::string_view name, const phase_stats& stats, std::size_t num_lines, std::size_t bytes)
+	{
+		const double secs = stats.time.count();
+		std::cout << std::format("{:<40}{:>10.1f} ms{:>12.1f} ns/line{:>10.1f} MB/s{:>12} allocations\n", name, secs * 1e3,
+			secs * 1e9 / static_cast<double>(std::max<std::size_t>(num_lines, 1)), static_cast<double>(bytes) / std::max(secs, 1e-9) / 1e6, stats.allocations);
+		report_counters(divide_counters(stats.counts, static_cast<double>(std::max<std::size_t>(num_lines, 1))), "line");
+	}
+
+	// time reading a whole logs directory into a session history, first with the real pipeline (parse_log_file_events, which overlaps the phases
+	// on several threads) and then one file at a time on one thread, with each phase timed on its own:
+	// scanning the directory, reading, decompressing, splitting lines, matching them, and applying the events to get sessions
+	// @param cold  whether to evict the files from the page cache before each run, otherwise they are read once first so they are in it
+	// @return whether the directory could be read
+	bool bench_ingest(const std::filesystem::path& dir, bool cold)
+	{
+		std::error_code ec;
+		if (!std::filesystem::is_directory(dir, ec))
+		{
+			std::cerr << std::format("{} is not a directory\n", dir.string());
+			return false;
+		}
+		phase_stats scan_phase;
+		auto manifest = scan_phase.measure([&]() { return scan_logs_dir<true>(dir); });
+		// the phases read each file by its path, which files in bundles don't have
+		if (const auto num_bundled = std::erase_if(manifest, [](const log_manifest_entry& file) { return file.bundle != nullptr; }); num_bundled != 0)
+			{ std::cout << std::format("(leaving out {} files in bundles)\n", num_bundled); }
+		if (manifest.empty())
+		{
+			std::cerr << std::format("No log files in {}\n", dir.string());
+			return false;
+		}
+		std::uintmax_t file_bytes = 0;
+		for (const log_manifest_entry& file : manifest)
+			{ file_bytes += file.size; }
+
+		const auto prepare_cache = [&]()
+		{
+			if (cold)
+			{
+				if (!drop_page_cache(manifest))
+					{ std::cout << "(evicting files from the page cache isn't supported on this platform, they may be cached)\n"; }
+				return;
+			}
+			std::string buf;
+			for (const log_manifest_entry& file : manifest)
+			{
+				std::ifstream fin(file.path, std::ios::binary);
+				buf.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+			}
+		};
+		const std::chrono::time_zone* utc = std::chrono::locate_zone("UTC");
+
+		prepare_cache();
+		phase_stats pipeline_phase;
+		const std::size_t sessions = pipeline_phase.measure([&]()
+		{
+			log_data_t data;
+			parse_log_file_events<true>(manifest, utc, [](const auto&) {}, parse_ctx_t(), session_aggregator(data));
+			session_history history;
+			history.commit(data);
+			return history.get_segments().empty() ? 0 : history.get_segments().front()->total_sessions();
+		});
+		const std::size_t pipeline_rss = peak_rss_bytes();
+
+		// the same, one phase at a time
+		prepare_cache();
+		phase_stats read_phase, decompress_phase, split_phase, scan_lines_phase, aggregate_phase;
+		detail::log_decompressor decompressor;
+		std::string compressed, decompressed;
+		detail::file_scan_t scan;
+		parse_ctx_t ctx;
+		log_data_t data;
+		std::size_t num_lines = 0, decompressed_bytes = 0;
+		std::chrono::system_clock::time_point last_tp{};
+		for (const log_manifest_entry& file : manifest)
+		{
+			std::string& contents = (file.codec != log_codec::none) ? compressed : decompressed;
+			read_phase.measure([&]()
+			{
+				std::ifstream fin(file.path, std::ios::binary);
+				contents.resize_and_overwrite(file.size, [&fin](char* buf, std::size_t buf_size)
+				{
+					fin.read(buf, static_cast<std::streamsize>(buf_size));
+					return static_cast<std::size_t>(fin.gcount());
+				});
+			});
+			if (file.codec != log_codec::none &&
+				decompress_phase.measure([&]() { return decompressor.decompress(file.codec, compressed, decompressed); }) != LIBDEFLATE_SUCCESS)
+			{
+				std::cerr << std::format("Could not decompress {}\n", file.path.string());
+				continue;
+			}
+			decompressed_bytes += decompressed.size();
+			split_phase.measure([&]()
+			{
+				num_lines += static_cast<std::size_t>(std::ranges::distance(detail::line_range(decompressed)));
+			});
+			scan_lines_phase.measure([&]() { detail::scan_lines<vanilla_log_format>(decompressed, scan); });
+			// same as parse_log_file_events
+			aggregate_phase.measure([&]()
+			{
+				ctx.cur_filename = file.path.filename().string();
+				ctx.date_tp = std::chrono::sys_days(file.date);
+				bool clear_before = (ctx.date_tp == last_tp);
+				last_tp = ctx.date_tp;
+				for (const auto& [line, event] : scan.events)
+				{
+					ctx.line = line;
+					if (detail::apply_line_event(event, ctx, clear_before, session_aggregator(data)).read_valid_line)
+						{ clear_before = false; }
+				}
+			});
+		}
+		aggregate_phase.measure([&]()
+		{
+			session_history history;
+			history.commit(data);
+		});
+		// scan_lines splits lines itself, so matching is what it takes beyond that
+		phase_stats match_phase = scan_lines_phase;
+		match_phase.time -= std::min(match_phase.time, split_phase.time);
+
+		std::cout << std::format("{}: {} files, {:.1f} MB on disk, {:.1f} MB of logs, {} lines, {} sessions ({} page cache)\n\n", dir.string(), manifest.size(),
+			static_cast<double>(file_bytes) / 1e6, static_cast<double>(decompressed_bytes) / 1e6, num_lines, sessions, cold ? "cold" : "warm");
+		report_phase("parse_log_file_events (all threads)", pipeline_phase, num_lines, decompressed_bytes);
+		std::cout << std::format("{:<40}{:>10.0f} lines/s, peak RSS {:.1f} MB\n\n", "", static_cast<double>(num_lines) / pipeline_phase.time.count(),
+			static_cast<double>(pipeline_rss) / 1e6);
+		std::cout << "one thread, by phase:\n";
+		report_phase("directory scan and sort", scan_phase, num_lines, decompressed_bytes);
+		report_phase("read", read_phase, num_lines, file_bytes);
+		report_phase("decompress", decompress_phase, num_lines, decompressed_bytes);
+		report_phase("split lines", split_phase, num_lines, decompressed_bytes);
+		report_phase("match lines (scan_lines - split)", match_phase, num_lines, decompressed_bytes);
+		report_phase("apply events and compact", aggregate_phase, num_lines, decompressed_bytes);
+		std::cout << std::format("peak RSS {:.1f} MB\n", static_cast<double>(peak_rss_bytes()) / 1e6);
+		return true;
+	}
+
+	// @return history of `num_players` players with `sessions_per_player` sessions each, spread over `days` days before `end`
+	[[nodiscard]] log_data_t generate_sessions(std::size_t num_players, std::size_t sessions_per_player, int days, std::chrono::system_clock::time_point end)
+	{
+		using namespace std::chrono;
+		std::uint64_t rng = 0x2545f4914f6cdd1d;
+		const auto next = [&rng]()
+		{
+			rng ^= rng << 13;
+			rng ^= rng >> 7;
+			rng ^= rng << 17;
+			return rng;
+		};
+		const auto start = end - days * std::chrono::days(1);
+		const auto slot = duration_cast<seconds>(end - start) / sessions_per_player;
+		log_data_t data;
+		for (std::size_t player = 0; player < num_players; player++)
+		{
+			auto& [names, play_info] = data[uuid_t{ next(), next() }];
+			names.push_back(std::format("Player{}", player));
+			// one session in each slot, somewhere in its first 80%
+			for (std::size_t i = 0; i < sessions_per_player; i++)
+			{
+				const auto len = seconds(1 + next() % static_cast<std::uint64_t>(slot.count() * 2 / 5));
+				const auto offset = seconds(next() % static_cast<std::uint64_t>(slot.count() * 4 / 5 - len.count() + 1));
+				play_info.first.emplace_back(start + slot * i + offset, len);
+				play_info.second += len;
+			}
+		}
+		return data;
+	}
+
+	[[nodiscard]] session_history generate_history(std::size_t num_players, std::size_t sessions_per_player, int days, std::chrono::system_clock::time_point end)
+	{
+		session_history history;
+		history.commit(generate_sessions(num_players, sessions_per_player, days, end));
+		return history;
+	}
+
+	// playtime of each player in the last week, with the loops queries were written as and with session_query
+	void bench_session_query()
+	{
+		constexpr std::size_t num_players = 300, sessions_per_player = 1000;
+		const auto now = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+		const auto segment = std::make_shared<const session_store>(generate_sessions(num_players, sessions_per_player, 365, now));
+		const std::array segments{ segment };
+		const auto zones = std::make_shared<const session_zone_map>(*segment);
+		const time_range last_week{ now - std::chrono::days(7), now };
+
+		report("handwritten scan (last week, by player)", run_bench([&]()
+		{
+			std::int64_t total = 0;
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				const auto [first, last] = segment->overlapping_sessions(i, last_week);
+				for (std::size_t j = first; j < last; j++)
+				{
+					const play_session session = segment->session(i, j);
+					if (last_week.overlaps(session))
+						{ total += std::chrono::duration_cast<std::chrono::seconds>(last_week.clip(session).second).count(); }
+				}
+			}
+			sink = static_cast<std::uint64_t>(total);
+		}), "scan");
+		const auto query = [&](const time_range& range, session_grouping group, unsigned threads)
+		{
+			session_query q{ .filter{ .overlapping = range, .clip = true }, .group = group, .threads = threads };
+			return [&segments, &zones, q]()
+			{
+				const log_data_t recent;
+				sink = run_session_query(segments, [&zones](const auto&) { return zones; }, recent, q).total.total_seconds;
+			};
+		};
+		const std::size_t num_sessions = num_players * sessions_per_player;
+		report("session_query (last week, by player)", run_bench(query(last_week, session_grouping::player, 1)), "scan");
+		report("session_query (all, total)", run_bench(query(time_range{}, session_grouping::none, 1)), "session", num_sessions, num_sessions * sizeof(play_session));
+		report("session_query (all, total, 4 threads)", run_bench(query(time_range{}, session_grouping::none, 4)), "session", num_sessions,
+			num_sessions * sizeof(play_session));
+	}
+
+	// memory and scan speed of a segment in columns and compressed (see session_store::compressed)
+	void bench_session_blocks()
+	{
+		constexpr std::size_t num_players = 300, sessions_per_player = 1000;
+		const auto now = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+		const session_store store(generate_sessions(num_players, sessions_per_player, 365, now));
+		const session_store compressed = store.compressed();
+		const auto per_session = [](const memory_usage& usage) { return static_cast<double>(usage.bytes) / static_cast<double>(usage.sessions); };
+		std::cout << std::format("session_store: {:.1f} bytes/session, compressed: {:.1f} bytes/session\n",
+			per_session(store.memory_used()), per_session(compressed.memory_used()));
+
+		const std::size_t num_sessions = num_players * sessions_per_player;
+		const auto scan = [](const session_store& segment, const time_range& range)
+		{
+			return [&segment, range]()
+			{
+				std::int64_t total = 0;
+				for (std::size_t i = 0; i < segment.size(); i++)
+					{ segment.for_each_session(i, range, [&total](const play_session& session) { total += session.second.count(); }); }
+				sink = static_cast<std::uint64_t>(total);
+			};
+		};
+		const time_range last_week{ now - std::chrono::days(7), now };
+		report("session_store scan (all)", run_bench(scan(store, time_range{})), "session", num_sessions, num_sessions * sizeof(play_session));
+		report("compressed scan (all)", run_bench(scan(compressed, time_range{})), "session", num_sessions, num_sessions * sizeof(play_session));
+		report("session_store scan (last week)", run_bench(scan(store, last_week)), "scan");
+		report("compressed scan (last week)", run_bench(scan(compressed, last_week)), "scan");
+	}
+
+	// time each stage of create_graph for a history of `num_players` players with `sessions_per_player` sessions each,
+	// and print one row of the table started by bench_render
+	void bench_render_grid_cell(std::size_t num_players, std::size_t sessions_per_player)
+	{
+		const auto now = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+		const session_history history = generate_history(num_players, sessions_per_player, 30, now);
+		graph_render_ctx render_ctx(std::chrono::locate_zone("UTC"));
+		// without a limit a png of 1000 players would be 1.6 GB of pixels, bots showing that many players set graph_row_limit
+		const graph_options options{ .render_ctx = &render_ctx, .row_limit = 100 };
+		const log_data_t recent;
+		const auto get_rows = [&]() { return detail::get_graph_rows(history.get_segments(), recent, options.range, render_ctx); };
+
+		detail::graph_rows rows = get_rows();
+		std::string combined_name;
+		detail::select_graph_rows(rows, options.row_limit, combined_name);
+		const detail::graph_layout layout = detail::get_graph_layout(rows, now, render_ctx.get_timezone());
+		const auto draw = [&](auto& writer) { detail::draw_graph(writer, rows, layout, options.color, render_ctx); };
+		const auto raster = [&]()
+		{
+			auto writer = std::make_unique<detail::png_graph_writer>(options.png_compression_level);
+			draw(*writer);
+			writer->rasterize();
+			return writer;
+		};
+		const auto drawn = raster();
+
+		// sorting is timed on copies of the rows, so the time of copying is taken out
+		const bench_result copy_res = run_bench([&]() { detail::graph_rows copy = rows; });
+		const bench_result sort_res = run_bench([&]()
+		{
+			detail::graph_rows copy = rows;
+			detail::select_graph_rows(copy, options.row_limit, combined_name);
+		});
+		const double stages[] = {
+			run_bench(get_rows).ns_per_op,
+			std::max(sort_res.ns_per_op - copy_res.ns_per_op, 0.),
+			run_bench([&]() { return detail::get_graph_layout(rows, now, render_ctx.get_timezone()); }).ns_per_op,
+			run_bench([&]()
+			{
+				detail::svg_graph_writer writer(options.row_paths);
+				draw(writer);
+				return writer.finish();
+			}).ns_per_op,
+			run_bench(raster).ns_per_op,
+			run_bench([&]() { return drawn->finish(); }).ns_per_op,
+			run_bench([&]() { return detail::create_graph<true, false>(rows, options, render_ctx, now); }).ns_per_op,
+		};
+		const bench_result png_res = run_bench([&]() { return detail::create_graph<false, true>(rows, options, render_ctx, now); });
+		std::string line = std::format("{:>8}{:>10}", num_players, sessions_per_player);
+		for (const double ns : stages)
+			{ line += std::format("{:>10.3f}", ns / 1e6); }
+		line += std::format("{:>10.3f}{:>12.0f}", png_res.ns_per_op / 1e6, png_res.allocations_per_op);
+		std::cout << line << std::endl;  // each row takes a while
+		report_counters(divide_counters(png_res.counters_per_op, static_cast<double>(std::max<std::size_t>(rows.size(), 1))), "row of png all");
+	}
+
+	// time the stages of drawing a playtime graph over a grid of player counts and sessions per player, to see how each stage scales:
+	// getting the rows from history, sorting them, measuring text for the layout, writing the svg, rasterizing and encoding the png,
+	// and the whole graph after the rows for each format. graphs show at most 100 rows, the rest are combined into one
+	// @param max_sessions  cells with more sessions in total are left out, since the largest graphs take seconds each
+	void bench_render(std::size_t max_sessions)
+	{
+		if (detail::text_metrics::get().get_face() == nullptr)
+			{ std::cout << "(no font was found, so text isn't measured or drawn)\n"; }
+		std::cout << std::format("{:>8}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}{:>12}\n", "players", "sessions", "rows", "sort", "layout",
+			"svg", "raster", "encode", "svg all", "png all", "png allocs");
+		std::cout << std::format("{:>18}{:>80}{:>12}\n", "per player", "(ms per graph)", "per graph");
+		for (const std::size_t num_players : { 10, 100, 1000 })
+		{
+			for (const std::size_t sessions_per_player : { 10, 100, 1000 })
+			{
+				if (num_players * sessions_per_player <= max_sessions)
+					{ bench_render_grid_cell(num_players, sessions_per_player); }
+			}
+		}
+	}
+
+	// a measurement of --check, compared with its baseline
+	struct check_metric
+	{
+		std::string_view name;
+		double value;
+		bool higher_is_better;
+		double default_tolerance;  // written by --record, timings vary more between runs than counts
+	};
+
+	// @return value that `fraction` of `samples` are at most
+	[[nodiscard]] double percentile(std::vector<double> samples, double fraction)
+	{
+		const auto nth = samples.begin() + static_cast<std::ptrdiff_t>(fraction * static_cast<double>(samples.size() - 1));
+		std::ranges::nth_element(samples, nth);
+		return *nth;
+	}
+
+	// measure what --check compares: the ingestion pipeline on `dir` (throughput and allocations), rendering a graph of generated history,
+	// latency of parsing a few lines at a time like latest.log is tailed, and the peak memory of all of them
+	// each timing is the best of a few runs, so another process running for a moment doesn't fail the check
+	// @return measurements, or nullopt if `dir` has no log files
+	[[nodiscard]] std::optional<std::vector<check_metric>> measure_check_metrics(const std::filesystem::path& dir)
+	{
+		constexpr int runs = 3;
+		std::vector<check_metric> res;
+
+		auto manifest = scan_logs_dir<true>(dir);
+		std::erase_if(manifest, [](const log_manifest_entry& file) { return file.bundle != nullptr; });
+		if (manifest.empty())
+			{ return std::nullopt; }
+		std::size_t num_lines = 0;
+		for (const log_manifest_entry& file : manifest)
+		{
+			if (const auto contents = read_log(file.path))
+				{ num_lines += static_cast<std::size_t>(std::ranges::distance(detail::line_range(contents.value()))); }
+		}
+		const std::chrono::time_zone* utc = std::chrono::locate_zone("UTC");
+		phase_stats best_ingest{ .time = std::chrono::duration<double>::max() };
+		for (int i = 0; i < runs; i++)
+		{
+			phase_stats ingest;
+			ingest.measure([&]()
+			{
+				log_data_t data;
+				parse_log_file_events<true>(manifest, utc, [](const auto&) {}, parse_ctx_t(), session_aggregator(data));
+				session_history history;
+				history.commit(data);
+			});
+			if (ingest.time < best_ingest.time)
+				{ best_ingest = ingest; }
+		}
+		const auto per_line = [num_lines = static_cast<double>(std::max<std::size_t>(num_lines, 1))](double val) { return val / num_lines; };
+		res.push_back({ "ingest_lines_per_sec", static_cast<double>(num_lines) / best_ingest.time.count(), true, 0.25 });
+		res.push_back({ "ingest_allocations_per_line", per_line(static_cast<double>(best_ingest.allocations)), false, 0.05 });
+
+		{
+			const auto now = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+			const session_history history = generate_history(100, 100, 30, now);
+			graph_render_ctx render_ctx(utc);
+			const graph_options options{ .render_ctx = &render_ctx, .row_limit = 100 };
+			const detail::graph_rows rows = detail::get_graph_rows(history.get_segments(), log_data_t(), options.range, render_ctx);
+			bench_result svg_res{ .ns_per_op = std::numeric_limits<double>::max() }, png_res = svg_res;
+			for (int i = 0; i < runs; i++)
+			{
+				const bench_result svg_run = run_bench([&]() { return detail::create_graph<true, false>(rows, options, render_ctx, now); });
+				const bench_result png_run = run_bench([&]() { return detail::create_graph<false, true>(rows, options, render_ctx, now); });
+				svg_res = std::ranges::min(svg_res, svg_run, {}, &bench_result::ns_per_op);
+				png_res = std::ranges::min(png_res, png_run, {}, &bench_result::ns_per_op);
+			}
+			res.push_back({ "render_svg_ms", svg_res.ns_per_op / 1e6, false, 0.3 });
+			res.push_back({ "render_png_ms", png_res.ns_per_op / 1e6, false, 0.3 });
+			res.push_back({ "render_png_allocations", png_res.allocations_per_op, false, 0.05 });
+		}
+
+		{
+			// a batch is what a wakeup of the log reading loop usually finds on a busy server
+			constexpr std::size_t batch_lines = 16;
+			const std::string log = generate_log(50000);
+			std::vector<std::string_view> batches;
+			std::string_view rest = log;
+			while (!rest.empty())
+			{
+				std::size_t end = 0;
+				for (std::size_t i = 0; i < batch_lines && end != std::string_view::npos; i++)
+					{ end = rest.find('\n', (i == 0) ? 0 : end + 1); }
+				end = (end == std::string_view::npos) ? rest.size() : end + 1;
+				batches.push_back(rest.substr(0, end));
+				rest.remove_prefix(end);
+			}
+			double best_p50 = std::numeric_limits<double>::max(), best_p99 = best_p50;
+			std::vector<double> latencies(batches.size());
+			for (int i = 0; i < runs; i++)
+			{
+				parse_ctx_t ctx;
+				log_data_t data;
+				for (std::size_t j = 0; j < batches.size(); j++)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					sink = parse_lines(batches[j], ctx, data);
+					latencies[j] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+				}
+				best_p50 = std::min(best_p50, percentile(latencies, 0.5));
+				best_p99 = std::min(best_p99, percentile(latencies, 0.99));
+			}
+			res.push_back({ "tail_batch_p50_us", best_p50, false, 0.3 });
+			res.push_back({ "tail_batch_p99_us", best_p99, false, 0.5 });
+		}
+
+		res.push_back({ "peak_rss_mb", static_cast<double>(peak_rss_bytes()) / 1e6, false, 0.2 });
+		return res;
+	}
+
+	// baselines file: a line for each metric with its name, baseline value and how much worse it may get as a fraction of the baseline
+	// (e.g. 0.25 fails a throughput below 75% of the baseline, or a time above 125%). # starts a comment
+	// @return baselines by name, with their tolerances, or nullopt if the file can't be read or is malformed
+	[[nodiscard]] std::optional<std::map<std::string, std::pair<double, double>, std::less<>>> read_baselines(const std::filesystem::path& path)
+	{
+		std::ifstream fin(path);
+		if (!fin)
+			{ return std::nullopt; }
+		std::map<std::string, std::pair<double, double>, std::less<>> res;
+		std::string line;
+		while (std::getline(fin, line))
+		{
+			const std::string_view content = std::string_view(line).substr(0, line.find('#'));
+			std::vector<std::string_view> fields;
+			for (const auto field : std::views::split(content, ' '))
+			{
+				if (!field.empty())
+					{ fields.emplace_back(field.begin(), field.end()); }
+			}
+			if (fields.empty())
+				{ continue; }
+			double baseline, tolerance;
+			if (fields.size() != 3 || std::from_chars(fields[1].data(), fields[1].data() + fields[1].size(), baseline).ec != std::errc() ||
+				std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(), tolerance).ec != std::errc() || tolerance < 0)
+			{
+				std::cerr << std::format("Malformed line in {}: {}\n", path.string(), line);
+				return std::nullopt;
+			}
+			res.insert_or_assign(std::string(fields[0]), std::pair(baseline, tolerance));
+		}
+		return res;
+	}
+
+	// measure the metrics on the logs in `dir` and compare them with the baselines in `baselines_path`, or replace those with them if `record`
+	// @return whether none got worse than its baseline allows (metrics without a baseline are only reported)
+	bool check_baselines(const std::filesystem::path& dir, const std::filesystem::path& baselines_path, bool record)
+	{
+		const auto metrics = measure_check_metrics(dir);
+		if (!metrics)
+		{
+			std::cerr << std::format("No log files in {} (write some with log_gen)\n", dir.string());
+			return false;
+		}
+		if (record)
+		{
+			std::ofstream fout(baselines_path, std::ios::trunc);
+			fout << "# qc_bench --check baselines: metric, baseline, tolerance (fraction of the baseline it may get worse by)\n";
+			for (const check_metric& metric : metrics.value())
+				{ fout << std::format("{} {:.6g} {}\n", metric.name, metric.value, metric.default_tolerance); }
+			if (!fout)
+			{
+				std::cerr << std::format("Could not write {}\n", baselines_path.string());
+				return false;
+			}
+			std::cout << std::format("Recorded {} baselines in {}\n", metrics->size(), baselines_path.string());
+			return true;
+		}
+
+		const auto baselines = read_baselines(baselines_path);
+		if (!baselines)
+		{
+			std::cerr << std::format("Could not read baselines from {}\n", baselines_path.string());
+			return false;
+		}
+		bool ok = true;
+		std::cout << std::format("{:<32}{:>14}{:>14}{:>14}\n", "metric", "value", "baseline", "limit");
+		for (const check_metric& metric : metrics.value())
+		{
+			const auto it = baselines->find(metric.name);
+			if (it == baselines->end())
+			{
+				std::cout << std::format("{:<32}{:>14.6g}{:>14}{:>14}  (no baseline)\n", metric.name, metric.value, "-", "-");
+				continue;
+			}
+			const auto [baseline, tolerance] = it->second;
+			const double limit = metric.higher_is_better ? baseline * (1 - tolerance) : baseline * (1 + tolerance);
+			const bool passed = metric.higher_is_better ? (metric.value >= limit) : (metric.value <= limit);
+			ok = ok && passed;
+			std::cout << std::format("{:<32}{:>14.6g}{:>14.6g}{:>14.6g}  {}\n", metric.name, metric.value, baseline, limit, passed ? "ok" : "REGRESSED");
+		}
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// warnings about the logs would be mixed into the results (and take time themselves)
+	get_logger().set_min_severity(log_severity::fatal);
+	// an option of every mode, so it is taken out before the arguments are looked at
+	std::optional<hardware_counters> hw_counters;
+	if (const auto it = std::ranges::find(argv + 1, argv + argc, std::string_view("--counters")); it != argv + argc)
+	{
+		std::rotate(it, it + 1, argv + argc);
+		argc--;
+		hw_counters.emplace();
+		if (hw_counters->available())
+			{ counters = &hw_counters.value(); }
+		else
+			{ std::cout << "(hardware counters can't be read here, e.g. they aren't supported or kernel.perf_event_paranoid doesn't allow it)\n"; }
+	}
+	if (argc > 1 && argv[1] == std::string_view("--ingest"))
+	{
+		const bool cold = (argc > 3 && argv[3] == std::string_view("--cold"));
+		if (argc < 3 || (argc > 3 && !cold) || argc > 4)
+		{
+			std::cerr << "usage: qc_bench --ingest <logs dir> [--cold]\n";
+			return 1;
+		}
+		return bench_ingest(argv[2], cold) ? 0 : 1;
+	}
+	if (argc > 1 && argv[1] == std::string_view("--render"))
+	{
+		std::size_t max_sessions = 100000;
+		if (argc > 3 || (argc == 3 && std::from_chars(argv[2], argv[2] + std::strlen(argv[2]), max_sessions).ec != std::errc()))
+		{
+			std::cerr << "usage: qc_bench --render [max sessions in a graph]\n";
+			return 1;
+		}
+		bench_render(max_sessions);
+		return 0;
+	}
+
+	if (argc > 1 && argv[1] == std::string_view("--check"))
+	{
+		const bool record = (argc == 5 && argv[4] == std::string_view("--record"));
+		if (argc != 4 && !record)
+		{
+			std::cerr << "usage: qc_bench --check <logs dir> <baselines file> [--record]\n";
+			return 1;
+		}
+		return check_baselines(argv[2], argv[3], record) ? 0 : 1;
+	}
+
+	bench_parse_line();
+	bench_uuid();
+	bench_timezone();
+	bench_session_query();
+	bench_session_blocks();
+	if (argc > 1)
+	{
+		const auto contents = read_log(argv[1]);
+		if (!contents)
+		{
+			std::cerr << std::format("Could not read {}\n", argv[1]);
+			return 1;
+		}
+		bench_buffer(argv[1], contents.value());
+	}
+	else
+		{ bench_buffer("generated", generate_log(200000)); }
+	return 0;
+}
@@ -0,0 +1,220 @@
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace detail
+{
+	inline constexpr std::uint64_t fnv1a_basis = 0xcbf29ce484222325;
+
+	// FNV-1a hash of `data`, or of everything hashed so far followed by `data` if `hash` is a previous result
+	[[nodiscard]] inline std::uint64_t fnv1a(std::string_view data, std::uint64_t hash = fnv1a_basis) noexcept
+	{
+		for (const char c : data)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 0x100000001b3;
+		}
+		return hash;
+	}
+
+	// appends values to a string in native byte order (files using this should record the byte order)
+	class binary_writer
+	{
+	private:
+		std::string& out;
+
+	public:
+		explicit binary_writer(std::string& out) : out(out) {}
+
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		void write(const T& val)
+			{ out.append(reinterpret_cast<const char*>(&val), sizeof(T)); }
+
+		// write size followed by contents
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		void write_span(std::span<const T> vals)
+		{
+			write<std::uint64_t>(vals.size());
+			out.append(reinterpret_cast<const char*>(vals.data()), vals.size_bytes());
+		}
+
+		// write size, then padding so the contents start at a multiple of alignof(T) from the start of the output, followed by contents
+		// a reader of output that starts at such a multiple in memory (e.g. a mapped file) can view them in place (see binary_reader::read_view)
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		void write_aligned_span(std::span<const T> vals)
+		{
+			write<std::uint64_t>(vals.size());
+			out.append((alignof(T) - out.size() % alignof(T)) % alignof(T), '\0');
+			out.append(reinterpret_cast<const char*>(vals.data()), vals.size_bytes());
+		}
+
+		// write size followed by contents
+		void write_string(std::string_view str)
+			{ write_span(std::span(str.data(), str.size())); }
+
+		// write unsigned LEB128, 7 bits per byte with the high bit set on all but the last
+		void write_varint(std::uint64_t val)
+		{
+			while (val >= 0x80)
+			{
+				out.push_back(static_cast<char>(val | 0x80));
+				val >>= 7;
+			}
+			out.push_back(static_cast<char>(val));
+		}
+
+		// write varint of zigzag encoding, so small negative values are small too
+		void write_signed_varint(std::int64_t val)
+			{ write_varint((static_cast<std::uint64_t>(val) << 1) ^ static_cast<std::uint64_t>(val >> 63)); }
+
+		// write varint size followed by contents
+		void write_short_string(std::string_view str)
+		{
+			write_varint(str.size());
+			out.append(str);
+		}
+	};
+
+	// reads values written by binary_writer, with bounds checking
+	// once a read fails, all further reads fail
+	class binary_reader
+	{
+	private:
+		std::string_view in;
+		const char* origin;  // start of what was written, which alignment is relative to
+		bool good = true;
+
+		// @return whether `size` more bytes are available
+		bool require(std::uint64_t size) noexcept
+		{
+			if (good && size > in.size())
+				{ good = false; }
+			return good;
+		}
+
+	public:
+		// @param origin  where the output of the writer starts, if `in` is part of it (e.g. after a header that was read separately)
+		explicit binary_reader(std::string_view in, const char* origin = nullptr) : in(in), origin(origin ? origin : in.data()) {}
+
+		// @return true if no reads have failed
+		[[nodiscard]] bool ok() const noexcept
+			{ return good; }
+		[[nodiscard]] std::size_t remaining() const noexcept
+			{ return in.size(); }
+
+		// @return true on success
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		bool read(T& val) noexcept
+		{
+			if (!require(sizeof(T)))
+				{ return false; }
+			std::memcpy(&val, in.data(), sizeof(T));
+			in.remove_prefix(sizeof(T));
+			return true;
+		}
+
+		// @return true on success
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		bool read_vector(std::vector<T>& vals)
+		{
+			std::uint64_t size;
+			// checking size first means size * sizeof(T) can't overflow
+			if (!read(size) || !require(size) || !require(size * sizeof(T)))
+				{ return false; }
+			vals.resize(size);
+			std::memcpy(vals.data(), in.data(), size * sizeof(T));
+			in.remove_prefix(size * sizeof(T));
+			return true;
+		}
+
+		// read contents written by write_aligned_span without copying them
+		// @param vals  view into the input, valid as long as it is
+		// @return true on success, false also if the contents aren't aligned in memory
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		bool read_view(std::span<const T>& vals) noexcept
+		{
+			std::uint64_t size;
+			const std::size_t padding = (alignof(T) - static_cast<std::size_t>(in.data() + sizeof(size) - origin) % alignof(T)) % alignof(T);
+			if (!read(size) || !require(padding))
+				{ return false; }
+			in.remove_prefix(padding);
+			if (!require(size) || !require(size * sizeof(T)) || reinterpret_cast<std::uintptr_t>(in.data()) % alignof(T) != 0)
+			{
+				good = false;
+				return false;
+			}
+			// the bytes were written from objects of T, which is trivially copyable, so they can be used as them where they are
+			vals = std::span(reinterpret_cast<const T*>(in.data()), size);
+			in.remove_prefix(size * sizeof(T));
+			return true;
+		}
+
+		// @return true on success
+		bool read_string(std::string& str)
+		{
+			std::uint64_t size;
+			if (!read(size) || !require(size))
+				{ return false; }
+			str.assign(in.data(), size);
+			in.remove_prefix(size);
+			return true;
+		}
+
+		// @return true on success
+		bool read_varint(std::uint64_t& val) noexcept
+		{
+			val = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (!require(1))
+					{ return false; }
+				const auto byte = static_cast<unsigned char>(in.front());
+				in.remove_prefix(1);
+				val |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+					{ return true; }
+			}
+			good = false;
+			return false;
+		}
+
+		// @return true on success
+		bool read_signed_varint(std::int64_t& val) noexcept
+		{
+			std::uint64_t encoded;
+			if (!read_varint(encoded))
+				{ return false; }
+			val = static_cast<std::int64_t>((encoded >> 1) ^ (~(encoded & 1) + 1));
+			return true;
+		}
+
+		// read string written by write_short_string
+		// @param str  view into the input, valid as long as it is
+		// @return true on success
+		bool read_short_string(std::string_view& str) noexcept
+		{
+			std::uint64_t size;
+			if (!read_varint(size) || !require(size))
+				{ return false; }
+			str = in.substr(0, size);
+			in.remove_prefix(size);
+			return true;
+		}
+	};
+}
+
+#endif
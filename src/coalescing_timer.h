@@ -0,0 +1,102 @@
+#ifndef COALESCING_TIMER_H
+#define COALESCING_TIMER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <dpp/dpp.h>
+
+// dpp timer for coalescing changes into fewer requests (see presence_scheduler, join_notifier and status_message): a change starts it, and it stops
+// itself once a tick has nothing left to do, so nothing runs while nothing changes. ticks, changes and the callbacks of requests (see guard) are
+// serialized by one mutex, which guards the owner's state
+// the owner is only called while this exists: the destructor waits for a tick that is running, and later ticks and callbacks find it stopped.
+// the timer is only ever stopped from its own tick, since dpp doesn't handle stopping a timer from another thread while it's ticking
+class coalescing_timer
+{
+public:
+	// called on dpp's timer thread with `lock` held. it may be unlocked for work that doesn't need it, but must be locked again before returning
+	// @return whether to keep ticking (e.g. a request hasn't been answered yet), false stops the timer until the next start
+	using tick_t = std::function<bool(std::unique_lock<std::mutex>& lock)>;
+
+private:
+	// shared with the timer and the guarded callbacks, which can outlive this
+	struct state_t
+	{
+		std::mutex mutex;
+		std::condition_variable cv;  // ticking was cleared
+		tick_t tick;
+		bool running = false;  // the timer is started
+		bool ticking = false;  // tick is running, maybe with the mutex unlocked
+		bool stopped = false;  // this was destroyed
+	};
+
+	dpp::cluster& bot;
+	std::uint64_t interval;
+	std::shared_ptr<state_t> state;
+
+	// `cur_state` is a copy, since stopping the timer destroys the callback that has the timer's
+	static void on_tick(dpp::cluster& bot, const std::shared_ptr<state_t> cur_state, dpp::timer handle)
+	{
+		std::unique_lock lock(cur_state->mutex);
+		if (!cur_state->stopped)
+		{
+			cur_state->ticking = true;
+			const bool keep = cur_state->tick(lock);
+			cur_state->ticking = false;
+			cur_state->cv.notify_all();
+			if (keep)
+				{ return; }
+		}
+		cur_state->running = false;
+		bot.stop_timer(handle);
+	}
+
+public:
+	// @param interval  seconds between ticks (at least 1)
+	coalescing_timer(dpp::cluster& bot, std::uint64_t interval, tick_t tick) :
+		bot(bot), interval(std::max<std::uint64_t>(interval, 1)), state(std::make_shared<state_t>())
+		{ state->tick = std::move(tick); }
+	coalescing_timer(const coalescing_timer&) = delete;
+	coalescing_timer& operator=(const coalescing_timer&) = delete;
+	// a running timer stops itself on its next tick
+	~coalescing_timer()
+	{
+		std::unique_lock lock(state->mutex);
+		state->stopped = true;
+		state->cv.wait(lock, [this]() { return !state->ticking; });
+		state->tick = nullptr;
+	}
+
+	// @return lock of the mutex ticks run with, to change what they read
+	[[nodiscard]] std::unique_lock<std::mutex> lock()
+		{ return std::unique_lock(state->mutex); }
+
+	// start ticking, if it isn't already
+	// @param lock  from lock()
+	void start(const std::unique_lock<std::mutex>& /*lock*/)
+	{
+		if (state->running)
+			{ return; }
+		state->running = true;
+		bot.start_timer([&bot = bot, cur_state = state](dpp::timer handle) { on_tick(bot, cur_state, handle); }, interval);
+	}
+
+	// @return `callback` (e.g. of a request sent by a tick) wrapped to run with the mutex held, and not at all once this is destroyed
+	template<typename callback_t>
+	[[nodiscard]] auto guard(callback_t callback) const
+	{
+		return [cur_state = state, callback = std::move(callback)](auto&&... args)
+		{
+			std::scoped_lock lock(cur_state->mutex);
+			if (!cur_state->stopped)
+				{ callback(std::forward<decltype(args)>(args)...); }
+		};
+	}
+};
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "coplay.h"
+#include "digest.h"
+#include "graph_cache.h"
+#include "heatmap_graph.h"
+#include "last_seen.h"
+#include "leaderboard.h"
+#include "name_completion.h"
+#include "online_graph.h"
+#include "online_index.h"
+#include "player_graph.h"
+#include "playtime_graph.h"
+#include "presence_index.h"
+#include "published_data.h"
+#include "render_executor.h"
+#include "session_lengths.h"
+#include "session_query.h"
+#include "timelapse_graph.h"
+
+// what slash commands do apart from talking to discord: reading their options, querying the published data of a view and rendering graphs.
+// main.cpp answers commands (and http requests) with these, and load_test runs them from many threads without discord
+
+// what is computed from the data of a view (one server, or all of them merged) and cached for it
+struct view_caches
+{
+	graph_cache graphs;
+	// names for the player option, remade when history is committed to
+	// completing only reads the latest published data, so it never waits for the log reading loops
+	detail::history_cache<name_completions> completions;
+	// all time ranking for /leaderboard, remade when history is committed to
+	detail::history_cache<playtime_ranking> ranking;
+	// interval trees for /online_at, remade when history is committed to
+	detail::history_cache<online_index> online;
+	// minutes each player was online for /friends, remade when history is committed to
+	detail::history_cache<coplay_index> coplay;
+	// players online on each day for /active, remade when history is committed to
+	detail::history_cache<presence_index> presence;
+	// last seen time of each player for /seen, remade when history is committed to
+	detail::history_cache<last_seen_index> last_seen;
+	// sketches of session lengths of each segment for /stats, made once for each segment
+	detail::segment_cache<session_length_digests> session_lengths;
+	// block headers of each segment for skipping blocks in session queries (e.g. for /stats), made once for each segment
+	detail::segment_cache<session_zone_map> zone_maps;
+};
+
+// @param str  type option of /graph or of /graph.svg and /graph.png
+// @return graph type it names, playtime if it doesn't name one
+[[nodiscard]] constexpr graph_type parse_graph_type(std::string_view str) noexcept
+{
+	return (str == "online") ? graph_type::online : (str == "heatmap") ? graph_type::heatmap : (str == "lag") ? graph_type::lag :
+		(str == "servers") ? graph_type::servers : graph_type::playtime;
+}
+
+static_assert(parse_graph_type("heatmap") == graph_type::heatmap);
+static_assert(parse_graph_type("player") == graph_type::playtime);
+
+// @param str  period option of /leaderboard
+// @return days it counts, including today, or 0 for all time
+[[nodiscard]] constexpr int parse_leaderboard_period(std::string_view str) noexcept
+	{ return (str == "month") ? 30 : (str == "week") ? 7 : (str == "today") ? 1 : 0; }
+
+static_assert(parse_leaderboard_period("week") == 7);
+static_assert(parse_leaderboard_period("all") == 0);
+
+// render the graph `key` is of, in its format
+// @param options  with the key's row limit and range
+// @return contents of the graph file (see create_graph)
+[[nodiscard]] inline std::string render_graph_file(const published_data_t& data, const graph_cache::key_t& key, const graph_options& options)
+{
+	if (key.type == graph_type::player)
+	{
+		if (key.svg)
+			{ return create_player_graph<true, false>(data.history, data.recent, data.ctx, key.player, options); }
+		return create_player_graph<false, true>(data.history, data.recent, data.ctx, key.player, options);
+	}
+	if (key.type == graph_type::heatmap)
+	{
+		if (key.svg)
+			{ return create_heatmap_graph<true, false>(data.history, data.recent, data.ctx, options); }
+		return create_heatmap_graph<false, true>(data.history, data.recent, data.ctx, options);
+	}
+	// a graph of each server of a server's data is only its players online graph
+	if (key.type == graph_type::servers && !data.servers.empty())
+	{
+		std::vector<server_graph_data> servers;
+		for (const auto& [name, server_data] : data.servers)
+			{ servers.push_back({ name, server_data->history, server_data->recent, server_data->ctx }); }
+		if (key.svg)
+			{ return create_servers_graph<true, false>(servers, options); }
+		return create_servers_graph<false, true>(servers, options);
+	}
+	if (key.type == graph_type::online || key.type == graph_type::servers)
+	{
+		if (key.svg)
+			{ return create_online_graph<true, false>(data.history, data.recent, data.ctx, options); }
+		return create_online_graph<false, true>(data.history, data.recent, data.ctx, options);
+	}
+	if (key.type == graph_type::lag)
+	{
+		if (key.svg)
+			{ return create_lag_graph<true, false>(data.history, data.recent, data.ctx, data.lag, data.uptime, options); }
+		return create_lag_graph<false, true>(data.history, data.recent, data.ctx, data.lag, data.uptime, options);
+	}
+	if (key.svg)
+		{ return create_graph<true, false>(data.history, data.recent, data.ctx, options); }
+	return create_graph<false, true>(data.history, data.recent, data.ctx, options);
+}
+
+enum class graph_request : std::uint8_t
+{
+	joined,  // an identical render was already running
+	queued,  // a render was queued
+	busy  // the render queue is full, the callback was called with null
+};
+
+// wait for the graph of `key` to be rendered on `renderer`, or for the render of it that is already running (the cache isn't looked in first)
+// @param render  renders the graph and adds it to the cache, on a render thread: std::shared_ptr<const std::string>()
+// @param callback  called with the graph, or null if it wasn't rendered (its deadline passed, or the render it joined wasn't queued)
+template<typename Render>
+graph_request request_graph(graph_cache& graphs, render_executor& renderer, std::chrono::steady_clock::time_point deadline, const graph_cache::key_t& key,
+	Render render, graph_cache::render_callback_t callback)
+{
+	if (graphs.await_render(key, std::move(callback)) == graph_cache::render_wait::joined)
+		{ return graph_request::joined; }
+	const bool queued = renderer.submit(deadline, [&graphs, key, render = std::move(render)](bool expired)
+		{ graphs.finish_render(key, expired ? nullptr : render()); });
+	if (!queued)
+	{
+		graphs.finish_render(key, nullptr);
+		return graph_request::busy;
+	}
+	return graph_request::queued;
+}
+
+// @return message of /players
+[[nodiscard]] inline std::string players_message(const published_data_t& data)
+{
+	std::string msg;
+	const std::size_t num_players = data.ctx.player_info.online().size();
+	for (const std::uint32_t id : data.ctx.player_info.online())
+	{
+		msg += data.ctx.player_info.name(id);
+		msg += ", ";
+	}
+	if (num_players == 0)
+		{ msg = "No players online"; }
+	else
+	{
+		msg.resize(msg.size() - 2);  // remove final ", "
+		msg = std::format("**{} players online:** {}", num_players, msg);
+	}
+	// online players are only known once latest.log is read
+	if (data.loading())
+		{ msg += "\n" + data.loading_note(); }
+	return msg;
+}
+
+// @param name  player option of /seen
+// @return when the player was last seen, or empty optional if nobody with that name has played
+[[nodiscard]] inline std::optional<last_seen_entry> find_last_seen(view_caches& cache, const published_data_t& data, std::string_view name)
+{
+	const auto segments = data.history.get_segments();
+	const auto index = cache.last_seen.get(segments, [segments]() { return last_seen_index(segments); });
+	return index->find(name, data.recent, data.ctx);
+}
+
+// run a filter/aggregate query over the sessions of a view (see session_query). it scans history, so it's run on the query lane
+[[nodiscard]] inline session_query_result query_sessions(view_caches& cache, const published_data_t& data, const session_query& query)
+{
+	const auto zone_map_of = [&cache](const std::shared_ptr<const session_store>& segment)
+		{ return cache.zone_maps.get(segment, [&segment]() { return session_zone_map(*segment); }); };
+	return run_session_query(data.history.get_segments(), zone_map_of, data.recent, query);
+}
+
+struct session_lengths_result
+{
+	session_length_stats everyone;
+	std::optional<session_length_stats> player;  // of the player asked about, if any
+	// total and longest of the same sessions
+	session_aggregate everyone_totals;
+	std::optional<session_aggregate> player_totals;
+};
+
+// lengths of the sessions that started in a range for /stats (may go through the sessions at the ends of the range, so it's run on the query lane)
+// @param timezone  months of the sketches are local to it
+// @param player  whose session lengths to find as well
+[[nodiscard]] inline session_lengths_result query_session_lengths(view_caches& cache, const published_data_t& data, const std::chrono::time_zone* timezone,
+	const time_range& range, std::optional<uuid_t> player)
+{
+	const auto segments = data.history.get_segments();
+	const auto digests_of = [&cache, timezone](const std::shared_ptr<const session_store>& segment)
+		{ return cache.session_lengths.get(segment, [&segment, timezone]() { return session_length_digests(*segment, timezone); }); };
+	session_lengths_result res;
+	res.everyone = get_session_lengths(segments, digests_of, timezone, data.recent, range, std::nullopt);
+	if (player)
+		{ res.player = get_session_lengths(segments, digests_of, timezone, data.recent, range, player); }
+
+	// the sessions the sketches have: those that started in the range, without the ones whose log dates were off
+	const session_query query{ .filter{ .started = range, .min_duration = std::chrono::seconds(0) },
+		.group = player ? session_grouping::player : session_grouping::none };
+	const session_query_result totals = query_sessions(cache, data, query);
+	res.everyone_totals = totals.total;
+	if (player)
+	{
+		const auto it = std::ranges::lower_bound(totals.players, player.value(), {}, &std::pair<uuid_t, session_aggregate>::first);
+		res.player_totals = (it != totals.players.end() && it->first == player.value()) ? it->second : session_aggregate();
+	}
+	return res;
+}
+
+struct leaderboard_result
+{
+	std::vector<leaderboard_entry> top;
+	std::optional<leaderboard_entry> player;  // the entry of the player asked about, if they have played
+};
+
+// rank players by playtime for /leaderboard (may scan all history, so it's run on the query lane)
+// @param timezone  days are counted from midnight in it
+// @param num_days  see parse_leaderboard_period
+// @param player  whose rank to find as well
+[[nodiscard]] inline leaderboard_result query_leaderboard(view_caches& cache, const published_data_t& data, const std::chrono::time_zone* timezone, int num_days,
+	std::size_t count, std::optional<uuid_t> player, graph_render_ctx& render_ctx)
+{
+	leaderboard_result res;
+	const auto now = std::chrono::system_clock::now();
+	if (num_days == 0)
+	{
+		const auto segments = data.history.get_segments();
+		const auto ranking = cache.ranking.get(segments, [segments]() { return playtime_ranking(segments); });
+		const auto extra = playtime_ranking::get_extra(data.recent, data.ctx, now);
+		res.top = ranking->top(count, extra, data.recent);
+		if (player)
+			{ res.player = ranking->rank(player.value(), extra, data.recent); }
+	}
+	else
+	{
+		// from midnight at the start of the first day, so playtime per day is used
+		const auto today = std::chrono::floor<std::chrono::days>(timezone->to_local(now));
+		time_range range;
+		range.begin = timezone->to_sys(today - std::chrono::days(num_days - 1), std::chrono::choose::earliest);
+		std::tie(res.top, res.player) = get_range_leaderboard(data.history, data.recent, data.ctx, range, count, player, render_ctx);
+	}
+	return res;
+}
+
+// all time playtime of a player in a view until now, for milestone_notifier (builds the ranking of the view the first time after history changes)
+[[nodiscard]] inline std::chrono::system_clock::duration query_playtime(view_caches& cache, const published_data_t& data, uuid_t uuid)
+{
+	const auto segments = data.history.get_segments();
+	const auto ranking = cache.ranking.get(segments, [segments]() { return playtime_ranking(segments); });
+	return ranking->playtime(uuid, data.recent, data.ctx, std::chrono::system_clock::now());
+}
+
+
+// make the digest of days [first, last] of a view for digest_poster (builds the presence index of the view the first time after it changes)
+// @param count  players in the digest's top
+[[nodiscard]] inline digest_t query_digest(view_caches& cache, const published_data_t& data, std::chrono::local_days first, std::chrono::local_days last,
+	std::size_t count, graph_render_ctx& render_ctx)
+{
+	const auto now = std::chrono::system_clock::now();
+	const std::chrono::time_zone* timezone = render_ctx.get_timezone();
+	const auto segments = data.history.get_segments();
+	const auto index = cache.presence.get(segments, [segments, timezone]() { return presence_index(segments, timezone); });
+	const presence_index::recent_t recent = index->get_recent(data.recent, data.ctx, now);
+	return get_digest(data.history, data.recent, data.ctx, *index, recent, render_ctx, first, last, count, now);
+}
+
+#endif
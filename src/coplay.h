@@ -0,0 +1,405 @@
+#ifndef COPLAY_H
+#define COPLAY_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "parse_logs.h"
+#include "session_store.h"
+
+// minutes someone was online, compressed like a roaring bitmap: minutes since the epoch are split into containers of 2^16 minutes (about 45 days),
+// and each container is a sorted list of the runs of consecutive minutes in it, or a bitmap of all of its minutes if there are too many runs
+// players are online for hours at a time, so most containers are a few dozen runs, and counting common minutes of two containers
+// is a merge of their runs, or ANDs and popcounts of whole words for bitmaps
+class minute_bitset
+{
+public:
+	static constexpr std::size_t container_bits = 16;
+	static constexpr std::size_t bitmap_words = (std::size_t(1) << container_bits) / 64;
+	// lists of more runs than this would take more memory than a bitmap
+	static constexpr std::size_t max_runs = bitmap_words * sizeof(std::uint64_t) / (2 * sizeof(std::uint16_t));
+
+	// half-open range of minutes since the epoch
+	using range_t = std::pair<std::uint32_t, std::uint32_t>;
+
+private:
+	// first and last (inclusive, so the whole container fits) low bits of the minutes of a run
+	using run_t = std::pair<std::uint16_t, std::uint16_t>;
+
+	struct container_t
+	{
+		std::uint32_t key;  // minutes >> container_bits
+		std::vector<run_t> runs;  // sorted and not touching, if it isn't a bitmap
+		std::vector<std::uint64_t> words;  // bitmap_words words, if it is a bitmap (then runs is empty)
+
+		[[nodiscard]] bool is_bitmap() const noexcept
+			{ return !words.empty(); }
+	};
+
+	std::vector<container_t> containers;  // sorted by key
+
+	// @param words  bitmap_words words
+	// @return container of the set bits of words, as runs if there aren't too many
+	[[nodiscard]] static container_t make_container(std::uint32_t key, std::span<const std::uint64_t> words)
+	{
+		container_t res{ key, {}, {} };
+		// @return first bit from `from` on that is `set`, or the number of bits if there is none
+		const auto next = [&words](std::size_t from, bool set)
+		{
+			for (std::size_t i = from / 64; i < words.size(); i++)
+			{
+				const std::uint64_t word = (set ? words[i] : ~words[i]) & (~std::uint64_t(0) << ((i == from / 64) ? from % 64 : 0));
+				if (word != 0)
+					{ return i * 64 + std::countr_zero(word); }
+			}
+			return words.size() * 64;
+		};
+		std::size_t bit = 0;
+		while (bit < words.size() * 64)
+		{
+			const std::size_t first = next(bit, true);
+			if (first == words.size() * 64)
+				{ break; }
+			bit = next(first, false);
+			if (res.runs.size() == max_runs)
+			{
+				res.runs.clear();
+				res.words.assign(words.begin(), words.end());
+				return res;
+			}
+			res.runs.emplace_back(static_cast<std::uint16_t>(first), static_cast<std::uint16_t>(bit - 1));
+		}
+		return res;
+	}
+
+	// set bits [first, last) of a bitmap
+	static void set_bits(std::span<std::uint64_t> words, std::size_t first, std::size_t last) noexcept
+	{
+		while (first < last)
+		{
+			const std::size_t word_end = std::min(last, (first / 64 + 1) * 64);
+			words[first / 64] |= bit_mask(first % 64, word_end - first);
+			first = word_end;
+		}
+	}
+
+	// @return `count` (1 to 64) bits starting at `first`
+	[[nodiscard]] static constexpr std::uint64_t bit_mask(std::size_t first, std::size_t count) noexcept
+		{ return ((count == 64) ? ~std::uint64_t(0) : ((std::uint64_t(1) << count) - 1)) << first; }
+
+	// @return number of set bits in [first, last) of a bitmap
+	[[nodiscard]] static std::uint64_t count_bits(std::span<const std::uint64_t> words, std::size_t first, std::size_t last) noexcept
+	{
+		std::uint64_t count = 0;
+		while (first < last)
+		{
+			const std::size_t word_end = std::min(last, (first / 64 + 1) * 64);
+			count += std::popcount(words[first / 64] & bit_mask(first % 64, word_end - first));
+			first = word_end;
+		}
+		return count;
+	}
+
+	static void add_to_bitmap(std::span<std::uint64_t> words, const container_t& container) noexcept
+	{
+		if (container.is_bitmap())
+		{
+			for (std::size_t i = 0; i < bitmap_words; i++)
+				{ words[i] |= container.words[i]; }
+		}
+		else
+		{
+			for (const auto [first, last] : container.runs)
+				{ set_bits(words, first, std::size_t(last) + 1); }
+		}
+	}
+
+	[[nodiscard]] static std::uint64_t intersection_size(const container_t& lhs, const container_t& rhs) noexcept
+	{
+		if (lhs.is_bitmap() && rhs.is_bitmap())
+		{
+			// independent iterations, so the compiler can vectorize it (e.g. with vpopcntq)
+			std::uint64_t count = 0;
+			for (std::size_t i = 0; i < bitmap_words; i++)
+				{ count += std::popcount(lhs.words[i] & rhs.words[i]); }
+			return count;
+		}
+		if (lhs.is_bitmap() || rhs.is_bitmap())
+		{
+			const container_t& runs = lhs.is_bitmap() ? rhs : lhs;
+			const container_t& bitmap = lhs.is_bitmap() ? lhs : rhs;
+			std::uint64_t count = 0;
+			for (const auto [first, last] : runs.runs)
+				{ count += count_bits(bitmap.words, first, std::size_t(last) + 1); }
+			return count;
+		}
+		// both sorted, so each step moves past the run that ends first
+		std::uint64_t count = 0;
+		for (auto it1 = lhs.runs.begin(), it2 = rhs.runs.begin(); it1 != lhs.runs.end() && it2 != rhs.runs.end();)
+		{
+			const std::uint16_t first = std::max(it1->first, it2->first), last = std::min(it1->second, it2->second);
+			if (first <= last)
+				{ count += last - first + 1; }
+			if (it1->second < it2->second)
+				{ ++it1; }
+			else
+				{ ++it2; }
+		}
+		return count;
+	}
+
+public:
+	minute_bitset() = default;
+
+	// @param ranges  of minutes, sorted by start. they may overlap
+	explicit minute_bitset(std::span<const range_t> ranges)
+	{
+		std::array<std::uint64_t, bitmap_words> words{};
+		std::optional<std::uint32_t> cur_key;
+		std::uint32_t covered = 0;  // end of the ranges so far, so containers are made in order even if ranges overlap
+		for (auto [first, last] : ranges)
+		{
+			first = std::max(first, covered);
+			covered = std::max(covered, last);
+			while (first < last)
+			{
+				const std::uint32_t key = first >> container_bits;
+				if (cur_key != key)
+				{
+					if (cur_key)
+						{ containers.push_back(make_container(cur_key.value(), words)); }
+					cur_key = key;
+					words.fill(0);
+				}
+				const std::uint64_t container_end = (std::uint64_t(key) + 1) << container_bits;
+				const auto end = static_cast<std::uint32_t>(std::min<std::uint64_t>(last, container_end));
+				set_bits(words, first & ((1 << container_bits) - 1), end - (key << container_bits));
+				first = end;
+			}
+		}
+		if (cur_key)
+			{ containers.push_back(make_container(cur_key.value(), words)); }
+	}
+
+	// @return minutes in this or `other`
+	[[nodiscard]] minute_bitset united(const minute_bitset& other) const
+	{
+		minute_bitset res;
+		auto it1 = containers.begin(), it2 = other.containers.begin();
+		while (it1 != containers.end() || it2 != other.containers.end())
+		{
+			if (it2 == other.containers.end() || (it1 != containers.end() && it1->key < it2->key))
+				{ res.containers.push_back(*it1++); }
+			else if (it1 == containers.end() || it2->key < it1->key)
+				{ res.containers.push_back(*it2++); }
+			else
+			{
+				std::array<std::uint64_t, bitmap_words> words{};
+				add_to_bitmap(words, *it1++);
+				add_to_bitmap(words, *it2);
+				res.containers.push_back(make_container(it2->key, words));
+				++it2;
+			}
+		}
+		return res;
+	}
+
+	// @return number of minutes in both this and `other`
+	[[nodiscard]] std::uint64_t intersection_size(const minute_bitset& other) const noexcept
+	{
+		std::uint64_t count = 0;
+		for (auto it1 = containers.begin(), it2 = other.containers.begin(); it1 != containers.end() && it2 != other.containers.end();)
+		{
+			if (it1->key < it2->key)
+				{ ++it1; }
+			else if (it2->key < it1->key)
+				{ ++it2; }
+			else
+				{ count += intersection_size(*it1++, *it2++); }
+		}
+		return count;
+	}
+
+	[[nodiscard]] bool empty() const noexcept
+		{ return containers.empty(); }
+
+	// @return keys of the containers, in order
+	[[nodiscard]] auto keys() const
+		{ return containers | std::views::transform(&container_t::key); }
+};
+
+namespace detail
+{
+	// @return minutes since the epoch that part of `session` is in, empty if it is before the epoch or empty
+	[[nodiscard]] inline minute_bitset::range_t session_minutes(const play_session& session) noexcept
+	{
+		const auto start = std::chrono::floor<std::chrono::minutes>(session.first.time_since_epoch()).count();
+		const auto end = std::chrono::ceil<std::chrono::minutes>((session.first + session.second).time_since_epoch()).count();
+		if (end <= start || end <= 0)
+			{ return { 0, 0 }; }
+		return { static_cast<std::uint32_t>(std::max<std::int64_t>(start, 0)), static_cast<std::uint32_t>(end) };
+	}
+
+	// @return bitset of minutes in `ranges`, which are sorted first
+	[[nodiscard]] inline minute_bitset make_minute_bitset(std::vector<minute_bitset::range_t>& ranges)
+	{
+		std::ranges::sort(ranges);
+		return minute_bitset(ranges);
+	}
+}
+
+// a player someone played with, and for how long (see coplay_index::partners)
+struct coplay_partner
+{
+	uuid_t uuid;
+	std::string_view name;  // latest name
+	std::chrono::minutes together;  // minutes both were online in
+};
+
+// minutes each player in history was online (see minute_bitset), made once for each set of history segments (see detail::history_cache)
+// minutes of recent data and online players are added when querying, like the leaderboard does with their playtime
+// in a view of several servers, players online on different servers at the same time count as together
+class coplay_index
+{
+private:
+	std::vector<uuid_t> uuids;  // sorted
+	std::vector<minute_bitset> bitsets;  // of uuids[i]
+	std::vector<std::string_view> names;  // latest name of uuids[i], in the segments
+	// of each container key, the players with minutes in it, so only players who were online in the same ~45 days are compared
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> players_by_key;  // sorted
+
+	[[nodiscard]] std::optional<std::size_t> find(uuid_t uuid) const noexcept
+	{
+		const auto it = std::ranges::lower_bound(uuids, uuid);
+		if (it == uuids.end() || *it != uuid)
+			{ return {}; }
+		return it - uuids.begin();
+	}
+
+public:
+	// @param segments  must outlive this, since names refer to them
+	// @param since  sessions ending before this are left out, e.g. ones that were rolled up, which all start at midnight (see session_store::rolled_up)
+	coplay_index(std::span<const std::shared_ptr<const session_store>> segments, std::chrono::system_clock::time_point since)
+	{
+		std::map<uuid_t, std::pair<std::vector<minute_bitset::range_t>, std::string_view>> players;
+		for (const auto& segment : segments)
+		{
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				auto& [ranges, name] = players[segment->uuid(i)];
+				if (const auto player_names = segment->player_names(i); !player_names.empty())
+					{ name = player_names.back(); }
+				segment->for_each_session(i, time_range{ .begin = since }, [&ranges](const play_session& session)
+					{ ranges.push_back(detail::session_minutes(session)); });
+			}
+		}
+		for (auto& [uuid, player] : players)
+		{
+			minute_bitset bitset = detail::make_minute_bitset(player.first);
+			if (bitset.empty())
+				{ continue; }
+			for (const std::uint32_t key : bitset.keys())
+				{ players_by_key.emplace_back(key, static_cast<std::uint32_t>(uuids.size())); }
+			uuids.push_back(uuid);
+			bitsets.push_back(std::move(bitset));
+			names.push_back(player.second);
+		}
+		std::ranges::sort(players_by_key);
+	}
+
+	// @param player  to find the partners of
+	// @param count  max partners to return
+	// @param recent, parse_ctx  data that isn't in history yet, for recent sessions and online players
+	// @param now  end of the sessions of online players
+	// @return the `count` players who were online at the same time as `player` for the most minutes, most first (only ones with any)
+	[[nodiscard]] std::vector<coplay_partner> partners(uuid_t player, std::size_t count, const log_data_t& recent, const parse_ctx_t& parse_ctx,
+		std::chrono::system_clock::time_point now) const
+	{
+		// minutes of players that aren't in history yet, added to their history when comparing
+		std::map<uuid_t, std::vector<minute_bitset::range_t>> extra_ranges;
+		for (const auto& [uuid, data] : recent)
+		{
+			for (const play_session& session : data.second.first)
+				{ extra_ranges[uuid].push_back(detail::session_minutes(session)); }
+		}
+		for (const std::uint32_t id : parse_ctx.player_info.online())
+		{
+			const auto& [uuid, join_time] = parse_ctx.player_info.infos()[id];
+			if (uuid)
+				{ extra_ranges[uuid.value()].push_back(detail::session_minutes(play_session(join_time.value(), now - join_time.value()))); }
+		}
+		std::map<uuid_t, minute_bitset> extra;
+		for (auto& [uuid, ranges] : extra_ranges)
+		{
+			minute_bitset bitset = detail::make_minute_bitset(ranges);
+			if (const auto ind = find(uuid))
+				{ bitset = bitset.united(bitsets[ind.value()]); }
+			extra.emplace(uuid, std::move(bitset));
+		}
+		const auto get_bitset = [this, &extra](uuid_t uuid, std::optional<std::size_t> ind) -> const minute_bitset*
+		{
+			if (const auto it = extra.find(uuid); it != extra.end())
+				{ return &it->second; }
+			return ind ? &bitsets[ind.value()] : nullptr;
+		};
+
+		const auto player_ind = find(player);
+		const minute_bitset* player_bitset = get_bitset(player, player_ind);
+		if (player_bitset == nullptr)
+			{ return {}; }
+		// players with minutes in a container the player has, and players with recent minutes
+		std::vector<std::uint32_t> candidates;
+		for (const std::uint32_t key : player_bitset->keys())
+		{
+			const auto [first, last] = std::ranges::equal_range(players_by_key, key, {}, &std::pair<std::uint32_t, std::uint32_t>::first);
+			for (auto it = first; it != last; ++it)
+				{ candidates.push_back(it->second); }
+		}
+		std::ranges::sort(candidates);
+		candidates.erase(std::ranges::unique(candidates).begin(), candidates.end());
+
+		std::vector<coplay_partner> res;
+		const auto add = [&](uuid_t uuid, std::string_view name, const minute_bitset& bitset)
+		{
+			if (uuid == player)
+				{ return; }
+			if (const std::uint64_t minutes = player_bitset->intersection_size(bitset); minutes != 0)
+				{ res.emplace_back(uuid, name, std::chrono::minutes(minutes)); }
+		};
+		for (const std::uint32_t ind : candidates)
+		{
+			if (!extra.contains(uuids[ind]))
+				{ add(uuids[ind], names[ind], bitsets[ind]); }
+		}
+		for (const auto& [uuid, bitset] : extra)
+		{
+			const auto ind = find(uuid);
+			add(uuid, ind ? names[ind.value()] : std::string_view(), bitset);
+		}
+
+		const std::size_t res_size = std::min(count, res.size());
+		std::ranges::partial_sort(res, res.begin() + res_size, [](const coplay_partner& lhs, const coplay_partner& rhs)
+			{ return (lhs.together != rhs.together) ? lhs.together > rhs.together : lhs.uuid < rhs.uuid; });
+		res.resize(res_size);
+		for (coplay_partner& partner : res)
+		{
+			if (const auto it = recent.find(partner.uuid); it != recent.end() && !it->second.first.empty())
+				{ partner.name = it->second.first.back(); }
+		}
+		return res;
+	}
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "leaderboard.h"
+#include "online_graph.h"
+#include "parse_logs.h"
+#include "playtime_graph.h"
+#include "presence_index.h"
+#include "session_store.h"
+
+// summary of some days, which the bot posts each day and each week (see digest_schedule)
+struct digest_t
+{
+	std::chrono::local_days first, last;  // days it is of, inclusive
+	std::vector<leaderboard_entry> top;  // most playtime on the days, names are of the data it was made from
+	std::size_t active = 0;  // players online on any of the days
+	std::size_t new_players = 0;  // of them, those first online on one of the days
+	std::chrono::seconds total{};  // playtime of all of them on the days
+	std::int32_t peak = 0;  // most players online at once
+	std::chrono::sys_seconds peak_time{};  // when that many were first online
+};
+
+// make the digest of days [first, last] from what is already kept per day and per change in players online, so it costs
+// as much as the players online on those days rather than every session: the players come from the presence index,
+// their playtime from the playtime per day of each segment (and their few recent sessions), and the peak from the step function of players online
+// the data is read in place, so it must not be modified while the digest is made
+// @param presence  of history, in render_ctx's time zone
+// @param presence_recent  of the recent data (see presence_index::get_recent)
+// @param count  players in top
+// @param now  end of the sessions of online players
+inline digest_t get_digest(const session_history& history, const log_data_t& recent, const parse_ctx_t& parse_ctx, const presence_index& presence,
+	const presence_index::recent_t& presence_recent, graph_render_ctx& render_ctx, std::chrono::local_days first, std::chrono::local_days last,
+	std::size_t count, std::chrono::system_clock::time_point now)
+{
+	digest_t res{ .first = first, .last = last };
+	const std::chrono::time_zone* timezone = render_ctx.get_timezone();
+	const time_range range{ timezone->to_sys(first, std::chrono::choose::earliest), timezone->to_sys(last + std::chrono::days(1), std::chrono::choose::earliest) };
+	const auto segments = history.get_segments();
+	std::vector<std::shared_ptr<const daily_playtime>> playtimes;
+	playtimes.reserve(segments.size());
+	for (const auto& segment : segments)
+		{ playtimes.push_back(render_ctx.get_daily_playtime(segment)); }
+	// (uuid, id in parse_ctx) of online players, sorted
+	std::vector<std::pair<uuid_t, std::uint32_t>> online;
+	for (const std::uint32_t id : parse_ctx.player_info.online())
+	{
+		if (const auto& uuid = parse_ctx.player_info.infos()[id].uuid)
+			{ online.emplace_back(uuid.value(), id); }
+	}
+	std::ranges::sort(online);
+
+	std::vector<leaderboard_entry> entries;
+	const player_bitmap active = presence.any_day(first, last, presence_recent);
+	entries.reserve(active.size());
+	active.for_each([&](std::uint32_t id)
+	{
+		leaderboard_entry& entry = entries.emplace_back(presence.uuid(id, presence_recent), std::string_view(), std::chrono::system_clock::duration::zero(), 0);
+		for (std::size_t i = 0; i < segments.size(); i++)
+		{
+			if (const auto ind = segments[i]->find(entry.uuid))
+			{
+				entry.total += playtimes[i]->playtime(ind.value(), first, last + std::chrono::days(1));
+				if (const auto names = segments[i]->player_names(ind.value()); !names.empty())
+					{ entry.name = names.back(); }
+			}
+		}
+		if (const auto it = recent.find(entry.uuid); it != recent.end())
+		{
+			const auto& [names, play_info] = it->second;
+			for (const play_session& session : play_info.first)
+			{
+				if (range.overlaps(session))
+					{ entry.total += range.clip(session).second; }
+			}
+			if (!names.empty())
+				{ entry.name = names.back(); }
+		}
+		if (const auto it = std::ranges::lower_bound(online, entry.uuid, {}, &std::pair<uuid_t, std::uint32_t>::first); it != online.end() && it->first == entry.uuid)
+		{
+			const auto join_time = parse_ctx.player_info.infos()[it->second].join_time.value();
+			if (const play_session session(join_time, now - join_time); range.overlaps(session))
+				{ entry.total += range.clip(session).second; }
+			entry.name = parse_ctx.player_info.name(it->second);
+		}
+	});
+	res.active = entries.size();
+	res.new_players = presence.first_online(first, last, presence_recent).size();
+	for (const leaderboard_entry& entry : entries)
+		{ res.total += std::chrono::duration_cast<std::chrono::seconds>(entry.total); }
+
+	// ranked like the leaderboard, players with the same playtime have the same rank
+	const auto top_end = entries.begin() + static_cast<std::ptrdiff_t>(std::min(count, entries.size()));
+	std::ranges::partial_sort(entries, top_end, std::ranges::greater(), &leaderboard_entry::total);
+	for (auto it = entries.begin(); it != top_end; ++it)
+		{ it->rank = (it != entries.begin() && std::prev(it)->total == it->total) ? std::prev(it)->rank : static_cast<std::size_t>(it - entries.begin() + 1); }
+	entries.erase(top_end, entries.end());
+	res.top = std::move(entries);
+
+	const auto history_players = render_ctx.get_online_players(segments);
+	const auto recent_events = detail::get_recent_online_events(recent, parse_ctx, now);
+	const auto to_seconds = [](std::chrono::system_clock::time_point tp) { return std::chrono::floor<std::chrono::seconds>(tp).time_since_epoch().count(); };
+	std::int64_t peak_time = to_seconds(range.begin);
+	res.peak = detail::online_sweep(*history_players, recent_events, peak_time).max_until(static_cast<double>(to_seconds(range.end)), &peak_time);
+	res.peak_time = std::chrono::sys_seconds(std::chrono::seconds(peak_time));
+	return res;
+}
+
+// when digests are posted: each day at a local time, the digest of the day before, and on one day of the week also the digest of the week before
+// they're made once the days they're of are over (see prepare_time), so there's time to render them before they're posted
+class digest_schedule
+{
+private:
+	const std::chrono::time_zone* timezone;
+	std::chrono::minutes time;  // after midnight
+	std::optional<std::chrono::weekday> weekly_day;
+	std::chrono::local_days next_day;  // of the next post
+
+public:
+	// @param time  of day to post at
+	// @param weekly_day  day to also post the digest of the week on, nullopt to not
+	// @param now  the first post is the first one after this
+	digest_schedule(const std::chrono::time_zone* timezone, std::chrono::minutes time, std::optional<std::chrono::weekday> weekly_day,
+		std::chrono::system_clock::time_point now) :
+		timezone(timezone), time(time), weekly_day(weekly_day), next_day(std::chrono::floor<std::chrono::days>(timezone->to_local(now)))
+	{
+		if (post_time() <= now)
+			{ advance(); }
+	}
+
+	// @return day of the next post
+	[[nodiscard]] std::chrono::local_days day() const noexcept
+		{ return next_day; }
+	// @return when the next digests can be made (the start of day(), when the days they're of are over)
+	[[nodiscard]] std::chrono::system_clock::time_point prepare_time() const
+		{ return timezone->to_sys(next_day, std::chrono::choose::earliest); }
+	// @return when the next digests are posted
+	[[nodiscard]] std::chrono::system_clock::time_point post_time() const
+		{ return timezone->to_sys(next_day + time, std::chrono::choose::earliest); }
+
+	// @return days of the digests posted on day(): the day before, and the week before on weekly_day
+	[[nodiscard]] std::vector<std::pair<std::chrono::local_days, std::chrono::local_days>> periods() const
+	{
+		std::vector<std::pair<std::chrono::local_days, std::chrono::local_days>> res{ { next_day - std::chrono::days(1), next_day - std::chrono::days(1) } };
+		if (weekly_day && std::chrono::weekday(next_day) == weekly_day.value())
+			{ res.emplace_back(next_day - std::chrono::days(7), next_day - std::chrono::days(1)); }
+		return res;
+	}
+
+	// go to the next day's post
+	void advance() noexcept
+		{ next_day += std::chrono::days(1); }
+};
+
+#endif
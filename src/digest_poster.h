@@ -0,0 +1,89 @@
+#ifndef DIGEST_POSTER_H
+#define DIGEST_POSTER_H
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <dpp/dpp.h>
+
+#include "digest.h"
+#include "logger.h"
+
+// posts digests to a channel when digest_schedule says, from a dpp timer. the messages of a post are made as soon as the days they're of
+// are over and kept until it's time to post them, so rendering them (which may wait behind other renders) never makes a post late
+class digest_poster
+{
+public:
+	using messages_t = std::vector<dpp::message>;
+	// start making the messages of the next post of `schedule` (of schedule.periods()), and call `done` with them once they're made,
+	// possibly on another thread, or with nullopt to try again on a later tick (e.g. history is still loading, or the render queue is full)
+	using prepare_t = std::function<void(const digest_schedule& schedule, std::function<void(std::optional<messages_t>)> done)>;
+
+private:
+	static constexpr std::uint64_t tick_seconds = 60;
+
+	dpp::cluster& bot;
+	dpp::snowflake channel_id;
+	prepare_t prepare;
+	std::mutex mutex;
+	digest_schedule schedule;
+	bool preparing = false;  // the messages of the next post are being made
+	std::optional<messages_t> prepared;  // of the next post
+	dpp::timer timer;
+
+	void tick()
+	{
+		std::unique_lock lock(mutex);
+		const auto now = std::chrono::system_clock::now();
+		if (prepared && now >= schedule.post_time())
+		{
+			for (dpp::message& message : prepared.value())
+			{
+				bot.message_create(message.set_channel_id(channel_id), [](const dpp::confirmation_callback_t& res)
+				{
+					if (res.is_error())
+						{ log_message(log_severity::error, std::format("Could not post digest: {}", res.get_error().human_readable)); }
+				});
+			}
+			prepared.reset();
+			schedule.advance();
+		}
+		// a post whose messages still couldn't be made by the time the next one is due is skipped, so posts don't pile up
+		while (!prepared && !preparing && now >= schedule.post_time() + std::chrono::days(1))
+		{
+			log_message(log_severity::warning, "Skipping a digest that could not be made in time");
+			schedule.advance();
+		}
+		if (!prepared && !preparing && now >= schedule.prepare_time())
+		{
+			preparing = true;
+			const digest_schedule next = schedule;
+			lock.unlock();  // `done` may be called before prepare returns
+			prepare(next, [this, day = next.day()](std::optional<messages_t> messages)
+			{
+				std::scoped_lock lock(mutex);
+				preparing = false;
+				if (messages && schedule.day() == day)
+					{ prepared = std::move(messages); }
+			});
+		}
+	}
+
+public:
+	// @param prepare  called from the timer's thread
+	digest_poster(dpp::cluster& bot, dpp::snowflake channel_id, digest_schedule schedule, prepare_t prepare) :
+		bot(bot), channel_id(channel_id), prepare(std::move(prepare)), schedule(std::move(schedule))
+		{ timer = bot.start_timer([this](dpp::timer) { tick(); }, tick_seconds); }
+	digest_poster(const digest_poster&) = delete;
+	digest_poster& operator=(const digest_poster&) = delete;
+	~digest_poster()
+		{ bot.stop_timer(timer); }
+};
+
+#endif
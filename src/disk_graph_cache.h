@@ -0,0 +1,191 @@
+#ifndef DISK_GRAPH_CACHE_H
+#define DISK_GRAPH_CACHE_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "binary_io.h"
+#include "file_writer.h"
+#include "logger.h"
+#include "parse_logs.h"
+#include "session_store.h"
+
+namespace detail
+{
+	template<typename T>
+	[[nodiscard]] inline std::uint64_t fnv1a_value(const T& value, std::uint64_t hash) noexcept
+	{
+		return fnv1a(std::string_view(reinterpret_cast<const char*>(&value), sizeof(value)), hash);
+	}
+}
+
+// @param segment_hashes  content hash of each segment, so a segment is only hashed the first time
+// @return hash of `history` and `recent`, which is the same for the same sessions (e.g. after a restart), unlike published data's generation.
+//         graphs only depend on them (and the options) while no players are online
+[[nodiscard]] inline std::uint64_t sessions_fingerprint(const session_history& history, const log_data_t& recent,
+	detail::segment_cache<std::uint64_t>& segment_hashes)
+{
+	std::uint64_t hash = detail::fnv1a_basis;
+	for (const auto& segment : history.get_segments())
+		{ hash = detail::fnv1a_value(*segment_hashes.get(segment, [&segment]() { return segment->content_hash(); }), hash); }
+	for (const auto& [uuid, player_data] : recent)
+	{
+		hash = detail::fnv1a_value(uuid, hash);
+		for (const std::string& name : player_data.first)
+			{ hash = detail::fnv1a(name, detail::fnv1a_value(name.size(), hash)); }
+		for (const auto& [start, duration] : player_data.second.first)
+		{
+			hash = detail::fnv1a_value(start.time_since_epoch().count(), hash);
+			hash = detail::fnv1a_value(duration.count(), hash);
+		}
+	}
+	return hash;
+}
+
+// rendered graphs saved in a directory, so they are still cached after a restart (graph_cache only keeps them in memory)
+// a file is named by a hash of everything its graph depends on (see sessions_fingerprint), so outdated files are never found, and are
+// removed once they are the least recently used and the files take more than the size limit
+class disk_graph_cache
+{
+private:
+	struct file_t
+	{
+		std::uint64_t key;
+		std::uint64_t size;
+		std::uint64_t last_use;  // of use_counter
+	};
+
+	std::filesystem::path dir;
+	std::uint64_t max_bytes;
+	durable_file_writer& writer;  // of the files, so saving a graph doesn't wait for the disk
+	std::mutex mutex;
+	std::vector<file_t> files;
+	std::uint64_t total_bytes = 0;
+	std::uint64_t use_counter = 0;
+
+	[[nodiscard]] std::filesystem::path file_path(std::uint64_t key) const
+		{ return dir / std::format("{:016x}.graph", key); }
+
+	// remove the least recently used files until they fit in max_bytes, assumes mutex is locked
+	void evict()
+	{
+		if (total_bytes <= max_bytes)
+			{ return; }
+		std::ranges::sort(files, {}, &file_t::last_use);
+		auto it = files.begin();
+		for (; it != files.end() && total_bytes > max_bytes; it++)
+		{
+			std::error_code ec;
+			std::filesystem::remove(file_path(it->key), ec);
+			total_bytes -= it->size;
+		}
+		files.erase(files.begin(), it);
+	}
+
+public:
+	// bumped when graphs change without their options changing, so files of older versions are never used
+	static constexpr std::uint64_t format_version = 1;
+
+	// files already in `dir` are kept, oldest modified first in line to be removed
+	// @param max_bytes  total size of the files
+	// @param writer  must outlive the cache
+	disk_graph_cache(std::filesystem::path dir, std::uint64_t max_bytes, durable_file_writer& writer) : dir(std::move(dir)), max_bytes(max_bytes), writer(writer)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(this->dir, ec);
+		if (ec)
+		{
+			log_message(log_severity::error, std::format("Could not create graph cache directory {}: {}", this->dir.string(), ec.message()));
+			return;
+		}
+		std::vector<std::pair<std::filesystem::file_time_type, file_t>> found;
+		for (const auto& entry : std::filesystem::directory_iterator(this->dir, ec))
+		{
+			const std::string name = entry.path().filename().string();
+			std::uint64_t key;
+			// a temporary file of a write that didn't finish is removed
+			if (entry.path().extension() != ".graph" || name.size() != 16 + 6 || std::from_chars(name.data(), name.data() + 16, key, 16).ptr != name.data() + 16)
+			{
+				if (entry.path().extension() == ".tmp")
+					{ std::filesystem::remove(entry.path(), ec); }
+				continue;
+			}
+			const std::uint64_t size = entry.file_size(ec);
+			if (!ec)
+				{ found.emplace_back(entry.last_write_time(ec), file_t{ key, size, 0 }); }
+		}
+		std::ranges::sort(found, {}, &decltype(found)::value_type::first);
+		for (auto& [time, file] : found)
+		{
+			file.last_use = use_counter++;
+			total_bytes += file.size;
+			files.push_back(file);
+		}
+		evict();
+	}
+	disk_graph_cache(const disk_graph_cache&) = delete;
+	disk_graph_cache& operator=(const disk_graph_cache&) = delete;
+	// the files being written are added once they are
+	~disk_graph_cache()
+		{ writer.flush(); }
+
+	// @param key  hash of everything the graph depends on
+	// @return contents of the graph, or null if it isn't saved
+	[[nodiscard]] std::shared_ptr<const std::string> load(std::uint64_t key)
+	{
+		{
+			std::scoped_lock lock(mutex);
+			const auto it = std::ranges::find(files, key, &file_t::key);
+			if (it == files.end())
+				{ return nullptr; }
+			it->last_use = use_counter++;
+		}
+		const std::filesystem::path path = file_path(key);
+		std::ifstream fin(path, std::ios::binary);
+		std::string contents((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+		if (!fin || contents.empty())
+			{ return nullptr; }
+		// so the order it is removed in is kept after a restart
+		std::error_code ec;
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+		return std::make_shared<const std::string>(std::move(contents));
+	}
+
+	// save a graph in the background, replacing any with the same key. it is only found once it has been written
+	// @param key  hash of everything the graph depends on
+	void store(std::uint64_t key, std::string_view contents)
+	{
+		if (contents.size() > max_bytes)
+			{ return; }
+		const std::uint64_t size = contents.size();
+		writer.write(file_path(key), std::string(contents), [this, key, size](bool ok)
+		{
+			if (!ok)
+				{ return; }
+			std::scoped_lock lock(mutex);
+			if (const auto it = std::ranges::find(files, key, &file_t::key); it != files.end())
+			{
+				total_bytes -= it->size;
+				files.erase(it);
+			}
+			files.emplace_back(key, size, use_counter++);
+			total_bytes += size;
+			evict();
+		});
+	}
+};
+
+#endif
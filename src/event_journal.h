@@ -0,0 +1,350 @@
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "binary_io.h"
+#include "logger.h"
+#include "parse_logs.h"
+
+namespace detail
+{
+	inline constexpr std::string_view event_journal_magic = "QCV2JRNL";
+	// increment when the layout changes, or when what scan_lines finds in a file does (e.g. a fixed parsing bug), so old events aren't replayed
+	inline constexpr std::uint32_t event_journal_version = 4;
+	inline constexpr std::uint32_t event_journal_byte_order = 0x01020304;  // see snapshot_byte_order
+
+	struct event_journal_header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		std::uint32_t format;  // log_format of the lines the events were found in
+	};
+
+	// before each record
+	struct event_journal_record_header
+	{
+		std::uint64_t payload_size;
+		std::uint64_t payload_checksum;  // see fnv1a
+	};
+
+	// identifies the contents of a log file, like snapshot_coverage does
+	struct event_journal_key
+	{
+		std::string_view filename;
+		std::uint64_t size;
+		std::int64_t mtime;
+
+		[[nodiscard]] static event_journal_key of(const log_manifest_entry& file, const std::string& filename) noexcept
+			{ return { filename, file.size, file.mtime.time_since_epoch().count() }; }
+	};
+
+	inline bool read_event_journal_key(binary_reader& reader, event_journal_key& key) noexcept
+		{ return reader.read_short_string(key.filename) && reader.read_varint(key.size) && reader.read(key.mtime); }
+
+	// @return whether events of `type` have text
+	[[nodiscard]] constexpr bool event_has_text(line_event_type type) noexcept
+		{ return type == line_event_type::invalid_uuid || type == line_event_type::player_list || type == line_event_type::lag; }
+
+	// record payload: key, number of lines, names of the players in the file, then the events
+	// line numbers and timestamps are encoded as differences from the previous event, and players as indices into the names
+	inline void write_event_journal_record(binary_writer& writer, const event_journal_key& key, const file_scan_t& scan)
+	{
+		writer.write_short_string(key.filename);
+		writer.write_varint(key.size);
+		writer.write(key.mtime);
+		writer.write_varint(scan.num_lines);
+
+		std::map<std::string_view, std::uint64_t> name_ids;
+		std::vector<std::string_view> names;
+		for (const auto& [line, event] : scan.events)
+		{
+			if (!event.name.empty() && name_ids.emplace(event.name, names.size()).second)
+				{ names.push_back(event.name); }
+		}
+		writer.write_varint(names.size());
+		for (const std::string_view name : names)
+			{ writer.write_short_string(name); }
+
+		writer.write_varint(scan.events.size());
+		std::size_t prev_line = 0;
+		int prev_secs = 0;
+		for (const auto& [line, event] : scan.events)
+		{
+			writer.write(event.type);
+			writer.write_varint(line - prev_line);
+			writer.write_signed_varint(event.secs - prev_secs);
+			prev_line = line;
+			prev_secs = event.secs;
+			// 0 for no name
+			writer.write_varint(event.name.empty() ? 0 : name_ids[event.name] + 1);
+			if (event.type == line_event_type::uuid)
+				{ writer.write(event.uuid); }
+			else if (event_has_text(event.type))
+				{ writer.write_short_string(event.text); }
+		}
+	}
+
+	// @param payload  of a record, after its key has been read from `reader`
+	// @param out  views into the payload until copy_to_storage is called
+	// @return true on success
+	inline bool read_event_journal_events(binary_reader& reader, file_scan_t& out)
+	{
+		out.res = LIBDEFLATE_SUCCESS;
+		out.mapped = true;
+		out.events.clear();
+		std::uint64_t num_lines, num_names, num_events;
+		if (!reader.read_varint(num_lines) || !reader.read_varint(num_names) || num_names > reader.remaining())
+			{ return false; }
+		out.num_lines = num_lines;
+		std::vector<std::string_view> names(num_names);
+		for (auto& name : names)
+		{
+			if (!reader.read_short_string(name))
+				{ return false; }
+		}
+
+		if (!reader.read_varint(num_events) || num_events > reader.remaining())
+			{ return false; }
+		out.events.reserve(num_events);
+		std::size_t line = 0;
+		std::int64_t secs = 0;
+		for (std::uint64_t i = 0; i < num_events; i++)
+		{
+			line_event event{};
+			std::uint64_t line_delta, name_id;
+			std::int64_t secs_delta;
+			if (!reader.read(event.type) || event.type > line_event_type::lag || !reader.read_varint(line_delta) || !reader.read_signed_varint(secs_delta) ||
+				!reader.read_varint(name_id) || name_id > names.size())
+				{ return false; }
+			line += line_delta;
+			secs += secs_delta;
+			event.secs = static_cast<int>(secs);
+			if (name_id != 0)
+				{ event.name = names[name_id - 1]; }
+			if (event.type == line_event_type::uuid && !reader.read(event.uuid))
+				{ return false; }
+			if (event_has_text(event.type) && !reader.read_short_string(event.text))
+				{ return false; }
+			out.events.emplace_back(line, event);
+		}
+		return reader.ok() && reader.remaining() == 0;
+	}
+}
+
+// append-only file of the events found in archived log files (see detail::file_scan_t), so they can be replayed instead of
+// decompressing and scanning the files again, e.g. when the snapshot can't be used after an update or a config change
+// layout: header, then a record for each file that was scanned. a file that changed gets a new record, and the newest one is used
+// an index of the records by file is made when loading, so only the records of files that are parsed are decoded
+// use as the scan cache of parse_log_file_events. all functions must be called from the same thread
+class event_journal
+{
+private:
+	struct index_entry
+	{
+		std::uint64_t size;
+		std::int64_t mtime;
+		std::size_t offset, length;  // of the payload in data
+	};
+
+	std::filesystem::path path;  // empty if disabled
+	log_format format;
+	std::string data;  // contents of the file
+	std::map<std::string, index_entry, std::less<>> index;  // by filename
+	std::ofstream fout;  // opened on the first append
+
+	// @return payload of the record for `file`, or empty optional if there is none for its current contents
+	[[nodiscard]] std::optional<std::string_view> find_payload(const log_manifest_entry& file) const
+	{
+		if (path.empty() || file.is_latest)
+			{ return {}; }
+		const auto it = index.find(file.path.filename().string());
+		if (it == index.end() || it->second.size != file.size || it->second.mtime != file.mtime.time_since_epoch().count())
+			{ return {}; }
+		return std::string_view(data).substr(it->second.offset, it->second.length);
+	}
+
+	// add the records in data after `offset` to the index
+	// @return offset after the last valid record
+	std::size_t index_records(std::size_t offset)
+	{
+		const std::string_view view = data;
+		while (offset + sizeof(detail::event_journal_record_header) <= view.size())
+		{
+			detail::event_journal_record_header header;
+			std::memcpy(&header, view.data() + offset, sizeof(header));
+			const std::size_t payload_offset = offset + sizeof(header);
+			if (header.payload_size > view.size() - payload_offset)
+				{ break; }
+			const std::string_view payload = view.substr(payload_offset, header.payload_size);
+			detail::binary_reader reader(payload);
+			detail::event_journal_key key;
+			if (detail::fnv1a(payload) != header.payload_checksum || !detail::read_event_journal_key(reader, key))
+				{ break; }
+			const std::size_t key_size = payload.size() - reader.remaining();
+			index.insert_or_assign(std::string(key.filename), index_entry{ key.size, key.mtime, payload_offset + key_size, payload.size() - key_size });
+			offset = payload_offset + payload.size();
+		}
+		return offset;
+	}
+
+	// make `path` an empty journal
+	void reset()
+	{
+		data.clear();
+		index.clear();
+		detail::event_journal_header header{};
+		std::memcpy(header.magic, detail::event_journal_magic.data(), sizeof(header.magic));
+		header.version = detail::event_journal_version;
+		header.byte_order = detail::event_journal_byte_order;
+		header.format = static_cast<std::uint32_t>(format);
+		data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(data.data(), data.size());
+		if (!out)
+		{
+			log_message(log_severity::error, std::format("Could not create event journal {}, disabling it", path.string()));
+			path.clear();
+		}
+	}
+
+public:
+	// load the journal at `path`, creating it if it doesn't exist. if it is invalid, a warning will be printed and it will be started over
+	// @param path  empty to disable the journal, in which case it contains nothing
+	// @param format  of the log files parsed with it. a journal made for another format is started over
+	event_journal(std::filesystem::path file_path, log_format format) : path(std::move(file_path)), format(format)
+	{
+		if (path.empty())
+			{ return; }
+		std::error_code ec;
+		if (!std::filesystem::exists(path, ec))
+		{
+			reset();
+			return;
+		}
+
+		{
+			std::ifstream fin(path, std::ios::binary);
+			data.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+			if (!fin && !fin.eof())
+			{
+				log_message(log_severity::warning, std::format("Could not read event journal {}, starting it over", path.string()));
+				reset();
+				return;
+			}
+		}
+		detail::event_journal_header header;
+		if (data.size() < sizeof(header))
+		{
+			log_message(log_severity::warning, std::format("Event journal {} is truncated, starting it over", path.string()));
+			reset();
+			return;
+		}
+		std::memcpy(&header, data.data(), sizeof(header));
+		if (std::string_view(header.magic, sizeof(header.magic)) != detail::event_journal_magic || header.byte_order != detail::event_journal_byte_order)
+		{
+			log_message(log_severity::warning, std::format("{} is not an event journal for this platform, starting it over", path.string()));
+			reset();
+			return;
+		}
+		if (header.version != detail::event_journal_version)
+		{
+			log_message(log_severity::info, std::format("Event journal {} has version {} (expected {}), starting it over", path.string(), header.version,
+				detail::event_journal_version));
+			reset();
+			return;
+		}
+		if (header.format != static_cast<std::uint32_t>(format))
+		{
+			const std::string_view old_format = (header.format < log_format_names.size()) ? log_format_names[header.format] : "unknown";
+			log_message(log_severity::info, std::format("Event journal {} was made for {} logs, starting it over", path.string(), old_format));
+			reset();
+			return;
+		}
+
+		// a record that wasn't completely written (e.g. a crash while appending) is cut off, so new records follow valid ones
+		const std::size_t valid_size = index_records(sizeof(header));
+		if (valid_size != data.size())
+		{
+			log_message(log_severity::warning, std::format("Event journal {} has a corrupted record, discarding it and the ones after it", path.string()));
+			data.resize(valid_size);
+			std::filesystem::resize_file(path, valid_size, ec);
+			if (ec)
+			{
+				log_message(log_severity::warning, std::format("Could not truncate event journal {}: {}, starting it over", path.string(), ec.message()));
+				reset();
+			}
+		}
+	}
+	event_journal(const event_journal&) = delete;
+	event_journal& operator=(const event_journal&) = delete;
+
+	// @return number of files with records
+	[[nodiscard]] std::size_t size() const noexcept
+		{ return index.size(); }
+
+	// @return whether there are events for the current contents of `file`
+	[[nodiscard]] bool contains(const log_manifest_entry& file) const
+		{ return find_payload(file).has_value(); }
+
+	// @param out  receives the events of `file`
+	// @return true on success, false if there are none for its current contents
+	bool find(const log_manifest_entry& file, detail::file_scan_t& out) const
+	{
+		const auto payload = find_payload(file);
+		if (!payload)
+			{ return false; }
+		detail::binary_reader reader(payload.value());
+		if (!detail::read_event_journal_events(reader, out))
+		{
+			log_message(log_severity::warning, std::format("Event journal record of {} is malformed, reading the file instead", file.path.filename().string()));
+			return false;
+		}
+		detail::copy_to_storage(out);
+		return true;
+	}
+
+	// append the events of `file`. latest.log isn't added, since it is still being written
+	// @param scan  of the file, which was successful
+	void add(const log_manifest_entry& file, const detail::file_scan_t& scan)
+	{
+		if (path.empty() || file.is_latest)
+			{ return; }
+		const std::string filename = file.path.filename().string();
+		const std::size_t record_offset = data.size();
+		data.resize(record_offset + sizeof(detail::event_journal_record_header));
+		detail::binary_writer writer(data);
+		detail::write_event_journal_record(writer, detail::event_journal_key::of(file, filename), scan);
+		const std::string_view payload = std::string_view(data).substr(record_offset + sizeof(detail::event_journal_record_header));
+		const detail::event_journal_record_header header{ payload.size(), detail::fnv1a(payload) };
+		std::memcpy(data.data() + record_offset, &header, sizeof(header));
+		index_records(record_offset);
+
+		if (!fout.is_open())
+			{ fout.open(path, std::ios::binary | std::ios::app); }
+		fout.write(data.data() + record_offset, data.size() - record_offset);
+		fout.flush();
+		if (!fout)
+		{
+			log_message(log_severity::error, std::format("Could not append to event journal {}, disabling it", path.string()));
+			path.clear();
+		}
+	}
+};
+
+#endif
@@ -5,34 +5,278 @@
 
 #include "file_watcher.h"
 
+#include <stdlib.h>
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+
+// polling for files on network filesystems, used by both backends below
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#else
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
+
+#ifdef __APPLE__
+#define FILE_WATCHER_MTIME(st) ((st).st_mtimespec)
+#else
+#define FILE_WATCHER_MTIME(st) ((st).st_mtim)
+#endif
+
+// @return true if `dir` is on a filesystem where changes made by other hosts have no inotify or kqueue events (e.g. nfs or smb)
+static bool needs_stat_poll(const char* dir)
+{
+	struct statfs st;
+	if (statfs(dir, &st) == -1)
+		{ return false; }  // the native watch fails too, and reports it
+#ifdef __linux__
+	// from linux/magic.h, which isn't always installed
+	static const uint32_t remote_magics[] = {
+		0x6969,  // nfs
+		0x517b,  // smb
+		0xff534d42,  // cifs
+		0xfe534d42,  // smb2
+		0x01021997,  // 9p (e.g. windows drives in wsl2)
+		0x5346414f,  // afs
+		0x00c36400,  // ceph
+	};
+	for (size_t i = 0; i < sizeof(remote_magics) / sizeof(remote_magics[0]); i++)
+	{
+		if ((uint32_t)st.f_type == remote_magics[i])
+			{ return true; }
+	}
+#else
+	static const char* const remote_types[] = { "nfs", "smbfs", "afpfs", "webdav" };
+	for (size_t i = 0; i < sizeof(remote_types) / sizeof(remote_types[0]); i++)
+	{
+		if (strcmp(st.f_fstypename, remote_types[i]) == 0)
+			{ return true; }
+	}
+#endif
+	return false;
+}
+
+static int64_t monotonic_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// @param st  set if it exists
+// @return false if it doesn't exist, or it can't be known (which is treated the same)
+static bool stat_polled_file(const char* path, struct stat* st)
+{
+	// opened instead of only stat-ed, since nfs only fetches attributes again on open (close-to-open consistency). otherwise sizes that
+	// were cached up to a minute ago are seen
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		if (errno != ENOENT)
+			{ perror("open() error"); }
+		return false;
+	}
+	bool ret = fstat(fd, st) == 0;
+	if (!ret)
+		{ perror("fstat() error"); }
+	close(fd);
+	return ret;
+}
+
+static void record_stat(struct file_watcher_stat_poll* poll, const struct stat* st)
+{
+	poll->dev = (uint64_t)st->st_dev;
+	poll->ino = (uint64_t)st->st_ino;
+	poll->size = (int64_t)st->st_size;
+	poll->mtime_ns = (int64_t)FILE_WATCHER_MTIME(*st).tv_sec * 1000000000 + FILE_WATCHER_MTIME(*st).tv_nsec;
+}
+
+// start polling the file at `path`, with what it is now as the state changes are from
+static void stat_poll_start(struct file_watcher_stat_poll* poll, const char* path)
+{
+	struct stat st;
+	poll->enabled = true;
+	poll->exists = stat_polled_file(path, &st);
+	if (poll->exists)
+		{ record_stat(poll, &st); }
+	poll->interval_ms = FILE_WATCHER_POLL_MIN_MS;
+	poll->next_ms = monotonic_ms() + poll->interval_ms;
+}
+
+// find the name in the directory of `path` of the file that was there before (it is gone from `path`)
+// @return null-terminated name (must be freed with free()), or NULL if it isn't in the directory anymore
+static char* find_moved_to(const struct file_watcher_stat_poll* poll, const char* path)
+{
+	// path is always dir + "/" + filename (see file_watcher_add)
+	const char* filename = strrchr(path, '/');
+	char* dir = strndup(path, (size_t)(filename - path));
+	if (dir == NULL)
+	{
+		perror("strndup() error");
+		return NULL;
+	}
+	filename++;
+	DIR* dir_stream = opendir(dir);
+	if (dir_stream == NULL)
+	{
+		perror("opendir() error");
+		free(dir);
+		return NULL;
+	}
+	char* ret = NULL;
+	struct dirent* entry;
+	while (ret == NULL && (entry = readdir(dir_stream)) != NULL)
+	{
+		if ((uint64_t)entry->d_ino != poll->ino || strcmp(entry->d_name, filename) == 0)
+			{ continue; }
+		// d_ino isn't always the inode number stat gives (e.g. of mount points), so it is confirmed
+		struct stat st;
+		if (fstatat(dirfd(dir_stream), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && (uint64_t)st.st_dev == poll->dev && (uint64_t)st.st_ino == poll->ino)
+		{
+			ret = strdup(entry->d_name);
+			if (ret == NULL)
+				{ perror("strdup() error"); }
+		}
+	}
+	closedir(dir_stream);
+	free(dir);
+	return ret;
+}
+
+// check a polled file for changes since the last check, and schedule the next one
+// @return the change (state 1), or state 2 if there was none
+static struct file_watcher_result stat_poll_check(struct file_watcher_stat_poll* poll, const char* path, uintptr_t tag, int64_t now_ms)
+{
+	struct stat st;
+	bool exists = stat_polled_file(path, &st);
+	struct file_watcher_result ret = { .state = 2 };
+	bool replaced = false;
+	if (poll->exists && (!exists || (uint64_t)st.st_dev != poll->dev || (uint64_t)st.st_ino != poll->ino))
+	{
+		// the file that was there is gone. a new one (if there is one) is reported by the next check, which is right after this one
+		char* moved_to = find_moved_to(poll, path);
+		if (moved_to != NULL)
+		{
+			ret = (struct file_watcher_result){ .state = 1, .event_create = false, .event_create_moved = false, .event_modify = false, .event_lost = false,
+				.moved_to = moved_to, .moved_to_size = strlen(moved_to), .tag = tag, .file_size = -1 };
+		}
+		else
+		{
+			// it was deleted, or moved and then deleted or moved elsewhere (e.g. compressed) before it was checked
+			ret = (struct file_watcher_result){ .state = 1, .event_create = false, .event_create_moved = false, .event_modify = true, .event_lost = true,
+				.moved_to = NULL, .moved_to_size = 0, .tag = tag, .file_size = -1 };
+		}
+		poll->exists = false;
+		replaced = exists;
+	}
+	else if (!poll->exists && exists)
+	{
+		// it may have been created or moved there, which can't be told apart. both are read from the start
+		ret = (struct file_watcher_result){ .state = 1, .event_create = true, .event_create_moved = false, .event_modify = true, .event_lost = false,
+			.moved_to = NULL, .moved_to_size = 0, .tag = tag, .file_size = (int64_t)st.st_size };
+		poll->exists = true;
+		record_stat(poll, &st);
+	}
+	else if (exists)
+	{
+		int64_t prev_size = poll->size, prev_mtime_ns = poll->mtime_ns;
+		record_stat(poll, &st);
+		if (poll->size != prev_size || poll->mtime_ns != prev_mtime_ns)
+		{
+			ret = (struct file_watcher_result){ .state = 1, .event_create = false, .event_create_moved = false, .event_modify = true, .event_lost = false,
+				.moved_to = NULL, .moved_to_size = 0, .tag = tag, .file_size = poll->size };
+		}
+	}
+
+	// checked often while it changes, and less often the longer it doesn't
+	if (ret.state == 1)
+		{ poll->interval_ms = FILE_WATCHER_POLL_MIN_MS; }
+	else
+		{ poll->interval_ms = (poll->interval_ms * 2 < FILE_WATCHER_POLL_MAX_MS) ? poll->interval_ms * 2 : FILE_WATCHER_POLL_MAX_MS; }
+	poll->next_ms = replaced ? now_ms : now_ms + poll->interval_ms;
+	return ret;
+}
+
+// check the polled files that are due
+// @return the first change (state 1), or state 0 if there was none
+static struct file_watcher_result stat_poll_due(struct file_watcher_ctx* ctx)
+{
+	int64_t now_ms = monotonic_ms();
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		struct file_watcher_watch* watch = &ctx->watches[i];
+		if (!watch->stat_poll.enabled || watch->stat_poll.next_ms > now_ms)
+			{ continue; }
+		struct file_watcher_result ret = stat_poll_check(&watch->stat_poll, watch->path, watch->tag, now_ms);
+		if (ret.state == 1)
+			{ return ret; }
+	}
+	struct file_watcher_result ret = { .state = 0 };
+	return ret;
+}
+
+// @param timeout_ms  as in file_watcher_wait
+// @return timeout_ms, or the time until the next polled file is due if that is sooner
+static int stat_poll_timeout(const struct file_watcher_ctx* ctx, int timeout_ms)
+{
+	int64_t now_ms = monotonic_ms();
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		const struct file_watcher_stat_poll* poll = &ctx->watches[i].stat_poll;
+		if (!poll->enabled)
+			{ continue; }
+		// at most the max interval, so it fits in an int
+		int until_ms = (poll->next_ms > now_ms) ? (int)(poll->next_ms - now_ms) : 0;
+		if (timeout_ms == -1 || until_ms < timeout_ms)
+			{ timeout_ms = until_ms; }
+	}
+	return timeout_ms;
+}
+
+#endif
+
 #ifdef __linux__
 
 #include <errno.h>
 #include <limits.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-static const size_t file_watcher_buf_size = sizeof(struct inotify_event) + NAME_MAX + 1;
+static const size_t file_watcher_buf_size = FILE_WATCHER_BUF_SIZE;
+_Static_assert(FILE_WATCHER_BUF_SIZE >= sizeof(struct inotify_event) + NAME_MAX + 1, "FILE_WATCHER_BUF_SIZE is too small to hold an inotify event");
+_Static_assert(FILE_WATCHER_BUF_SIZE % _Alignof(struct inotify_event) == 0, "FILE_WATCHER_BUF_SIZE must be a multiple of inotify_event alignment");
+
+// stop watching the file that watch->file_watch_desc is of (e.g. it was moved away, so its modifies aren't of the watched file anymore)
+// @param keep  watch descriptor that isn't removed even if it's the same (a file that is watched again gets the same one)
+static void disarm_file_watch(struct file_watcher_ctx* ctx, struct file_watcher_watch* watch, int keep)
+{
+	// fails if the file was deleted, since its watch was already removed then
+	if (watch->file_watch_desc != -1 && watch->file_watch_desc != keep)
+		{ inotify_rm_watch(ctx->inotify_fd, watch->file_watch_desc); }
+	watch->file_watch_desc = -1;
+}
 
 struct file_watcher_ctx file_watcher_init(const char* dir, const char* filename, size_t filename_size, void* /* unused */)
 {
-	int inotify_fd = inotify_init();
+	// non-blocking so file_watcher_poll can read without waiting (file_watcher_wait does the waiting)
+	int inotify_fd = inotify_init1(IN_NONBLOCK);
 	if (inotify_fd == -1)
 	{
-		perror("inotify_init() error");
-		struct file_watcher_ctx ret = { .has_value = 0 };
-		return ret;
-	}
-
-	int watch_desc = inotify_add_watch(inotify_fd, dir, IN_CREATE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO);
-	if (watch_desc == -1)
-	{
-		perror("inotify_add_watch() error");
+		perror("inotify_init1() error");
 		struct file_watcher_ctx ret = { .has_value = 0 };
 		return ret;
 	}
@@ -53,29 +297,107 @@ struct file_watcher_ctx file_watcher_init(const char* dir, const char* filename,
 		return ret;
 	}
 
-	if (filename_size == -1)
-		{ filename_size = strlen(filename); }
-	
-	char* filename_ = strndup(filename, filename_size);
-	if (filename_ == NULL)
+	int wakeup_fd = eventfd(0, EFD_NONBLOCK);
+	if (wakeup_fd == -1)
 	{
-		perror("strndup() error");  // for C23 strndup, setting errno is not required, but it is in POSIX
+		perror("eventfd() error");
+		struct file_watcher_ctx ret = { .has_value = 0 };
+		return ret;
+	}
+
+	struct epoll_event wakeup_event = { .events = EPOLLIN, .data = { .fd = wakeup_fd } };
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &wakeup_event) == -1)
+	{
+		perror("epoll_ctl() error");
 		struct file_watcher_ctx ret = { .has_value = 0 };
 		return ret;
 	}
-	unsigned char* read_data = malloc(file_watcher_buf_size);
+
+	unsigned char* read_data = aligned_alloc(_Alignof(struct inotify_event), file_watcher_buf_size);
 	if (read_data == NULL)
 	{
-		perror("malloc() error");  // malloc setting errno is not required in standard C, but is in POSIX
+		perror("aligned_alloc() error");  // setting errno is not required in standard C, but is in POSIX
 		struct file_watcher_ctx ret = { .has_value = 0 };
 		return ret;
 	}
-	struct file_watcher_ctx ret = { .has_value = 1, .inotify_fd = inotify_fd, .epoll_fd = epoll_fd, .cookie = 0,
-		.filename = filename_, .filename_size = filename_size,
+	struct file_watcher_ctx ret = { .has_value = 1, .watches = NULL, .num_watches = 0,
+		.inotify_fd = inotify_fd, .epoll_fd = epoll_fd, .wakeup_fd = wakeup_fd,
 		.read_data = read_data, .read_data_consumed_size = 0, .read_data_size = 0 };
+	if (!file_watcher_add(&ret, dir, filename, filename_size, 0))
+	{
+		file_watcher_cleanup(&ret);
+		ret.has_value = 0;
+	}
 	return ret;
 }
 
+// watch the file at watch->path for modifies, replacing the watch of the file it was before (if it was replaced)
+// nothing is watched if it doesn't exist, it is watched again once it is created
+static void arm_file_watch(struct file_watcher_ctx* ctx, struct file_watcher_watch* watch)
+{
+	int file_watch_desc = inotify_add_watch(ctx->inotify_fd, watch->path, IN_MODIFY);
+	if (file_watch_desc == -1 && errno != ENOENT)
+		{ perror("inotify_add_watch() error"); }
+	disarm_file_watch(ctx, watch, file_watch_desc);
+	watch->file_watch_desc = file_watch_desc;
+}
+
+bool file_watcher_add(struct file_watcher_ctx* ctx, const char* dir, const char* filename, size_t filename_size, uintptr_t tag)
+{
+	if (!ctx->has_value)
+		{ return false; }
+
+	// changes made by other hosts have no events, so the file is polled instead and nothing is watched
+	bool polled = needs_stat_poll(dir);
+	// a directory that is already watched gets the same watch descriptor
+	// only name events, so writes to other files in the directory (e.g. archives being compressed) never wake up the process
+	int watch_desc = polled ? -1 : inotify_add_watch(ctx->inotify_fd, dir, IN_CREATE | IN_MOVED_FROM | IN_MOVED_TO);
+	if (!polled && watch_desc == -1)
+	{
+		perror("inotify_add_watch() error");
+		return false;
+	}
+
+	if (filename_size == -1)
+		{ filename_size = strlen(filename); }
+
+	char* filename_ = strndup(filename, filename_size);
+	if (filename_ == NULL)
+	{
+		perror("strndup() error");  // for C23 strndup, setting errno is not required, but it is in POSIX
+		return false;
+	}
+	size_t dir_size = strlen(dir);
+	char* path = malloc(dir_size + 1 + filename_size + 1);
+	if (path == NULL)
+	{
+		perror("malloc() error");
+		free(filename_);
+		return false;
+	}
+	memcpy(path, dir, dir_size);
+	path[dir_size] = '/';
+	memcpy(path + dir_size + 1, filename_, filename_size + 1);
+	struct file_watcher_watch* watches = realloc(ctx->watches, (ctx->num_watches + 1) * sizeof(struct file_watcher_watch));
+	if (watches == NULL)
+	{
+		perror("realloc() error");
+		free(filename_);
+		free(path);
+		return false;
+	}
+	struct file_watcher_watch watch = { .tag = tag, .stat_poll = { .enabled = false }, .watch_desc = watch_desc, .file_watch_desc = -1, .path = path,
+		.cookie = 0, .lost_events = false, .filename = filename_, .filename_size = filename_size };
+	if (polled)
+		{ stat_poll_start(&watch.stat_poll, path); }
+	else
+		{ arm_file_watch(ctx, &watch); }
+	watches[ctx->num_watches] = watch;
+	ctx->watches = watches;
+	ctx->num_watches++;
+	return true;
+}
+
 // expects previous read_data to have been fully consumed
 // ctx->read_data, read_data_consumed_size, read_data_size will be updated only if data was available to read
 // @return -1 on error, 0 if nothing was available to read, 1 if data was read successfully (subset of file_watcher_result.state)
@@ -84,29 +406,19 @@ static char read_more_events(struct file_watcher_ctx* ctx)
 	// no ctx->has_value check because this isn't public and
 	// everything that calls this should have checked already
 
-	struct epoll_event epoll_event_out;
-	int res = epoll_wait(ctx->epoll_fd, &epoll_event_out, 1, 0);
-	if (res == -1)
+	ssize_t read_amt = read(ctx->inotify_fd, ctx->read_data, file_watcher_buf_size);
+	if (read_amt == -1)
 	{
-		perror("epoll_wait() error");
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{ return 0; }
+		perror("inotify read() error");
 		return -1;
 	}
-	if (res > 0)
-	{
-		// overwrite previous contenst of ctx->read_data
-		// this isn't c++, no need for destructors or anything
-		ctx->read_data_consumed_size = 0;
-		// alternatively use epoll_event_out.data.fd
-		ssize_t read_amt = read(ctx->inotify_fd, ctx->read_data, file_watcher_buf_size);
-		if (read_amt == -1)
-		{
-			perror("inotify read() error");
-			return -1;
-		}
-		ctx->read_data_size = read_amt;
-		return 1;
-	}
-	return 0;
+	// overwrite previous contenst of ctx->read_data
+	// this isn't c++, no need for destructors or anything
+	ctx->read_data_consumed_size = 0;
+	ctx->read_data_size = read_amt;
+	return 1;
 }
 
 // does not validate. use with caution
@@ -126,6 +438,22 @@ struct file_watcher_result file_watcher_poll(struct file_watcher_ctx* ctx)
 		return ret;
 	}
 
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		struct file_watcher_watch* watch = &ctx->watches[i];
+		if (watch->lost_events)
+		{
+			watch->lost_events = false;
+			struct file_watcher_result ret = { .state = 1, .event_create = false, .event_create_moved = false, .event_modify = true, .event_lost = true,
+				.moved_to = NULL, .moved_to_size = 0, .tag = watch->tag, .file_size = -1 };
+			return ret;
+		}
+	}
+
+	struct file_watcher_result polled = stat_poll_due(ctx);
+	if (polled.state != 0)
+		{ return polled; }
+
 	if (ctx->read_data == NULL || ctx->read_data_consumed_size >= ctx->read_data_size)
 	{
 		char read_res = read_more_events(ctx);
@@ -138,64 +466,625 @@ struct file_watcher_result file_watcher_poll(struct file_watcher_ctx* ctx)
 
 	struct inotify_event* event = get_next_event(ctx);
 
-	if ((event->mask & IN_MOVED_TO) && ctx->cookie != 0 && ctx->cookie == event->cookie)
+	// not for any watch (wd is -1). every file is reported as having lost events, and a move that was started can't be finished
+	// the file may have been replaced, so it is watched again
+	if (event->mask & IN_Q_OVERFLOW)
+	{
+		for (size_t i = 0; i < ctx->num_watches; i++)
+		{
+			if (ctx->watches[i].stat_poll.enabled)
+				{ continue; }
+			ctx->watches[i].lost_events = true;
+			ctx->watches[i].cookie = 0;
+			arm_file_watch(ctx, &ctx->watches[i]);
+		}
+		struct file_watcher_result ret = { .state = 2 };
+		return ret;
+	}
+
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		struct file_watcher_watch* watch = &ctx->watches[i];
+		if (event->wd != watch->file_watch_desc)
+			{ continue; }
+		// the file was deleted (or the watch removed), its watch descriptor may be reused
+		if (event->mask & IN_IGNORED)
+		{
+			watch->file_watch_desc = -1;
+			struct file_watcher_result ret = { .state = 2 };
+			return ret;
+		}
+		struct file_watcher_result ret = { .state = 1, .event_create = false, .event_create_moved = false, .event_modify = true,
+			.moved_to = NULL, .moved_to_size = 0, .tag = watch->tag, .file_size = -1 };
+		return ret;
+	}
+
+	for (size_t i = 0; i < ctx->num_watches; i++)
 	{
-		ctx->cookie = 0;
-		char* new_filename = strndup(event->name, event->len);
-		if (new_filename == NULL)
+		struct file_watcher_watch* watch = &ctx->watches[i];
+		if (event->wd != watch->watch_desc)
+			{ continue; }
+
+		if ((event->mask & IN_MOVED_TO) && watch->cookie != 0 && watch->cookie == event->cookie)
+		{
+			watch->cookie = 0;
+			char* new_filename = strndup(event->name, event->len);
+			if (new_filename == NULL)
+			{
+				perror("strndup() error");
+				struct file_watcher_result ret = { .state = -1 };
+				return ret;
+			}
+			size_t new_filename_size = strlen(new_filename);
+			struct file_watcher_result ret = { .state = 1, .event_create = false, .event_modify = false,
+				.moved_to = new_filename, .moved_to_size = new_filename_size, .tag = watch->tag, .file_size = -1 };
+			return ret;
+		}
+
+		// note: event->len does not give the exact size of event->name, only an upper bound
+		bool strs_eq = (event->len > watch->filename_size &&
+				strncmp(event->name, watch->filename, watch->filename_size) == 0 && event->name[watch->filename_size] == '\0');
+
+		if (!strs_eq)
+			{ continue; }
+		if (event->mask & IN_MOVED_FROM)
+		{
+			watch->cookie = event->cookie;
+			// its modifies aren't of the watched file anymore
+			disarm_file_watch(ctx, watch, -1);
+			struct file_watcher_result ret = { .state = 2 };
+			return ret;
+		}
+		// same file but different event
+		watch->cookie = 0;
+
+		bool created = event->mask & IN_CREATE;
+		bool created_moved = event->mask & IN_MOVED_TO;
+
+		if (!created && !created_moved)
 		{
-			perror("strndup() error");
-			struct file_watcher_result ret = { .state = -1 };
+			struct file_watcher_result ret = { .state = 2 };
 			return ret;
 		}
-		size_t new_filename_size = strlen(new_filename);
-		struct file_watcher_result ret = { .state = 1, .event_create = false, .event_modify = false,
-			.moved_to = new_filename, .moved_to_size = new_filename_size };
+
+		// anything written before the file was watched has no modify event, so a create is also reported as a modify
+		arm_file_watch(ctx, watch);
+		struct file_watcher_result ret = { .state = 1, .event_create = created, .event_create_moved = created_moved, .event_modify = true,
+			.moved_to = NULL, .moved_to_size = 0, .tag = watch->tag, .file_size = -1 };
 		return ret;
 	}
 
-	// note: event->len does not give the exact size of event->name, only an upper bound
-	bool strs_eq = (event->len > ctx->filename_size &&
-			strncmp(event->name, ctx->filename, ctx->filename_size) == 0);
+	// not for any watched file
+	struct file_watcher_result ret = { .state = 2 };
+	return ret;
+}
 
-	if (!strs_eq)
+char file_watcher_wait(struct file_watcher_ctx* ctx, int timeout_ms)
+{
+	if (!ctx->has_value)
+		{ return -1; }
+
+	// events from the previous read haven't all been consumed
+	if (ctx->read_data_consumed_size < ctx->read_data_size)
+		{ return 1; }
+
+	// woken up when a polled file is due, as if it had events
+	int wait_ms = stat_poll_timeout(ctx, timeout_ms);
+	struct epoll_event epoll_events_out[2];
+	int res = epoll_wait(ctx->epoll_fd, epoll_events_out, 2, wait_ms);
+	if (res == -1)
 	{
-		struct file_watcher_result ret = { .state = 2 };
+		if (errno == EINTR)
+			{ return 0; }
+		perror("epoll_wait() error");
+		return -1;
+	}
+
+	bool ready = false, woken = false;
+	for (int i = 0; i < res; i++)
+	{
+		if (epoll_events_out[i].data.fd == ctx->wakeup_fd)
+			{ woken = true; }
+		else
+			{ ready = true; }
+	}
+	if (woken)
+	{
+		// reset the counter so the next wait blocks again
+		// inotify events (if any) are left for the next call since epoll is level-triggered
+		uint64_t count;
+		if (read(ctx->wakeup_fd, &count, sizeof(count)) == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			perror("eventfd read() error");
+			return -1;
+		}
+		return 2;
+	}
+	return (ready || wait_ms != timeout_ms) ? 1 : 0;
+}
+
+bool file_watcher_wakeup(struct file_watcher_ctx* ctx)
+{
+	if (!ctx->has_value)
+		{ return false; }
+
+	uint64_t count = 1;
+	if (write(ctx->wakeup_fd, &count, sizeof(count)) == -1)
+	{
+		perror("eventfd write() error");
+		return false;
+	}
+	return true;
+}
+
+file_watcher_native_handle_t file_watcher_native_handle(const struct file_watcher_ctx* ctx)
+{
+	return ctx->inotify_fd;
+}
+
+bool file_watcher_cleanup(struct file_watcher_ctx* ctx)
+{
+	if (!ctx->has_value)
+		{ return false; }
+
+	free(ctx->read_data);
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		free(ctx->watches[i].filename);
+		free(ctx->watches[i].path);
+	}
+	free(ctx->watches);
+	bool b1 = close(ctx->epoll_fd) != -1;
+	bool b2 = close(ctx->inotify_fd) != -1;
+	bool b3 = close(ctx->wakeup_fd) != -1;
+	return (b1 && b2 && b3);
+}
+
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/event.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __FreeBSD__
+#include <sys/user.h>
+#endif
+
+// events read at once. kqueue merges events of the same file until they are read, so there are at most two per watch waiting
+static const size_t file_watcher_max_events = FILE_WATCHER_BUF_SIZE / sizeof(struct kevent);
+_Static_assert(FILE_WATCHER_BUF_SIZE >= sizeof(struct kevent), "FILE_WATCHER_BUF_SIZE is too small to hold a kevent");
+
+#ifdef O_EVTONLY
+// only for events, so watching a file doesn't stop its volume from being unmounted
+static const int file_watcher_open_flags = O_EVTONLY | O_CLOEXEC;
+#else
+static const int file_watcher_open_flags = O_RDONLY | O_CLOEXEC;
+#endif
+
+// @return true if vnode events `fflags` of `fd` are now read from the kqueue
+static bool watch_fd(int kqueue_fd, int fd, unsigned int fflags)
+{
+	struct kevent change;
+	EV_SET(&change, fd, EVFILT_VNODE, EV_ADD | EV_CLEAR, fflags, 0, NULL);
+	if (kevent(kqueue_fd, &change, 1, NULL, 0, NULL) == -1)
+	{
+		perror("kevent() error");
+		return false;
+	}
+	return true;
+}
+
+// open the file at watch->path and watch it, if it exists (closing it removes its events from the kqueue)
+static void open_file(struct file_watcher_ctx* ctx, struct file_watcher_watch* watch)
+{
+	int fd = open(watch->path, file_watcher_open_flags);
+	if (fd == -1)
+	{
+		if (errno != ENOENT)
+			{ perror("open() error"); }
+		return;
+	}
+	if (!watch_fd(ctx->kqueue_fd, fd, NOTE_WRITE | NOTE_EXTEND | NOTE_RENAME | NOTE_DELETE))
+	{
+		close(fd);
+		return;
+	}
+	watch->file_fd = fd;
+}
+
+// @param buf  receives the null-terminated path `fd` is at now, PATH_MAX bytes
+// @return false if it can't be known
+static bool get_fd_path(int fd, char* buf)
+{
+#if defined(F_GETPATH)
+	return fcntl(fd, F_GETPATH, buf) != -1;
+#elif defined(F_KINFO)
+	struct kinfo_file info;
+	info.kf_structsize = sizeof(info);
+	if (fcntl(fd, F_KINFO, &info) == -1 || info.kf_path[0] == '\0')
+		{ return false; }
+	memcpy(buf, info.kf_path, PATH_MAX);
+	return true;
+#else
+	(void)fd;
+	(void)buf;
+	return false;
+#endif
+}
+
+struct file_watcher_ctx file_watcher_init(const char* dir, const char* filename, size_t filename_size, void* /* unused */)
+{
+	int kqueue_fd = kqueue();
+	if (kqueue_fd == -1)
+	{
+		perror("kqueue() error");
+		struct file_watcher_ctx ret = { .has_value = 0 };
 		return ret;
 	}
-	if (event->mask & IN_MOVED_FROM)
+
+	// non-blocking, so file_watcher_wakeup never blocks on a full pipe and file_watcher_wait can empty it
+	int wakeup_fds[2];
+	if (pipe(wakeup_fds) == -1 || fcntl(wakeup_fds[0], F_SETFL, O_NONBLOCK) == -1 || fcntl(wakeup_fds[1], F_SETFL, O_NONBLOCK) == -1)
 	{
-		ctx->cookie = event->cookie;
-		struct file_watcher_result ret = { .state = 2 };
+		perror("pipe() error");
+		struct file_watcher_ctx ret = { .has_value = 0 };
 		return ret;
 	}
-	// same file but different event
-	ctx->cookie = 0;
 
-	bool created = event->mask & IN_CREATE;
-	bool created_moved = event->mask & IN_MOVED_TO;
-	bool modified = event->mask & IN_MODIFY;
-	
-	if (!created && !created_moved && !modified)
+	void* read_data = malloc(file_watcher_max_events * sizeof(struct kevent));
+	if (read_data == NULL)
 	{
-		struct file_watcher_result ret = { .state = 2 };
+		perror("malloc() error");
+		struct file_watcher_ctx ret = { .has_value = 0 };
 		return ret;
 	}
+	struct file_watcher_ctx ret = { .has_value = 1, .watches = NULL, .num_watches = 0,
+		.kqueue_fd = kqueue_fd, .wakeup_fds = { wakeup_fds[0], wakeup_fds[1] },
+		.read_data = read_data, .read_data_consumed_size = 0, .read_data_size = 0 };
+	if (!file_watcher_add(&ret, dir, filename, filename_size, 0))
+	{
+		file_watcher_cleanup(&ret);
+		ret.has_value = 0;
+	}
+	return ret;
+}
+
+bool file_watcher_add(struct file_watcher_ctx* ctx, const char* dir, const char* filename, size_t filename_size, uintptr_t tag)
+{
+	if (!ctx->has_value)
+		{ return false; }
+
+	// changes made by other hosts have no events, so the file is polled instead and nothing is watched
+	bool polled = needs_stat_poll(dir);
+	// its entries changing (a file being created, removed or renamed) is a write
+	int dir_fd = -1;
+	if (!polled)
+	{
+		dir_fd = open(dir, file_watcher_open_flags | O_DIRECTORY);
+		if (dir_fd == -1)
+		{
+			perror("open() error");
+			return false;
+		}
+		if (!watch_fd(ctx->kqueue_fd, dir_fd, NOTE_WRITE))
+		{
+			close(dir_fd);
+			return false;
+		}
+	}
+
+	if (filename_size == -1)
+		{ filename_size = strlen(filename); }
+
+	char* filename_ = strndup(filename, filename_size);
+	size_t dir_size = strlen(dir);
+	char* path = malloc(dir_size + 1 + filename_size + 1);
+	struct file_watcher_watch* watches = (filename_ == NULL || path == NULL) ? NULL :
+		realloc(ctx->watches, (ctx->num_watches + 1) * sizeof(struct file_watcher_watch));
+	if (watches == NULL)
+	{
+		perror("allocation error");
+		free(filename_);
+		free(path);
+		if (dir_fd != -1)
+			{ close(dir_fd); }
+		return false;
+	}
+	memcpy(path, dir, dir_size);
+	path[dir_size] = '/';
+	memcpy(path + dir_size + 1, filename_, filename_size + 1);
+	struct file_watcher_watch watch = { .tag = tag, .stat_poll = { .enabled = false }, .dir_fd = dir_fd, .file_fd = -1, .path = path,
+		.filename = filename_, .filename_size = filename_size, .check_modify = false, .check_moved = false, .check_created = false };
+	if (polled)
+		{ stat_poll_start(&watch.stat_poll, path); }
+	else
+		{ open_file(ctx, &watch); }
+	watches[ctx->num_watches] = watch;
+	ctx->watches = watches;
+	ctx->num_watches++;
+	return true;
+}
+
+// expects previous read_data to have been fully consumed
+// @return -1 on error, 0 if nothing was available to read, 1 if events were read (subset of file_watcher_result.state)
+static char read_more_events(struct file_watcher_ctx* ctx)
+{
+	const struct timespec no_wait = { 0, 0 };
+	int num_events = kevent(ctx->kqueue_fd, NULL, 0, (struct kevent*)ctx->read_data, (int)file_watcher_max_events, &no_wait);
+	if (num_events == -1)
+	{
+		if (errno == EINTR)
+			{ return 0; }
+		perror("kevent() error");
+		return -1;
+	}
+	if (num_events == 0)
+		{ return 0; }
+	ctx->read_data_consumed_size = 0;
+	ctx->read_data_size = (size_t)num_events;
+	return 1;
+}
 
-	struct file_watcher_result ret = { .state = 1, .event_create = created, .event_create_moved = created_moved, .event_modify = modified, .moved_to = NULL, .moved_to_size = 0 };
+// check whether the open file was moved away from watch->path (or deleted), and stop watching it if it was
+// @return result with where it was moved to in the same directory, otherwise state 2 (or lost events if where it went can't be known)
+static struct file_watcher_result check_moved(struct file_watcher_watch* watch)
+{
+	struct file_watcher_result none = { .state = 2 };
+	struct stat file_st, path_st;
+	if (fstat(watch->file_fd, &file_st) == -1)
+		{ return none; }
+	if (stat(watch->path, &path_st) == 0 && path_st.st_dev == file_st.st_dev && path_st.st_ino == file_st.st_ino)
+		{ return none; }
+
+	struct file_watcher_result ret = none;
+	char new_path[PATH_MAX];
+	if (file_st.st_nlink == 0)
+		{}  // deleted
+	else if (!get_fd_path(watch->file_fd, new_path))
+	{
+		// the file has to be checked anyway
+		ret = (struct file_watcher_result){ .state = 1, .event_create = false, .event_create_moved = false, .event_modify = true, .event_lost = true,
+			.moved_to = NULL, .moved_to_size = 0, .tag = watch->tag, .file_size = -1 };
+	}
+	else
+	{
+		// the path may not be spelled like watch->path (e.g. it is absolute), so the directory is compared by what it is
+		char* name = strrchr(new_path, '/');
+		struct stat dir_st, new_dir_st;
+		if (name != NULL)
+		{
+			*name = '\0';
+			name++;
+			if (fstat(watch->dir_fd, &dir_st) == 0 && stat((new_path[0] == '\0') ? "/" : new_path, &new_dir_st) == 0 &&
+				dir_st.st_dev == new_dir_st.st_dev && dir_st.st_ino == new_dir_st.st_ino)
+			{
+				char* moved_to = strdup(name);
+				if (moved_to == NULL)
+					{ perror("strdup() error"); }
+				else
+				{
+					ret = (struct file_watcher_result){ .state = 1, .event_create = false, .event_create_moved = false, .event_modify = false,
+						.moved_to = moved_to, .moved_to_size = strlen(moved_to), .tag = watch->tag, .file_size = -1 };
+				}
+			}
+		}
+	}
+	close(watch->file_fd);
+	watch->file_fd = -1;
 	return ret;
 }
 
+struct file_watcher_result file_watcher_poll(struct file_watcher_ctx* ctx)
+{
+	if (!ctx->has_value)
+	{
+		struct file_watcher_result ret = { .state = -1 };
+		return ret;
+	}
+
+	struct file_watcher_result polled = stat_poll_due(ctx);
+	if (polled.state != 0)
+		{ return polled; }
+
+	while (true)
+	{
+		// in the order they happen when a file is rotated: it is written to, moved away, then a new one is created
+		for (size_t i = 0; i < ctx->num_watches; i++)
+		{
+			struct file_watcher_watch* watch = &ctx->watches[i];
+			if (watch->check_modify)
+			{
+				watch->check_modify = false;
+				if (watch->file_fd != -1)
+				{
+					struct file_watcher_result ret = { .state = 1, .event_create = false, .event_create_moved = false, .event_modify = true,
+						.moved_to = NULL, .moved_to_size = 0, .tag = watch->tag, .file_size = -1 };
+					return ret;
+				}
+			}
+			if (watch->check_moved)
+			{
+				watch->check_moved = false;
+				if (watch->file_fd != -1)
+				{
+					struct file_watcher_result ret = check_moved(watch);
+					if (ret.state == 1)
+						{ return ret; }
+				}
+			}
+			if (watch->check_created)
+			{
+				watch->check_created = false;
+				if (watch->file_fd == -1)
+				{
+					open_file(ctx, watch);
+					// it may have been created or moved there, which can't be told apart. both are read from the start
+					if (watch->file_fd != -1)
+					{
+						struct file_watcher_result ret = { .state = 1, .event_create = true, .event_create_moved = false, .event_modify = true,
+							.moved_to = NULL, .moved_to_size = 0, .tag = watch->tag, .file_size = -1 };
+						return ret;
+					}
+				}
+			}
+		}
+
+		if (ctx->read_data_consumed_size >= ctx->read_data_size)
+		{
+			char read_res = read_more_events(ctx);
+			if (read_res != 1)
+			{
+				struct file_watcher_result ret = { .state = read_res };
+				return ret;
+			}
+		}
+		const struct kevent* event = (const struct kevent*)ctx->read_data + ctx->read_data_consumed_size;
+		ctx->read_data_consumed_size++;
+		for (size_t i = 0; i < ctx->num_watches; i++)
+		{
+			struct file_watcher_watch* watch = &ctx->watches[i];
+			if (event->ident == (uintptr_t)watch->dir_fd)
+			{
+				watch->check_moved = true;
+				watch->check_created = true;
+			}
+			else if (watch->file_fd != -1 && event->ident == (uintptr_t)watch->file_fd)
+			{
+				if (event->fflags & (NOTE_WRITE | NOTE_EXTEND))
+					{ watch->check_modify = true; }
+				if (event->fflags & (NOTE_RENAME | NOTE_DELETE))
+					{ watch->check_moved = true; }
+			}
+		}
+	}
+}
+
+char file_watcher_wait(struct file_watcher_ctx* ctx, int timeout_ms)
+{
+	if (!ctx->has_value)
+		{ return -1; }
+
+	// events from the previous read haven't all been consumed or checked
+	if (ctx->read_data_consumed_size < ctx->read_data_size)
+		{ return 1; }
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		const struct file_watcher_watch* watch = &ctx->watches[i];
+		if (watch->check_modify || watch->check_moved || watch->check_created)
+			{ return 1; }
+	}
+
+	// woken up when a polled file is due, as if it had events
+	int wait_ms = stat_poll_timeout(ctx, timeout_ms);
+	struct pollfd fds[2] = { { .fd = ctx->kqueue_fd, .events = POLLIN }, { .fd = ctx->wakeup_fds[0], .events = POLLIN } };
+	int res = poll(fds, 2, wait_ms);
+	if (res == -1)
+	{
+		if (errno == EINTR)
+			{ return 0; }
+		perror("poll() error");
+		return -1;
+	}
+	if (fds[1].revents & POLLIN)
+	{
+		// empty the pipe so the next wait blocks again
+		// kqueue events (if any) are left for the next call, since it stays readable until they are read
+		char buf[64];
+		while (read(ctx->wakeup_fds[0], buf, sizeof(buf)) > 0)
+			{}
+		return 2;
+	}
+	return ((fds[0].revents & POLLIN) || wait_ms != timeout_ms) ? 1 : 0;
+}
+
+bool file_watcher_wakeup(struct file_watcher_ctx* ctx)
+{
+	if (!ctx->has_value)
+		{ return false; }
+
+	// a full pipe will already wake up the waiting thread
+	char c = 0;
+	if (write(ctx->wakeup_fds[1], &c, 1) == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+	{
+		perror("pipe write() error");
+		return false;
+	}
+	return true;
+}
+
+file_watcher_native_handle_t file_watcher_native_handle(const struct file_watcher_ctx* ctx)
+{
+	return ctx->kqueue_fd;
+}
+
 bool file_watcher_cleanup(struct file_watcher_ctx* ctx)
 {
 	if (!ctx->has_value)
 		{ return false; }
 
 	free(ctx->read_data);
-	free(ctx->filename);
-	bool b1 = close(ctx->epoll_fd) != -1;
-	bool b2 = close(ctx->inotify_fd) != -1;
-	return (b1 && b2);
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		struct file_watcher_watch* watch = &ctx->watches[i];
+		if (watch->file_fd != -1)
+			{ close(watch->file_fd); }
+		if (watch->dir_fd != -1)
+			{ close(watch->dir_fd); }
+		free(watch->filename);
+		free(watch->path);
+	}
+	free(ctx->watches);
+	bool b1 = close(ctx->kqueue_fd) != -1;
+	bool b2 = close(ctx->wakeup_fds[0]) != -1;
+	bool b3 = close(ctx->wakeup_fds[1]) != -1;
+	return (b1 && b2 && b3);
 }
 
 #endif
+
+// platform independent, only uses file_watcher_poll
+
+ptrdiff_t file_watcher_poll_batch(struct file_watcher_ctx* ctx, struct file_watcher_result* results, size_t max_results)
+{
+	size_t num_results = 0;
+	while (num_results < max_results)
+	{
+		struct file_watcher_result res = file_watcher_poll(ctx);
+		if (res.state == -1)
+		{
+			for (size_t i = 0; i < num_results; i++)
+				{ free(results[i].moved_to); }
+			return -1;
+		}
+		if (res.state == 0)
+			{ break; }
+		if (res.state == 2)
+			{ continue; }
+
+		// only a plain modify can be merged, and only into something of the same file that would be followed by reading it anyway
+		bool only_modify = res.event_modify && !res.event_create && !res.event_create_moved && res.moved_to == NULL;
+		if (only_modify)
+		{
+			size_t prev = num_results;
+			while (prev > 0 && results[prev - 1].tag != res.tag)
+				{ prev--; }
+			if (prev > 0 && results[prev - 1].moved_to == NULL)
+			{
+				results[prev - 1].event_modify = true;
+				results[prev - 1].event_lost = results[prev - 1].event_lost || res.event_lost;
+				results[prev - 1].file_size = res.file_size;
+				continue;
+			}
+		}
+		results[num_results] = res;
+		num_results++;
+	}
+	return (ptrdiff_t)num_results;
+}
@@ -8,14 +8,30 @@
 
 #ifdef _WIN32
 #include <algorithm>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <string_view>
 // windows.h included in header
 
 namespace
 {
-	constexpr size_t file_watcher_buf_size = 256 * sizeof(DWORD); 
+	constexpr size_t file_watcher_buf_size = FILE_WATCHER_BUF_SIZE;
+	static_assert(file_watcher_buf_size % sizeof(LONGLONG) == 0, "FILE_WATCHER_BUF_SIZE must be a multiple of LONGLONG size for ReadDirectoryChangesExW");
+
+	// ReadDirectoryChangesExW can report the file size with each event (windows 10 1709+)
+#if defined(NTDDI_WIN10_RS3) && NTDDI_VERSION >= NTDDI_WIN10_RS3
+	constexpr bool use_extended_info = true;
+	using notify_info_t = FILE_NOTIFY_EXTENDED_INFORMATION;
+#else
+	constexpr bool use_extended_info = false;
+	using notify_info_t = FILE_NOTIFY_INFORMATION;
+#endif
+
+	// completion key of file_watcher_wakeup packets (other keys are watch indices)
+	constexpr ULONG_PTR wakeup_key = static_cast<ULONG_PTR>(-1);
 
 	// kinda like perror for win32 errors
 	static inline void print_error(std::string_view sv, DWORD error_code = GetLastError())
@@ -36,41 +52,114 @@ namespace
 
 file_watcher_ctx file_watcher_init(const char* dir, const char* filename, size_t filename_size, void* user_data)
 {
-	HANDLE dir_handle = CreateFileA(dir, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
-		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
-	if (dir_handle == INVALID_HANDLE_VALUE)
+	HANDLE port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+	if (port == nullptr)
 	{
-		print_error("CreateFileA() error opening directory");
+		print_error("CreateIoCompletionPort() error");
 		return { .has_value = false };
 	}
-	void* read_data = _aligned_malloc(file_watcher_buf_size, sizeof(DWORD));
-	if (read_data == nullptr)
+	// manual-reset, as required for OVERLAPPED::hEvent (shared by the requests of all watches)
+	// completions are still queued to the port when an event is given
+	HANDLE request_event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	if (request_event == nullptr)
 	{
-		std::perror("_aligned_malloc() error");
+		print_error("CreateEventA() error");
 		return { .has_value = false };
 	}
-	
-	// wide filename can have upto as many bytes as narrow
-	wchar_t* filename_ = new wchar_t[filename_size + 1];
-	filename_size = std::mbstowcs(filename_, filename, filename_size + 1);
-	return { .has_value = true, .handle = dir_handle, .filename = filename_, .filename_size = filename_size,
-		.notify_on_last_write = *static_cast<bool*>(user_data), .has_cur_request = false, .moved = false,
-		.read_data = static_cast<unsigned char*>(read_data), .read_data_offset = 0, .read_data_size = 0 };
+
+	file_watcher_ctx ret = { .has_value = true, .watches = nullptr, .num_watches = 0,
+		.notify_on_last_write = *static_cast<bool*>(user_data), .next_watch = 0,
+		.port = port, .request_event = request_event, .woken = false };
+	if (!file_watcher_add(&ret, dir, filename, filename_size, 0))
+	{
+		file_watcher_cleanup(&ret);
+		ret.has_value = false;
+	}
+	return ret;
 }
 
 namespace
 {
-	static inline file_watcher_result file_watcher_read(file_watcher_ctx* ctx)
+	// start a request in the watch's pending buffer if there isn't one already
+	// @return true on success
+	static inline bool file_watcher_start_request(const file_watcher_ctx* ctx, file_watcher_watch* watch)
 	{
-		const auto* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(ctx->read_data + ctx->read_data_offset);
+		if (watch->has_request)
+			{ return true; }
+		OVERLAPPED* request = &(watch->requests[watch->pending_buffer]);
+		*request = {};
+		request->hEvent = ctx->request_event;
+		unsigned char* buffer = watch->read_data + watch->pending_buffer * file_watcher_buf_size;
+		const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | (ctx->notify_on_last_write ? FILE_NOTIFY_CHANGE_LAST_WRITE : FILE_NOTIFY_CHANGE_SIZE) | FILE_NOTIFY_CHANGE_CREATION;
+		// unlike ReadFile, this shouldn't ever run synchronously if the handle is async
+		// (and even if it did, the completion would still be queued to the port)
+		bool ok;
+		if constexpr (use_extended_info)
+			{ ok = ReadDirectoryChangesExW(watch->handle, buffer, file_watcher_buf_size, FALSE, filter, nullptr, request, nullptr, ReadDirectoryNotifyExtendedInformation); }
+		else
+			{ ok = ReadDirectoryChangesW(watch->handle, buffer, file_watcher_buf_size, FALSE, filter, nullptr, request, nullptr); }
+		if (!ok)
+		{
+			print_error("ReadDirectoryChangesW() error");
+			return false;
+		}
+		watch->has_request = true;
+		return true;
+	}
+
+	// take a completion from the port. if it is a request, its events are made available to read and the next request is started
+	// the events being read must have been consumed already (since the buffer is reused)
+	// @return -1 on error, 0 on timeout, 1 if a request completed, 2 if it was a wakeup
+	static inline char file_watcher_dequeue(file_watcher_ctx* ctx, DWORD timeout_ms)
+	{
+		DWORD bytes_transferred;
+		ULONG_PTR key;
+		OVERLAPPED* overlapped;
+		if (!GetQueuedCompletionStatus(ctx->port, &bytes_transferred, &key, &overlapped, timeout_ms))
+		{
+			const auto last_err = GetLastError();
+			if (overlapped == nullptr && last_err == WAIT_TIMEOUT)
+				{ return 0; }
+			if (overlapped != nullptr && last_err == ERROR_NOTIFY_ENUM_DIR)
+				{ bytes_transferred = 0; }  // the request completed, but there were too many changes to report
+			else
+			{
+				// either the port failed, or a request did
+				print_error("GetQueuedCompletionStatus() error", last_err);
+				return -1;
+			}
+		}
+		if (key == wakeup_key)
+			{ return 2; }
+
+		file_watcher_watch* watch = &(ctx->watches[key]);
+		const size_t completed_buffer = watch->pending_buffer;
+		watch->has_request = false;
+		watch->pending_buffer = 1 - completed_buffer;
+		watch->read_data_offset = completed_buffer * file_watcher_buf_size;
+		watch->read_data_size = watch->read_data_offset + bytes_transferred;
+		// nothing is transferred if the buffer overflowed
+		if (bytes_transferred == 0)
+			{ watch->lost_events = true; }
+		if (!file_watcher_start_request(ctx, watch))
+			{ return -1; }
+		return 1;
+	}
+
+	static inline file_watcher_result file_watcher_read(file_watcher_watch* watch)
+	{
+		const auto* info = reinterpret_cast<const notify_info_t*>(watch->read_data + watch->read_data_offset);
 		if (info->NextEntryOffset == 0)  // this is the last entry
-			{ ctx->read_data_offset = ctx->read_data_size; }
+			{ watch->read_data_offset = watch->read_data_size; }
 		else
-			{ ctx->read_data_offset += info->NextEntryOffset; }
+			{ watch->read_data_offset += info->NextEntryOffset; }
 		
 		const std::size_t filename_num_chars = info->FileNameLength / sizeof(WCHAR);
+		int64_t file_size = -1;
+		if constexpr (use_extended_info)
+			{ file_size = info->FileSize.QuadPart; }
 		
-		if (info->Action == FILE_ACTION_RENAMED_NEW_NAME && ctx->moved)
+		if (info->Action == FILE_ACTION_RENAMED_NEW_NAME && watch->moved)
 		{
 			// allocate double length so wide to multibyte string conversion never overflows
 			std::size_t new_filename_size = filename_num_chars * 2;
@@ -85,13 +174,14 @@ namespace
 			}
 			new_filename_size = ret;
 			new_filename[new_filename_size] = '\0';  // add null terminator
-			return { .state = 1, .event_create = false, .event_modify = false, .moved_to = new_filename, .moved_to_size = new_filename_size };
+			return { .state = 1, .event_create = false, .event_modify = false, .moved_to = new_filename, .moved_to_size = new_filename_size,
+				.tag = watch->tag, .file_size = file_size };
 		}
-		ctx->moved = false;
+		watch->moved = false;
 		
 		bool strs_eq;
 		{
-			std::wstring_view old_sv(ctx->filename, ctx->filename_size);
+			std::wstring_view old_sv(watch->filename, watch->filename_size);
 			std::wstring_view new_sv(info->FileName, filename_num_chars);
 			strs_eq = (old_sv != new_sv);
 		}
@@ -99,7 +189,7 @@ namespace
 			{ return { .state = 2 }; }
 		if (info->Action == FILE_ACTION_RENAMED_OLD_NAME)
 		{
-			ctx->moved = true;
+			watch->moved = true;
 			return { .state = 2 };
 		}
 		
@@ -118,51 +208,152 @@ namespace
 		default:
 			return { .state = 2 };
 		}
-		return { .state = 1, .event_create = created, .event_create_moved = created_moved, .event_modify = modified, .moved_to = nullptr, .moved_to_size = 0 };
+		return { .state = 1, .event_create = created, .event_create_moved = created_moved, .event_modify = modified, .moved_to = nullptr, .moved_to_size = 0,
+			.tag = watch->tag, .file_size = file_size };
+	}
+}
+
+bool file_watcher_add(file_watcher_ctx* ctx, const char* dir, const char* filename, size_t filename_size, uintptr_t tag)
+{
+	if (!ctx->has_value)
+		{ return false; }
+
+	// each watch has its own directory handle (even for the same directory), since each has its own requests
+	HANDLE dir_handle = CreateFileA(dir, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (dir_handle == INVALID_HANDLE_VALUE)
+	{
+		print_error("CreateFileA() error opening directory");
+		return false;
+	}
+	if (CreateIoCompletionPort(dir_handle, ctx->port, ctx->num_watches, 0) == nullptr)
+	{
+		print_error("CreateIoCompletionPort() error");
+		CloseHandle(dir_handle);
+		return false;
+	}
+	void* read_data = _aligned_malloc(2 * file_watcher_buf_size, alignof(LONGLONG));
+	if (read_data == nullptr)
+	{
+		std::perror("_aligned_malloc() error");
+		CloseHandle(dir_handle);
+		return false;
 	}
+	auto* watches = static_cast<file_watcher_watch*>(std::realloc(ctx->watches, (ctx->num_watches + 1) * sizeof(file_watcher_watch)));
+	if (watches == nullptr)
+	{
+		std::perror("realloc() error");
+		_aligned_free(read_data);
+		CloseHandle(dir_handle);
+		return false;
+	}
+	ctx->watches = watches;
+
+	if (filename_size == static_cast<size_t>(-1))
+		{ filename_size = std::strlen(filename); }
+	// wide filename can have upto as many bytes as narrow
+	wchar_t* filename_ = new wchar_t[filename_size + 1];
+	filename_size = std::mbstowcs(filename_, filename, filename_size + 1);
+	file_watcher_watch* watch = &(watches[ctx->num_watches]);
+	*watch = { .tag = tag, .handle = dir_handle, .filename = filename_, .filename_size = filename_size, .moved = false,
+		.has_request = false, .lost_events = false, .pending_buffer = 0, .requests = new OVERLAPPED[2]{},
+		.read_data = static_cast<unsigned char*>(read_data), .read_data_offset = 0, .read_data_size = 0 };
+	ctx->num_watches++;
+	// start watching right away, changes are buffered from now on
+	return file_watcher_start_request(ctx, watch);
 }
 
 file_watcher_result file_watcher_poll(file_watcher_ctx* ctx)
 {
 	if (!ctx->has_value)
 		{ return { .state = -1 }; }
-	
-	// still more data from previous request that haven't been read
-	if (ctx->read_data_offset < ctx->read_data_size)
-		{ return file_watcher_read(ctx); }
-	
-	
-	if (!ctx->has_cur_request)
+
+	bool event_reset = false;
+	while (true)
 	{
-		ctx->cur_request = {};
-		// unlike ReadFile, this shouldn't ever run synchronously if the handle is async
-		if (!ReadDirectoryChangesW(ctx->handle, ctx->read_data, file_watcher_buf_size, FALSE,
-			FILE_NOTIFY_CHANGE_FILE_NAME | (ctx->notify_on_last_write ? FILE_NOTIFY_CHANGE_LAST_WRITE : FILE_NOTIFY_CHANGE_SIZE) | FILE_NOTIFY_CHANGE_CREATION,
-			nullptr, &(ctx->cur_request), nullptr))
+		for (size_t i = 0; i < ctx->num_watches; i++)
 		{
-			print_error("ReadDirectoryChangesW() error");
-			return { .state = -1 };
+			const size_t ind = (ctx->next_watch + i) % ctx->num_watches;
+			file_watcher_watch* watch = &(ctx->watches[ind]);
+			if (watch->lost_events)
+			{
+				// the file has to be read again anyway, and a modify does that
+				// (the file could also have been replaced, but that can't be known)
+				watch->lost_events = false;
+				ctx->next_watch = (ind + 1) % ctx->num_watches;
+				return { .state = 1, .event_create = false, .event_create_moved = false, .event_modify = true, .event_lost = true, .moved_to = nullptr,
+					.moved_to_size = 0, .tag = watch->tag, .file_size = -1 };
+			}
+			// still more data from previous request that haven't been read
+			if (watch->read_data_offset < watch->read_data_size)
+			{
+				ctx->next_watch = (ind + 1) % ctx->num_watches;
+				return file_watcher_read(watch);
+			}
 		}
-		ctx->has_cur_request = true;
-	}
-	// has_cur_request will always be true now 
-	DWORD bytes_transferred;
-	if (!GetOverlappedResult(ctx->handle, &(ctx->cur_request), &bytes_transferred, FALSE))
-	{
-		const auto last_err = GetLastError();
-		if (last_err == ERROR_IO_INCOMPLETE)
-			{ return { .state = 0 }; }
-		else
+
+		// everything buffered has been read, so more can be taken from the port
+		switch (file_watcher_dequeue(ctx, 0))
 		{
-			print_error("GetOverlappedResult() error", last_err);
+		case 1:
+			continue;
+		case 2:
+			ctx->woken = true;  // for the next wait
+			continue;
+		case 0:
+			if (event_reset)
+				{ return { .state = 0 }; }
+			// reset the event to only be signaled by requests that complete from now on,
+			// then check the port again for ones that completed before the reset
+			if (!ResetEvent(ctx->request_event))
+			{
+				print_error("ResetEvent() error");
+				return { .state = -1 };
+			}
+			event_reset = true;
+			continue;
+		default:
 			return { .state = -1 };
 		}
 	}
-	// successfully read data
-	ctx->read_data_offset = 0;
-	ctx->read_data_size = bytes_transferred;
-	ctx->has_cur_request = false;
-	return file_watcher_read(ctx);
+}
+
+char file_watcher_wait(file_watcher_ctx* ctx, int timeout_ms)
+{
+	if (!ctx->has_value)
+		{ return -1; }
+	
+	if (ctx->woken)
+	{
+		ctx->woken = false;
+		return 2;
+	}
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		const file_watcher_watch* watch = &(ctx->watches[i]);
+		// still more data from previous request that haven't been read
+		if (watch->lost_events || watch->read_data_offset < watch->read_data_size)
+			{ return 1; }
+	}
+	return file_watcher_dequeue(ctx, (timeout_ms < 0) ? INFINITE : static_cast<DWORD>(timeout_ms));
+}
+
+bool file_watcher_wakeup(file_watcher_ctx* ctx)
+{
+	if (!ctx->has_value)
+		{ return false; }
+	
+	if (!PostQueuedCompletionStatus(ctx->port, 0, wakeup_key, nullptr))
+	{
+		print_error("PostQueuedCompletionStatus() error");
+		return false;
+	}
+	return true;
+}
+
+file_watcher_native_handle_t file_watcher_native_handle(const file_watcher_ctx* ctx)
+{
+	return ctx->request_event;
 }
 
 bool file_watcher_cleanup(struct file_watcher_ctx* ctx)
@@ -170,12 +361,28 @@ bool file_watcher_cleanup(struct file_watcher_ctx* ctx)
 	if (!ctx->has_value)
 		{ return false; }
 	
-	delete[] ctx->filename;
-	_aligned_free(ctx->read_data);
 	bool ok = true;
-	if (!CancelIo(ctx->handle))
-		{ ok = false; print_error("CancelIo() error"); }
-	if (!CloseHandle(ctx->handle))
+	for (size_t i = 0; i < ctx->num_watches; i++)
+	{
+		file_watcher_watch* watch = &(ctx->watches[i]);
+		if (!CancelIo(watch->handle))
+			{ ok = false; print_error("CancelIo() error"); }
+		else if (watch->has_request)
+		{
+			// the request can still write to requests and read_data until cancelling it completes
+			DWORD bytes_transferred;
+			GetOverlappedResult(watch->handle, &(watch->requests[watch->pending_buffer]), &bytes_transferred, TRUE);
+		}
+		if (!CloseHandle(watch->handle))
+			{ ok = false; print_error("CloseHandle() error"); }
+		delete[] watch->filename;
+		delete[] watch->requests;
+		_aligned_free(watch->read_data);
+	}
+	std::free(ctx->watches);
+	if (!CloseHandle(ctx->port))
+		{ ok = false; print_error("CloseHandle() error"); }
+	if (!CloseHandle(ctx->request_event))
 		{ ok = false; print_error("CloseHandle() error"); }
 	return ok;
 }
@@ -18,38 +18,120 @@ extern "C"
 #undef WIN32_LEAN_AND_MEAN
 #endif
 
-struct file_watcher_ctx
+// size in bytes of the buffer events are read into, so many events can be read at once
+// (can be defined to override; on linux it must fit at least one event with the longest filename;
+// on windows there are two per file, and ReadDirectoryChangesW fails for more than 64 KiB on network drives)
+#ifndef FILE_WATCHER_BUF_SIZE
+#define FILE_WATCHER_BUF_SIZE 65536
+#endif
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+// min and max time in milliseconds between checks of a polled file (see file_watcher_stat_poll), can be defined to override
+// it is checked again after the min while it changes, and the time doubles (up to the max) each time it didn't
+#ifndef FILE_WATCHER_POLL_MIN_MS
+#define FILE_WATCHER_POLL_MIN_MS 100
+#endif
+#ifndef FILE_WATCHER_POLL_MAX_MS
+#define FILE_WATCHER_POLL_MAX_MS 2000
+#endif
+
+// a file that is polled with stat instead of watched, since it is on a filesystem that doesn't report changes made by other hosts (e.g. nfs)
+struct file_watcher_stat_poll
 {
-	bool has_value;  // true if the rest of the contents are valid
+	bool enabled;
+	bool exists;  // when it was last checked, the rest is of that check if it did
+	// to tell when it is replaced. a new file that reused the inode number (the old one was deleted before it was checked) looks like the same one
+	uint64_t dev, ino;
+	int64_t size;
+	int64_t mtime_ns;
+	int64_t next_ms;  // CLOCK_MONOTONIC time of the next check
+	int64_t interval_ms;  // time from the last check to the next
+};
+#endif
+
+// one file being watched
+struct file_watcher_watch
+{
+	uintptr_t tag;  // returned with events of this file
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+	struct file_watcher_stat_poll stat_poll;  // if enabled, nothing is watched and only path, filename and filename_size are used
+#endif
 #ifdef __linux__
-	int inotify_fd, epoll_fd;
-	uint32_t cookie;
+	int watch_desc;  // of the directory (shared by all watches in the same directory), only for creates and moves
+	// of the file itself, for modifies (so writes to other files in the directory aren't read), or -1 if it doesn't exist.
+	// it follows the file, so it is removed when the file is moved away and added again when the file is created
+	int file_watch_desc;
+	char* path;  // null-terminated path of the file, to watch it again
+	uint32_t cookie;  // of the last IN_MOVED_FROM of this file, to find where it was moved to
+	bool lost_events;  // the event queue overflowed, so changes since the last event that was read may be missing
 	char* filename;  // null-terminated filename
 	size_t filename_size;  // excludes null terminator
-	unsigned char* read_data;
-	size_t read_data_consumed_size, read_data_size;
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+	int dir_fd;  // of the directory, for entries being added, removed or renamed (kqueue has no events with names)
+	int file_fd;  // of the file, for writes, renames and deletes, or -1 if it isn't open (it doesn't exist)
+	char* path;  // null-terminated path of the file, to open it again
+	char* filename;  // null-terminated filename
+	size_t filename_size;  // excludes null terminator
+	// what events that were read need checked, since they only say which file changed and not how (see file_watcher_poll)
+	bool check_modify, check_moved, check_created;
 #elif defined(_WIN32)
-	HANDLE handle;
+	HANDLE handle;  // directory, associated with the ctx's completion port (key is the index of the watch)
 	const wchar_t* filename;  // null-terminated filename
 	size_t filename_size;  // excludes null terminator
-	bool notify_on_last_write;  // true to use FILE_NOTIFY_CHANGE_LAST_WRITE, false to use FILE_NOTIFY_CHANGE_SIZE
-	bool has_cur_request;
-	OVERLAPPED cur_request;
 	bool moved;
-	unsigned char* read_data;
-	size_t read_data_offset, read_data_size;
+	// double-buffered: a new request is started (in the other buffer) as soon as one completes, before its events are read,
+	// so changes made while reading are still captured
+	bool has_request;  // whether the request in pending_buffer is outstanding
+	bool lost_events;  // the last request overflowed, so changes reported before it may be missing
+	size_t pending_buffer;  // 0 or 1, the other buffer holds the events being read
+	OVERLAPPED* requests;  // 2, separately allocated, since file_watcher_add can move the watches while a request is pending
+	unsigned char* read_data;  // 2 buffers of FILE_WATCHER_BUF_SIZE
+	size_t read_data_offset, read_data_size;  // of the buffer being read
+#endif
+};
+
+struct file_watcher_ctx
+{
+	bool has_value;  // true if the rest of the contents are valid
+	struct file_watcher_watch* watches;
+	size_t num_watches;
+#ifdef __linux__
+	int inotify_fd, epoll_fd;
+	int wakeup_fd;  // eventfd for file_watcher_wakeup
+	unsigned char* read_data;  // shared by all watches
+	size_t read_data_consumed_size, read_data_size;
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+	int kqueue_fd;
+	int wakeup_fds[2];  // pipe for file_watcher_wakeup, written to [1] and read from [0]
+	void* read_data;  // array of struct kevent, shared by all watches
+	size_t read_data_consumed_size, read_data_size;  // in events
+#elif defined(_WIN32)
+	bool notify_on_last_write;  // true to use FILE_NOTIFY_CHANGE_LAST_WRITE, false to use FILE_NOTIFY_CHANGE_SIZE
+	size_t next_watch;  // where file_watcher_poll starts looking, so one busy file can't hide the others
+	HANDLE port;  // IO completion port that all requests complete to (and file_watcher_wakeup posts to)
+	HANDLE request_event;  // signaled when any request completes, reset when the port is found to be empty
+	bool woken;  // file_watcher_poll took a wakeup from the port, so the next file_watcher_wait returns 2
 #endif
 };
 
-// watch `filename` in `dir` for create, modify, and rename events
+// watch `filename` in `dir` for create, modify, and rename events (with tag 0, see file_watcher_add for more files)
+// on linux, macos and freebsd, a file on a network filesystem is polled instead (see file_watcher_stat_poll), and is only found
+// to be moved if it is still in `dir` when it is checked
 // @param dir  null-terminated string of directory to watch
 // @param filename  null-terminated string of target file (filename only, not path)
 // @param filename_size  size of filename string excluding null, or -1 if unknown
 // @param other_data  additional data that the platform-specific implementation might use:
 //                    on windows, this will be a bool* that holds true to use FILE_NOTIFY_CHANGE_LAST_WRITE and false to use FILE_NOTIFY_CHANGE_SIZE;
-//                    on linux, it is unused
+//                    on linux, macos and freebsd, it is unused
 struct file_watcher_ctx file_watcher_init(const char* dir, const char* filename, size_t filename_size, void* other_data);
 
+// also watch `filename` in `dir` (which can be the same directory as other watches), e.g. for the logs of another server
+// events of all files are read and waited for together
+// @param dir, filename, filename_size  same as file_watcher_init
+// @param tag  value of file_watcher_result.tag for events of this file
+// @return true on success
+bool file_watcher_add(struct file_watcher_ctx* ctx, const char* dir, const char* filename, size_t filename_size, uintptr_t tag);
+
 struct file_watcher_result
 {
 	// -1 on error, 0 if nothing was available to read, 1 if data was read, 2 if more should be read
@@ -61,14 +143,53 @@ struct file_watcher_result
 	bool event_create_moved;
 	// file was modified
 	bool event_modify;
+	// events of the file were lost (the event queue overflowed), so it may also have been created, replaced or moved without
+	// other events saying so. event_modify is always also set, since the file has to be read again anyway
+	bool event_lost;
 	// new file name if file was moved elsewhere (NULL otherwise)
 	// MUST BE FREED BY USER WITH free()
 	char* moved_to;  // null-terminated new file name
 	size_t moved_to_size;  // excludes null terminator
+	// tag of the file the event is for (see file_watcher_add)
+	uintptr_t tag;
+	// size of the file when the event happened (it might have changed since), or -1 if unknown
+	// only known on windows 10 1709+ (if built for it), and for files that are polled
+	int64_t file_size;
 };
 // read a single event, if it exists
 struct file_watcher_result file_watcher_poll(struct file_watcher_ctx* ctx);
 
+// read all available events for the file (up to max_results) in order, like calling file_watcher_poll until nothing is left
+// consecutive modify events of a file (including one following a create) are coalesced into one, since reading the file once handles all of them
+// @param results  array of at least max_results elements. moved_to must be freed as with file_watcher_poll
+// @return -1 on error (results that were written are freed), otherwise number of results written. if this is max_results, there may be more events
+ptrdiff_t file_watcher_poll_batch(struct file_watcher_ctx* ctx, struct file_watcher_result* results, size_t max_results);
+
+// block until there may be events for file_watcher_poll to read, the timeout passes, or file_watcher_wakeup is called
+// @param timeout_ms  max time to wait in milliseconds, or -1 to wait indefinitely
+// @return -1 on error, 0 on timeout, 1 if file_watcher_poll should be called, 2 if woken up by file_watcher_wakeup
+//         (0 can also be returned early if the wait was interrupted, so callers should be prepared to wait again)
+char file_watcher_wait(struct file_watcher_ctx* ctx, int timeout_ms);
+
+// wake up a thread blocked in file_watcher_wait (if none is, the next call will return immediately)
+// unlike the other functions, this is safe to call from any thread
+// @return true on success
+bool file_watcher_wakeup(struct file_watcher_ctx* ctx);
+
+#ifdef _WIN32
+typedef HANDLE file_watcher_native_handle_t;
+#else
+typedef int file_watcher_native_handle_t;
+#endif
+// get something an external event loop can wait on instead of calling file_watcher_wait:
+// on linux, a file descriptor that is readable (EPOLLIN/POLLIN, level-triggered) when there are events;
+// on macos and freebsd, the kqueue, which is readable (POLLIN) when there are events;
+// on windows, an event that is signaled when a request completes (reset by file_watcher_poll once there is nothing left)
+// files that are polled (see file_watcher_stat_poll) never make it ready, so file_watcher_wait has to be used if any are
+// once it is ready, call file_watcher_poll_batch. if that returns max_results, call it again before waiting, since buffered events don't make it ready
+// the handle is owned by ctx, and file_watcher_wakeup has no effect on it
+file_watcher_native_handle_t file_watcher_native_handle(const struct file_watcher_ctx* ctx);
+
 // if failed, some file descriptors may not be closed
 // @return true on success
 bool file_watcher_cleanup(struct file_watcher_ctx* ctx);
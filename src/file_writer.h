@@ -0,0 +1,288 @@
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#undef WIN32_LEAN_AND_MEAN
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "logger.h"
+
+namespace detail
+{
+	// file to replace atomically and durably (see replace_files)
+	struct file_replacement
+	{
+		const std::filesystem::path* path;
+		std::string_view contents;
+		bool ok = false;  // set to whether the file was replaced
+	};
+
+#ifdef _WIN32
+	using native_file = HANDLE;
+	inline const native_file invalid_native_file = INVALID_HANDLE_VALUE;
+
+	[[nodiscard]] inline native_file create_file_for_write(const std::filesystem::path& path) noexcept
+		{ return CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr); }
+	[[nodiscard]] inline bool write_all(native_file file, std::string_view data) noexcept
+	{
+		while (!data.empty())
+		{
+			DWORD written = 0;
+			const DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(data.size(), 1 << 30));
+			if (!WriteFile(file, data.data(), chunk, &written, nullptr) || written == 0)
+				{ return false; }
+			data.remove_prefix(written);
+		}
+		return true;
+	}
+	[[nodiscard]] inline bool sync_file(native_file file) noexcept
+		{ return FlushFileBuffers(file) != 0; }
+	inline void close_file(native_file file) noexcept
+		{ CloseHandle(file); }
+	// the rename is written through, so there is no directory to flush
+	[[nodiscard]] inline bool rename_file(const std::filesystem::path& from, const std::filesystem::path& to) noexcept
+		{ return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0; }
+	[[nodiscard]] inline bool sync_directory(const std::filesystem::path& /*dir*/) noexcept
+		{ return true; }
+	[[nodiscard]] inline std::error_code last_file_error() noexcept
+		{ return std::error_code(static_cast<int>(GetLastError()), std::system_category()); }
+#else
+	using native_file = int;
+	inline constexpr native_file invalid_native_file = -1;
+
+	[[nodiscard]] inline native_file create_file_for_write(const std::filesystem::path& path) noexcept
+		{ return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); }
+	[[nodiscard]] inline bool write_all(native_file file, std::string_view data) noexcept
+	{
+		while (!data.empty())
+		{
+			const ssize_t written = ::write(file, data.data(), data.size());
+			if (written < 0 && errno == EINTR)
+				{ continue; }
+			if (written <= 0)
+				{ return false; }
+			data.remove_prefix(static_cast<std::size_t>(written));
+		}
+		return true;
+	}
+	[[nodiscard]] inline bool sync_file(native_file file) noexcept
+	{
+#ifdef __linux__
+		return ::fdatasync(file) == 0;
+#else
+		return ::fsync(file) == 0;
+#endif
+	}
+	inline void close_file(native_file file) noexcept
+		{ ::close(file); }
+	[[nodiscard]] inline bool rename_file(const std::filesystem::path& from, const std::filesystem::path& to) noexcept
+		{ return ::rename(from.c_str(), to.c_str()) == 0; }
+	// so a rename into it survives a crash
+	[[nodiscard]] inline bool sync_directory(const std::filesystem::path& dir) noexcept
+	{
+		const int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0)
+			{ return false; }
+		const bool res = ::fsync(fd) == 0;
+		::close(fd);
+		return res;
+	}
+	[[nodiscard]] inline std::error_code last_file_error() noexcept
+		{ return std::error_code(errno, std::generic_category()); }
+#endif
+
+	// replace each file atomically and durably: its contents are written to a temporary file, which is flushed to disk and renamed over it,
+	// then its directory is flushed, so after a crash (of the process or the machine) it is either the old file or the new one, never a partial one
+	// the files are replaced as a group, so their flushes overlap and each directory is only flushed once
+	// an error is printed for each file that couldn't be replaced
+	inline void replace_files(std::span<file_replacement> files)
+	{
+		std::vector<std::filesystem::path> temp_paths;
+		std::vector<native_file> handles;
+		temp_paths.reserve(files.size());
+		handles.reserve(files.size());
+		const auto fail = [&](std::size_t i, std::string_view what)
+		{
+			log_message(log_severity::error, std::format("Could not {} {}: {}", what, temp_paths[i].string(), last_file_error().message()));
+			files[i].ok = false;
+		};
+		for (std::size_t i = 0; i < files.size(); i++)
+		{
+			temp_paths.push_back(*files[i].path);
+			temp_paths.back() += ".tmp";
+			handles.push_back(create_file_for_write(temp_paths.back()));
+			files[i].ok = handles.back() != invalid_native_file;
+			if (!files[i].ok)
+				{ fail(i, "create"); }
+			else if (!write_all(handles.back(), files[i].contents))
+				{ fail(i, "write"); }
+		}
+		for (std::size_t i = 0; i < files.size(); i++)
+		{
+			if (handles[i] == invalid_native_file)
+				{ continue; }
+			if (files[i].ok && !sync_file(handles[i]))
+				{ fail(i, "flush"); }
+			close_file(handles[i]);
+		}
+		std::set<std::filesystem::path> dirs;
+		for (std::size_t i = 0; i < files.size(); i++)
+		{
+			if (files[i].ok && !rename_file(temp_paths[i], *files[i].path))
+				{ fail(i, "rename"); }
+			if (files[i].ok)
+				{ dirs.insert(files[i].path->parent_path()); }
+			else
+			{
+				std::error_code ec;
+				std::filesystem::remove(temp_paths[i], ec);
+			}
+		}
+		for (const auto& dir : dirs)
+		{
+			if (!sync_directory(dir))
+				{ log_message(log_severity::warning, std::format("Could not flush directory {}, the files replaced in it may not survive a crash", dir.string())); }
+		}
+	}
+
+	// @return whether `path` was replaced with `contents` (see replace_files)
+	inline bool replace_file(const std::filesystem::path& path, std::string_view contents)
+	{
+		file_replacement file{ &path, contents };
+		replace_files(std::span(&file, 1));
+		return file.ok;
+	}
+}
+
+// replaces files atomically and durably (see detail::replace_files) on a background thread, since flushing a file to disk can take from milliseconds
+// to seconds on a busy disk, and the threads that have files to save (reading logs, rendering, dpp's) shouldn't wait for it.
+// files queued while a group is being written are committed together as the next group, and a file queued again right after itself before it is
+// written only has its newest contents written (e.g. the latest.log resume point, if the disk can't keep up)
+// files are replaced in the order they were queued in, so a file queued after another is never on disk without it
+class durable_file_writer
+{
+public:
+	// called on the writer's thread with whether the file was replaced (an error will have been printed if it wasn't)
+	using callback_t = std::function<void(bool ok)>;
+
+private:
+	struct job_t
+	{
+		std::filesystem::path path;
+		std::string contents;
+		std::vector<callback_t> callbacks;  // of this write and of those it replaced
+	};
+
+	std::size_t max_queued_bytes;
+	std::mutex mutex;
+	std::condition_variable cv;  // the queue or writing changed
+	std::vector<job_t> queue;
+	std::size_t queued_bytes = 0;
+	bool writing = false;  // a group taken from the queue is being written
+	bool stopping = false;
+	std::thread thread;
+
+	void run()
+	{
+		std::unique_lock lock(mutex);
+		while (true)
+		{
+			cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (queue.empty())
+				{ return; }  // stopping, and everything was written
+			std::vector<job_t> group = std::move(queue);
+			queue.clear();
+			queued_bytes = 0;
+			writing = true;
+			cv.notify_all();
+			lock.unlock();
+
+			std::vector<detail::file_replacement> files;
+			files.reserve(group.size());
+			for (const job_t& job : group)
+				{ files.push_back({ &job.path, job.contents }); }
+			detail::replace_files(files);
+			for (std::size_t i = 0; i < group.size(); i++)
+			{
+				for (const callback_t& callback : group[i].callbacks)
+					{ callback(files[i].ok); }
+			}
+
+			lock.lock();
+			writing = false;
+			cv.notify_all();
+		}
+	}
+
+public:
+	// @param max_queued_bytes  of contents waiting to be written, after which queueing more waits for them (the disk can't keep up)
+	explicit durable_file_writer(std::size_t max_queued_bytes = std::size_t(256) << 20) : max_queued_bytes(max_queued_bytes)
+		{ thread = std::thread([this]() { run(); }); }
+	durable_file_writer(const durable_file_writer&) = delete;
+	durable_file_writer& operator=(const durable_file_writer&) = delete;
+	// writes what is queued before returning
+	~durable_file_writer()
+	{
+		{
+			std::scoped_lock lock(mutex);
+			stopping = true;
+		}
+		cv.notify_all();
+		thread.join();
+	}
+
+	// queue `contents` to replace the file at `path`. only waits if more than max_queued_bytes are queued already
+	// @param callback  optional, see callback_t
+	void write(std::filesystem::path path, std::string contents, callback_t callback = {})
+	{
+		std::unique_lock lock(mutex);
+		// a file larger than the limit is queued once nothing else is
+		cv.wait(lock, [&]() { return queue.empty() || queued_bytes + contents.size() <= max_queued_bytes; });
+		// only if it is the last one queued, so the order files are replaced in is kept
+		if (!queue.empty() && queue.back().path == path)
+		{
+			queued_bytes -= queue.back().contents.size();
+			queue.back().contents = std::move(contents);
+		}
+		else
+			{ queue.push_back({ std::move(path), std::move(contents), {} }); }
+		queued_bytes += queue.back().contents.size();
+		if (callback)
+			{ queue.back().callbacks.push_back(std::move(callback)); }
+		cv.notify_all();
+	}
+
+	// wait until everything queued so far has been written, e.g. before reading a directory the files are in
+	void flush()
+	{
+		std::unique_lock lock(mutex);
+		cv.wait(lock, [this]() { return queue.empty() && !writing; });
+	}
+};
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef GRAPH_CACHE_H
+#define GRAPH_CACHE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "memory_census.h"
+#include "session_store.h"
+
+// what a graph shows
+enum class graph_type : std::uint8_t
+{
+	playtime,  // create_graph
+	online,  // create_online_graph
+	heatmap,  // create_heatmap_graph
+	player,  // create_player_graph
+	lag,  // create_lag_graph
+	servers  // create_servers_graph
+};
+
+// size of a png graph, rendered at full size and downsampled to the others (see png_graph_writer::variant_divisors, in the same order)
+enum class graph_size : std::uint8_t
+{
+	full,  // for discord
+	half,  // for the web
+	thumbnail
+};
+
+// rendered graphs of the latest data, so identical /graph commands don't render again when nothing has changed
+// only the newest generation is kept, since older data is never graphed again
+class graph_cache
+{
+public:
+	struct key_t
+	{
+		std::uint64_t generation;  // generation of the data the graph was created from, incremented whenever the data changes
+		graph_type type;
+		bool svg;  // format
+		bool dark;  // theme
+		std::size_t row_limit;  // see graph_options
+		time_range range;  // see graph_options
+		uuid_t player{};  // for graph_type::player
+		graph_size size = graph_size::full;  // for png
+
+		[[nodiscard]] bool operator==(const key_t&) const = default;
+	};
+
+	// called with the rendered contents, or null if the render didn't happen (e.g. its deadline passed)
+	using render_callback_t = std::function<void(std::shared_ptr<const std::string>)>;
+
+	enum class render_wait : std::uint8_t
+	{
+		joined,  // an identical render was already running, the callback is called when it finishes
+		started  // none was, the caller has to render and call finish_render
+	};
+
+private:
+	struct entry_t
+	{
+		key_t key;
+		std::shared_ptr<const std::string> contents;
+		std::chrono::steady_clock::time_point expiry;
+		std::string url;  // of the contents uploaded as an attachment, empty if unknown
+		std::chrono::system_clock::time_point url_expiry;
+	};
+
+	struct pending_t
+	{
+		key_t key;
+		std::vector<render_callback_t> callbacks;
+	};
+
+	std::mutex mutex;
+	std::vector<entry_t> entries;  // all have the same generation
+	// renders that have been started and not finished, so identical requests wait for them instead of rendering again
+	// (there are at most a few, one per render thread and queued render)
+	std::vector<pending_t> pending;
+
+public:
+	// @return cached contents, or null if they aren't cached or have expired
+	[[nodiscard]] std::shared_ptr<const std::string> find(const key_t& key)
+	{
+		std::scoped_lock lock(mutex);
+		const auto it = std::ranges::find(entries, key, &entry_t::key);
+		if (it == entries.end() || std::chrono::steady_clock::now() >= it->expiry)
+			{ return nullptr; }
+		return it->contents;
+	}
+
+	// @return url of the cached contents uploaded as an attachment, or empty string if it isn't known, has expired or the contents have
+	[[nodiscard]] std::string find_url(const key_t& key)
+	{
+		std::scoped_lock lock(mutex);
+		const auto it = std::ranges::find(entries, key, &entry_t::key);
+		if (it == entries.end() || std::chrono::steady_clock::now() >= it->expiry || std::chrono::system_clock::now() >= it->url_expiry)
+			{ return {}; }
+		return it->url;
+	}
+
+	// remember where the cached contents were uploaded, so they can be linked to instead of being uploaded again
+	// does nothing if key isn't cached (or was cached again since, but the contents are the same then)
+	// @param url_expiry  time after which the url stops working
+	void set_url(const key_t& key, std::string url, std::chrono::system_clock::time_point url_expiry)
+	{
+		std::scoped_lock lock(mutex);
+		const auto it = std::ranges::find(entries, key, &entry_t::key);
+		if (it != entries.end())
+		{
+			it->url = std::move(url);
+			it->url_expiry = url_expiry;
+		}
+	}
+
+	// @param expiry  time after which contents are outdated even if the data doesn't change
+	//                (graphs with online players extend to the time they were created)
+	void insert(const key_t& key, std::shared_ptr<const std::string> contents, std::chrono::steady_clock::time_point expiry)
+	{
+		std::scoped_lock lock(mutex);
+		if (!entries.empty())
+		{
+			const std::uint64_t cur_generation = entries.front().key.generation;
+			if (key.generation < cur_generation)
+				{ return; }  // rendered from old data while newer data was cached
+			if (key.generation > cur_generation)
+				{ entries.clear(); }
+		}
+		const auto it = std::ranges::find(entries, key, &entry_t::key);
+		if (it != entries.end())
+			{ *it = { key, std::move(contents), expiry, {}, {} }; }
+		else
+			{ entries.emplace_back(key, std::move(contents), expiry, std::string(), std::chrono::system_clock::time_point()); }
+	}
+
+	// @return whether a render of `key` has been started and not finished
+	[[nodiscard]] bool rendering(const key_t& key)
+	{
+		std::scoped_lock lock(mutex);
+		return std::ranges::find(pending, key, &pending_t::key) != pending.end();
+	}
+
+	// wait for the render of `key`, which is started by the caller if it isn't running yet
+	// @param callback  called by finish_render, possibly on another thread
+	[[nodiscard]] render_wait await_render(const key_t& key, render_callback_t callback)
+	{
+		std::scoped_lock lock(mutex);
+		const auto it = std::ranges::find(pending, key, &pending_t::key);
+		if (it != pending.end())
+		{
+			it->callbacks.push_back(std::move(callback));
+			return render_wait::joined;
+		}
+		pending.emplace_back(key, std::vector{ std::move(callback) });
+		return render_wait::started;
+	}
+
+	// call everything waiting for the render of `key` with its result, after render_wait::started
+	// @param contents  null if it wasn't rendered
+	void finish_render(const key_t& key, const std::shared_ptr<const std::string>& contents)
+	{
+		std::vector<render_callback_t> callbacks;
+		{
+			std::scoped_lock lock(mutex);
+			const auto it = std::ranges::find(pending, key, &pending_t::key);
+			if (it == pending.end())
+				{ return; }
+			callbacks = std::move(it->callbacks);
+			pending.erase(it);
+		}
+		// called without the lock, since they may look up the cache (e.g. resuming a coroutine)
+		for (const auto& callback : callbacks)
+			{ callback(contents); }
+	}
+
+	// forget every graph, e.g. after the options they were rendered with changed
+	void clear()
+	{
+		std::scoped_lock lock(mutex);
+		entries.clear();
+	}
+
+	// @return memory used by cached graphs (see memory_usage), contents are counted even if a reply still holds them
+	[[nodiscard]] memory_usage memory_used()
+	{
+		std::scoped_lock lock(mutex);
+		memory_usage res{ .bytes = detail::vector_heap_bytes(entries) };
+		for (const entry_t& entry : entries)
+			{ res.string_bytes += detail::string_heap_bytes(*entry.contents) + detail::string_heap_bytes(entry.url); }
+		res.bytes += res.string_bytes;
+		return res;
+	}
+};
+
+#endif
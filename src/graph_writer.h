@@ -0,0 +1,840 @@
+#ifndef GRAPH_WRITER_H
+#define GRAPH_WRITER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <plutovg.h>
+
+#include "line_splitter.h"
+#include "png_encoder.h"
+#include "text_metrics.h"
+
+// outputs for the graph layout (see detail::draw_graph)
+// both draw the same elements: svg_graph_writer writes them as svg, png_graph_writer rasterizes them directly with plutovg
+// the same way lunasvg would render the svg (2x scale, transparent background), without creating or parsing the svg, and encodes them with encode_png
+
+namespace detail
+{
+	// dominant-baseline
+	enum class text_baseline { middle, hanging };
+
+	// color of labels and axes that depends on the theme. in an svg it follows the viewer's light or dark color scheme (see svg_graph_writer::begin),
+	// a png is drawn with its theme color, and everything else can be shared by both themes (see png_graph_writer::layer)
+	inline constexpr std::string_view adaptive_color = "currentColor";
+
+	// coordinate or size written to an svg with two decimals at most (1/100 of a unit is 1/50 of a pixel in the png), as a fixed-point integer
+	// with to_chars, instead of the shortest representation that round trips, which is slower and longer for most values
+	struct svg_number
+	{
+		double value;
+	};
+}
+
+template<>
+struct std::formatter<detail::svg_number, char>
+{
+	constexpr auto parse(std::format_parse_context& ctx) const
+	{
+		const auto it = ctx.begin(), end = ctx.end();
+		if (it == end || *it == '}')
+			{ return it; }
+		return end;
+	}
+
+	auto format(detail::svg_number number, std::format_context& context) const
+	{
+		std::array<char, 24> chars;
+		char* it = chars.data();
+		std::int64_t hundredths = std::llround(number.value * 100);
+		if (hundredths < 0)
+		{
+			*it++ = '-';
+			hundredths = -hundredths;
+		}
+		it = std::to_chars(it, chars.data() + chars.size(), hundredths / 100).ptr;
+		// trailing zeros of the fraction aren't written, like the shortest representation
+		if (const int fraction = static_cast<int>(hundredths % 100); fraction != 0)
+		{
+			*it++ = '.';
+			*it++ = static_cast<char>('0' + fraction / 10);
+			if (fraction % 10 != 0)
+				{ *it++ = static_cast<char>('0' + fraction % 10); }
+		}
+		return std::copy(chars.data(), it, context.out());
+	}
+};
+
+namespace detail
+{
+	// append `text` to `out` with the characters xml gives a meaning to replaced by entities, so it can be text content or an attribute value
+	// the runs between them (usually all of the text) are found with simd (see find_any_of) and appended at once, instead of a character at a time
+	inline void append_xml_escaped(std::string& out, std::string_view text)
+	{
+		const char* it = text.data();
+		const char* const end = it + text.size();
+		while (true)
+		{
+			const char* const special = find_any_of<'<', '>', '&', '"', '\''>(it, end);
+			out.append(it, special);
+			if (special == end)
+				{ return; }
+			switch (*special)
+			{
+			case '<': out += "&lt;"; break;
+			case '>': out += "&gt;"; break;
+			case '&': out += "&amp;"; break;
+			case '"': out += "&quot;"; break;
+			default: out += "&apos;"; break;
+			}
+			it = special + 1;
+		}
+	}
+
+	class svg_graph_writer
+	{
+	private:
+		std::string svg_data;
+		bool row_paths;
+		bool adaptive_colors;
+
+		[[nodiscard]] static constexpr std::string_view anchor_name(text_anchor anchor)
+		{
+			switch (anchor)
+			{
+			case text_anchor::start: return "start";
+			case text_anchor::middle: return "middle";
+			default: return "end";
+			}
+		}
+
+		// append to the document without a temporary string
+		template<typename... Args>
+		void write(std::format_string<Args...> fmt, Args&&... args)
+			{ std::format_to(std::back_inserter(svg_data), fmt, std::forward<Args>(args)...); }
+
+	public:
+		// @param row_paths  whether to write each row of bars as one <path> instead of a <rect> for each bar (much smaller)
+		// @param adaptive_colors  whether to set the color adaptive_color stands for with css
+		// @param reserve  expected size of the document (see graph_size_estimator), so it is allocated once
+		svg_graph_writer(bool row_paths, bool adaptive_colors = false, std::size_t reserve = 0) : row_paths(row_paths), adaptive_colors(adaptive_colors)
+			{ svg_data.reserve(reserve); }
+
+		// must be called first
+		// @param view_x, view_y  user coordinates of the top left corner
+		void begin(double width, double height, double view_x, double view_y)
+		{
+			write("<svg width=\"{0}\" height=\"{1}\" viewBox=\"{2} {3} {0} {1}\" xmlns=\"http://www.w3.org/2000/svg\">\n",
+				svg_number(width), svg_number(height), svg_number(view_x), svg_number(view_y));
+			// black like the light theme, white like the dark one. an embedding page can override it by setting color on the svg
+			if (adaptive_colors)
+				{ svg_data += "<style>svg{color:black}@media (prefers-color-scheme:dark){svg{color:white}}</style>\n"; }
+		}
+
+		// @param monospace  whether to ask for a monospace font
+		// @param text  escaped as it is written, so it can be anything (e.g. a server's name)
+		void text(double x, double y, double size, bool monospace, std::string_view color, text_anchor anchor, text_baseline baseline, std::string_view text)
+		{
+			write("<text x=\"{}\" y=\"{}\" font-size=\"{}\"{} fill=\"{}\" text-anchor=\"{}\" dominant-baseline=\"{}\">",
+				svg_number(x), svg_number(y), svg_number(size), monospace ? " font-family=\"monospace\"" : "", color, anchor_name(anchor),
+				(baseline == text_baseline::middle) ? "middle" : "hanging");
+			append_xml_escaped(svg_data, text);
+			svg_data += "</text>\n";
+		}
+
+		void line(double x1, double y1, double x2, double y2, std::string_view color, double width)
+		{
+			write("<line x1=\"{}\" y1=\"{}\" x2=\"{}\" y2=\"{}\" stroke=\"{}\" stroke-width=\"{}\"/>\n",
+				svg_number(x1), svg_number(y1), svg_number(x2), svg_number(y2), color, svg_number(width));
+		}
+
+		void rect(double x, double y, double width, double height, std::string_view color)
+		{
+			write("<rect x=\"{}\" y=\"{}\" width=\"{}\" height=\"{}\" fill=\"{}\"/>\n", svg_number(x), svg_number(y), svg_number(width), svg_number(height), color);
+		}
+
+		// bars of the same height and color in one row
+		// @param bars  x and width of each bar
+		void bar_row(double y, double height, std::string_view color, std::span<const std::pair<double, double>> bars)
+		{
+			if (!row_paths)
+			{
+				for (const auto& [x, width] : bars)
+					{ rect(x, y, width, height, color); }
+				return;
+			}
+			if (bars.empty())
+				{ return; }
+			svg_data += "<path d=\"";
+			for (const auto& [x, width] : bars)
+				{ write("M{} {}h{}v{}h{}z", svg_number(x), svg_number(y), svg_number(width), svg_number(height), svg_number(-width)); }
+			write("\" fill=\"{}\"/>\n", color);
+		}
+
+		// @param points  x and y of each corner
+		void polygon(std::span<const std::pair<double, double>> points, std::string_view color)
+		{
+			if (points.empty())
+				{ return; }
+			svg_data += "<path d=\"M";
+			for (const auto& [x, y] : points)
+				{ write("{} {} ", svg_number(x), svg_number(y)); }
+			write("z\" fill=\"{}\"/>\n", color);
+		}
+
+		// @return svg data
+		[[nodiscard]] std::string finish()
+		{
+			svg_data += "</svg>";
+			return std::move(svg_data);
+		}
+	};
+
+	// coverage of rasterized labels, kept between renders: most labels (player names, dates, hours) are the same in every render,
+	// and shaping and rasterizing them is a large part of rasterizing a graph. a sprite doesn't depend on the color, so both themes use it
+	// labels are rasterized at the same subpixel offset they are drawn at, so a sprite is exactly what drawing the text would give
+	// one per render thread like text_metrics, whose face it uses
+	class label_sprite_cache
+	{
+	public:
+		struct sprite
+		{
+			int left, top;  // of the mask, relative to the pixel the text's origin is in
+			int width, height;
+			std::vector<std::uint8_t> mask;  // coverage, see blend_mask
+			std::uint64_t last_use;
+		};
+
+	private:
+		struct string_hash
+		{
+			using is_transparent = void;
+			[[nodiscard]] std::size_t operator()(std::string_view str) const noexcept
+				{ return std::hash<std::string_view>()(str); }
+		};
+
+		static constexpr std::size_t max_bytes = std::size_t(8) << 20;  // per thread. about a dozen large graphs' labels at 2x
+
+		// the font size and subpixel origin (as bytes) followed by the text
+		std::unordered_map<std::string, sprite, string_hash, std::equal_to<>> sprites;
+		std::string lookup_key;  // reused
+		std::size_t bytes = 0;
+		std::uint64_t use_count = 0;
+
+		[[nodiscard]] static std::atomic<std::size_t>& total_bytes()
+		{
+			static std::atomic<std::size_t> instance = 0;
+			return instance;
+		}
+
+		label_sprite_cache() = default;
+
+		[[nodiscard]] static sprite rasterize(std::string_view text, float size, float origin_x, float origin_y)
+		{
+			sprite res{};
+			plutovg_font_face_t* face = text_metrics::get().get_face();
+			plutovg_rect_t extents;
+			plutovg_font_face_text_extents(face, size, text.data(), static_cast<int>(text.size()), PLUTOVG_TEXT_ENCODING_UTF8, &extents);
+			// a pixel of margin for antialiasing
+			res.left = static_cast<int>(std::floor(origin_x + extents.x)) - 1;
+			res.top = static_cast<int>(std::floor(origin_y + extents.y)) - 1;
+			res.width = static_cast<int>(std::ceil(origin_x + extents.x + extents.w)) + 1 - res.left;
+			res.height = static_cast<int>(std::ceil(origin_y + extents.y + extents.h)) + 1 - res.top;
+			const surface_ptr surface(plutovg_surface_create(res.width, res.height));
+			if (!surface)
+				{ throw std::runtime_error("Graph surface creation failed."); }
+			plutovg_canvas_t* canvas = plutovg_canvas_create(surface.get());
+			plutovg_canvas_set_rgb(canvas, 1, 1, 1);
+			plutovg_canvas_set_font(canvas, face, size);
+			plutovg_canvas_fill_text(canvas, text.data(), static_cast<int>(text.size()), PLUTOVG_TEXT_ENCODING_UTF8,
+				origin_x - static_cast<float>(res.left), origin_y - static_cast<float>(res.top));
+			plutovg_canvas_destroy(canvas);
+			res.mask.resize(static_cast<std::size_t>(res.width) * res.height);
+			const int stride = plutovg_surface_get_stride(surface.get());
+			const unsigned char* data = plutovg_surface_get_data(surface.get());
+			for (int y = 0; y < res.height; y++)
+			{
+				const auto* row = reinterpret_cast<const std::uint32_t*>(data + static_cast<std::size_t>(stride) * y);
+				for (int x = 0; x < res.width; x++)
+					{ res.mask[static_cast<std::size_t>(res.width) * y + x] = static_cast<std::uint8_t>(row[x] >> 24); }
+			}
+			return res;
+		}
+
+		// remove the least recently used half of the sprites
+		void evict()
+		{
+			std::vector<std::uint64_t> uses;
+			uses.reserve(sprites.size());
+			for (const auto& [key, cur] : sprites)
+				{ uses.push_back(cur.last_use); }
+			const auto median = uses.begin() + static_cast<std::ptrdiff_t>(uses.size() / 2);
+			std::ranges::nth_element(uses, median);
+			const std::uint64_t threshold = *median;
+			const std::size_t old_bytes = bytes;
+			std::erase_if(sprites, [this, threshold](const auto& entry)
+			{
+				if (entry.second.last_use >= threshold)
+					{ return false; }
+				bytes -= entry.first.size() + entry.second.mask.size();
+				return true;
+			});
+			total_bytes() -= old_bytes - bytes;
+		}
+
+	public:
+		label_sprite_cache(const label_sprite_cache&) = delete;
+		label_sprite_cache& operator=(const label_sprite_cache&) = delete;
+		~label_sprite_cache()
+			{ total_bytes() -= bytes; }
+
+		[[nodiscard]] static label_sprite_cache& get()
+		{
+			thread_local label_sprite_cache instance;
+			return instance;
+		}
+
+		// @return bytes of the sprites of every thread
+		[[nodiscard]] static std::size_t memory_used() noexcept
+			{ return total_bytes(); }
+
+		// this thread's face must not be null
+		// @param size  font size in pixels
+		// @param origin_x, origin_y  position of the text's origin within its pixel, in [0, 1)
+		// @return sprite of `text`, valid until the next call
+		[[nodiscard]] const sprite& find(std::string_view text, float size, float origin_x, float origin_y)
+		{
+			lookup_key.clear();
+			for (const float n : { size, origin_x, origin_y })
+			{
+				const auto n_bytes = std::bit_cast<std::array<char, sizeof(float)>>(n);
+				lookup_key.append(n_bytes.data(), n_bytes.size());
+			}
+			lookup_key += text;
+			use_count++;
+			if (const auto it = sprites.find(std::string_view(lookup_key)); it != sprites.end())
+			{
+				it->second.last_use = use_count;
+				return it->second;
+			}
+			sprite new_sprite = rasterize(text, size, origin_x, origin_y);
+			new_sprite.last_use = use_count;
+			const std::size_t new_bytes = lookup_key.size() + new_sprite.mask.size();
+			if (bytes + new_bytes > max_bytes && !sprites.empty())
+				{ evict(); }
+			bytes += new_bytes;
+			total_bytes() += new_bytes;
+			return sprites.emplace(lookup_key, std::move(new_sprite)).first->second;
+		}
+	};
+
+	class png_graph_writer
+	{
+	public:
+		static constexpr float scale = 2;  // pixels per svg unit, unless a png at this scale would be too large (see graph_size_estimator)
+		// smaller versions that can be made of the same rasterization (see finish): 1x for the web, and a thumbnail. powers of 2, ascending
+		static constexpr std::array<int, 2> variant_divisors = { 2, 8 };
+
+		// which elements are drawn
+		enum class layer : std::uint8_t
+		{
+			all,
+			shared,  // everything not in adaptive_color, which is the same for both themes
+			theme  // only adaptive_color
+		};
+
+	private:
+		// an element to draw. elements are recorded and rasterized together (see rasterize), so bands of a large graph can be drawn in parallel
+		struct command
+		{
+			enum class shape : std::uint8_t { text, line, spans, polygon };
+
+			shape kind;
+			plutovg_color_t color;
+			float top, bottom;  // pixel rows it can draw to (more for text), so bands skip the rest
+			// text: origin x, y and font size in pixels. line: x1, y1, x2, y2 and width in svg units (drawn with the canvas' matrix)
+			// spans: top and bottom in pixels
+			std::array<float, 5> values;
+			std::size_t begin, end;  // text: in texts. spans: columns in column_spans. polygon: corners in polygon_points
+		};
+
+		static constexpr int min_band_rows = 256;  // a graph is only split into bands (see band_pool) if each gets at least this many rows
+
+		pixel_buffer_pool::buffer pixels;  // of surface, reused between renders (see pixel_buffer_pool)
+		plutovg_surface_t* surface = nullptr;
+		int compression_level;
+		float pixel_scale;
+		std::string_view theme_color;
+		layer cur_layer = layer::all;
+		const plutovg_surface_t* base = nullptr;
+		float offset_x = 0, offset_y = 0;  // pixel position of the view's origin
+		// drawn since the last rasterize
+		std::pmr::vector<command> commands;
+		std::pmr::string texts;
+		std::pmr::vector<pixel_span> column_spans;
+		std::pmr::vector<std::pair<float, float>> polygon_points;
+		text_metrics& metrics = text_metrics::get();
+
+		[[nodiscard]] bool in_layer(std::string_view color) const noexcept
+			{ return cur_layer == layer::all || ((color == adaptive_color) == (cur_layer == layer::theme)); }
+
+		[[nodiscard]] plutovg_color_t parse_color(std::string_view color) const
+		{
+			if (color == adaptive_color)
+				{ color = theme_color; }
+			plutovg_color_t c;
+			if (plutovg_color_parse(&c, color.data(), static_cast<int>(color.size())) == 0)
+				{ plutovg_color_init_rgb(&c, 0, 0, 0); }  // like lunasvg, which uses the initial value (black) for fill
+			return c;
+		}
+
+		// record the rectangles from y to y + height and each of column_spans since `first_span`
+		void add_spans(double y, double height, std::string_view color, std::size_t first_span)
+		{
+			if (first_span == column_spans.size())
+				{ return; }
+			const float top = static_cast<float>(y) * pixel_scale + offset_y, bottom = top + static_cast<float>(height) * pixel_scale;
+			commands.push_back({ .kind = command::shape::spans, .color = parse_color(color), .top = top, .bottom = bottom, .values = { top, bottom },
+				.begin = first_span, .end = column_spans.size() });
+		}
+
+		// draw the commands that reach rows [band_top, band_bottom) of the surface, clipped to them
+		// called on any thread (see band_pool), so it only uses that thread's fonts and sprites
+		void rasterize_band(int band_top, int band_bottom) const
+		{
+			const int width = plutovg_surface_get_width(surface), stride = plutovg_surface_get_stride(surface);
+			const surface_ptr band(plutovg_surface_create_for_data(plutovg_surface_get_data(surface) + static_cast<std::size_t>(stride) * band_top,
+				width, band_bottom - band_top, stride));
+			if (!band)
+				{ throw std::runtime_error("Graph surface creation failed."); }
+			plutovg_canvas_t* canvas = nullptr;  // only made if the band has lines or polygons
+			label_sprite_cache& sprites = label_sprite_cache::get();
+			std::vector<pixel_span> row_spans;
+			const float band_offset = static_cast<float>(band_top);
+			for (const command& cur : commands)
+			{
+				if (cur.bottom <= band_offset || cur.top >= static_cast<float>(band_bottom))
+					{ continue; }
+				if (cur.kind == command::shape::text)
+				{
+					const float x = cur.values[0], y = cur.values[1], size = cur.values[2];
+					const float floor_x = std::floor(x), floor_y = std::floor(y);
+					const auto& sprite = sprites.find(std::string_view(texts).substr(cur.begin, cur.end - cur.begin), size, x - floor_x, y - floor_y);
+					blend_mask(band.get(), premultiply_color(cur.color), sprite.mask, sprite.width, sprite.height,
+						static_cast<int>(floor_x) + sprite.left, static_cast<int>(floor_y) + sprite.top - band_top);
+				}
+				else if (cur.kind == command::shape::spans)
+				{
+					row_spans.clear();
+					append_pixel_spans(cur.values[0] - band_offset, cur.values[1] - band_offset, band_bottom - band_top, row_spans);
+					fill_pixel_spans(band.get(), premultiply_color(cur.color), row_spans, std::span(column_spans).subspan(cur.begin, cur.end - cur.begin));
+				}
+				else
+				{
+					if (canvas == nullptr)
+					{
+						canvas = plutovg_canvas_create(band.get());
+						const plutovg_matrix_t matrix = { pixel_scale, 0, 0, pixel_scale, offset_x, offset_y - band_offset };
+						plutovg_canvas_set_matrix(canvas, &matrix);
+						plutovg_canvas_set_fill_rule(canvas, PLUTOVG_FILL_RULE_NON_ZERO);
+						plutovg_canvas_set_operator(canvas, PLUTOVG_OPERATOR_SRC_OVER);
+					}
+					plutovg_canvas_set_color(canvas, &cur.color);
+					if (cur.kind == command::shape::line)
+					{
+						const auto& [x1, y1, x2, y2, line_width] = cur.values;
+						plutovg_canvas_set_line_width(canvas, line_width);
+						plutovg_canvas_set_miter_limit(canvas, 4);
+						plutovg_canvas_move_to(canvas, x1, y1);
+						plutovg_canvas_line_to(canvas, x2, y2);
+						plutovg_canvas_stroke(canvas);
+					}
+					else
+					{
+						plutovg_canvas_move_to(canvas, polygon_points[cur.begin].first, polygon_points[cur.begin].second);
+						for (std::size_t i = cur.begin + 1; i < cur.end; i++)
+							{ plutovg_canvas_line_to(canvas, polygon_points[i].first, polygon_points[i].second); }
+						plutovg_canvas_close_path(canvas);
+						plutovg_canvas_fill(canvas);
+					}
+				}
+			}
+			plutovg_canvas_destroy(canvas);
+		}
+
+	public:
+		// @param compression_level  see encode_png
+		// @param pixel_scale  pixels per svg unit
+		// @param theme_color  what adaptive_color is drawn as
+		// @param memory  of the elements recorded until they're rasterized (e.g. a render_arena's), only used by the thread drawing
+		explicit png_graph_writer(int compression_level, float pixel_scale = scale, std::string_view theme_color = "black",
+			std::pmr::memory_resource* memory = std::pmr::get_default_resource()) :
+			compression_level(compression_level), pixel_scale(pixel_scale), theme_color(theme_color), commands(memory), texts(memory), column_spans(memory),
+			polygon_points(memory) {}
+		png_graph_writer(const png_graph_writer&) = delete;
+		png_graph_writer& operator=(const png_graph_writer&) = delete;
+		~png_graph_writer()
+			{ plutovg_surface_destroy(surface); }
+
+		// draw only some elements from now on, e.g. the shared layer, then copy_surface, then the theme layer
+		void set_layer(layer new_layer) noexcept
+			{ cur_layer = new_layer; }
+
+		// start from a copy of `surface` (e.g. a shared layer) instead of a transparent surface, if it is the same size
+		// must be called before begin, and `surface` must outlive begin
+		void set_base(const plutovg_surface_t* surface_) noexcept
+			{ base = surface_; }
+
+		// must be called first. later calls (drawing another layer) do nothing
+		// @throws std::runtime_error if the surface can't be created
+		void begin(double width, double height, double view_x, double view_y)
+		{
+			if (surface != nullptr)
+				{ return; }
+			const int width_px = static_cast<int>(static_cast<float>(width) * pixel_scale), height_px = static_cast<int>(static_cast<float>(height) * pixel_scale);
+			if (width_px <= 0 || height_px <= 0)
+				{ throw std::runtime_error("Graph surface creation failed."); }
+			// transparent background, like a new surface
+			const std::size_t size = static_cast<std::size_t>(width_px) * height_px * 4;
+			pixels = pixel_buffer_pool::get().acquire(size);
+			if (base != nullptr && plutovg_surface_get_width(base) == width_px && plutovg_surface_get_height(base) == height_px &&
+				plutovg_surface_get_stride(base) == width_px * 4)
+				{ std::memcpy(pixels.data(), plutovg_surface_get_data(base), size); }
+			else
+				{ std::memset(pixels.data(), 0, size); }
+			surface = plutovg_surface_create_for_data(pixels.data(), width_px, height_px, width_px * 4);
+			offset_x = static_cast<float>(-view_x) * pixel_scale;
+			offset_y = static_cast<float>(-view_y) * pixel_scale;
+		}
+
+		// @param monospace  unused, since there is only one font (see text_metrics)
+		void text(double x, double y, double size, bool /*monospace*/, std::string_view color, text_anchor anchor, text_baseline baseline, std::string_view text)
+		{
+			if (metrics.get_face() == nullptr || !in_layer(color))
+				{ return; }
+			const float font_size = static_cast<float>(size);
+			// same position as lunasvg's text layout
+			float origin_x = static_cast<float>(x);
+			if (anchor != text_anchor::start)
+			{
+				const float width = metrics.text_width(text, font_size);
+				origin_x += (anchor == text_anchor::middle) ? -width / 2.f : -width;
+			}
+			const float baseline_offset = (baseline == text_baseline::middle) ? -metrics.x_height(font_size) / 2.f : -metrics.ascent(font_size) * 8.f / 10.f;
+			const float pixel_x = origin_x * pixel_scale + offset_x, pixel_y = (static_cast<float>(y) - baseline_offset) * pixel_scale + offset_y;
+			const float pixel_size = font_size * pixel_scale;
+			// glyphs (even accented ones) stay well within 1.5 font sizes of the baseline
+			commands.push_back({ .kind = command::shape::text, .color = parse_color(color), .top = pixel_y - pixel_size * 1.5f, .bottom = pixel_y + pixel_size * 1.5f,
+				.values = { pixel_x, pixel_y, pixel_size }, .begin = texts.size(), .end = texts.size() + text.size() });
+			texts += text;
+		}
+
+		void line(double x1, double y1, double x2, double y2, std::string_view color, double width)
+		{
+			if (!in_layer(color))
+				{ return; }
+			// a miter join can extend past the width, but a single line has no joins
+			const float half_width = static_cast<float>(width) * pixel_scale / 2 + 1;
+			const float top = static_cast<float>(std::min(y1, y2)) * pixel_scale + offset_y - half_width;
+			const float bottom = static_cast<float>(std::max(y1, y2)) * pixel_scale + offset_y + half_width;
+			commands.push_back({ .kind = command::shape::line, .color = parse_color(color), .top = top, .bottom = bottom,
+				.values = { static_cast<float>(x1), static_cast<float>(y1), static_cast<float>(x2), static_cast<float>(y2), static_cast<float>(width) } });
+		}
+
+		void rect(double x, double y, double width, double height, std::string_view color)
+		{
+			if (width <= 0 || height <= 0 || !in_layer(color))
+				{ return; }  // not rendered in svg, or in another layer
+			const std::size_t first_span = column_spans.size();
+			const float left = static_cast<float>(x) * pixel_scale + offset_x;
+			append_pixel_spans(left, left + static_cast<float>(width) * pixel_scale, plutovg_surface_get_width(surface), column_spans);
+			add_spans(y, height, color, first_span);
+		}
+
+		// bars of the same height and color in one row, filled together like one path: overlapping bars are joined first, and a
+		// pixel shared by the edges of two bars is covered by both
+		// @param bars  x and width of each bar, sorted by x
+		void bar_row(double y, double height, std::string_view color, std::span<const std::pair<double, double>> bars)
+		{
+			if (height <= 0 || !in_layer(color))
+				{ return; }
+			const int surface_width = plutovg_surface_get_width(surface);
+			const std::size_t first_span = column_spans.size();
+			float cur_begin = 0, cur_end = 0;  // bar being joined, empty if cur_begin == cur_end
+			for (const auto& [x, width] : bars)
+			{
+				if (width <= 0)
+					{ continue; }
+				const float begin = static_cast<float>(x) * pixel_scale + offset_x, end = begin + static_cast<float>(width) * pixel_scale;
+				if (cur_begin < cur_end && begin >= cur_begin && begin <= cur_end)
+					{ cur_end = std::max(cur_end, end); }
+				else
+				{
+					append_pixel_spans(cur_begin, cur_end, surface_width, column_spans);
+					cur_begin = begin;
+					cur_end = end;
+				}
+			}
+			append_pixel_spans(cur_begin, cur_end, surface_width, column_spans);
+			add_spans(y, height, color, first_span);
+		}
+
+		// @param points  x and y of each corner
+		void polygon(std::span<const std::pair<double, double>> points, std::string_view color)
+		{
+			if (points.empty() || !in_layer(color))
+				{ return; }
+			const auto [min_y, max_y] = std::ranges::minmax(points | std::views::values);
+			commands.push_back({ .kind = command::shape::polygon, .color = parse_color(color),
+				.top = static_cast<float>(min_y) * pixel_scale + offset_y - 1, .bottom = static_cast<float>(max_y) * pixel_scale + offset_y + 1,
+				.values = {}, .begin = polygon_points.size(), .end = polygon_points.size() + points.size() });
+			for (const auto& [x, y] : points)
+				{ polygon_points.emplace_back(static_cast<float>(x), static_cast<float>(y)); }
+		}
+
+		// draw everything recorded since the last call (also done by copy_surface and finish). a large graph is split into bands of rows which are drawn in parallel,
+		// since every element only draws to the rows it covers
+		// @throws std::runtime_error if a band's surface can't be created
+		void rasterize()
+		{
+			if (commands.empty())
+				{ return; }
+			const int height = plutovg_surface_get_height(surface);
+			band_pool& bands = band_pool::get();
+			const std::size_t num_bands = bands.bands_for(height, min_band_rows);
+			bands.run(num_bands, [this, height, num_bands](std::size_t band)
+			{
+				const auto [begin, end] = band_pool::band_rows(height, band, num_bands);
+				rasterize_band(begin, end);
+			});
+			commands.clear();
+			texts.clear();
+			column_spans.clear();
+			polygon_points.clear();
+		}
+
+		// @throws std::runtime_error if the surface can't be created
+		// @return copy of what has been drawn so far
+		[[nodiscard]] surface_ptr copy_surface()
+		{
+			rasterize();
+			const int width = plutovg_surface_get_width(surface), height = plutovg_surface_get_height(surface);
+			surface_ptr res(plutovg_surface_create(width, height));
+			if (!res)
+				{ throw std::runtime_error("Graph surface creation failed."); }
+			for (int y = 0; y < height; y++)
+			{
+				std::memcpy(plutovg_surface_get_data(res.get()) + static_cast<std::size_t>(plutovg_surface_get_stride(res.get())) * y,
+					plutovg_surface_get_data(surface) + static_cast<std::size_t>(plutovg_surface_get_stride(surface)) * y, static_cast<std::size_t>(width) * 4);
+			}
+			return res;
+		}
+
+		// @throws std::runtime_error if png encoding fails
+		// @return png data
+		[[nodiscard]] std::string finish()
+		{
+			rasterize();
+			return encode_png(surface, compression_level);
+		}
+
+		// downsampling is much faster than rasterizing again, and each png is encoded on its own thread
+		// @param variants  receives the png downsampled by each of variant_divisors
+		// @throws std::runtime_error if png encoding fails
+		// @return png data
+		[[nodiscard]] std::string finish(std::vector<std::string>& variants)
+		{
+			rasterize();
+			std::vector<surface_ptr> downsampled;  // halved repeatedly
+			std::vector<const plutovg_surface_t*> targets;  // of each divisor
+			const plutovg_surface_t* cur = surface;
+			int cur_divisor = 1;
+			for (const int divisor : variant_divisors)
+			{
+				for (; cur_divisor < divisor; cur_divisor *= 2)
+				{
+					downsampled.push_back(downsample_surface_half(cur));
+					cur = downsampled.back().get();
+				}
+				targets.push_back(cur);
+			}
+			std::vector<std::future<std::string>> encoded;
+			for (const plutovg_surface_t* target : targets)
+				{ encoded.push_back(std::async(std::launch::async, [this, target]() { return encode_png(target, compression_level); })); }
+			std::string res = encode_png(surface, compression_level);
+			variants.clear();
+			for (auto& cur_encoded : encoded)
+				{ variants.push_back(cur_encoded.get()); }
+			return res;
+		}
+	};
+
+	// rasterized shared layers (see png_graph_writer::layer) of recent graphs, so rendering a graph in the other theme only draws its labels
+	// only a couple are kept, since each is as large as the graph
+	class png_layer_cache
+	{
+	private:
+		struct entry_t
+		{
+			std::uint64_t key;
+			std::shared_ptr<const plutovg_surface_t> layer;
+		};
+
+		static constexpr std::size_t max_entries = 2;  // the latest graphs, which are the ones asked for in the other theme
+
+		std::mutex mutex;
+		std::vector<entry_t> entries;  // oldest first
+
+	public:
+		// @return layer inserted with `key`, or null if it isn't cached
+		[[nodiscard]] std::shared_ptr<const plutovg_surface_t> find(std::uint64_t key)
+		{
+			std::scoped_lock lock(mutex);
+			const auto it = std::ranges::find(entries, key, &entry_t::key);
+			return (it == entries.end()) ? nullptr : it->layer;
+		}
+
+		void insert(std::uint64_t key, surface_ptr layer)
+		{
+			std::scoped_lock lock(mutex);
+			std::erase_if(entries, [key](const entry_t& entry) { return entry.key == key; });
+			if (entries.size() >= max_entries)
+				{ entries.erase(entries.begin()); }
+			entries.emplace_back(key, std::shared_ptr<const plutovg_surface_t>(std::move(layer)));
+		}
+
+		// @return bytes of the cached layers' pixels
+		[[nodiscard]] std::size_t memory_used()
+		{
+			std::scoped_lock lock(mutex);
+			std::size_t res = 0;
+			for (const entry_t& entry : entries)
+				{ res += static_cast<std::size_t>(plutovg_surface_get_stride(entry.layer.get())) * plutovg_surface_get_height(entry.layer.get()); }
+			return res;
+		}
+	};
+
+	// counts what would be drawn, to estimate how large the png would be at each scale before rasterizing it, and how large the svg will be
+	// graphs are mostly flat areas, which deflate turns into long matches (a row the same as the one above is almost free),
+	// so the png's size mostly depends on how many edges there are, and antialiased text, rather than on the number of pixels
+	// the png estimate is rough and meant to be on the large side. encode_png's result is checked against the budget anyway
+	class graph_size_estimator
+	{
+	private:
+		double width = 0, height = 0;  // in svg units
+		double text_area = 0;  // sum of font size squared over all characters
+		std::size_t texts = 0, text_chars = 0, lines = 0, rects = 0, bar_rects = 0, polygon_points = 0;
+
+		// bars, rects, lines and polygon sides
+		[[nodiscard]] std::size_t edges() const noexcept
+			{ return 2 * (lines + rects + bar_rects) + polygon_points; }
+
+	public:
+		// scales that are tried, largest first
+		static constexpr std::array<float, 3> scales = { png_graph_writer::scale, 1.5f, 1 };
+
+		void begin(double width_, double height_, double /*view_x*/, double /*view_y*/)
+		{
+			width = width_;
+			height = height_;
+		}
+
+		void text(double /*x*/, double /*y*/, double size, bool /*monospace*/, std::string_view /*color*/, text_anchor /*anchor*/, text_baseline /*baseline*/,
+			std::string_view text)
+		{
+			texts++;
+			text_chars += text.size();
+			text_area += size * size * static_cast<double>(text.size());
+		}
+
+		void line(double /*x1*/, double /*y1*/, double /*x2*/, double /*y2*/, std::string_view /*color*/, double /*width*/)
+			{ lines++; }
+
+		void rect(double /*x*/, double /*y*/, double /*width*/, double /*height*/, std::string_view /*color*/)
+			{ rects++; }
+
+		void bar_row(double /*y*/, double /*height*/, std::string_view /*color*/, std::span<const std::pair<double, double>> bars)
+			{ bar_rects += bars.size(); }
+
+		void polygon(std::span<const std::pair<double, double>> points, std::string_view /*color*/)
+			{ polygon_points += points.size(); }
+
+		// @return estimated bytes of the png at `pixel_scale`
+		[[nodiscard]] std::size_t png_bytes(float pixel_scale) const
+		{
+			const double width_px = width * pixel_scale, height_px = height * pixel_scale;
+			// a row of flat color costs a few bytes per 258 byte match (at most 1 byte per pixel with a palette), plus its filter byte
+			const double rows = height_px * (width_px / 128 + 8);
+			// antialiased glyphs are mostly literals, about a bit per pixel of the glyph's box
+			const double glyphs = text_area * pixel_scale * pixel_scale / 8;
+			// each edge breaks the matches of its first rows and its antialiased rows, independent of scale
+			const double edge_bytes = 32 * static_cast<double>(edges());
+			constexpr double chunks = 1024;  // signature, header and palette
+			return static_cast<std::size_t>(rows + glyphs + edge_bytes + chunks);
+		}
+
+		// @return largest scale the png is estimated to fit in `max_bytes` at, `max_scale` or a smaller one of `scales`, or 0 if it doesn't at any of them
+		[[nodiscard]] float fit_scale(std::size_t max_bytes, float max_scale = png_graph_writer::scale) const
+		{
+			if (png_bytes(max_scale) <= max_bytes)
+				{ return max_scale; }
+			for (const float cur : scales)
+			{
+				if (cur < max_scale && png_bytes(cur) <= max_bytes)
+					{ return cur; }
+			}
+			return 0;
+		}
+
+		// @return bytes of the surface the png is rasterized into at `pixel_scale` (4 per pixel), which is most of the memory a render uses
+		[[nodiscard]] std::size_t surface_bytes(float pixel_scale) const
+			{ return static_cast<std::size_t>(std::ceil(width * pixel_scale) * std::ceil(height * pixel_scale) * 4); }
+
+		// @return largest scale whose surface fits in `max_bytes`, `max_scale` or a smaller one of `scales`, or 0 if it doesn't at any of them
+		[[nodiscard]] float fit_surface_scale(std::size_t max_bytes, float max_scale = png_graph_writer::scale) const
+		{
+			if (surface_bytes(max_scale) <= max_bytes)
+				{ return max_scale; }
+			for (const float cur : scales)
+			{
+				if (cur < max_scale && surface_bytes(cur) <= max_bytes)
+					{ return cur; }
+			}
+			return 0;
+		}
+
+		// @param row_paths  see svg_graph_writer
+		// @return bytes svg_graph_writer will write, a little more for most graphs (numbers are assumed to have 2 decimals)
+		[[nodiscard]] std::size_t svg_bytes(bool row_paths) const
+		{
+			// element markup, with attributes, numbers and colors
+			constexpr std::size_t text_bytes = 150, line_bytes = 90, rect_bytes = 80, bar_path_bytes = 40, point_bytes = 16, header_bytes = 256;
+			return header_bytes + texts * text_bytes + text_chars + lines * line_bytes + rects * rect_bytes + polygon_points * point_bytes +
+				bar_rects * (row_paths ? bar_path_bytes : rect_bytes);
+		}
+	};
+}
+
+#endif
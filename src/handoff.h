@@ -0,0 +1,217 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "logger.h"
+#include "net_socket.h"
+
+// handing the bot over from the process that is running to a new one (e.g. after an upgrade), so commands and the status are never stale
+// the running process listens on a loopback port (handoff_listener). a new process connects to it on startup (handoff_client), loads history
+// while the old one keeps serving, then tells it to save where it got to in latest.log (see latest_log_resume_t) and exit, and continues from there.
+// the request has a hash of the bot token, so a process that doesn't have the config can't make the bot exit
+// protocol (lines): new sends "QCV2HANDOFF <hash>", old replies "OK", later new sends "EXIT", old saves and exits (closing the connection)
+namespace detail
+{
+	inline constexpr std::string_view handoff_hello = "QCV2HANDOFF";
+	inline constexpr std::string_view handoff_address = "127.0.0.1";
+
+	// read a line, waiting at most `timeout_ms` (-1 for no limit) for each part of it
+	// @return line without the newline, or nullopt if the peer hung up or sent nothing in time
+	[[nodiscard]] inline std::optional<std::string> read_handoff_line(socket_t s, int timeout_ms)
+	{
+		constexpr std::size_t max_line_size = 256;
+		std::string line;
+		char c;
+		while (line.size() < max_line_size)
+		{
+			if (poll_socket(s, timeout_ms) <= 0 || recv(s, &c, 1, 0) != 1)
+				{ return std::nullopt; }
+			if (c == '\n')
+				{ return line; }
+			line.push_back(c);
+		}
+		return std::nullopt;
+	}
+}
+
+// in the running process: waits for a new process to take over, and exits once it has
+class handoff_listener
+{
+private:
+	using socket_t = detail::socket_t;
+	static constexpr int stop_check_ms = 500;  // how often the thread checks whether to stop
+	static constexpr int hello_timeout_ms = 2000;
+
+	std::uint64_t token_hash;
+	std::function<void()> before_exit;
+	socket_t listener = detail::invalid_socket;
+	std::atomic<bool> stopping = false;
+	std::thread thread;
+
+	// @return true if the new process asked to exit
+	[[nodiscard]] bool handle(socket_t client) const
+	{
+		const auto hello = detail::read_handoff_line(client, hello_timeout_ms);
+		if (!hello || *hello != std::format("{} {:016x}", detail::handoff_hello, token_hash))
+		{
+			log_message(log_severity::warning, "Ignoring handoff request without the bot's token hash (is the new process using another config?)");
+			return false;
+		}
+		if (!detail::send_all(client, "OK\n"))
+			{ return false; }
+		log_message(log_severity::info, "A new process is taking over, serving until it has loaded history");
+		// however long loading takes
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			const int res = detail::poll_socket(client, stop_check_ms);
+			if (res == 0)
+				{ continue; }
+			const auto line = (res > 0) ? detail::read_handoff_line(client, hello_timeout_ms) : std::nullopt;
+			if (line == "EXIT")
+				{ return true; }
+			log_message(log_severity::warning, "The new process went away before taking over, continuing to serve");
+			return false;
+		}
+		return false;
+	}
+
+	void run()
+	{
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			if (detail::poll_socket(listener, stop_check_ms) <= 0)
+				{ continue; }
+			const socket_t client = accept(listener, nullptr, nullptr);
+			if (client == detail::invalid_socket)
+				{ continue; }
+			if (handle(client))
+			{
+				before_exit();
+				log_message(log_severity::info, "Handed over to the new process, exiting");
+				// the connection is closed by exiting, which tells the new process it can continue
+				std::exit(0);
+			}
+			detail::close_socket(client);
+		}
+	}
+
+	void cleanup() noexcept
+	{
+		if (listener != detail::invalid_socket)
+		{
+			detail::close_socket(listener);
+			listener = detail::invalid_socket;
+		}
+		detail::cleanup_sockets();
+	}
+
+public:
+	// @param token_hash  detail::fnv1a hash of the bot token, which a new process has to send
+	// @param before_exit  called on the listener's thread before exiting, to save what the new process continues from
+	// @throws std::runtime_error if the port can't be listened on (e.g. another process is listening on it)
+	handoff_listener(std::uint16_t port, std::uint64_t token_hash, std::function<void()> before_exit) : token_hash(token_hash), before_exit(std::move(before_exit))
+	{
+		if (!detail::init_sockets())
+			{ throw std::runtime_error("Could not initialize sockets for handoff"); }
+		listener = detail::bind_socket(std::string(detail::handoff_address), port, SOCK_STREAM);
+		if (listener == detail::invalid_socket)
+		{
+			cleanup();
+			throw std::runtime_error(std::format("Could not listen for handoff on {}:{}", detail::handoff_address, port));
+		}
+		thread = std::thread([this]() { run(); });
+	}
+	handoff_listener(const handoff_listener&) = delete;
+	handoff_listener& operator=(const handoff_listener&) = delete;
+	~handoff_listener()
+	{
+		stopping = true;
+		if (thread.joinable())
+			{ thread.join(); }
+		cleanup();
+	}
+};
+
+// in a new process: takes over from the process that is running, if there is one
+class handoff_client
+{
+private:
+	using socket_t = detail::socket_t;
+
+	socket_t s = detail::invalid_socket;
+
+	explicit handoff_client(socket_t s) noexcept : s(s) {}
+
+public:
+	handoff_client(const handoff_client&) = delete;
+	handoff_client& operator=(const handoff_client&) = delete;
+	handoff_client(handoff_client&& other) noexcept : s(std::exchange(other.s, detail::invalid_socket)) {}
+	handoff_client& operator=(handoff_client&& other) noexcept
+	{
+		std::swap(s, other.s);
+		return *this;
+	}
+	~handoff_client()
+	{
+		if (s != detail::invalid_socket)
+		{
+			detail::close_socket(s);
+			detail::cleanup_sockets();
+		}
+	}
+
+	// @param token_hash  as given to the running process's handoff_listener
+	// @return client if a process is running and agreed to hand over, otherwise nullopt (e.g. none is running, so there is nothing to take over)
+	[[nodiscard]] static std::optional<handoff_client> connect(std::uint16_t port, std::uint64_t token_hash)
+	{
+		if (!detail::init_sockets())
+			{ return std::nullopt; }
+		handoff_client client(detail::connect_socket(std::string(detail::handoff_address), port));
+		if (client.s == detail::invalid_socket)
+		{
+			detail::cleanup_sockets();
+			return std::nullopt;
+		}
+		if (!detail::send_all(client.s, std::format("{} {:016x}\n", detail::handoff_hello, token_hash)) || detail::read_handoff_line(client.s, 5000) != "OK")
+			{ return std::nullopt; }
+		return client;
+	}
+
+	// tell the running process to save and exit, and wait until it has
+	// @param timeout  for it to exit
+	// @return false if it didn't exit in time (it may still be running)
+	[[nodiscard]] bool take_over(std::chrono::milliseconds timeout)
+	{
+		if (!detail::send_all(s, "EXIT\n"))
+			{ return false; }
+		// it sends nothing more, so this only returns once the connection is closed
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (true)
+		{
+			const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+			if (remaining <= std::chrono::milliseconds::zero())
+				{ return false; }
+			if (detail::poll_socket(s, static_cast<int>(remaining.count())) > 0)
+			{
+				char c;
+				if (recv(s, &c, 1, 0) <= 0)
+					{ return true; }
+			}
+		}
+	}
+};
+
+#endif
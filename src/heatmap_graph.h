@@ -0,0 +1,137 @@
+#ifndef HEATMAP_GRAPH_H
+#define HEATMAP_GRAPH_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "graph_writer.h"
+#include "parse_logs.h"
+#include "playtime_graph.h"
+#include "session_store.h"
+#include "text_metrics.h"
+
+/*
+SVG layout:
+ ____________________________________________________
+|              |               hours                 |
+|______________|_____________________________________|
+|              |                                     |
+|   weekdays   |  average players online in each     |
+|              |  hour of the week                   |
+|______________|_____________________________________|
+|                      caption                       |
+|____________________________________________________|
+*/
+
+inline constexpr double svg_heatmap_cell_height = svg_bar_stride;
+inline constexpr double svg_heatmap_hue = 215.0 / 360;
+inline constexpr double svg_heatmap_saturation = 0.7;
+// lightness of cells with no players online and with the most players online
+inline constexpr double svg_heatmap_min_lightness = 0.95, svg_heatmap_max_lightness = 0.3;
+
+namespace detail
+{
+	// @param frac  of the most players online, in [0, 1]
+	// @return color of a cell, and color of its text
+	inline std::pair<std::string, std::string_view> get_heatmap_colors(double frac)
+	{
+		const double lightness = svg_heatmap_min_lightness + (svg_heatmap_max_lightness - svg_heatmap_min_lightness) * frac;
+		const auto [red, green, blue] = hsl2rgb(svg_heatmap_hue, svg_heatmap_saturation, lightness);
+		return { std::format("#{:02X}{:02X}{:02X}", red, green, blue), (lightness > 0.6) ? "black" : "white" };
+	}
+
+	// @return text of a cell, empty if nobody was online
+	inline std::string get_heatmap_label(double average)
+		{ return (average == 0) ? std::string() : std::format("{:.1f}", average); }
+
+	// @param writer  svg_graph_writer or png_graph_writer
+	// @param averages  players online in each hour of the week (see weekly_playtime)
+	inline void draw_heatmap_graph(auto& writer, const std::array<double, weekly_playtime::num_hours>& averages, std::string_view color,
+		const std::chrono::time_zone* target_tz)
+	{
+		auto& metrics = text_metrics::get();
+		constexpr std::array<std::string_view, 7> weekday_names = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };  // see weekly_playtime
+
+		text_bounds bounds;
+		for (std::size_t day = 0; day < 7; day++)
+			{ bounds.add(-svg_pad, metrics.text_width(weekday_names[day], svg_fontsize), text_anchor::end); }
+		const double text_width = std::ceil(bounds.get_width() / 2.5) * 2.5;  // round up to multiple of 2.5
+		const double cell_width = std::floor((svg_width - (text_width + svg_pad)) / 24 / 2.5) * 2.5;  // round down to multiple of 2.5
+		const double hours_height = svg_date_fontsize + svg_pad;
+		const double data_height = svg_heatmap_cell_height * 7;
+		const double caption_height = svg_pad + svg_date_fontsize;
+
+		writer.begin(svg_width + 2 * svg_side_pad, hours_height + data_height + caption_height + 2 * svg_side_pad,
+			-(text_width + svg_pad) - svg_side_pad, -hours_height - svg_side_pad);
+
+		// hours (x-axis, at the top)
+		for (std::size_t hour = 0; hour < 24; hour++)
+			{ writer.text(cell_width * (hour + 0.5), -hours_height, svg_date_fontsize, false, color, text_anchor::middle, text_baseline::hanging, std::to_string(hour)); }
+
+		const double max_average = *std::ranges::max_element(averages);
+		for (std::size_t day = 0; day < 7; day++)
+		{
+			const double y = svg_heatmap_cell_height * day;
+			writer.text(-svg_pad, y + svg_heatmap_cell_height / 2, svg_fontsize, true, color, text_anchor::end, text_baseline::middle, weekday_names[day]);
+			for (std::size_t hour = 0; hour < 24; hour++)
+			{
+				const double average = averages[day * 24 + hour];
+				const auto [cell_color, text_color] = get_heatmap_colors((max_average == 0) ? 0 : average / max_average);
+				writer.rect(cell_width * hour, y, cell_width - svg_min_bar_gap, svg_heatmap_cell_height - svg_min_bar_gap, cell_color);
+				writer.text(cell_width * (hour + 0.5), y + svg_heatmap_cell_height / 2, svg_date_fontsize, false, text_color, text_anchor::middle, text_baseline::middle,
+					get_heatmap_label(average));
+			}
+		}
+
+		writer.text(cell_width * 12, data_height + svg_pad, svg_date_fontsize, false, color, text_anchor::middle, text_baseline::hanging,
+			std::format("average players online in each hour ({})", target_tz->name()));
+	}
+}
+
+// graph of the average number of players online in each hour of the week, in the graph time zone
+// history comes from sums per hour of the week for each segment (see graph_render_ctx::get_weekly_playtime),
+// so only recent sessions are gone through and the size of the graph doesn't depend on the data
+// options.row_limit and options.range are unused. players who are online count until the current time
+// the data is read in place, so it must not be modified while the graph is created
+// @tparam return_svg  whether to return svg data
+// @tparam render_to_png  whether to return rendered png data
+// @throws std::runtime_error if png rendering fails
+// @return pair of svg and png data if return_svg and render_to_png are both true, otherwise return single string containing data
+template<bool return_svg = true, bool render_to_png = false>
+inline auto create_heatmap_graph(const session_history& history, const log_data_t& recent, const parse_ctx_t& parse_ctx, const graph_options& options = {})
+{
+	static_assert(return_svg || render_to_png, "Graph must be either saved to svg or png");
+
+	std::optional<graph_render_ctx> temp_render_ctx;
+	graph_render_ctx& render_ctx = options.render_ctx ? *options.render_ctx : temp_render_ctx.emplace();
+	weekly_playtime playtime(render_ctx.get_timezone());
+	for (const auto& segment : history.get_segments())
+		{ playtime += *render_ctx.get_weekly_playtime(segment); }
+	for (const auto& [uuid, data] : recent)
+	{
+		for (const play_session& session : data.second.first)
+			{ playtime.add(session); }
+	}
+	const auto now = std::chrono::system_clock::now();
+	for (const std::uint32_t id : parse_ctx.player_info.online())
+	{
+		const auto& [uuid, join_time] = parse_ctx.player_info.infos()[id];
+		if (uuid)
+			{ playtime.add({ join_time.value(), now - join_time.value() }); }
+	}
+
+	std::array<double, weekly_playtime::num_hours> averages;
+	for (std::size_t i = 0; i < averages.size(); i++)
+		{ averages[i] = playtime.average_online(i); }
+	return detail::write_graph<return_svg, render_to_png>(options, [&](auto& writer)
+		{ detail::draw_heatmap_graph(writer, averages, options.color, render_ctx.get_timezone()); });
+}
+
+#endif
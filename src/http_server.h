@@ -0,0 +1,577 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <libdeflate.h>
+
+#include "binary_io.h"
+#include "live_feed.h"
+#include "logger.h"
+#include "net_socket.h"
+#include "websocket.h"
+
+struct http_request
+{
+	std::string_view method;
+	std::string_view path;  // without the query
+	std::string_view query;  // after the ?, still percent-encoded (see http_query_param)
+};
+
+struct http_response
+{
+	std::string_view status = "200 OK";
+	std::string_view content_type = "text/plain; charset=utf-8";
+	// shared so a cached body (e.g. a graph) is sent without being copied
+	std::shared_ptr<const std::string> body;
+	// start of the etag, e.g. the generation of the data the body is made from. the rest is a hash of the body,
+	// since some bodies change without the data changing (e.g. playtime of online players)
+	std::string etag_prefix;
+	bool compressible = false;  // sent gzip compressed if the client accepts it (not worth it for png)
+};
+
+namespace detail
+{
+	[[nodiscard]] constexpr char ascii_lower(char c) noexcept
+		{ return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+	[[nodiscard]] constexpr bool iequals(std::string_view lhs, std::string_view rhs) noexcept
+		{ return std::ranges::equal(lhs, rhs, {}, ascii_lower, ascii_lower); }
+
+	[[nodiscard]] constexpr std::string_view trim_spaces(std::string_view str) noexcept
+	{
+		while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+			{ str.remove_prefix(1); }
+		while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+			{ str.remove_suffix(1); }
+		return str;
+	}
+
+	// @param head  request line and headers
+	// @return value of header `name`, or empty if it wasn't sent
+	[[nodiscard]] constexpr std::string_view http_header(std::string_view head, std::string_view name) noexcept
+	{
+		for (std::size_t pos = head.find("\r\n"); pos != std::string_view::npos && pos + 2 < head.size(); )
+		{
+			const std::size_t line_start = pos + 2;
+			pos = head.find("\r\n", line_start);
+			const std::string_view line = head.substr(line_start, (pos == std::string_view::npos) ? std::string_view::npos : pos - line_start);
+			const std::size_t colon = line.find(':');
+			if (colon != std::string_view::npos && iequals(line.substr(0, colon), name))
+				{ return trim_spaces(line.substr(colon + 1)); }
+		}
+		return {};
+	}
+	static_assert(http_header("GET / HTTP/1.1\r\nHost: x\r\naccept-encoding:  gzip, br\r\n\r\n", "Accept-Encoding") == "gzip, br");
+	static_assert(http_header("GET / HTTP/1.1\r\nHost: x\r\n\r\n", "Accept-Encoding").empty());
+
+	// @return whether a comma-separated header value lists `token` without ;q=0 (e.g. gzip in Accept-Encoding)
+	[[nodiscard]] constexpr bool http_header_has_token(std::string_view value, std::string_view token) noexcept
+	{
+		while (!value.empty())
+		{
+			const std::size_t end = value.find(',');
+			const std::string_view item = value.substr(0, end);
+			value.remove_prefix((end == std::string_view::npos) ? value.size() : end + 1);
+			const std::size_t params = item.find(';');
+			if (!iequals(trim_spaces(item.substr(0, params)), token))
+				{ continue; }
+			if (params == std::string_view::npos)
+				{ return true; }
+			const std::string_view q = trim_spaces(item.substr(params + 1));
+			return !(q.starts_with("q=0") && q.find_first_not_of("0.", 3) == std::string_view::npos);
+		}
+		return false;
+	}
+	static_assert(http_header_has_token("gzip, br", "gzip") && http_header_has_token("br;q=1, GZIP;q=0.5", "gzip"));
+	static_assert(!http_header_has_token("gzip;q=0", "gzip") && !http_header_has_token("gzipx, br", "gzip") && !http_header_has_token("", "gzip"));
+}
+
+// @return value of query parameter `name`, percent-decoded, or empty optional if it isn't in `query`
+[[nodiscard]] inline std::optional<std::string> http_query_param(std::string_view query, std::string_view name)
+{
+	const auto hex_value = [](char c) -> int
+		{ return (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1; };
+	while (!query.empty())
+	{
+		const std::size_t end = query.find('&');
+		const std::string_view param = query.substr(0, end);
+		query.remove_prefix((end == std::string_view::npos) ? query.size() : end + 1);
+		const std::size_t equals = param.find('=');
+		if (param.substr(0, equals) != name)
+			{ continue; }
+		std::string res;
+		const std::string_view value = (equals == std::string_view::npos) ? std::string_view() : param.substr(equals + 1);
+		for (std::size_t i = 0; i < value.size(); i++)
+		{
+			if (value[i] == '+')
+				{ res += ' '; }
+			else if (value[i] == '%' && i + 2 < value.size() && hex_value(value[i + 1]) != -1 && hex_value(value[i + 2]) != -1)
+			{
+				res += static_cast<char>(hex_value(value[i + 1]) * 16 + hex_value(value[i + 2]));
+				i += 2;
+			}
+			else
+				{ res += value[i]; }
+		}
+		return res;
+	}
+	return std::nullopt;
+}
+
+// serves GET (and HEAD) requests over http/1.1 on its own thread, e.g. graphs and stats for dashboards
+// connections are kept alive and polled together, requests are handled one at a time in the order they arrive
+// bodies are sent straight from the response, and the etag and compressed copy of a body are kept for as long as it is (e.g. while a graph is cached),
+// so polling for something that is cached doesn't copy, hash or compress it again
+// with a live_feed, GET /live is a websocket its messages are pushed to. those clients' sockets don't block,
+// and what a client hasn't received yet is bounded: one that falls behind gets a snapshot once it catches up, instead of the messages it missed
+class http_server
+{
+private:
+	using socket_t = detail::socket_t;
+	using clock = std::chrono::steady_clock;
+
+	struct client_t
+	{
+		socket_t socket;
+		std::string received;  // start of the next request, or frames for a websocket
+		clock::time_point last_active;
+		// the rest is only used once the connection is a websocket
+		bool websocket = false;
+		bool needs_snapshot = false;  // instead of the next messages
+		std::deque<std::shared_ptr<const std::string>> outgoing;  // frames, shared by all clients that are sent them
+		std::size_t outgoing_offset = 0;  // sent of the first frame
+		std::size_t outgoing_bytes = 0;
+		clock::time_point last_ping;
+	};
+
+	// etag and compressed copy of a body, until it is freed
+	struct body_info_t
+	{
+		std::weak_ptr<const std::string> body;
+		std::uint64_t hash;
+		std::shared_ptr<const std::string> gzipped;  // null until a client accepts it
+	};
+
+	static constexpr int stop_check_ms = 500;  // how often the thread checks whether to stop
+	static constexpr std::size_t max_request_size = 8192;
+	static constexpr std::size_t max_clients = 1024;  // mostly live feed clients, which stay connected
+	static constexpr auto idle_timeout = std::chrono::seconds(60);
+	static constexpr std::size_t max_outgoing_bytes = 256 << 10;  // per websocket
+	static constexpr auto ping_interval = std::chrono::seconds(30);
+	static constexpr auto websocket_timeout = 3 * ping_interval;  // without hearing from the client (browsers answer pings)
+
+	std::function<http_response(const http_request&)> handler;
+	socket_t listener = detail::invalid_socket;
+	live_feed* feed;
+	// the feed sends to it when something is published, to wake the server from polling
+	socket_t wake_socket = detail::invalid_socket;
+	std::atomic<bool> wake_pending = false;
+	std::vector<client_t> clients;
+	std::vector<body_info_t> body_infos;
+	std::unique_ptr<libdeflate_compressor, decltype(&libdeflate_free_compressor)> compressor;
+	std::atomic<bool> stopping = false;
+	std::thread thread;
+
+	[[nodiscard]] body_info_t& get_body_info(const std::shared_ptr<const std::string>& body)
+	{
+		std::erase_if(body_infos, [](const body_info_t& info) { return info.body.expired(); });
+		const auto it = std::ranges::find_if(body_infos, [&body](const body_info_t& info) { return info.body.lock() == body; });
+		if (it != body_infos.end())
+			{ return *it; }
+		return body_infos.emplace_back(body, detail::fnv1a(*body), nullptr);
+	}
+
+	[[nodiscard]] std::shared_ptr<const std::string> gzip(const std::string& body)
+	{
+		std::string compressed(libdeflate_gzip_compress_bound(compressor.get(), body.size()), '\0');
+		compressed.resize(libdeflate_gzip_compress(compressor.get(), body.data(), body.size(), compressed.data(), compressed.size()));
+		return std::make_shared<const std::string>(std::move(compressed));
+	}
+
+	// @param head  request line and headers
+	// @return whether the connection can be kept open
+	[[nodiscard]] bool handle(client_t& client, std::string_view head)
+	{
+		const std::string_view request_line = head.substr(0, head.find("\r\n"));
+		const std::size_t target_start = request_line.find(' ') + 1;
+		const std::size_t target_end = request_line.find(' ', target_start);
+		if (target_start == 0 || target_end == std::string_view::npos)
+			{ return false; }
+		const std::string_view target = request_line.substr(target_start, target_end - target_start);
+		const std::size_t query_start = target.find('?');
+		const http_request request{ request_line.substr(0, target_start - 1), target.substr(0, query_start),
+			(query_start == std::string_view::npos) ? std::string_view() : target.substr(query_start + 1) };
+		const bool head_only = (request.method == "HEAD");
+		// http/1.1 connections are persistent unless the client says otherwise, 1.0 ones only if it asks
+		const std::string_view connection = detail::http_header(head, "Connection");
+		const bool keep_alive = request_line.ends_with("HTTP/1.1") ? !detail::http_header_has_token(connection, "close") :
+			detail::http_header_has_token(connection, "keep-alive");
+
+		http_response response;
+		// requests with a body aren't supported, so its end wouldn't be known
+		const bool has_body = !detail::http_header(head, "Content-Length").empty() || !detail::http_header(head, "Transfer-Encoding").empty();
+		if (feed && request.path == "/live" && request.method == "GET")
+		{
+			const std::string_view key = detail::http_header(head, "Sec-WebSocket-Key");
+			if (detail::http_header_has_token(detail::http_header(head, "Upgrade"), "websocket") && !key.empty() && !has_body)
+				{ return upgrade(client, key); }
+			response = { .status = "426 Upgrade Required", .body = std::make_shared<const std::string>("/live is a websocket\n") };
+		}
+		else if (request.method != "GET" && !head_only)
+			{ response = { .status = "405 Method Not Allowed", .body = std::make_shared<const std::string>("Only GET is supported\n") }; }
+		else
+		{
+			try
+			{
+				response = handler(request);
+			}
+			catch (const std::exception& e)
+			{
+				log_message(log_severity::error, std::format("HTTP request for {} failed: {}", target, e.what()));
+				response = { .status = "500 Internal Server Error", .body = std::make_shared<const std::string>("Internal server error\n") };
+			}
+		}
+		if (!response.body)
+			{ response.body = std::make_shared<const std::string>(); }
+
+		std::shared_ptr<const std::string> body = response.body;
+		std::string headers;
+		if (response.status.starts_with("200"))
+		{
+			body_info_t& info = get_body_info(response.body);
+			const std::string etag = std::format("\"{}-{:016x}\"", response.etag_prefix, info.hash);
+			// a client that has this body already doesn't need it again
+			if (const std::string_view if_none_match = detail::http_header(head, "If-None-Match"); !if_none_match.empty() &&
+				(if_none_match == "*" || if_none_match.find(etag) != std::string_view::npos))
+			{
+				response.status = "304 Not Modified";
+				body = nullptr;
+			}
+			else if (response.compressible && detail::http_header_has_token(detail::http_header(head, "Accept-Encoding"), "gzip"))
+			{
+				if (!info.gzipped)
+					{ info.gzipped = gzip(*response.body); }
+				body = info.gzipped;
+				headers += "Content-Encoding: gzip\r\n";
+			}
+			headers += std::format("ETag: {}\r\nCache-Control: no-cache\r\n", etag);
+			if (response.compressible)
+				{ headers += "Vary: Accept-Encoding\r\n"; }
+		}
+		if (body)
+			{ headers += std::format("Content-Type: {}\r\nContent-Length: {}\r\n", response.content_type, body->size()); }
+		headers = std::format("HTTP/1.1 {}\r\nConnection: {}\r\n{}\r\n", response.status, (keep_alive && !has_body) ? "keep-alive" : "close", headers);
+		if (!detail::send_all(client.socket, headers) || (body && !head_only && !detail::send_all(client.socket, *body)))
+			{ return false; }
+		return keep_alive && !has_body;
+	}
+
+	// switch a connection to a websocket for the live feed. it is sent a snapshot with the next messages (see deliver)
+	// @param key  Sec-WebSocket-Key
+	// @return whether the connection can be kept open
+	[[nodiscard]] bool upgrade(client_t& client, std::string_view key)
+	{
+		const std::string response = std::format("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: {}\r\n\r\n",
+			detail::websocket_accept_key(key));
+		if (!detail::send_all(client.socket, response) || !detail::set_nonblocking(client.socket))
+			{ return false; }
+		client.websocket = true;
+		client.needs_snapshot = true;
+		client.last_ping = clock::now();
+		return true;
+	}
+
+	void queue(client_t& client, std::shared_ptr<const std::string> frame)
+	{
+		client.outgoing_bytes += frame->size();
+		client.outgoing.push_back(std::move(frame));
+	}
+
+	// send as much of what is queued for a websocket as its socket takes without blocking
+	// @return false if the client hung up
+	[[nodiscard]] static bool flush(client_t& client)
+	{
+		while (!client.outgoing.empty())
+		{
+			const std::string& frame = *client.outgoing.front();
+			const auto num_sent = detail::send_some(client.socket, std::string_view(frame).substr(client.outgoing_offset));
+			if (!num_sent)
+				{ return false; }
+			if (num_sent.value() == 0)
+				{ break; }
+			client.outgoing_offset += num_sent.value();
+			client.outgoing_bytes -= num_sent.value();
+			if (client.outgoing_offset == frame.size())
+			{
+				client.outgoing.pop_front();
+				client.outgoing_offset = 0;
+			}
+		}
+		return true;
+	}
+
+	// handle the complete frames a websocket client sent. only pings and closing need an answer, messages are ignored
+	// @return false once the connection should be closed
+	[[nodiscard]] bool read_frames(client_t& client)
+	{
+		while (true)
+		{
+			const auto header = detail::parse_websocket_frame_header(client.received);
+			if (!header)
+				{ return client.received.size() <= max_request_size; }
+			// clients must mask frames, and nothing they would send is large
+			if (!header->masked || header->payload_size > max_request_size)
+				{ return false; }
+			if (client.received.size() < header->header_size + header->payload_size)
+				{ return true; }
+			std::string payload = client.received.substr(header->header_size, static_cast<std::size_t>(header->payload_size));
+			for (std::size_t i = 0; i < payload.size(); i++)
+				{ payload[i] = static_cast<char>(payload[i] ^ header->mask[i % 4]); }
+			client.received.erase(0, header->header_size + static_cast<std::size_t>(header->payload_size));
+			if (header->opcode == detail::websocket_opcode::close)
+			{
+				// answered with the same status, best effort since the connection is closed right after
+				std::ignore = detail::send_some(client.socket, detail::websocket_frame(detail::websocket_opcode::close, payload.substr(0, 2)));
+				return false;
+			}
+			if (header->opcode == detail::websocket_opcode::ping)
+				{ queue(client, std::make_shared<const std::string>(detail::websocket_frame(detail::websocket_opcode::pong, payload))); }
+		}
+	}
+
+	// read what a client sent and answer complete requests
+	// @return false once the connection should be closed
+	[[nodiscard]] bool read_client(client_t& client)
+	{
+		char buf[4096];
+		const auto num_read = recv(client.socket, buf, sizeof(buf), 0);
+		if (num_read <= 0)
+			{ return num_read < 0 && client.websocket && detail::last_error_would_block(); }
+		client.received.append(buf, static_cast<std::size_t>(num_read));
+		client.last_active = clock::now();
+		if (client.websocket)
+			{ return read_frames(client); }
+		// pipelined requests are answered in order
+		for (std::size_t head_end = client.received.find("\r\n\r\n"); head_end != std::string::npos; head_end = client.received.find("\r\n\r\n"))
+		{
+			const std::string head = client.received.substr(0, head_end);
+			client.received.erase(0, head_end + 4);
+			if (!handle(client, head))
+				{ return false; }
+			// anything after the upgrade request is frames
+			if (client.websocket)
+				{ return read_frames(client); }
+		}
+		return client.received.size() <= max_request_size;
+	}
+
+	// queue what was published to the live feed for websocket clients, and pings
+	// clients with too much queued already miss messages, and get a snapshot once they have received what was queued
+	void deliver()
+	{
+		std::vector<std::shared_ptr<const std::string>> frames;
+		const bool complete = feed->take(frames);
+		std::size_t frames_size = 0;
+		for (const auto& frame : frames)
+			{ frames_size += frame->size(); }
+		// made once for all clients that need it, after taking the messages so it includes them
+		std::shared_ptr<const std::string> snapshot;
+		bool snapshot_failed = false;
+		static const auto ping = std::make_shared<const std::string>(detail::websocket_frame(detail::websocket_opcode::ping, {}));
+		const auto now = clock::now();
+		for (client_t& client : clients)
+		{
+			if (!client.websocket)
+				{ continue; }
+			if (!complete || (!client.needs_snapshot && client.outgoing_bytes + frames_size > max_outgoing_bytes))
+				{ client.needs_snapshot = true; }
+			if (client.needs_snapshot && client.outgoing.empty() && !snapshot_failed)
+			{
+				if (!snapshot)
+				{
+					try
+					{
+						snapshot = std::make_shared<const std::string>(detail::websocket_frame(detail::websocket_opcode::text, feed->make_snapshot()));
+					}
+					catch (const std::exception& e)
+					{
+						log_message(log_severity::error, std::format("Could not make the live feed snapshot: {}", e.what()));
+						snapshot_failed = true;  // tried again with the next messages
+					}
+				}
+				if (snapshot)
+				{
+					queue(client, snapshot);
+					client.needs_snapshot = false;
+				}
+			}
+			else if (!client.needs_snapshot)
+			{
+				for (const auto& frame : frames)
+					{ queue(client, frame); }
+			}
+			if (now - client.last_ping >= ping_interval)
+			{
+				queue(client, ping);
+				client.last_ping = now;
+			}
+		}
+	}
+
+	void wake() noexcept
+	{
+		if (!wake_pending.exchange(true))
+			{ std::ignore = detail::send_some(wake_socket, std::string_view("", 1)); }
+	}
+
+	void accept_client()
+	{
+		const socket_t client = accept(listener, nullptr, nullptr);
+		if (client == detail::invalid_socket)
+			{ return; }
+		if (clients.size() >= max_clients)
+		{
+			detail::close_socket(client);
+			return;
+		}
+		clients.push_back({ client, std::string(), clock::now() });
+	}
+
+	void cleanup() noexcept
+	{
+		if (wake_socket != detail::invalid_socket)
+		{
+			detail::close_socket(wake_socket);
+			wake_socket = detail::invalid_socket;
+		}
+		for (const client_t& client : clients)
+			{ detail::close_socket(client.socket); }
+		clients.clear();
+		if (listener != detail::invalid_socket)
+		{
+			detail::close_socket(listener);
+			listener = detail::invalid_socket;
+		}
+		detail::cleanup_sockets();
+	}
+
+	void run()
+	{
+		std::vector<detail::pollfd_t> poll_fds;
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			poll_fds.clear();
+			poll_fds.push_back({ .fd = listener, .events = POLLIN, .revents = 0 });
+			if (wake_socket != detail::invalid_socket)
+				{ poll_fds.push_back({ .fd = wake_socket, .events = POLLIN, .revents = 0 }); }
+			const std::size_t clients_start = poll_fds.size();
+			for (const client_t& client : clients)
+				{ poll_fds.push_back({ .fd = client.socket, .events = static_cast<short>(client.outgoing.empty() ? POLLIN : POLLIN | POLLOUT), .revents = 0 }); }
+			if (detail::poll_sockets(poll_fds.data(), poll_fds.size(), stop_check_ms) < 0)
+				{ continue; }
+
+			// clients are read before new ones are accepted, so poll_fds matches clients
+			const auto now = clock::now();
+			std::size_t num_kept = 0;
+			for (std::size_t i = 0; i < clients.size(); i++)
+			{
+				client_t& client = clients[i];
+				const short revents = poll_fds[clients_start + i].revents;
+				bool keep = ((revents & (POLLIN | POLLHUP | POLLERR)) != 0) ? read_client(client) :
+					(now - client.last_active < (client.websocket ? websocket_timeout : idle_timeout));
+				if (keep && client.websocket)
+					{ keep = flush(client); }
+				if (!keep)
+					{ detail::close_socket(client.socket); }
+				else if (num_kept++ != i)
+					{ clients[num_kept - 1] = std::move(client); }
+			}
+			clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(num_kept), clients.end());
+			if (feed)
+			{
+				if ((poll_fds[1].revents & POLLIN) != 0)
+				{
+					// before taking the messages, so one published after that wakes the server again
+					wake_pending = false;
+					char buf[64];
+					while (recv(wake_socket, buf, sizeof(buf), 0) > 0) {}
+				}
+				deliver();
+				// sent now rather than after the next poll, which only waits for sockets with something queued to have room
+				std::erase_if(clients, [](client_t& client)
+				{
+					if (!client.websocket || client.outgoing.empty() || flush(client))
+						{ return false; }
+					detail::close_socket(client.socket);
+					return true;
+				});
+			}
+			if ((poll_fds[0].revents & POLLIN) != 0)
+				{ accept_client(); }
+		}
+	}
+
+public:
+	// @param address  ipv4 address to listen on, e.g. 127.0.0.1 for only this machine
+	// @param handler  called on the server's thread for each request
+	// @param feed  pushed to websocket clients of /live, none if null. must outlive the server
+	// @throws std::runtime_error if the address is invalid or can't be listened on
+	http_server(const std::string& address, std::uint16_t port, std::function<http_response(const http_request&)> handler, live_feed* feed = nullptr)
+		: handler(std::move(handler)), feed(feed), compressor(libdeflate_alloc_compressor(6), &libdeflate_free_compressor)
+	{
+		if (!compressor)
+			{ throw std::runtime_error("Could not allocate compressor for the http server"); }
+		if (!detail::init_sockets())
+			{ throw std::runtime_error("Could not initialize sockets for the http server"); }
+		listener = detail::bind_socket(address, port, SOCK_STREAM);
+		if (listener == detail::invalid_socket)
+		{
+			cleanup();
+			throw std::runtime_error(std::format("Could not listen for http on {}:{} (is it a valid ipv4 address?)", address, port));
+		}
+		if (feed)
+		{
+			// a udp socket connected to itself, so it can be sent to without an address
+			wake_socket = detail::bind_socket("127.0.0.1", 0, SOCK_DGRAM);
+			sockaddr_in wake_addr{};
+			socklen_t wake_addr_size = sizeof(wake_addr);
+			if (wake_socket == detail::invalid_socket || getsockname(wake_socket, reinterpret_cast<sockaddr*>(&wake_addr), &wake_addr_size) != 0
+				|| connect(wake_socket, reinterpret_cast<const sockaddr*>(&wake_addr), wake_addr_size) != 0 || !detail::set_nonblocking(wake_socket))
+			{
+				cleanup();
+				throw std::runtime_error("Could not create the socket that wakes the http server for the live feed");
+			}
+			feed->set_notify([this]() { wake(); });
+		}
+		thread = std::thread([this]() { run(); });
+		log_message(log_severity::info, std::format("Serving graphs and stats on http://{}:{}/", address, port));
+	}
+	http_server(const http_server&) = delete;
+	http_server& operator=(const http_server&) = delete;
+	~http_server()
+	{
+		if (feed)
+			{ feed->set_notify(nullptr); }
+		stopping = true;
+		if (thread.joinable())
+			{ thread.join(); }
+		cleanup();
+	}
+};
+
+#endif
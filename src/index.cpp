@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "event_journal.h"
+#include "lag_series.h"
+#include "parse_logs.h"
+#include "session_store.h"
+#include "snapshot.h"
+#include "uptime_series.h"
+
+// builds the snapshot and event journal of a logs directory ahead of time, so the bot doesn't have to parse years of logs when it starts
+// (e.g. on a small machine, or after an upgrade that changed the snapshot format). it reads the archives the same way the bot's initial
+// parse does, with every core decompressing and scanning files (see parse_log_file_events), then writes what the bot would have saved
+// usage: qc-index <logs dir> [--format vanilla|paper|forge] [--timezone name] [--merge-gap seconds] [--snapshot file] [--journal file]
+// the defaults are the bot's (see snapshot_path and journal_path in the config). the files can be copied to where the bot runs, as long as the
+// log files keep their sizes and modification times (e.g. rsync -t), since those decide whether the snapshot still matches them
+// an existing journal is reused, so files that are already in it aren't read again
+// the exit code is 0 on success, 1 if the snapshot couldn't be written, 2 on bad arguments
+
+namespace
+{
+	struct index_options
+	{
+		std::filesystem::path logs_dir;
+		log_format format = log_format::vanilla;
+		const std::chrono::time_zone* timezone = nullptr;
+		std::chrono::seconds merge_gap{};
+		std::filesystem::path snapshot_path = "qc-v2-snapshot.bin";
+		std::filesystem::path journal_path = "qc-v2-journal.bin";  // empty to not write a journal
+	};
+
+	template<log_format_policy line_format>
+	bool build_index(const index_options& options)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const std::vector<log_manifest_entry> manifest = scan_logs_dir<true>(options.logs_dir);
+		event_journal journal(options.journal_path, options.format);
+		if (journal.size() != 0)
+			{ log_message(log_severity::info, std::format("Loaded event journal with {} log files", journal.size())); }
+
+		// in batches like the bot's initial parse, so the sessions being added to are only ever a batch's
+		constexpr std::size_t batch_size = 64;
+		session_history history;
+		parse_ctx_t ctx;
+		lag_series lag;
+		lag_collector lag_events(lag);
+		uptime_series uptime;
+		uptime_collector uptime_events(uptime);
+		for (std::size_t first = 0; first < manifest.size(); first += batch_size)
+		{
+			const std::size_t last = std::min(first + batch_size, manifest.size());
+			std::pmr::monotonic_buffer_resource arena(1 << 20);
+			pmr_log_data_t new_data(&arena);
+			session_aggregator sessions(new_data, options.merge_gap);
+			ctx = parse_log_file_events<true, line_format>(std::vector(manifest.begin() + first, manifest.begin() + last), options.timezone,
+				[](const auto&) {}, std::move(ctx), combine_consumers(sessions, lag_events, uptime_events), journal);
+			history.commit(new_data);
+			log_message(log_severity::info, std::format("Read {} of {} log files", last, manifest.size()));
+		}
+
+		const auto store = history.merged();
+		if (!save_snapshot(options.snapshot_path, manifest, options.format, *store, ctx, lag, uptime))
+			{ return false; }
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		log_message(log_severity::info, std::format("Wrote snapshot {} of {} log files with {} sessions of {} players in {} ms", options.snapshot_path.string(),
+			manifest.size(), store->total_sessions(), store->size(), elapsed.count()));
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	index_options options;
+	bool valid = (argc >= 2 && argc % 2 == 0);
+	if (valid)
+		{ options.logs_dir = argv[1]; }
+	try
+	{
+		options.timezone = std::chrono::locate_zone("UTC");
+		for (int i = 2; valid && i + 1 < argc; i += 2)
+		{
+			const std::string_view name = argv[i], value = argv[i + 1];
+			if (name == "--format")
+			{
+				const auto format = parse_log_format(value);
+				valid = format.has_value();
+				options.format = format.value_or(log_format::vanilla);
+			}
+			else if (name == "--timezone")
+				{ options.timezone = std::chrono::locate_zone(value); }
+			else if (name == "--merge-gap")
+			{
+				std::uint64_t seconds = 0;
+				valid = std::from_chars(value.data(), value.data() + value.size(), seconds).ptr == value.data() + value.size();
+				options.merge_gap = std::chrono::seconds(seconds);
+			}
+			else if (name == "--snapshot")
+				{ options.snapshot_path = value; }
+			else if (name == "--journal")
+				{ options.journal_path = value; }
+			else
+				{ valid = false; }
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << std::format("Invalid timezone: {}\n", e.what());
+		return 2;
+	}
+	if (!valid || !std::filesystem::is_directory(options.logs_dir) || options.snapshot_path.empty())
+	{
+		std::cerr << "usage: qc-index <logs dir> [--format vanilla|paper|forge] [--timezone name] [--merge-gap seconds] [--snapshot file] [--journal file]\n"
+			"       the timezone (UTC by default) and merge gap must be the logs_timezone and session_merge_gap the bot uses\n";
+		return 2;
+	}
+
+	const bool ok = with_log_format(options.format, [&]<typename line_format>(line_format) { return build_index<line_format>(options); });
+	return ok ? 0 : 1;
+}
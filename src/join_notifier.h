@@ -0,0 +1,85 @@
+#ifndef JOIN_NOTIFIER_H
+#define JOIN_NOTIFIER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <dpp/dpp.h>
+
+#include "coalescing_timer.h"
+#include "live_feed.h"
+#include "logger.h"
+
+// posts players joining and leaving to a channel from a dpp timer instead of immediately, so a burst of them
+// (e.g. everyone reconnecting after a server restart) becomes a single message
+// only one message is sent at a time, so the next one waits for it (and for dpp's rate limit bucket of the channel) instead of requests piling up
+class join_notifier
+{
+private:
+	static constexpr std::size_t max_message_size = 2000;  // discord's limit for message content
+
+	dpp::cluster& bot;
+	dpp::snowflake channel_id;
+	// guarded by the timer's mutex
+	std::deque<std::string> pending;  // lines not sent yet
+	bool sending = false;  // a message hasn't been answered yet
+	coalescing_timer timer;  // running while something is pending or being sent, last so it's destroyed first
+
+	bool tick()
+	{
+		if (sending)
+			{ return true; }  // try again next tick
+		if (pending.empty())
+			{ return false; }  // nothing left to send, the timer is started again by the next change
+		// as many lines as fit, the rest are sent by the next ticks
+		std::string content;
+		while (!pending.empty() && (content.empty() || content.size() + 1 + pending.front().size() <= max_message_size))
+		{
+			if (!content.empty())
+				{ content += '\n'; }
+			content += pending.front().substr(0, max_message_size);
+			pending.pop_front();
+		}
+		sending = true;
+		// names are from the logs, so they mustn't ping anyone
+		bot.message_create(dpp::message(channel_id, content).set_allowed_mentions(), timer.guard([this](const dpp::confirmation_callback_t& res)
+		{
+			if (res.is_error())
+				{ log_message(log_severity::error, std::format("Could not post joins and leaves: {}", res.get_error().human_readable)); }
+			sending = false;
+		}));
+		return true;
+	}
+
+public:
+	// @param window  seconds to wait for more changes before sending (at least 1)
+	join_notifier(dpp::cluster& bot, dpp::snowflake channel_id, std::uint64_t window) :
+		bot(bot), channel_id(channel_id), timer(bot, window, [this](std::unique_lock<std::mutex>&) { return tick(); }) {}
+	join_notifier(const join_notifier&) = delete;
+	join_notifier& operator=(const join_notifier&) = delete;
+
+	// @param server  name, empty if there is only one
+	// @param deltas  in the order they happened
+	void add(std::string_view server, std::span<const live_delta> deltas)
+	{
+		if (deltas.empty())
+			{ return; }
+		const auto lock = timer.lock();
+		for (const live_delta& delta : deltas)
+		{
+			std::string line = std::format("**{}** {}", dpp::utility::markdown_escape(delta.player), (delta.type == log_event_type::join) ? "joined" : "left");
+			if (!server.empty())
+				{ line += std::format(" ({})", dpp::utility::markdown_escape(std::string(server))); }
+			pending.push_back(std::move(line));
+		}
+		timer.start(lock);
+	}
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef KWAY_MERGE_H
+#define KWAY_MERGE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+// merge of sorted runs (e.g. the history segments of each server, or a player's sessions on each of them), which yields their elements in order
+// one at a time from a min-heap of a cursor into each run, so whatever takes them goes through all runs in one pass (O(n log k)) instead of
+// concatenating them and sorting them again, or merging them two at a time
+// equal elements come in the order of their runs. it's an input range, so it can be gone through once
+// @tparam Run  forward view of a run (e.g. a span of a vector), which are copied into the merge
+template<std::ranges::forward_range Run, typename Comp = std::ranges::less, typename Proj = std::identity>
+class kway_merge
+{
+private:
+	using run_iterator = std::ranges::iterator_t<Run>;
+	using run_sentinel = std::ranges::sentinel_t<Run>;
+
+	struct cursor
+	{
+		run_iterator cur;
+		run_sentinel end;
+		std::size_t run;  // index, for ties
+	};
+
+	std::vector<Run> runs;  // the cursors point into, so it isn't changed after it's filled
+	std::vector<cursor> heap;
+	[[no_unique_address]] Comp comp;
+	[[no_unique_address]] Proj proj;
+
+	// std heap functions keep the largest element first, so this orders cursors by their next element the other way around
+	[[nodiscard]] bool after(const cursor& lhs, const cursor& rhs) const
+	{
+		if (std::invoke(comp, std::invoke(proj, *rhs.cur), std::invoke(proj, *lhs.cur)))
+			{ return true; }
+		if (std::invoke(comp, std::invoke(proj, *lhs.cur), std::invoke(proj, *rhs.cur)))
+			{ return false; }
+		return lhs.run > rhs.run;
+	}
+
+	[[nodiscard]] auto heap_comp() const
+		{ return [this](const cursor& lhs, const cursor& rhs) { return after(lhs, rhs); }; }
+
+public:
+	using value_type = std::ranges::range_value_t<Run>;
+	using reference = std::ranges::range_reference_t<Run>;
+
+	class iterator
+	{
+	private:
+		kway_merge* merge = nullptr;
+
+	public:
+		using value_type = kway_merge::value_type;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() = default;
+		explicit iterator(kway_merge& merge) noexcept : merge(&merge) {}
+
+		[[nodiscard]] reference operator*() const
+			{ return merge->top(); }
+		iterator& operator++()
+		{
+			merge->pop();
+			return *this;
+		}
+		void operator++(int)
+			{ ++*this; }
+		[[nodiscard]] friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept
+			{ return it.merge->empty(); }
+	};
+
+	// @param runs  each sorted by comp and proj
+	template<std::ranges::input_range Runs>
+	explicit kway_merge(Runs&& new_runs, Comp comp = {}, Proj proj = {}) :
+		runs(std::ranges::begin(new_runs), std::ranges::end(new_runs)), comp(std::move(comp)), proj(std::move(proj))
+	{
+		heap.reserve(runs.size());
+		for (std::size_t i = 0; i < runs.size(); i++)
+		{
+			if (!std::ranges::empty(runs[i]))
+				{ heap.push_back({ std::ranges::begin(runs[i]), std::ranges::end(runs[i]), i }); }
+		}
+		std::ranges::make_heap(heap, heap_comp());
+	}
+	kway_merge(const kway_merge&) = delete;
+	kway_merge& operator=(const kway_merge&) = delete;
+
+	[[nodiscard]] bool empty() const noexcept
+		{ return heap.empty(); }
+
+	// @return smallest element left, the merge mustn't be empty
+	[[nodiscard]] reference top() const
+		{ return *heap.front().cur; }
+	// @return index of the run top() is from
+	[[nodiscard]] std::size_t top_run() const noexcept
+		{ return heap.front().run; }
+
+	// go past top()
+	void pop()
+	{
+		std::ranges::pop_heap(heap, heap_comp());
+		cursor& last = heap.back();
+		if (++last.cur == last.end)
+			{ heap.pop_back(); }
+		else
+			{ std::ranges::push_heap(heap, heap_comp()); }
+	}
+
+	[[nodiscard]] iterator begin() noexcept
+		{ return iterator(*this); }
+	[[nodiscard]] std::default_sentinel_t end() const noexcept
+		{ return {}; }
+};
+
+template<std::ranges::input_range Runs>
+kway_merge(Runs&&) -> kway_merge<std::ranges::range_value_t<Runs>>;
+template<std::ranges::input_range Runs, typename Comp>
+kway_merge(Runs&&, Comp) -> kway_merge<std::ranges::range_value_t<Runs>, Comp>;
+template<std::ranges::input_range Runs, typename Comp, typename Proj>
+kway_merge(Runs&&, Comp, Proj) -> kway_merge<std::ranges::range_value_t<Runs>, Comp, Proj>;
+
+#endif
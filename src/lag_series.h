@@ -0,0 +1,136 @@
+#ifndef LAG_SERIES_H
+#define LAG_SERIES_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "binary_io.h"
+#include "parse_logs.h"
+
+// how far behind the server fell over time, from its "Can't keep up!" lines (see log_event_type::lag), which is the best sign of its health there is
+// samples are kept in the order they were logged, in columns of 12 bytes a sample (the server logs one at most every 15 seconds),
+// and rolled up per hour when they are shown (see hourly_lag)
+class lag_series
+{
+private:
+	std::vector<std::int64_t> times;  // seconds since epoch, nearly sorted (the clock may have gone back)
+	std::vector<std::uint32_t> behind_ms;
+
+public:
+	void add(std::chrono::system_clock::time_point time, std::chrono::milliseconds behind)
+	{
+		times.push_back(std::chrono::floor<std::chrono::seconds>(time).time_since_epoch().count());
+		behind_ms.push_back(static_cast<std::uint32_t>(std::clamp<std::chrono::milliseconds::rep>(behind.count(), 0, std::numeric_limits<std::uint32_t>::max())));
+	}
+
+	// add the samples of `other` after these
+	void append(const lag_series& other)
+	{
+		times.insert(times.end(), other.times.begin(), other.times.end());
+		behind_ms.insert(behind_ms.end(), other.behind_ms.begin(), other.behind_ms.end());
+	}
+
+	// remove the samples added after the series had `size` of them, for when the lines they were parsed from are parsed again
+	void truncate(std::size_t size)
+	{
+		times.resize(std::min(size, times.size()));
+		behind_ms.resize(times.size());
+	}
+
+	void clear() noexcept
+	{
+		times.clear();
+		behind_ms.clear();
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept
+		{ return times.size(); }
+	[[nodiscard]] bool empty() const noexcept
+		{ return times.empty(); }
+	// @return seconds since epoch of sample `i`
+	[[nodiscard]] std::int64_t time(std::size_t i) const noexcept
+		{ return times[i]; }
+	[[nodiscard]] std::uint32_t behind(std::size_t i) const noexcept
+		{ return behind_ms[i]; }
+
+	[[nodiscard]] std::size_t memory_used() const noexcept
+		{ return times.capacity() * sizeof(std::int64_t) + behind_ms.capacity() * sizeof(std::uint32_t); }
+
+	void write(detail::binary_writer& writer) const
+	{
+		writer.write_span(std::span(times));
+		writer.write_span(std::span(behind_ms));
+	}
+
+	// read what write wrote
+	// @return true on success
+	[[nodiscard]] bool read(detail::binary_reader& reader)
+		{ return reader.read_vector(times) && reader.read_vector(behind_ms) && times.size() == behind_ms.size(); }
+};
+
+// adds the lag of the server to a series, as a log event consumer (see parse_events)
+class lag_collector
+{
+private:
+	lag_series& series;
+
+public:
+	explicit lag_collector(lag_series& series) noexcept : series(series) {}
+
+	void operator()(const log_event& event)
+	{
+		if (event.type == log_event_type::lag)
+			{ series.add(event.time, event.behind); }
+	}
+};
+
+// how far behind the server was in an hour
+struct lag_hour
+{
+	std::chrono::sys_seconds start;
+	std::uint32_t samples;
+	std::chrono::milliseconds max, p50, p95;
+};
+
+// @param series  of one or more servers, whose samples are rolled up together
+// @return rollup of each hour from `first` until `last` (rounded out to whole hours) that has samples, in order
+[[nodiscard]] inline std::vector<lag_hour> hourly_lag(std::span<const std::shared_ptr<const lag_series>> series, std::chrono::sys_seconds first,
+	std::chrono::sys_seconds last)
+{
+	const std::int64_t begin = std::chrono::floor<std::chrono::hours>(first).time_since_epoch().count() * 3600;
+	const std::int64_t end = std::chrono::ceil<std::chrono::hours>(last).time_since_epoch().count() * 3600;
+	// hour and lag of every sample in range, sorted so each hour's are together and in order
+	std::vector<std::pair<std::int64_t, std::uint32_t>> samples;
+	for (const auto& cur : series)
+	{
+		for (std::size_t i = 0; i < cur->size(); i++)
+		{
+			if (cur->time(i) >= begin && cur->time(i) < end)
+				{ samples.emplace_back(cur->time(i) - (cur->time(i) - begin) % 3600, cur->behind(i)); }
+		}
+	}
+	std::ranges::sort(samples);
+
+	std::vector<lag_hour> res;
+	for (std::size_t i = 0; i < samples.size();)
+	{
+		const std::size_t hour_begin = i;
+		for (; i < samples.size() && samples[i].first == samples[hour_begin].first; i++) {}
+		const std::size_t count = i - hour_begin;
+		// nearest rank
+		const auto percentile = [&](std::size_t p)
+			{ return std::chrono::milliseconds(samples[hour_begin + (count * p + 99) / 100 - 1].second); };
+		res.push_back({ std::chrono::sys_seconds(std::chrono::seconds(samples[hour_begin].first)), static_cast<std::uint32_t>(count),
+			std::chrono::milliseconds(samples[i - 1].second), percentile(50), percentile(95) });
+	}
+	return res;
+}
+
+#endif
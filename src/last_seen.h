@@ -0,0 +1,134 @@
+#ifndef LAST_SEEN_H
+#define LAST_SEEN_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "parse_logs.h"
+#include "session_store.h"
+
+struct last_seen_entry
+{
+	uuid_t uuid;
+	std::chrono::system_clock::time_point time;  // end of their last session, or when they joined if they are online
+	bool online;
+};
+
+// when each player in history was last seen, found by any of their names (ignoring case) with one hash lookup,
+// made once for each set of history segments (see detail::history_cache)
+// players who joined since are found through the parse context's table of names, and their recent sessions through their uuid
+class last_seen_index
+{
+private:
+	std::vector<uuid_t> uuids;  // sorted
+	std::vector<std::chrono::system_clock::time_point> last_ends;  // end of each player's last session in history
+	// folded name (see player_name_index::fold_case) to index in uuids. like find_player, newer segments come first,
+	// and in a segment the player who has a name now comes before those who had it before
+	std::unordered_map<std::string, std::uint32_t> by_name;
+
+	// @return entry of `uuid` from history, recent data and who is online, or empty optional if they haven't played
+	[[nodiscard]] std::optional<last_seen_entry> get(uuid_t uuid, const log_data_t& recent, const parse_ctx_t& ctx) const
+	{
+		// few players are online at once
+		for (const std::uint32_t id : ctx.player_info.online())
+		{
+			const auto& [online_uuid, join_time] = ctx.player_info.infos()[id];
+			if (online_uuid == uuid)
+				{ return last_seen_entry{ uuid, join_time.value(), true }; }
+		}
+		auto res = std::chrono::system_clock::time_point::min();
+		if (const auto it = std::ranges::lower_bound(uuids, uuid); it != uuids.end() && *it == uuid)
+			{ res = last_ends[it - uuids.begin()]; }
+		// sessions may not be in order when servers are merged
+		if (const auto it = recent.find(uuid); it != recent.end())
+		{
+			for (const auto& [start, duration] : it->second.second.first)
+				{ res = std::max(res, start + duration); }
+		}
+		if (res == std::chrono::system_clock::time_point::min())
+			{ return {}; }
+		return last_seen_entry{ uuid, res, false };
+	}
+
+public:
+	last_seen_index() = default;
+	explicit last_seen_index(std::span<const std::shared_ptr<const session_store>> segments)
+	{
+		std::map<uuid_t, std::chrono::system_clock::time_point> players;
+		for (const auto& segment : segments)
+		{
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				auto& last_end = players.try_emplace(segment->uuid(i), std::chrono::system_clock::time_point::min()).first->second;
+				segment->for_each_session(i, time_range{}, [&last_end](const play_session& session)
+					{ last_end = std::max(last_end, session.first + session.second); });
+			}
+		}
+		uuids.reserve(players.size());
+		last_ends.reserve(players.size());
+		for (const auto& [uuid, last_end] : players)
+		{
+			uuids.push_back(uuid);
+			last_ends.push_back(last_end);
+		}
+
+		// segments are oldest first, so names are assigned again by newer ones
+		for (const auto& segment : segments)
+		{
+			const auto index_of = [&](std::size_t i)
+				{ return static_cast<std::uint32_t>(std::ranges::lower_bound(uuids, segment->uuid(i)) - uuids.begin()); };
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				for (const std::string_view name : segment->player_names(i))
+					{ by_name.insert_or_assign(player_name_index::fold_case(name), index_of(i)); }
+			}
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				std::string_view current;
+				for (const std::string_view name : segment->player_names(i))
+					{ current = name; }
+				if (!current.empty())
+					{ by_name.insert_or_assign(player_name_index::fold_case(current), index_of(i)); }
+			}
+		}
+	}
+
+	// @param name  current or former name of the player (case is ignored)
+	// @param recent  sessions newer than history
+	// @param ctx  of recent, for who is online and the uuids of players who joined since history was committed to
+	// @return when the player was last seen, or empty optional if nobody with that name has played
+	[[nodiscard]] std::optional<last_seen_entry> find(std::string_view name, const log_data_t& recent, const parse_ctx_t& ctx) const
+	{
+		// the name as it was logged, which is newer than history
+		if (const auto id = ctx.player_info.find(name))
+		{
+			if (const auto& uuid = ctx.player_info.infos()[id.value()].uuid)
+			{
+				if (auto res = get(uuid.value(), recent, ctx))
+					{ return res; }
+			}
+		}
+		const std::string folded = player_name_index::fold_case(name);
+		if (const auto it = by_name.find(folded); it != by_name.end())
+			{ return get(uuids[it->second], recent, ctx); }
+		// only players new since history who were asked about with different case are left, and recent data only has players who played since then
+		for (const auto& [uuid, data] : recent)
+		{
+			if (std::ranges::any_of(data.first, [&folded](const std::string& cur) { return player_name_index::fold_case(cur) == folded; }))
+				{ return get(uuid, recent, ctx); }
+		}
+		return {};
+	}
+};
+
+#endif
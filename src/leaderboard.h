@@ -0,0 +1,228 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "parse_logs.h"
+#include "playtime_graph.h"
+#include "session_store.h"
+
+struct leaderboard_entry
+{
+	uuid_t uuid;
+	std::string_view name;  // latest name
+	std::chrono::system_clock::duration total;
+	std::size_t rank;  // 1 for the most playtime, players with the same playtime have the same rank
+};
+
+// players in history ranked by total playtime, made once for each set of history segments (see detail::history_cache)
+// playtime that isn't in history yet (recent data and online players) is added when querying, only moving those few players,
+// so top players and the rank of a player don't need all players sorted again
+class playtime_ranking
+{
+public:
+	// playtime of players that isn't in history, sorted by uuid
+	using extra_t = std::vector<std::pair<uuid_t, std::chrono::system_clock::duration>>;
+
+private:
+	std::vector<uuid_t> uuids;  // sorted
+	std::vector<std::chrono::system_clock::duration> totals;  // of uuids[i]
+	std::vector<std::string_view> names;  // latest name of uuids[i], in the segments
+	std::vector<std::uint32_t> order;  // indices of uuids, most playtime first
+	std::vector<std::chrono::system_clock::duration> sorted_totals;  // totals in order
+
+	[[nodiscard]] std::optional<std::size_t> find(uuid_t uuid) const noexcept
+	{
+		const auto it = std::ranges::lower_bound(uuids, uuid);
+		if (it == uuids.end() || *it != uuid)
+			{ return {}; }
+		return it - uuids.begin();
+	}
+
+	[[nodiscard]] std::chrono::system_clock::duration history_total(uuid_t uuid) const noexcept
+	{
+		const auto ind = find(uuid);
+		return ind ? totals[ind.value()] : std::chrono::system_clock::duration::zero();
+	}
+
+	[[nodiscard]] static std::chrono::system_clock::duration extra_total(std::span<const extra_t::value_type> extra, uuid_t uuid) noexcept
+	{
+		const auto it = std::ranges::lower_bound(extra, uuid, {}, &extra_t::value_type::first);
+		return (it == extra.end() || it->first != uuid) ? std::chrono::system_clock::duration::zero() : it->second;
+	}
+
+	static void set_recent_name(leaderboard_entry& entry, const log_data_t& recent)
+	{
+		if (const auto it = recent.find(entry.uuid); it != recent.end() && !it->second.first.empty())
+			{ entry.name = it->second.first.back(); }
+	}
+
+public:
+	// @param segments  must outlive this, since names refer to them
+	explicit playtime_ranking(std::span<const std::shared_ptr<const session_store>> segments)
+	{
+		std::map<uuid_t, std::pair<std::chrono::system_clock::duration, std::string_view>> players;
+		for (const auto& segment : segments)
+		{
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				auto& [total, name] = players[segment->uuid(i)];
+				total += segment->total_playtime(i);
+				if (const auto player_names = segment->player_names(i); !player_names.empty())
+					{ name = player_names.back(); }
+			}
+		}
+		for (const auto& [uuid, player] : players)
+		{
+			uuids.push_back(uuid);
+			totals.push_back(player.first);
+			names.push_back(player.second);
+		}
+		order.resize(uuids.size());
+		for (std::uint32_t i = 0; i < order.size(); i++)
+			{ order[i] = i; }
+		std::ranges::stable_sort(order, std::ranges::greater(), [this](std::uint32_t i) { return totals[i]; });
+		for (const std::uint32_t i : order)
+			{ sorted_totals.push_back(totals[i]); }
+	}
+
+	// @return playtime of each player in recent data and of online players (until `now`), for the extra parameters below
+	[[nodiscard]] static extra_t get_extra(const log_data_t& recent, const parse_ctx_t& parse_ctx, std::chrono::system_clock::time_point now)
+	{
+		extra_t extra;
+		for (const auto& [uuid, data] : recent)
+			{ extra.emplace_back(uuid, data.second.second); }  // already sorted
+		for (const std::uint32_t id : parse_ctx.player_info.online())
+		{
+			const auto& [uuid, join_time] = parse_ctx.player_info.infos()[id];
+			if (!uuid)
+				{ continue; }
+			const auto it = std::ranges::lower_bound(extra, uuid.value(), {}, &extra_t::value_type::first);
+			if (it == extra.end() || it->first != uuid.value())
+				{ extra.emplace(it, uuid.value(), now - join_time.value()); }
+			else
+				{ it->second += now - join_time.value(); }
+		}
+		return extra;
+	}
+
+	// @param recent  data of the same view, for playtime newer than history
+	// @param now  end of the session the player is in, if they're online
+	// @return all time playtime of a player, zero if they have never played
+	[[nodiscard]] std::chrono::system_clock::duration playtime(uuid_t uuid, const log_data_t& recent, const parse_ctx_t& parse_ctx, std::chrono::system_clock::time_point now) const
+	{
+		auto res = history_total(uuid);
+		if (const auto it = recent.find(uuid); it != recent.end())
+			{ res += it->second.second.second; }
+		for (const std::uint32_t id : parse_ctx.player_info.online())
+		{
+			const auto& [cur_uuid, join_time] = parse_ctx.player_info.infos()[id];
+			if (cur_uuid == uuid)
+				{ res += now - join_time.value(); }
+		}
+		return res;
+	}
+
+	// @param extra  see get_extra
+	// @param recent  for names newer than history
+	// @return the `count` players with the most playtime, most first
+	[[nodiscard]] std::vector<leaderboard_entry> top(std::size_t count, std::span<const extra_t::value_type> extra, const log_data_t& recent) const
+	{
+		// only players with extra playtime can move, so the top is among the first count + extra.size() players of history and them
+		std::vector<leaderboard_entry> candidates;
+		for (std::size_t i = 0; i < std::min(order.size(), count + extra.size()); i++)
+		{
+			const std::uint32_t ind = order[i];
+			candidates.emplace_back(uuids[ind], names[ind], totals[ind] + extra_total(extra, uuids[ind]), 0);
+		}
+		for (const auto& [uuid, extra_playtime] : extra)
+		{
+			if (std::ranges::find(candidates, uuid, &leaderboard_entry::uuid) == candidates.end())
+			{
+				const auto ind = find(uuid);
+				candidates.emplace_back(uuid, ind ? names[ind.value()] : std::string_view(), history_total(uuid) + extra_playtime, 0);
+			}
+		}
+		const std::size_t res_size = std::min(count, candidates.size());
+		std::ranges::partial_sort(candidates, candidates.begin() + res_size, std::ranges::greater(), &leaderboard_entry::total);
+		candidates.resize(res_size);
+		for (std::size_t i = 0; i < candidates.size(); i++)
+		{
+			leaderboard_entry& entry = candidates[i];
+			entry.rank = (i != 0 && candidates[i - 1].total == entry.total) ? candidates[i - 1].rank : i + 1;
+			set_recent_name(entry, recent);
+		}
+		return candidates;
+	}
+
+	// @param extra  see get_extra
+	// @param recent  for names newer than history
+	// @return rank and playtime of a player, or empty optional if they have never played
+	[[nodiscard]] std::optional<leaderboard_entry> rank(uuid_t uuid, std::span<const extra_t::value_type> extra, const log_data_t& recent) const
+	{
+		const auto ind = find(uuid);
+		const auto extra_it = std::ranges::lower_bound(extra, uuid, {}, &extra_t::value_type::first);
+		const bool has_extra = (extra_it != extra.end() && extra_it->first == uuid);
+		if (!ind && !has_extra)
+			{ return {}; }
+		const auto total = history_total(uuid) + extra_total(extra, uuid);
+
+		// players in history with more playtime, then moving the players with extra playtime
+		std::size_t num_greater = std::ranges::partition_point(sorted_totals, [total](auto cur) { return cur > total; }) - sorted_totals.begin();
+		for (const auto& [cur_uuid, extra_playtime] : extra)
+		{
+			if (cur_uuid == uuid)
+				{ continue; }
+			const auto cur_total = history_total(cur_uuid);
+			num_greater -= (cur_total > total) ? 1 : 0;
+			num_greater += (cur_total + extra_playtime > total) ? 1 : 0;
+		}
+
+		leaderboard_entry res{ uuid, ind ? names[ind.value()] : std::string_view(), total, num_greater + 1 };
+		set_recent_name(res, recent);
+		return res;
+	}
+};
+
+// leaderboard of playtime in a bounded range, which comes from the rows of the playtime graph (using playtime per day for whole days)
+// @param player  player to also find the rank of
+// @return top `count` players, and the rank of `player` (if they played in the range)
+inline std::pair<std::vector<leaderboard_entry>, std::optional<leaderboard_entry>> get_range_leaderboard(const session_history& history, const log_data_t& recent,
+	const parse_ctx_t& parse_ctx, const time_range& range, std::size_t count, std::optional<uuid_t> player, graph_render_ctx& render_ctx)
+{
+	const detail::render_arena::scope arena;
+	detail::graph_rows rows = detail::get_graph_rows(history.get_segments(), recent, range, render_ctx, arena.resource());
+	detail::add_online_sessions(rows, parse_ctx, range, std::chrono::system_clock::now());
+	detail::remove_empty_rows(rows);
+	detail::sort_graph_rows(rows);
+
+	std::vector<leaderboard_entry> entries;
+	std::optional<leaderboard_entry> player_entry;
+	std::size_t rank = 0;
+	for (std::size_t i = 0; i < rows.size(); i++)
+	{
+		if (entries.size() == count && (!player || player_entry))
+			{ break; }
+		const detail::graph_row& row = rows[i];
+		if (i == 0 || rows[i - 1].total != row.total)
+			{ rank = i + 1; }
+		const leaderboard_entry entry{ row.uuid, row.name, row.total, rank };
+		if (entries.size() < count)
+			{ entries.push_back(entry); }
+		if (player && row.uuid == player.value())
+			{ player_entry = entry; }
+	}
+	return { std::move(entries), player_entry };
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef LINE_SPLITTER_H
+#define LINE_SPLITTER_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LINE_SPLITTER_SSE2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define LINE_SPLITTER_NEON
+#include <arm_neon.h>
+#endif
+
+namespace detail
+{
+	// @tparam chars  characters to search for
+	// @return pointer to the first character in [first, last) that is one of `chars`, or last if there is none
+	template<char... chars>
+	inline const char* find_any_of(const char* first, const char* last) noexcept
+	{
+		static_assert(sizeof...(chars) > 0, "no characters to search for");
+#if defined(__AVX2__)
+		for (; last - first >= 32; first += 32)
+		{
+			const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+			__m256i eq = _mm256_setzero_si256();
+			((eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(chars)))), ...);
+			const std::uint32_t mask = _mm256_movemask_epi8(eq);
+			if (mask != 0)
+				{ return first + std::countr_zero(mask); }
+		}
+#endif
+#if defined(LINE_SPLITTER_SSE2)
+		for (; last - first >= 16; first += 16)
+		{
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+			__m128i eq = _mm_setzero_si128();
+			((eq = _mm_or_si128(eq, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(chars)))), ...);
+			const std::uint32_t mask = _mm_movemask_epi8(eq);
+			if (mask != 0)
+				{ return first + std::countr_zero(mask); }
+		}
+#elif defined(LINE_SPLITTER_NEON)
+		for (; last - first >= 16; first += 16)
+		{
+			const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const std::uint8_t*>(first));
+			uint8x16_t eq = vdupq_n_u8(0);
+			((eq = vorrq_u8(eq, vceqq_u8(chunk, vdupq_n_u8(chars)))), ...);
+			// narrow each byte of the comparison result to a nibble, giving a 64-bit mask with 4 bits per byte
+			const std::uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+			if (mask != 0)
+				{ return first + std::countr_zero(mask) / 4; }
+		}
+#endif
+		return std::find_if(first, last, [](char c) { return ((c == chars) || ...); });
+	}
+
+	// @return pointer to the first '\n' in [first, last), or last if there is none
+	inline const char* find_newline(const char* first, const char* last) noexcept
+		{ return find_any_of<'\n'>(first, last); }
+
+	// get the line starting at `pos` in `str` and advance `pos` past its line ending
+	// a trailing \r is removed, so both \n and \r\n endings are handled
+	// after the last line is returned, pos will be greater than str.size()
+	// @return view of line contents (excluding line ending) into `str`
+	inline std::string_view next_line(std::string_view str, std::size_t& pos) noexcept
+	{
+		const char* const begin = str.data() + pos;
+		const char* const end = find_newline(begin, str.data() + str.size());
+		std::string_view line(begin, end - begin);
+		pos += line.size() + 1;
+		if (line.ends_with('\r'))
+			{ line.remove_suffix(1); }
+		return line;
+	}
+
+	// the lines of a buffer (see next_line) as a range, so they can be looped over without keeping track of the position
+	// a line ending at the end of the buffer doesn't start another (empty) line
+	// e.g. for (std::string_view line : line_range(str))
+	class line_range
+	{
+	private:
+		std::string_view str;
+
+	public:
+		class iterator
+		{
+		private:
+			std::string_view str;
+			std::size_t pos = 0;  // of the line after the current one
+			std::string_view line;
+			bool done = false;  // the last line was already taken
+
+		public:
+			using value_type = std::string_view;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() = default;
+			explicit iterator(std::string_view str) noexcept : str(str)
+				{ ++*this; }
+
+			[[nodiscard]] std::string_view operator*() const noexcept
+				{ return line; }
+			iterator& operator++() noexcept
+			{
+				if (pos >= str.size())
+					{ done = true; }
+				else
+					{ line = next_line(str, pos); }
+				return *this;
+			}
+			iterator operator++(int) noexcept
+			{
+				iterator res = *this;
+				++*this;
+				return res;
+			}
+			[[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept
+				{ return done; }
+		};
+
+		explicit line_range(std::string_view str) noexcept : str(str) {}
+
+		[[nodiscard]] iterator begin() const noexcept
+			{ return iterator(str); }
+		[[nodiscard]] static std::default_sentinel_t end() noexcept
+			{ return {}; }
+	};
+}
+
+#endif
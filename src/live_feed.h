@@ -0,0 +1,99 @@
+#ifndef LIVE_FEED_H
+#define LIVE_FEED_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "parse_logs.h"
+#include "websocket.h"
+
+// a player joining or leaving, kept until the data it changed is published (see live_feed)
+struct live_delta
+{
+	log_event_type type;  // join or leave
+	std::string player;
+	std::optional<uuid_t> uuid;
+	std::chrono::system_clock::time_point time;
+};
+
+// consumer of log events (see parse_events) that keeps the joins and leaves, to be sent to live feed clients
+struct live_delta_collector
+{
+	std::vector<live_delta> deltas;
+	// false while nobody is waiting for each event, e.g. reading logs on startup or again after a rollback
+	bool enabled = false;
+
+	void operator()(const log_event& event)
+	{
+		if (enabled && (event.type == log_event_type::join || event.type == log_event_type::leave))
+			{ deltas.push_back({ event.type, std::string(event.player), event.uuid, event.time }); }
+	}
+};
+
+// messages from the log reading loops to websocket clients of the http server (see http_server), e.g. players joining and leaving.
+// clients get a snapshot of the current state when they connect, then the messages published after it
+// publishing only appends the message, already framed, to a queue the server takes all of at once, so it costs the same however many clients there are
+// a message must only be published after the data it describes is, so a snapshot made after the message was taken already includes it
+class live_feed
+{
+private:
+	static constexpr std::size_t max_pending = 1024;  // messages the server hasn't taken yet, more are dropped (and clients get a snapshot instead)
+
+	std::mutex mutex;
+	std::vector<std::shared_ptr<const std::string>> pending;
+	bool dropped = false;
+	std::function<void()> notify;
+
+public:
+	// @param make_snapshot  see snapshot
+	explicit live_feed(std::function<std::string()> make_snapshot) : make_snapshot(std::move(make_snapshot)) {}
+	live_feed(const live_feed&) = delete;
+	live_feed& operator=(const live_feed&) = delete;
+
+	// @return message with the current state, which messages published later are changes to. called on the server's thread and by resync
+	const std::function<std::string()> make_snapshot;
+
+	// @param message  text, e.g. json
+	void publish(std::string_view message)
+	{
+		auto frame = std::make_shared<const std::string>(detail::websocket_frame(detail::websocket_opcode::text, message));
+		const std::lock_guard lock(mutex);
+		if (pending.size() < max_pending)
+			{ pending.push_back(std::move(frame)); }
+		else
+			{ dropped = true; }
+		if (notify)
+			{ notify(); }
+	}
+
+	// send a snapshot to every client, e.g. after data was discarded and parsed again, so the changes clients have seen aren't accurate anymore
+	void resync()
+		{ publish(make_snapshot()); }
+
+	// @param on_publish  called after a message is published, possibly on another thread. none if null
+	void set_notify(std::function<void()> on_publish)
+	{
+		const std::lock_guard lock(mutex);
+		notify = std::move(on_publish);
+	}
+
+	// take the messages published since the last call, as websocket frames
+	// @return false if messages were dropped since the last call, so every client needs a snapshot
+	[[nodiscard]] bool take(std::vector<std::shared_ptr<const std::string>>& out)
+	{
+		out.clear();
+		const std::lock_guard lock(mutex);
+		std::swap(out, pending);
+		return !std::exchange(dropped, false);
+	}
+};
+
+#endif
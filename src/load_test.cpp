@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "commands.h"
+#include "log_replay.h"
+#include "resource_governor.h"
+#include "text_metrics.h"
+
+// load test of the commands (see commands.h) without discord: client threads send /graph, /players and /leaderboard as fast as they
+// are answered (after a think time), while a recorded log is replayed into latest.log (see log_replay.h) and followed, parsed and
+// published for the commands like the bot does. graphs are rendered on a render_executor and leaderboards run on a query lane like in main.cpp
+// usage: load_test <recorded log> [--dir dir] [--speed x] [--max-gap seconds] [--clients n] [--render-threads n] [--think-ms n]
+// reports the latency of each command (from sending it to having its reply) and how many were turned away because a queue was full,
+// how long the log reading loop held the lock of the published data, and how long written lines took to be published (ingest lag)
+
+#if defined(__linux__) || defined(_WIN32)
+
+namespace
+{
+	struct load_options
+	{
+		replay_options replay;
+		std::size_t clients = 100;
+		std::size_t render_threads = 2;
+		std::size_t think_ms = 100;  // between a client's commands
+	};
+
+	// what the commands of the bot are answered from
+	struct command_state
+	{
+		std::atomic<std::shared_ptr<const published_data_t>> published;
+		view_caches cache;
+		graph_render_ctx graph_ctx{ std::chrono::locate_zone("UTC") };
+		// like in main.cpp, see render_graph and query_lane there
+		render_executor graph_renderer;
+		render_executor query_lane{ 1, 16 };
+
+		explicit command_state(std::size_t render_threads) : graph_renderer(render_threads, 8, []()
+		{
+			detail::enter_render_thread();
+			constexpr std::array<float, 2> font_sizes = { static_cast<float>(svg_fontsize), static_cast<float>(svg_date_fontsize) };
+			detail::text_metrics::get().warm(font_sizes);
+		}) {}
+	};
+
+	// latencies of one command, shared by all clients
+	struct command_stats
+	{
+		std::mutex mutex;
+		latency_stats latency;
+		std::size_t rejected = 0;
+
+		void add(std::chrono::steady_clock::duration d)
+		{
+			std::scoped_lock lock(mutex);
+			latency.add(d);
+		}
+
+		void reject()
+		{
+			std::scoped_lock lock(mutex);
+			rejected++;
+		}
+	};
+
+	struct load_stats
+	{
+		command_stats graph, players, leaderboard;
+		std::atomic<std::size_t> graph_cache_hits = 0;
+	};
+
+	// a small, deterministic generator, so each client's commands are the same every run (see log_gen.cpp)
+	struct client_rng
+	{
+		std::uint64_t state;
+
+		[[nodiscard]] std::uint32_t next(std::uint32_t bound) noexcept
+		{
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			return static_cast<std::uint32_t>((state >> 33) % bound);
+		}
+	};
+
+	// render the graph of `key` and add it to the cache, like main.cpp's render_graph (without the disk cache and previews)
+	[[nodiscard]] std::shared_ptr<const std::string> render_graph(command_state& state, const published_data_t& data, const graph_cache::key_t& key)
+	{
+		const graph_options options = {
+			.color = detail::adaptive_color,
+			.theme_color = key.dark ? "white" : "black",
+			.render_ctx = &state.graph_ctx,
+			.row_limit = key.row_limit,
+			.range = key.range
+		};
+		auto contents = std::make_shared<const std::string>(render_graph_file(data, key, options));
+		const auto expiry = data.ctx.player_info.online().empty() ? std::chrono::steady_clock::time_point::max() :
+			std::chrono::steady_clock::now() + std::chrono::seconds(60);
+		state.cache.graphs.insert(key, contents, expiry);
+		return contents;
+	}
+
+	// send one command from a client and wait for its reply
+	void send_command(command_state& state, load_stats& stats, client_rng& rng)
+	{
+		constexpr std::array<std::string_view, 4> graph_types = { "playtime", "online", "heatmap", "lag" };
+		constexpr std::array<std::string_view, 4> periods = { "all", "month", "week", "today" };
+		const std::shared_ptr<const published_data_t> data = state.published.load();
+		if (!data)
+			{ return; }
+		const auto start = std::chrono::steady_clock::now();
+		const std::uint32_t choice = rng.next(4);
+		if (choice < 2)
+		{
+			const graph_type type = parse_graph_type(graph_types[rng.next(graph_types.size())]);
+			const bool svg = (rng.next(4) == 0);
+			const graph_cache::key_t key{ data->generation, type, svg, !svg && rng.next(2) == 0, (type == graph_type::playtime) ? std::size_t(25) : 0, {} };
+			if (state.cache.graphs.find(key))
+			{
+				stats.graph_cache_hits++;
+				stats.graph.add(std::chrono::steady_clock::now() - start);
+				return;
+			}
+			std::promise<std::shared_ptr<const std::string>> promise;
+			auto rendered = promise.get_future();
+			const graph_request request = request_graph(state.cache.graphs, state.graph_renderer, start + std::chrono::minutes(14), key,
+				[&state, data, key]() { return render_graph(state, *data, key); },
+				[&promise](std::shared_ptr<const std::string> contents) { promise.set_value(std::move(contents)); });
+			if (request == graph_request::busy || !rendered.get())
+				{ stats.graph.reject(); }
+			else
+				{ stats.graph.add(std::chrono::steady_clock::now() - start); }
+		}
+		else if (choice == 2)
+		{
+			static_cast<void>(players_message(*data));
+			stats.players.add(std::chrono::steady_clock::now() - start);
+		}
+		else
+		{
+			const int num_days = parse_leaderboard_period(periods[rng.next(periods.size())]);
+			std::promise<bool> promise;
+			auto answered = promise.get_future();
+			const bool queued = state.query_lane.submit(start + std::chrono::milliseconds(2500), [&state, &promise, data, num_days](bool expired)
+			{
+				if (!expired)
+					{ static_cast<void>(query_leaderboard(state.cache, *data, std::chrono::locate_zone("UTC"), num_days, 10, std::nullopt, state.graph_ctx)); }
+				promise.set_value(!expired);
+			});
+			if (!queued || !answered.get())
+				{ stats.leaderboard.reject(); }
+			else
+				{ stats.leaderboard.add(std::chrono::steady_clock::now() - start); }
+		}
+	}
+
+	[[nodiscard]] bool parse_option(load_options& options, std::string_view name, std::string_view value)
+	{
+		const auto parse_size = [value](std::size_t& out)
+			{ return std::from_chars(value.data(), value.data() + value.size(), out).ptr == value.data() + value.size(); };
+		if (name == "--clients")
+			{ return parse_size(options.clients) && options.clients != 0; }
+		if (name == "--render-threads")
+			{ return parse_size(options.render_threads) && options.render_threads != 0; }
+		if (name == "--think-ms")
+			{ return parse_size(options.think_ms); }
+		return parse_replay_option(options.replay, name, value);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	load_options options;
+	bool valid = (argc >= 2 && argc % 2 == 0);
+	if (valid)
+		{ options.replay.recorded = argv[1]; }
+	for (int i = 2; valid && i + 1 < argc; i += 2)
+		{ valid = parse_option(options, argv[i], argv[i + 1]); }
+	if (!valid)
+	{
+		std::cerr << "usage: load_test <recorded log> [--dir dir (default replay)] [--speed x] [--max-gap seconds] [--clients n (default 100)] "
+			"[--render-threads n (default 2)] [--think-ms n (default 100)]\n";
+		return 1;
+	}
+	get_logger().set_min_severity(log_severity::fatal);
+	detail::text_metrics::load_font("");
+
+	std::optional<std::string> contents;
+	const std::vector<replay_burst> bursts = prepare_replay(options.replay, contents);
+	if (bursts.empty())
+		{ return 1; }
+
+	command_state state(options.render_threads);
+	load_stats stats;
+	replay_progress progress;
+	latency_stats ingest_lag, presence_lag, publish_time, publish_lock;
+	std::size_t num_events = 0, num_rotations = 0;
+	bool follow_ok = true;
+
+	// publishes after each batch like the log reading loop in main.cpp, committing to history when latest.log is rotated
+	// (only with nobody online, like at a restart: a graph needs the recent data of online players, which the replay doesn't log again)
+	session_history history;
+	std::uint64_t generation = 0;
+	const auto lag = std::make_shared<const lag_series>();
+	const replay_parsed_t publish = [&](const parse_ctx_t& parse_ctx, log_data_t& data, bool players_changed, bool rotated)
+	{
+		if (rotated && parse_ctx.player_info.online().empty())
+		{
+			history.commit(data);
+			data.clear();
+		}
+		if (players_changed || rotated)
+			{ generation++; }
+		const auto publish_start = std::chrono::steady_clock::now();
+		auto published = std::make_shared<const published_data_t>(history, data, parse_ctx, generation, 0, 0, memory_usage{},
+			std::vector<std::shared_ptr<const lag_series>>{ lag, lag });
+		const auto lock_start = std::chrono::steady_clock::now();
+		state.published.store(std::move(published));
+		const auto end = std::chrono::steady_clock::now();
+		publish_time.add(end - publish_start);
+		publish_lock.add(end - lock_start);
+	};
+	std::thread follower([&]() { follow_ok = follow_replay(options.replay.dir, progress, ingest_lag, presence_lag, num_events, publish); });
+
+	std::vector<std::jthread> clients;
+	for (std::size_t i = 0; i < options.clients; i++)
+	{
+		clients.emplace_back([&state, &stats, &progress, &options, i]()
+		{
+			client_rng rng{ i + 1 };
+			while (!progress.done)
+			{
+				send_command(state, stats, rng);
+				std::this_thread::sleep_for(std::chrono::milliseconds(options.think_ms));
+			}
+		});
+	}
+
+	// give the watcher time to start, so the first writes aren't missed
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	try
+	{
+		replay_bursts(options.replay, bursts, progress, num_rotations);
+	}
+	catch (const std::filesystem::filesystem_error& e)
+	{
+		std::cerr << std::format("Replay failed: {}\n", e.what());
+		progress.done = true;
+		follower.join();
+		return 1;
+	}
+	progress.done = true;
+	clients.clear();
+	follower.join();
+	if (!follow_ok)
+	{
+		std::cerr << "Watching the directory failed\n";
+		return 1;
+	}
+
+	std::cout << std::format("{} clients, {} render threads, {} watcher events, {} rotations\n", options.clients, options.render_threads, num_events, num_rotations);
+	stats.graph.latency.print("/graph");
+	stats.players.latency.print("/players");
+	stats.leaderboard.latency.print("/leaderboard");
+	std::cout << std::format("rejected (queue full or expired): /graph {}, /leaderboard {}; graph cache hits {}\n", stats.graph.rejected,
+		stats.leaderboard.rejected, stats.graph_cache_hits.load());
+	publish_time.print("publish (copy and store)");
+	publish_lock.print("publish lock held");
+	ingest_lag.print("ingest lag (write to published)");
+	presence_lag.print("join/leave to player count");
+}
+
+#else
+
+int main()
+{
+	std::cerr << "not implemented" << std::endl;
+}
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef LOG_BUNDLE_H
+#define LOG_BUNDLE_H
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <libdeflate.h>
+
+// the formats of backup bundles of old logs (tar, tar.gz and zip), whose members are parsed like files in the logs directory without extracting them
+// only what is needed to find the members is read here, the bundle's contents are loaded by detail::log_bundle (see parse_logs.h)
+namespace detail
+{
+	enum class bundle_kind : std::uint8_t
+	{
+		tar,
+		tar_gz,  // the whole tar is gzipped, so it has to be decompressed to find anything in it
+		zip
+	};
+
+	// @return kind of bundle `filename` is by its extension, or nullopt if it isn't one
+	[[nodiscard]] inline std::optional<bundle_kind> bundle_kind_of(std::string_view filename) noexcept
+	{
+		if (filename.ends_with(".tar"))
+			{ return bundle_kind::tar; }
+		if (filename.ends_with(".tar.gz") || filename.ends_with(".tgz"))
+			{ return bundle_kind::tar_gz; }
+		if (filename.ends_with(".zip"))
+			{ return bundle_kind::zip; }
+		return std::nullopt;
+	}
+
+	// where a member's data is in the (decompressed, for tar.gz) bundle
+	struct bundle_member_location
+	{
+		std::uint64_t offset = 0;
+		std::uint64_t stored_size = 0;  // size of the data, compressed if it is deflated
+		std::uint64_t size = 0;  // size of the member itself
+		bool deflated = false;  // raw deflate (zip), otherwise stored
+	};
+
+	struct bundle_member
+	{
+		std::string name;  // path in the bundle, with '/' separators
+		std::int64_t mtime;  // seconds since epoch
+		bundle_member_location location;
+	};
+
+	// @return little endian integer at `pos` of `data`, which must have the bytes
+	template<typename T>
+	[[nodiscard]] inline T read_le(std::string_view data, std::size_t pos) noexcept
+	{
+		T res = 0;
+		for (std::size_t i = sizeof(T); i-- > 0;)
+			{ res = static_cast<T>((res << 8) | static_cast<unsigned char>(data[pos + i])); }
+		return res;
+	}
+
+	// @param field  octal digits (terminated by a space or null), or big endian base-256 if the first byte has the high bit set (gnu, for large values)
+	// @return value, or nullopt if it is malformed
+	[[nodiscard]] inline std::optional<std::uint64_t> parse_tar_number(std::string_view field) noexcept
+	{
+		if (!field.empty() && (static_cast<unsigned char>(field[0]) & 0x80) != 0)
+		{
+			std::uint64_t res = static_cast<unsigned char>(field[0]) & 0x7f;
+			for (const char c : field.substr(1))
+			{
+				if (res >> 56 != 0)
+					{ return std::nullopt; }
+				res = (res << 8) | static_cast<unsigned char>(c);
+			}
+			return res;
+		}
+		std::uint64_t res = 0;
+		std::size_t i = 0;
+		for (; i < field.size() && field[i] == ' '; i++) {}
+		for (; i < field.size() && field[i] >= '0' && field[i] <= '7'; i++)
+		{
+			if (res >> 61 != 0)
+				{ return std::nullopt; }
+			res = res * 8 + static_cast<std::uint64_t>(field[i] - '0');
+		}
+		if (i < field.size() && field[i] != ' ' && field[i] != '\0')
+			{ return std::nullopt; }
+		return res;
+	}
+
+	// find the regular files in a tar (ustar, gnu or pax)
+	// @param out  receives the members, in the order they are in the tar
+	// @return false if `tar` isn't one or is truncated (out has the members before the problem)
+	[[nodiscard]] inline bool list_tar_members(std::string_view tar, std::vector<bundle_member>& out)
+	{
+		constexpr std::size_t block_size = 512;
+		const auto field = [](std::string_view header, std::size_t pos, std::size_t size)
+		{
+			const std::string_view res = header.substr(pos, size);
+			return res.substr(0, res.find('\0'));
+		};
+		// from the entry before, for the one after (gnu long name, or pax extended header)
+		std::optional<std::string> next_name;
+		std::optional<std::uint64_t> next_size;
+		std::size_t pos = 0;
+		while (tar.size() - pos >= block_size)
+		{
+			const std::string_view header = tar.substr(pos, block_size);
+			// the tar ends with zeroed blocks
+			if (std::ranges::all_of(header, [](char c) { return c == '\0'; }))
+				{ return true; }
+			// sum of the header's bytes, with the checksum itself as spaces
+			std::uint64_t sum = 0;
+			for (std::size_t i = 0; i < block_size; i++)
+				{ sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]); }
+			const auto checksum = parse_tar_number(header.substr(148, 8));
+			auto size = parse_tar_number(header.substr(124, 12));
+			const auto mtime = parse_tar_number(header.substr(136, 12));
+			if (!checksum || checksum.value() != sum || !size || !mtime)
+				{ return false; }
+			if (next_size)
+				{ size = next_size; }
+			const std::size_t data_pos = pos + block_size;
+			if (size.value() > tar.size() - data_pos)
+				{ return false; }
+			const std::string_view data = tar.substr(data_pos, static_cast<std::size_t>(size.value()));
+			pos = data_pos + (static_cast<std::size_t>(size.value()) + block_size - 1) / block_size * block_size;
+
+			const char type = header[156];
+			if (type == 'L')
+				{ next_name = std::string(data.substr(0, data.find('\0'))); }
+			else if (type == 'x')
+			{
+				// records are "<length> <key>=<value>\n"
+				for (std::string_view records = data; !records.empty();)
+				{
+					const std::size_t space = records.find(' ');
+					std::size_t length = 0;
+					for (std::size_t i = 0; i < space && i < records.size() && records[i] >= '0' && records[i] <= '9'; i++)
+						{ length = length * 10 + static_cast<std::size_t>(records[i] - '0'); }
+					if (space == std::string_view::npos || length <= space + 1 || length > records.size())
+						{ return false; }
+					std::string_view record = records.substr(space + 1, length - space - 2);
+					records.remove_prefix(length);
+					if (record.starts_with("path="))
+						{ next_name = std::string(record.substr(5)); }
+					else if (record.starts_with("size="))
+					{
+						// decimal, unlike in the header
+						std::uint64_t value;
+						const auto [end, ec] = std::from_chars(record.data() + 5, record.data() + record.size(), value);
+						if (ec != std::errc() || end != record.data() + record.size())
+							{ return false; }
+						next_size = value;
+					}
+				}
+			}
+			else if (type == '0' || type == '\0' || type == '7')
+			{
+				std::string name = next_name ? std::move(next_name.value()) : std::string(field(header, 0, 100));
+				// ustar splits long names into a prefix and a name
+				if (!next_name && header.substr(257, 5) == "ustar" && !field(header, 345, 155).empty())
+					{ name = std::string(field(header, 345, 155)) + '/' + name; }
+				out.push_back({ std::move(name), static_cast<std::int64_t>(mtime.value()), { data_pos, size.value(), size.value(), false } });
+			}
+			// anything else (directories, links and the like) is skipped, as is the pax global header
+			if (type != 'L' && type != 'x')
+			{
+				next_name.reset();
+				next_size.reset();
+			}
+		}
+		// without the zeroed blocks at the end, which some tools leave out
+		return pos == tar.size();
+	}
+
+	// @param date, time  in ms-dos format, in local time (treated as utc, since the time zone isn't known)
+	// @return seconds since epoch
+	[[nodiscard]] inline std::int64_t dos_time_to_seconds(std::uint16_t date, std::uint16_t time) noexcept
+	{
+		const std::chrono::year_month_day ymd{ std::chrono::year(1980 + (date >> 9)), std::chrono::month((date >> 5) & 0xf), std::chrono::day(date & 0x1f) };
+		if (!ymd.ok())
+			{ return 0; }
+		return std::chrono::sys_days(ymd).time_since_epoch().count() * 86400 + (time >> 11) * 3600 + ((time >> 5) & 0x3f) * 60 + (time & 0x1f) * 2;
+	}
+
+	// find the files in a zip, from its central directory (zip64 included)
+	// only stored and deflated files that aren't encrypted can be read, others are skipped
+	// @param out  receives the members, in the order they are in the central directory
+	// @return false if `zip` isn't one or is truncated
+	[[nodiscard]] inline bool list_zip_members(std::string_view zip, std::vector<bundle_member>& out)
+	{
+		constexpr std::uint32_t eocd_signature = 0x06054b50, zip64_locator_signature = 0x07064b50, zip64_eocd_signature = 0x06064b50,
+			central_signature = 0x02014b50, local_signature = 0x04034b50;
+		constexpr std::size_t eocd_size = 22, zip64_locator_size = 20, zip64_eocd_size = 56, central_size = 46, local_size = 30;
+		if (zip.size() < eocd_size)
+			{ return false; }
+		// the end of central directory record is followed by a comment of at most 65535 bytes
+		std::size_t eocd_pos = zip.size() - eocd_size;
+		const std::size_t eocd_min = zip.size() - std::min(zip.size(), eocd_size + 0xffff);
+		while (read_le<std::uint32_t>(zip, eocd_pos) != eocd_signature)
+		{
+			if (eocd_pos == eocd_min)
+				{ return false; }
+			eocd_pos--;
+		}
+		std::uint64_t num_entries = read_le<std::uint16_t>(zip, eocd_pos + 10);
+		std::uint64_t central_pos = read_le<std::uint32_t>(zip, eocd_pos + 16);
+		if (eocd_pos >= zip64_locator_size && read_le<std::uint32_t>(zip, eocd_pos - zip64_locator_size) == zip64_locator_signature)
+		{
+			const std::uint64_t zip64_eocd_pos = read_le<std::uint64_t>(zip, eocd_pos - zip64_locator_size + 8);
+			if (zip64_eocd_pos > zip.size() - zip64_eocd_size || read_le<std::uint32_t>(zip, zip64_eocd_pos) != zip64_eocd_signature)
+				{ return false; }
+			num_entries = read_le<std::uint64_t>(zip, zip64_eocd_pos + 32);
+			central_pos = read_le<std::uint64_t>(zip, zip64_eocd_pos + 48);
+		}
+
+		std::size_t pos = static_cast<std::size_t>(std::min<std::uint64_t>(central_pos, zip.size()));
+		for (std::uint64_t i = 0; i < num_entries; i++)
+		{
+			if (zip.size() - pos < central_size || read_le<std::uint32_t>(zip, pos) != central_signature)
+				{ return false; }
+			const auto flags = read_le<std::uint16_t>(zip, pos + 8);
+			const auto method = read_le<std::uint16_t>(zip, pos + 10);
+			std::int64_t mtime = dos_time_to_seconds(read_le<std::uint16_t>(zip, pos + 14), read_le<std::uint16_t>(zip, pos + 12));
+			std::uint64_t stored_size = read_le<std::uint32_t>(zip, pos + 20);
+			std::uint64_t size = read_le<std::uint32_t>(zip, pos + 24);
+			const std::size_t name_size = read_le<std::uint16_t>(zip, pos + 28);
+			const std::size_t extra_size = read_le<std::uint16_t>(zip, pos + 30);
+			const std::size_t comment_size = read_le<std::uint16_t>(zip, pos + 32);
+			std::uint64_t local_pos = read_le<std::uint32_t>(zip, pos + 42);
+			if (zip.size() - pos - central_size < name_size + extra_size + comment_size)
+				{ return false; }
+			const std::string_view name = zip.substr(pos + central_size, name_size);
+			// zip64 sizes and offset (only those that didn't fit), and the unix modification time
+			for (std::string_view extra = zip.substr(pos + central_size + name_size, extra_size); extra.size() >= 4;)
+			{
+				const auto id = read_le<std::uint16_t>(extra, 0);
+				const std::size_t field_size = std::min<std::size_t>(read_le<std::uint16_t>(extra, 2), extra.size() - 4);
+				std::string_view field = extra.substr(4, field_size);
+				extra.remove_prefix(4 + field_size);
+				if (id == 0x0001)
+				{
+					for (std::uint64_t* value : { &size, &stored_size, &local_pos })
+					{
+						if (*value != 0xffffffff || field.size() < 8)
+							{ continue; }
+						*value = read_le<std::uint64_t>(field, 0);
+						field.remove_prefix(8);
+					}
+				}
+				else if (id == 0x5455 && field.size() >= 5 && (field[0] & 1) != 0)
+					{ mtime = static_cast<std::int32_t>(read_le<std::uint32_t>(field, 1)); }
+			}
+			pos += central_size + name_size + extra_size + comment_size;
+
+			if ((flags & 1) != 0 || (method != 0 && method != 8) || name.ends_with('/'))
+				{ continue; }
+			// the data is after the local header, whose name and extra field can differ from those in the central directory
+			if (local_pos > zip.size() - local_size || read_le<std::uint32_t>(zip, static_cast<std::size_t>(local_pos)) != local_signature)
+				{ return false; }
+			const std::uint64_t data_pos = local_pos + local_size + read_le<std::uint16_t>(zip, static_cast<std::size_t>(local_pos) + 26) +
+				read_le<std::uint16_t>(zip, static_cast<std::size_t>(local_pos) + 28);
+			if (data_pos > zip.size() || stored_size > zip.size() - data_pos)
+				{ return false; }
+			out.push_back({ std::string(name), mtime, { data_pos, stored_size, size, method == 8 } });
+		}
+		return true;
+	}
+
+	// @param bundle  contents of the bundle (decompressed, for tar.gz)
+	// @param buf  receives the member if it has to be inflated
+	// @return contents of the member (a view into `bundle` or `buf`), or nullopt if they are corrupt
+	[[nodiscard]] inline std::optional<std::string_view> read_bundle_member(std::string_view bundle, const bundle_member_location& location,
+		libdeflate_decompressor* decompressor, std::string& buf)
+	{
+		if (location.offset > bundle.size() || location.stored_size > bundle.size() - location.offset)
+			{ return std::nullopt; }
+		const std::string_view stored = bundle.substr(static_cast<std::size_t>(location.offset), static_cast<std::size_t>(location.stored_size));
+		if (!location.deflated)
+			{ return stored; }
+		buf.resize_and_overwrite(static_cast<std::size_t>(location.size), [](char*, std::size_t size) { return size; });
+		std::size_t out_size;
+		if (libdeflate_deflate_decompress(decompressor, stored.data(), stored.size(), buf.data(), buf.size(), &out_size) != LIBDEFLATE_SUCCESS ||
+			out_size != buf.size())
+			{ return std::nullopt; }
+		return std::string_view(buf);
+	}
+}
+
+#endif
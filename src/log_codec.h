@@ -0,0 +1,173 @@
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <libdeflate.h>
+
+// zstd and xz are only read if the build has them (see the QC_ZSTD and QC_XZ cmake options), gzip is always read with libdeflate
+#ifdef QC_USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef QC_USE_XZ
+#include <lzma.h>
+#endif
+
+// how a log file is compressed, which is known from its extension
+// the server only gzips old logs, the others are for logs recompressed to save space (e.g. by a backup script)
+enum class log_codec : std::uint8_t
+{
+	none,  // .log
+	gzip,  // .log.gz
+	zstd,  // .log.zst
+	xz,  // .log.xz
+	count_
+};
+
+namespace detail
+{
+	// extension of logs compressed with each codec, by value
+	inline constexpr std::array<std::string_view, static_cast<std::size_t>(log_codec::count_)> log_codec_extensions = { ".log", ".log.gz", ".log.zst", ".log.xz" };
+	inline constexpr std::array<std::string_view, static_cast<std::size_t>(log_codec::count_)> log_codec_names = { "none", "gzip", "zstd", "xz" };
+
+	[[nodiscard]] constexpr std::string_view log_extension(log_codec codec) noexcept
+		{ return log_codec_extensions[static_cast<std::size_t>(codec)]; }
+
+	// @return codec of a log file by the extension of `filename`, or nullopt if it doesn't have the extension of a log
+	[[nodiscard]] constexpr std::optional<log_codec> log_codec_of(std::string_view filename) noexcept
+	{
+		for (std::size_t i = 0; i < log_codec_extensions.size(); i++)
+		{
+			if (filename.ends_with(log_codec_extensions[i]))
+				{ return static_cast<log_codec>(i); }
+		}
+		return std::nullopt;
+	}
+
+	static_assert(log_codec_of("latest.log") == log_codec::none);
+	static_assert(log_codec_of("2024-01-01-1.log.gz") == log_codec::gzip);
+	static_assert(log_codec_of("2024-01-01-1.log.zst") == log_codec::zstd);
+	static_assert(log_codec_of("2024-01-01-1.log.xz") == log_codec::xz);
+	static_assert(!log_codec_of("2024-01-01-1.gz").has_value());
+
+	// @return whether this build can decompress logs compressed with `codec`
+	[[nodiscard]] constexpr bool log_codec_supported(log_codec codec) noexcept
+	{
+		switch (codec)
+		{
+		case log_codec::none:
+		case log_codec::gzip:
+			return true;
+		case log_codec::zstd:
+#ifdef QC_USE_ZSTD
+			return true;
+#else
+			return false;
+#endif
+		case log_codec::xz:
+#ifdef QC_USE_XZ
+			return true;
+#else
+			return false;
+#endif
+		default:
+			return false;
+		}
+	}
+
+	// the codecs below report errors as libdeflate_result like gzip_decompress (see parse_logs.h), so callers handle all of them the same way:
+	// LIBDEFLATE_BAD_DATA if the data is corrupt or cut off. `out` keeps its capacity, so reusing it between files avoids reallocating
+
+	// how much bigger than the compressed data the output buffer starts, if the data doesn't say how big it is. logs compress very well
+	inline constexpr std::size_t decompressed_size_guess = 8;
+
+#ifdef QC_USE_ZSTD
+	struct zstd_dctx_deleter
+	{
+		void operator()(ZSTD_DCtx* ptr) const noexcept
+			{ ZSTD_freeDCtx(ptr); }
+	};
+
+	// decompress zstd data (possibly several frames, e.g. from pzstd or appended files) into `out`, as a stream, so frames that don't record
+	// their size (e.g. from zstd reading a pipe) decompress too
+	// @param dctx  reused between calls, since creating one allocates its window
+	inline libdeflate_result zstd_decompress(ZSTD_DCtx* dctx, std::string_view in, std::string& out)
+	{
+		out.clear();  // don't copy old contents if the buffer needs to grow
+		ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+		// size of the first frame is a good hint if it was recorded
+		const unsigned long long content_size = ZSTD_getFrameContentSize(in.data(), in.size());
+		std::size_t capacity = (content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size == ZSTD_CONTENTSIZE_ERROR) ?
+			in.size() * decompressed_size_guess : static_cast<std::size_t>(content_size);
+		capacity = std::max(capacity, ZSTD_DStreamOutSize());
+
+		ZSTD_inBuffer input{ in.data(), in.size(), 0 };
+		std::size_t out_size = 0, remaining = 0;
+		// the decoder may still have output once all input is used if the output buffer was full, unless the frame was complete
+		do
+		{
+			if (out_size == capacity)
+				{ capacity *= 2; }
+			// contents before out_size are preserved when growing
+			out.resize_and_overwrite(capacity, [](char*, std::size_t buf_size) { return buf_size; });
+			ZSTD_outBuffer output{ out.data(), capacity, out_size };
+			remaining = ZSTD_decompressStream(dctx, &output, &input);
+			out_size = output.pos;
+			if (ZSTD_isError(remaining))
+			{
+				out.resize(out_size);
+				return LIBDEFLATE_BAD_DATA;
+			}
+		} while (input.pos < input.size || (out_size == capacity && remaining != 0));
+		out.resize(out_size);
+		// 0 once a frame is complete, otherwise the data was cut off in the middle of one
+		return (remaining == 0) ? LIBDEFLATE_SUCCESS : LIBDEFLATE_BAD_DATA;
+	}
+#endif
+
+#ifdef QC_USE_XZ
+	// decompress xz data (possibly several concatenated streams) into `out`
+	inline libdeflate_result xz_decompress(std::string_view in, std::string& out)
+	{
+		out.clear();  // don't copy old contents if the buffer needs to grow
+		lzma_stream stream = LZMA_STREAM_INIT;
+		if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+			{ return LIBDEFLATE_BAD_DATA; }
+		const std::unique_ptr<lzma_stream, decltype(&lzma_end)> stream_guard(&stream, &lzma_end);
+		stream.next_in = reinterpret_cast<const std::uint8_t*>(in.data());
+		stream.avail_in = in.size();
+
+		std::size_t capacity = std::max<std::size_t>(in.size() * decompressed_size_guess, 4096), out_size = 0;
+		while (true)
+		{
+			if (out_size == capacity)
+				{ capacity *= 2; }
+			// contents before out_size are preserved when growing
+			out.resize_and_overwrite(capacity, [](char*, std::size_t buf_size) { return buf_size; });
+			stream.next_out = reinterpret_cast<std::uint8_t*>(out.data() + out_size);
+			stream.avail_out = capacity - out_size;
+			// LZMA_BUF_ERROR if the data was cut off, since all of it has been given
+			const lzma_ret res = lzma_code(&stream, LZMA_FINISH);
+			out_size = capacity - stream.avail_out;
+			if (res == LZMA_STREAM_END)
+				{ break; }
+			if (res != LZMA_OK)
+			{
+				out.resize(out_size);
+				return LIBDEFLATE_BAD_DATA;
+			}
+		}
+		out.resize(out_size);
+		return LIBDEFLATE_SUCCESS;
+	}
+#endif
+}
+
+#endif
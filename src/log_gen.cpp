@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <libdeflate.h>
+
+#include "parse_logs.h"
+
+// writes a logs directory of generated server logs, for testing and benchmarking with more data than real logs have
+// the same options and seed always give the same files (random numbers aren't from <random>, whose distributions differ between standard libraries)
+// each day has `restarts` server runs, one file each (YYYY-MM-DD-N.log.gz, and latest.log for the last one, which is still running)
+// a run ends with the server stopping, or crashing without a stop message or players leaving
+
+namespace
+{
+	struct gen_options
+	{
+		std::filesystem::path out_dir = "logs";
+		std::uint64_t seed = 1;
+		std::size_t players = 1000;
+		std::size_t days = 30;
+		std::chrono::year_month_day start{ std::chrono::year(2020), std::chrono::January, std::chrono::day(1) };
+		std::size_t restarts = 4;  // per day
+		std::size_t sessions = 0;  // per day, 0 for players / 4
+		double session_minutes = 45;  // average length
+		double crash_ratio = 0.05;  // of runs
+		double rename_ratio = 0.002;  // of joins
+		double noise = 0.9;  // fraction of lines that aren't joins, leaves, uuids or starting/stopping
+		int compression_level = 6;  // libdeflate, 0 to 12
+	};
+
+	// splitmix64, so the output doesn't depend on the standard library
+	class rng_t
+	{
+	private:
+		std::uint64_t state;
+
+	public:
+		explicit rng_t(std::uint64_t seed) noexcept : state(seed) {}
+
+		std::uint64_t next() noexcept
+		{
+			std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			return z ^ (z >> 31);
+		}
+
+		// @return in [0, 1)
+		double uniform() noexcept
+			{ return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+		// @return in [0, n)
+		std::uint64_t below(std::uint64_t n) noexcept
+			{ return static_cast<std::uint64_t>(uniform() * static_cast<double>(n)); }
+
+		bool chance(double p) noexcept
+			{ return uniform() < p; }
+
+		double exponential(double mean) noexcept
+			{ return -std::log(1 - uniform()) * mean; }
+	};
+
+	struct player_t
+	{
+		uuid_t uuid;
+		std::string name;
+		std::uint32_t renames = 0;
+		std::int64_t busy_until = 0;  // seconds from the start, end of their last session
+	};
+
+	constexpr std::array<std::string_view, 16> name_prefixes = {
+		"Steve", "Alex", "Creeper", "Diamond", "Redstone", "Ender", "Nether", "Block",
+		"Miner", "Crafty", "Pixel", "Shadow", "Frost", "Blaze", "Mossy", "Iron"
+	};
+
+	// @return name of at most 16 characters, unique because of the index
+	[[nodiscard]] std::string make_name(rng_t& rng, std::size_t index, std::uint32_t renames)
+	{
+		std::string res = std::format("{}{}", name_prefixes[rng.below(name_prefixes.size())], index);
+		if (renames != 0)
+			{ res += std::format("_{}", renames); }
+		if (res.size() > 16)
+			{ res.erase(0, res.size() - 16); }
+		return res;
+	}
+
+	// @return "[HH:MM:SS]" for seconds since midnight
+	[[nodiscard]] std::string timestamp(std::int64_t secs)
+		{ return std::format("[{:02}:{:02}:{:02}]", secs / 3600, secs / 60 % 60, secs % 60); }
+
+	struct log_line
+	{
+		std::int64_t secs;  // since midnight
+		std::string text;  // without timestamp and newline
+	};
+
+	// @return line that doesn't change any player's session
+	[[nodiscard]] std::string noise_line(rng_t& rng, const std::vector<player_t>& players)
+	{
+		switch (rng.below(8))
+		{
+		case 0:
+			return std::format("[Server thread/WARN]: Can't keep up! Is the server overloaded? Running {}ms or {} ticks behind", 2000 + rng.below(8000), 40 + rng.below(160));
+		case 1:
+			return "[Server thread/INFO]: Saving chunks for level 'ServerLevel[world]'/minecraft:overworld";
+		case 2:
+			return std::format("[Server thread/INFO]: {} has made the advancement [Monster Hunter]", players[rng.below(players.size())].name);
+		case 3:
+			return std::format("[Server thread/INFO]: {} was slain by Zombie", players[rng.below(players.size())].name);
+		default:
+			return std::format("[Server thread/INFO]: <{}> anyone want to trade {} for the game joined", players[rng.below(players.size())].name, rng.below(64));
+		}
+	}
+
+	// @return whether the option was known and its value valid
+	bool parse_option(gen_options& options, std::string_view name, std::string_view value)
+	{
+		const auto parse_uint = [value](auto& out)
+		{
+			const auto res = std::from_chars(value.data(), value.data() + value.size(), out);
+			return res.ec == std::errc() && res.ptr == value.data() + value.size();
+		};
+		const auto parse_double = [value](double& out)
+		{
+			const auto res = std::from_chars(value.data(), value.data() + value.size(), out);
+			return res.ec == std::errc() && res.ptr == value.data() + value.size() && out >= 0;
+		};
+		if (name == "--out")
+		{
+			options.out_dir = value;
+			return true;
+		}
+		if (name == "--seed")
+			{ return parse_uint(options.seed); }
+		if (name == "--players")
+			{ return parse_uint(options.players) && options.players != 0; }
+		if (name == "--days")
+			{ return parse_uint(options.days) && options.days != 0; }
+		if (name == "--restarts")
+			{ return parse_uint(options.restarts) && options.restarts != 0 && options.restarts <= 96; }
+		if (name == "--sessions")
+			{ return parse_uint(options.sessions); }
+		if (name == "--session-minutes")
+			{ return parse_double(options.session_minutes) && options.session_minutes > 0; }
+		if (name == "--crash-ratio")
+			{ return parse_double(options.crash_ratio) && options.crash_ratio <= 1; }
+		if (name == "--rename-ratio")
+			{ return parse_double(options.rename_ratio) && options.rename_ratio <= 1; }
+		if (name == "--noise")
+			{ return parse_double(options.noise) && options.noise < 1; }
+		if (name == "--level")
+			{ return parse_uint(options.compression_level) && options.compression_level <= 12; }
+		if (name == "--start")
+		{
+			int y;
+			unsigned m, d;
+			const auto parse_part = [value](std::size_t pos, std::size_t len, auto& out)
+				{ return std::from_chars(value.data() + pos, value.data() + pos + len, out).ptr == value.data() + pos + len; };
+			if (value.size() != 10 || value[4] != '-' || value[7] != '-' || !parse_part(0, 4, y) || !parse_part(5, 2, m) || !parse_part(8, 2, d))
+				{ return false; }
+			options.start = std::chrono::year(y) / std::chrono::month(m) / std::chrono::day(d);
+			return options.start.ok();
+		}
+		return false;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	gen_options options;
+	for (int i = 1; i < argc; i += 2)
+	{
+		if (i + 1 == argc || !parse_option(options, argv[i], argv[i + 1]))
+		{
+			std::cerr << "usage: log_gen [--out dir] [--seed n] [--players n] [--days n] [--start yyyy-mm-dd] [--restarts n (per day)] [--sessions n (per day)]\n"
+				"               [--session-minutes x] [--crash-ratio x] [--rename-ratio x] [--noise x (fraction of lines)] [--level n (gzip level)]\n";
+			return 1;
+		}
+	}
+	const std::size_t sessions_per_day = (options.sessions != 0) ? options.sessions : std::max<std::size_t>(options.players / 4, 1);
+
+	std::error_code ec;
+	std::filesystem::create_directories(options.out_dir, ec);
+	if (ec)
+	{
+		std::cerr << std::format("Could not create {}: {}\n", options.out_dir.string(), ec.message());
+		return 1;
+	}
+
+	rng_t rng(options.seed);
+	std::vector<player_t> players(options.players);
+	for (std::size_t i = 0; i < players.size(); i++)
+	{
+		// version 4 uuid, digit i is nibble i (see the uuid_t formatter)
+		players[i].uuid = { (rng.next() & ~(0xfull << 48)) | (4ull << 48), (rng.next() & ~0xcull) | 0x8 };
+		players[i].name = make_name(rng, i, 0);
+	}
+	// how often each player plays falls off like a power law, so a few players have most of the playtime
+	std::vector<double> cumulative_weights(players.size());
+	double weight_sum = 0;
+	for (std::size_t i = 0; i < players.size(); i++)
+	{
+		weight_sum += 1 / std::pow(static_cast<double>(rng.below(players.size()) + 1), 0.8);
+		cumulative_weights[i] = weight_sum;
+	}
+
+	const std::unique_ptr<libdeflate_compressor, decltype(&libdeflate_free_compressor)> compressor(libdeflate_alloc_compressor(options.compression_level), &libdeflate_free_compressor);
+	std::string contents, compressed;
+	std::vector<log_line> lines;
+	std::vector<std::size_t> online;  // players in the current run
+	std::size_t num_files = 0, num_lines = 0, num_sessions = 0;
+	std::uintmax_t num_bytes = 0;
+	const std::int64_t run_length = 86400 / static_cast<std::int64_t>(options.restarts);
+
+	for (std::size_t day_ind = 0; day_ind < options.days; day_ind++)
+	{
+		const std::chrono::sys_days day = std::chrono::sys_days(options.start) + std::chrono::days(day_ind);
+		const std::int64_t day_start = static_cast<std::int64_t>(day_ind) * 86400;
+
+		// sessions of the day, started in order so players don't overlap themselves
+		std::vector<std::pair<std::int64_t, std::size_t>> starts(sessions_per_day);  // second of the day and player
+		for (auto& [secs, player] : starts)
+		{
+			secs = static_cast<std::int64_t>(rng.below(86400));
+			player = std::ranges::upper_bound(cumulative_weights, rng.uniform() * weight_sum) - cumulative_weights.begin();
+			player = std::min(player, players.size() - 1);
+		}
+		std::ranges::sort(starts);
+
+		std::size_t next_start = 0;
+		for (std::size_t run = 0; run < options.restarts; run++)
+		{
+			const std::int64_t run_begin = static_cast<std::int64_t>(run) * run_length;
+			const std::int64_t boot_done = run_begin + 20;
+			std::int64_t run_end = run_begin + run_length - 10;
+			const bool is_latest = (day_ind + 1 == options.days && run + 1 == options.restarts);
+			const bool crashed = !is_latest && rng.chance(options.crash_ratio);
+			if (crashed)
+				{ run_end = boot_done + static_cast<std::int64_t>(rng.below(static_cast<std::uint64_t>(run_end - boot_done))); }
+
+			lines.clear();
+			online.clear();
+			lines.emplace_back(run_begin, "[main/INFO]: Starting minecraft server version 1.20.1");
+			lines.emplace_back(boot_done, std::format("[Server thread/INFO]: Done ({}.{:03}s)! For help, type \"help\"", 5 + rng.below(20), rng.below(1000)));
+			for (; next_start < starts.size() && starts[next_start].first < run_begin + run_length; next_start++)
+			{
+				const auto [start_secs, player_ind] = starts[next_start];
+				const std::int64_t join = std::max(start_secs, boot_done + 1);
+				player_t& player = players[player_ind];
+				if (join >= run_end || day_start + join <= player.busy_until)
+					{ continue; }
+				const std::int64_t leave = std::min(join + 1 + static_cast<std::int64_t>(rng.exponential(options.session_minutes * 60)), run_end);
+				player.busy_until = day_start + leave;
+				num_sessions++;
+
+				std::string old_name;
+				if (rng.chance(options.rename_ratio))
+				{
+					old_name = std::move(player.name);
+					player.name = make_name(rng, player_ind, ++player.renames);
+				}
+				lines.emplace_back(join, std::format("[User Authenticator #{}/INFO]: UUID of player {} is {}", 1 + rng.below(4), player.name, player.uuid));
+				if (old_name.empty())
+					{ lines.emplace_back(join, std::format("[Server thread/INFO]: {} joined the game", player.name)); }
+				else
+					{ lines.emplace_back(join, std::format("[Server thread/INFO]: {} (formerly known as {}) joined the game", player.name, old_name)); }
+				// players still online when the run ends are kicked when it stops, or never leave if it crashed
+				if (leave < run_end)
+				{
+					lines.emplace_back(leave, std::format("[Server thread/INFO]: {} lost connection: Disconnected", player.name));
+					lines.emplace_back(leave, std::format("[Server thread/INFO]: {} left the game", player.name));
+				}
+				else
+					{ online.push_back(player_ind); }
+			}
+
+			// noise lines at random times, with the occasional stack trace (lines without a timestamp) after a warning
+			const std::size_t num_relevant = lines.size();
+			const auto num_noise = static_cast<std::size_t>(static_cast<double>(num_relevant) * options.noise / (1 - options.noise));
+			for (std::size_t i = 0; i < num_noise; i++)
+			{
+				const std::int64_t secs = boot_done + static_cast<std::int64_t>(rng.below(static_cast<std::uint64_t>(run_end - boot_done)));
+				lines.emplace_back(secs, noise_line(rng, players));
+				if (rng.chance(0.01))
+				{
+					lines.back().text = "[Server thread/ERROR]: Encountered an unexpected exception\n"
+						"java.lang.NullPointerException: Cannot invoke \"net.minecraft.world.entity.Entity.getId()\" because \"entity\" is null\n"
+						"\tat net.minecraft.server.MinecraftServer.tickServer(MinecraftServer.java:895)";
+				}
+			}
+			std::ranges::stable_sort(lines, {}, &log_line::secs);
+
+			if (!crashed && !is_latest)
+			{
+				lines.emplace_back(run_end, "[Server thread/INFO]: Stopping the server");
+				lines.emplace_back(run_end, "[Server thread/INFO]: Stopping server");
+				lines.emplace_back(run_end, "[Server thread/INFO]: Saving players");
+				for (const std::size_t player_ind : online)
+				{
+					lines.emplace_back(run_end, std::format("[Server thread/INFO]: {} lost connection: Server closed", players[player_ind].name));
+					lines.emplace_back(run_end, std::format("[Server thread/INFO]: {} left the game", players[player_ind].name));
+				}
+			}
+
+			contents.clear();
+			for (const auto& [secs, text] : lines)
+			{
+				contents += timestamp(secs);
+				contents += ' ';
+				contents += text;
+				contents += '\n';
+			}
+			num_lines += lines.size();
+
+			std::filesystem::path path;
+			if (is_latest)
+			{
+				path = options.out_dir / "latest.log";
+				std::ofstream(path, std::ios::binary).write(contents.data(), static_cast<std::streamsize>(contents.size()));
+				// the date of latest.log comes from when it was last written
+				const auto last_write = day + std::chrono::seconds(lines.back().secs);
+				std::filesystem::last_write_time(path, std::chrono::clock_cast<std::chrono::file_clock>(std::chrono::system_clock::time_point(last_write)), ec);
+			}
+			else
+			{
+				path = options.out_dir / std::format("{:%F}-{}.log.gz", day, run + 1);
+				compressed.resize(libdeflate_gzip_compress_bound(compressor.get(), contents.size()));
+				compressed.resize(libdeflate_gzip_compress(compressor.get(), contents.data(), contents.size(), compressed.data(), compressed.size()));
+				std::ofstream(path, std::ios::binary).write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+			}
+			num_bytes += std::filesystem::file_size(path, ec);
+			num_files++;
+		}
+	}
+
+	std::cout << std::format("Wrote {} files ({} lines, {} sessions, {:.1f} MB) to {}\n", num_files, num_lines, num_sessions,
+		static_cast<double>(num_bytes) / 1e6, options.out_dir.string());
+	return 0;
+}
@@ -0,0 +1,318 @@
+#ifndef LOG_LISTENER_H
+#define LOG_LISTENER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "logger.h"
+#include "net_socket.h"
+#include "parse_logs.h"
+
+namespace detail
+{
+	// @return message of a syslog line (rfc 5424 or rfc 3164), or `line` if it doesn't start with a priority like <13>
+	[[nodiscard]] constexpr std::string_view strip_syslog_header(std::string_view line) noexcept
+	{
+		using namespace std::string_view_literals;
+		const std::size_t pri_end = line.find('>');
+		if (!line.starts_with('<') || pri_end < 2 || pri_end > 4 || line.substr(1, pri_end - 1).find_first_not_of("0123456789"sv) != std::string_view::npos)
+			{ return line; }
+		std::string_view rest = line.substr(pri_end + 1);
+		const auto skip_token = [&rest]()
+		{
+			const std::size_t end = rest.find(' ');
+			rest.remove_prefix((end == std::string_view::npos) ? rest.size() : end + 1);
+		};
+		if (rest.starts_with("1 "sv))
+		{
+			// rfc 5424: VERSION TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG
+			rest.remove_prefix(2);
+			for (int i = 0; i < 5; i++)
+				{ skip_token(); }
+			// structured data is - or [...] elements, whose quoted values may have spaces and escaped brackets
+			if (rest.starts_with('-'))
+				{ rest.remove_prefix(1); }
+			while (rest.starts_with('['))
+			{
+				bool quoted = false;
+				std::size_t pos = 1;
+				for (; pos < rest.size() && (quoted || rest[pos] != ']'); pos++)
+				{
+					if (rest[pos] == '\\')
+						{ pos++; }
+					else if (rest[pos] == '"')
+						{ quoted = !quoted; }
+				}
+				rest.remove_prefix(std::min(pos + 1, rest.size()));
+			}
+			if (rest.starts_with(' '))
+				{ rest.remove_prefix(1); }
+			if (rest.starts_with("\xEF\xBB\xBF"sv))  // utf-8 bom
+				{ rest.remove_prefix(3); }
+			return rest;
+		}
+		// rfc 3164: TIMESTAMP (Mmm dd hh:mm:ss) HOSTNAME TAG: MSG, where senders often leave out the timestamp and hostname
+		if (rest.size() > 16 && rest[3] == ' ' && rest[6] == ' ' && rest[9] == ':' && rest[12] == ':' && rest[15] == ' ')
+		{
+			rest.remove_prefix(16);
+			skip_token();
+		}
+		// the tag is like minecraft[123]: and log lines start with a timestamp in brackets, so one can't be mistaken for the other
+		if (const std::size_t tag_end = rest.find(' '); tag_end != std::string_view::npos && tag_end != 0 && tag_end <= 48 && !rest.starts_with('[') && rest[tag_end - 1] == ':')
+			{ rest.remove_prefix(tag_end + 1); }
+		return rest;
+	}
+	static_assert(strip_syslog_header("<13>1 2024-01-01T00:00:00Z host mc 123 - - [01:02:03] x") == "[01:02:03] x");
+	static_assert(strip_syslog_header("<13>1 - - - - - [a b=\"c] d\"][e] [01:02:03] x") == "[01:02:03] x");
+	static_assert(strip_syslog_header("<13>Jan  1 00:00:00 host minecraft[12]: [01:02:03] x") == "[01:02:03] x");
+	static_assert(strip_syslog_header("<13>minecraft: [01:02:03] x") == "[01:02:03] x" && strip_syslog_header("<13>[01:02:03] x") == "[01:02:03] x");
+	static_assert(strip_syslog_header("[01:02:03] x") == "[01:02:03] x" && strip_syslog_header("<a>[01:02:03] x") == "<a>[01:02:03] x");
+}
+
+// receives log lines pushed over the network, for servers whose latest.log can't be watched well (e.g. over nfs on another host)
+// - tcp: lines ending with \n, from any number of connections (e.g. from a log forwarding plugin)
+// - udp on the same port: syslog messages, or one or more plain lines per datagram
+// lines may have a syslog header either way, which is removed (see detail::strip_syslog_header)
+// anyone who can connect can add lines, so it should only listen on an address that is trusted
+// sockets are polled on the calling thread, so lines can be parsed right after they are received
+class log_listener
+{
+private:
+	using socket_t = detail::socket_t;
+
+	struct client_t
+	{
+		socket_t socket;
+		std::string partial;  // start of a line whose \n hasn't been received yet
+	};
+
+	static constexpr std::size_t max_clients = 64;  // more connections are closed right away
+	static constexpr std::size_t max_line_size = 1 << 16;  // a client sending a longer line is disconnected
+	static constexpr std::size_t max_batch_size = 16 << 20;  // received before returning, so a flood is parsed in parts
+
+	socket_t tcp_listener = detail::invalid_socket, udp_socket = detail::invalid_socket;
+	std::vector<client_t> clients;
+	std::vector<detail::pollfd_t> poll_fds;  // listener, udp, then clients
+	std::string buf;
+
+	// append `line` to `out` without its syslog header, and with a \n
+	static void add_line(std::string_view line, std::string& out)
+	{
+		while (line.ends_with('\r'))
+			{ line.remove_suffix(1); }
+		line = detail::strip_syslog_header(line);
+		if (line.empty())
+			{ return; }
+		out += line;
+		out += '\n';
+	}
+
+	// append complete lines in `data` to `out`
+	// @param partial  start of the first line, replaced with the incomplete line at the end of `data`
+	// @return false if a line is too long
+	[[nodiscard]] static bool add_lines(std::string_view data, std::string& partial, std::string& out)
+	{
+		for (std::size_t end = data.find('\n'); end != std::string_view::npos; end = data.find('\n'))
+		{
+			if (partial.empty())
+				{ add_line(data.substr(0, end), out); }
+			else
+			{
+				partial.append(data.substr(0, end));
+				add_line(partial, out);
+				partial.clear();
+			}
+			data.remove_prefix(end + 1);
+		}
+		partial.append(data);
+		return partial.size() <= max_line_size;
+	}
+
+	// @return false once the client has hung up or sent a line that is too long
+	[[nodiscard]] bool read_client(client_t& client, std::string& out)
+	{
+		const auto num_read = recv(client.socket, buf.data(), static_cast<int>(buf.size()), 0);
+		if (num_read <= 0)
+		{
+			// the last line may not have a \n
+			add_line(client.partial, out);
+			return false;
+		}
+		if (!add_lines(std::string_view(buf.data(), static_cast<std::size_t>(num_read)), client.partial, out))
+		{
+			log_message(log_severity::warning, std::format("Log forwarding client sent a line longer than {} bytes, disconnecting it", max_line_size));
+			return false;
+		}
+		return true;
+	}
+
+	void read_datagram(std::string& out)
+	{
+		const auto num_read = recv(udp_socket, buf.data(), static_cast<int>(buf.size()), 0);
+		if (num_read <= 0)
+			{ return; }
+		// a datagram is a whole message, so its last line is complete without a \n
+		std::string partial;
+		std::ignore = add_lines(std::string_view(buf.data(), static_cast<std::size_t>(num_read)), partial, out);
+		add_line(partial, out);
+	}
+
+	void accept_client()
+	{
+		const socket_t client = accept(tcp_listener, nullptr, nullptr);
+		if (client == detail::invalid_socket)
+			{ return; }
+		if (clients.size() >= max_clients)
+		{
+			log_message(log_severity::warning, std::format("More than {} log forwarding clients, closing new connection", max_clients));
+			detail::close_socket(client);
+			return;
+		}
+		clients.push_back({ client, std::string() });
+	}
+
+	void cleanup() noexcept
+	{
+		for (const socket_t s : { tcp_listener, udp_socket })
+		{
+			if (s != detail::invalid_socket)
+				{ detail::close_socket(s); }
+		}
+		for (const client_t& client : clients)
+			{ detail::close_socket(client.socket); }
+		clients.clear();
+		detail::cleanup_sockets();
+	}
+
+public:
+	// @param address  ipv4 address to listen on, e.g. 0.0.0.0 to accept lines from other hosts
+	// @throws std::runtime_error if the address is invalid or can't be listened on
+	log_listener(const std::string& address, std::uint16_t port) : buf(64 << 10, '\0')
+	{
+		if (!detail::init_sockets())
+			{ throw std::runtime_error("Could not initialize sockets for receiving logs"); }
+		tcp_listener = detail::bind_socket(address, port, SOCK_STREAM);
+		udp_socket = detail::bind_socket(address, port, SOCK_DGRAM);
+		if (tcp_listener == detail::invalid_socket || udp_socket == detail::invalid_socket)
+		{
+			cleanup();
+			throw std::runtime_error(std::format("Could not listen for log lines on {}:{} (is it a valid ipv4 address?)", address, port));
+		}
+	}
+	log_listener(const log_listener&) = delete;
+	log_listener& operator=(const log_listener&) = delete;
+	~log_listener()
+		{ cleanup(); }
+
+	// wait for lines, then receive everything sent so far (up to a limit, so there may be more)
+	// @param out  complete lines received are appended, each with a \n
+	// @param timeout  max time to wait, or nullopt to wait indefinitely
+	// @return false on error
+	[[nodiscard]] bool receive(std::string& out, std::optional<std::chrono::milliseconds> timeout = std::nullopt)
+	{
+		// clamp so it fits in an int and isn't -1 (wait indefinitely)
+		int timeout_ms = timeout ? static_cast<int>(std::clamp<std::chrono::milliseconds::rep>(timeout->count(), 0, std::numeric_limits<int>::max())) : -1;
+		while (out.size() < max_batch_size)
+		{
+			poll_fds.clear();
+			for (const socket_t s : { tcp_listener, udp_socket })
+				{ poll_fds.push_back({ .fd = s, .events = POLLIN, .revents = 0 }); }
+			for (const client_t& client : clients)
+				{ poll_fds.push_back({ .fd = client.socket, .events = POLLIN, .revents = 0 }); }
+			const int num_ready = detail::poll_sockets(poll_fds.data(), poll_fds.size(), timeout_ms);
+			if (num_ready < 0)
+				{ return false; }
+			if (num_ready == 0)
+				{ return true; }
+			// after the first wait, only what is already there is read
+			timeout_ms = 0;
+
+			// clients are read before new ones are accepted, so poll_fds matches clients
+			std::size_t num_kept = 0;
+			for (std::size_t i = 0; i < clients.size(); i++)
+			{
+				const short revents = poll_fds[i + 2].revents;
+				if ((revents & (POLLIN | POLLHUP | POLLERR)) != 0 && !read_client(clients[i], out))
+					{ detail::close_socket(clients[i].socket); }
+				else if (num_kept++ != i)
+					{ clients[num_kept - 1] = std::move(clients[i]); }
+			}
+			clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(num_kept), clients.end());
+			if ((poll_fds[1].revents & POLLIN) != 0)
+				{ read_datagram(out); }
+			if ((poll_fds[0].revents & POLLIN) != 0)
+				{ accept_client(); }
+		}
+		return true;
+	}
+
+	// @return open tcp connections
+	[[nodiscard]] std::size_t num_clients() const noexcept
+		{ return clients.size(); }
+};
+
+// parse lines received by a log_listener, dated by when they were received since log lines only have the time of day, passing what changes to `consumer`
+// a line whose time is later than `now` (by more than an allowance for clocks that differ) is from the day before, e.g. one sent just before midnight
+// @param timezone  of the times in the lines (see server_config_t::logs_timezone)
+// @param consumer  see parse_events
+// @return whether players have joined/left
+template<log_format_policy line_format = vanilla_log_format>
+inline bool parse_received_events(std::string_view lines, std::chrono::system_clock::time_point now, const std::chrono::time_zone* timezone, parse_ctx_t& ctx,
+	auto&& consumer)
+{
+	constexpr int max_clock_difference = 60 * 60;
+	const auto local_now = timezone->to_local(now);
+	const auto today = std::chrono::floor<std::chrono::days>(local_now);
+	const int now_secs = static_cast<int>(std::chrono::floor<std::chrono::seconds>(local_now - today).count());
+	const std::chrono::system_clock::time_point dates[] = {
+		timezone->to_sys(today - std::chrono::days(1), std::chrono::choose::earliest), timezone->to_sys(today, std::chrono::choose::earliest) };
+
+	// lines are parsed in runs of the same date, lines without a timestamp belong to the run they are in
+	bool players_changed = false;
+	std::size_t run_start = 0, pos = 0;
+	std::optional<std::chrono::system_clock::time_point> run_date;
+	const auto parse_run = [&](std::size_t end)
+	{
+		if (end == run_start)
+			{ return; }
+		ctx.date_tp = run_date.value_or(dates[1]);
+		if (parse_events<line_format>(lines.substr(run_start, end - run_start), ctx, consumer))
+			{ players_changed = true; }
+		run_start = end;
+	};
+	while (pos < lines.size())
+	{
+		const std::size_t line_start = pos;
+		const std::size_t line_end = lines.find('\n', pos);
+		pos = (line_end == std::string_view::npos) ? lines.size() : line_end + 1;
+		const auto prefix = line_format::parse_prefix(lines.substr(line_start, pos - line_start));
+		if (!prefix)
+			{ continue; }
+		const auto date = dates[(prefix->secs > now_secs + max_clock_difference) ? 0 : 1];
+		if (run_date && run_date.value() != date)
+			{ parse_run(line_start); }
+		run_date = date;
+	}
+	parse_run(lines.size());
+	ctx.date_tp = dates[1];  // lines received later aren't from before today
+	return players_changed;
+}
+
+// @param merge_gap  see session_aggregator
+// @return whether players have joined/left
+template<log_format_policy line_format = vanilla_log_format>
+inline bool parse_received_lines(std::string_view lines, std::chrono::system_clock::time_point now, const std::chrono::time_zone* timezone, parse_ctx_t& ctx,
+	log_data_t& data, std::chrono::system_clock::duration merge_gap = {})
+	{ return parse_received_events<line_format>(lines, now, timezone, ctx, session_aggregator(data, merge_gap)); }
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef LOG_REPLAY_H
+#define LOG_REPLAY_H
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <libdeflate.h>
+
+#include "file_watcher.h"
+#include "log_tailer.h"
+#include "parse_logs.h"
+
+// replays a recorded log into a test latest.log with its original timing, rotating it like the server does,
+// while following it like the bot does (file watcher, log_tailer and parse_lines). used by log_test and load_test
+// lines with the same timestamp are written at once (the server logs them within the same second), and lines without one
+// (like stack traces) go with the line before them. latest.log is rotated at a restart (a "Starting minecraft server" line)
+// and when the time of day goes backwards (midnight): it is closed, renamed to yyyy-mm-dd-n.log and then compressed to .log.gz,
+// like log4j does, and the next line starts a new latest.log
+
+struct replay_options
+{
+	std::filesystem::path recorded;
+	std::filesystem::path dir = "replay";
+	double speed = 1;  // x times faster than the log's timing
+	double max_gap = 0;  // longer pauses are shortened to this many seconds (after the speedup), 0 for no limit
+};
+
+// lines written at once
+struct replay_burst
+{
+	std::string_view lines;  // including the final newline
+	std::chrono::seconds time;  // since the start of the replay, in log time (before the speedup)
+	bool rotate_before;
+	bool new_day;  // the time went past midnight, so archives are of the next date
+	bool join_leave;
+};
+
+// a burst that was written, to be matched with when it was parsed
+struct written_burst
+{
+	std::size_t file_index;  // how many times latest.log was rotated before it
+	std::uint64_t end_offset;  // in latest.log
+	std::chrono::steady_clock::time_point time;
+	bool join_leave;
+};
+
+// bursts written and not parsed yet, shared by the writer and the follower
+struct replay_progress
+{
+	std::mutex mutex;
+	std::deque<written_burst> pending;
+	std::atomic<bool> done = false;
+};
+
+struct latency_stats
+{
+	std::vector<double> ms;
+
+	void add(std::chrono::steady_clock::duration d)
+		{ ms.push_back(std::chrono::duration<double, std::milli>(d).count()); }
+
+	void print(std::string_view name)
+	{
+		if (ms.empty())
+		{
+			std::cout << std::format("{:<32} no samples\n", name);
+			return;
+		}
+		std::ranges::sort(ms);
+		const auto percentile = [this](double p) { return ms[std::min(ms.size() - 1, static_cast<std::size_t>(p * static_cast<double>(ms.size())))]; };
+		std::cout << std::format("{:<32}{:>8} samples  p50 {:.2f} ms  p90 {:.2f} ms  p99 {:.2f} ms  max {:.2f} ms\n", name, ms.size(), percentile(0.5),
+			percentile(0.9), percentile(0.99), ms.back());
+	}
+};
+
+namespace detail
+{
+	// @return seconds since midnight of a line starting with [hh:mm:ss], or nullopt if it doesn't
+	[[nodiscard]] inline std::optional<std::chrono::seconds> replay_line_time(std::string_view line)
+	{
+		if (line.size() < 10 || line[0] != '[' || line[3] != ':' || line[6] != ':' || line[9] != ']')
+			{ return {}; }
+		int h, m, s;
+		const auto parse_part = [line](std::size_t pos, int& out)
+			{ return std::from_chars(line.data() + pos, line.data() + pos + 2, out).ptr == line.data() + pos + 2; };
+		if (!parse_part(1, h) || !parse_part(4, m) || !parse_part(7, s))
+			{ return {}; }
+		return std::chrono::hours(h) + std::chrono::minutes(m) + std::chrono::seconds(s);
+	}
+}
+
+// @return bursts of `contents`, with times continuing past midnight
+[[nodiscard]] inline std::vector<replay_burst> split_bursts(std::string_view contents)
+{
+	std::vector<replay_burst> res;
+	std::optional<std::chrono::seconds> prev_time;
+	std::chrono::seconds day_offset{}, first_time{};
+	std::size_t pos = 0;
+	while (pos < contents.size())
+	{
+		const std::size_t begin = pos;
+		std::size_t end = contents.find('\n', pos);
+		end = (end == std::string_view::npos) ? contents.size() : end + 1;
+		pos = end;
+		const std::string_view line = contents.substr(begin, end - begin);
+		const bool join_leave = line.contains(" joined the game") || line.contains(" left the game");
+		const auto time = detail::replay_line_time(line);
+		if (!res.empty() && (!time || time == prev_time) && !line.contains("Starting minecraft server"))
+		{
+			replay_burst& cur = res.back();
+			cur.lines = std::string_view(cur.lines.data(), cur.lines.size() + line.size());
+			cur.join_leave = cur.join_leave || join_leave;
+			continue;
+		}
+		const bool new_day = time && prev_time && time.value() < prev_time.value();
+		if (new_day)
+			{ day_offset += std::chrono::days(1); }
+		const bool rotate = new_day || (!res.empty() && line.contains("Starting minecraft server"));
+		const auto cur_time = day_offset + time.value_or(prev_time.value_or(std::chrono::seconds(0)));
+		if (res.empty())
+			{ first_time = cur_time; }
+		res.push_back({ line, cur_time - first_time, rotate, new_day, join_leave });
+		if (time)
+			{ prev_time = time; }
+	}
+	return res;
+}
+
+// @return contents of `path`, decompressed if it ends with .gz, or nullopt if it can't be read
+[[nodiscard]] inline std::optional<std::string> read_recorded(const std::filesystem::path& path)
+{
+	std::ifstream fin(path, std::ios::binary);
+	if (!fin)
+		{ return {}; }
+	std::string contents((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+	if (path.extension() != ".gz")
+		{ return contents; }
+	const std::unique_ptr<libdeflate_decompressor, detail::libdeflate_decompressor_deleter> decompressor(libdeflate_alloc_decompressor());
+	std::string res;
+	if (detail::gzip_decompress(decompressor.get(), contents, res) != LIBDEFLATE_SUCCESS)
+		{ return {}; }
+	return res;
+}
+
+// write the bursts to latest.log in `options.dir` at their times, rotating it where they say
+// @param num_rotations  incremented for each rotation
+inline void replay_bursts(const replay_options& options, const std::vector<replay_burst>& bursts, replay_progress& progress, std::size_t& num_rotations)
+{
+	const std::filesystem::path latest_log = options.dir / "latest.log";
+	const std::unique_ptr<libdeflate_compressor, decltype(&libdeflate_free_compressor)> compressor(libdeflate_alloc_compressor(6), &libdeflate_free_compressor);
+	auto date = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+	int archive_num = 0;  // of the last archive of `date`
+	std::size_t file_index = 0;
+	std::uint64_t offset = 0;
+	std::ofstream fout;
+
+	const auto rotate = [&](bool next_day)
+	{
+		fout.close();
+		archive_num++;
+		const std::filesystem::path archive = options.dir / std::format("{:%F}-{}.log", date, archive_num);
+		std::filesystem::rename(latest_log, archive);
+		std::string contents = read_recorded(archive).value_or(std::string());
+		std::string compressed(libdeflate_gzip_compress_bound(compressor.get(), contents.size()), '\0');
+		compressed.resize(libdeflate_gzip_compress(compressor.get(), contents.data(), contents.size(), compressed.data(), compressed.size()));
+		std::ofstream(archive.string() + ".gz", std::ios::binary).write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+		std::filesystem::remove(archive);
+		if (next_day)
+		{
+			date += std::chrono::days(1);
+			archive_num = 0;
+		}
+		file_index++;
+		offset = 0;
+		num_rotations++;
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	std::chrono::duration<double> replay_time{};  // of the previous burst, after the speedup and gap limit
+	std::chrono::seconds prev_time{};
+	for (const replay_burst& cur : bursts)
+	{
+		std::chrono::duration<double> gap = (cur.time - prev_time) / options.speed;
+		if (options.max_gap != 0)
+			{ gap = std::min(gap, std::chrono::duration<double>(options.max_gap)); }
+		replay_time += gap;
+		std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(replay_time));
+
+		if (cur.rotate_before && fout.is_open())
+			{ rotate(cur.new_day); }
+		prev_time = cur.time;
+		if (!fout.is_open())
+			{ fout.open(latest_log, std::ios::binary | std::ios::app); }
+		offset += cur.lines.size();
+		// added before writing, so the follower can't parse the lines before knowing when they were written
+		{
+			std::scoped_lock lock(progress.mutex);
+			progress.pending.push_back({ file_index, offset, std::chrono::steady_clock::now(), cur.join_leave });
+		}
+		fout.write(cur.lines.data(), static_cast<std::streamsize>(cur.lines.size()));
+		fout.flush();
+	}
+	fout.close();
+}
+
+#if defined(__linux__) || defined(_WIN32)
+
+// called by follow_replay after it parses lines, before the bursts they are from count as parsed
+// @param players_changed  whether players joined or left (see parse_lines)
+// @param rotated  whether they were the last of a latest.log that was rotated
+using replay_parsed_t = std::function<void(const parse_ctx_t& parse_ctx, log_data_t& data, bool players_changed, bool rotated)>;
+
+// follow latest.log in `dir` like the bot does until the replay is done, recording how long after being written bursts were parsed
+// @param parse_latency  of every burst
+// @param presence_latency  of bursts with a join or leave that changed the number of players online
+// @param num_events  incremented for each watcher event
+// @return whether watching worked
+inline bool follow_replay(const std::filesystem::path& dir, replay_progress& progress, latency_stats& parse_latency, latency_stats& presence_latency,
+	std::size_t& num_events, const replay_parsed_t& on_parsed = {})
+{
+	const std::string file = "latest.log";
+#ifdef _WIN32
+	bool notify_on_last_write = false;
+#define FILE_WATCHER_USER_DATA &notify_on_last_write
+#else
+#define FILE_WATCHER_USER_DATA nullptr
+#endif
+	auto ctx = file_watcher_init(dir.string().c_str(), file.c_str(), file.size(), FILE_WATCHER_USER_DATA);
+#undef FILE_WATCHER_USER_DATA
+	if (!ctx.has_value)
+		{ return false; }
+
+	log_tailer tailer(dir / file);
+	parse_ctx_t parse_ctx;
+	log_data_t data;
+	std::size_t file_index = 0;
+	std::size_t num_players = 0;
+	// bursts of the current file up to `end` (or all bursts of earlier files) have been parsed
+	const auto parsed = [&](std::uint64_t end, bool players_changed, bool rotated)
+	{
+		if (on_parsed)
+			{ on_parsed(parse_ctx, data, players_changed, rotated); }
+		const auto now = std::chrono::steady_clock::now();
+		const std::size_t new_num_players = parse_ctx.player_info.online().size();
+		std::scoped_lock lock(progress.mutex);
+		while (!progress.pending.empty() && (progress.pending.front().file_index < file_index ||
+			(progress.pending.front().file_index == file_index && progress.pending.front().end_offset <= end)))
+		{
+			const written_burst& cur = progress.pending.front();
+			parse_latency.add(now - cur.time);
+			if (cur.join_leave && players_changed && new_num_players != num_players)
+				{ presence_latency.add(now - cur.time); }
+			progress.pending.pop_front();
+		}
+		num_players = new_num_players;
+	};
+	// times in latest.log are of the day it was written on, like update_date_tp in main.cpp (logs are in utc here)
+	const auto open = [&]()
+	{
+		tailer.open();
+		std::error_code ec;
+		const auto write_time = std::filesystem::last_write_time(dir / file, ec);
+		if (!ec)
+			{ parse_ctx.date_tp = file_modification_date(write_time, std::chrono::locate_zone("UTC")); }
+	};
+	const auto read = [&]()
+	{
+		const auto size = tailer.size().value_or(0);
+		while (tailer.get_offset() < size)
+		{
+			const auto lines = tailer.read(size);
+			if (!lines || lines->empty())
+				{ break; }
+			parsed(tailer.parsed_offset(), parse_lines(lines.value(), parse_ctx, data), false);
+		}
+	};
+
+	bool ok = true;
+	while (ok)
+	{
+		const auto res = file_watcher_poll(&ctx);
+		if (res.state == -1)
+			{ ok = false; }
+		else if (res.state == 1)
+		{
+			num_events++;
+			if (res.event_create && tailer.replaced())
+				{ open(); }
+			if (res.event_modify)
+			{
+				if (!tailer.is_open())
+					{ open(); }
+				read();
+			}
+			if (res.moved_to != nullptr)
+			{
+				if (tailer.is_open())
+				{
+					read();
+					const auto last_line = tailer.flush();
+					const bool players_changed = !last_line.empty() && parse_lines(last_line, parse_ctx, data);
+					file_index++;
+					parsed(0, players_changed, true);
+				}
+				tailer.close();
+				std::free(res.moved_to);
+			}
+		}
+		else if (res.state == 0)
+		{
+			if (progress.done)
+			{
+				std::scoped_lock lock(progress.mutex);
+				if (progress.pending.empty())
+					{ break; }
+			}
+			if (file_watcher_wait(&ctx, 100) == -1)
+				{ ok = false; }
+		}
+	}
+	return file_watcher_cleanup(&ctx) && ok;
+}
+
+#endif
+
+// parse an option of the replay (--dir, --speed or --max-gap)
+// @return whether it is one and `value` is valid
+[[nodiscard]] inline bool parse_replay_option(replay_options& options, std::string_view name, std::string_view value)
+{
+	const auto parse_double = [value](double& out)
+		{ return std::from_chars(value.data(), value.data() + value.size(), out).ptr == value.data() + value.size(); };
+	if (name == "--dir")
+	{
+		options.dir = value;
+		return true;
+	}
+	if (name == "--speed")
+		{ return parse_double(options.speed) && options.speed > 0; }
+	if (name == "--max-gap")
+		{ return parse_double(options.max_gap) && options.max_gap >= 0; }
+	return false;
+}
+
+// start the replay of `options.recorded` from an empty `options.dir`, like a server's first start
+// @return its bursts (which view `contents`), or empty after printing why it can't be
+[[nodiscard]] inline std::vector<replay_burst> prepare_replay(const replay_options& options, std::optional<std::string>& contents)
+{
+	contents = read_recorded(options.recorded);
+	if (!contents)
+	{
+		std::cerr << std::format("Could not read {}\n", options.recorded.string());
+		return {};
+	}
+	std::vector<replay_burst> bursts = split_bursts(contents.value());
+	if (bursts.empty())
+	{
+		std::cerr << std::format("{} has no lines\n", options.recorded.string());
+		return {};
+	}
+	std::error_code ec;
+	std::filesystem::remove_all(options.dir, ec);
+	std::filesystem::create_directories(options.dir, ec);
+	if (ec)
+	{
+		std::cerr << std::format("Could not create {}: {}\n", options.dir.string(), ec.message());
+		return {};
+	}
+	std::cout << std::format("Replaying {} bursts of lines over {:%T} of log time at {}x into {}\n", bursts.size(), bursts.back().time, options.speed,
+		std::filesystem::absolute(options.dir).string());
+	return bursts;
+}
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef LOG_TAILER_H
+#define LOG_TAILER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "binary_io.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#undef WIN32_LEAN_AND_MEAN
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// reads data appended to a log file through a handle that is kept open
+// since the handle follows the file and not the path, data written just before the file is renamed can still be read afterwards
+class log_tailer
+{
+private:
+	// identifies a file independently of its path
+	struct file_id
+	{
+#ifdef _WIN32
+		DWORD volume;
+		std::uint64_t index;
+#else
+		dev_t dev;
+		ino_t ino;
+#endif
+		[[nodiscard]] bool operator==(const file_id&) const = default;
+	};
+
+	std::filesystem::path path;
+#ifdef _WIN32
+	HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+	int fd = -1;
+#endif
+	file_id id{};
+	std::uint64_t offset = 0;  // position of next read
+	// reused between reads. starts with the complete lines returned by the last read (consumed bytes),
+	// followed by an incomplete line that is kept for the next read
+	std::string buffer;
+	std::size_t consumed = 0;
+	std::uint64_t hash = detail::fnv1a_basis;  // see parsed_hash
+
+	// read `size` bytes at `pos` (like pread), or less if the file ends first
+	// @return amount read, or nullopt on error
+	[[nodiscard]] std::optional<std::size_t> read_at(char* out, std::size_t size, std::uint64_t pos) const
+	{
+		std::size_t total = 0;
+		while (total < size)
+		{
+#ifdef _WIN32
+			// a synchronous handle with an offset in OVERLAPPED is the equivalent of pread
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(pos + total);
+			overlapped.OffsetHigh = static_cast<DWORD>((pos + total) >> 32);
+			DWORD amount;
+			const DWORD to_read = static_cast<DWORD>(std::min<std::size_t>(size - total, 1 << 30));
+			if (!ReadFile(handle, out + total, to_read, &amount, &overlapped))
+			{
+				if (GetLastError() == ERROR_HANDLE_EOF)
+					{ break; }
+				return {};
+			}
+#else
+			const ssize_t amount = pread(fd, out + total, size - total, pos + total);
+			if (amount == -1)
+			{
+				if (errno == EINTR)
+					{ continue; }
+				return {};
+			}
+#endif
+			if (amount == 0)
+				{ break; }  // end of file
+			total += amount;
+		}
+		return total;
+	}
+
+	// drop what was returned by the last read, leaving only the incomplete line
+	void discard_consumed()
+	{
+		buffer.erase(0, consumed);
+		consumed = 0;
+	}
+
+#ifdef _WIN32
+	[[nodiscard]] static std::optional<file_id> get_id(HANDLE h)
+	{
+		BY_HANDLE_FILE_INFORMATION info;
+		if (!GetFileInformationByHandle(h, &info))
+			{ return {}; }
+		return file_id{ info.dwVolumeSerialNumber, (static_cast<std::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow };
+	}
+	[[nodiscard]] static HANDLE open_handle(const std::filesystem::path& p)
+	{
+		// allow the server to keep writing and to rename the file while it is open
+		return CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	}
+#endif
+
+public:
+	explicit log_tailer(std::filesystem::path path) : path(std::move(path)) {}
+	log_tailer(const log_tailer&) = delete;
+	log_tailer& operator=(const log_tailer&) = delete;
+	~log_tailer() { close(); }
+
+	// open the file currently at path from the start, closing the previous file
+	// @return true on success
+	bool open()
+	{
+		close();
+#ifdef _WIN32
+		HANDLE h = open_handle(path);
+		if (h == INVALID_HANDLE_VALUE)
+			{ return false; }
+		const auto new_id = get_id(h);
+		if (!new_id)
+		{
+			CloseHandle(h);
+			return false;
+		}
+		handle = h;
+		id = new_id.value();
+#else
+		const int new_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (new_fd == -1)
+			{ return false; }
+		struct stat st;
+		if (fstat(new_fd, &st) == -1)
+		{
+			::close(new_fd);
+			return false;
+		}
+		fd = new_fd;
+		id = { st.st_dev, st.st_ino };
+#endif
+		return true;
+	}
+
+	void close() noexcept
+	{
+#ifdef _WIN32
+		if (handle != INVALID_HANDLE_VALUE)
+			{ CloseHandle(handle); }
+		handle = INVALID_HANDLE_VALUE;
+#else
+		if (fd != -1)
+			{ ::close(fd); }
+		fd = -1;
+#endif
+		seek(0);
+	}
+
+	[[nodiscard]] bool is_open() const noexcept
+	{
+#ifdef _WIN32
+		return handle != INVALID_HANDLE_VALUE;
+#else
+		return fd != -1;
+#endif
+	}
+
+	// @return whether the file at path is not the open one (it was rotated, replaced, or removed), or nothing is open
+	[[nodiscard]] bool replaced() const
+	{
+		if (!is_open())
+			{ return true; }
+#ifdef _WIN32
+		HANDLE h = open_handle(path);
+		if (h == INVALID_HANDLE_VALUE)
+			{ return true; }
+		const auto cur_id = get_id(h);
+		CloseHandle(h);
+		return cur_id != id;
+#else
+		struct stat st;
+		if (stat(path.c_str(), &st) == -1)
+			{ return true; }
+		return file_id{ st.st_dev, st.st_ino } != id;
+#endif
+	}
+
+	// @return identity of the open file (device and inode, or volume and file index on windows), which is the same for the same file
+	//         after a restart, unlike handles
+	[[nodiscard]] std::pair<std::uint64_t, std::uint64_t> identity() const noexcept
+	{
+#ifdef _WIN32
+		return { id.volume, id.index };
+#else
+		return { static_cast<std::uint64_t>(id.dev), static_cast<std::uint64_t>(id.ino) };
+#endif
+	}
+
+	// @return current size of the open file, or nullopt on error or if nothing is open
+	[[nodiscard]] std::optional<std::uint64_t> size() const
+	{
+#ifdef _WIN32
+		LARGE_INTEGER file_size;
+		if (!is_open() || !GetFileSizeEx(handle, &file_size))
+			{ return {}; }
+		return static_cast<std::uint64_t>(file_size.QuadPart);
+#else
+		struct stat st;
+		if (!is_open() || fstat(fd, &st) == -1)
+			{ return {}; }
+		return static_cast<std::uint64_t>(st.st_size);
+#endif
+	}
+
+	// @return position the next read starts at
+	[[nodiscard]] std::uint64_t get_offset() const noexcept
+		{ return offset; }
+	// @return end of the data returned so far (end of the last complete line read), which parsing can be resumed from
+	[[nodiscard]] std::uint64_t parsed_offset() const noexcept
+		{ return offset - (buffer.size() - consumed); }
+	// @return detail::fnv1a hash of everything returned since the start of the file, [0, parsed_offset())
+	//         (only meaningful if reading started at 0, or seek was given the hash up to where it started)
+	[[nodiscard]] std::uint64_t parsed_hash() const noexcept
+		{ return hash; }
+
+	// e.g. to read from the start again after the file was truncated
+	// any incomplete line that was kept is discarded
+	// @param prefix_hash  hash of [0, new_offset), for parsed_hash
+	void seek(std::uint64_t new_offset, std::uint64_t prefix_hash = detail::fnv1a_basis) noexcept
+	{
+		offset = new_offset;
+		hash = prefix_hash;
+		buffer.clear();
+		consumed = 0;
+	}
+
+	// read from the current position up to `end` (usually size()), or less if the file ends earlier
+	// only complete lines are returned, since the rest may not have been written yet. an incomplete line at the end
+	// is kept and returned by the next read once it is complete (see flush to get it anyway)
+	// @return complete lines read (including the final newline), valid until the next read or flush; or nullopt on error
+	[[nodiscard]] std::optional<std::string_view> read(std::uint64_t end)
+	{
+		if (!is_open())
+			{ return {}; }
+		discard_consumed();
+		if (end <= offset)
+			{ return std::string_view(); }
+		const std::size_t start = buffer.size();
+		buffer.resize(start + (end - offset));
+		const auto amount = read_at(buffer.data() + start, end - offset, offset);
+		if (!amount)
+		{
+			// the incomplete line kept before is all that is left, not what was made room for
+			buffer.resize(start);
+			return {};
+		}
+		offset += amount.value();
+		buffer.resize(start + amount.value());
+		const auto last_newline = std::string_view(buffer).find_last_of('\n');
+		consumed = (last_newline == std::string_view::npos) ? 0 : last_newline + 1;
+		const std::string_view lines(buffer.data(), consumed);
+		hash = detail::fnv1a(lines, hash);
+		return lines;
+	}
+
+	// take the incomplete line kept by the last read, e.g. when nothing more will be written to the file
+	// @return incomplete line (no newline), valid until the next read or flush
+	[[nodiscard]] std::string_view flush()
+	{
+		discard_consumed();
+		consumed = buffer.size();
+		hash = detail::fnv1a(buffer, hash);
+		return buffer;
+	}
+
+	// hash [begin, end) of the open file without affecting reads
+	// @param prefix_hash  hash of [0, begin), to get the hash of [0, end)
+	// @return detail::fnv1a hash, or nullopt on error or if the file ends before `end`
+	[[nodiscard]] std::optional<std::uint64_t> hash_range(std::uint64_t begin, std::uint64_t end, std::uint64_t prefix_hash = detail::fnv1a_basis) const
+	{
+		constexpr std::size_t chunk_size = 1 << 20;
+		std::string chunk(chunk_size, '\0');
+		while (begin < end)
+		{
+			const std::size_t cur_size = static_cast<std::size_t>(std::min<std::uint64_t>(end - begin, chunk_size));
+			const auto amount = read_at(chunk.data(), cur_size, begin);
+			if (!amount || amount.value() != cur_size)
+				{ return {}; }
+			prefix_hash = detail::fnv1a(std::string_view(chunk.data(), cur_size), prefix_hash);
+			begin += cur_size;
+		}
+		return prefix_hash;
+	}
+};
+
+#endif
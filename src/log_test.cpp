@@ -1,95 +1,70 @@
 #include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <format>
-#include <fstream>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 
-#include "file_watcher.h"
+#include "log_replay.h"
+
+// replays a recorded log into a test latest.log with its original timing, rotating it like the server does (see log_replay.h),
+// while following it like the bot does (file watcher, log_tailer and parse_lines), to measure how long written lines take to be parsed
+// usage: log_test <recorded log> [--dir dir] [--speed x] [--max-gap seconds]
+// --speed x replays x times faster, --max-gap shortens longer pauses to that many seconds (after the speedup)
 
 #if defined(__linux__) || defined(_WIN32)
 
-int main()
+int main(int argc, char** argv)
 {
-	const std::string file = "latest.log";
-#ifdef _WIN32
-	bool notify_on_last_write = false;
-#define FILE_WATCHER_USER_DATA &notify_on_last_write
-#else
-#define FILE_WATCHER_USER_DATA nullptr
-#endif
-	auto ctx = file_watcher_init(".", file.c_str(), file.size(), FILE_WATCHER_USER_DATA);
-#undef FILE_WATCHER_USER_DATA
-	if (!ctx.has_value)
-		{ return -1; }
-	
-	std::uintmax_t prev_size = 0;
+	replay_options options;
+	bool valid = (argc >= 2 && argc % 2 == 0);
+	if (valid)
+		{ options.recorded = argv[1]; }
+	for (int i = 2; valid && i + 1 < argc; i += 2)
+		{ valid = parse_replay_option(options, argv[i], argv[i + 1]); }
+	if (!valid)
+	{
+		std::cerr << "usage: log_test <recorded log> [--dir dir (default replay)] [--speed x] [--max-gap seconds]\n";
+		return 1;
+	}
+	// parsing warnings would get in the way of the results
+	get_logger().set_min_severity(log_severity::fatal);
 
-	while (true)
+	std::optional<std::string> contents;
+	const std::vector<replay_burst> bursts = prepare_replay(options, contents);
+	if (bursts.empty())
+		{ return 1; }
+
+	replay_progress progress;
+	latency_stats parse_latency, presence_latency;
+	std::size_t num_events = 0, num_rotations = 0;
+	bool follow_ok = true;
+	std::thread follower([&]() { follow_ok = follow_replay(options.dir, progress, parse_latency, presence_latency, num_events); });
+	// give the watcher time to start, so the first writes aren't missed
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	try
+	{
+		replay_bursts(options, bursts, progress, num_rotations);
+	}
+	catch (const std::filesystem::filesystem_error& e)
+	{
+		std::cerr << std::format("Replay failed: {}\n", e.what());
+		return 1;
+	}
+	progress.done = true;
+	follower.join();
+	if (!follow_ok)
 	{
-		auto res = file_watcher_poll(&ctx);
-		if (res.state == -1)
-			{ return -1; }
-		if (res.state == 1)
-		{
-			std::cout << std::format("{:%D %T} - {}{}{}", std::chrono::system_clock::now(), res.event_create ? "CREATE" : "", res.event_modify ? "MODIFY" : "", (res.moved_to != nullptr) ? "MOVE" : "") << std::endl;
-			if (res.event_create || res.moved_to != nullptr)
-				{ prev_size = 0; }
-			if (res.event_create_moved)
-			{
-				const auto size = std::filesystem::exists(file) ? std::filesystem::file_size(file) : 0;
-				if (size > 0)
-				{
-					std::ifstream fin(file, std::ios::binary);
-					std::string s;
-					s.resize_and_overwrite(size, [&fin](char* buf, std::size_t buf_size)
-					{
-						fin.read(buf, buf_size);
-						return buf_size;
-					});
-					fin.close();
-					std::cout << std::format("--BEGIN MOVED FILE CONTENTS--\n{}\n--END MOVED FILE CONTENTS--", s) << std::endl;
-				}
-				prev_size = size;
-			}
-			if (res.event_modify)
-			{				
-				const auto size = std::filesystem::exists(file) ? std::filesystem::file_size(file) : 0;
-				if (size < prev_size)
-				{
-					std::cerr << "WARNING: File shrunk somehow, reading from start" << std::endl;
-					prev_size = 0;
-				}
-				if (size > 0 && size > prev_size)
-				{
-					std::ifstream fin(file, std::ios::binary);
-					fin.seekg(prev_size, std::ios::beg);
-					std::string s;
-					s.resize_and_overwrite(size - prev_size, [&fin](char* buf, std::size_t buf_size)
-					{
-						fin.read(buf, buf_size);
-						return buf_size;
-					});
-					fin.close();
-					std::cout << s << std::endl;
-				}
-				else
-					{ std::cout << "(empty)" << std::endl; }
-				prev_size = size;
-			}
-			if (res.moved_to != nullptr)
-			{
-				std::cout << std::string_view(res.moved_to, res.moved_to_size) << std::endl;
-				std::free(res.moved_to);
-			}
-		}
-		else if (res.state == 0)
-			{ std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+		std::cerr << "Watching the directory failed\n";
+		return 1;
 	}
 
-	if (!file_watcher_cleanup(&ctx))
-		{ return -1; }
+	std::cout << std::format("{} watcher events, {} rotations\n", num_events, num_rotations);
+	parse_latency.print("write to parsed");
+	presence_latency.print("join/leave to player count");
 }
 
 #else
@@ -0,0 +1,264 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+enum class log_severity : std::uint8_t
+{
+	debug,
+	info,
+	warning,
+	error,
+	fatal,
+	count_
+};
+
+// kinds of messages that can be repeated many times (e.g. on every crash in old logs), each is rate limited separately
+enum class log_type : std::uint8_t
+{
+	general,  // not rate limited
+	dpp,
+	unexpected_file_name,
+	never_left,
+	uuid_not_found,
+	joined_multiple_times,
+	join_time_not_found,
+	uuid_parse_failed,
+	player_list_mismatch,
+	count_
+};
+
+namespace detail
+{
+	[[nodiscard]] constexpr std::string_view log_severity_prefix(log_severity severity)
+	{
+		using namespace std::string_view_literals;
+		constexpr std::array prefixes = { "DEBUG: "sv, "INFO: "sv, "WARNING: "sv, "ERROR: "sv, "FATAL ERROR: "sv };
+		return prefixes[static_cast<std::size_t>(severity)];
+	}
+}
+
+// messages are put in a lock-free queue and written by a background thread, so logging never waits for terminal output
+// debug, info and warning go to stdout, error and fatal go to stderr
+class logger
+{
+public:
+	// messages of each rate limited type past this many in a period are counted but not written
+	static constexpr std::uint32_t max_per_period = 100;
+	static constexpr std::chrono::steady_clock::duration rate_limit_period = std::chrono::seconds(10);
+
+	struct counters_t
+	{
+		std::array<std::uint64_t, static_cast<std::size_t>(log_severity::count_)> logged;  // by severity, including suppressed
+		std::array<std::uint64_t, static_cast<std::size_t>(log_type::count_)> suppressed;  // by type
+	};
+
+private:
+	// intrusive MPSC queue (Vyukov): producers exchange head, the writer follows next pointers from tail
+	// the node at tail has already been written (or is the initial stub)
+	struct node
+	{
+		std::atomic<node*> next = nullptr;
+		log_severity severity = log_severity::info;
+		std::string message;
+	};
+
+	struct rate_limit_t
+	{
+		std::atomic<std::chrono::steady_clock::rep> period_start{ 0 };
+		std::atomic<std::uint32_t> count{ 0 };
+		std::atomic<std::uint32_t> suppressed{ 0 };  // this period, for the summary
+	};
+
+	std::atomic<node*> head;
+	node* tail;  // only used by the writer
+	std::atomic<bool> signal{ false };  // true if messages may have been pushed since the writer last checked
+	std::atomic<bool> stopping{ false };
+	std::atomic<std::uint64_t> pushed{ 0 };
+	std::atomic<std::uint64_t> written{ 0 };
+	std::atomic<log_severity> min_severity{ log_severity::info };
+
+	std::array<rate_limit_t, static_cast<std::size_t>(log_type::count_)> rate_limits;
+	std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(log_severity::count_)> logged_counts{};
+	std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(log_type::count_)> suppressed_counts{};
+
+	std::thread writer;
+
+	// @return number of messages pushed so far, including this one
+	std::uint64_t push(log_severity severity, std::string message)
+	{
+		node* n = new node;
+		n->severity = severity;
+		n->message = std::move(message);
+		node* prev = head.exchange(n, std::memory_order_acq_rel);
+		prev->next.store(n, std::memory_order_release);
+		const std::uint64_t count = pushed.fetch_add(1, std::memory_order_relaxed) + 1;
+		// only wake the writer once per batch
+		if (!signal.exchange(true, std::memory_order_acq_rel))
+			{ signal.notify_one(); }
+		return count;
+	}
+
+	// if there are suppressed messages of `type`, push a summary of them
+	void push_suppressed_summary(log_type type)
+	{
+		const std::uint32_t num_suppressed = rate_limits[static_cast<std::size_t>(type)].suppressed.exchange(0, std::memory_order_relaxed);
+		if (num_suppressed != 0)
+			{ push(log_severity::warning, std::to_string(num_suppressed) + " similar messages were suppressed"); }
+	}
+
+	// @return whether the message is allowed through (approximately max_per_period per period, races only affect the exact count)
+	[[nodiscard]] bool check_rate_limit(log_type type)
+	{
+		if (type == log_type::general)
+			{ return true; }
+		auto& limit = rate_limits[static_cast<std::size_t>(type)];
+		const auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+		auto start = limit.period_start.load(std::memory_order_relaxed);
+		if (now - start >= rate_limit_period.count() && limit.period_start.compare_exchange_strong(start, now, std::memory_order_relaxed))
+		{
+			limit.count.store(0, std::memory_order_relaxed);
+			push_suppressed_summary(type);
+		}
+		if (limit.count.fetch_add(1, std::memory_order_relaxed) < max_per_period)
+			{ return true; }
+		limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+		suppressed_counts[static_cast<std::size_t>(type)].fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// write everything in the queue
+	void drain()
+	{
+		std::uint64_t count = 0;
+		bool wrote_out = false, wrote_err = false;
+		while (true)
+		{
+			node* next = tail->next.load(std::memory_order_acquire);
+			if (next == nullptr)
+				{ break; }  // empty, or a push hasn't linked its node yet (it will signal after)
+			delete tail;
+			tail = next;
+			auto& stream = (next->severity >= log_severity::error) ? std::cerr : std::cout;
+			(next->severity >= log_severity::error ? wrote_err : wrote_out) = true;
+			stream << detail::log_severity_prefix(next->severity) << next->message << '\n';
+			next->message = std::string();  // tail stays allocated until the next message
+			count++;
+		}
+		if (wrote_out)
+			{ std::cout.flush(); }
+		if (wrote_err)
+			{ std::cerr.flush(); }
+		if (count != 0)
+		{
+			written.fetch_add(count, std::memory_order_release);
+			written.notify_all();
+		}
+	}
+
+	void writer_loop()
+	{
+		while (true)
+		{
+			signal.wait(false, std::memory_order_acquire);
+			const bool stop = stopping.load(std::memory_order_acquire);
+			signal.exchange(false, std::memory_order_acq_rel);
+			drain();
+			if (stop)
+				{ return; }
+		}
+	}
+
+public:
+	logger() : head(new node), tail(head.load())
+	{
+		writer = std::thread([this]() { writer_loop(); });
+	}
+	logger(const logger&) = delete;
+	logger& operator=(const logger&) = delete;
+	~logger()
+	{
+		flush();
+		stopping.store(true, std::memory_order_release);
+		signal.store(true, std::memory_order_release);
+		signal.notify_one();
+		writer.join();
+		delete tail;
+	}
+
+	// @return warnings and worse the calling thread has logged (including suppressed ones), e.g. to count those of work done on it
+	[[nodiscard]] static std::uint64_t& thread_warnings() noexcept
+	{
+		thread_local std::uint64_t count = 0;
+		return count;
+	}
+
+	// messages below this severity are ignored
+	void set_min_severity(log_severity severity) noexcept
+		{ min_severity.store(severity, std::memory_order_relaxed); }
+
+	// @param type  for rate limiting, if the message could be repeated many times
+	void log(log_severity severity, std::string message, log_type type = log_type::general)
+	{
+		if (severity < min_severity.load(std::memory_order_relaxed))
+			{ return; }
+		logged_counts[static_cast<std::size_t>(severity)].fetch_add(1, std::memory_order_relaxed);
+		if (severity >= log_severity::warning)
+			{ thread_warnings()++; }
+		// fatal errors are always written, since they are usually the last thing logged
+		if (severity != log_severity::fatal && !check_rate_limit(type))
+			{ return; }
+		push(severity, std::move(message));
+		if (severity == log_severity::fatal)
+			{ flush(); }
+	}
+
+	// wait until everything logged so far (including summaries of suppressed messages) is written
+	void flush()
+	{
+		for (std::size_t i = 0; i < rate_limits.size(); i++)
+			{ push_suppressed_summary(static_cast<log_type>(i)); }
+		const std::uint64_t target = pushed.load(std::memory_order_relaxed);
+		std::uint64_t cur;
+		while ((cur = written.load(std::memory_order_acquire)) < target)
+			{ written.wait(cur, std::memory_order_acquire); }
+	}
+
+	[[nodiscard]] counters_t counters() const noexcept
+	{
+		counters_t res;
+		for (std::size_t i = 0; i < res.logged.size(); i++)
+			{ res.logged[i] = logged_counts[i].load(std::memory_order_relaxed); }
+		for (std::size_t i = 0; i < res.suppressed.size(); i++)
+			{ res.suppressed[i] = suppressed_counts[i].load(std::memory_order_relaxed); }
+		return res;
+	}
+};
+
+// logger used by everything
+// it is never destroyed, since other threads (e.g. dpp's) may log during exit. it is flushed at exit instead
+[[nodiscard]] inline logger& get_logger()
+{
+	static logger& instance = []() -> logger&
+	{
+		logger* l = new logger;
+		std::atexit([]() { get_logger().flush(); });
+		return *l;
+	}();
+	return instance;
+}
+
+inline void log_message(log_severity severity, std::string message, log_type type = log_type::general)
+	{ get_logger().log(severity, std::move(message), type); }
+
+#endif
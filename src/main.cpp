@@ -1,18 +1,70 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <chrono>
 #include <cstdint>
 #include <fstream>
+#include <future>
+#include <latch>
+#include <limits>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <stdexcept>
 #include <string_view>
+#include <thread>
+#include <tuple>
 #include <vector>
 #include <dpp/dpp.h>
+#include <dpp/json.h>
 #include <jsoncons/json.hpp>
 #include "parse_logs.h"
+#include "archive_ranges.h"
+#include "commands.h"
+#include "coplay.h"
+#include "disk_graph_cache.h"
+#include "event_journal.h"
+#include "file_writer.h"
 #include "file_watcher.h"
+#include "graph_cache.h"
+#include "handoff.h"
+#include "heatmap_graph.h"
+#include "http_server.h"
+#include "kway_merge.h"
+#include "digest_poster.h"
+#include "join_notifier.h"
+#include "lag_series.h"
+#include "leaderboard.h"
+#include "live_feed.h"
+#include "log_listener.h"
+#include "log_tailer.h"
+#include "logger.h"
+#include "memory_census.h"
+#include "metrics.h"
+#include "metrics_server.h"
+#include "milestone_notifier.h"
+#include "name_completion.h"
+#include "online_graph.h"
+#include "online_index.h"
+#include "player_graph.h"
 #include "playtime_graph.h"
+#include "presence_index.h"
+#include "presence_scheduler.h"
+#include "published_data.h"
+#include "rate_limiter.h"
+#include "rcon_client.h"
+#include "recent_events.h"
+#include "render_executor.h"
+#include "replication.h"
+#include "sampling_profiler.h"
+#include "segment_spill.h"
+#include "session_export.h"
+#include "snapshot.h"
+#include "status_message.h"
+#include "tracing.h"
 
 #undef poll  // from dpp socket.h for windows
 
@@ -27,6 +79,13 @@ private:
 		void operator()(char* ptr) const noexcept { std::free(ptr); }
 	};
 
+	[[nodiscard]] static std::optional<std::uint64_t> get_file_size(const file_watcher_result& res)
+	{
+		if (res.file_size < 0)
+			{ return std::nullopt; }
+		return static_cast<std::uint64_t>(res.file_size);
+	}
+
 public:
 	// IMPORTANT: dir and file must be null-terminated! (not all string_views are)
 	// @throws std::runtime_error if construction failed
@@ -38,16 +97,25 @@ public:
 	~file_watcher()
 	{
 		if (!file_watcher_cleanup(&ctx))
-			{ std::cerr << "Error cleaning up file_watcher" << std::endl; }
+			{ log_message(log_severity::error, "Error cleaning up file_watcher"); }
 	}
 	
 	// TODO: copy and move
+
+	// also watch `file` in `dir`, with events having `tag` (the file from the constructor has tag 0)
+	// IMPORTANT: dir and file must be null-terminated!
+	// @return false on error
+	[[nodiscard]] bool add(const char* dir, std::string_view file, std::uintptr_t tag)
+		{ return file_watcher_add(&ctx, dir, file.data(), file.size(), tag); }
 	
 	struct result_t
 	{
 		enum class state_t { no_data, data_read, read_more } state;
 		bool event_create, event_create_moved, event_modify;
+		bool event_lost;  // see file_watcher_result::event_lost
 		std::optional<std::pair<std::unique_ptr<char[], free_deleter>, std::size_t>> moved_to;
+		std::uintptr_t tag;  // of the file (see add)
+		std::optional<std::uint64_t> file_size;  // when the event happened, if known (see file_watcher_result::file_size)
 	};
 
 	// @return nullopt on error, or struct containing bools event_create, event_create_moved, event_modify; optional<pair<unique_ptr<char[]>, size_t>> moved_to
@@ -72,22 +140,178 @@ public:
 			s = result_t::state_t::read_more;
 			break;
 		default:
-			std::cerr << "Unexpected file_watcher_poll state: " << res.state << std::endl;
+			log_message(log_severity::error, std::format("Unexpected file_watcher_poll state: {}", static_cast<int>(res.state)));
+			return std::nullopt;
+		}
+		return std::make_optional<result_t>(s, res.event_create, res.event_create_moved, res.event_modify, res.event_lost, std::move(moved_to), res.tag,
+			get_file_size(res));
+	}
+
+	// read all available events, consecutive modify events are coalesced (see file_watcher_poll_batch)
+	// @param results  replaced with events read (state is always data_read). if there are max_results, more may be available
+	// @return false on error
+	[[nodiscard]] bool poll_batch(std::vector<result_t>& results, std::size_t max_results = 64)
+	{
+		results.clear();
+		std::vector<file_watcher_result> raw_results(max_results);
+		const auto num_results = file_watcher_poll_batch(&ctx, raw_results.data(), raw_results.size());
+		if (num_results == -1)
+			{ return false; }
+		for (const auto& res : std::span(raw_results).first(num_results))
+		{
+			decltype(result_t::moved_to) moved_to;
+			if (res.moved_to != nullptr)
+				{ moved_to = { std::unique_ptr<char[], free_deleter>(res.moved_to), res.moved_to_size }; }
+			results.emplace_back(result_t::state_t::data_read, res.event_create, res.event_create_moved, res.event_modify, res.event_lost, std::move(moved_to),
+				res.tag, get_file_size(res));
+		}
+		return true;
+	}
+
+	enum class wait_result_t { timeout, ready, woken };
+
+	// block until poll may have something to read
+	// @param timeout  max time to wait, or nullopt to wait indefinitely
+	// @return nullopt on error
+	[[nodiscard]] std::optional<wait_result_t> wait(std::optional<std::chrono::milliseconds> timeout = std::nullopt)
+	{
+		// clamp so it fits in an int and isn't -1 (wait indefinitely)
+		const int timeout_ms = timeout ? static_cast<int>(std::clamp<std::chrono::milliseconds::rep>(timeout->count(), 0, std::numeric_limits<int>::max())) : -1;
+		switch (file_watcher_wait(&ctx, timeout_ms))
+		{
+		case 0:
+			return wait_result_t::timeout;
+		case 1:
+			return wait_result_t::ready;
+		case 2:
+			return wait_result_t::woken;
+		default:
 			return std::nullopt;
 		}
-		return std::make_optional<result_t>(s, res.event_create, res.event_create_moved, res.event_modify, std::move(moved_to));
 	}
+
+	// make wait return (from any thread)
+	// @return true on success
+	bool wakeup()
+		{ return file_watcher_wakeup(&ctx); }
+
+	// for waiting in another event loop instead of wait (see file_watcher_native_handle)
+	[[nodiscard]] file_watcher_native_handle_t native_handle() const
+		{ return file_watcher_native_handle(&ctx); }
 };
 
 using file_watcher_state_t = file_watcher::result_t::state_t;
 
-struct config_t
+// state after parsing a prefix of latest.log, so it doesn't need to be read from the start if the file is truncated or replaced
+struct latest_log_checkpoint_t
 {
-	std::string log_path;
+	std::uint64_t offset;  // end of the prefix, always at the end of a line
+	std::uint64_t prefix_hash;  // detail::fnv1a hash of the prefix, to check it is unchanged
+	log_data_t data;
+	parse_ctx_t ctx;
+	std::size_t lag_size;  // samples in the latest.log lag series
+	uptime_series uptime;  // of latest.log, which is small (its periods change as they end, so it is copied rather than truncated)
+};
+
+// a minecraft server whose logs are read, each one is read on its own thread into its own data (see server_shard)
+struct server_config_t
+{
+	std::string name;  // for the server option of commands, empty if it is the only server
+	std::string log_path;  // may be empty if lines are received over the network, otherwise read on startup anyway
 	const std::chrono::time_zone* logs_timezone;
-	std::uint64_t guild_id;
-	std::string status_0, status_1, status_multi;
+	log_format logs_format;  // layout of the log lines
 	bool windows_notify_on_last_write;
+	std::string snapshot_path;  // empty to disable snapshots
+	std::string journal_path;  // of the event journal, empty to disable it
+	// to receive lines pushed over the network (see log_listener) instead of watching latest.log in log_path, if ingest_port isn't 0
+	std::string ingest_address;
+	std::uint16_t ingest_port;
+	// the server's rcon port, to ask it who is online on startup (see rcon_client), if rcon_port isn't 0
+	std::string rcon_address;
+	std::uint16_t rcon_port;
+	std::string rcon_password;
+	// the server's usercache.json, whose names and uuids are used for players whose uuid line isn't in the logs read (see known_uuids_t),
+	// empty for none. next to the logs directory by default
+	std::string usercache_path;
+	std::string segment_path;  // directory that history segments are spilled to with history_memory_bytes (see segment_spill)
+};
+
+// shown in the server option of commands for all servers combined (see merge_published_data)
+constexpr std::string_view merged_view_name = "all";
+// discord allows 25 choices for an option, one of which is merged_view_name
+constexpr std::size_t max_servers = 24;
+
+struct config_t
+{
+	std::vector<server_config_t> servers;  // at least one
+	std::uint64_t guild_id;
+	std::string status_0, status_1, status_multi;  // with the number of players online on all servers
+	std::uint64_t presence_update_window;  // seconds to coalesce player count changes for
+	bool svg_row_paths;  // see graph_options
+	int png_compression_level;  // see graph_options
+	const std::chrono::time_zone* graph_timezone;  // for date labels
+	std::uint64_t graph_row_limit;  // for graphs without a limit given, 0 for no limit (see graph_options)
+	// largest png graph to render (see graph_options::png_max_bytes), discord's attachment limit by default
+	std::uint64_t attachment_max_bytes;
+	// a png /graph with more players than this is first shown as a quick preview of this many rows, 0 to always wait for the full graph
+	std::uint64_t graph_preview_rows;
+	// seconds for a user to get back one render's worth of heavy commands (see take_command_tokens in main), 0 to not limit them
+	std::uint64_t graph_cooldown;
+	// directory to save rendered graphs in, so they are still cached after a restart (see disk_graph_cache), empty to only cache them in memory
+	std::string graph_cache_path;
+	std::uint64_t graph_cache_bytes;  // total size of the graphs saved in graph_cache_path
+	std::string font_path;  // for all text in graphs, empty for the font lunasvg falls back to (see text_metrics::load_font)
+	// sessions that ended more than this many days ago (in graph_timezone) are rolled up into playtime per day, 0 to keep them all
+	// (see session_history::roll_up). the snapshot still has all of them
+	std::uint64_t retention_days;
+	// only archives from this many days ago (in each server's logs_timezone, including today) are read on startup, 0 to read them all.
+	// uuids logged before that come from usercache_path. sessions of players online when the first archive read starts are missed
+	std::uint64_t history_days;
+	// most memory each server's history segments may use, older segments are written to files in its segment_path and mapped
+	// when they would use more (see segment_spill), 0 to keep them all in memory
+	std::uint64_t history_memory_bytes;
+	// keep history segments other than the newest compressed (see session_history::compress), for a few times less memory at the cost of
+	// decoding sessions whenever they are read
+	bool compress_history;
+	// a player who joins again less than this many seconds after leaving continues their session, 0 to never merge (see session_aggregator)
+	std::uint64_t session_merge_gap;
+	std::string metrics_address;  // to serve /metrics on (see metrics_server)
+	std::uint16_t metrics_port;  // 0 to not serve metrics
+	std::string http_address;  // to serve graphs and stats on (see http_server)
+	std::uint16_t http_port;  // 0 to not serve them
+	std::uint64_t notify_channel_id;  // to post players joining and leaving in (see join_notifier), 0 to not post them
+	std::uint64_t notify_window;  // seconds to collect joins and leaves for before posting them
+	std::uint64_t status_channel_id;  // to keep a pinned message with the players online in (see status_message), 0 to not
+	std::uint64_t status_window;  // seconds to collect changes for before editing the message
+	// to post a digest of the day before in each day, and of the week before once a week (see digest_schedule), 0 to not post them
+	// digests are of all servers
+	std::uint64_t digest_channel_id;
+	std::chrono::minutes digest_time;  // local time of day (in graph_timezone) digests are posted at
+	std::optional<std::chrono::weekday> digest_weekday;  // day the weekly digest is posted on, nullopt to only post daily ones
+	// to post players reaching milestones of all time playtime on all servers in (see milestone_notifier), 0 to not post them
+	std::uint64_t milestone_channel_id;
+	std::vector<std::chrono::hours> milestone_hours;  // playtime of the milestones
+	// connect with no intents and no dpp caches, since the bot only handles interactions and never looks up guilds, channels or members
+	bool lean_gateway;
+	std::uint32_t request_threads;  // for dpp's REST requests, 12 by default (dpp's default) or 2 with lean_gateway
+	// loopback port to hand the bot over to a new process on (see handoff_listener), 0 to not. a process started with the same port takes over
+	// from the one running, which keeps serving until the new one has loaded history
+	std::uint16_t handoff_port;
+	// limits on the bot's bulk work, so it doesn't take cores from the minecraft server it runs next to (see resource_limits_t)
+	std::uint32_t parse_threads;  // 0 for one per core
+	std::vector<unsigned> parse_cpus;  // empty for any
+	bool parse_background;
+	std::uint32_t render_threads;  // graphs rendered at once
+	std::vector<unsigned> render_cpus;  // empty for any
+	// most memory renders take at once (rasterizing pngs, see graph_options::png_max_surface_bytes), 0 for no limit. a png that wouldn't fit
+	// in its thread's share is rendered at a smaller scale, or as an svg
+	std::uint64_t render_memory_bytes;
+	std::string replication_address;  // to send the data of every server to replicas on (see replication_publisher)
+	std::uint16_t replication_port;  // 0 to not
+	// primary to serve the data of instead of reading logs (see replication_client), if replicate_from_port isn't 0. a replica serves http and metrics,
+	// but doesn't connect to discord (the primary answers commands) or read anything itself
+	std::string replicate_from_address;
+	std::uint16_t replicate_from_port;
 };
 
 template<std::size_t size>
@@ -131,84 +355,470 @@ T get_optional_config_key(const jsoncons::json& config, std::string_view key, T
 	}
 	else
 	{
-		std::cout << "WARNING: " << key << " not found in config (using default)" << std::endl;
+		log_message(log_severity::warning, std::format("{} not found in config (using default)", key));
 		return default_val;
 	}
 }
 
-// will call std::exit(-1) if parsing fails
-// @param bot  optional of bot to initialize (needs to be optional ref param because it has no default constructor and is immovable)
-[[nodiscard]] static inline config_t parse_config(std::optional<dpp::cluster>& bot)
+// read the keys of one server, at the top level of the config if there is only one, or from an element of its servers array
+// @param name  of the server, empty if there is only one. other servers' snapshots, journals and segment directories have it in their default file names
+// @throws runtime_error on error
+[[nodiscard]] static inline server_config_t parse_server_config(const jsoncons::json& config, std::string name)
 {
-	std::string log_path, status_0, status_1, status_multi;
+	const std::string suffix = name.empty() ? std::string() : "-" + name;
+	const std::uint64_t ingest_port = get_optional_config_key<std::uint64_t, "uint64">(config, "ingest_port", 0);
+	if (ingest_port > std::numeric_limits<std::uint16_t>::max())
+		{ throw std::runtime_error(std::format("ingest_port must be at most {}, got {}", std::numeric_limits<std::uint16_t>::max(), ingest_port)); }
+	std::string ingest_address = get_optional_config_key<std::string, "string">(config, "ingest_address", "127.0.0.1");
+	// archived logs of a server sending its lines are optional, they may not be on this machine
+	const std::string log_path = (ingest_port == 0) ? get_config_key<std::string, "string">(config, "log_path") :
+		get_optional_config_key<std::string, "string">(config, "log_path");
+	const std::string timezone = get_config_key<std::string, "string">(config, "logs_timezone");
+	const std::string format_name = get_optional_config_key<std::string, "string">(config, "log_format", std::string(log_format_names[0]));
+	const auto logs_format = parse_log_format(format_name);
+	if (!logs_format)
+		{ throw std::runtime_error(std::format("log_format must be vanilla, paper or forge, got {}", format_name)); }
+	const bool windows_notify_on_last_write = get_optional_config_key<bool, "bool">(config, "windows_notify_on_last_write", false);
+	std::string snapshot_path = get_optional_config_key<std::string, "string">(config, "snapshot_path", std::format("qc-v2-snapshot{}.bin", suffix));
+	std::string journal_path = get_optional_config_key<std::string, "string">(config, "journal_path", std::format("qc-v2-journal{}.bin", suffix));
+	const std::uint64_t rcon_port = get_optional_config_key<std::uint64_t, "uint64">(config, "rcon_port", 0);
+	if (rcon_port > std::numeric_limits<std::uint16_t>::max())
+		{ throw std::runtime_error(std::format("rcon_port must be at most {}, got {}", std::numeric_limits<std::uint16_t>::max(), rcon_port)); }
+	std::string rcon_address = get_optional_config_key<std::string, "string">(config, "rcon_address", "127.0.0.1");
+	std::string rcon_password = (rcon_port == 0) ? std::string() : get_config_key<std::string, "string">(config, "rcon_password");
+	std::string usercache_path = get_optional_config_key<std::string, "string">(config, "usercache_path",
+		log_path.empty() ? std::string() : (std::filesystem::path(log_path).parent_path() / "usercache.json").string());
+	std::string segment_path = get_optional_config_key<std::string, "string">(config, "segment_path", std::format("qc-v2-segments{}", suffix));
+
 	const std::chrono::time_zone* logs_timezone;
-	std::uint64_t guild_id;
-	bool windows_notify_on_last_write;
 	try
 	{
-		std::ifstream fin("qc-v2-config.txt");
-		const jsoncons::json config = jsoncons::json::parse(fin);
-		fin.close();
+		logs_timezone = std::chrono::locate_zone(timezone);
+	}
+	catch (const std::runtime_error& e)
+	{
+		throw std::runtime_error(std::format("Could not locate timezone \"{}\" (is it an IANA time zone ID?): {}", timezone, e.what()));
+	}
+	return { std::move(name), log_path, logs_timezone, logs_format.value(), windows_notify_on_last_write, std::move(snapshot_path), std::move(journal_path),
+		std::move(ingest_address), static_cast<std::uint16_t>(ingest_port), std::move(rcon_address), static_cast<std::uint16_t>(rcon_port), std::move(rcon_password),
+		std::move(usercache_path), std::move(segment_path) };
+}
+
+inline constexpr std::string_view config_filename = "qc-v2-config.txt";
 
-		log_path = get_config_key<std::string, "string">(config, "log_path");
-		guild_id = get_config_key<std::uint64_t, "uint64">(config, "guild_id");
-		status_0 = get_optional_config_key<std::string, "string">(config, "status_empty");
-		status_1 = get_optional_config_key<std::string, "string">(config, "status_one");
-		status_multi = get_optional_config_key<std::string, "string">(config, "status_multi");
-		std::string timezone = get_config_key<std::string, "string">(config, "logs_timezone");
-		std::string token = get_config_key<std::string, "string">(config, "bot_token");
-		windows_notify_on_last_write = get_optional_config_key<bool, "bool">(config, "windows_notify_on_last_write", false);
+// @param token  receives bot_token
+// @throws std::exception (std::runtime_error or from jsoncons) if parsing fails
+[[nodiscard]] static inline config_t read_config(std::string& token)
+{
+	std::vector<server_config_t> servers;
+	std::string status_0, status_1, status_multi, metrics_address, http_address;
+	std::uint64_t guild_id;
+	std::uint64_t presence_update_window;
+	bool svg_row_paths;
+	std::uint64_t png_compression_level;
+	const std::chrono::time_zone* graph_timezone;
+	std::uint64_t graph_row_limit;
+	std::uint64_t attachment_max_bytes;
+	std::uint64_t graph_preview_rows;
+	std::uint64_t graph_cooldown;
+	std::string graph_cache_path;
+	std::uint64_t graph_cache_bytes;
+	std::string font_path;
+	std::uint64_t retention_days;
+	std::uint64_t history_days;
+	std::uint64_t history_memory_bytes;
+	bool compress_history;
+	std::uint64_t session_merge_gap;
+	std::uint64_t metrics_port;
+	std::uint64_t http_port;
+	std::uint64_t notify_channel_id;
+	std::uint64_t notify_window;
+	std::uint64_t status_channel_id;
+	std::uint64_t status_window;
+	std::uint64_t digest_channel_id;
+	std::chrono::minutes digest_time;
+	std::optional<std::chrono::weekday> digest_weekday;
+	std::uint64_t milestone_channel_id;
+	std::vector<std::chrono::hours> milestone_hours;
+	bool lean_gateway;
+	std::uint64_t request_threads;
+	std::uint64_t handoff_port;
+	std::uint64_t parse_threads;
+	std::vector<unsigned> parse_cpus;
+	bool parse_background;
+	std::uint64_t render_threads;
+	std::vector<unsigned> render_cpus;
+	std::uint64_t render_memory_bytes;
+	std::string replication_address;
+	std::uint64_t replication_port;
+	std::string replicate_from_address;
+	std::uint64_t replicate_from_port;
+	std::ifstream fin{ std::string(config_filename) };
+	const jsoncons::json config = jsoncons::json::parse(fin);
+	fin.close();
 
-		if (!status_multi.empty())  // validate format string
+	// either a list of named servers, or the keys of the only server at the top level
+	if (config.contains("servers"))
+	{
+		const auto& servers_json = config.at("servers");
+		if (!servers_json.is_array() || servers_json.empty())
+			{ throw std::runtime_error("Expected servers to be a non-empty array"); }
+		if (servers_json.size() > max_servers)
+			{ throw std::runtime_error(std::format("There can be at most {} servers, got {}", max_servers, servers_json.size())); }
+		for (const auto& server : servers_json.array_range())
 		{
+			if (!server.is_object())
+				{ throw std::runtime_error("Expected each element of servers to be an object"); }
+			const std::string name = get_config_key<std::string, "string">(server, "name");
+			if (name.empty() || name.size() > 100 || name == merged_view_name)
+				{ throw std::runtime_error(std::format("Server names must be 1 to 100 characters and not {}, got \"{}\"", merged_view_name, name)); }
+			if (std::ranges::find(servers, name, &server_config_t::name) != servers.end())
+				{ throw std::runtime_error(std::format("Server name {} is used more than once", name)); }
 			try
 			{
-				std::size_t temp = 0;
-				std::ignore = std::vformat(status_multi, std::make_format_args(temp));
+				servers.push_back(parse_server_config(server, name));
 			}
-			catch (const std::format_error& e)
+			catch (const std::runtime_error& e)
 			{
-				throw std::runtime_error(
-					std::format("Formatting error for status_multi (use exactly one {{}} for number of players and {{{{, }}}} to escape braces): {}", e.what()));
+				throw std::runtime_error(std::format("In server {}: {}", name, e.what()));
 			}
 		}
+	}
+	else
+		{ servers.push_back(parse_server_config(config, std::string())); }
+	guild_id = get_config_key<std::uint64_t, "uint64">(config, "guild_id");
+	status_0 = get_optional_config_key<std::string, "string">(config, "status_empty");
+	status_1 = get_optional_config_key<std::string, "string">(config, "status_one");
+	status_multi = get_optional_config_key<std::string, "string">(config, "status_multi");
+	std::string graph_timezone_name = get_optional_config_key<std::string, "string">(config, "graph_timezone", std::string(graph_render_ctx::default_timezone));
+	token = get_config_key<std::string, "string">(config, "bot_token");
+	presence_update_window = get_optional_config_key<std::uint64_t, "uint64">(config, "presence_update_window", 5);
+	svg_row_paths = get_optional_config_key<bool, "bool">(config, "svg_row_paths", true);
+	png_compression_level = get_optional_config_key<std::uint64_t, "uint64">(config, "png_compression_level", graph_options().png_compression_level);
+	if (png_compression_level > 12)
+		{ throw std::runtime_error(std::format("png_compression_level must be at most 12, got {}", png_compression_level)); }
+	graph_row_limit = get_optional_config_key<std::uint64_t, "uint64">(config, "graph_row_limit", 0);
+	attachment_max_bytes = get_optional_config_key<std::uint64_t, "uint64">(config, "attachment_max_bytes", 10 * 1024 * 1024);
+	graph_preview_rows = get_optional_config_key<std::uint64_t, "uint64">(config, "graph_preview_rows", 25);
+	graph_cooldown = get_optional_config_key<std::uint64_t, "uint64">(config, "graph_cooldown", 60);
+	graph_cache_path = get_optional_config_key<std::string, "string">(config, "graph_cache_path");
+	graph_cache_bytes = get_optional_config_key<std::uint64_t, "uint64">(config, "graph_cache_bytes", 256 * 1024 * 1024);
+	font_path = get_optional_config_key<std::string, "string">(config, "font_path");
+	retention_days = get_optional_config_key<std::uint64_t, "uint64">(config, "retention_days", 0);
+	history_days = get_optional_config_key<std::uint64_t, "uint64">(config, "history_days", 0);
+	history_memory_bytes = get_optional_config_key<std::uint64_t, "uint64">(config, "history_memory_bytes", 0);
+	compress_history = get_optional_config_key<bool, "bool">(config, "compress_history", false);
+	session_merge_gap = get_optional_config_key<std::uint64_t, "uint64">(config, "session_merge_gap", 0);
+	metrics_address = get_optional_config_key<std::string, "string">(config, "metrics_address", "127.0.0.1");
+	metrics_port = get_optional_config_key<std::uint64_t, "uint64">(config, "metrics_port", 0);
+	if (metrics_port > std::numeric_limits<std::uint16_t>::max())
+		{ throw std::runtime_error(std::format("metrics_port must be at most {}, got {}", std::numeric_limits<std::uint16_t>::max(), metrics_port)); }
+	http_address = get_optional_config_key<std::string, "string">(config, "http_address", "127.0.0.1");
+	http_port = get_optional_config_key<std::uint64_t, "uint64">(config, "http_port", 0);
+	if (http_port > std::numeric_limits<std::uint16_t>::max())
+		{ throw std::runtime_error(std::format("http_port must be at most {}, got {}", std::numeric_limits<std::uint16_t>::max(), http_port)); }
+	notify_channel_id = get_optional_config_key<std::uint64_t, "uint64">(config, "notify_channel_id", 0);
+	notify_window = get_optional_config_key<std::uint64_t, "uint64">(config, "notify_window", 10);
+	status_channel_id = get_optional_config_key<std::uint64_t, "uint64">(config, "status_channel_id", 0);
+	status_window = get_optional_config_key<std::uint64_t, "uint64">(config, "status_window", 10);
+	digest_channel_id = get_optional_config_key<std::uint64_t, "uint64">(config, "digest_channel_id", 0);
+	{
+		const std::string time_str = get_optional_config_key<std::string, "string">(config, "digest_time", "09:00");
+		unsigned hours = 24, minutes = 60;
+		const auto [ptr, ec] = std::from_chars(time_str.data(), time_str.data() + time_str.size(), hours);
+		if (ec != std::errc() || ptr == time_str.data() + time_str.size() || *ptr != ':'
+			|| std::from_chars(ptr + 1, time_str.data() + time_str.size(), minutes).ptr != time_str.data() + time_str.size() || hours >= 24 || minutes >= 60)
+			{ throw std::runtime_error(std::format("digest_time must be a time of day as hh:mm, got \"{}\"", time_str)); }
+		digest_time = std::chrono::hours(hours) + std::chrono::minutes(minutes);
+	}
+	{
+		const std::string weekday_str = get_optional_config_key<std::string, "string">(config, "digest_weekday", "monday");
+		constexpr std::array<std::string_view, 7> weekday_names = { "sunday", "monday", "tuesday", "wednesday", "thursday", "friday", "saturday" };
+		if (const auto it = std::ranges::find(weekday_names, weekday_str); it != weekday_names.end())
+			{ digest_weekday = std::chrono::weekday(static_cast<unsigned>(it - weekday_names.begin())); }
+		else if (!weekday_str.empty())
+			{ throw std::runtime_error(std::format("digest_weekday must be a day of the week in lowercase (e.g. monday) or empty, got \"{}\"", weekday_str)); }
+	}
+	milestone_channel_id = get_optional_config_key<std::uint64_t, "uint64">(config, "milestone_channel_id", 0);
+	for (const std::uint64_t hours : get_optional_config_key<std::vector<std::uint64_t>, "array of uint64">(config, "milestone_hours", { 10, 50, 100, 250, 500, 1000 }))
+	{
+		if (hours == 0 || hours > 1'000'000)
+			{ throw std::runtime_error(std::format("milestone_hours must be 1 to 1000000, got {}", hours)); }
+		milestone_hours.emplace_back(hours);
+	}
+	lean_gateway = get_optional_config_key<bool, "bool">(config, "lean_gateway", false);
+	// replies, followups and edits are a few requests per command, so a couple of threads is plenty for one guild
+	request_threads = get_optional_config_key<std::uint64_t, "uint64">(config, "request_threads", lean_gateway ? 2 : 12);
+	if (request_threads == 0 || request_threads > 64)
+		{ throw std::runtime_error(std::format("request_threads must be 1 to 64, got {}", request_threads)); }
+	handoff_port = get_optional_config_key<std::uint64_t, "uint64">(config, "handoff_port", 0);
+	if (handoff_port > std::numeric_limits<std::uint16_t>::max())
+		{ throw std::runtime_error(std::format("handoff_port must be at most {}, got {}", std::numeric_limits<std::uint16_t>::max(), handoff_port)); }
+	parse_threads = get_optional_config_key<std::uint64_t, "uint64">(config, "parse_threads", 0);
+	if (parse_threads > 1024)
+		{ throw std::runtime_error(std::format("parse_threads must be at most 1024, got {}", parse_threads)); }
+	parse_background = get_optional_config_key<bool, "bool">(config, "parse_background", false);
+	render_threads = get_optional_config_key<std::uint64_t, "uint64">(config, "render_threads", 2);
+	if (render_threads == 0 || render_threads > 64)
+		{ throw std::runtime_error(std::format("render_threads must be 1 to 64, got {}", render_threads)); }
+	render_memory_bytes = get_optional_config_key<std::uint64_t, "uint64">(config, "render_memory_bytes", 0);
+	replication_address = get_optional_config_key<std::string, "string">(config, "replication_address", "127.0.0.1");
+	replication_port = get_optional_config_key<std::uint64_t, "uint64">(config, "replication_port", 0);
+	if (replication_port > std::numeric_limits<std::uint16_t>::max())
+		{ throw std::runtime_error(std::format("replication_port must be at most {}, got {}", std::numeric_limits<std::uint16_t>::max(), replication_port)); }
+	replicate_from_address = get_optional_config_key<std::string, "string">(config, "replicate_from_address", "127.0.0.1");
+	replicate_from_port = get_optional_config_key<std::uint64_t, "uint64">(config, "replicate_from_port", 0);
+	if (replicate_from_port > std::numeric_limits<std::uint16_t>::max())
+		{ throw std::runtime_error(std::format("replicate_from_port must be at most {}, got {}", std::numeric_limits<std::uint16_t>::max(), replicate_from_port)); }
+	if (replication_port != 0 && replicate_from_port != 0)
+		{ throw std::runtime_error("A replica (replicate_from_port) can't have replicas of its own (replication_port)"); }
+	for (auto [key, cpus] : { std::pair("parse_cpus", &parse_cpus), std::pair("render_cpus", &render_cpus) })
+	{
+		for (const std::uint64_t cpu : get_optional_config_key<std::vector<std::uint64_t>, "array of uint64">(config, key))
+		{
+			if (cpu >= 1024)
+				{ throw std::runtime_error(std::format("{} must be cpu numbers less than 1024, got {}", key, cpu)); }
+			cpus->push_back(static_cast<unsigned>(cpu));
+		}
+	}
 
+	if (!status_multi.empty())  // validate format string
+	{
 		try
 		{
-			logs_timezone = std::chrono::locate_zone(timezone);
+			std::size_t temp = 0;
+			std::ignore = std::vformat(status_multi, std::make_format_args(temp));
 		}
-		catch (const std::runtime_error& e)
+		catch (const std::format_error& e)
 		{
-			throw std::runtime_error(std::format("Could not locate timezone \"{}\" (is it an IANA time zone ID?): {}", timezone, e.what()));
+			throw std::runtime_error(
+				std::format("Formatting error for status_multi (use exactly one {{}} for number of players and {{{{, }}}} to escape braces): {}", e.what()));
 		}
+	}
 
-		bot.emplace(std::move(token));
+	try
+	{
+		graph_timezone = std::chrono::locate_zone(graph_timezone_name);
+	}
+	catch (const std::runtime_error& e)
+	{
+		throw std::runtime_error(std::format("Could not locate graph timezone \"{}\" (is it an IANA time zone ID?): {}", graph_timezone_name, e.what()));
+	}
+
+	return { std::move(servers), guild_id, status_0, status_1, status_multi, presence_update_window, svg_row_paths, static_cast<int>(png_compression_level), graph_timezone, graph_row_limit, attachment_max_bytes, graph_preview_rows, graph_cooldown, std::move(graph_cache_path), graph_cache_bytes, std::move(font_path), retention_days, history_days, history_memory_bytes, compress_history, session_merge_gap, metrics_address, static_cast<std::uint16_t>(metrics_port), http_address, static_cast<std::uint16_t>(http_port),
+		notify_channel_id, notify_window, status_channel_id, status_window, digest_channel_id, digest_time, digest_weekday, milestone_channel_id,
+		std::move(milestone_hours), lean_gateway, static_cast<std::uint32_t>(request_threads), static_cast<std::uint16_t>(handoff_port),
+		static_cast<std::uint32_t>(parse_threads), std::move(parse_cpus), parse_background, static_cast<std::uint32_t>(render_threads), std::move(render_cpus),
+		render_memory_bytes, std::move(replication_address), static_cast<std::uint16_t>(replication_port), std::move(replicate_from_address),
+		static_cast<std::uint16_t>(replicate_from_port) };
+}
 
-		return { log_path, logs_timezone, guild_id, status_0, status_1, status_multi, windows_notify_on_last_write };
+// will call std::exit(-1) if parsing fails
+// @param bot  optional of bot to initialize (needs to be optional ref param because it has no default constructor and is immovable)
+[[nodiscard]] static inline config_t parse_config(std::optional<dpp::cluster>& bot)
+{
+	try
+	{
+		std::string token;
+		config_t config = read_config(token);
+		if (config.lean_gateway)
+		{
+			// interactions are sent regardless of intents. guilds and channels are also cached for dpp's own use, which isn't needed without events
+			bot.emplace(std::move(token), 0, 0, 0, 1, true, dpp::cache_policy::cpol_none, config.request_threads);
+		}
+		else
+			{ bot.emplace(std::move(token), dpp::i_default_intents, 0, 0, 1, true, dpp::cache_policy::cpol_default, config.request_threads); }
+		return config;
 	}
 	catch (const std::exception& e)
 	{
-		std::cerr << "JSON parsing from qc-v2-config.txt failed: " << e.what() << std::endl;
+		log_message(log_severity::fatal, std::format("JSON parsing from {} failed: {}", config_filename, e.what()));
 		std::exit(-1);
 	}
 }
 
-[[nodiscard]] static inline std::size_t get_num_players(const parse_ctx_t& parse_ctx)
+// only the status strings, svg_row_paths, png_compression_level, graph_row_limit, attachment_max_bytes, graph_preview_rows, graph_cooldown and each server's
+// logs_timezone are used when the config is reloaded
+// @return keys of the rest that differ between `old_config` and `new_config`, which are only used after a restart
+[[nodiscard]] static inline std::vector<std::string_view> get_restart_keys(const config_t& old_config, const config_t& new_config)
+{
+	std::vector<std::string_view> res;
+	const auto check = [&](std::string_view key, const auto& old_value, const auto& new_value)
+	{
+		if (old_value != new_value)
+			{ res.push_back(key); }
+	};
+	// a server's data is read into its own shard, and its name is a choice in the registered commands
+	const auto server_keys = [](const server_config_t& server)
+	{
+		return std::tie(server.name, server.log_path, server.logs_format, server.windows_notify_on_last_write, server.snapshot_path, server.journal_path,
+			server.ingest_address, server.ingest_port, server.rcon_address, server.rcon_port, server.rcon_password, server.usercache_path,
+			server.segment_path);
+	};
+	if (!std::ranges::equal(old_config.servers, new_config.servers, {}, server_keys, server_keys))
+		{ res.push_back("servers"); }
+	check("guild_id", old_config.guild_id, new_config.guild_id);
+	check("presence_update_window", old_config.presence_update_window, new_config.presence_update_window);
+	check("graph_timezone", old_config.graph_timezone, new_config.graph_timezone);
+	check("font_path", old_config.font_path, new_config.font_path);
+	check("graph_cache_path", old_config.graph_cache_path, new_config.graph_cache_path);
+	check("graph_cache_bytes", old_config.graph_cache_bytes, new_config.graph_cache_bytes);
+	check("retention_days", old_config.retention_days, new_config.retention_days);
+	check("history_days", old_config.history_days, new_config.history_days);
+	check("history_memory_bytes", old_config.history_memory_bytes, new_config.history_memory_bytes);
+	check("compress_history", old_config.compress_history, new_config.compress_history);
+	check("session_merge_gap", old_config.session_merge_gap, new_config.session_merge_gap);
+	check("metrics_address", old_config.metrics_address, new_config.metrics_address);
+	check("metrics_port", old_config.metrics_port, new_config.metrics_port);
+	check("http_address", old_config.http_address, new_config.http_address);
+	check("http_port", old_config.http_port, new_config.http_port);
+	check("notify_channel_id", old_config.notify_channel_id, new_config.notify_channel_id);
+	check("notify_window", old_config.notify_window, new_config.notify_window);
+	check("status_channel_id", old_config.status_channel_id, new_config.status_channel_id);
+	check("status_window", old_config.status_window, new_config.status_window);
+	check("digest_channel_id", old_config.digest_channel_id, new_config.digest_channel_id);
+	check("digest_time", old_config.digest_time, new_config.digest_time);
+	check("digest_weekday", old_config.digest_weekday, new_config.digest_weekday);
+	check("milestone_channel_id", old_config.milestone_channel_id, new_config.milestone_channel_id);
+	check("milestone_hours", old_config.milestone_hours, new_config.milestone_hours);
+	check("lean_gateway", old_config.lean_gateway, new_config.lean_gateway);
+	check("request_threads", old_config.request_threads, new_config.request_threads);
+	check("handoff_port", old_config.handoff_port, new_config.handoff_port);
+	check("parse_threads", old_config.parse_threads, new_config.parse_threads);
+	check("parse_cpus", old_config.parse_cpus, new_config.parse_cpus);
+	check("parse_background", old_config.parse_background, new_config.parse_background);
+	check("render_threads", old_config.render_threads, new_config.render_threads);
+	check("render_cpus", old_config.render_cpus, new_config.render_cpus);
+	check("render_memory_bytes", old_config.render_memory_bytes, new_config.render_memory_bytes);
+	check("replication_address", old_config.replication_address, new_config.replication_address);
+	check("replication_port", old_config.replication_port, new_config.replication_port);
+	check("replicate_from_address", old_config.replicate_from_address, new_config.replicate_from_address);
+	check("replicate_from_port", old_config.replicate_from_port, new_config.replicate_from_port);
+	return res;
+}
+
+// @return the parts of each command that are set here, sorted, for checking whether the registered commands are the same
+//         commands read from discord are serialized the same as commands made here, so fields discord adds don't make them differ
+[[nodiscard]] static inline std::vector<std::string> get_command_definitions(std::ranges::input_range auto&& commands)
+{
+	std::vector<std::string> res;
+	for (const dpp::slashcommand& command : commands)
+	{
+		const dpp::json command_json = command;
+		dpp::json definition = dpp::json::object();
+		for (const char* key : { "name", "description", "type", "options" })
+		{
+			if (command_json.contains(key))
+				{ definition[key] = command_json[key]; }
+		}
+		res.push_back(definition.dump());
+	}
+	std::ranges::sort(res);
+	return res;
+}
+
+// discord attachment urls are signed and stop working at the time in their ex parameter (hexadecimal unix time)
+// @return time a bit before the url stops working, so a reply linking to it can still be shown, or the max time point if it has no expiry
+[[nodiscard]] static inline std::chrono::system_clock::time_point get_attachment_url_expiry(std::string_view url)
+{
+	constexpr auto margin = std::chrono::minutes(10);
+	const std::size_t query = url.find('?');
+	if (query == std::string_view::npos)
+		{ return std::chrono::system_clock::time_point::max(); }
+	for (const auto param : std::views::split(url.substr(query + 1), '&'))
+	{
+		const std::string_view param_str(param.begin(), param.end());
+		if (!param_str.starts_with("ex="))
+			{ continue; }
+		std::int64_t expiry;
+		const auto res = std::from_chars(param_str.data() + 3, param_str.data() + param_str.size(), expiry, 16);
+		if (res.ec != std::errc() || res.ptr != param_str.data() + param_str.size())
+			{ return {}; }  // unknown format, so it isn't reused
+		return std::chrono::system_clock::time_point(std::chrono::seconds(expiry)) - margin;
+	}
+	return std::chrono::system_clock::time_point::max();
+}
+
+// a png graph is rendered as an svg instead if it would be larger than attachment_max_bytes (see graph_options::png_max_bytes)
+// @return whether graph contents are a png
+[[nodiscard]] static inline bool is_png(std::string_view contents)
+	{ return contents.starts_with("\x89PNG"); }
+
+// @return `duration` in its two largest units, like "3d 4h" or "12m 5s"
+[[nodiscard]] static inline std::string format_duration(std::chrono::seconds duration)
+{
+	const auto days = std::chrono::floor<std::chrono::days>(duration);
+	const auto hours = std::chrono::floor<std::chrono::hours>(duration - days);
+	const auto minutes = std::chrono::floor<std::chrono::minutes>(duration - days - hours);
+	if (days.count() != 0)
+		{ return std::format("{}d {}h", days.count(), hours.count()); }
+	if (hours.count() != 0)
+		{ return std::format("{}h {}m", hours.count(), minutes.count()); }
+	return std::format("{}m {}s", minutes.count(), (duration - minutes).count());
+}
+
+// @return `bytes` in the largest binary unit it has at least one of, like "12.3 MiB"
+[[nodiscard]] static inline std::string format_bytes(std::size_t bytes)
 {
-	std::size_t num_players = 0;
-	for (const auto& [cur_name, cur_info] : parse_ctx.player_info)
+	constexpr std::array<std::string_view, 4> units = { "KiB", "MiB", "GiB", "TiB" };
+	if (bytes < 1024)
+		{ return std::format("{} B", bytes); }
+	double val = static_cast<double>(bytes) / 1024;
+	std::size_t unit = 0;
+	for (; val >= 1024 && unit + 1 < units.size(); unit++)
+		{ val /= 1024; }
+	return std::format("{:.1f} {}", val, units[unit]);
+}
+
+// @return one line of the memory census (see /debug memory)
+[[nodiscard]] static inline std::string format_memory_usage(std::string_view what, const memory_usage& usage)
+{
+	std::string res = std::format("{:<16}{:>10}", what, format_bytes(usage.bytes));
+	if (usage.string_bytes != 0)
+		{ res += std::format(", {} in strings", format_bytes(usage.string_bytes)); }
+	if (usage.players != 0)
+		{ res += std::format(", {} players", usage.players); }
+	if (usage.sessions != 0)
+		{ res += std::format(", {} sessions", usage.sessions); }
+	return res + '\n';
+}
+
+// @return what parsing an archive cost, like "log.gz: 1.2 MiB (8.0 MiB), 41000 lines, 900 events, 12 ms decompress, 30 ms scan, 4 ms apply, 0 warnings"
+[[nodiscard]] static inline std::string format_ingest_stats(const log_manifest_entry& file)
+{
+	const file_ingest_stats& stats = file.ingest;
+	const auto ms = [](std::chrono::nanoseconds time) { return std::chrono::duration_cast<std::chrono::milliseconds>(time).count(); };
+	std::string res = file.path.filename().string() + ": ";
+	if (stats.cached)
+		{ res += "cached"; }
+	else
 	{
-		const auto& [uuid, join_time] = cur_info;
-		if (join_time)
-			{ num_players++; }
+		res += format_bytes(stats.compressed_bytes);
+		if (stats.compressed_bytes != stats.bytes)
+			{ res += std::format(" ({})", format_bytes(stats.bytes)); }
 	}
-	return num_players;
+	res += std::format(", {} lines, {} events", stats.lines, stats.events);
+	if (!stats.cached)
+		{ res += std::format(", {} ms decompress, {} ms scan", ms(stats.decompress_time), ms(stats.scan_time)); }
+	return res + std::format(", {} ms apply, {} warnings", ms(stats.apply_time), stats.warnings);
+}
+
+// @return memory used by the objects in a dpp cache and its map, not counting what they allocate
+template<typename T>
+[[nodiscard]] static inline std::size_t get_dpp_cache_bytes(dpp::cache<T>* cache)
+	{ return (cache == nullptr) ? 0 : cache->bytes() + cache->count() * sizeof(T); }
+
+[[nodiscard]] static inline std::size_t get_num_players(const parse_ctx_t& parse_ctx)
+{
+	return parse_ctx.player_info.online().size();
 }
 
-static inline void update_player_count(dpp::cluster& bot, const config_t& config, const parse_ctx_t& parse_ctx, std::size_t& last_player_count)
+// @param new_player_count  online on all servers
+// @param force  set the status even if the count is the same, e.g. after the status strings changed
+static inline void update_player_count(presence_scheduler& presence, const config_t& config, std::size_t new_player_count, std::size_t& last_player_count,
+	bool force = false)
 {
-	auto new_player_count = get_num_players(parse_ctx);
-	if (new_player_count != last_player_count)
+	if (force || new_player_count != last_player_count)
 	{
 		last_player_count = new_player_count;
 		std::string str;
@@ -225,271 +835,3026 @@ static inline void update_player_count(dpp::cluster& bot, const config_t& config
 				{ str = std::vformat(config.status_multi, std::make_format_args(new_player_count)); }
 			break;
 		}
-		dpp::presence ps;
-		if (str.empty())
-			{ ps = dpp::presence(dpp::ps_online, dpp::activity()); }
-		else
-			{ ps = dpp::presence(dpp::ps_online, dpp::at_game, str); }
-		bot.set_presence(ps);
-		bot.log(dpp::loglevel::ll_info, "changing presence");
+		presence.set(std::move(str));
+	}
+}
+
+// data of all servers, for commands that aren't about one of them
+// history segments are shared with the servers' data instead of being copied, only latest.log data and the parse contexts (which are small) are combined
+// a player who played on several servers has their history sessions in several segments, which everything reading history already handles
+// @param sources  published data of each server
+// @param names  of each server
+[[nodiscard]] static inline published_data_t merge_published_data(std::span<const std::shared_ptr<const published_data_t>> sources,
+	std::span<const std::string> names)
+{
+	published_data_t res{};
+	for (std::size_t i = 0; i < sources.size(); i++)
+	{
+		const auto& source = sources[i];
+		res.servers.emplace_back(names[i], source);
+		res.history.add_segments(source->history);
+		res.lag.insert(res.lag.end(), source->lag.begin(), source->lag.end());
+		for (const auto& [uuid, player_data] : source->recent)
+		{
+			auto& [player_names, play_info] = res.recent[uuid];
+			for (const std::string& name : player_data.first)
+			{
+				if (std::ranges::find(player_names, name) == player_names.end())
+					{ player_names.push_back(name); }
+			}
+			// each server's sessions are in order, so they're merged into the others' as they're added (instead of sorting them all again)
+			auto& sessions = play_info.first;
+			const auto num_before = static_cast<std::ptrdiff_t>(sessions.size());
+			sessions.insert(sessions.end(), player_data.second.first.begin(), player_data.second.first.end());
+			std::inplace_merge(sessions.begin(), sessions.begin() + num_before, sessions.end());
+			play_info.second += player_data.second.second;
+		}
+		const auto& players = source->ctx.player_info;
+		for (std::uint32_t id = 0; id < players.size(); id++)
+		{
+			const auto& [uuid, join_time] = players.infos()[id];
+			const std::uint32_t merged_id = res.ctx.player_info.intern(players.name(id));
+			if (uuid)
+				{ res.ctx.player_info.set_uuid(merged_id, uuid.value()); }
+			// a player online on several servers has been online since they joined the first of them
+			const auto merged_join_time = res.ctx.player_info.infos()[merged_id].join_time;
+			if (join_time && (!merged_join_time || join_time.value() < merged_join_time.value()))
+				{ res.ctx.player_info.set_join_time(merged_id, join_time); }
+		}
+		res.ctx.date_tp = std::max(res.ctx.date_tp, source->ctx.date_tp);
+		res.generation += source->generation;  // generations only increase, so the sum changes whenever one of them does
+		res.files_loaded += source->files_loaded;
+		res.files_total += source->files_total;
+		res.checkpoint_memory += source->checkpoint_memory;
 	}
+	return res;
 }
 
+// read the names and uuids in a server's usercache.json (an array of objects with name, uuid and expiresOn), which has the players who joined
+// in the last month or so, including those whose uuid lines are in archives that aren't read (see config_t::history_days)
+// @return the bindings, or null if there is no usercache or it can't be read
+[[nodiscard]] static std::shared_ptr<const known_uuids_t> read_usercache(const std::string& path, const std::string& log_prefix)
+{
+	if (path.empty())
+		{ return nullptr; }
+	std::ifstream fin(path);
+	if (!fin)
+		{ return nullptr; }
+	try
+	{
+		const jsoncons::json usercache = jsoncons::json::parse(fin);
+		if (!usercache.is_array())
+			{ throw std::runtime_error("Expected an array"); }
+		auto res = std::make_shared<known_uuids_t>();
+		for (const auto& entry : usercache.array_range())
+		{
+			if (!entry.is_object() || !entry.contains("name") || !entry.contains("uuid") || !entry.at("name").is_string() || !entry.at("uuid").is_string())
+				{ continue; }
+			const std::string uuid_str = entry.at("uuid").as<std::string>();
+			if (uuid_str.size() != 36)
+				{ continue; }
+			if (const auto uuid = detail::parse_uuid(std::span<const char, 36>(uuid_str.data(), 36)))
+				{ res->insert_or_assign(entry.at("name").as<std::string>(), uuid.value()); }
+		}
+		log_message(log_severity::info, log_prefix + std::format("Read uuids of {} players from {}", res->size(), path));
+		return res;
+	}
+	catch (const std::exception& e)
+	{
+		log_message(log_severity::warning, log_prefix + std::format("Could not read {}: {}", path, e.what()));
+		return nullptr;
+	}
+}
+
+// a server whose logs are read on its own thread, with its own tailer, parse context and history
+struct server_shard
+{
+	const server_config_t& config;
+	// config.logs_timezone, or what it was changed to since (see reload_config). only used for lines parsed after it changes
+	std::atomic<const std::chrono::time_zone*> logs_timezone;
+	// only the shard's thread touches its parsed data. slash commands read the latest published copy,
+	// so neither side ever waits for the other (null until some history has been read)
+	std::atomic<std::shared_ptr<const published_data_t>> published;
+	std::atomic<std::size_t> num_players = 0;  // online, for the bot's status
+	// set by another thread to have the shard save its latest.log resume point now (see latest_log_resume_t), cleared once it has
+	std::atomic<bool> save_resume_requested = false;
+	std::atomic<file_watcher*> watcher = nullptr;  // of latest.log once it is watched, to wake up the shard's thread
+	// sessions of archives parsed again for queries about times before the retention period (see config_t::retention_days)
+	archive_range_cache archive_ranges;
+	// joins, leaves, starts and stops the shard's thread parsed last, for /recent (read without locks)
+	recent_event_ring recent_events;
+	std::thread thread;
+
+	explicit server_shard(const server_config_t& config) : config(config), logs_timezone(config.logs_timezone) {}
+};
+
+// published data of all servers merged (see merge_published_data), remade when one of them publishes
+class merged_view
+{
+private:
+	std::mutex mutex;
+	std::vector<std::shared_ptr<const published_data_t>> sources;  // that value was made from
+	std::shared_ptr<const published_data_t> value;
+
+public:
+	// @return merged data of each shard's latest published data, or null if one hasn't published yet
+	[[nodiscard]] std::shared_ptr<const published_data_t> get(std::span<const std::unique_ptr<server_shard>> shards)
+	{
+		std::vector<std::shared_ptr<const published_data_t>> cur_sources;
+		for (const auto& shard : shards)
+		{
+			cur_sources.push_back(shard->published.load());
+			if (!cur_sources.back())
+				{ return nullptr; }
+		}
+		{
+			std::scoped_lock lock(mutex);
+			if (value && sources == cur_sources)
+				{ return value; }
+		}
+		// merged without holding the lock, like history_cache, so commands for one server don't wait for it
+		std::vector<std::string> names;
+		for (const auto& shard : shards)
+			{ names.push_back(shard->config.name); }
+		auto merged = std::make_shared<const published_data_t>(merge_published_data(cur_sources, names));
+		std::scoped_lock lock(mutex);
+		sources = std::move(cur_sources);
+		value = merged;
+		return merged;
+	}
+};
+
 int main()
 {
 	std::optional<dpp::cluster> bot_;
 	auto config = parse_config(bot_);
 	auto& bot = bot_.value();
+	// what the config file has now (see reload_config), for the settings that can change while running. config is what the bot started with
+	std::atomic<std::shared_ptr<const config_t>> live_config = std::make_shared<const config_t>(config);
+	set_resource_limits({ .parse_threads = config.parse_threads, .parse_cpus = config.parse_cpus, .parse_background = config.parse_background,
+		.render_cpus = config.render_cpus });
+	// read before anything renders, so finding and reading the font file is never part of a render
+	if (detail::text_metrics::load_font(config.font_path))
+		{ log_message(log_severity::info, std::format("Loaded font {}", config.font_path.empty() ? "(default)" : config.font_path)); }
+	else
+	{
+		log_message(log_severity::warning, config.font_path.empty() ? std::string("No default font was found, graphs will have no text (set font_path)") :
+			std::format("Could not read font_path {}, graphs will have no text", config.font_path));
+	}
 
-	bot.on_log(dpp::utility::cout_logger());
+	bot.on_log([](const dpp::log_t& event)
+	{
+		log_severity severity;
+		switch (event.severity)
+		{
+		case dpp::ll_trace:
+			return;
+		case dpp::ll_debug:
+			severity = log_severity::debug;
+			break;
+		case dpp::ll_info:
+			severity = log_severity::info;
+			break;
+		case dpp::ll_warning:
+			severity = log_severity::warning;
+			break;
+		default:
+			severity = log_severity::error;
+			break;
+		}
+		log_message(severity, "[dpp] " + event.message, log_type::dpp);
+	});
 	
 	bot.on_ready([&bot, &config](const dpp::ready_t& event)
 	{
 		if (dpp::run_once<decltype([]() {})>())
 		{
+			// with several servers, commands are about all of them unless one is chosen
+			std::optional<dpp::command_option> server_option;
+			if (config.servers.size() > 1)
+			{
+				server_option.emplace(dpp::co_string, "server", "Server to show, all of them by default", false);
+				for (const server_config_t& server : config.servers)
+					{ server_option->add_choice(dpp::command_option_choice(server.name, server.name)); }
+				server_option->add_choice(dpp::command_option_choice(std::string(merged_view_name), std::string(merged_view_name)));
+			}
 			dpp::slashcommand command_graph("graph", "Create a graph of play times", bot.me.id);
 			// TODO: make this a subcommand and allow specifying size for png?
+			command_graph.add_option(dpp::command_option(dpp::co_string, "type", "What to graph", false)
+				.add_choice(dpp::command_option_choice("playtime", std::string("playtime")))
+				.add_choice(dpp::command_option_choice("online", std::string("online")))
+				.add_choice(dpp::command_option_choice("heatmap", std::string("heatmap")))
+				.add_choice(dpp::command_option_choice("lag", std::string("lag"))));
+			// players online on each server, stacked over the same time axis
+			if (config.servers.size() > 1)
+				{ command_graph.options.back().add_choice(dpp::command_option_choice("servers", std::string("servers"))); }
 			command_graph.add_option(dpp::command_option(dpp::co_string, "format", "File format of graph", false)
 				.add_choice(dpp::command_option_choice("png", std::string("png")))
 				.add_choice(dpp::command_option_choice("svg", std::string("svg"))));
 			// false for light and true for dark
-			command_graph.add_option(dpp::command_option(dpp::co_boolean, "dark", "Use dark theme for drawing graph labels and axes", false)
+			command_graph.add_option(dpp::command_option(dpp::co_boolean, "dark", "Use dark theme for drawing graph labels and axes (an svg follows the viewer's theme)", false)
 				.add_choice(dpp::command_option_choice("false", false))
 				.add_choice(dpp::command_option_choice("true", true)));
+			command_graph.add_option(dpp::command_option(dpp::co_integer, "limit", "Number of players to show, the rest are combined into one row", false)
+				.set_min_value(std::int64_t(1)));
+			command_graph.add_option(dpp::command_option(dpp::co_string, "player", "Show the sessions of one player (current or former name)", false)
+				.set_auto_complete(true));
+			command_graph.add_option(dpp::command_option(dpp::co_string, "from", "First date to show (yyyy-mm-dd)", false));
+			command_graph.add_option(dpp::command_option(dpp::co_string, "to", "Last date to show (yyyy-mm-dd)", false));
 			dpp::slashcommand command_players("players", "List online players", bot.me.id);
-			bot.guild_bulk_command_create({ command_graph, command_players }, config.guild_id);
+			if (server_option)
+			{
+				command_graph.add_option(server_option.value());
+				command_players.add_option(server_option.value());
+			}
+			dpp::slashcommand command_leaderboard("leaderboard", "List the players with the most playtime", bot.me.id);
+			command_leaderboard.add_option(dpp::command_option(dpp::co_string, "period", "Playtime to count", false)
+				.add_choice(dpp::command_option_choice("all time", std::string("all")))
+				.add_choice(dpp::command_option_choice("last 30 days", std::string("month")))
+				.add_choice(dpp::command_option_choice("last 7 days", std::string("week")))
+				.add_choice(dpp::command_option_choice("today", std::string("today"))));
+			command_leaderboard.add_option(dpp::command_option(dpp::co_string, "player", "Also show the rank of a player", false)
+				.set_auto_complete(true));
+			if (server_option)
+				{ command_leaderboard.add_option(server_option.value()); }
+			dpp::slashcommand command_online_at("online_at", "List the players who were online at a time", bot.me.id);
+			command_online_at.add_option(dpp::command_option(dpp::co_string, "time", "yyyy-mm-dd hh:mm, or a unix timestamp", true));
+			if (server_option)
+				{ command_online_at.add_option(server_option.value()); }
+			dpp::slashcommand command_friends("friends", "List the players who were online at the same time as a player the most", bot.me.id);
+			command_friends.add_option(dpp::command_option(dpp::co_string, "player", "Player to find the friends of (current or former name)", true)
+				.set_auto_complete(true));
+			if (server_option)
+				{ command_friends.add_option(server_option.value()); }
+			dpp::slashcommand command_seen("seen", "Show when a player was last online", bot.me.id);
+			command_seen.add_option(dpp::command_option(dpp::co_string, "player", "Player to look up (current or former name)", true)
+				.set_auto_complete(true));
+			if (server_option)
+				{ command_seen.add_option(server_option.value()); }
+			dpp::slashcommand command_recent("recent", "List who joined or left recently, and when servers started or stopped", bot.me.id);
+			command_recent.add_option(dpp::command_option(dpp::co_integer, "minutes", "How far back to look (default 60)", false)
+				.set_min_value(std::int64_t(1)).set_max_value(std::int64_t(1440)));
+			if (server_option)
+				{ command_recent.add_option(server_option.value()); }
+			dpp::slashcommand command_stats("stats", "Show how long sessions last", bot.me.id);
+			command_stats.add_option(dpp::command_option(dpp::co_string, "player", "Also show the sessions of a player (current or former name)", false)
+				.set_auto_complete(true));
+			command_stats.add_option(dpp::command_option(dpp::co_string, "from", "First date of sessions to include (yyyy-mm-dd)", false));
+			command_stats.add_option(dpp::command_option(dpp::co_string, "to", "Last date of sessions to include (yyyy-mm-dd)", false));
+			if (server_option)
+				{ command_stats.add_option(server_option.value()); }
+			dpp::slashcommand command_active("active", "Count the players who played recently", bot.me.id);
+			command_active.add_option(dpp::command_option(dpp::co_string, "player", "Also show how many days in a row a player has played", false)
+				.set_auto_complete(true));
+			if (server_option)
+				{ command_active.add_option(server_option.value()); }
+			dpp::slashcommand command_retention("retention", "Show how many of the players who first joined in each month still play", bot.me.id);
+			command_retention.add_option(dpp::command_option(dpp::co_integer, "months", "Number of months of new players to show, including this one (default 6)", false)
+				.set_min_value(std::int64_t(1)).set_max_value(std::int64_t(12)));
+			if (server_option)
+				{ command_retention.add_option(server_option.value()); }
+			// only shown to server admins by default, discord lets them allow others
+			dpp::slashcommand command_debug("debug", "Diagnostics of the bot", bot.me.id);
+			command_debug.set_default_permissions(dpp::p_administrator);
+			dpp::command_option command_debug_memory(dpp::co_sub_command, "memory", "Show memory used by parsed data and caches");
+			if (server_option)
+				{ command_debug_memory.add_option(server_option.value()); }
+			command_debug.add_option(command_debug_memory);
+#ifdef QC_TRACING
+			command_debug.add_option(dpp::command_option(dpp::co_sub_command, "trace", "Get recent spans of what the bot did, as a Chrome trace"));
+#endif
+#ifdef SAMPLING_PROFILER_AVAILABLE
+			command_debug.add_option(dpp::command_option(dpp::co_sub_command, "profile", "Sample where the bot spends cpu time, as folded stacks for a flame graph")
+				.add_option(dpp::command_option(dpp::co_integer, "seconds", "How long to sample for (default 10)", false)
+					.set_min_value(std::int64_t(1)).set_max_value(std::int64_t(60))));
+#endif
+			// also only for admins, it has every session (and players' uuids)
+			dpp::slashcommand command_export("export", "Download sessions that have ended, as a file for spreadsheets or analytics tools", bot.me.id);
+			command_export.set_default_permissions(dpp::p_administrator);
+			command_export.add_option(dpp::command_option(dpp::co_string, "format", "File format of the rows", false)
+				.add_choice(dpp::command_option_choice("csv", std::string("csv")))
+				.add_choice(dpp::command_option_choice("ndjson", std::string("ndjson")))
+				.add_choice(dpp::command_option_choice("arrow (not compressed)", std::string("arrow"))));
+			command_export.add_option(dpp::command_option(dpp::co_string, "from", "First date of sessions to include (yyyy-mm-dd)", false));
+			command_export.add_option(dpp::command_option(dpp::co_string, "to", "Last date of sessions to include (yyyy-mm-dd)", false));
+			if (server_option)
+				{ command_export.add_option(server_option.value()); }
+			dpp::slashcommand command_timelapse("timelapse", "Create an animation of the players online, one hour at a time", bot.me.id);
+			command_timelapse.add_option(dpp::command_option(dpp::co_integer, "days", "Number of days to show, up to now (default 7)", false)
+				.set_min_value(std::int64_t(1)).set_max_value(std::int64_t(30)));
+			command_timelapse.add_option(dpp::command_option(dpp::co_boolean, "dark", "Use dark theme for drawing labels and axes", false)
+				.add_choice(dpp::command_option_choice("false", false))
+				.add_choice(dpp::command_option_choice("true", true)));
+			if (server_option)
+				{ command_timelapse.add_option(server_option.value()); }
+			dpp::slashcommand command_uptime("uptime", "Show how long the server was up, and how often it stopped or crashed", bot.me.id);
+			command_uptime.add_option(dpp::command_option(dpp::co_integer, "days", "Number of days to look at, up to now (default 30)", false)
+				.set_min_value(std::int64_t(1)).set_max_value(std::int64_t(3650)));
+			if (server_option)
+				{ command_uptime.add_option(server_option.value()); }
+			std::vector<dpp::slashcommand> commands = { command_graph, command_players, command_leaderboard, command_online_at, command_friends, command_seen,
+				command_recent, command_stats, command_active, command_retention, command_debug, command_export, command_timelapse, command_uptime };
+
+			// registering commands is only needed when they change, and discord can take a while to update them
+			bot.guild_commands_get(config.guild_id, [&bot, &config, commands = std::move(commands)](const dpp::confirmation_callback_t& res)
+			{
+				if (!res.is_error() && get_command_definitions(res.get<dpp::slashcommand_map>() | std::views::values) == get_command_definitions(commands))
+				{
+					log_message(log_severity::info, "Slash commands are already registered");
+					return;
+				}
+				if (res.is_error())
+					{ log_message(log_severity::warning, std::format("Could not get registered slash commands: {}", res.get_error().human_readable)); }
+				log_message(log_severity::info, "Registering slash commands");
+				bot.guild_bulk_command_create(commands, config.guild_id);
+			});
 		}
 	});
 
-	std::vector<std::string> read_files;
-	std::pair<log_data_t, parse_ctx_t> parse_data_ctx, persistent_data_ctx;
-	auto& [parse_data, parse_ctx] = parse_data_ctx;
-	std::mutex parse_data_ctx_mutex;
-	std::size_t last_player_count = 0;
-
-	parse_data_ctx_mutex.lock();
-
-	// next available time point when the graph command can be called
-	std::chrono::system_clock::time_point graph_command_next_tp;
-	std::mutex next_tp_mutex;
-	
-	// this slash command handler will only ever read from parse_data (not write)
-	bot.on_slashcommand([&](const dpp::slashcommand_t& event) -> dpp::task<void>
+	// each server is read on its own thread (see run_server)
+	std::vector<std::unique_ptr<server_shard>> shards;
+	for (const server_config_t& server : config.servers)
+		{ shards.push_back(std::make_unique<server_shard>(server)); }
+	// writes the files saved while reading logs and rendering graphs, so those threads don't wait for the disk
+	// after shards, so what they queued is written before they are destroyed
+	durable_file_writer file_writer;
+	presence_scheduler presence(bot, config.presence_update_window);
+	std::optional<join_notifier> notifier;
+	if (config.notify_channel_id != 0)
+		{ notifier.emplace(bot, config.notify_channel_id, config.notify_window); }
+	// replicas don't connect to discord, the primary keeps the message
+	std::optional<status_message> status;
+	if (config.status_channel_id != 0 && config.replicate_from_port == 0)
 	{
-		using namespace std::string_view_literals;
-		const auto cmd_name = event.command.get_command_name();
-		if (cmd_name == "graph"sv)
+		status.emplace(bot, config.status_channel_id, config.status_window, [&]() -> std::optional<std::string>
 		{
-			// rate limit
+			std::string msg;
+			for (const auto& shard : shards)
 			{
-				std::scoped_lock(next_tp_mutex);
-				const auto now = std::chrono::system_clock::now();
-				if (now >= graph_command_next_tp)
-					{ graph_command_next_tp = now + std::chrono::seconds(60); }  // TODO: configurable rate limit
-				else
-				{
-					event.reply(dpp::message(std::format("Last graph was generated recently, please try again <t:{:%Q}:R>",
-						std::chrono::ceil<std::chrono::seconds>(graph_command_next_tp.time_since_epoch()))).set_flags(dpp::m_ephemeral));
-					co_return;
-				}
+				const std::shared_ptr<const published_data_t> data = shard->published.load();
+				if (!data)
+					{ return {}; }
+				if (!msg.empty())
+					{ msg += "\n\n"; }
+				if (shards.size() > 1)
+					{ msg += std::format("__{}__\n", dpp::utility::markdown_escape(shard->config.name)); }
+				msg += players_message(*data);
 			}
-			dpp::async thinking = event.co_thinking(false);
-			
-			// format is png by default
-			const auto format_param = event.get_parameter("format");
-			const std::string* format_str_ptr = std::get_if<std::string>(&format_param);
-			const std::string_view format = (format_str_ptr == nullptr) ? "png"sv : *format_str_ptr;
-
-			const auto dark_param = event.get_parameter("dark");
-			const bool* dark_ptr = std::get_if<bool>(&dark_param);
-			const std::string_view color = (dark_ptr != nullptr && *dark_ptr) ? "white" : "black";  // white text for darkmode and dark text otherwise
+			return msg;
+		});
+	}
+	std::mutex player_count_mutex;
+	std::size_t last_player_count = 0;  // on all servers, guarded by player_count_mutex
+	// the status has the number of players online on all servers
+	const auto publish_player_count = [&](server_shard& shard, const parse_ctx_t& parse_ctx)
+	{
+		shard.num_players = get_num_players(parse_ctx);
+		std::scoped_lock lock(player_count_mutex);
+		std::size_t total = 0;
+		for (const auto& cur : shards)
+			{ total += cur->num_players; }
+		update_player_count(presence, *live_config.load(), total, last_player_count);
+		if (status)
+			{ status->update(); }
+	};
+	const std::chrono::seconds merge_gap(config.session_merge_gap);
 
-			const bool format_is_svg = (format == "svg"sv);
-			const std::string_view file_mime_type = format_is_svg ? "image/svg+xml"sv : "image/png"sv;
-			const std::string_view filename = format_is_svg ? "graph.svg"sv : "graph.png"sv;
-			std::string file_contents;
-			{
-				// TODO: allow user to specify date range
-				// TODO: set last date to current time instead of last player time
-				std::scoped_lock lock(parse_data_ctx_mutex);
-				std::cout << "INFO: Creating graph in " << (format_is_svg ? "svg"sv : "png"sv) << " format" << std::endl;
-				if (format_is_svg)
-					{ file_contents = create_graph<true, false>(parse_data, parse_ctx, color); }
-				else
-					{ file_contents = create_graph<false, true>(parse_data, parse_ctx, color); }
-				std::cout << "INFO: Finished creating graph" << std::endl;
-			}
-			
-			co_await thinking;
-			event.edit_original_response(dpp::message().add_file(filename, file_contents, file_mime_type));
-		}
-		else if (cmd_name == "players"sv)
+	// commands are about a view: one server (indexed like shards), or all of them merged (after the servers, only if there are several)
+	const std::size_t merged_view_index = shards.size();
+	const std::size_t num_views = (shards.size() > 1) ? shards.size() + 1 : 1;
+	const std::unique_ptr<view_caches[]> caches = std::make_unique<view_caches[]>(num_views);
+	merged_view merged;
+	// @return latest data of `view`, or null if it hasn't been published yet
+	const auto get_view_data = [&](std::size_t view)
+		{ return (view == merged_view_index) ? merged.get(shards) : shards[view]->published.load(); };
+	// @param param  server option of a command
+	// @return view it chooses, all servers if it isn't given
+	const auto get_view = [&](const dpp::command_value& param)
+	{
+		if (const std::string* name_ptr = std::get_if<std::string>(&param))
 		{
-			dpp::async thinking = event.co_thinking(false);
-
-			std::string msg;
-			std::size_t num_players = 0;
+			for (std::size_t i = 0; i < shards.size(); i++)
 			{
-				std::scoped_lock lock(parse_data_ctx_mutex);
-				for (const auto& [cur_name, cur_info] : parse_ctx.player_info)
-				{
-					const auto& [uuid, join_time] = cur_info;
-					if (join_time)
-					{
-						msg += cur_name;
-						msg += ", ";
-						num_players++;
-					}
-				}
-				if (num_players == 0)
-					{ msg = "No players online"; }
-				else
-				{
-					msg.resize(msg.size() - 2);  // remove final ", "
-					msg = std::format("**{} players online:** {}", num_players, msg);
-				}
+				if (shards[i]->config.name == *name_ptr)
+					{ return i; }
 			}
-			co_await thinking;
-			event.edit_original_response(dpp::message(msg));
 		}
-	});
-	
-	// bot.start will block in 10.0.35, even with dpp::st_return
-	std::thread([&]() { bot.start(dpp::st_return); }).detach();
-	
-	std::cout << "INFO: Performing initial parse" << std::endl;
+		return (shards.size() > 1) ? merged_view_index : std::size_t(0);
+	};
+	// heavy commands (graphs that have to be rendered, and exports) take tokens from buckets of their user and of their channel,
+	// so one user's renders don't hold up everyone else's. cached graphs and renders that are already running are free
+	rate_limiter user_limiter, channel_limiter;
+	constexpr double user_burst = 3;
+	// shared by everyone in the channel, so it refills 3 times as fast as a user's
+	constexpr double channel_burst = 6;
+	// take `cost` tokens for `event` from its user's and its channel's buckets (see config_t::graph_cooldown)
+	// @return 0 if they were taken, otherwise how long until they can be
+	const auto take_command_tokens = [&live_config, &user_limiter, &channel_limiter, user_burst, channel_burst](const dpp::slashcommand_t& event, double cost)
+	{
+		const std::chrono::milliseconds interval = std::chrono::seconds(live_config.load()->graph_cooldown);
+		if (interval.count() == 0)
+			{ return std::chrono::milliseconds(0); }
+		if (const auto wait = user_limiter.try_take(event.command.usr.id, cost, user_burst, interval); wait.count() != 0)
+			{ return wait; }
+		if (const auto wait = channel_limiter.try_take(event.command.channel_id, cost, channel_burst, interval / 3); wait.count() != 0)
+		{
+			user_limiter.refund(event.command.usr.id, cost, interval);
+			return wait;
+		}
+		return std::chrono::milliseconds(0);
+	};
+	// send `msg` as the response to `event`: as its reply, or by editing it if it was deferred (see dpp::interaction_create_t::thinking)
+	const auto respond = [](const dpp::slashcommand_t& event, bool deferred, const dpp::message& msg)
+		{ return deferred ? event.co_edit_original_response(msg) : event.co_reply(msg); };
+	// @param wait  from take_command_tokens
+	const auto reply_rate_limited = [](const dpp::slashcommand_t& event, std::chrono::milliseconds wait)
+	{
+		const auto retry_tp = std::chrono::ceil<std::chrono::seconds>(std::chrono::system_clock::now() + wait);
+		event.reply(dpp::message(std::format("Too many graphs were generated here recently, please try again <t:{:%Q}:R>", retry_tp.time_since_epoch()))
+			.set_flags(dpp::m_ephemeral));
+	};
 
-	parse_data_ctx = parse_logs<true, true>(config.log_path, config.logs_timezone, [&](const auto& p) { read_files.emplace_back(log_filename_no_ext(p)); });
-	persistent_data_ctx = parse_data_ctx;
-	
-	const std::filesystem::path latest_log = std::filesystem::path(config.log_path) / "latest.log";
-#ifdef _WIN32
-#define FILE_WATCHER_USER_DATA &(config.windows_notify_on_last_write)
-#else
-#define FILE_WATCHER_USER_DATA nullptr
-#endif
-	file_watcher watcher(config.log_path.c_str(), latest_log.filename().string(), FILE_WATCHER_USER_DATA);
-#undef FILE_WATCHER_USER_DATA
+	graph_render_ctx graph_ctx(config.graph_timezone);
+	// each render thread's share of render_memory_bytes
+	const std::size_t render_surface_bytes = static_cast<std::size_t>(config.render_memory_bytes / config.render_threads);
+	// how long a graph with online players can be reused for
+	constexpr auto graph_cache_online_max_age = std::chrono::seconds(60);
 
-	const auto update_date_tp = [&](bool latest_log_exists)
+	std::optional<disk_graph_cache> disk_graphs;
+	if (!config.graph_cache_path.empty())
+		{ disk_graphs.emplace(config.graph_cache_path, config.graph_cache_bytes, file_writer); }
+	detail::segment_cache<std::uint64_t> segment_hashes;  // see sessions_fingerprint
+	// @return key in disk_graphs of the graph of `key` made from `data` with `cur_config`, without its size (see disk_graph_cache)
+	const auto get_disk_graph_key = [&config, render_surface_bytes, &segment_hashes](const published_data_t& data, const graph_cache::key_t& key, const config_t& cur_config)
 	{
-		if (latest_log_exists)
-			{ parse_ctx.date_tp = file_modification_date(latest_log, config.logs_timezone); }
+		std::uint64_t res = detail::hash_combine(disk_graph_cache::format_version, sessions_fingerprint(data.history, data.recent, segment_hashes));
+		for (const std::uint64_t n : { static_cast<std::uint64_t>(key.type), static_cast<std::uint64_t>(key.svg), static_cast<std::uint64_t>(key.dark),
+			static_cast<std::uint64_t>(key.row_limit), static_cast<std::uint64_t>(key.range.begin.time_since_epoch().count()),
+			static_cast<std::uint64_t>(key.range.end.time_since_epoch().count()), key.player.first, key.player.second,
+			static_cast<std::uint64_t>(cur_config.svg_row_paths), static_cast<std::uint64_t>(cur_config.png_compression_level), cur_config.attachment_max_bytes,
+			detail::fnv1a(config.font_path), detail::fnv1a(config.graph_timezone->name()), static_cast<std::uint64_t>(render_surface_bytes) })
+			{ res = detail::hash_combine(res, n); }
+		return res;
 	};
 
-	std::uintmax_t prev_size = 0;
-	// parse latest.log initially
+	// render graph on the calling thread and add it to the view's graph cache
+	const auto render_graph = [&live_config, &graph_ctx, render_surface_bytes, graph_cache_online_max_age, &disk_graphs, &get_disk_graph_key](view_caches& cache,
+		const published_data_t& data, const graph_cache::key_t& key)
 	{
-		const bool latest_log_exists = std::filesystem::exists(latest_log);
-		const auto size = latest_log_exists ? std::filesystem::file_size(latest_log) : 0;
-		update_date_tp(latest_log_exists);
-		if (size > 0)
+		using namespace std::string_view_literals;
+		const auto cur_config = live_config.load();
+		// a graph without online players only depends on the sessions, so it may have been saved before a restart
+		std::optional<std::uint64_t> disk_key;
+		if (disk_graphs && get_num_players(data.ctx) == 0)
 		{
-			std::ifstream fin(latest_log, std::ios::binary);
-			std::string s;
-			s.resize_and_overwrite(size, [&fin](char* buf, std::size_t buf_size)
+			disk_key = get_disk_graph_key(data, key, *cur_config);
+			if (auto contents = disk_graphs->load(detail::hash_combine(disk_key.value(), static_cast<std::uint64_t>(key.size))))
 			{
-				fin.read(buf, buf_size);
-				return buf_size;
-			});
-			fin.close();
-			parse_lines(std::move(s), parse_ctx, parse_data);
+				cache.graphs.insert(key, contents, std::chrono::steady_clock::time_point::max());
+				return std::shared_ptr<const std::string>(std::move(contents));
+			}
 		}
-	}
-	update_player_count(bot, config, parse_ctx, last_player_count);
+		// every size of a png is made from one rasterization (the size in the key is only which one is returned)
+		std::vector<std::string> png_variants;
+		// a png's bars are the same in both themes, unless players are online and the graph changes with the time it is rendered at
+		std::uint64_t layer_key = 0;
+		if (!key.svg && get_num_players(data.ctx) == 0)
+		{
+			layer_key = detail::hash_combine(reinterpret_cast<std::uintptr_t>(&cache), key.generation);
+			for (const std::uint64_t n : { static_cast<std::uint64_t>(key.type), static_cast<std::uint64_t>(key.row_limit),
+				static_cast<std::uint64_t>(key.range.begin.time_since_epoch().count()), static_cast<std::uint64_t>(key.range.end.time_since_epoch().count()),
+				key.player.first, key.player.second })
+				{ layer_key = detail::hash_combine(layer_key, n); }
+		}
+		const graph_options options = {
+			// white text for darkmode and dark text otherwise. an svg has both, chosen by the viewer's color scheme, so one serves both themes
+			.color = detail::adaptive_color,
+			.theme_color = key.dark ? "white"sv : "black"sv,
+			.row_paths = cur_config->svg_row_paths,
+			.png_compression_level = cur_config->png_compression_level,
+			.render_ctx = &graph_ctx,
+			.row_limit = key.row_limit,
+			.range = key.range,
+			.png_max_bytes = static_cast<std::size_t>(cur_config->attachment_max_bytes),
+			.png_max_surface_bytes = render_surface_bytes,
+			.png_variants = key.svg ? nullptr : &png_variants,
+			.layer_key = layer_key
+		};
+		log_message(log_severity::info, std::format("Creating graph in {} format", key.svg ? "svg"sv : "png"sv));
+		QC_TRACE_SCOPE("render_graph", key.svg ? "svg" : "png");
+		QC_ALLOCATION_SCOPE(render, 1);
+		const metrics_histogram::timer timer(key.svg ? get_metrics().render_svg : get_metrics().render_png);
+		std::string file_contents = render_graph_file(data, key, options);
+		log_message(log_severity::info, "Finished creating graph");
+		// online players' sessions end at the time the graph was created, so it goes out of date without the data changing
+		const auto expiry = (get_num_players(data.ctx) == 0) ? std::chrono::steady_clock::time_point::max() :
+			std::chrono::steady_clock::now() + graph_cache_online_max_age;
+		auto contents = std::make_shared<const std::string>(std::move(file_contents));
+		std::shared_ptr<const std::string> res = contents;
+		graph_cache::key_t size_key = key;
+		size_key.size = graph_size::full;
+		cache.graphs.insert(size_key, contents, expiry);
+		if (disk_key)
+			{ disk_graphs->store(detail::hash_combine(disk_key.value(), static_cast<std::uint64_t>(graph_size::full)), *contents); }
+		// without variants (e.g. the png was too large and is an svg), every size is the full one
+		for (std::size_t i = 0; i < png_variants.size(); i++)
+		{
+			size_key.size = static_cast<graph_size>(i + 1);
+			auto variant = std::make_shared<const std::string>(std::move(png_variants[i]));
+			if (size_key.size == key.size)
+				{ res = variant; }
+			if (disk_key)
+				{ disk_graphs->store(detail::hash_combine(disk_key.value(), static_cast<std::uint64_t>(size_key.size)), *variant); }
+			cache.graphs.insert(size_key, std::move(variant), expiry);
+		}
+		return res;
+	};
+	// quick version of a large png playtime graph, shown while the full one renders: only the top `rows` players at 1x, compressed less.
+	// not cached, since it isn't the graph of any key
+	const auto render_preview = [&live_config, &graph_ctx, render_surface_bytes](const published_data_t& data, const graph_cache::key_t& key, std::size_t rows)
+	{
+		using namespace std::string_view_literals;
+		const auto cur_config = live_config.load();
+		const graph_options options = {
+			.color = detail::adaptive_color,
+			.theme_color = key.dark ? "white"sv : "black"sv,
+			.png_compression_level = std::min(cur_config->png_compression_level, 1),
+			.render_ctx = &graph_ctx,
+			.row_limit = rows,
+			.range = key.range,
+			.png_max_bytes = static_cast<std::size_t>(cur_config->attachment_max_bytes),
+			.png_max_surface_bytes = render_surface_bytes,
+			.png_scale = 1
+		};
+		QC_TRACE_SCOPE("render_preview");
+		return create_graph<false, true>(data.history, data.recent, data.ctx, options);
+	};
+
+	// the default graphs are rendered in the background a while after players join/leave, so most commands are cache hits
+	// only done if someone used /graph recently, and limited to a fraction of a thread
+	std::atomic<std::chrono::steady_clock::time_point> last_graph_command_tp = std::chrono::steady_clock::time_point::min();
+	std::atomic<std::chrono::steady_clock::time_point> prerender_next_allowed_tp = std::chrono::steady_clock::time_point::min();
+	constexpr auto prerender_delay = std::chrono::seconds(30);  // after the last join/leave
+	constexpr auto prerender_max_idle = std::chrono::hours(1);  // since the last /graph
+	constexpr int prerender_cpu_percent = 10;
 
-	std::cout << "INFO: Finished initial parse" << std::endl;
-	parse_data_ctx_mutex.unlock();
+	// started once the bot is (declared before graph_renderer, so digests still being made when it's destroyed can be handed to it)
+	std::optional<digest_poster> digests;
+	// graphs are rendered here instead of in the slash command handler so dpp's event threads stay free
+	// (declared after everything jobs use, so it's destroyed first)
+	// each render thread loads the glyphs graphs use before taking jobs, so the first /graph isn't slower than the rest
+	render_executor graph_renderer(config.render_threads, 8, []()
+	{
+		detail::enter_render_thread();
+		constexpr std::array<float, 2> font_sizes = { static_cast<float>(svg_fontsize), static_cast<float>(svg_date_fontsize) };
+		detail::text_metrics::get().warm(font_sizes);
+	});
+	// interaction tokens are valid for 15 minutes, leave some time to upload the result
+	constexpr auto graph_deadline = std::chrono::minutes(14);
 
-	while (true)
+	// commands are scheduled by cost, so cheap ones never wait behind expensive ones:
+	// - answered on the shard's event thread: /players and /debug, which only read the published data
+	// - query_lane: commands that may scan all history (/leaderboard, /online_at and /friends build an index the first time after it
+	//   changes). dpp handles a shard's events on one thread, so these would hold up every other command and the gateway
+	// - graph_renderer: renders and exports, which take seconds, with a bounded queue
+	render_executor query_lane(1, 16);
+	// queries aren't deferred (see dpp::interaction_create_t::thinking), so they must be answered within discord's 3 seconds
+	constexpr auto query_deadline = std::chrono::milliseconds(2500);
+	// run `func` on query_lane
+	// @return its result, or empty if the queue is full or its deadline passed before it started
+	const auto run_query = [&query_lane, query_deadline](auto func)
+	{
+		using result_t = std::optional<std::invoke_result_t<decltype(func)>>;
+		return dpp::async<result_t>([&query_lane, query_deadline, func = std::move(func)](auto&& callback)
+		{
+			const bool queued = query_lane.submit(std::chrono::steady_clock::now() + query_deadline, [func, callback](bool expired)
+				{ callback(expired ? result_t() : result_t(func())); });
+			if (!queued)
+				{ callback(result_t()); }
+		});
+	};
+	constexpr std::string_view queries_busy_message = "Too many commands are running, please try again soon";
+	
+	bot.on_autocomplete([&bot, &caches, &get_view_data, &get_view](const dpp::autocomplete_t& event)
 	{
-		auto res = watcher.poll();
-		if (!res)
+		// completes names of players of the server chosen so far
+		dpp::command_value server_param;
+		for (const dpp::command_option& option : event.options)
 		{
-			// TODO: handle error (close and reopen watcher?)
-			std::cerr << "FATAL ERROR: Could not poll for changes in directory" << std::endl;
-			return -1;
+			if (option.name == "server")
+				{ server_param = option.value; }
 		}
-		if (res->state == file_watcher_state_t::data_read)
+		const std::size_t view = get_view(server_param);
+		const std::shared_ptr<const published_data_t> data = get_view_data(view);
+		for (const dpp::command_option& option : event.options)
 		{
-			if (res->event_create)
+			if (!option.focused || option.name != "player")
+				{ continue; }
+			dpp::interaction_response response(dpp::ir_autocomplete_reply);
+			if (data)
 			{
-				update_date_tp(std::filesystem::exists(latest_log));
-				prev_size = 0;
+				const std::string* prefix_ptr = std::get_if<std::string>(&option.value);
+				const auto segments = data->history.get_segments();
+				const auto completions = caches[view].completions.get(segments, [segments]() { return name_completions(segments); });
+				for (const std::string& name : completions->complete((prefix_ptr == nullptr) ? std::string_view() : *prefix_ptr, data->recent))
+					{ response.add_autocomplete_choice(dpp::command_option_choice(name, name)); }
 			}
+			bot.interaction_response_create(event.command.id, event.command.token, response);
+		}
+	});
 
-			if (res->event_create_moved)
+	// the from and to options of a command, which are inclusive dates in the graph's time zone
+	// @return range from the start of the first date to the end of the last, and a message for the user if they are invalid
+	const auto get_range = [&config](const dpp::slashcommand_t& event) -> std::pair<time_range, std::string_view>
+	{
+		const auto from_param = event.get_parameter("from");
+		const auto to_param = event.get_parameter("to");
+		const std::string* from_ptr = std::get_if<std::string>(&from_param);
+		const std::string* to_ptr = std::get_if<std::string>(&to_param);
+		if (from_ptr == nullptr && to_ptr == nullptr)
+			{ return {}; }
+		const auto from = (from_ptr == nullptr) ? std::nullopt : parse_date(*from_ptr);
+		const auto to = (to_ptr == nullptr) ? std::nullopt : parse_date(*to_ptr);
+		if ((from_ptr != nullptr && !from) || (to_ptr != nullptr && !to))
+			{ return { time_range(), "Dates must be in the format yyyy-mm-dd" }; }
+		if (from && to && from.value() > to.value())
+			{ return { time_range(), "The first date must not be after the last date" }; }
+		return { days_range(from, to, config.graph_timezone), {} };
+	};
+
+	// @param load_archives  whether to parse the archives of a time before the retention period again (see archive_range_cache)
+	// @return players online in `data` at `time` (see online_index), or a message for the user if history doesn't know,
+	//         and the archived sessions the names of the players are in, if they were from archives
+	const auto get_online_at = [&config, &caches, &shards, merged_view_index](std::size_t view, const published_data_t& data, std::chrono::system_clock::time_point time,
+		bool load_archives) -> std::tuple<std::vector<online_at_entry>, std::string, std::shared_ptr<const online_index>>
+	{
+		const auto now = std::chrono::system_clock::now();
+		if (time > now)
+			{ return { {}, "That time is in the future", nullptr }; }
+		// rolled up sessions start at midnight, so they don't say when players were online, but the archives of the time do
+		if (config.retention_days != 0)
+		{
+			const auto today = std::chrono::floor<std::chrono::days>(config.graph_timezone->to_local(now));
+			const auto cutoff = config.graph_timezone->to_sys(today - std::chrono::days(config.retention_days), std::chrono::choose::earliest);
+			if (time < cutoff)
+			{
+				const std::string error = std::format("Only playtime per day is kept for sessions older than {} days", config.retention_days);
+				if (!load_archives)
+					{ return { {}, error, nullptr }; }
+				std::vector<std::shared_ptr<const session_store>> archived;
+				time_range range;
+				range.begin = time;
+				range.end = time + std::chrono::seconds(1);
+				for (std::size_t i = 0; i < shards.size(); i++)
+				{
+					if (view != merged_view_index && view != i)
+						{ continue; }
+					if (auto sessions = shards[i]->archive_ranges.get(range, data.history.get_segments()))
+						{ archived.push_back(std::move(sessions)); }
+				}
+				if (archived.empty())
+					{ return { {}, error, nullptr }; }
+				auto index = std::make_shared<const online_index>(archived);
+				return { index->online_at(time, log_data_t(), parse_ctx_t(), now), {}, index };
+			}
+		}
+		const auto segments = data.history.get_segments();
+		const auto index = caches[view].online.get(segments, [segments]() { return online_index(segments); });
+		return { index->online_at(time, data.recent, data.ctx, now), {}, nullptr };
+	};
+
+	bot.on_slashcommand([&](const dpp::slashcommand_t& event) -> dpp::task<void>
+	{
+		using namespace std::string_view_literals;
+		const auto cmd_name = event.command.get_command_name();
+		// also finds the option in a subcommand (/debug memory)
+		const std::size_t view = get_view(event.get_parameter("server"));
+		view_caches& cache = caches[view];
+		const std::shared_ptr<const published_data_t> data = get_view_data(view);
+		if (!data)
+		{
+			event.reply(dpp::message("Logs are still being read, please try again soon").set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+		if (cmd_name == "graph"sv)
+		{
+			// playtime by default
+			const auto type_param = event.get_parameter("type");
+			const std::string* type_str_ptr = std::get_if<std::string>(&type_param);
+			const std::string_view type_str = (type_str_ptr == nullptr) ? "playtime"sv : *type_str_ptr;
+			graph_type type = parse_graph_type(type_str);
+
+			// a player's graph if one is given
+			const auto player_param = event.get_parameter("player");
+			const std::string* player_ptr = std::get_if<std::string>(&player_param);
+			uuid_t player{};
+			if (player_ptr != nullptr)
+			{
+				const auto uuid = find_player(data->history, data->recent, *player_ptr, graph_ctx);
+				if (!uuid)
+				{
+					event.reply(dpp::message(std::format("No player named {} has played", *player_ptr)).set_flags(dpp::m_ephemeral));
+					co_return;
+				}
+				type = graph_type::player;
+				player = uuid.value();
+			}
+
+			// format is png by default
+			const auto format_param = event.get_parameter("format");
+			const std::string* format_str_ptr = std::get_if<std::string>(&format_param);
+			const std::string_view format = (format_str_ptr == nullptr) ? "png"sv : *format_str_ptr;
+
+			const auto dark_param = event.get_parameter("dark");
+			const bool* dark_ptr = std::get_if<bool>(&dark_param);
+			const bool dark = (dark_ptr != nullptr && *dark_ptr);
+
+			const auto limit_param = event.get_parameter("limit");
+			const std::int64_t* limit_ptr = std::get_if<std::int64_t>(&limit_param);
+			// only playtime graphs have rows, so other graphs don't have a cache entry for each limit
+			const std::size_t row_limit = (type != graph_type::playtime) ? 0 : (limit_ptr == nullptr) ? live_config.load()->graph_row_limit : static_cast<std::size_t>(*limit_ptr);
+
+			auto [range, range_error] = get_range(event);
+			if (!range_error.empty())
+			{
+				event.reply(dpp::message(std::string(range_error)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+
+			// heatmaps are of all data
+			if (type == graph_type::heatmap)
+				{ range = {}; }
+
+			const bool format_is_svg = (format == "svg"sv);
+			// @return filename and mime type of the rendered graph
+			const auto attachment_type = [](const std::string& contents)
+				{ return is_png(contents) ? std::pair("graph.png"sv, "image/png"sv) : std::pair("graph.svg"sv, "image/svg+xml"sv); };
+
+			last_graph_command_tp = std::chrono::steady_clock::now();
+			// an svg is the same for both themes (see render_graph)
+			const graph_cache::key_t cache_key{ data->generation, type, format_is_svg, dark && !format_is_svg, row_limit, range, player };
+			const auto cached = cache.graphs.find(cache_key);
+			(cached ? get_metrics().graph_cache_hits : get_metrics().graph_cache_misses).add();
+			if (cached)
+			{
+				// a png that was already uploaded is linked to instead of being uploaded again (discord doesn't show svg in embeds)
+				if (const std::string url = format_is_svg ? std::string() : cache.graphs.find_url(cache_key); !url.empty())
+					{ event.reply(dpp::message(data->loading_note()).add_embed(dpp::embed().set_image(url))); }
+				else
+				{
+					const auto [filename, file_mime_type] = attachment_type(*cached);
+					event.reply(dpp::message(data->loading_note()).add_file(filename, *cached, file_mime_type));
+				}
+				co_return;
+			}
+
+			// rate limit (only graphs that need to be rendered count, identical commands wait for the render already running)
+			if (!cache.graphs.rendering(cache_key))
+			{
+				// a playtime graph takes longer the more rows it has (the history's largest segment is a lower bound of the players it has)
+				std::size_t rows = row_limit;
+				if (type == graph_type::playtime && rows == 0)
+				{
+					for (const auto& segment : data->history.get_segments())
+						{ rows = std::max(rows, segment->size()); }
+				}
+				const double cost = std::min(user_burst, 1 + static_cast<double>(rows) / 500);
+				if (const auto wait = take_command_tokens(event, cost); wait.count() != 0)
+				{
+					reply_rate_limited(event, wait);
+					co_return;
+				}
+			}
+
+			// TODO: set last date to current time instead of last player time
+			bool queued = true;
+			bool joined = false;
+			// result is null if the deadline passed before the render started, or the render being waited for wasn't queued
+			dpp::async<std::shared_ptr<const std::string>> render([&](auto&& callback)
+			{
+				const graph_request request = request_graph(cache.graphs, graph_renderer, std::chrono::steady_clock::now() + graph_deadline, cache_key,
+					[&render_graph, &cache, data, cache_key]() { return render_graph(cache, *data, cache_key); }, callback);
+				joined = (request == graph_request::joined);
+				queued = (request != graph_request::busy);
+			});
+			if (!queued)
+			{
+				event.reply(dpp::message("Too many graphs are being generated, please try again soon").set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			// a graph with many rows takes a while at full size, so a preview of its top rows is shown until it's ready
+			// (the history's largest segment is a lower bound of the players it has)
+			const std::size_t preview_rows = live_config.load()->graph_preview_rows;
+			const auto has_more_players = [&data](std::size_t rows)
+			{
+				return std::ranges::any_of(data->history.get_segments(), [rows](const auto& segment) { return segment->size() > rows; });
+			};
+			std::optional<dpp::async<std::shared_ptr<const std::string>>> preview;
+			if (!joined && !format_is_svg && type == graph_type::playtime && preview_rows != 0 && (row_limit == 0 || row_limit > preview_rows) &&
+				has_more_players(preview_rows))
+			{
+				// queued after the full render, so it never delays it. skipped if the queue is full
+				preview.emplace([&](auto&& callback)
+				{
+					const bool preview_queued = graph_renderer.submit(std::chrono::steady_clock::now() + graph_deadline,
+						[&render_preview, data, cache_key, preview_rows, callback](bool expired)
+						{ callback(expired ? nullptr : std::make_shared<const std::string>(render_preview(*data, cache_key, preview_rows))); });
+					if (!preview_queued)
+						{ callback(nullptr); }
+				});
+			}
+			// only deferred if the graph isn't done yet (it may have been nearly done when joined), replying directly saves a round trip
+			std::optional<dpp::async<dpp::confirmation_callback_t>> thinking;
+			if (preview || !render.await_ready())
+				{ thinking.emplace(event.co_thinking(false)); }
+			const bool deferred = thinking.has_value();
+			bool thinking_done = !deferred;
+			QC_TRACE_SCOPE("/graph after thinking");
+
+			if (preview)
+			{
+				const auto preview_contents = co_await *preview;
+				// not shown if the full graph is already done, or the preview became an svg
+				if (preview_contents && is_png(*preview_contents) && !render.await_ready())
+				{
+					co_await *thinking;
+					thinking_done = true;
+					std::string note = data->loading_note();
+					note += (note.empty() ? "" : "\n") + std::format("*Preview of the top {} players, the full graph is being generated*", preview_rows);
+					const dpp::confirmation_callback_t preview_res = co_await event.co_edit_original_response(
+						dpp::message(note).add_file("graph.png", *preview_contents, "image/png"));
+					if (preview_res.is_error())
+						{ log_message(log_severity::warning, std::format("Could not send graph preview: {}", preview_res.get_error().human_readable)); }
+				}
+			}
+			const auto file_contents = co_await render;
+			if (!thinking_done)
+				{ co_await *thinking; }
+			if (!file_contents)
+			{
+				if (joined)
+					{ co_await respond(event, deferred, dpp::message("Too many graphs are being generated, please try again soon")); }
+				else
+					{ log_message(log_severity::warning, "Graph was not generated before the interaction expired, discarding it"); }
+				co_return;
+			}
+			dpp::confirmation_callback_t res;
+			{
+				QC_TRACE_SCOPE("send graph");
+				const metrics_histogram::timer timer(get_metrics().discord_rest);
+				const auto [filename, file_mime_type] = attachment_type(*file_contents);
+				std::string note = data->loading_note();
+				if (!format_is_svg && !is_png(*file_contents))
+					{ note += (note.empty() ? "" : "\n") + std::string("The graph is too large for a png, so it is an svg"); }
+				res = co_await respond(event, deferred, dpp::message(note).add_file(filename, *file_contents, file_mime_type));
+			}
+			if (res.is_error())
+			{
+				log_message(log_severity::error, std::format("Could not send graph: {}", res.get_error().human_readable));
+				co_return;
+			}
+			// a reply's confirmation has no message, so its attachment is looked up after the user already has the graph
+			if (!deferred && is_png(*file_contents))
+			{
+				res = co_await event.co_get_original_response();
+				if (res.is_error())
+					{ co_return; }
+			}
+			// discord doesn't show svg in embeds, so only a png's url is reused
+			if (const auto& attachments = res.get<dpp::message>().attachments; !attachments.empty() && is_png(*file_contents))
+				{ cache.graphs.set_url(cache_key, attachments.front().url, get_attachment_url_expiry(attachments.front().url)); }
+		}
+		else if (cmd_name == "export"sv)
+		{
+			// csv by default
+			const auto format_param = event.get_parameter("format");
+			const std::string* format_str_ptr = std::get_if<std::string>(&format_param);
+			const export_format format = parse_export_format((format_str_ptr == nullptr) ? "csv"sv : *format_str_ptr).value_or(export_format::csv);
+			const auto [range, range_error] = get_range(event);
+			if (!range_error.empty())
+			{
+				event.reply(dpp::message(std::string(range_error)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			if (const auto wait = take_command_tokens(event, 1); wait.count() != 0)
+			{
+				reply_rate_limited(event, wait);
+				co_return;
+			}
+
+			// compressed file, or empty optional if the deadline passed before the export started
+			struct export_result
+			{
+				std::string file;
+				bool complete;  // false if it was too large to upload, or couldn't be made
+			};
+			// the file is uploaded, so it is only ever as large as discord allows
+			constexpr std::size_t max_export_size = 8 << 20;
+			bool queued = false;
+			// on a render thread like graphs, since years of sessions take a while
+			dpp::async<std::optional<export_result>> exported([&](auto&& callback)
+			{
+				queued = graph_renderer.submit(std::chrono::steady_clock::now() + graph_deadline, [data, format, range, callback](bool expired)
+				{
+					if (expired)
+					{
+						callback(std::nullopt);
+						return;
+					}
+					export_result res{ std::string(), false };
+					try
+					{
+						session_exporter exporter(format, [&res](std::string_view part)
+						{
+							res.file += part;
+							return res.file.size() <= max_export_size;
+						});
+						for (const auto& segment : data->history.get_segments())
+							{ exporter.add(*segment, range); }
+						exporter.add(data->recent, range);
+						res.complete = exporter.finish();
+					}
+					catch (const std::runtime_error& e)
+					{
+						log_message(log_severity::error, e.what());
+					}
+					if (!res.complete)
+						{ res.file = std::string(); }
+					callback(std::move(res));
+				});
+			});
+			if (!queued)
+			{
+				event.reply(dpp::message("Too many graphs are being generated, please try again soon").set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			// only deferred if the export isn't done yet, like graphs
+			std::optional<dpp::async<dpp::confirmation_callback_t>> thinking;
+			if (!exported.await_ready())
+				{ thinking.emplace(event.co_thinking(true)); }
+			const bool deferred = thinking.has_value();
+			// a deferred response is already ephemeral
+			const std::uint16_t flags = deferred ? 0 : dpp::m_ephemeral;
+			const std::optional<export_result> res = co_await exported;
+			if (thinking)
+				{ co_await *thinking; }
+			if (!res)
+			{
+				log_message(log_severity::warning, "Export was not made before the interaction expired, discarding it");
+				co_return;
+			}
+			if (!res->complete)
+			{
+				co_await respond(event, deferred, dpp::message(std::format("The export would be larger than {}, try fewer dates (from and to)",
+					format_bytes(max_export_size))).set_flags(flags));
+				co_return;
+			}
+			const auto sent = co_await respond(event, deferred, dpp::message(data->loading_note()).add_file(std::string(export_filename(format)), res->file,
+				std::string(export_content_type(format))).set_flags(flags));
+			if (sent.is_error())
+				{ log_message(log_severity::error, std::format("Could not send export: {}", sent.get_error().human_readable)); }
+		}
+		else if (cmd_name == "timelapse"sv)
+		{
+			const auto days_param = event.get_parameter("days");
+			const std::int64_t* days_ptr = std::get_if<std::int64_t>(&days_param);
+			const int num_days = (days_ptr == nullptr) ? 7 : static_cast<int>(std::clamp<std::int64_t>(*days_ptr, 1, 30));
+			const auto dark_param = event.get_parameter("dark");
+			const bool* dark_ptr = std::get_if<bool>(&dark_param);
+			const bool dark = (dark_ptr != nullptr && *dark_ptr);
+			// a frame is many times cheaper than a graph, but there are a lot of them
+			if (const auto wait = take_command_tokens(event, 2); wait.count() != 0)
+			{
+				reply_rate_limited(event, wait);
+				co_return;
+			}
+
+			const auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+			const time_range range{ now - std::chrono::days(num_days), now };
+			// whole hours, and no more frames than timelapse_max_frames
+			const auto step = std::chrono::ceil<std::chrono::hours>((range.end - range.begin + std::chrono::seconds(timelapse_max_frames - 1)) / timelapse_max_frames);
+			const std::shared_ptr<const config_t> cur_config = live_config.load();
+			const timelapse_options options{
+				.theme_color = dark ? "white"sv : "black"sv,
+				.png_compression_level = cur_config->png_compression_level,
+				.render_ctx = &graph_ctx,
+				.range = range,
+				.step = std::max<std::chrono::seconds>(step, std::chrono::hours(1)),
+				.max_bytes = static_cast<std::size_t>(cur_config->attachment_max_bytes),
+			};
+			bool queued = false;
+			// the animation, or empty optional if the deadline passed before it was started or it couldn't be made
+			dpp::async<std::optional<std::string>> rendered([&](auto&& callback)
+			{
+				queued = graph_renderer.submit(std::chrono::steady_clock::now() + graph_deadline, [&cache, &config, data, options, callback](bool expired)
+				{
+					if (expired)
+					{
+						callback(std::nullopt);
+						return;
+					}
+					try
+					{
+						const auto segments = data->history.get_segments();
+						const auto index = cache.presence.get(segments, [segments, &config]() { return presence_index(segments, config.graph_timezone); });
+						const presence_index::recent_t recent = index->get_recent(data->recent, data->ctx, std::chrono::system_clock::now());
+						callback(create_timelapse(data->history, data->recent, data->ctx, *index, recent, options));
+					}
+					catch (const std::runtime_error& e)
+					{
+						log_message(log_severity::error, e.what());
+						callback(std::nullopt);
+					}
+				});
+			});
+			if (!queued)
+			{
+				event.reply(dpp::message("Too many graphs are being generated, please try again soon").set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			std::optional<dpp::async<dpp::confirmation_callback_t>> thinking;
+			if (!rendered.await_ready())
+				{ thinking.emplace(event.co_thinking(false)); }
+			const bool deferred = thinking.has_value();
+			const std::optional<std::string> res = co_await rendered;
+			if (thinking)
+				{ co_await *thinking; }
+			if (!res)
+			{
+				co_await respond(event, deferred, dpp::message("Could not make the timelapse").set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			if (res->empty())
+			{
+				co_await respond(event, deferred, dpp::message(std::format("The timelapse would be larger than {}, try fewer days",
+					format_bytes(options.max_bytes))).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto sent = co_await respond(event, deferred, dpp::message(data->loading_note()).add_file("timelapse.png", res.value(), "image/png"));
+			if (sent.is_error())
+				{ log_message(log_severity::error, std::format("Could not send timelapse: {}", sent.get_error().human_readable)); }
+		}
+		else if (cmd_name == "leaderboard"sv)
+		{
+			constexpr std::size_t leaderboard_size = 10;
+			const auto period_param = event.get_parameter("period");
+			const std::string* period_ptr = std::get_if<std::string>(&period_param);
+			const std::string_view period = (period_ptr == nullptr) ? "all"sv : *period_ptr;
+			// days counted, including today. 0 for all time
+			const int num_days = parse_leaderboard_period(period);
+
+			const auto player_param = event.get_parameter("player");
+			const std::string* player_ptr = std::get_if<std::string>(&player_param);
+			std::optional<uuid_t> player;
+			if (player_ptr != nullptr)
+			{
+				player = find_player(data->history, data->recent, *player_ptr, graph_ctx);
+				if (!player)
+				{
+					event.reply(dpp::message(std::format("No player named {} has played", *player_ptr)).set_flags(dpp::m_ephemeral));
+					co_return;
+				}
+			}
+
+			const auto ranked = co_await run_query([&cache, &config, &graph_ctx, data, player, num_days]()
+				{ return query_leaderboard(cache, *data, config.graph_timezone, num_days, leaderboard_size, player, graph_ctx); });
+			if (!ranked)
+			{
+				event.reply(dpp::message(std::string(queries_busy_message)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto& [top, player_entry] = ranked.value();
+
+			const auto format_entry = [](const leaderboard_entry& entry)
+			{
+				return std::format("{}. {} ({:%H:%M:%S})", entry.rank, dpp::utility::markdown_escape(std::string(entry.name)),
+					std::chrono::round<std::chrono::seconds>(entry.total));
+			};
+			std::string msg = std::format("**Most playtime ({}):**", (num_days == 0) ? "all time"sv : (num_days == 1) ? "today"sv : (num_days == 7) ? "last 7 days"sv : "last 30 days"sv);
+			for (const leaderboard_entry& entry : top)
+				{ msg += "\n" + format_entry(entry); }
+			if (top.empty())
+				{ msg += "\nNobody has played"; }
+			if (player)
+			{
+				if (player_entry)
+					{ msg += "\n\n" + format_entry(player_entry.value()); }
+				else
+					{ msg += std::format("\n\n{} hasn't played", dpp::utility::markdown_escape(*player_ptr)); }
+			}
+			if (data->loading())
+				{ msg += "\n\n" + data->loading_note(); }
+			event.reply(dpp::message(msg));
+		}
+		else if (cmd_name == "online_at"sv)
+		{
+			const auto time = parse_date_time(std::get<std::string>(event.get_parameter("time")), config.graph_timezone);
+			if (!time)
+			{
+				event.reply(dpp::message("The time must be in the format yyyy-mm-dd hh:mm, or a unix timestamp").set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto online = co_await run_query([&get_online_at, data, view, time]() { return get_online_at(view, *data, time.value(), true); });
+			if (!online)
+			{
+				event.reply(dpp::message(std::string(queries_busy_message)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto& [players, error, archived] = online.value();
+			if (!error.empty())
+			{
+				event.reply(dpp::message(error).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+
+			// discord shows timestamps in the reader's time zone
+			const auto seconds = [](std::chrono::system_clock::time_point tp) { return std::chrono::floor<std::chrono::seconds>(tp.time_since_epoch()).count(); };
+			std::string msg = std::format("**{} players online at <t:{}:f>:**", players.size(), seconds(time.value()));
+			if (players.empty())
+				{ msg = std::format("Nobody was online at <t:{}:f>", seconds(time.value())); }
+			constexpr std::size_t max_message_size = 2000;  // discord's limit for message content
+			for (std::size_t i = 0; i < players.size(); i++)
+			{
+				const online_at_entry& entry = players[i];
+				const std::string line = entry.online ? std::format("\n{} (since <t:{}:t>, still online)", dpp::utility::markdown_escape(std::string(entry.name)),
+					seconds(entry.session.first)) : std::format("\n{} (<t:{}:t> to <t:{}:t>)", dpp::utility::markdown_escape(std::string(entry.name)),
+					seconds(entry.session.first), seconds(entry.session.first + entry.session.second));
+				// room for the players that don't fit
+				if (msg.size() + line.size() + 32 > max_message_size)
+				{
+					msg += std::format("\nand {} more", players.size() - i);
+					break;
+				}
+				msg += line;
+			}
+			if (data->loading())
+				{ msg += "\n\n" + data->loading_note(); }
+			// names are from the logs, so they mustn't ping anyone
+			event.reply(dpp::message(msg).set_allowed_mentions());
+		}
+		else if (cmd_name == "friends"sv)
+		{
+			constexpr std::size_t num_friends = 10;
+			const std::string& player_name = std::get<std::string>(event.get_parameter("player"));
+			const auto player = find_player(data->history, data->recent, player_name, graph_ctx);
+			if (!player)
+			{
+				event.reply(dpp::message(std::format("No player named {} has played", player_name)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto found = co_await run_query([&cache, &config, data, player]()
+			{
+				const auto now = std::chrono::system_clock::now();
+				// rolled up sessions all start at midnight, so everyone would seem to play together then
+				std::chrono::system_clock::time_point since = std::chrono::system_clock::time_point::min();
+				if (config.retention_days != 0)
+				{
+					const auto today = std::chrono::floor<std::chrono::days>(config.graph_timezone->to_local(now));
+					since = config.graph_timezone->to_sys(today - std::chrono::days(config.retention_days), std::chrono::choose::earliest);
+				}
+				const auto segments = data->history.get_segments();
+				const auto index = cache.coplay.get(segments, [segments, since]() { return coplay_index(segments, since); });
+				return index->partners(player.value(), num_friends, data->recent, data->ctx, now);
+			});
+			if (!found)
+			{
+				event.reply(dpp::message(std::string(queries_busy_message)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto& partners = found.value();
+
+			std::string msg = std::format("**Played the most with {}", dpp::utility::markdown_escape(player_name));
+			if (config.retention_days != 0)
+				{ msg += std::format(" (last {} days)", config.retention_days); }
+			msg += ":**";
+			for (std::size_t i = 0; i < partners.size(); i++)
+			{
+				msg += std::format("\n{}. {} ({:%H:%M} together)", i + 1, dpp::utility::markdown_escape(std::string(partners[i].name)),
+					partners[i].together);
+			}
+			if (partners.empty())
+				{ msg += "\nNobody was online at the same time"; }
+			if (data->loading())
+				{ msg += "\n\n" + data->loading_note(); }
+			event.reply(dpp::message(msg).set_allowed_mentions());
+		}
+		else if (cmd_name == "seen"sv)
+		{
+			// answered directly, the index is only made again when history is committed to
+			const std::string& player_name = std::get<std::string>(event.get_parameter("player"));
+			const auto seen = find_last_seen(cache, *data, player_name);
+			if (!seen)
+			{
+				event.reply(dpp::message(std::format("No player named {} has played", player_name)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto seconds = std::chrono::floor<std::chrono::seconds>(seen->time.time_since_epoch()).count();
+			const std::string name = dpp::utility::markdown_escape(player_name);
+			std::string msg = seen->online ? std::format("{} is online (joined <t:{}:R>)", name, seconds) :
+				std::format("{} was last seen <t:{}:R> (<t:{}:f>)", name, seconds, seconds);
+			if (data->loading())
+				{ msg += "\n\n" + data->loading_note(); }
+			// names are from the logs, so they mustn't ping anyone
+			event.reply(dpp::message(msg).set_allowed_mentions());
+		}
+		else if (cmd_name == "recent"sv)
+		{
+			// answered directly from the servers' rings of recent events (see recent_event_ring), which are read without waiting for the log reading loops
+			const auto minutes_param = event.get_parameter("minutes");
+			const std::int64_t* minutes_ptr = std::get_if<std::int64_t>(&minutes_param);
+			const std::int64_t minutes = (minutes_ptr == nullptr) ? 60 : *minutes_ptr;
+			const auto since = std::chrono::system_clock::now() - std::chrono::minutes(minutes);
+			std::vector<std::vector<recent_event>> server_events;
+			std::vector<std::string_view> server_names;
+			bool truncated = false;  // a ring was full, so events older than its oldest one may be missing
+			for (std::size_t i = 0; i < shards.size(); i++)
+			{
+				if (view != merged_view_index && view != i)
+					{ continue; }
+				server_events.push_back(shards[i]->recent_events.read(since));
+				server_names.push_back(shards[i]->config.name);
+				truncated = truncated || server_events.back().size() == recent_event_ring::capacity;
+			}
+			// each ring is newest first, so the servers' events are merged the same way
+			std::vector<std::span<const recent_event>> runs(server_events.begin(), server_events.end());
+			kway_merge events(runs, std::ranges::greater(), &recent_event::time);
+
+			const auto seconds = [](std::chrono::system_clock::time_point tp) { return std::chrono::floor<std::chrono::seconds>(tp.time_since_epoch()).count(); };
+			std::size_t num_events = 0;
+			for (const auto& cur : server_events)
+				{ num_events += cur.size(); }
+			std::string msg = std::format("**Joins and leaves in the last {} minutes:**", minutes);
+			if (num_events == 0)
+				{ msg = std::format("Nobody joined or left in the last {} minutes", minutes); }
+			constexpr std::size_t max_message_size = 2000;  // discord's limit for message content
+			for (std::size_t i = 0; !events.empty(); i++, events.pop())
+			{
+				const recent_event& cur = events.top();
+				const std::string server = (view == merged_view_index) ? std::format("[{}] ", dpp::utility::markdown_escape(std::string(server_names[events.top_run()]))) : "";
+				const std::string name = dpp::utility::markdown_escape(std::string(cur.name()));
+				const std::string what = (cur.type == log_event_type::join) ? name + " joined" : (cur.type == log_event_type::leave) ? name + " left" :
+					(cur.type == log_event_type::server_start) ? "Server started" : "Server stopped";
+				const std::string line = std::format("\n<t:{}:T> {}{}", seconds(cur.time), server, what);
+				// room for the events that don't fit
+				if (msg.size() + line.size() + 32 > max_message_size)
+				{
+					msg += std::format("\nand {} more", num_events - i);
+					break;
+				}
+				msg += line;
+			}
+			if (truncated)
+				{ msg += std::format("\n\nOnly the last {} events of each server are kept", recent_event_ring::capacity); }
+			// names are from the logs, so they mustn't ping anyone
+			event.reply(dpp::message(msg).set_allowed_mentions());
+		}
+		else if (cmd_name == "stats"sv)
+		{
+			auto [range, range_error] = get_range(event);
+			if (!range_error.empty())
+			{
+				event.reply(dpp::message(std::string(range_error)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto player_param = event.get_parameter("player");
+			const std::string* player_ptr = std::get_if<std::string>(&player_param);
+			std::optional<uuid_t> player;
+			if (player_ptr != nullptr)
+			{
+				player = find_player(data->history, data->recent, *player_ptr, graph_ctx);
+				if (!player)
+				{
+					event.reply(dpp::message(std::format("No player named {} has played", *player_ptr)).set_flags(dpp::m_ephemeral));
+					co_return;
+				}
+			}
+			// rolled up sessions are playtime per day, not sessions
+			if (config.retention_days != 0)
+			{
+				const auto today = std::chrono::floor<std::chrono::days>(config.graph_timezone->to_local(std::chrono::system_clock::now()));
+				range.begin = std::max(range.begin, std::chrono::system_clock::time_point(
+					config.graph_timezone->to_sys(today - std::chrono::days(config.retention_days), std::chrono::choose::earliest)));
+			}
+
+			const auto lengths = co_await run_query([&cache, &config, data, range, player]()
+				{ return query_session_lengths(cache, *data, config.graph_timezone, range, player); });
+			if (!lengths)
+			{
+				event.reply(dpp::message(std::string(queries_busy_message)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto format_stats = [](const session_length_stats& stats, const session_aggregate& totals)
+			{
+				if (stats.sessions == 0)
+					{ return std::string("no sessions"); }
+				return std::format("{} {}, median {:%H:%M}, 90th percentile {:%H:%M}, longest {:%H:%M}, {:%H:%M:%S} in total", stats.sessions,
+					(stats.sessions == 1) ? "session" : "sessions", stats.median, stats.p90, std::chrono::seconds(totals.max_seconds),
+					std::chrono::seconds(totals.total_seconds));
+			};
+
+			std::string msg = "**Session lengths";
+			if (config.retention_days != 0)
+				{ msg += std::format(" (last {} days at most)", config.retention_days); }
+			msg += std::format(":**\nEveryone: {}", format_stats(lengths->everyone, lengths->everyone_totals));
+			if (lengths->player)
+				{ msg += std::format("\n{}: {}", dpp::utility::markdown_escape(*player_ptr), format_stats(lengths->player.value(), lengths->player_totals.value())); }
+			if (data->loading())
+				{ msg += "\n\n" + data->loading_note(); }
+			// names are from the logs, so they mustn't ping anyone
+			event.reply(dpp::message(msg).set_allowed_mentions());
+		}
+		else if (cmd_name == "active"sv)
+		{
+			const auto player_param = event.get_parameter("player");
+			const std::string* player_ptr = std::get_if<std::string>(&player_param);
+			std::optional<uuid_t> player;
+			if (player_ptr != nullptr)
+			{
+				player = find_player(data->history, data->recent, *player_ptr, graph_ctx);
+				if (!player)
+				{
+					event.reply(dpp::message(std::format("No player named {} has played", *player_ptr)).set_flags(dpp::m_ephemeral));
+					co_return;
+				}
+			}
+
+			// counts of players who played today, in the last 7 and 30 days, and on every one of the last 7 days, and the player's streak
+			const auto counted = co_await run_query([&cache, &config, data, player]()
+			{
+				const auto now = std::chrono::system_clock::now();
+				const auto today = std::chrono::floor<std::chrono::days>(config.graph_timezone->to_local(now));
+				const auto segments = data->history.get_segments();
+				const auto index = cache.presence.get(segments, [segments, &config]() { return presence_index(segments, config.graph_timezone); });
+				const presence_index::recent_t recent = index->get_recent(data->recent, data->ctx, now);
+				const auto last_days = [&](int num_days) { return index->any_day(today - std::chrono::days(num_days - 1), today, recent).size(); };
+				std::array<std::size_t, 4> counts = { last_days(1), last_days(7), last_days(30),
+					index->every_day(today - std::chrono::days(6), today, recent).size() };
+				std::size_t streak = 0;
+				if (const auto id = player ? index->find(player.value(), recent) : std::nullopt)
+				{
+					// a streak isn't over until a day is missed, so one that ended yesterday still counts if the player hasn't played yet today
+					streak = index->streak(id.value(), today, recent);
+					if (streak == 0)
+						{ streak = index->streak(id.value(), today - std::chrono::days(1), recent); }
+				}
+				return std::pair(counts, streak);
+			});
+			if (!counted)
+			{
+				event.reply(dpp::message(std::string(queries_busy_message)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			const auto& [counts, streak] = counted.value();
+
+			std::string msg = std::format("**Players who played:**\nToday: {}\nLast 7 days: {}\nLast 30 days: {}\nEvery day of the last 7 days: {}",
+				counts[0], counts[1], counts[2], counts[3]);
+			if (player)
+			{
+				const std::string name = dpp::utility::markdown_escape(*player_ptr);
+				if (streak == 0)
+					{ msg += std::format("\n\n{} didn't play today or yesterday", name); }
+				else
+					{ msg += std::format("\n\n{} has played {} {} in a row", name, streak, (streak == 1) ? "day" : "days"); }
+			}
+			if (data->loading())
+				{ msg += "\n\n" + data->loading_note(); }
+			// names are from the logs, so they mustn't ping anyone
+			event.reply(dpp::message(msg).set_allowed_mentions());
+		}
+		else if (cmd_name == "retention"sv)
+		{
+			const auto months_param = event.get_parameter("months");
+			const std::int64_t* months_ptr = std::get_if<std::int64_t>(&months_param);
+			const int num_months = (months_ptr == nullptr) ? 6 : static_cast<int>(std::clamp<std::int64_t>(*months_ptr, 1, 12));
+
+			const auto table = co_await run_query([&cache, &config, data, num_months]()
+			{
+				const auto now = std::chrono::system_clock::now();
+				const std::chrono::year_month_day today(std::chrono::floor<std::chrono::days>(config.graph_timezone->to_local(now)));
+				const std::chrono::year_month this_month = today.year() / today.month();
+				const auto segments = data->history.get_segments();
+				const auto index = cache.presence.get(segments, [segments, &config]() { return presence_index(segments, config.graph_timezone); });
+				const presence_index::recent_t recent = index->get_recent(data->recent, data->ctx, now);
+				return format_retention(index->retention(this_month - std::chrono::months(num_months - 1), this_month, std::chrono::local_days(today), recent));
+			});
+			if (!table)
+			{
+				event.reply(dpp::message(std::string(queries_busy_message)).set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+			std::string msg = std::format("**Players still playing, by the month they first joined:**\n```\n{}\n```\n"
+				"+n is the share of them who played n months after joining", table.value());
+			if (data->loading())
+				{ msg += "\n\n" + data->loading_note(); }
+			event.reply(dpp::message(msg));
+		}
+		else if (cmd_name == "uptime"sv)
+		{
+			// answered directly, since how long a server was up in a range takes a few binary searches (see get_uptime)
+			const auto days_param = event.get_parameter("days");
+			const std::int64_t* days_ptr = std::get_if<std::int64_t>(&days_param);
+			const std::int64_t num_days = (days_ptr == nullptr) ? 30 : std::clamp<std::int64_t>(*days_ptr, 1, 3650);
+			const auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+			const time_range range{ now - std::chrono::days(num_days), now };
+			const auto seconds = [](std::chrono::system_clock::time_point tp) { return std::chrono::floor<std::chrono::seconds>(tp.time_since_epoch()).count(); };
+			std::string msg = std::format("**Server uptime in the last {} {}:**", num_days, (num_days == 1) ? "day" : "days");
+			// each server was up at different times, so all of them are shown one by one
+			for (std::size_t i = 0; i < shards.size(); i++)
+			{
+				if (view != merged_view_index && view != i)
+					{ continue; }
+				if (view == merged_view_index)
+					{ msg += std::format("\n\n**{}**", dpp::utility::markdown_escape(shards[i]->config.name)); }
+				const std::shared_ptr<const published_data_t> server_data = (view == i) ? data : get_view_data(i);
+				const uptime_summary summary = server_data ? get_uptime(server_data->uptime, range, now) : uptime_summary();
+				if (summary.up + summary.down == std::chrono::seconds::zero())
+				{
+					msg += "\nNot seen running yet";
+					continue;
+				}
+				msg += std::format("\nUp {:.2f}% of the time ({} up, {} down)", 100 * summary.availability(), format_duration(summary.up), format_duration(summary.down));
+				if (summary.known.begin > range.begin)
+					{ msg += std::format(", since it was first seen running <t:{}:f>", seconds(summary.known.begin)); }
+				msg += std::format("\nStarted {} {}, crashed {} {}\nLongest without going down: {}", summary.starts, (summary.starts == 1) ? "time" : "times",
+					summary.crashes, (summary.crashes == 1) ? "time" : "times", format_duration(summary.longest));
+			}
+			if (data->loading())
+				{ msg += "\n\n" + data->loading_note(); }
+			event.reply(dpp::message(msg));
+		}
+		else if (cmd_name == "players"sv)
+		{
+			// answered directly, since it only reads the published data
+			event.reply(dpp::message(players_message(*data)));
+		}
+		else if (cmd_name == "debug"sv)
+		{
+#ifdef QC_TRACING
+			if (const auto& options = event.command.get_command_interaction().options; !options.empty() && options.front().name == "trace")
+			{
+				event.reply(dpp::message("Recent spans (open in chrome://tracing or ui.perfetto.dev)").add_file("trace.json", get_chrome_trace(), "application/json")
+					.set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+#endif
+#ifdef SAMPLING_PROFILER_AVAILABLE
+			if (const auto& options = event.command.get_command_interaction().options; !options.empty() && options.front().name == "profile")
+			{
+				const auto seconds_param = event.get_parameter("seconds");
+				const std::int64_t* seconds_ptr = std::get_if<std::int64_t>(&seconds_param);
+				const std::int64_t seconds = std::clamp<std::int64_t>((seconds_ptr == nullptr) ? 10 : *seconds_ptr, 1, 60);
+				co_await event.co_thinking(true);
+				// sampled on a thread of its own, so it doesn't hold up one of dpp's threads for the whole time
+				std::thread([event, seconds]()
+				{
+					const auto res = detail::sampling_profiler::get().profile(std::chrono::seconds(seconds));
+					if (!res)
+					{
+						event.edit_original_response(dpp::message("Another profile is running, try again once it's done"));
+						return;
+					}
+					std::string msg = std::format("{} samples over {} s (open in speedscope.app, or make a flame graph with flamegraph.pl)", res->samples, seconds);
+					if (res->dropped != 0)
+						{ msg += std::format(", {} samples dropped", res->dropped); }
+					event.edit_original_response(dpp::message(msg).add_file("profile.folded", res->folded, "text/plain"));
+				}).detach();
+				co_return;
+			}
+#endif
+			// memory, estimated from the published copy of the data, which shares history with the log reading loop but has its own copy of the rest
+			const memory_usage history_memory = data->history.memory_used(), recent_memory = memory_used(data->recent), ctx_memory = memory_used(data->ctx),
+				graphs_memory = cache.graphs.memory_used();
+			const memory_usage dpp_memory{ .bytes = get_dpp_cache_bytes(dpp::get_user_cache()) + get_dpp_cache_bytes(dpp::get_guild_cache()) +
+				get_dpp_cache_bytes(dpp::get_role_cache()) + get_dpp_cache_bytes(dpp::get_channel_cache()) + get_dpp_cache_bytes(dpp::get_emoji_cache()) };
+			// kept between renders (see pixel_buffer_pool, png_layer_cache and label_sprite_cache), shared by every view
+			const memory_usage render_memory{ .bytes = detail::pixel_buffer_pool::get().pooled_bytes() + graph_ctx.get_png_layers().memory_used() +
+				detail::label_sprite_cache::memory_used() };
+			memory_usage total;
+			for (const memory_usage* cur : { &history_memory, &recent_memory, &ctx_memory, &data->checkpoint_memory, &graphs_memory, &render_memory, &dpp_memory })
+				{ total.bytes += cur->bytes; }
+
+			std::string msg = std::format("**Memory use{}** (estimated, {} history segments)\n```\n", (shards.size() == 1) ? std::string() :
+				std::format(" of {}", (view == merged_view_index) ? merged_view_name : std::string_view(shards[view]->config.name)), data->history.get_segments().size());
+			msg += format_memory_usage("history", history_memory);
+			msg += format_memory_usage("latest.log", recent_memory);
+			msg += format_memory_usage("parse context", ctx_memory);
+			msg += format_memory_usage("checkpoints", data->checkpoint_memory);
+			msg += format_memory_usage("graph cache", graphs_memory);
+			msg += format_memory_usage("render buffers", render_memory);
+			msg += format_memory_usage("discord cache", dpp_memory);
+			msg += format_memory_usage("total", total);
+			msg += "```";
+			// thread stacks are reserved rather than used, so they aren't in the total
+			constexpr std::uint32_t default_request_threads = 12;
+			if (config.lean_gateway)
+			{
+				msg += std::format("\nLean gateway: no intents or discord caches, {} request threads ({} fewer than by default)", config.request_threads,
+					static_cast<std::int64_t>(default_request_threads) - config.request_threads);
+			}
+			else if (config.request_threads != default_request_threads)
+				{ msg += std::format("\n{} request threads ({} by default)", config.request_threads, default_request_threads); }
+			event.reply(dpp::message(msg).set_flags(dpp::m_ephemeral));
+		}
+	});
+	
+	// bot.start will block in 10.0.35, even with dpp::st_return
+	// TODO: 10.0.35 has no socket engine that other fds can be added to. once dpp has one, register watcher.native_handle() with it
+	//       and handle events from its callback instead of running a loop on this thread
+	// a replica only serves what the primary sends it, the primary answers commands
+	const bool replica = (config.replicate_from_port != 0);
+	if (!replica)
+		{ std::thread([&]() { bot.start(dpp::st_return); }).detach(); }
+
+	std::optional<milestone_notifier> milestones;
+	if (config.milestone_channel_id != 0 && !replica)
+	{
+		milestones.emplace(bot, config.milestone_channel_id, config.milestone_hours, [&](uuid_t uuid) -> std::optional<std::chrono::system_clock::duration>
+		{
+			const std::size_t view = (shards.size() > 1) ? merged_view_index : std::size_t(0);
+			const std::shared_ptr<const published_data_t> data = get_view_data(view);
+			// playtime isn't all known until history is loaded
+			if (!data || data->loading())
+				{ return {}; }
+			return query_playtime(caches[view], *data, uuid);
+		});
+	}
+
+	if (config.digest_channel_id != 0 && !replica)
+	{
+		constexpr std::size_t digest_top_count = 5;
+		// digests are made on graph_renderer like other renders, so they aren't in a hurry
+		constexpr auto digest_deadline = std::chrono::minutes(30);
+		const digest_schedule schedule(config.graph_timezone, config.digest_time, config.digest_weekday, std::chrono::system_clock::now());
+		digests.emplace(bot, config.digest_channel_id, schedule, [&](const digest_schedule& next, std::function<void(std::optional<digest_poster::messages_t>)> done)
+		{
+			const std::size_t view = (shards.size() > 1) ? merged_view_index : std::size_t(0);
+			const std::shared_ptr<const published_data_t> data = get_view_data(view);
+			// the days aren't complete until history is loaded
+			if (!data || data->loading())
+			{
+				done(std::nullopt);
+				return;
+			}
+			const auto job = [&, data, view, periods = next.periods(), done](bool expired)
+			{
+				if (expired)
+				{
+					done(std::nullopt);
+					return;
+				}
+				const auto cur_config = live_config.load();
+				digest_poster::messages_t messages;
+				for (const auto& [first, last] : periods)
+				{
+					const digest_t digest = query_digest(caches[view], *data, first, last, digest_top_count, graph_ctx);
+					std::string msg = (first == last) ? std::format("**Yesterday ({:%A, %B %d}):**", first) : std::format("**Last week ({:%B %d} to {:%B %d}):**", first, last);
+					if (digest.active == 0)
+						{ msg += "\nNobody played"; }
+					else
+					{
+						msg += std::format("\nPlayers: {} ({} new)\nPlaytime: {} hours\nMost online: {} at <t:{:%Q}:{}>", digest.active, digest.new_players,
+							std::chrono::round<std::chrono::hours>(digest.total).count(), digest.peak, digest.peak_time.time_since_epoch(), (first == last) ? 't' : 'f');
+						msg += "\n\n**Most playtime:**";
+						for (const leaderboard_entry& entry : digest.top)
+						{
+							msg += std::format("\n{}. {} ({:%H:%M:%S})", entry.rank, dpp::utility::markdown_escape(std::string(entry.name)),
+								std::chrono::round<std::chrono::seconds>(entry.total));
+						}
+					}
+					// names are from the logs, so they mustn't ping anyone
+					dpp::message message(msg);
+					message.set_allowed_mentions();
+					const graph_options options = {
+						.color = "white",  // for discord's default theme, which is dark
+						.png_compression_level = cur_config->png_compression_level,
+						.render_ctx = &graph_ctx,
+						.range = { config.graph_timezone->to_sys(first, std::chrono::choose::earliest),
+							config.graph_timezone->to_sys(last + std::chrono::days(1), std::chrono::choose::earliest) },
+						.png_max_bytes = static_cast<std::size_t>(cur_config->attachment_max_bytes),
+						.png_max_surface_bytes = render_surface_bytes
+					};
+					try
+					{
+						std::string contents = create_online_graph<false, true>(data->history, data->recent, data->ctx, options);
+						const bool png = is_png(contents);
+						message.add_file(png ? "online.png" : "online.svg", std::move(contents), png ? "image/png" : "image/svg+xml");
+					}
+					catch (const std::runtime_error& e)
+						{ log_message(log_severity::error, std::format("Could not render the graph of a digest: {}", e.what())); }
+					messages.push_back(std::move(message));
+				}
+				done(std::move(messages));
+			};
+			if (!graph_renderer.submit(std::chrono::steady_clock::now() + digest_deadline, job))
+				{ done(std::nullopt); }
+		});
+	}
+
+	// a process that is already running keeps serving until this one has loaded the archives (see handoff_listener)
+	const std::uint64_t token_hash = detail::fnv1a(bot.token);
+	std::optional<handoff_client> handoff;
+	if (config.handoff_port != 0 && !replica)
+	{
+		handoff = handoff_client::connect(config.handoff_port, token_hash);
+		if (handoff)
+			{ log_message(log_severity::info, "Taking over from the running process once history is loaded"); }
+	}
+
+	// started before the initial parse, so it can be watched (after taking over, since the running process has the port until then)
+	std::optional<metrics_server> metrics;
+	const auto start_metrics = [&]()
+	{
+		if (config.metrics_port == 0)
+			{ return; }
+		try
+		{
+			metrics.emplace(config.metrics_address, config.metrics_port, []() { return get_metrics().format(); });
+		}
+		catch (const std::runtime_error& e)
+		{
+			log_message(log_severity::error, e.what());
+		}
+	};
+	if (!handoff)
+		{ start_metrics(); }
+
+	// @return players online in `data`, as in /players.json and the live feed
+	const auto online_players_json = [](const published_data_t& data)
+	{
+		jsoncons::json players(jsoncons::json_array_arg);
+		for (const std::uint32_t id : data.ctx.player_info.online())
+		{
+			const auto& [uuid, join_time] = data.ctx.player_info.infos()[id];
+			jsoncons::json player(jsoncons::json_object_arg);
+			player["name"] = data.ctx.player_info.name(id);
+			if (uuid)
+				{ player["uuid"] = std::format("{}", uuid.value()); }
+			player["online_since"] = std::chrono::floor<std::chrono::seconds>(join_time.value().time_since_epoch()).count();
+			players.push_back(std::move(player));
+		}
+		return players;
+	};
+
+	// graphs and stats for dashboards, from the same published data and graph cache as commands
+	// GET /graph.svg and /graph.png (type=playtime|online|heatmap, dark=true, size=full|half|thumbnail for png), /players.json, /player.json?name=..., /online_at.json?time=...
+	// all take server=... to choose one server, like the server option of commands
+	const auto handle_http = [&](const http_request& request) -> http_response
+	{
+		using namespace std::string_view_literals;
+		const auto make_body = [](std::string str) { return std::make_shared<const std::string>(std::move(str)); };
+		const auto server_param = http_query_param(request.query, "server");
+		const std::size_t view = get_view(server_param ? dpp::command_value(server_param.value()) : dpp::command_value());
+		if (server_param && server_param.value() != merged_view_name && (view == merged_view_index || shards[view]->config.name != server_param.value()))
+			{ return { .status = "404 Not Found", .body = make_body(std::format("No server named {}\n", server_param.value())) }; }
+		const std::shared_ptr<const published_data_t> data = get_view_data(view);
+		if (!data)
+			{ return { .status = "503 Service Unavailable", .body = make_body("Logs are still being read, please try again soon\n") }; }
+		const std::string etag_prefix = std::format("{}-{}", view, data->generation);
+
+		if (request.path == "/graph.svg"sv || request.path == "/graph.png"sv)
+		{
+			const bool svg = (request.path == "/graph.svg"sv);
+			const std::string type_str = http_query_param(request.query, "type").value_or("playtime");
+			const graph_type type = parse_graph_type(type_str);
+			// an svg is the same for both themes, so it has one etag
+			const bool dark = !svg && (http_query_param(request.query, "dark").value_or("false") == "true"sv);
+			const std::string size_str = http_query_param(request.query, "size").value_or("full");
+			const graph_size size = svg ? graph_size::full : (size_str == "half"sv) ? graph_size::half : (size_str == "thumbnail"sv) ? graph_size::thumbnail : graph_size::full;
+			// the same key as /graph without options, so the graphs are shared with (and pre-rendered for) commands, which render every size
+			const graph_cache::key_t key{ data->generation, type, svg, dark, (type == graph_type::playtime) ? live_config.load()->graph_row_limit : 0, {}, {}, size };
+			std::shared_ptr<const std::string> contents = caches[view].graphs.find(key);
+			(contents ? get_metrics().graph_cache_hits : get_metrics().graph_cache_misses).add();
+			if (!contents)
+				{ contents = render_graph(caches[view], *data, key); }
+			const bool png = is_png(*contents);  // shares the cache with commands, so a png may be an svg if it was too large to attach
+			return { .content_type = png ? "image/png"sv : "image/svg+xml"sv, .body = std::move(contents), .etag_prefix = etag_prefix, .compressible = !png };
+		}
+		if (request.path == "/players.json"sv)
+		{
+			jsoncons::json res(jsoncons::json_object_arg);
+			res["online"] = online_players_json(*data);
+			res["loading"] = data->loading();
+			std::string body;
+			res.dump(body);
+			return { .content_type = "application/json"sv, .body = make_body(std::move(body)), .etag_prefix = etag_prefix, .compressible = true };
+		}
+		if (request.path == "/player.json"sv)
+		{
+			const auto name = http_query_param(request.query, "name");
+			if (!name)
+				{ return { .status = "400 Bad Request", .body = make_body("name=... is required\n") }; }
+			const auto uuid = find_player(data->history, data->recent, name.value(), graph_ctx);
+			if (!uuid)
+				{ return { .status = "404 Not Found", .body = make_body(std::format("No player named {} has played\n", name.value())) }; }
+			const auto segments = data->history.get_segments();
+			const auto ranking = caches[view].ranking.get(segments, [segments]() { return playtime_ranking(segments); });
+			const auto extra = playtime_ranking::get_extra(data->recent, data->ctx, std::chrono::system_clock::now());
+			const auto entry = ranking->rank(uuid.value(), extra, data->recent);
+			jsoncons::json res(jsoncons::json_object_arg);
+			res["uuid"] = std::format("{}", uuid.value());
+			res["name"] = entry ? std::string(entry->name) : name.value();
+			res["playtime_seconds"] = entry ? std::chrono::floor<std::chrono::seconds>(entry->total).count() : 0;
+			if (entry)
+				{ res["rank"] = entry->rank; }
+			const auto online_id = data->ctx.player_info.find(std::string_view(res["name"].as_string_view()));
+			res["online"] = online_id && data->ctx.player_info.infos()[online_id.value()].join_time.has_value();
+			res["loading"] = data->loading();
+			std::string body;
+			res.dump(body);
+			return { .content_type = "application/json"sv, .body = make_body(std::move(body)), .etag_prefix = etag_prefix, .compressible = true };
+		}
+		if (request.path == "/online_at.json"sv)
+		{
+			const auto time_str = http_query_param(request.query, "time");
+			if (!time_str)
+				{ return { .status = "400 Bad Request", .body = make_body("time=... (unix timestamp) is required\n") }; }
+			const auto time = parse_date_time(time_str.value(), config.graph_timezone);
+			if (!time)
+				{ return { .status = "400 Bad Request", .body = make_body("time must be a unix timestamp or yyyy-mm-ddThh:mm\n") }; }
+			// parsing archives would hold up the http thread
+			const auto [players, error, archived] = get_online_at(view, *data, time.value(), false);
+			if (!error.empty())
+				{ return { .status = "400 Bad Request", .body = make_body(error + "\n") }; }
+			jsoncons::json online(jsoncons::json_array_arg);
+			for (const online_at_entry& entry : players)
+			{
+				jsoncons::json player(jsoncons::json_object_arg);
+				player["name"] = std::string(entry.name);
+				if (entry.uuid)
+					{ player["uuid"] = std::format("{}", entry.uuid.value()); }
+				player["start"] = std::chrono::floor<std::chrono::seconds>(entry.session.first.time_since_epoch()).count();
+				if (!entry.online)
+					{ player["end"] = std::chrono::floor<std::chrono::seconds>((entry.session.first + entry.session.second).time_since_epoch()).count(); }
+				online.push_back(std::move(player));
+			}
+			jsoncons::json res(jsoncons::json_object_arg);
+			res["online"] = std::move(online);
+			res["loading"] = data->loading();
+			std::string body;
+			res.dump(body);
+			return { .content_type = "application/json"sv, .body = make_body(std::move(body)), .etag_prefix = etag_prefix, .compressible = true };
+		}
+		return { .status = "404 Not Found", .body = make_body("Not found (see /graph.svg, /graph.png, /players.json, /player.json, /online_at.json and /live)\n") };
+	};
+	// joins and leaves on all servers as they are parsed, for dashboards (websocket /live of the http server). clients get
+	// {"type":"snapshot","servers":[{"server":name,"online":[like /players.json],"loading":bool}]} when they connect (and if they fall behind), then
+	// {"type":"delta","server":name,"online_count":n,"events":[{"type":"join"|"leave","name":...,"uuid":...,"time":secs}]} for what each batch of lines changed
+	std::optional<live_feed> feed;
+	if (config.http_port != 0)
+	{
+		feed.emplace([&shards, &online_players_json]()
+		{
+			jsoncons::json servers(jsoncons::json_array_arg);
+			for (const auto& shard : shards)
+			{
+				const std::shared_ptr<const published_data_t> data = shard->published.load();
+				if (!data)
+					{ continue; }
+				jsoncons::json server(jsoncons::json_object_arg);
+				server["server"] = shard->config.name;
+				server["online"] = online_players_json(*data);
+				server["loading"] = data->loading();
+				servers.push_back(std::move(server));
+			}
+			jsoncons::json res(jsoncons::json_object_arg);
+			res["type"] = "snapshot";
+			res["servers"] = std::move(servers);
+			std::string message;
+			res.dump(message);
+			return message;
+		});
+	}
+	std::optional<http_server> http;
+	const auto start_http = [&]()
+	{
+		if (config.http_port == 0)
+			{ return; }
+		try
+		{
+			http.emplace(config.http_address, config.http_port, handle_http, &feed.value());
+		}
+		catch (const std::runtime_error& e)
+		{
+			log_message(log_severity::error, e.what());
+		}
+	};
+	// after taking over too, since the running process has the port until then
+	std::optional<replication_publisher> replication;
+	const auto start_replication = [&]()
+	{
+		if (config.replication_port == 0)
+			{ return; }
+		try
+		{
+			replication.emplace(config.replication_address, config.replication_port, bot.token, [&shards]()
+			{
+				std::vector<std::pair<std::string, std::shared_ptr<const published_data_t>>> res;
+				for (const auto& shard : shards)
+					{ res.emplace_back(shard->config.name, shard->published.load()); }
+				return res;
+			});
+		}
+		catch (const std::runtime_error& e)
+		{
+			log_message(log_severity::error, e.what());
+		}
+	};
+	if (!handoff)
+	{
+		start_http();
+		start_replication();
+	}
+
+	// when taking over, shards wait for the running process to exit once they have read the archives (see handoff_client::take_over)
+	std::latch archives_loaded(static_cast<std::ptrdiff_t>(shards.size()));
+	std::atomic<bool> taken_over = !handoff;
+
+	// read a server's logs until an error, publishing its data for commands (run on the shard's thread)
+	// @return false on error
+	const auto run_server = [&](server_shard& shard, std::size_t shard_index)
+	{
+		const server_config_t& server = shard.config;
+		// messages say which server they are about if there are several
+		const std::string log_prefix = server.name.empty() ? std::string() : std::format("[{}] ", server.name);
+
+		// archived log files whose data is in history, in order
+		std::vector<log_manifest_entry> read_manifest;
+		// false if a file was read that the manifest can't describe, in which case snapshots would be wrong
+		bool snapshot_valid = !server.snapshot_path.empty() && !server.log_path.empty();
+		// of the snapshot that is on disk, empty until one is loaded or saved (see snapshot_t)
+		std::optional<std::uint64_t> snapshot_next_segment;
+		std::size_t snapshot_segments = 0;  // appended since the snapshot was loaded or last compacted
+		std::future<bool> snapshot_compaction;  // of the snapshot's segments into its base, in the background (see compact_snapshot)
+		// of the whole snapshot, in the background. snapshot_next_segment is its result once it's done (see start_snapshot_save)
+		std::future<std::optional<std::uint64_t>> snapshot_save;
+		// set by file_writer if a segment couldn't be written, shared since it may be written after this thread is done
+		const auto snapshot_segment_failed = std::make_shared<std::atomic<bool>>(false);
+		// sessions from log files that have been fully read are committed to history,
+		// parse_data only holds what was read from latest.log since then
+		// committing and rolling back only touch parse_data and parse_ctx (which is small), never the history
+		session_history history;
+		std::pair<log_data_t, parse_ctx_t> parse_data_ctx;
+		auto& [parse_data, parse_ctx] = parse_data_ctx;
+		parse_ctx_t persistent_ctx;  // parse_ctx before reading latest.log
+		// lag and uptime of the history, and of latest.log since it was committed, which are committed with the sessions
+		auto history_lag = std::make_shared<const lag_series>();
+		lag_series parse_lag;
+		auto history_uptime = std::make_shared<const uptime_series>();
+		uptime_series parse_uptime;
+		memory_usage checkpoint_memory;  // see published_data_t
+		std::uint64_t data_generation = 0;
+		// joins and leaves since the data was last published, sent to the live feed and the notifier once it is (see live_feed)
+		live_delta_collector live_deltas;
+		bool live_resync = false;  // latest.log was parsed again, so the feed needs a snapshot rather than what changed
+		// lines of latest.log (or received) add sessions, live deltas, lag, uptime and recent events
+		session_aggregator sessions(parse_data, merge_gap);
+		lag_collector lag_events(parse_lag);
+		uptime_collector uptime_events(parse_uptime, &history_uptime);
+		recent_event_collector recent_events{ &shard.recent_events };
+		const auto live_consumer = combine_consumers(sessions, live_deltas, lag_events, uptime_events, recent_events);
+		using live_consumer_t = decltype(live_consumer);
+		// @return message for the live feed with live_deltas
+		const auto format_live_deltas = [&]()
+		{
+			jsoncons::json events(jsoncons::json_array_arg);
+			for (const live_delta& delta : live_deltas.deltas)
+			{
+				jsoncons::json event(jsoncons::json_object_arg);
+				event["type"] = (delta.type == log_event_type::join) ? "join" : "leave";
+				event["name"] = delta.player;
+				if (delta.uuid)
+					{ event["uuid"] = std::format("{}", delta.uuid.value()); }
+				event["time"] = std::chrono::floor<std::chrono::seconds>(delta.time.time_since_epoch()).count();
+				events.push_back(std::move(event));
+			}
+			jsoncons::json res(jsoncons::json_object_arg);
+			res["type"] = "delta";
+			res["server"] = server.name;
+			res["online_count"] = parse_ctx.player_info.online().size();
+			res["events"] = std::move(events);
+			std::string message;
+			res.dump(message);
+			return message;
+		};
+		const auto publish_live = [&]()
+		{
+			if (live_resync)
+			{
+				if (feed)
+					{ feed->resync(); }
+				live_resync = false;
+				live_deltas.enabled = true;
+			}
+			else if (!live_deltas.deltas.empty())
+			{
+				if (feed)
+					{ feed->publish(format_live_deltas()); }
+				if (notifier)
+					{ notifier->add(server.name, live_deltas.deltas); }
+				if (milestones)
+					{ milestones->add(live_deltas.deltas); }
+			}
+			live_deltas.deltas.clear();
+		};
+		const auto publish_data = [&]()
+		{
+			{
+				const metrics_histogram::timer timer(get_metrics().publish);
+				auto data = std::make_shared<const published_data_t>(history, parse_data, parse_ctx, data_generation, read_manifest.size(), read_manifest.size(),
+					checkpoint_memory, std::vector<std::shared_ptr<const lag_series>>{ history_lag, std::make_shared<const lag_series>(parse_lag) },
+					std::vector<std::shared_ptr<const uptime_series>>{ history_uptime, std::make_shared<const uptime_series>(parse_uptime) });
+				const metrics_histogram::timer lock_timer(get_metrics().publish_lock);
+				shard.published.store(std::move(data));
+			}
+			// after the data, so a snapshot made after a message is taken includes what it describes
+			publish_live();
+		};
+		// changes when a period of parse_uptime starts or ends, for lag graphs (which shade downtime)
+		const auto uptime_state = [&]()
+			{ return std::pair(parse_uptime.size(), parse_uptime.open()); };
+		// add the lag and uptime of latest.log to those of history, when its sessions are committed (parse_lag and parse_uptime are cleared with parse_data)
+		const auto commit_lag = [&]()
+		{
+			auto lag = std::make_shared<lag_series>(*history_lag);
+			lag->append(parse_lag);
+			history_lag = std::move(lag);
+			auto uptime = std::make_shared<uptime_series>(*history_uptime);
+			uptime->append(parse_uptime);
+			history_uptime = std::move(uptime);
+		};
+		// roll up sessions older than the retention period, if there is one (see config_t::retention_days)
+		const auto apply_retention = [&]()
+		{
+			if (config.retention_days == 0)
+				{ return; }
+			const auto today = std::chrono::floor<std::chrono::days>(config.graph_timezone->to_local(std::chrono::system_clock::now()));
+			const auto cutoff = config.graph_timezone->to_sys(today - std::chrono::days(config.retention_days), std::chrono::choose::earliest);
+			if (history.roll_up(cutoff, config.graph_timezone))
+				{ data_generation++; }
+		};
+		// older history segments are compressed with config_t::compress_history, and spilled to files once history would use more memory
+		// than config_t::history_memory_bytes
+		std::optional<segment_spill> spill;
+		if (config.history_memory_bytes != 0)
+			{ spill.emplace(server.segment_path, config.history_memory_bytes); }
+		const auto apply_memory_limit = [&]()
+		{
+			if (config.compress_history && history.compress())
+				{ data_generation++; }
+			if (spill && spill->apply(history))
+				{ data_generation++; }
+		};
+		// let queries about times before the retention period parse the archives again, once read_manifest has their summaries
+		const auto publish_archives = [&]()
+		{
+			if (config.retention_days != 0)
+			{
+				shard.archive_ranges.set_archives(std::make_shared<const archive_range_cache::archives_t>(read_manifest, server.logs_format,
+					shard.logs_timezone.load(), merge_gap));
+			}
+		};
+		// wait for the snapshot being saved in the background, if it is, so it can be written to again
+		const auto finish_snapshot_save = [&]()
+		{
+			if (snapshot_save.valid())
+				{ snapshot_next_segment = snapshot_save.get(); }
+		};
+		// save the whole snapshot on another thread, so reading logs isn't paused for as long as it takes to write.
+		// history's segments, lag and uptime are immutable and shared with it, the rest is copied, so it writes what they are now
+		// @param ctx  parse context after the files in read_manifest
+		const auto start_snapshot_save = [&](const parse_ctx_t& ctx)
+		{
+			finish_snapshot_save();
+			snapshot_next_segment.reset();
+			snapshot_segments = 0;
+			snapshot_save = std::async(std::launch::async, [path = std::filesystem::path(server.snapshot_path), manifest = read_manifest, format = server.logs_format,
+				history = history, ctx, lag = history_lag, uptime = history_uptime, compaction = std::move(snapshot_compaction), &file_writer]() mutable
+			{
+				QC_TRACE_SCOPE("save_snapshot");
+				// they both replace the base
+				if (compaction.valid())
+					{ compaction.wait(); }
+				// so the segments it replaces are on disk to be removed
+				file_writer.flush();
+				// merged here too, since that copies every session when there are several segments
+				return save_snapshot(path, manifest, format, *history.merged(), ctx, *lag, *uptime);
+			});
+		};
+		// add the sessions of latest.log, which was just archived, to the snapshot as a segment, and compact the segments in the background
+		// once there are snapshot_compaction_segments of them. only the new sessions are written, so history in memory may be rolled up
+		// (see session_history::roll_up) without the snapshot losing the sessions that were
+		const auto update_snapshot = [&]()
+		{
+			finish_snapshot_save();
+			// a later segment would be missing the files of one that couldn't be written
+			if (snapshot_segment_failed->exchange(false))
+				{ snapshot_next_segment.reset(); }
+			if (!snapshot_next_segment)
+			{
+				// nothing was archived on startup (or saving failed since), so history is all the snapshot would have,
+				// except with a retention period, when it is missing the sessions that were rolled up
+				if (config.retention_days == 0 || read_manifest.size() == 1)
+					{ start_snapshot_save(persistent_ctx); }
+				return;
+			}
+			queue_snapshot_segment(file_writer, server.snapshot_path, snapshot_next_segment.value(), read_manifest, server.logs_format, parse_data, persistent_ctx,
+				parse_lag, parse_uptime, [failed = snapshot_segment_failed](bool ok)
+				{
+					if (!ok)
+						{ *failed = true; }
+				});
+			snapshot_next_segment.value()++;
+			snapshot_segments++;
+			const bool compacting = snapshot_compaction.valid() && snapshot_compaction.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+			if (snapshot_segments >= snapshot_compaction_segments && !compacting)
+			{
+				snapshot_segments = 0;
+				snapshot_compaction = std::async(std::launch::async, [path = std::filesystem::path(server.snapshot_path), logs_dir = std::filesystem::path(server.log_path),
+					&file_writer]()
+				{
+					QC_TRACE_SCOPE("compact_snapshot");
+					// so it has the segment that was just queued
+					file_writer.flush();
+					return compact_snapshot(path, logs_dir);
+				});
+			}
+		};
+
+		std::optional<std::chrono::steady_clock::time_point> prerender_tp;  // when to pre-render next
+		// @return how long the log reading loop can wait for so the next pre-render isn't late, or nullopt if there is none
+		const auto prerender_timeout = [&]() -> std::optional<std::chrono::milliseconds>
+		{
+			if (!prerender_tp)
+				{ return std::nullopt; }
+			return std::chrono::ceil<std::chrono::milliseconds>(prerender_tp.value() - std::chrono::steady_clock::now());
+		};
+		// pre-render the default graphs if it is time to (see prerender_delay)
+		const auto prerender_if_due = [&]()
+		{
+			if (!prerender_tp || std::chrono::steady_clock::now() < prerender_tp.value())
+				{ return; }
+			const auto now = std::chrono::steady_clock::now();
+			if (now < prerender_next_allowed_tp.load())
+				{ prerender_tp = prerender_next_allowed_tp.load(); }  // over budget, try again later
+			else
 			{
-				std::scoped_lock lock(parse_data_ctx_mutex);
-				const bool latest_log_exists = std::filesystem::exists(latest_log);
-				const auto size = latest_log_exists ? std::filesystem::file_size(latest_log) : 0;
-				update_date_tp(latest_log_exists);
-				if (size > 0)
+				prerender_tp.reset();
+				if (last_graph_command_tp.load() > now - prerender_max_idle)
 				{
-					std::cout << "WARNING: latest.log shouldn't be moved to (from another file), discarding data and reading entirely" << std::endl;
-					parse_data_ctx = persistent_data_ctx;
-					std::ifstream fin(latest_log, std::ios::binary);
-					std::string s;
-					s.resize_and_overwrite(size, [&fin](char* buf, std::size_t buf_size)
+					// skipped if the queue is full, user commands are more important
+					std::ignore = graph_renderer.submit(now + prerender_delay, [&](bool expired)
 					{
-						fin.read(buf, buf_size);
-						return buf_size;
+						if (expired)
+							{ return; }
+						const auto start = std::chrono::steady_clock::now();
+						// the server's graphs, and the graphs of all servers, which include it
+						for (std::size_t view = shard_index; view < num_views; view = (view == merged_view_index) ? num_views : merged_view_index)
+						{
+							const auto data = get_view_data(view);
+							if (!data)
+								{ continue; }
+							for (const bool dark : { false, true })
+							{
+								const graph_cache::key_t key{ data->generation, graph_type::playtime, false, dark, live_config.load()->graph_row_limit, {}, {} };
+								// don't bother if a command rendered it
+								if (caches[view].graphs.find(key))
+									{ continue; }
+								render_graph(caches[view], *data, key);
+							}
+						}
+						const auto end = std::chrono::steady_clock::now();
+						prerender_next_allowed_tp = end + (end - start) * (100 - prerender_cpu_percent) / prerender_cpu_percent;
 					});
-					fin.close();
-					parse_lines(std::move(s), parse_ctx, parse_data);
-					update_player_count(bot, config, parse_ctx, last_player_count);
 				}
-				prev_size = size;
 			}
+		};
+
+		// the players online now according to the server, if it has rcon (see server_config_t::rcon_port), so they are known before latest.log is read
+		// @return names separated by ", ", or nullopt if rcon isn't enabled or failed
+		const auto query_rcon_players = [&]() -> std::optional<std::string>
+		{
+			if (server.rcon_port == 0)
+				{ return std::nullopt; }
+			constexpr int rcon_timeout_ms = 2000;
+			auto rcon = rcon_client::connect(server.rcon_address, server.rcon_port, server.rcon_password, rcon_timeout_ms);
+			auto res = rcon ? rcon->list_players() : std::nullopt;
+			if (!res)
+			{
+				log_message(log_severity::warning, log_prefix + std::format("Could not get the online players over rcon from {}:{} (is the password right?)",
+					server.rcon_address, server.rcon_port));
+			}
+			return res;
+		};
+		// online players published while history loads, empty without rcon
+		parse_ctx_t loading_ctx;
+		const auto loading_list = query_rcon_players();
+		if (loading_list)
+		{
+			const auto now = std::chrono::system_clock::now();
+			for (const std::string_view name : detail::split_player_list(loading_list.value()))
+				{ loading_ctx.player_info.set_join_time(loading_ctx.player_info.intern(name), now); }
+			publish_player_count(shard, loading_ctx);
+			log_message(log_severity::info, log_prefix + std::format("{} players online according to rcon", loading_ctx.player_info.online().size()));
+		}
+		// make the players online exactly those the server says are, once latest.log has been read, since it may not have their joins
+		// (e.g. the bot started when latest.log was already rotated) or leaves (e.g. lines lost when the server crashed)
+		const auto reconcile_rcon_players = [&]()
+		{
+			const auto list = query_rcon_players();
+			if (list && detail::reconcile_online_players(parse_ctx, detail::split_player_list(list.value()), std::chrono::system_clock::now(),
+				"in the rcon player list", live_consumer))
+				{ data_generation++; }
+		};
+
+		// @return date of the oldest archives that are read (see config_t::history_days)
+		const auto history_first_day = [&]()
+		{
+			if (config.history_days == 0)
+				{ return std::chrono::year::min() / std::chrono::January / 1; }
+			const auto today = std::chrono::floor<std::chrono::days>(shard.logs_timezone.load()->to_local(std::chrono::system_clock::now()));
+			return std::chrono::year_month_day(std::chrono::sys_days((today - std::chrono::days(config.history_days - 1)).time_since_epoch()));
+		};
+
+		log_message(log_severity::info, log_prefix + "Performing initial parse");
+
+		{
+			QC_TRACE_SCOPE("initial parse of archives");
+			if (!server.log_path.empty())
+				{ read_manifest = scan_logs_dir<true>(server.log_path); }
+			// with a window, older archives aren't read at all, and the uuids logged in them come from the usercache
+			if (config.history_days != 0)
+			{
+				const auto first_day = history_first_day();
+				const std::size_t num_skipped = std::erase_if(read_manifest, [first_day](const log_manifest_entry& file) { return file.date < first_day; });
+				if (num_skipped != 0)
+					{ log_message(log_severity::info, log_prefix + std::format("Skipping {} log files from before {}", num_skipped, first_day)); }
+			}
+			const auto known_uuids = read_usercache(server.usercache_path, log_prefix);
+			// archives are parsed in batches, and history is published after each one so commands can use it while the rest is read
+			// latest.log is only read after all of them, since it continues from their parse context
+			// (players online at the end of a batch aren't published, since they aren't necessarily online now, only those rcon says are)
+			constexpr std::size_t initial_parse_batch_size = 64;
+			const auto publish_loading = [&](std::size_t files_loaded)
+			{
+				data_generation++;
+				shard.published.store(std::make_shared<const published_data_t>(history, log_data_t(), loading_ctx, data_generation, files_loaded, read_manifest.size(),
+					memory_usage()));
+				log_message(log_severity::info, log_prefix + std::format("Read {} of {} log files", files_loaded, read_manifest.size()));
+			};
+			// /players can already answer with who rcon says is online
+			if (loading_list)
+				{ publish_loading(0); }
+			// only parse files that aren't in the snapshot
+			std::size_t num_covered = 0;
+			lag_series archive_lag;
+			lag_collector archive_lag_events(archive_lag);
+			uptime_series archive_uptime;
+			uptime_collector archive_uptime_events(archive_uptime);
+			if (snapshot_valid)
+			{
+				auto snapshot = [&]()
+				{
+					QC_TRACE_SCOPE("load_snapshot");
+					return load_snapshot(server.snapshot_path, server.log_path);
+				}();
+				if (snapshot)
+				{
+					const auto coverage = snapshot_coverage(snapshot->manifest, read_manifest);
+					if (snapshot->format != server.logs_format)
+					{
+						log_message(log_severity::warning, log_prefix + std::format("Snapshot was made for {} logs, parsing all logs",
+							log_format_names[static_cast<std::size_t>(snapshot->format)]));
+					}
+					else if (coverage)
+					{
+						num_covered = coverage.value();
+						for (std::size_t i = 0; i < num_covered; i++)
+							{ read_manifest[i].summary = snapshot->manifest[i].summary; }
+						history = std::move(snapshot->history);
+						snapshot_next_segment = snapshot->next_segment;
+						snapshot_segments = snapshot->num_segments;
+						// the snapshot may have been made without merging sessions, or with a smaller gap
+						if (merge_gap != std::chrono::seconds::zero() && history.compact(merge_gap))
+							{ log_message(log_severity::info, log_prefix + "Merged reconnecting sessions of snapshot"); }
+						parse_ctx = std::move(snapshot->ctx);
+						archive_lag = std::move(snapshot->lag);
+						archive_uptime = std::move(snapshot->uptime);
+						log_message(log_severity::info, log_prefix + std::format("Loaded snapshot covering {} of {} log files", num_covered, read_manifest.size()));
+						publish_loading(num_covered);
+					}
+					else
+						{ log_message(log_severity::warning, log_prefix + "Snapshot does not match log files (were they changed?), parsing all logs"); }
+				}
+			}
+			// archives that aren't in the snapshot but were parsed before are replayed from the journal instead of being read
+			std::optional<event_journal> journal;
+			if (num_covered != read_manifest.size())
+			{
+				journal.emplace(server.journal_path, server.logs_format);
+				if (journal->size() != 0)
+					{ log_message(log_severity::info, log_prefix + std::format("Loaded event journal with {} log files", journal->size())); }
+			}
+			// after the snapshot's context, which doesn't have it
+			parse_ctx.known_uuids = known_uuids;
+			for (std::size_t first = num_covered; first < read_manifest.size(); first += initial_parse_batch_size)
+			{
+				const std::size_t last = std::min(first + initial_parse_batch_size, read_manifest.size());
+				// the batch's sessions are only added to and then compacted into history, so they come from an arena that is released after it
+				std::pmr::monotonic_buffer_resource arena(1 << 20);
+				pmr_log_data_t new_data(&arena);
+				session_aggregator new_sessions(new_data, merge_gap);
+				archive_summary_collector summaries;
+				std::size_t next_file = first;
+				parse_ctx = with_log_format(server.logs_format, [&]<typename line_format>(line_format)
+				{
+					return parse_log_file_events<true, line_format>(std::vector(read_manifest.begin() + first, read_manifest.begin() + last), shard.logs_timezone.load(),
+						[&](const log_manifest_entry& file)
+						{
+							summaries.file_done();
+							read_manifest[next_file++].ingest = file.ingest;
+						}, std::move(parse_ctx), combine_consumers(new_sessions, archive_lag_events, archive_uptime_events, summaries),
+						journal.value());
+				});
+				for (std::size_t i = 0; i < summaries.summaries.size(); i++)
+					{ read_manifest[first + i].summary = summaries.summaries[i]; }
+				{
+					QC_TRACE_SCOPE("commit batch");
+					history.commit(new_data);
+				}
+				// so reading years of archives stays within the budget too
+				apply_memory_limit();
+				if (last != read_manifest.size())
+					{ publish_loading(last); }
+			}
+			// the archives that took longest, since a few pathological ones (e.g. a day of a mod spamming warnings) can dominate loading
+			if (num_covered != read_manifest.size())
+			{
+				std::vector<const log_manifest_entry*> slowest;
+				for (std::size_t i = num_covered; i < read_manifest.size(); i++)
+					{ slowest.push_back(&read_manifest[i]); }
+				const std::size_t count = std::min<std::size_t>(slowest.size(), 5);
+				std::ranges::partial_sort(slowest, slowest.begin() + count, std::ranges::greater(), [](const log_manifest_entry* file) { return file->ingest.total_time(); });
+				std::string message = log_prefix + "Slowest log files to parse:";
+				for (std::size_t i = 0; i < count; i++)
+					{ message += "\n  " + format_ingest_stats(*slowest[i]); }
+				log_message(log_severity::info, message);
+			}
+			history_lag = std::make_shared<const lag_series>(std::move(archive_lag));
+			history_uptime = std::make_shared<const uptime_series>(std::move(archive_uptime));
+			if (snapshot_valid && num_covered != read_manifest.size())
+				{ start_snapshot_save(parse_ctx); }
+			// after starting the save, so the snapshot has every session
+			apply_retention();
+			apply_memory_limit();
+			publish_archives();
+			const memory_usage history_memory = history.memory_used();
+			log_message(log_severity::info, log_prefix + std::format("History uses {} for {} sessions in {} segments (see /debug memory)", format_bytes(history_memory.bytes),
+				history_memory.sessions, history.get_segments().size()));
+		}
+		persistent_ctx = parse_ctx;
+
+		// the process being taken over is still reading latest.log (or receiving lines, on the ingest port it has until it exits)
+		archives_loaded.count_down();
+		taken_over.wait(false);
+
+		// lines pushed over the network are parsed as soon as they are received, instead of watching latest.log
+		// the log rotation that commits latest.log data to history doesn't happen here, so it is committed at midnight instead
+		if (server.ingest_port != 0)
+		{
+			std::optional<log_listener> listener;
+			try
+			{
+				listener.emplace(server.ingest_address, server.ingest_port);
+			}
+			catch (const std::runtime_error& e)
+			{
+				log_message(log_severity::fatal, log_prefix + e.what());
+				return false;
+			}
+			log_message(log_severity::info, log_prefix + std::format("Receiving log lines on {}:{} (tcp and udp)", server.ingest_address, server.ingest_port));
+			// players online at the end of the archives aren't known to be online now
+			for (const std::uint32_t id : std::vector(parse_ctx.player_info.online().begin(), parse_ctx.player_info.online().end()))
+				{ parse_ctx.player_info.set_join_time(id, std::nullopt); }
+			reconcile_rcon_players();
+			publish_player_count(shard, parse_ctx);
+			data_generation++;  // graphs cached while loading are outdated
+			publish_data();
+			log_message(log_severity::info, log_prefix + "Finished initial parse");
+			live_deltas.enabled = true;
 
-			if (res->event_modify)
+			const auto parse_received = with_log_format(server.logs_format,
+				[]<typename line_format>(line_format) { return &parse_received_events<line_format, const live_consumer_t&>; });
+			std::string lines;
+			while (true)
 			{
-				std::scoped_lock lock(parse_data_ctx_mutex);
-				const auto size = std::filesystem::exists(latest_log) ? std::filesystem::file_size(latest_log) : 0;
-				bool do_update = false;
-				if (size < prev_size)
+				const std::uint64_t prev_generation = data_generation;
+				lines.clear();
+				if (!listener->receive(lines, prerender_timeout()))
 				{
-					std::cout << "WARNING: latest.log shrunk somehow, discarding data and re-reading from start" << std::endl;
-					prev_size = 0;
-					parse_data_ctx = persistent_data_ctx;
-					do_update = true;
+					log_message(log_severity::fatal, log_prefix + "Could not receive log lines");
+					return false;
 				}
-				if (size > 0 && size > prev_size)
+				if (!lines.empty())
 				{
-					std::ifstream fin(latest_log, std::ios::binary);
-					fin.seekg(prev_size, std::ios::beg);
-					std::string s;
-					s.resize_and_overwrite(size - prev_size, [&fin](char* buf, std::size_t buf_size)
+					QC_ALLOCATION_SCOPE(tail, 1);
+					const metrics_histogram::timer timer(get_metrics().parse_batch);
+					get_metrics().bytes_received.add(lines.size());
+					get_metrics().lines_parsed.add(static_cast<std::uint64_t>(std::ranges::count(lines, '\n')));
+					const auto prev_date = parse_ctx.date_tp;
+					const std::size_t prev_lag = parse_lag.size();
+					const auto prev_uptime = uptime_state();
+					if (parse_received(lines, std::chrono::system_clock::now(), shard.logs_timezone.load(), parse_ctx, live_consumer))
 					{
-						fin.read(buf, buf_size);
-						return buf_size;
-					});
-					fin.close();
-					if (parse_lines(std::move(s), parse_ctx, parse_data) || do_update)
-						{ update_player_count(bot, config, parse_ctx, last_player_count); }
+						data_generation++;
+						publish_player_count(shard, parse_ctx);
+					}
+					else if (parse_lag.size() != prev_lag || uptime_state() != prev_uptime)
+						{ data_generation++; }  // for lag graphs
+					// sessions that ended before the new day go into history, like when latest.log is rotated
+					if (prev_date != std::chrono::system_clock::time_point() && parse_ctx.date_tp > prev_date)
+					{
+						history.commit(parse_data);
+						commit_lag();
+						parse_data.clear();
+						parse_lag.clear();
+						parse_uptime.clear();
+						apply_retention();
+						apply_memory_limit();
+					}
+					publish_data();
+				}
+				if (data_generation != prev_generation)
+					{ prerender_tp = std::chrono::steady_clock::now() + prerender_delay; }
+				prerender_if_due();
+			}
+		}
+
+		const std::filesystem::path latest_log = std::filesystem::path(server.log_path) / "latest.log";
+#ifdef _WIN32
+		bool notify_on_last_write = server.windows_notify_on_last_write;
+#define FILE_WATCHER_USER_DATA &notify_on_last_write
+#else
+#define FILE_WATCHER_USER_DATA nullptr
+#endif
+		file_watcher watcher(server.log_path.c_str(), latest_log.filename().string(), FILE_WATCHER_USER_DATA);
+#undef FILE_WATCHER_USER_DATA
+		shard.watcher = &watcher;
+
+		// the published data has the date too (commands use it for the date of the players online), so it has to be published again if this changed it
+		// @return whether the date changed
+		const auto update_date_tp = [&](bool latest_log_exists)
+		{
+			if (!latest_log_exists)
+				{ return false; }
+			const auto prev = parse_ctx.date_tp;
+			parse_ctx.date_tp = file_modification_date(latest_log, shard.logs_timezone.load());
+			return parse_ctx.date_tp != prev;
+		};
+
+		// kept open so data written just before latest.log is rotated can still be read
+		log_tailer tailer(latest_log);
+
+		// checkpoints of the open latest.log, oldest first
+		// the interval doubles (and every other checkpoint is dropped) whenever there are too many, so memory use is bounded
+		std::vector<latest_log_checkpoint_t> checkpoints;
+		constexpr std::uint64_t min_checkpoint_interval = 16 << 20;
+		constexpr std::size_t max_checkpoints = 32;
+		std::uint64_t checkpoint_interval = min_checkpoint_interval;
+		const auto count_checkpoint_memory = [&]()
+		{
+			checkpoint_memory = { .bytes = detail::vector_heap_bytes(checkpoints) };
+			for (const auto& checkpoint : checkpoints)
+			{
+				checkpoint_memory += memory_used(checkpoint.data);
+				checkpoint_memory += memory_used(checkpoint.ctx);
+				checkpoint_memory.bytes += checkpoint.uptime.memory_used();
+			}
+		};
+		const auto clear_checkpoints = [&]()
+		{
+			checkpoints.clear();
+			checkpoint_interval = min_checkpoint_interval;
+			count_checkpoint_memory();
+		};
+		const auto add_checkpoint = [&]()
+		{
+			const std::uint64_t last_offset = checkpoints.empty() ? 0 : checkpoints.back().offset;
+			if (tailer.parsed_offset() - last_offset < checkpoint_interval)
+				{ return; }
+			checkpoints.emplace_back(tailer.parsed_offset(), tailer.parsed_hash(), parse_data, parse_ctx, parse_lag.size(), parse_uptime);
+			if (checkpoints.size() > max_checkpoints)
+			{
+				std::size_t num_kept = 0;
+				for (std::size_t i = 1; i < checkpoints.size(); i += 2)
+					{ checkpoints[num_kept++] = std::move(checkpoints[i]); }
+				checkpoints.erase(checkpoints.begin() + num_kept, checkpoints.end());
+				checkpoint_interval *= 2;
+			}
+			count_checkpoint_memory();
+		};
+		// discard latest.log data after the last checkpoint whose prefix is unchanged in the open file
+		// (everything is discarded if there is none), and continue reading from there
+		// @param size  current size of the open file
+		// @return offset reading continues from
+		const auto rollback_latest_log = [&](std::uint64_t size)
+		{
+			// prefixes are checked in order, so each part of the file only needs to be hashed once
+			std::uint64_t hash = detail::fnv1a_basis, hashed_end = 0;
+			std::size_t num_valid = 0;
+			for (const auto& checkpoint : checkpoints)
+			{
+				if (checkpoint.offset > size)
+					{ break; }
+				const auto cur_hash = tailer.hash_range(hashed_end, checkpoint.offset, hash);
+				if (!cur_hash || cur_hash.value() != checkpoint.prefix_hash)
+					{ break; }
+				hash = cur_hash.value();
+				hashed_end = checkpoint.offset;
+				num_valid++;
+			}
+			checkpoints.erase(checkpoints.begin() + num_valid, checkpoints.end());
+			count_checkpoint_memory();
+			// what is read again was sent to the live feed already
+			live_deltas.enabled = false;
+			live_deltas.deltas.clear();
+			live_resync = true;
+			recent_events.replay();
+
+			if (checkpoints.empty())
+			{
+				parse_data.clear();
+				parse_lag.clear();
+				parse_uptime.clear();
+				parse_ctx = persistent_ctx;
+				update_date_tp(true);
+				tailer.seek(0);
+				return std::uint64_t(0);
+			}
+			const auto& checkpoint = checkpoints.back();
+			parse_data = checkpoint.data;
+			parse_ctx = checkpoint.ctx;
+			parse_lag.truncate(checkpoint.lag_size);
+			parse_uptime = checkpoint.uptime;
+			tailer.seek(checkpoint.offset, checkpoint.prefix_hash);
+			return checkpoint.offset;
+		};
+
+		// chosen once, so lines aren't checked for each format
+		const auto parse_new_lines = with_log_format(server.logs_format,
+			[]<typename line_format>(line_format) { return &parse_events<line_format, const live_consumer_t&>; });
+
+		// parse complete lines of the open latest.log from the last read position to `end`
+		// (an incomplete line at the end is parsed by a later call, once the rest of it has been written)
+		// large amounts are read in chunks, so memory use doesn't depend on how much there is (e.g. on startup with a huge latest.log)
+		// @return whether players have joined/left
+		const auto read_latest_log = [&](std::uint64_t end)
+		{
+			constexpr std::uint64_t chunk_size = 16 << 20;  // large enough to be scanned on several threads (see parse_lines)
+			const metrics_histogram::timer timer(get_metrics().parse_batch);
+			bool players_changed = false;
+			while (tailer.get_offset() < end)
+			{
+				const std::uint64_t prev_offset = tailer.get_offset();
+				const auto data = tailer.read(std::min(end, prev_offset + chunk_size));
+				if (!data)
+				{
+					log_message(log_severity::error, log_prefix + "Could not read latest.log");
+					break;
+				}
+				// empty if there are no complete lines yet (e.g. a line longer than a chunk)
+				if (!data->empty())
+				{
+					const auto num_lines = static_cast<std::uint64_t>(std::ranges::count(data.value(), '\n'));
+					get_metrics().bytes_tailed.add(data->size());
+					get_metrics().lines_parsed.add(num_lines);
+					{
+						QC_ALLOCATION_SCOPE(parse, num_lines);
+						if (parse_new_lines(data.value(), parse_ctx, live_consumer))
+							{ players_changed = true; }
+					}
+					add_checkpoint();
 				}
-				prev_size = size;
+				if (tailer.get_offset() == prev_offset)
+					{ break; }  // file ended early, it must have been truncated
 			}
+			return players_changed;
+		};
 
-			if (res->moved_to)
+		// where reading latest.log got to is saved now and then, so a restart continues from there (see latest_log_resume_t)
+		// it is next to the snapshot, since it is only worth it when the archives don't have to be parsed either
+		const std::filesystem::path resume_path = server.snapshot_path.empty() ? std::filesystem::path() : std::filesystem::path(server.snapshot_path + ".latest");
+		constexpr auto resume_save_interval = std::chrono::minutes(1);  // at most this much of latest.log is parsed again after a restart
+		std::pair<std::pair<std::uint64_t, std::uint64_t>, std::uint64_t> resume_saved{};  // file identity and offset that were saved last
+		auto resume_save_tp = std::chrono::steady_clock::now();  // when it was saved last
+		// @return how long the log reading loop can wait for so saving the resume point isn't late, or nullopt if it is up to date
+		const auto resume_timeout = [&]() -> std::optional<std::chrono::milliseconds>
+		{
+			if (resume_path.empty() || !tailer.is_open() || resume_saved == std::pair(tailer.identity(), tailer.parsed_offset()))
+				{ return std::nullopt; }
+			return std::chrono::ceil<std::chrono::milliseconds>(resume_save_tp + resume_save_interval - std::chrono::steady_clock::now());
+		};
+		// also saved before it is due if another thread requested it (see server_shard::save_resume_requested)
+		// it is written by file_writer, and counts as saved once it is queued. if writing it fails, it is saved again once more of latest.log is read
+		const auto save_resume_if_due = [&]()
+		{
+			const bool requested = shard.save_resume_requested.load();
+			const auto timeout = resume_timeout();
+			if (timeout && (requested || timeout.value() <= std::chrono::milliseconds::zero()))
 			{
-				std::string_view moved_to(res->moved_to->first.get(), res->moved_to->second);
-				if (!moved_to.ends_with(".log"))
+				const std::uint64_t offset = tailer.parsed_offset();
+				const auto tail_hash = tailer.hash_range(offset - std::min(offset, latest_log_resume_t::tail_size), offset);
+				resume_save_tp = std::chrono::steady_clock::now();
+				if (tail_hash)
 				{
-					std::cout << "WARNING: latest.log was moved to file with unexpected extension (expected .log), ignoring: " << moved_to << std::endl;
+					resume_saved = { tailer.identity(), offset };
+					// the thread that requested it waits until it is on disk
+					queue_latest_log_resume(file_writer, resume_path, { read_manifest, server.logs_format, parse_ctx, tailer.identity(), offset,
+						tailer.parsed_hash(), tail_hash.value(), parse_data, parse_lag, parse_uptime }, [&shard, requested](bool)
+						{
+							if (requested)
+								{ shard.save_resume_requested = false; }
+						});
+					return;
 				}
-				else
+			}
+			if (requested)
+				{ shard.save_resume_requested = false; }
+		};
+		// continue from the saved resume point instead of the start of latest.log, if it is of the open file, the part of it that was read
+		// is unchanged, and the archives before it are the same
+		const auto resume_latest_log = [&]()
+		{
+			if (resume_path.empty())
+				{ return; }
+			auto resume = load_latest_log_resume(resume_path, server.log_path);
+			if (!resume)
+				{ return; }
+			const auto coverage = snapshot_coverage(resume->manifest, read_manifest);
+			if (resume->format != server.logs_format || !coverage || coverage.value() != read_manifest.size() || resume->file_id != tailer.identity() ||
+				resume->offset > tailer.size().value_or(0) ||
+				tailer.hash_range(resume->offset - std::min(resume->offset, latest_log_resume_t::tail_size), resume->offset) != resume->tail_hash)
+			{
+				log_message(log_severity::info, log_prefix + "latest.log or the archives changed since the resume point was saved, reading latest.log from the start");
+				return;
+			}
+			parse_data = std::move(resume->data);
+			parse_ctx = std::move(resume->ctx);
+			parse_lag = std::move(resume->lag);
+			parse_uptime = std::move(resume->uptime);
+			tailer.seek(resume->offset, resume->prefix_hash);
+			// so truncating it doesn't go back to the start
+			checkpoints.emplace_back(resume->offset, resume->prefix_hash, parse_data, parse_ctx, parse_lag.size(), parse_uptime);
+			count_checkpoint_memory();
+			resume_saved = { resume->file_id, resume->offset };
+			log_message(log_severity::info, log_prefix + std::format("Resuming latest.log from byte {}", resume->offset));
+		};
+
+		// archives put in the logs directory since it was read are found by listing it now and then (see archive_scanner)
+		constexpr auto archive_scan_interval = std::chrono::minutes(1);
+		archive_scanner archive_scan;
+		auto archive_scan_tp = std::chrono::steady_clock::now() + archive_scan_interval;  // when to list it next
+		// read the archives that were added, each run of them between two that were already read in one go, and add their sessions to history
+		// where they belong by time (see session_history::insert), so only the segments around them are merged again
+		// players online across the boundary with an archive that was already read only have the part of their session in the new one
+		// @return whether anything was added
+		const auto read_new_archives = [&]()
+		{
+			archive_scan_tp = std::chrono::steady_clock::now() + archive_scan_interval;
+			const auto timezone = shard.logs_timezone.load();
+			// the archive latest.log is moved to has its date, and may be listed before the move is handled
+			const std::chrono::year_month_day end_day(std::chrono::floor<std::chrono::days>(timezone->to_local(tailer.is_open() ?
+				parse_ctx.date_tp : std::chrono::system_clock::now())));
+			auto [files, compressed] = archive_scan.scan(server.log_path, read_manifest, history_first_day(), end_day);
+			// the manifest is pointed at the files that exist now, so they can be parsed again for old ranges (see archive_range_cache).
+			// snapshots match them either way (see snapshot_coverage)
+			const auto file_order = [](const log_manifest_entry& entry)
+				{ return std::pair(entry.date, entry.index); };
+			if (!compressed.empty())
+			{
+				for (auto& file : compressed)
+				{
+					const auto it = std::ranges::lower_bound(read_manifest, file_order(file), {}, file_order);
+					file.summary = it->summary;
+					file.ingest = it->ingest;
+					*it = std::move(file);
+				}
+				publish_archives();
+			}
+			if (files.empty())
+				{ return false; }
+			log_message(log_severity::info, log_prefix + std::format("Reading {} log files added to the logs directory, {} to {}", files.size(),
+				files.front().path.filename().string(), files.back().path.filename().string()));
+			const auto manifest_pos = [&](const log_manifest_entry& entry)
+				{ return std::ranges::upper_bound(read_manifest, file_order(entry), {}, file_order) - read_manifest.begin(); };
+			for (std::size_t first = 0; first < files.size();)
+			{
+				const auto pos = manifest_pos(files[first]);
+				std::size_t last = first + 1;
+				while (last < files.size() && manifest_pos(files[last]) == pos)
+					{ last++; }
+				std::vector<archive_summary> summaries;
+				const log_data_t data = parse_archives(std::vector(files.begin() + first, files.begin() + last), server.logs_format, timezone, merge_gap,
+					history.get_segments(), &summaries);
+				history.insert(data, merge_gap);
+				for (std::size_t i = 0; i < summaries.size(); i++)
+					{ files[first + i].summary = summaries[i]; }
+				read_manifest.insert(read_manifest.begin() + pos, std::make_move_iterator(files.begin() + first), std::make_move_iterator(files.begin() + last));
+				first = last;
+			}
+			// segments of the snapshot are for files archived from latest.log, so it is written again (unless history is rolled up, see update_snapshot)
+			if (snapshot_valid)
+			{
+				finish_snapshot_save();
+				if (config.retention_days == 0)
+					{ start_snapshot_save(persistent_ctx); }
+				else if (snapshot_next_segment)
+				{
+					log_message(log_severity::info, log_prefix + "The snapshot does not have the log files that were added, they will be read again on the next start");
+					snapshot_next_segment.reset();
+				}
+			}
+			apply_retention();
+			apply_memory_limit();
+			publish_archives();
+			data_generation++;
+			return true;
+		};
+
+		// parse latest.log initially
+		if (tailer.open())
+		{
+			QC_TRACE_SCOPE("initial parse of latest.log");
+			update_date_tp(true);
+			resume_latest_log();
+			read_latest_log(tailer.size().value_or(0));
+		}
+		reconcile_rcon_players();
+		publish_player_count(shard, parse_ctx);
+
+		data_generation++;  // graphs cached while loading are outdated
+		publish_data();
+		log_message(log_severity::info, log_prefix + "Finished initial parse");
+		live_deltas.enabled = true;
+
+		constexpr std::size_t max_events = 64;  // per batch
+		std::vector<file_watcher::result_t> events;
+		auto wake_tp = std::chrono::steady_clock::now();  // when the watcher last woke this loop up
+		while (true)
+		{
+			const std::uint64_t prev_generation = data_generation;
+			if (!watcher.poll_batch(events, max_events))
+			{
+				// TODO: handle error (close and reopen watcher?)
+				log_message(log_severity::fatal, log_prefix + "Could not poll for changes in directory");
+				return false;
+			}
+			// published once for the whole batch
+			bool data_changed = false;
+			for (auto& res : events)
+			{
+				QC_ALLOCATION_SCOPE(tail, 1);
+				if (res.event_create)
+				{
+					// the initial parse may have opened latest.log already, in which case it shouldn't be read again
+					if (tailer.replaced())
+					{
+						tailer.open();
+						clear_checkpoints();
+					}
+					if (update_date_tp(tailer.is_open()))
+						{ data_changed = true; }
+				}
+
+				if (res.event_create_moved)
+				{
+					// the checkpoints are of the previous file, but the new one may start with the same data
+					tailer.open();
+					const auto size = tailer.size().value_or(0);
+					if (size == 0)
+					{
+						if (update_date_tp(tailer.is_open()))
+							{ data_changed = true; }
+					}
+					else
+					{
+						const auto offset = rollback_latest_log(size);
+						log_message(log_severity::warning, log_prefix + std::format("latest.log shouldn't be moved to (from another file), discarding data and reading from {}",
+							(offset == 0) ? std::string("start") : std::format("checkpoint at byte {}", offset)));
+						read_latest_log(size);
+						publish_player_count(shard, parse_ctx);
+						data_changed = true;
+						data_generation++;
+					}
+				}
+
+				// the kernel's event queue overflowed, so latest.log may have been replaced without a create or move event. if it was, the new file
+				// is read as if it continued the old one, and the old one is only added to history once it is read as an archive after a restart
+				if (res.event_lost)
+				{
+					log_message(log_severity::warning, log_prefix + "Some changes to latest.log were missed (too many events at once), checking it again");
+					if (tailer.replaced())
+					{
+						tailer.open();
+						clear_checkpoints();
+						if (update_date_tp(tailer.is_open()))
+							{ data_changed = true; }
+					}
+				}
+
+				if (res.event_modify)
+				{
+					if (!tailer.is_open())
+						{ tailer.open(); }  // it didn't exist before
+					const auto size = tailer.size().value_or(0);
+					bool do_update = false;
+					if (size < tailer.get_offset())
+					{
+						const auto offset = rollback_latest_log(size);
+						log_message(log_severity::warning, log_prefix + std::format("latest.log shrunk somehow, discarding data and re-reading from {}",
+							(offset == 0) ? std::string("start") : std::format("checkpoint at byte {}", offset)));
+						do_update = true;
+						data_changed = true;
+						data_generation++;
+					}
+					if (size > tailer.get_offset())
+					{
+						get_metrics().watch_to_parse.observe(std::chrono::steady_clock::now() - wake_tp);
+						// other lines don't change sessions (or lag and uptime), so graphs cached for the current generation are still valid
+						const std::size_t prev_lag = parse_lag.size();
+						const auto prev_uptime = uptime_state();
+						const bool players_changed = read_latest_log(size);
+						if (players_changed || parse_lag.size() != prev_lag || uptime_state() != prev_uptime)
+							{ data_generation++; }
+						if (players_changed || do_update)
+							{ publish_player_count(shard, parse_ctx); }
+						data_changed = true;
+					}
+				}
+
+				if (res.moved_to)
+				{
+					// the open file is the one that was moved, so anything written to it since the last modify event is still readable
+					if (tailer.is_open())
+					{
+						const auto size = tailer.size().value_or(0);
+						bool players_changed = false;
+						if (size > tailer.get_offset())
+						{
+							players_changed = read_latest_log(size);
+							data_changed = true;
+						}
+						// nothing more will be written to it, so the last line is complete even without a newline
+						if (const auto last_line = tailer.flush(); !last_line.empty())
+						{
+							players_changed = parse_new_lines(last_line, parse_ctx, live_consumer) || players_changed;
+							data_changed = true;
+						}
+						if (players_changed)
+						{
+							data_generation++;
+							publish_player_count(shard, parse_ctx);
+						}
+					}
+					tailer.close();
+					clear_checkpoints();
+
+					std::string_view moved_to(res.moved_to->first.get(), res.moved_to->second);
+					if (!moved_to.ends_with(".log"))
+					{
+						log_message(log_severity::warning, log_prefix + std::format("latest.log was moved to file with unexpected extension (expected .log), ignoring: {}", moved_to));
+					}
+					else
+					{
+						const auto moved_path = std::filesystem::path(server.log_path) / moved_to;
+						auto entry = make_log_manifest_entry(std::filesystem::directory_entry(moved_path));
+						// it may have been compressed already, if the move was handled late
+						if (!entry)
+							{ entry = detail::find_compressed_archive(moved_path); }
+						if (entry)
+						{
+							entry->summary = summarize_sessions(parse_data);
+							read_manifest.emplace_back(std::move(entry.value()));
+						}
+						else if (snapshot_valid)
+						{
+							log_message(log_severity::warning, log_prefix + std::format("latest.log was moved to {}, which is not a valid log file name, snapshots will not be updated", moved_to));
+							snapshot_valid = false;
+						}
+						// "commit" latest.log data/ctx to persistent
+						history.commit(parse_data);
+						commit_lag();
+						// the new latest.log logs the uuid of everyone who joins, so only players still online are kept
+						parse_ctx.player_info.remove_offline();
+						persistent_ctx = parse_ctx;
+						if (snapshot_valid)
+							{ update_snapshot(); }
+						parse_data.clear();
+						parse_lag.clear();
+						parse_uptime.clear();
+						apply_retention();
+						apply_memory_limit();
+						publish_archives();
+						data_changed = true;
+					}
+				}
+			}
+			if (data_changed)
+				{ publish_data(); }
+			if (data_generation != prev_generation)
+				{ prerender_tp = std::chrono::steady_clock::now() + prerender_delay; }
+
+			if (events.size() < max_events)  // don't wait if the batch was full; read more immediately
+			{
+				// wake up in time for the next pre-render or resume point save, if there is one
+				auto timeout = prerender_timeout();
+				if (const auto resume = resume_timeout(); resume && (!timeout || resume.value() < timeout.value()))
+					{ timeout = resume; }
+				if (const auto scan = std::chrono::ceil<std::chrono::milliseconds>(archive_scan_tp - std::chrono::steady_clock::now()); !timeout || scan < timeout.value())
+					{ timeout = scan; }
+				if (!watcher.wait(timeout))
+				{
+					log_message(log_severity::fatal, log_prefix + "Could not wait for changes in directory");
+					return false;
+				}
+				wake_tp = std::chrono::steady_clock::now();
+			}
+
+			if (std::chrono::steady_clock::now() >= archive_scan_tp && read_new_archives())
+			{
+				publish_data();
+				prerender_tp = std::chrono::steady_clock::now() + prerender_delay;
+			}
+			prerender_if_due();
+			save_resume_if_due();
+		}
+	};
+	std::optional<replication_client> primary;
+	if (replica)
+	{
+		// the primary's data is published as if the shards had read it, so everything that serves from shards works the same
+		primary.emplace(config.replicate_from_address, config.replicate_from_port, bot.token,
+			[&shards, &feed](std::string_view server_name, std::shared_ptr<const published_data_t> data)
+		{
+			const auto it = std::ranges::find(shards, server_name, [](const auto& shard) -> std::string_view { return shard->config.name; });
+			if (it == shards.end())
+			{
+				log_message(log_severity::warning, std::format("The primary sent data of server \"{}\", which isn't in {}", server_name, config_filename));
+				return;
+			}
+			(*it)->published.store(std::move(data));
+			// joins and leaves aren't replicated, so live feed clients get the new state instead
+			if (feed)
+				{ feed->resync(); }
+		});
+	}
+	else
+	{
+		for (std::size_t i = 0; i < shards.size(); i++)
+		{
+			shards[i]->thread = std::thread([&run_server, &shard = *shards[i], i]()
+			{
+				if (!run_server(shard, i))
+					{ std::exit(-1); }
+			});
+		}
+	}
+
+	// read the config file again and use what can change while running, without touching parsed data
+	// a config that can't be parsed is ignored, so a mistake while editing it doesn't stop the bot
+	const auto reload_config = [&]()
+	{
+		std::shared_ptr<const config_t> new_config;
+		try
+		{
+			std::string token;
+			new_config = std::make_shared<const config_t>(read_config(token));
+		}
+		catch (const std::exception& e)
+		{
+			log_message(log_severity::error, std::format("Keeping the current config, JSON parsing from {} failed: {}", config_filename, e.what()));
+			return;
+		}
+		const auto old_config = live_config.exchange(new_config);
+		for (const std::string_view key : get_restart_keys(*old_config, *new_config))
+			{ log_message(log_severity::warning, std::format("{} changed in {}, restart the bot to use it", key, config_filename)); }
+
+		// the history parsed with the old timezone is kept, parsing it again would lose the sessions of log files that have been deleted since
+		for (const auto& shard : shards)
+		{
+			const auto it = std::ranges::find(new_config->servers, shard->config.name, &server_config_t::name);
+			if (it == new_config->servers.end() || it->logs_timezone == shard->logs_timezone.load())
+				{ continue; }
+			shard->logs_timezone = it->logs_timezone;
+			const std::string log_prefix = shard->config.name.empty() ? std::string() : std::format("[{}] ", shard->config.name);
+			log_message(log_severity::info, log_prefix + std::format("Using logs_timezone {} for lines read from now on", it->logs_timezone->name()));
+		}
+		if (old_config->svg_row_paths != new_config->svg_row_paths || old_config->png_compression_level != new_config->png_compression_level
+			|| old_config->graph_row_limit != new_config->graph_row_limit || old_config->attachment_max_bytes != new_config->attachment_max_bytes)
+		{
+			for (std::size_t view = 0; view < num_views; view++)
+				{ caches[view].graphs.clear(); }
+		}
+		if (old_config->status_0 != new_config->status_0 || old_config->status_1 != new_config->status_1 || old_config->status_multi != new_config->status_multi)
+		{
+			std::scoped_lock lock(player_count_mutex);
+			std::size_t total = 0;
+			for (const auto& cur : shards)
+				{ total += cur->num_players; }
+			update_player_count(presence, *new_config, total, last_player_count, true);
+		}
+		log_message(log_severity::info, std::format("Reloaded {}", config_filename));
+	};
+
+	if (handoff)
+	{
+		archives_loaded.wait();
+		log_message(log_severity::info, "History is loaded, asking the running process to exit");
+		if (!handoff->take_over(std::chrono::seconds(30)))
+			{ log_message(log_severity::error, "The running process didn't exit after being asked to, continuing anyway"); }
+		handoff.reset();
+		taken_over = true;
+		taken_over.notify_all();
+		start_metrics();
+		start_http();
+		start_replication();
+	}
+	// for the next process to take over from this one
+	std::optional<handoff_listener> handoff_server;
+	if (config.handoff_port != 0 && !replica)
+	{
+		try
+		{
+			// the shards reading latest.log save where they got to, so the new process only reads what was written since
+			handoff_server.emplace(config.handoff_port, token_hash, [&shards]()
+			{
+				for (const auto& shard : shards)
+				{
+					if (file_watcher* const watcher = shard->watcher.load())
+					{
+						shard->save_resume_requested = true;
+						watcher->wakeup();
+					}
+				}
+				const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+				for (const auto& shard : shards)
 				{
-					// remove extension
-					read_files.emplace_back(moved_to.substr(0, moved_to.size() - 4));
-					// "commit" latest.log data/ctx to persistent
-					// no need to lock because we aren't writing to parse_data_ctx
-					persistent_data_ctx = parse_data_ctx;
+					while (shard->save_resume_requested.load() && std::chrono::steady_clock::now() < deadline)
+						{ std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
 				}
-				prev_size = 0;
+			});
+		}
+		catch (const std::runtime_error& e)
+		{
+			log_message(log_severity::error, e.what());
+		}
+	}
+
+	// the config file is watched on this thread while the servers are read on theirs
+	// editors often write a file in several steps, or write another one and rename it over it, so it is only read once it hasn't changed for a moment
+	constexpr auto config_reload_delay = std::chrono::milliseconds(500);
+	try
+	{
+#ifdef _WIN32
+		bool notify_on_last_write = true;
+#define FILE_WATCHER_USER_DATA &notify_on_last_write
+#else
+#define FILE_WATCHER_USER_DATA nullptr
+#endif
+		file_watcher config_watcher(".", config_filename, FILE_WATCHER_USER_DATA);
+#undef FILE_WATCHER_USER_DATA
+		std::vector<file_watcher::result_t> events;
+		bool changed = false;
+		while (true)
+		{
+			const auto wait_res = config_watcher.wait(changed ? std::optional(config_reload_delay) : std::nullopt);
+			if (!wait_res)
+			{
+				log_message(log_severity::error, std::format("Could not wait for changes to {}, it won't be reloaded", config_filename));
+				break;
+			}
+			if (wait_res.value() == file_watcher::wait_result_t::timeout)
+			{
+				changed = false;
+				reload_config();
+				continue;
+			}
+			if (!config_watcher.poll_batch(events))
+			{
+				log_message(log_severity::error, std::format("Could not poll for changes to {}, it won't be reloaded", config_filename));
+				break;
 			}
+			changed = changed || std::ranges::any_of(events, [](const file_watcher::result_t& res) { return res.event_create || res.event_create_moved || res.event_modify; });
 		}
-		else if (res->state == file_watcher_state_t::no_data)  // don't sleep if state is read_more; read more immediately
-			{ std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
 	}
+	catch (const std::runtime_error& e)
+	{
+		log_message(log_severity::error, std::format("Could not watch {} for changes, it won't be reloaded: {}", config_filename, e.what()));
+	}
+
+	for (const auto& shard : shards)
+	{
+		if (shard->thread.joinable())
+			{ shard->thread.join(); }
+	}
+	return 0;
 }
@@ -0,0 +1,249 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#undef WIN32_LEAN_AND_MEAN
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace detail
+{
+#ifndef _WIN32
+	// for files that are read once from start to end (e.g. archived logs), so the kernel reads further ahead
+	inline void advise_read_once(int fd) noexcept
+	{
+#ifdef POSIX_FADV_SEQUENTIAL
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	}
+	// once a file given to advise_read_once has been read, drop it from the page cache, so reading gigabytes of logs at startup
+	// doesn't evict what other processes on the machine use (e.g. the minecraft server's world). the logs are read again from disk if needed
+	inline void drop_cached(int fd) noexcept
+	{
+#ifdef POSIX_FADV_DONTNEED
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	}
+#endif
+
+	// read-only memory mapping of an entire file
+	// the mapping is shared and read-only, so it maps the page cache itself (shared with anything else reading the file) and never makes copies of its pages
+	class mapped_file
+	{
+	private:
+		const char* ptr = nullptr;
+		std::size_t size = 0;
+#ifndef _WIN32
+		int drop_fd = -1;  // kept open for drop_cached on close if the file was opened with read_once
+#endif
+
+	public:
+		mapped_file() = default;
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		mapped_file(mapped_file&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)), size(std::exchange(other.size, 0))
+#ifndef _WIN32
+			, drop_fd(std::exchange(other.drop_fd, -1))
+#endif
+			{}
+		mapped_file& operator=(mapped_file&& other) noexcept
+		{
+			if (this != &other)
+			{
+				close();
+				ptr = std::exchange(other.ptr, nullptr);
+				size = std::exchange(other.size, 0);
+#ifndef _WIN32
+				drop_fd = std::exchange(other.drop_fd, -1);
+#endif
+			}
+			return *this;
+		}
+		~mapped_file() { close(); }
+
+		// map `p`, unmapping any previous file
+		// empty files are never mapped, but this still succeeds and data() will be empty
+		// @param read_once  the file is read once from start to end and then closed, so it is read ahead and dropped from the
+		//                   page cache on close (see drop_cached). windows only gets the read ahead (FILE_FLAG_SEQUENTIAL_SCAN, which every file has)
+		// @return true on success
+		bool open(const std::filesystem::path& p, bool read_once = false)
+		{
+			close();
+#ifdef _WIN32
+			HANDLE file_handle = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file_handle == INVALID_HANDLE_VALUE)
+				{ return false; }
+			LARGE_INTEGER file_size;
+			if (!GetFileSizeEx(file_handle, &file_size))
+			{
+				CloseHandle(file_handle);
+				return false;
+			}
+			if (file_size.QuadPart == 0)
+			{
+				CloseHandle(file_handle);
+				return true;
+			}
+			HANDLE mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file_handle);  // mapping keeps a reference to the file
+			if (mapping_handle == nullptr)
+				{ return false; }
+			void* view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping_handle);  // view keeps a reference to the mapping
+			if (view == nullptr)
+				{ return false; }
+			ptr = static_cast<const char*>(view);
+			size = static_cast<std::size_t>(file_size.QuadPart);
+#else
+			const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd == -1)
+				{ return false; }
+			struct stat st;
+			if (fstat(fd, &st) == -1)
+			{
+				::close(fd);
+				return false;
+			}
+			if (st.st_size == 0)
+			{
+				::close(fd);
+				return true;
+			}
+			if (read_once)
+				{ advise_read_once(fd); }
+			void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (view == MAP_FAILED)
+			{
+				::close(fd);
+				return false;
+			}
+			ptr = static_cast<const char*>(view);
+			size = st.st_size;
+			if (read_once)
+			{
+				// the file is scanned in parallel chunks, so all of it is read ahead rather than only what follows the last access
+				posix_madvise(view, size, POSIX_MADV_WILLNEED);
+				drop_fd = fd;
+			}
+			else
+				{ ::close(fd); }  // mapping stays valid after closing fd
+#endif
+			return true;
+		}
+
+		void close() noexcept
+		{
+			if (ptr != nullptr)
+			{
+#ifdef _WIN32
+				UnmapViewOfFile(ptr);
+#else
+				munmap(const_cast<char*>(ptr), size);
+#endif
+			}
+#ifndef _WIN32
+			// after unmapping, since mapped pages aren't dropped
+			if (drop_fd != -1)
+			{
+				drop_cached(drop_fd);
+				::close(drop_fd);
+			}
+			drop_fd = -1;
+#endif
+			ptr = nullptr;
+			size = 0;
+		}
+
+		// @return view of entire file contents, valid until close() or open() is called
+		[[nodiscard]] std::string_view data() const noexcept { return { ptr, size }; }
+	};
+
+	// read a file that is read once from start to end (see mapped_file::open's read_once), e.g. one that can't be mapped,
+	// or a compressed file that is decompressed into another buffer anyway
+	// @param size  expected size of the file. a file that has grown since is only read up to it
+	// @param out  receives the contents (reused between calls to avoid reallocating)
+	// @return false if the file couldn't be opened or read, in which case out has what was read before the error
+	inline bool read_file_once(const std::filesystem::path& p, std::uint64_t size, std::string& out)
+	{
+		bool ok = true;
+#ifdef _WIN32
+		HANDLE file_handle = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE)
+		{
+			out.clear();
+			return false;
+		}
+		out.resize_and_overwrite(static_cast<std::size_t>(size), [file_handle, &ok](char* buf, std::size_t buf_size)
+		{
+			std::size_t total = 0;
+			while (total < buf_size)
+			{
+				DWORD amount;
+				const DWORD to_read = static_cast<DWORD>(std::min<std::size_t>(buf_size - total, 1 << 30));
+				if (!ReadFile(file_handle, buf + total, to_read, &amount, nullptr))
+				{
+					ok = false;
+					break;
+				}
+				if (amount == 0)
+					{ break; }  // end of file
+				total += amount;
+			}
+			return total;
+		});
+		CloseHandle(file_handle);
+#else
+		const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+		{
+			out.clear();
+			return false;
+		}
+		advise_read_once(fd);
+		out.resize_and_overwrite(static_cast<std::size_t>(size), [fd, &ok](char* buf, std::size_t buf_size)
+		{
+			std::size_t total = 0;
+			while (total < buf_size)
+			{
+				const ssize_t amount = ::read(fd, buf + total, buf_size - total);
+				if (amount == -1)
+				{
+					if (errno == EINTR)
+						{ continue; }
+					ok = false;
+					break;
+				}
+				if (amount == 0)
+					{ break; }  // end of file
+				total += amount;
+			}
+			return total;
+		});
+		drop_cached(fd);
+		::close(fd);
+#endif
+		return ok;
+	}
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef MEMORY_CENSUS_H
+#define MEMORY_CENSUS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "small_vector.h"
+
+// estimated memory used by some data, for sizing containers and checking what features that save memory do
+// bytes are what the data's own containers have allocated (capacities, not sizes) plus the objects themselves,
+// allocator overhead isn't known, so the real use is somewhat higher
+struct memory_usage
+{
+	std::size_t bytes = 0;  // including string_bytes
+	std::size_t string_bytes = 0;  // allocated by strings (names and such)
+	std::size_t players = 0;
+	std::size_t sessions = 0;
+
+	memory_usage& operator+=(const memory_usage& other) noexcept
+	{
+		bytes += other.bytes;
+		string_bytes += other.string_bytes;
+		players += other.players;
+		sessions += other.sessions;
+		return *this;
+	}
+};
+
+namespace detail
+{
+	// bytes of a std::map or std::set node besides its value (color and three pointers in the common implementations)
+	inline constexpr std::size_t tree_node_overhead = 4 * sizeof(void*);
+
+	// @return bytes allocated by `str`, 0 if it fits in the string itself
+	template<typename string_t>
+	[[nodiscard]] inline std::size_t string_heap_bytes(const string_t& str) noexcept
+		{ return (str.capacity() > string_t().capacity()) ? str.capacity() + 1 : 0; }
+
+	// @return bytes allocated by `vec` for its elements (not anything the elements allocate)
+	template<typename vector_t>
+	[[nodiscard]] inline std::size_t vector_heap_bytes(const vector_t& vec) noexcept
+		{ return vec.capacity() * sizeof(typename vector_t::value_type); }
+	template<typename T, std::size_t N>
+	[[nodiscard]] inline std::size_t vector_heap_bytes(const small_vector<T, N>& vec) noexcept
+		{ return vec.heap_bytes(); }
+
+	// @return usage of strings in `strings`, and of the vector holding them
+	template<typename vector_t>
+	[[nodiscard]] inline memory_usage strings_memory(const vector_t& strings) noexcept
+	{
+		memory_usage res{ .bytes = vector_heap_bytes(strings) };
+		for (const auto& str : strings)
+			{ res.string_bytes += string_heap_bytes(str); }
+		res.bytes += res.string_bytes;
+		return res;
+	}
+}
+
+#endif
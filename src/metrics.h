@@ -0,0 +1,236 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+
+#include "alloc_counter.h"
+
+// counters and histograms of what the bot does, in the prometheus text format (see metrics_server.h)
+// updating them is a relaxed atomic add on a shard of the calling thread, so they can be used on hot paths:
+// threads don't contend for the same cache line unless there are more threads than shards
+namespace detail
+{
+	inline constexpr std::size_t metrics_shards = 8;
+	inline constexpr std::size_t cache_line_size = 64;
+
+	// @return shard of the calling thread, threads get them in turn
+	[[nodiscard]] inline std::size_t metrics_shard_index() noexcept
+	{
+		static std::atomic<std::size_t> next_index = 0;
+		thread_local const std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed) % metrics_shards;
+		return index;
+	}
+
+	// metric names and labels are written as given, they must already be valid
+	// @param labels  e.g. format="png", or empty for none
+	inline void append_metric_line(std::string& out, std::string_view name, std::string_view labels, std::uint64_t value)
+	{
+		if (labels.empty())
+			{ out += std::format("{} {}\n", name, value); }
+		else
+			{ out += std::format("{}{{{}}} {}\n", name, labels, value); }
+	}
+
+	inline void append_metric_line(std::string& out, std::string_view name, std::string_view labels, double value)
+	{
+		if (labels.empty())
+			{ out += std::format("{} {}\n", name, value); }
+		else
+			{ out += std::format("{}{{{}}} {}\n", name, labels, value); }
+	}
+
+	// @param type  "counter" or "histogram"
+	inline void append_metric_header(std::string& out, std::string_view name, std::string_view type, std::string_view help)
+		{ out += std::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type); }
+}
+
+class metrics_counter
+{
+private:
+	struct alignas(detail::cache_line_size) shard
+	{
+		std::atomic<std::uint64_t> value = 0;
+	};
+	std::array<shard, detail::metrics_shards> shards;
+
+public:
+	void add(std::uint64_t n = 1) noexcept
+		{ shards[detail::metrics_shard_index()].value.fetch_add(n, std::memory_order_relaxed); }
+
+	// @return sum of all shards, which may miss adds that are happening at the same time
+	[[nodiscard]] std::uint64_t value() const noexcept
+	{
+		std::uint64_t res = 0;
+		for (const shard& cur : shards)
+			{ res += cur.value.load(std::memory_order_relaxed); }
+		return res;
+	}
+
+	// @param labels  see detail::append_metric_line
+	void append_to(std::string& out, std::string_view name, std::string_view labels = {}) const
+		{ detail::append_metric_line(out, name, labels, value()); }
+};
+
+// durations sorted into buckets from half a millisecond to a minute
+class metrics_histogram
+{
+public:
+	// upper bounds of the buckets in seconds, there is one more for anything longer
+	static constexpr std::array<double, 16> bounds = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60 };
+
+private:
+	struct alignas(detail::cache_line_size) shard
+	{
+		std::array<std::atomic<std::uint64_t>, bounds.size() + 1> counts{};  // not cumulative
+		std::atomic<std::uint64_t> sum_ns = 0;
+	};
+	std::array<shard, detail::metrics_shards> shards;
+
+public:
+	void observe(std::chrono::steady_clock::duration duration) noexcept
+	{
+		const double secs = std::chrono::duration<double>(duration).count();
+		std::size_t bucket = 0;
+		while (bucket < bounds.size() && secs > bounds[bucket])
+			{ bucket++; }
+		shard& cur = shards[detail::metrics_shard_index()];
+		cur.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		cur.sum_ns.fetch_add((ns < 0) ? 0 : static_cast<std::uint64_t>(ns), std::memory_order_relaxed);
+	}
+
+	// write the buckets, sum and count (the header is written separately, so labeled histograms can share one)
+	// @param labels  see detail::append_metric_line
+	void append_to(std::string& out, std::string_view name, std::string_view labels = {}) const
+	{
+		std::array<std::uint64_t, bounds.size() + 1> counts{};
+		std::uint64_t sum_ns = 0;
+		for (const shard& cur : shards)
+		{
+			for (std::size_t i = 0; i < counts.size(); i++)
+				{ counts[i] += cur.counts[i].load(std::memory_order_relaxed); }
+			sum_ns += cur.sum_ns.load(std::memory_order_relaxed);
+		}
+		const std::string bucket_name = std::format("{}_bucket", name);
+		const std::string_view separator = labels.empty() ? "" : ",";
+		std::uint64_t cumulative = 0;
+		for (std::size_t i = 0; i < counts.size(); i++)
+		{
+			cumulative += counts[i];
+			const std::string le = (i < bounds.size()) ? std::format("{}", bounds[i]) : std::string("+Inf");
+			detail::append_metric_line(out, bucket_name, std::format("{}{}le=\"{}\"", labels, separator, le), cumulative);
+		}
+		detail::append_metric_line(out, std::format("{}_sum", name), labels, static_cast<double>(sum_ns) / 1e9);
+		detail::append_metric_line(out, std::format("{}_count", name), labels, cumulative);
+	}
+
+	// measures the time until it is destroyed
+	class timer
+	{
+	private:
+		metrics_histogram& histogram;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	public:
+		explicit timer(metrics_histogram& histogram) noexcept : histogram(histogram) {}
+		timer(const timer&) = delete;
+		timer& operator=(const timer&) = delete;
+		~timer()
+			{ histogram.observe(std::chrono::steady_clock::now() - start); }
+	};
+};
+
+// everything the bot measures about itself
+struct bot_metrics
+{
+	metrics_counter lines_parsed;  // of latest.log or received over the network, archived logs read on startup aren't counted
+	metrics_counter bytes_tailed;
+	metrics_counter bytes_received;  // of lines pushed over the network (see log_listener)
+	metrics_histogram watch_to_parse;  // from the watcher waking up the log reading loop to parsing what was written
+	metrics_histogram parse_batch;  // reading and parsing what was written at once
+	metrics_histogram publish;  // copying the data for slash commands and publishing it
+	metrics_histogram publish_lock;  // storing the published data, the only point where commands and the log reading loop share a lock
+	metrics_histogram render_svg, render_png;
+	metrics_counter graph_cache_hits, graph_cache_misses;
+	metrics_counter presence_updates;  // sent to discord
+	metrics_histogram discord_rest;  // responses with graphs, from sending to the reply
+
+#ifdef QC_COUNT_ALLOCATIONS
+	// allocations in total and in each scope, with the units of work done in the scope, so rates give allocations per line and such
+	static void append_allocations(std::string& out)
+	{
+		const allocation_count total = total_allocations();
+		detail::append_metric_header(out, "qc_allocations_total", "counter", "Allocations by all threads.");
+		detail::append_metric_line(out, "qc_allocations_total", {}, total.allocations);
+		detail::append_metric_header(out, "qc_allocated_bytes_total", "counter", "Bytes allocated by all threads.");
+		detail::append_metric_line(out, "qc_allocated_bytes_total", {}, total.bytes);
+
+		const allocation_scopes& scopes = get_allocation_scopes();
+		const allocation_scope_stats* const all_stats[] = { &scopes.parse, &scopes.tail, &scopes.render };
+		detail::append_metric_header(out, "qc_scope_allocations_total", "counter", "Allocations in a scope.");
+		for (const allocation_scope_stats* stats : all_stats)
+			{ detail::append_metric_line(out, "qc_scope_allocations_total", std::format("scope=\"{}\"", stats->name), stats->allocations.load(std::memory_order_relaxed)); }
+		detail::append_metric_header(out, "qc_scope_allocated_bytes_total", "counter", "Bytes allocated in a scope.");
+		for (const allocation_scope_stats* stats : all_stats)
+			{ detail::append_metric_line(out, "qc_scope_allocated_bytes_total", std::format("scope=\"{}\"", stats->name), stats->bytes.load(std::memory_order_relaxed)); }
+		detail::append_metric_header(out, "qc_scope_units_total", "counter", "Units of work done in a scope.");
+		for (const allocation_scope_stats* stats : all_stats)
+		{
+			detail::append_metric_line(out, "qc_scope_units_total", std::format("scope=\"{}\",unit=\"{}\"", stats->name, stats->unit),
+				stats->units.load(std::memory_order_relaxed));
+		}
+	}
+#endif
+
+	// @return all metrics in the prometheus text format
+	[[nodiscard]] std::string format() const
+	{
+		std::string out;
+		const auto counter = [&out](std::string_view name, std::string_view help, const metrics_counter& value)
+		{
+			detail::append_metric_header(out, name, "counter", help);
+			value.append_to(out, name);
+		};
+		const auto histogram = [&out](std::string_view name, std::string_view help, const metrics_histogram& value)
+		{
+			detail::append_metric_header(out, name, "histogram", help);
+			value.append_to(out, name);
+		};
+		counter("qc_lines_parsed_total", "Lines of latest.log or received over the network parsed.", lines_parsed);
+		counter("qc_bytes_tailed_total", "Bytes of latest.log read.", bytes_tailed);
+		counter("qc_bytes_received_total", "Bytes of log lines received over the network.", bytes_received);
+		histogram("qc_watch_to_parse_seconds", "Time from a file watcher event to parsing what was written.", watch_to_parse);
+		histogram("qc_parse_batch_seconds", "Time to read and parse lines written to latest.log.", parse_batch);
+		histogram("qc_publish_seconds", "Time to copy and publish parsed data for commands.", publish);
+		histogram("qc_publish_lock_seconds", "Time holding the lock of the published data.", publish_lock);
+
+		detail::append_metric_header(out, "qc_graph_render_seconds", "histogram", "Time to render a graph.");
+		render_svg.append_to(out, "qc_graph_render_seconds", "format=\"svg\"");
+		render_png.append_to(out, "qc_graph_render_seconds", "format=\"png\"");
+		detail::append_metric_header(out, "qc_graph_cache_requests_total", "counter", "Graph commands by whether the graph was cached.");
+		graph_cache_hits.append_to(out, "qc_graph_cache_requests_total", "result=\"hit\"");
+		graph_cache_misses.append_to(out, "qc_graph_cache_requests_total", "result=\"miss\"");
+
+		counter("qc_presence_updates_total", "Presence updates sent to Discord.", presence_updates);
+		histogram("qc_discord_rest_seconds", "Time for Discord to respond to a graph being sent.", discord_rest);
+#ifdef QC_COUNT_ALLOCATIONS
+		append_allocations(out);
+#endif
+		return out;
+	}
+};
+
+[[nodiscard]] inline bot_metrics& get_metrics()
+{
+	static bot_metrics instance;
+	return instance;
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+
+#include "logger.h"
+#include "net_socket.h"
+
+// serves GET /metrics over http on its own thread, for prometheus to scrape
+// requests are handled one at a time, which is plenty for a scraper every few seconds
+class metrics_server
+{
+private:
+	using socket_t = detail::socket_t;
+	static constexpr int stop_check_ms = 500;  // how often the thread checks whether to stop
+	static constexpr std::size_t max_request_size = 8192;
+
+	std::function<std::string()> get_body;
+	socket_t listener = detail::invalid_socket;
+	std::atomic<bool> stopping = false;
+	std::thread thread;
+
+	// read the request head, waiting at most a couple of seconds so a client that sends nothing can't block scrapes
+	// @return request line and headers, or empty string if the client didn't send them
+	[[nodiscard]] static std::string read_request(socket_t client)
+	{
+		std::string request;
+		char buf[1024];
+		while (request.size() < max_request_size && request.find("\r\n\r\n") == std::string::npos)
+		{
+			if (detail::poll_socket(client, 2000) <= 0)
+				{ return {}; }
+			const auto num_read = recv(client, buf, sizeof(buf), 0);
+			if (num_read <= 0)
+				{ return {}; }
+			request.append(buf, static_cast<std::size_t>(num_read));
+		}
+		return request;
+	}
+
+	void handle(socket_t client) const
+	{
+		const std::string request = read_request(client);
+		if (request.empty())
+			{ return; }
+		const std::string_view request_line = std::string_view(request).substr(0, request.find("\r\n"));
+		std::string_view status = "200 OK";
+		std::string body;
+		if (!request_line.starts_with("GET "))
+			{ status = "405 Method Not Allowed"; }
+		else if (const std::string_view target = request_line.substr(4, request_line.find(' ', 4) - 4); target != "/metrics" && !target.starts_with("/metrics?"))
+			{ status = "404 Not Found"; }
+		else
+			{ body = get_body(); }
+		std::string response = std::format("HTTP/1.1 {}\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+			status, body.size());
+		response += body;
+		std::ignore = detail::send_all(client, response);
+	}
+
+	void cleanup() noexcept
+	{
+		if (listener != detail::invalid_socket)
+		{
+			detail::close_socket(listener);
+			listener = detail::invalid_socket;
+		}
+		detail::cleanup_sockets();
+	}
+
+	void run()
+	{
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			if (detail::poll_socket(listener, stop_check_ms) <= 0)
+				{ continue; }
+			const socket_t client = accept(listener, nullptr, nullptr);
+			if (client == detail::invalid_socket)
+				{ continue; }
+			handle(client);
+			detail::close_socket(client);
+		}
+	}
+
+public:
+	// @param address  ipv4 address to listen on, e.g. 127.0.0.1 for only this machine
+	// @param get_body  called on the server's thread for each scrape, returns the metrics (see bot_metrics::format)
+	// @throws std::runtime_error if the address is invalid or can't be listened on
+	metrics_server(const std::string& address, std::uint16_t port, std::function<std::string()> get_body) : get_body(std::move(get_body))
+	{
+		if (!detail::init_sockets())
+			{ throw std::runtime_error("Could not initialize sockets for the metrics server"); }
+		listener = detail::bind_socket(address, port, SOCK_STREAM);
+		if (listener == detail::invalid_socket)
+		{
+			cleanup();
+			throw std::runtime_error(std::format("Could not listen for metrics on {}:{} (is it a valid ipv4 address?)", address, port));
+		}
+		thread = std::thread([this]() { run(); });
+		log_message(log_severity::info, std::format("Serving metrics on http://{}:{}/metrics", address, port));
+	}
+	metrics_server(const metrics_server&) = delete;
+	metrics_server& operator=(const metrics_server&) = delete;
+	~metrics_server()
+	{
+		stopping = true;
+		if (thread.joinable())
+			{ thread.join(); }
+		cleanup();
+	}
+};
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef MILESTONE_NOTIFIER_H
+#define MILESTONE_NOTIFIER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dpp/dpp.h>
+
+#include "live_feed.h"
+#include "logger.h"
+
+// posts players reaching milestones of all time playtime (e.g. 100 hours) to a channel, without looking at every player's playtime:
+// a player's playtime is only looked up when they join, which says when they will reach their next milestone if they stay online.
+// those times are kept in a min-heap with a single dpp timer for the earliest one, so each join, leave and milestone costs O(log n)
+// leaving doesn't remove the player's entry from the heap, it's skipped when it comes up (see online_player::generation)
+// players already online when the bot starts are only counted from when they next join, since their joins aren't live deltas
+class milestone_notifier
+{
+public:
+	// @return all time playtime of a player until now (including the session they're in), nullopt if it can't be known yet (e.g. history is loading)
+	using playtime_t = std::function<std::optional<std::chrono::system_clock::duration>(uuid_t uuid)>;
+
+private:
+	static constexpr std::size_t max_message_size = 2000;  // discord's limit for message content
+	static constexpr std::uint64_t retry_seconds = 60;  // until looking up the playtime of joins again when it couldn't be
+
+	struct online_player
+	{
+		std::string name;
+		std::uint64_t generation;  // of the join, heap entries of earlier ones are stale
+	};
+	// when a player reaches a milestone if they stay online
+	struct crossing
+	{
+		std::chrono::system_clock::time_point time;
+		uuid_t uuid;
+		std::uint64_t generation;
+		std::size_t milestone;  // index in milestones
+	};
+	static constexpr auto later = [](const crossing& lhs, const crossing& rhs) { return lhs.time > rhs.time; };
+
+	dpp::cluster& bot;
+	dpp::snowflake channel_id;
+	std::vector<std::chrono::hours> milestones;  // sorted
+	playtime_t playtime;
+	std::mutex mutex;
+	std::map<uuid_t, online_player> online;
+	std::uint64_t next_generation = 0;
+	std::vector<std::pair<uuid_t, std::uint64_t>> joined;  // (uuid, generation) of joins whose playtime hasn't been looked up
+	std::vector<crossing> heap;  // ordered by `later`, so the earliest is at the front
+	std::optional<dpp::timer> timer;
+	std::chrono::system_clock::time_point timer_time;  // when the timer fires
+
+	[[nodiscard]] bool is_current(uuid_t uuid, std::uint64_t generation) const
+	{
+		const auto it = online.find(uuid);
+		return it != online.end() && it->second.generation == generation;
+	}
+
+	void push(crossing entry)
+	{
+		heap.push_back(entry);
+		std::ranges::push_heap(heap, later);
+	}
+
+	// (re)start the timer so it fires at `time` (or in a second, if that's sooner), unless it already fires before
+	void schedule(std::chrono::system_clock::time_point time)
+	{
+		const auto now = std::chrono::system_clock::now();
+		time = std::max(time, now + std::chrono::seconds(1));
+		if (timer && timer_time <= time)
+			{ return; }
+		if (timer)
+			{ bot.stop_timer(timer.value()); }
+		timer_time = time;
+		const auto seconds = std::chrono::ceil<std::chrono::seconds>(time - now).count();
+		timer = bot.start_timer([this](dpp::timer) { tick(); }, static_cast<std::uint64_t>(seconds));
+	}
+
+	void tick()
+	{
+		std::unique_lock lock(mutex);
+		bot.stop_timer(timer.value());
+		timer.reset();
+
+		// looked up without the lock, since it may build an index over all history
+		std::vector<std::pair<uuid_t, std::uint64_t>> lookups = std::move(joined);
+		joined.clear();
+		lock.unlock();
+		std::vector<std::optional<std::chrono::system_clock::duration>> totals;
+		totals.reserve(lookups.size());
+		for (const auto& [uuid, generation] : lookups)
+			{ totals.push_back(playtime(uuid)); }
+		const auto now = std::chrono::system_clock::now();
+		lock.lock();
+		for (std::size_t i = 0; i < lookups.size(); i++)
+		{
+			const auto& [uuid, generation] = lookups[i];
+			if (!is_current(uuid, generation))
+				{ continue; }  // left since
+			if (!totals[i])
+			{
+				joined.push_back(lookups[i]);
+				continue;
+			}
+			const auto next = std::ranges::upper_bound(milestones, totals[i].value(), std::ranges::less(), [](std::chrono::hours hours) { return std::chrono::system_clock::duration(hours); });
+			if (next != milestones.end())
+				{ push({ now + (*next - totals[i].value()), uuid, generation, static_cast<std::size_t>(next - milestones.begin()) }); }
+		}
+
+		std::vector<std::string> lines;
+		while (!heap.empty() && heap.front().time <= now)
+		{
+			std::ranges::pop_heap(heap, later);
+			const crossing entry = heap.back();
+			heap.pop_back();
+			if (!is_current(entry.uuid, entry.generation))
+				{ continue; }
+			lines.push_back(std::format("**{}** just reached {} hours of playtime", dpp::utility::markdown_escape(online.at(entry.uuid).name), milestones[entry.milestone].count()));
+			if (entry.milestone + 1 < milestones.size())
+				{ push({ entry.time + (milestones[entry.milestone + 1] - milestones[entry.milestone]), entry.uuid, entry.generation, entry.milestone + 1 }); }
+		}
+		// stale entries of players who left are only popped when they come up, so drop them once they're most of the heap
+		if (heap.size() > 2 * online.size() + 16)
+		{
+			std::erase_if(heap, [this](const crossing& entry) { return !is_current(entry.uuid, entry.generation); });
+			std::ranges::make_heap(heap, later);
+		}
+
+		if (!joined.empty())
+			{ schedule(now + std::chrono::seconds(retry_seconds)); }
+		if (!heap.empty())
+			{ schedule(heap.front().time); }
+		lock.unlock();
+
+		// as many lines as fit in each message
+		std::string content;
+		for (std::size_t i = 0; i < lines.size(); i++)
+		{
+			if (!content.empty())
+				{ content += '\n'; }
+			content += lines[i];
+			if (i + 1 == lines.size() || content.size() + 1 + lines[i + 1].size() > max_message_size)
+			{
+				// names are from the logs, so they mustn't ping anyone
+				bot.message_create(dpp::message(channel_id, content).set_allowed_mentions(), [](const dpp::confirmation_callback_t& res)
+				{
+					if (res.is_error())
+						{ log_message(log_severity::error, std::format("Could not post playtime milestones: {}", res.get_error().human_readable)); }
+				});
+				content.clear();
+			}
+		}
+	}
+
+public:
+	// @param milestones  hours of playtime to post players reaching
+	// @param playtime  called from the timer's thread
+	milestone_notifier(dpp::cluster& bot, dpp::snowflake channel_id, std::vector<std::chrono::hours> milestones, playtime_t playtime) :
+		bot(bot), channel_id(channel_id), milestones(std::move(milestones)), playtime(std::move(playtime))
+	{
+		std::ranges::sort(this->milestones);
+		const auto [first, last] = std::ranges::unique(this->milestones);
+		this->milestones.erase(first, last);
+	}
+	milestone_notifier(const milestone_notifier&) = delete;
+	milestone_notifier& operator=(const milestone_notifier&) = delete;
+	~milestone_notifier()
+	{
+		std::scoped_lock lock(mutex);
+		if (timer)
+			{ bot.stop_timer(timer.value()); }
+	}
+
+	// @param deltas  in the order they happened, joins and leaves of players without a uuid are ignored
+	void add(std::span<const live_delta> deltas)
+	{
+		std::scoped_lock lock(mutex);
+		for (const live_delta& delta : deltas)
+		{
+			if (!delta.uuid)
+				{ continue; }
+			if (delta.type == log_event_type::join)
+			{
+				online.insert_or_assign(delta.uuid.value(), online_player{ delta.player, next_generation });
+				joined.emplace_back(delta.uuid.value(), next_generation++);
+			}
+			else
+				{ online.erase(delta.uuid.value()); }
+		}
+		if (!joined.empty())
+			{ schedule(std::chrono::system_clock::now()); }
+	}
+};
+
+#endif
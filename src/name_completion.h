@@ -0,0 +1,138 @@
+#ifndef NAME_COMPLETION_H
+#define NAME_COMPLETION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "parse_logs.h"
+#include "session_store.h"
+
+// all names (current and former) of players in history, sorted ignoring case, for autocompleting player names
+// matches for a prefix are a range found with a binary search. players are ranked by total playtime
+// made once for each set of history segments (see detail::history_cache), recent data is checked when completing
+class name_completions
+{
+public:
+	static constexpr std::size_t max_results = 25;  // most autocomplete choices discord allows
+
+private:
+	struct entry
+	{
+		std::string folded;  // see player_name_index::fold_case
+		std::string_view name;  // in names
+		std::uint32_t player;  // index in uuids and totals
+		bool current;  // whether it is the player's latest name
+	};
+
+	std::vector<std::string> names;
+	std::vector<entry> entries;  // sorted by folded name
+	std::vector<uuid_t> uuids;  // sorted
+	std::vector<std::chrono::system_clock::duration> totals;  // in history
+
+public:
+	name_completions() = default;
+	// entries refer to names, moving keeps them valid but copying wouldn't
+	name_completions(const name_completions&) = delete;
+	name_completions(name_completions&&) = default;
+	explicit name_completions(std::span<const std::shared_ptr<const session_store>> segments)
+	{
+		// names of a player are oldest first, and segments are oldest first
+		std::map<uuid_t, std::pair<std::vector<std::string_view>, std::chrono::system_clock::duration>> players;
+		for (const auto& segment : segments)
+		{
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				auto& [player_names, total] = players[segment->uuid(i)];
+				for (const std::string_view name : segment->player_names(i))
+				{
+					std::erase(player_names, name);
+					player_names.push_back(name);
+				}
+				total += segment->total_playtime(i);
+			}
+		}
+
+		std::size_t num_names = 0;
+		for (const auto& [uuid, player] : players)
+			{ num_names += player.first.size(); }
+		names.reserve(num_names);  // so views into it stay valid
+		entries.reserve(num_names);
+		for (const auto& [uuid, player] : players)
+		{
+			const auto& [player_names, total] = player;
+			const auto player_ind = static_cast<std::uint32_t>(uuids.size());
+			uuids.push_back(uuid);
+			totals.push_back(total);
+			for (std::size_t i = 0; i < player_names.size(); i++)
+			{
+				const std::string& name = names.emplace_back(player_names[i]);
+				entries.emplace_back(player_name_index::fold_case(name), name, player_ind, i + 1 == player_names.size());
+			}
+		}
+		std::ranges::sort(entries, {}, &entry::folded);
+	}
+
+	// @param prefix  typed so far (case is ignored)
+	// @param recent  sessions newer than history, whose playtime counts and whose players are also completed
+	// @return names starting with prefix of the players with the most playtime (one for each player, their latest one if it matches), at most max_results
+	[[nodiscard]] std::vector<std::string> complete(std::string_view prefix, const log_data_t& recent) const
+	{
+		const std::string folded_prefix = player_name_index::fold_case(prefix);
+		const auto matches = [&folded_prefix](std::string_view name)
+			{ return player_name_index::fold_case(name).starts_with(folded_prefix); };
+
+		// total playtime, whether the name is current (so it is picked for its player), name, and uuid
+		std::vector<std::tuple<std::chrono::system_clock::duration, bool, std::string_view, uuid_t>> candidates;
+		const auto first = std::ranges::lower_bound(entries, folded_prefix, {}, &entry::folded);
+		for (auto it = first; it != entries.end() && it->folded.starts_with(folded_prefix); it++)
+		{
+			auto total = totals[it->player];
+			bool current = it->current;
+			const uuid_t uuid = uuids[it->player];
+			if (const auto recent_it = recent.find(uuid); recent_it != recent.end())
+			{
+				total += recent_it->second.second.second;
+				current = current && recent_it->second.first.empty();  // otherwise the latest name is in recent data
+			}
+			candidates.emplace_back(total, current, it->name, uuid);
+		}
+		// recent data only has players who played since the last commit, so it is gone through
+		for (const auto& [uuid, data] : recent)
+		{
+			const auto& [player_names, play_info] = data;
+			const auto history_it = std::ranges::lower_bound(uuids, uuid);
+			const auto total = play_info.second + ((history_it != uuids.end() && *history_it == uuid) ? totals[history_it - uuids.begin()] : std::chrono::system_clock::duration{});
+			for (std::size_t i = 0; i < player_names.size(); i++)
+			{
+				if (matches(player_names[i]))
+					{ candidates.emplace_back(total, i + 1 == player_names.size(), player_names[i], uuid); }
+			}
+		}
+
+		std::ranges::sort(candidates, std::ranges::greater());
+		std::vector<std::string> res;
+		std::vector<uuid_t> res_uuids;
+		for (const auto& [total, current, name, uuid] : candidates)
+		{
+			if (res.size() == max_results)
+				{ break; }
+			if (std::ranges::find(res_uuids, uuid) != res_uuids.end())
+				{ continue; }
+			res_uuids.push_back(uuid);
+			res.emplace_back(name);
+		}
+		return res;
+	}
+};
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef NET_SOCKET_H
+#define NET_SOCKET_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// the parts of sockets that differ between platforms, for the servers the bot runs (see metrics_server and log_listener)
+namespace detail
+{
+#ifdef _WIN32
+	using socket_t = SOCKET;
+	using pollfd_t = WSAPOLLFD;
+	inline constexpr socket_t invalid_socket = INVALID_SOCKET;
+	inline constexpr int send_flags = 0;
+
+	inline void close_socket(socket_t s)
+		{ closesocket(s); }
+	inline bool set_nonblocking(socket_t s)
+	{
+		u_long mode = 1;
+		return ioctlsocket(s, FIONBIO, &mode) == 0;
+	}
+	[[nodiscard]] inline bool last_error_would_block()
+		{ return WSAGetLastError() == WSAEWOULDBLOCK; }
+	inline int poll_sockets(pollfd_t* fds, std::size_t num_fds, int timeout_ms)
+		{ return WSAPoll(fds, static_cast<ULONG>(num_fds), timeout_ms); }
+
+	// @return false if sockets can't be used
+	[[nodiscard]] inline bool init_sockets()
+	{
+		WSADATA wsa_data;
+		return WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0;
+	}
+	// once for each successful init_sockets
+	inline void cleanup_sockets()
+		{ WSACleanup(); }
+#else
+	using socket_t = int;
+	using pollfd_t = pollfd;
+	inline constexpr socket_t invalid_socket = -1;
+#ifdef MSG_NOSIGNAL
+	inline constexpr int send_flags = MSG_NOSIGNAL;  // a client that hung up shouldn't kill the bot with SIGPIPE
+#else
+	inline constexpr int send_flags = 0;
+#endif
+
+	inline void close_socket(socket_t s)
+		{ close(s); }
+	inline bool set_nonblocking(socket_t s)
+	{
+		const int flags = fcntl(s, F_GETFL, 0);
+		return flags != -1 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+	[[nodiscard]] inline bool last_error_would_block()
+		{ return errno == EAGAIN || errno == EWOULDBLOCK; }
+	inline int poll_sockets(pollfd_t* fds, std::size_t num_fds, int timeout_ms)
+		{ return poll(fds, static_cast<nfds_t>(num_fds), timeout_ms); }
+
+	[[nodiscard]] inline bool init_sockets()
+		{ return true; }
+	inline void cleanup_sockets() {}
+#endif
+
+	// @return > 0 if `s` can be read from (or accepted on) without blocking, 0 on timeout, < 0 on error
+	inline int poll_socket(socket_t s, int timeout_ms)
+	{
+		pollfd_t fd{};
+		fd.fd = s;
+		fd.events = POLLIN;
+		return poll_sockets(&fd, 1, timeout_ms);
+	}
+
+	// @param type  SOCK_STREAM for a socket that is listened on, or SOCK_DGRAM
+	// @return socket bound to ipv4 `address`:`port`, or invalid_socket if `address` is invalid or can't be bound
+	[[nodiscard]] inline socket_t bind_socket(const std::string& address, std::uint16_t port, int type)
+	{
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+			{ return invalid_socket; }
+		const socket_t s = socket(AF_INET, type, 0);
+		if (s == invalid_socket)
+			{ return invalid_socket; }
+		const int reuse = 1;
+		if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse)) != 0
+			|| bind(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0
+			|| (type == SOCK_STREAM && listen(s, 8) != 0))
+		{
+			close_socket(s);
+			return invalid_socket;
+		}
+		return s;
+	}
+
+	// @return stream socket connected to ipv4 `address`:`port`, or invalid_socket if `address` is invalid or nothing accepted the connection
+	[[nodiscard]] inline socket_t connect_socket(const std::string& address, std::uint16_t port)
+	{
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+			{ return invalid_socket; }
+		const socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+		if (s == invalid_socket)
+			{ return invalid_socket; }
+		if (connect(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+		{
+			close_socket(s);
+			return invalid_socket;
+		}
+		return s;
+	}
+
+	// @return false if the peer hung up before all of `data` was sent
+	[[nodiscard]] inline bool send_all(socket_t s, std::string_view data)
+	{
+		std::size_t sent = 0;
+		while (sent < data.size())
+		{
+			const auto num_sent = send(s, data.data() + sent, static_cast<int>(data.size() - sent), send_flags);
+			if (num_sent <= 0)
+				{ return false; }
+			sent += static_cast<std::size_t>(num_sent);
+		}
+		return true;
+	}
+
+	// for sockets that were set_nonblocking, so a slow peer doesn't hold up the others
+	// @return bytes of the start of `data` that were sent, possibly none, or empty optional if the peer hung up
+	[[nodiscard]] inline std::optional<std::size_t> send_some(socket_t s, std::string_view data)
+	{
+		const auto num_sent = send(s, data.data(), static_cast<int>(data.size()), send_flags);
+		if (num_sent >= 0)
+			{ return static_cast<std::size_t>(num_sent); }
+		if (last_error_would_block())
+			{ return 0; }
+		return std::nullopt;
+	}
+}
+
+#endif
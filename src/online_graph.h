@@ -0,0 +1,539 @@
+#ifndef ONLINE_GRAPH_H
+#define ONLINE_GRAPH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "graph_writer.h"
+#include "lag_series.h"
+#include "parse_logs.h"
+#include "playtime_graph.h"
+#include "session_store.h"
+#include "text_metrics.h"
+#include "uptime_series.h"
+
+/*
+SVG layout:
+ ____________________________________________________
+|                    peak label                      |
+|____________________________________________________|
+|              |                                     |
+|   players    |                                     |
+|   online     |      players online over time       |
+|   (y-axis)   |                                     |
+|______________|_____________________________________|
+|                      dates                         |
+|____________________________________________________|
+
+lag graph (the same, followed by):
+ ____________________________________________________
+|                   worst lag label                  |
+|____________________________________________________|
+|              |                                     |
+| ms behind    |  hourly max and 95th percentile of  |
+|  (y-axis)    |  how far behind the server was,     |
+|              |  on times it was down (shaded)      |
+|______________|_____________________________________|
+
+graph of each server: a shorter players online graph for each server, with its name in the peak label,
+stacked so they share the x-axis, with the dates only below the last one
+*/
+
+inline constexpr double svg_online_height = 500;
+inline constexpr std::string_view svg_online_color = "#3A7BD5";
+inline constexpr std::string_view svg_grid_color = "#808080";
+inline constexpr int svg_max_online_ticks = 5;  // intervals between labels on the y-axis
+inline constexpr double svg_peak_marker_size = 6;
+inline constexpr double svg_server_panel_height = 200;  // of each server's players online in the graph of each server
+inline constexpr double svg_lag_height = 250;
+inline constexpr std::string_view svg_lag_max_color = "#F2B27A";
+inline constexpr std::string_view svg_lag_p95_color = "#D9622B";
+inline constexpr std::string_view svg_downtime_color = "#A0A0A0";
+
+namespace detail
+{
+	// @return joins and leaves of sessions in recent data and of online players (who leave at `now`), sorted
+	inline std::vector<online_players::event> get_recent_online_events(const log_data_t& recent, const parse_ctx_t& parse_ctx,
+		std::chrono::system_clock::time_point now)
+	{
+		std::vector<online_players::event> events;
+		for (const auto& [uuid, data] : recent)
+		{
+			for (const play_session& session : data.second.first)
+				{ online_players::add_events(events, session); }
+		}
+		for (const std::uint32_t id : parse_ctx.player_info.online())
+		{
+			const auto& [uuid, join_time] = parse_ctx.player_info.infos()[id];
+			if (uuid)
+				{ online_players::add_events(events, { join_time.value(), now - join_time.value() }); }
+		}
+		std::ranges::sort(events);
+		return events;
+	}
+
+	// players online over time from history and recent events, which are swept over together
+	class online_sweep
+	{
+	private:
+		const online_players& history;
+		std::span<const online_players::event> recent;
+		std::size_t history_ind = 0, recent_ind = 0;
+		std::int32_t history_count = 0, recent_count = 0;
+
+		static constexpr std::int64_t no_time = std::numeric_limits<std::int64_t>::max();
+
+		[[nodiscard]] std::int64_t next_time() const noexcept
+		{
+			return std::min((history_ind < history.size()) ? history.time(history_ind) : no_time,
+				(recent_ind < recent.size()) ? recent[recent_ind].first : no_time);
+		}
+
+	public:
+		// @param recent  sorted
+		// @param first_time  time to start at (seconds since epoch), found with a binary search in history
+		online_sweep(const online_players& history, std::span<const online_players::event> recent, std::int64_t first_time) :
+			history(history), recent(recent), history_ind(history.upper_bound(first_time))
+		{
+			if (history_ind != 0)
+				{ history_count = history.count(history_ind - 1); }
+			for (; recent_ind < recent.size() && recent[recent_ind].first <= first_time; recent_ind++)
+				{ recent_count += recent[recent_ind].second; }
+		}
+
+		// @return players online at the current time
+		[[nodiscard]] std::int32_t count() const noexcept
+			{ return history_count + recent_count; }
+
+		// go through all changes before `end`
+		// @param[out] peak_time  if not null, time of the change after which the most were online first (unchanged if it's the current count)
+		// @return most players online at once from the current time until `end`
+		std::int32_t max_until(double end, std::int64_t* peak_time = nullptr)
+		{
+			std::int32_t res = count();
+			for (std::int64_t time = next_time(); static_cast<double>(time) < end; time = next_time())
+			{
+				// changes at the same time are applied together, so a player leaving and another joining isn't counted as both online
+				for (; history_ind < history.size() && history.time(history_ind) == time; history_ind++)
+					{ history_count = history.count(history_ind); }
+				for (; recent_ind < recent.size() && recent[recent_ind].first == time; recent_ind++)
+					{ recent_count += recent[recent_ind].second; }
+				if (count() > res && peak_time != nullptr)
+					{ *peak_time = time; }
+				res = std::max(res, count());
+			}
+			return res;
+		}
+	};
+
+	// sizes and positions of the graph parts (see SVG layout above)
+	struct online_layout
+	{
+		std::chrono::sys_seconds first_time, last_time;
+		double header_height;  // peak label
+		double text_width;  // y-axis labels
+		double axis_width;  // x-axis and grid lines
+		double data_area_width;  // players online
+		double date_height;  // 0 if there are no dates
+		std::int32_t y_step, y_max;  // between labels on the y-axis, and at the top of it
+		std::vector<std::int32_t> max_counts;  // most players online at once in each column (one pixel of the png wide)
+		std::size_t peak_column;  // first column with the most players online
+		std::chrono::sys_seconds peak_time;  // start of peak_column
+	};
+
+	// @return y-axis label spacing of 1, 2, or 5 times a power of 10, so there are at most svg_max_online_ticks intervals up to `peak`
+	inline std::int32_t get_online_y_step(std::int32_t peak)
+	{
+		for (std::int64_t power = 1;; power *= 10)
+		{
+			for (const std::int64_t mult : { 1, 2, 5 })
+			{
+				if (power * mult * svg_max_online_ticks >= peak)
+					{ return static_cast<std::int32_t>(power * mult); }
+			}
+		}
+	}
+
+	// @param range  only this is shown, if there are sessions in all of it
+	// @return first and last time shown (seconds since epoch): from the first to the last change, like the bars of the playtime graph,
+	// or the current time for both if there are none
+	inline std::pair<std::int64_t, std::int64_t> get_online_extent(const online_players& history, std::span<const online_players::event> recent,
+		const time_range& range)
+	{
+		std::int64_t first = std::numeric_limits<std::int64_t>::max(), last = std::numeric_limits<std::int64_t>::min();
+		if (!history.empty())
+		{
+			first = history.time(0);
+			last = history.time(history.size() - 1);
+		}
+		if (!recent.empty())
+		{
+			first = std::min(first, recent.front().first);
+			last = std::max(last, recent.back().first);
+		}
+		first = std::max(first, std::chrono::floor<std::chrono::seconds>(range.begin).time_since_epoch().count());
+		last = std::min(last, std::chrono::ceil<std::chrono::seconds>(range.end).time_since_epoch().count());
+		if (first >= last)
+			{ first = last = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()).time_since_epoch().count(); }
+		return { first, last };
+	}
+
+	// @param extent  first and last time shown, see get_online_extent (or the union of those of graphs that share an x-axis)
+	// @param min_text_width  of the y-axis labels, so another graph below can have wider ones (see get_lag_layout)
+	inline online_layout get_online_layout(const online_players& history, std::span<const online_players::event> recent, std::pair<std::int64_t, std::int64_t> extent,
+		const std::chrono::time_zone* target_tz, double min_text_width = 0)
+	{
+		online_layout layout{};
+		auto& metrics = text_metrics::get();
+		const auto [first, last] = extent;
+		layout.first_time = std::chrono::sys_seconds(std::chrono::seconds(first));
+		layout.last_time = std::chrono::sys_seconds(std::chrono::seconds(last));
+
+		// labels depend on the peak, and the width of the columns depends on the labels, so the peak is found with its own sweep
+		const std::int32_t peak = (first < last) ? online_sweep(history, recent, first).max_until(static_cast<double>(last)) : 0;
+		layout.y_step = get_online_y_step(peak);
+		layout.y_max = std::max(1, (peak + layout.y_step - 1) / layout.y_step * layout.y_step);
+		layout.header_height = svg_date_fontsize + svg_pad;
+		{
+			text_bounds bounds;
+			for (std::int32_t val = 0; val <= layout.y_max; val += layout.y_step)
+				{ bounds.add(-svg_pad, metrics.text_width(std::to_string(val), svg_date_fontsize), text_anchor::end); }
+			// the labels are narrow, so also leave room for a date centered on the y-axis
+			const double date_overhang = metrics.text_width("00/00/0000", svg_date_fontsize) / 2 - svg_pad;
+			layout.text_width = std::ceil(std::max({ bounds.get_width(), date_overhang, min_text_width }) / 2.5) * 2.5;  // round up to multiple of 2.5
+		}
+
+		layout.axis_width = svg_width - (layout.text_width + svg_pad);
+		layout.data_area_width = layout.axis_width;
+		if (first >= last)
+			{ return layout; }  // nothing to show
+		std::tie(layout.data_area_width, layout.date_height) = fit_date_labels(layout.axis_width, layout.first_time, layout.last_time, target_tz);
+
+		// sessions are downsampled to the png resolution, keeping the most players in each column so short peaks still show
+		const auto num_columns = static_cast<std::size_t>(std::lround(layout.data_area_width * png_graph_writer::scale));
+		const double column_seconds = static_cast<double>(last - first) / static_cast<double>(num_columns);
+		online_sweep sweep(history, recent, first);
+		layout.max_counts.resize(num_columns);
+		for (std::size_t i = 0; i < num_columns; i++)
+		{
+			const double column_end = (i + 1 == num_columns) ? static_cast<double>(last) : static_cast<double>(first) + column_seconds * static_cast<double>(i + 1);
+			layout.max_counts[i] = sweep.max_until(column_end);
+		}
+		layout.peak_column = std::ranges::max_element(layout.max_counts) - layout.max_counts.begin();
+		layout.peak_time = layout.first_time + std::chrono::seconds(std::llround(column_seconds * static_cast<double>(layout.peak_column)));
+		return layout;
+	}
+
+	// @param range  only this is shown, if there are sessions in all of it
+	inline online_layout get_online_layout(const online_players& history, std::span<const online_players::event> recent, const time_range& range,
+		const std::chrono::time_zone* target_tz, double min_text_width = 0)
+		{ return get_online_layout(history, recent, get_online_extent(history, recent, range), target_tz, min_text_width); }
+
+	// draw players online from `top` to `top + height`, with its label in the layout.header_height above
+	// @param writer  svg_graph_writer or png_graph_writer
+	// @param name  of what the players were online on, put before the peak label (empty for none)
+	// @param dates  whether to label the x-axis with dates, in the layout.date_height below it
+	inline void draw_online_panel(auto& writer, const online_layout& layout, std::string_view color, const std::chrono::time_zone* target_tz,
+		double top, double height, std::string_view name, bool dates)
+	{
+		const auto get_y = [&](std::int32_t count)
+			{ return top + height * (1 - static_cast<double>(count) / layout.y_max); };
+
+		// y-axis and grid
+		for (std::int32_t val = 0; val <= layout.y_max; val += layout.y_step)
+		{
+			const double y = get_y(val);
+			if (val != 0)
+				{ writer.line(0, y, layout.axis_width, y, svg_grid_color, 1); }
+			writer.text(-svg_pad, y, svg_date_fontsize, false, color, text_anchor::end, text_baseline::middle, std::to_string(val));
+		}
+
+		// players online, with steps merged where neighboring columns are the same
+		if (!layout.max_counts.empty())
+		{
+			const double column_width = layout.data_area_width / static_cast<double>(layout.max_counts.size());
+			std::vector<std::pair<double, double>> points{ { 0, top + height } };
+			for (std::size_t i = 0; i < layout.max_counts.size();)
+			{
+				const std::size_t begin = i;
+				for (; i < layout.max_counts.size() && layout.max_counts[i] == layout.max_counts[begin]; i++) {}
+				const double y = get_y(layout.max_counts[begin]);
+				points.emplace_back(column_width * static_cast<double>(begin), y);
+				points.emplace_back(column_width * static_cast<double>(i), y);
+			}
+			points.emplace_back(layout.data_area_width, top + height);
+			writer.polygon(points, svg_online_color);
+
+			// peak marker
+			const std::int32_t peak = layout.max_counts[layout.peak_column];
+			if (peak > 0)
+			{
+				const double x = column_width * (static_cast<double>(layout.peak_column) + 0.5);
+				const double y = get_y(peak);
+				writer.line(x, top - svg_pad / 2, x, y, color, 1);
+				writer.rect(x - svg_peak_marker_size / 2, y - svg_peak_marker_size / 2, svg_peak_marker_size, svg_peak_marker_size, color);
+
+				std::string label = std::format("peak: {} online ({:%m/%d/%Y %H:%M})", peak,
+					std::chrono::floor<std::chrono::minutes>(target_tz->to_local(layout.peak_time)));
+				if (!name.empty())
+					{ label = std::format("{}, {}", name, label); }
+				// centered above the marker, but kept inside the graph
+				const double half_width = text_metrics::get().text_width(label, svg_date_fontsize) / 2;
+				const double label_x = std::clamp(x, half_width - (layout.text_width + svg_pad), layout.axis_width - half_width);
+				writer.text(label_x, top - layout.header_height, svg_date_fontsize, false, color, text_anchor::middle, text_baseline::hanging, label);
+				name = {};
+			}
+		}
+		if (!name.empty())
+			{ writer.text(0, top - layout.header_height, svg_date_fontsize, false, color, text_anchor::start, text_baseline::hanging, std::format("{}, nobody online", name)); }
+
+		// x-axis
+		writer.line(0, top + height, layout.axis_width, top + height, color, 2);
+		if (dates)
+			{ detail::add_dates(writer, layout.first_time, layout.last_time, top + height, layout.data_area_width, color, target_tz); }
+	}
+
+	// @param writer  svg_graph_writer or png_graph_writer
+	// @param below_height  left below the graph, for another one (see draw_lag_graph)
+	inline void draw_online_graph(auto& writer, const online_layout& layout, std::string_view color, const std::chrono::time_zone* target_tz,
+		double below_height = 0)
+	{
+		writer.begin(svg_width + 2 * svg_side_pad, layout.header_height + svg_online_height + layout.date_height + below_height + 2 * svg_side_pad,
+			-(layout.text_width + svg_pad) - svg_side_pad, -layout.header_height - svg_side_pad);
+		draw_online_panel(writer, layout, color, target_tz, 0, svg_online_height, {}, true);
+	}
+
+	// the part of the lag graph below the players online, which shares its x-axis
+	struct lag_layout
+	{
+		std::vector<lag_hour> hours;  // shown, in order
+		double text_width;  // y-axis labels
+		std::int32_t y_step, y_max;  // milliseconds between labels on the y-axis, and at the top of it
+		std::size_t worst_hour;  // with the highest max, if there are any hours
+		std::vector<time_range> downtime;  // times the server was down, in order
+	};
+
+	// @param uptime  see create_lag_graph
+	// @param first_time, last_time  of the players online graph
+	inline lag_layout get_lag_layout(std::span<const std::shared_ptr<const lag_series>> lag, std::span<const std::shared_ptr<const uptime_series>> uptime,
+		std::chrono::sys_seconds first_time, std::chrono::sys_seconds last_time)
+	{
+		lag_layout layout{};
+		layout.hours = hourly_lag(lag, first_time, last_time);
+		layout.downtime = get_downtime(uptime, { first_time, last_time }, std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+		std::int64_t worst = 0;
+		for (std::size_t i = 0; i < layout.hours.size(); i++)
+		{
+			if (layout.hours[i].max.count() > worst)
+			{
+				worst = layout.hours[i].max.count();
+				layout.worst_hour = i;
+			}
+		}
+		layout.y_step = get_online_y_step(static_cast<std::int32_t>(std::min<std::int64_t>(worst, std::numeric_limits<std::int32_t>::max() / 10)));
+		layout.y_max = std::max(1, static_cast<std::int32_t>((worst + layout.y_step - 1) / layout.y_step * layout.y_step));
+		text_bounds bounds;
+		for (std::int32_t val = 0; val <= layout.y_max; val += layout.y_step)
+			{ bounds.add(-svg_pad, text_metrics::get().text_width(std::format("{}ms", val), svg_date_fontsize), text_anchor::end); }
+		layout.text_width = bounds.get_width();
+		return layout;
+	}
+
+	// @return height of the lag part of the graph, including the gap above it
+	[[nodiscard]] inline double lag_graph_height(const online_layout& layout) noexcept
+		{ return svg_pad + layout.header_height + svg_lag_height; }
+
+	// draw the lag part of the graph below the players online, which must have been drawn with lag_graph_height below it
+	inline void draw_lag_graph(auto& writer, const online_layout& layout, const lag_layout& lag, std::string_view color, const std::chrono::time_zone* target_tz)
+	{
+		const double top = svg_online_height + layout.date_height + svg_pad + layout.header_height;
+		const auto get_y = [&](std::chrono::milliseconds behind)
+			{ return top + svg_lag_height * (1 - std::min(1.0, static_cast<double>(behind.count()) / lag.y_max)); };
+
+		// y-axis and grid
+		for (std::int32_t val = 0; val <= lag.y_max; val += lag.y_step)
+		{
+			const double y = get_y(std::chrono::milliseconds(val));
+			if (val != 0)
+				{ writer.line(0, y, layout.axis_width, y, svg_grid_color, 1); }
+			writer.text(-svg_pad, y, svg_date_fontsize, false, color, text_anchor::end, text_baseline::middle, std::format("{}ms", val));
+		}
+
+		const double seconds = static_cast<double>((layout.last_time - layout.first_time).count());
+		// behind the bars, at least a pixel wide like them
+		for (const time_range& down : lag.downtime)
+		{
+			const auto get_x = [&](std::chrono::system_clock::time_point tp)
+				{ return (seconds > 0) ? layout.data_area_width * std::chrono::duration<double>(tp - layout.first_time).count() / seconds : 0; };
+			const double x = get_x(down.begin);
+			writer.rect(x, top, std::max(get_x(down.end) - x, 1 / static_cast<double>(png_graph_writer::scale)), svg_lag_height, svg_downtime_color);
+		}
+
+		// a bar for each hour, at least a pixel wide so hours aren't lost in long ranges
+		const double hour_width = (seconds > 0) ? std::max(layout.data_area_width * 3600 / seconds, 1 / static_cast<double>(png_graph_writer::scale)) : 0;
+		const auto get_x = [&](const lag_hour& hour)
+		{
+			const double x = (seconds > 0) ? layout.data_area_width * static_cast<double>((hour.start - layout.first_time).count()) / seconds : 0;
+			return std::clamp(x, 0.0, std::max(0.0, layout.data_area_width - hour_width));
+		};
+		for (const lag_hour& hour : lag.hours)
+		{
+			const double x = get_x(hour);
+			writer.rect(x, get_y(hour.max), hour_width, top + svg_lag_height - get_y(hour.max), svg_lag_max_color);
+			writer.rect(x, get_y(hour.p95), hour_width, top + svg_lag_height - get_y(hour.p95), svg_lag_p95_color);
+		}
+
+		std::string label = "no lag";
+		if (!lag.hours.empty())
+		{
+			const lag_hour& worst = lag.hours[lag.worst_hour];
+			label = std::format("worst lag: {}ms behind ({:%m/%d/%Y %H:00}), hourly max and 95th percentile", worst.max.count(),
+				std::chrono::floor<std::chrono::hours>(target_tz->to_local(worst.start)));
+		}
+		if (!lag.downtime.empty())
+			{ label += ", server down shaded"; }
+		writer.text(0, top - layout.header_height, svg_date_fontsize, false, color, text_anchor::start, text_baseline::hanging, label);
+
+		// x-axis
+		writer.line(0, top + svg_lag_height, layout.axis_width, top + svg_lag_height, color, 2);
+	}
+}
+
+// graph of how many players were online over time, with the peak marked
+// options.row_limit is unused. the graph extends to the current time if players are online
+// the data is read in place, so it must not be modified while the graph is created
+// @tparam return_svg  whether to return svg data
+// @tparam render_to_png  whether to return rendered png data
+// @throws std::runtime_error if png rendering fails
+// @return pair of svg and png data if return_svg and render_to_png are both true, otherwise return single string containing data
+template<bool return_svg = true, bool render_to_png = false>
+inline auto create_online_graph(const session_history& history, const log_data_t& recent, const parse_ctx_t& parse_ctx, const graph_options& options = {})
+{
+	static_assert(return_svg || render_to_png, "Graph must be either saved to svg or png");
+
+	std::optional<graph_render_ctx> temp_render_ctx;
+	graph_render_ctx& render_ctx = options.render_ctx ? *options.render_ctx : temp_render_ctx.emplace();
+	const auto history_players = render_ctx.get_online_players(history.get_segments());
+	const auto recent_events = detail::get_recent_online_events(recent, parse_ctx, std::chrono::system_clock::now());
+	const detail::online_layout layout = detail::get_online_layout(*history_players, recent_events, options.range, render_ctx.get_timezone());
+	return detail::write_graph<return_svg, render_to_png>(options, [&](auto& writer)
+		{ detail::draw_online_graph(writer, layout, options.color, render_ctx.get_timezone()); });
+}
+
+// graph of how many players were online over time, with how far behind the server was below it, so lag can be matched to player count
+// options.row_limit is unused. the graph extends to the current time if players are online
+// the data is read in place, so it must not be modified while the graph is created
+// @param lag  of the servers the history is of
+// @param uptime  of the server the history is of, whose downtime is shaded (see get_downtime), or empty if it isn't known (e.g. several servers)
+// @tparam return_svg  whether to return svg data
+// @tparam render_to_png  whether to return rendered png data
+// @throws std::runtime_error if png rendering fails
+// @return pair of svg and png data if return_svg and render_to_png are both true, otherwise return single string containing data
+template<bool return_svg = true, bool render_to_png = false>
+inline auto create_lag_graph(const session_history& history, const log_data_t& recent, const parse_ctx_t& parse_ctx,
+	std::span<const std::shared_ptr<const lag_series>> lag, std::span<const std::shared_ptr<const uptime_series>> uptime, const graph_options& options = {})
+{
+	static_assert(return_svg || render_to_png, "Graph must be either saved to svg or png");
+
+	std::optional<graph_render_ctx> temp_render_ctx;
+	graph_render_ctx& render_ctx = options.render_ctx ? *options.render_ctx : temp_render_ctx.emplace();
+	const auto history_players = render_ctx.get_online_players(history.get_segments());
+	const auto recent_events = detail::get_recent_online_events(recent, parse_ctx, std::chrono::system_clock::now());
+	detail::online_layout layout = detail::get_online_layout(*history_players, recent_events, options.range, render_ctx.get_timezone());
+	const detail::lag_layout lag_layout = detail::get_lag_layout(lag, uptime, layout.first_time, layout.last_time);
+	// both parts have the same x-axis, so the labels of both have to fit
+	if (lag_layout.text_width > layout.text_width)
+		{ layout = detail::get_online_layout(*history_players, recent_events, options.range, render_ctx.get_timezone(), lag_layout.text_width); }
+	return detail::write_graph<return_svg, render_to_png>(options, [&](auto& writer)
+	{
+		detail::draw_online_graph(writer, layout, options.color, render_ctx.get_timezone(), detail::lag_graph_height(layout));
+		detail::draw_lag_graph(writer, layout, lag_layout, options.color, render_ctx.get_timezone());
+	});
+}
+
+// data of a server, for create_servers_graph
+struct server_graph_data
+{
+	std::string_view name;
+	const session_history& history;
+	const log_data_t& recent;
+	const parse_ctx_t& parse_ctx;
+};
+
+// graph of how many players were online on each server, each in its own panel over a shared time axis, so servers can be compared in one image
+// each server's players online and layout are made in parallel (see band_pool), and a png's panels are rasterized in parallel
+// as the bands of rows of one image (see png_graph_writer::rasterize), so there is nothing to composite
+// options.row_limit is unused. the graph extends to the current time if players are online
+// the data is read in place, so it must not be modified while the graph is created
+// @param servers  at least one, in the order of their panels
+// @tparam return_svg  whether to return svg data
+// @tparam render_to_png  whether to return rendered png data
+// @throws std::runtime_error if png rendering fails
+// @return pair of svg and png data if return_svg and render_to_png are both true, otherwise return single string containing data
+template<bool return_svg = true, bool render_to_png = false>
+inline auto create_servers_graph(std::span<const server_graph_data> servers, const graph_options& options = {})
+{
+	static_assert(return_svg || render_to_png, "Graph must be either saved to svg or png");
+
+	std::optional<graph_render_ctx> temp_render_ctx;
+	graph_render_ctx& render_ctx = options.render_ctx ? *options.render_ctx : temp_render_ctx.emplace();
+	const std::chrono::time_zone* timezone = render_ctx.get_timezone();
+	const auto now = std::chrono::system_clock::now();
+	detail::band_pool& pool = detail::band_pool::get();
+	// not get_online_players, which keeps one step function (that of the merged view's graphs, usually)
+	std::vector<std::optional<online_players>> history_players(servers.size());
+	std::vector<std::vector<online_players::event>> recent_events(servers.size());
+	std::vector<std::pair<std::int64_t, std::int64_t>> extents(servers.size());
+	pool.run(servers.size(), [&](std::size_t i)
+	{
+		history_players[i].emplace(render_ctx.make_online_players(servers[i].history.get_segments()));
+		recent_events[i] = detail::get_recent_online_events(servers[i].recent, servers[i].parse_ctx, now);
+		extents[i] = detail::get_online_extent(*history_players[i], recent_events[i], options.range);
+	});
+
+	// every panel shows the times of all of them. a server without changes in the range only has the current time, which doesn't widen the others
+	std::pair<std::int64_t, std::int64_t> extent{ std::numeric_limits<std::int64_t>::max(), std::numeric_limits<std::int64_t>::min() };
+	for (const auto& [first, last] : extents)
+	{
+		if (first < last)
+			{ extent = { std::min(extent.first, first), std::max(extent.second, last) }; }
+	}
+	if (extent.first >= extent.second)
+		{ extent.first = extent.second = std::chrono::floor<std::chrono::seconds>(now).time_since_epoch().count(); }
+	std::vector<detail::online_layout> layouts(servers.size());
+	pool.run(servers.size(), [&](std::size_t i)
+		{ layouts[i] = detail::get_online_layout(*history_players[i], recent_events[i], extent, timezone); });
+	// the panels have the same x-axis, so the y-axis labels of all of them have to fit
+	const double text_width = std::ranges::max(layouts | std::views::transform(&detail::online_layout::text_width));
+	pool.run(servers.size(), [&](std::size_t i)
+	{
+		if (layouts[i].text_width < text_width)
+			{ layouts[i] = detail::get_online_layout(*history_players[i], recent_events[i], extent, timezone, text_width); }
+	});
+
+	return detail::write_graph<return_svg, render_to_png>(options, [&](auto& writer)
+	{
+		const detail::online_layout& front = layouts.front();
+		const double panel_stride = front.header_height + svg_server_panel_height + svg_pad;
+		writer.begin(svg_width + 2 * svg_side_pad, panel_stride * static_cast<double>(layouts.size()) - svg_pad + front.date_height + 2 * svg_side_pad,
+			-(front.text_width + svg_pad) - svg_side_pad, -front.header_height - svg_side_pad);
+		for (std::size_t i = 0; i < layouts.size(); i++)
+		{
+			detail::draw_online_panel(writer, layouts[i], options.color, timezone, panel_stride * static_cast<double>(i), svg_server_panel_height,
+				servers[i].name, i + 1 == layouts.size());
+		}
+	});
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef ONLINE_INDEX_H
+#define ONLINE_INDEX_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "parse_logs.h"
+#include "session_store.h"
+
+// a player who was online at a time (see online_index::online_at)
+struct online_at_entry
+{
+	std::optional<uuid_t> uuid;  // empty for online players whose uuid isn't known
+	std::string_view name;  // latest name
+	play_session session;  // containing the time, until now for online players
+	bool online;  // still online, so the session hasn't ended
+};
+
+// centered interval tree of the sessions of a session_store, for finding the sessions containing a time point in O(log n + k)
+// each node has a center, the sessions containing it, and children with the sessions that end by it and that start after it
+// the center is the midpoint of the median session's midpoint, so both children have at most half of the sessions and the depth is at most log2(n)
+class session_interval_tree
+{
+private:
+	static constexpr std::uint32_t no_node = std::numeric_limits<std::uint32_t>::max();
+
+	// seconds since the epoch, half-open like play_session
+	struct interval_t
+	{
+		std::int64_t start;
+		std::int64_t end;
+		std::uint32_t player;  // index in the store
+	};
+
+	struct node_t
+	{
+		std::int64_t center;
+		// sessions containing center are [first, last) of intervals sorted by start, and the same range of by_end sorted by end, latest first
+		std::uint32_t first, last;
+		std::uint32_t left, right;  // no_node if there are no sessions ending by center or starting after it
+	};
+
+	std::vector<interval_t> intervals;
+	std::vector<std::uint32_t> by_end;  // indices of intervals
+	std::vector<node_t> nodes;  // the root is the first, if there are any
+
+	// make the node of `items`, which is a subrange of intervals
+	[[nodiscard]] std::uint32_t build(std::span<interval_t> items)
+	{
+		if (items.empty())
+			{ return no_node; }
+		const auto midpoint = [](const interval_t& interval) { return interval.start + (interval.end - interval.start) / 2; };
+		const auto median = items.begin() + items.size() / 2;
+		std::ranges::nth_element(items, median, {}, midpoint);
+		const std::int64_t center = midpoint(*median);
+		// sessions are never empty, so the median one contains its midpoint and every node has at least one session
+		const auto crossing = std::partition(items.begin(), items.end(), [center](const interval_t& interval) { return interval.end <= center; });
+		const auto after = std::partition(crossing, items.end(), [center](const interval_t& interval) { return interval.start <= center; });
+		std::sort(crossing, after, [](const interval_t& lhs, const interval_t& rhs) { return lhs.start < rhs.start; });
+
+		const auto first = static_cast<std::uint32_t>(std::to_address(crossing) - intervals.data()),
+			last = static_cast<std::uint32_t>(std::to_address(after) - intervals.data());
+		for (std::uint32_t i = first; i < last; i++)
+			{ by_end[i] = i; }
+		std::sort(by_end.begin() + first, by_end.begin() + last, [this](std::uint32_t lhs, std::uint32_t rhs) { return intervals[lhs].end > intervals[rhs].end; });
+
+		const auto node = static_cast<std::uint32_t>(nodes.size());
+		nodes.push_back({ center, first, last, no_node, no_node });
+		const std::uint32_t left = build(std::span(items.begin(), crossing));
+		const std::uint32_t right = build(std::span(after, items.end()));
+		nodes[node].left = left;
+		nodes[node].right = right;
+		return node;
+	}
+
+public:
+	explicit session_interval_tree(const session_store& store)
+	{
+		for (std::size_t i = 0; i < store.size(); i++)
+		{
+			store.for_each_session(i, time_range{}, [this, i](const play_session& session)
+			{
+				const std::int64_t start = std::chrono::floor<std::chrono::seconds>(session.first.time_since_epoch()).count();
+				const std::int64_t end = start + std::chrono::floor<std::chrono::seconds>(session.second).count();
+				// empty sessions (or ones ending before they start) contain no time
+				if (end > start)
+					{ intervals.push_back({ start, end, static_cast<std::uint32_t>(i) }); }
+			});
+		}
+		by_end.resize(intervals.size());
+		std::ignore = build(intervals);
+	}
+
+	// call f(player index, session) for each session containing `time`, in no particular order
+	void stab(std::chrono::system_clock::time_point time, auto&& f) const
+	{
+		const std::int64_t t = std::chrono::floor<std::chrono::seconds>(time.time_since_epoch()).count();
+		const auto report = [&f](const interval_t& interval)
+			{ f(interval.player, play_session(std::chrono::system_clock::time_point(std::chrono::seconds(interval.start)), std::chrono::seconds(interval.end - interval.start))); };
+		std::uint32_t node_ind = nodes.empty() ? no_node : 0;
+		while (node_ind != no_node)
+		{
+			const node_t& node = nodes[node_ind];
+			// every session of the node contains center, so before it only their starts and after it only their ends need checking
+			if (t < node.center)
+			{
+				for (std::uint32_t i = node.first; i < node.last && intervals[i].start <= t; i++)
+					{ report(intervals[i]); }
+				node_ind = node.left;
+			}
+			else
+			{
+				for (std::uint32_t i = node.first; i < node.last && intervals[by_end[i]].end > t; i++)
+					{ report(intervals[by_end[i]]); }
+				node_ind = node.right;
+			}
+		}
+	}
+
+	// @return number of sessions in the tree (empty ones are left out)
+	[[nodiscard]] std::size_t size() const noexcept
+		{ return intervals.size(); }
+};
+
+// who was online at a time, made once for each set of history segments (see detail::history_cache)
+// each segment has its own tree, and recent data (only latest.log) and online players are checked when querying
+class online_index
+{
+private:
+	std::vector<std::shared_ptr<const session_store>> segments;
+	std::vector<session_interval_tree> trees;  // of segments[i]
+
+public:
+	explicit online_index(std::span<const std::shared_ptr<const session_store>> segments) : segments(segments.begin(), segments.end())
+	{
+		trees.reserve(segments.size());
+		for (const auto& segment : segments)
+			{ trees.emplace_back(*segment); }
+	}
+
+	// @param time  to find the players online at
+	// @param recent, parse_ctx  data that isn't in history yet, for recent sessions and online players
+	// @param now  end of the sessions of online players
+	// @return each player online at `time` once (with the earliest session if they had several, e.g. on several servers), earliest first
+	[[nodiscard]] std::vector<online_at_entry> online_at(std::chrono::system_clock::time_point time, const log_data_t& recent, const parse_ctx_t& parse_ctx,
+		std::chrono::system_clock::time_point now) const
+	{
+		std::vector<online_at_entry> res;
+		for (std::size_t i = 0; i < segments.size(); i++)
+		{
+			const session_store& segment = *segments[i];
+			trees[i].stab(time, [&](std::uint32_t player, const play_session& session)
+			{
+				const auto names = segment.player_names(player);
+				res.emplace_back(segment.uuid(player), names.empty() ? std::string_view() : names.back(), session, false);
+			});
+		}
+		for (const auto& [uuid, data] : recent)
+		{
+			const auto& [names, play_info] = data;
+			for (const play_session& session : play_info.first)
+			{
+				if (session.first <= time && time < session.first + session.second)
+					{ res.emplace_back(uuid, names.empty() ? std::string_view() : std::string_view(names.back()), session, false); }
+			}
+		}
+		for (const std::uint32_t id : parse_ctx.player_info.online())
+		{
+			const auto& [uuid, join_time] = parse_ctx.player_info.infos()[id];
+			if (join_time.value() <= time && time < now)
+				{ res.emplace_back(uuid, parse_ctx.player_info.name(id), play_session(join_time.value(), now - join_time.value()), true); }
+		}
+
+		// names from newer data replace older ones, like the leaderboard does
+		for (online_at_entry& entry : res)
+		{
+			if (!entry.uuid)
+				{ continue; }
+			if (const auto it = recent.find(entry.uuid.value()); it != recent.end() && !it->second.first.empty())
+				{ entry.name = it->second.first.back(); }
+		}
+		std::ranges::sort(res, [](const online_at_entry& lhs, const online_at_entry& rhs) { return lhs.session.first < rhs.session.first; });
+		std::vector<online_at_entry> unique;
+		for (const online_at_entry& entry : res)
+		{
+			const bool seen = std::ranges::any_of(unique, [&entry](const online_at_entry& other)
+				{ return entry.uuid ? (other.uuid == entry.uuid) : (!other.uuid && other.name == entry.name); });
+			if (!seen)
+				{ unique.push_back(entry); }
+		}
+		return unique;
+	}
+};
+
+#endif
@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <libdeflate.h>
+
+#include "event_journal.h"
+#include "line_splitter.h"
+#include "parse_logs.h"
+
+// parses a logs directory with the legacy engine (each line parsed one after another, as parse_line does) and with the engines the bot uses,
+// and compares what they produce, so changes to parsing can't silently change play sessions
+// usage: parse_diff <logs dir> [--format vanilla|paper|forge] [--timezone name] [--batch files]
+// the engines compared to the legacy one are:
+//   pipeline  parse_log_file_events over all files, scanning files in parallel
+//   batched   parse_log_file_events in batches of files continuing the parse context, writing an event journal, like the bot's startup
+//   journal   the same batches again, replaying events from that journal instead of reading the files
+// the events each engine produces are compared in order, so the first file and line where one diverges can be shown,
+// then the resulting log_data_t and parse_ctx_t are compared exactly
+// the exit code is 0 if all engines agree, 1 if any differs, 2 on bad arguments
+
+namespace
+{
+	struct diff_options
+	{
+		std::filesystem::path logs_dir;
+		log_format format = log_format::vanilla;
+		const std::chrono::time_zone* timezone = nullptr;
+		std::size_t batch_size = 64;  // same as the bot's initial parse
+	};
+
+	// a log_event that outlives the call it was passed to
+	struct recorded_event
+	{
+		log_event_type type;
+		std::chrono::system_clock::time_point time;
+		std::string player;
+		std::optional<uuid_t> uuid;
+		std::chrono::system_clock::time_point join_time;
+		std::size_t file;  // index in the manifest
+		std::size_t line;  // line number in the file, 0 if the engine doesn't know it
+
+		[[nodiscard]] bool same_as(const recorded_event& other) const noexcept
+		{
+			return type == other.type && time == other.time && player == other.player && uuid == other.uuid && join_time == other.join_time
+				&& file == other.file;
+		}
+	};
+
+	// what an engine produced
+	struct engine_result
+	{
+		log_data_t data;
+		parse_ctx_t ctx;
+		std::vector<recorded_event> events;
+		std::chrono::steady_clock::duration duration{};
+	};
+
+	// records events and passes them on to a session_aggregator of the result's data
+	class event_recorder
+	{
+	private:
+		engine_result& res;
+		session_aggregator<> aggregator;
+
+	public:
+		std::size_t file = 0;
+		std::size_t line = 0;
+
+		explicit event_recorder(engine_result& res) : res(res), aggregator(res.data) {}
+
+		void operator()(const log_event& event)
+		{
+			res.events.push_back({ event.type, event.time, std::string(event.player), event.uuid, event.join_time, file, line });
+			aggregator(event);
+		}
+	};
+
+	[[nodiscard]] std::string_view event_type_name(log_event_type type) noexcept
+	{
+		switch (type)
+		{
+		case log_event_type::join:
+			return "join";
+		case log_event_type::leave:
+			return "leave";
+		case log_event_type::uuid_bind:
+			return "uuid";
+		case log_event_type::server_stop:
+			return "server stop";
+		case log_event_type::server_start:
+			return "server start";
+		case log_event_type::lag:
+			return "lag";
+		}
+		return "unknown";
+	}
+
+	[[nodiscard]] std::string describe(const recorded_event* event)
+	{
+		if (event == nullptr)
+			{ return "no event"; }
+		std::string res = std::format("{} at {}", event_type_name(event->type), event->time);
+		if (!event->player.empty())
+			{ res += std::format(" of {}", event->player); }
+		if (event->uuid)
+			{ res += std::format(" ({})", event->uuid.value()); }
+		if (event->type == log_event_type::leave)
+			{ res += std::format(", joined at {}", event->join_time); }
+		return res;
+	}
+
+	// @return first part of the parse contexts that differs, or nullopt if they are the same
+	[[nodiscard]] std::optional<std::string> ctx_difference(const parse_ctx_t& lhs, const parse_ctx_t& rhs)
+	{
+		if (lhs.cur_filename != rhs.cur_filename)
+			{ return std::format("cur_filename ({} vs {})", lhs.cur_filename, rhs.cur_filename); }
+		if (lhs.date_tp != rhs.date_tp)
+			{ return std::format("date_tp ({} vs {})", lhs.date_tp, rhs.date_tp); }
+		if (lhs.line != rhs.line)
+			{ return std::format("line ({} vs {})", lhs.line, rhs.line); }
+		if (lhs.server_stopped != rhs.server_stopped)
+			{ return std::format("server_stopped ({} vs {})", lhs.server_stopped, rhs.server_stopped); }
+		// last_line_* only remember the time of the last line that was looked at, which engines are free to differ in, since the next lines
+		// get the same times either way
+		if (lhs.player_info.size() != rhs.player_info.size())
+			{ return std::format("number of players ({} vs {})", lhs.player_info.size(), rhs.player_info.size()); }
+		for (std::uint32_t id = 0; id < lhs.player_info.size(); id++)
+		{
+			const auto& lhs_info = lhs.player_info.infos()[id];
+			const auto& rhs_info = rhs.player_info.infos()[id];
+			if (lhs.player_info.name(id) != rhs.player_info.name(id) || lhs_info.uuid != rhs_info.uuid || lhs_info.join_time != rhs_info.join_time)
+				{ return std::format("player {} ({})", id, lhs.player_info.name(id)); }
+		}
+		if (!std::ranges::equal(lhs.player_info.online(), rhs.player_info.online()))
+			{ return std::string("online players"); }
+		return {};
+	}
+
+	// @return first player whose data differs, or nullopt if the data is the same
+	[[nodiscard]] std::optional<std::string> data_difference(const log_data_t& lhs, const log_data_t& rhs)
+	{
+		if (lhs == rhs)
+			{ return {}; }
+		auto lhs_it = lhs.begin();
+		auto rhs_it = rhs.begin();
+		for (; lhs_it != lhs.end() && rhs_it != rhs.end(); ++lhs_it, ++rhs_it)
+		{
+			if (lhs_it->first != rhs_it->first)
+				{ return std::format("players ({} vs {})", std::min(lhs_it->first, rhs_it->first), std::max(lhs_it->first, rhs_it->first)); }
+			const auto& [lhs_names, lhs_play] = lhs_it->second;
+			const auto& [rhs_names, rhs_play] = rhs_it->second;
+			if (lhs_names != rhs_names)
+				{ return std::format("names of {}", lhs_it->first); }
+			if (lhs_play != rhs_play)
+			{
+				return std::format("sessions of {} ({} sessions, {} total vs {} sessions, {} total)", lhs_it->first, lhs_play.first.size(),
+					std::chrono::duration_cast<std::chrono::seconds>(lhs_play.second), rhs_play.first.size(),
+					std::chrono::duration_cast<std::chrono::seconds>(rhs_play.second));
+			}
+		}
+		return std::format("number of players ({} vs {})", lhs.size(), rhs.size());
+	}
+
+	// the legacy engine: every file read completely and every line parsed one after another, like parse_line does
+	template<log_format_policy line_format>
+	[[nodiscard]] engine_result parse_legacy(const std::vector<log_manifest_entry>& manifest, const diff_options& options)
+	{
+		engine_result res;
+		const auto start = std::chrono::steady_clock::now();
+		event_recorder recorder(res);
+		parse_ctx_t& ctx = res.ctx;
+		detail::log_decompressor decompressor;
+		std::string compressed, contents;
+		bool clear_before = false;
+		std::chrono::system_clock::time_point last_tp;
+		for (std::size_t i = 0; i < manifest.size(); i++)
+		{
+			const auto& file = manifest[i];
+			recorder.file = i;
+			if (file.codec != log_codec::none)
+			{
+				if (detail::read_compressed_file(decompressor, file, compressed, contents) != LIBDEFLATE_SUCCESS)
+					{ continue; }
+			}
+			else
+			{
+				std::ifstream fin(file.path, std::ios::binary);
+				contents.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+			}
+
+			bool file_is_new = true;
+			std::size_t line_num = 0;
+			for (std::string_view line : detail::line_range(contents))
+			{
+				line_num++;
+				while (line.ends_with('\r'))
+					{ line.remove_suffix(1); }
+				// files and lines without anything are skipped as if they weren't there
+				if (line.empty())
+					{ continue; }
+				if (file_is_new)
+				{
+					file_is_new = false;
+					ctx.cur_filename = file.path.filename().string();
+					ctx.date_tp = file.is_latest ? file_modification_date(file.mtime, options.timezone) : std::chrono::sys_days(file.date);
+					if (ctx.date_tp == last_tp)
+						{ clear_before = true; }
+					last_tp = ctx.date_tp;
+				}
+				ctx.line = line_num;
+				recorder.line = line_num;
+				if (!clear_before && !detail::may_be_relevant(line))
+					{ continue; }
+				const auto event = detail::get_line_event<line_format>(line);
+				if (event && detail::apply_line_event(event.value(), ctx, clear_before, recorder).read_valid_line)
+					{ clear_before = false; }
+			}
+		}
+		res.duration = std::chrono::steady_clock::now() - start;
+		return res;
+	}
+
+	// parse_log_file_events over the manifest in batches of `batch_size` files (all of them at once if it is 0)
+	template<log_format_policy line_format>
+	[[nodiscard]] engine_result parse_batched(const std::vector<log_manifest_entry>& manifest, const diff_options& options, std::size_t batch_size,
+		event_journal* journal)
+	{
+		engine_result res;
+		const auto start = std::chrono::steady_clock::now();
+		event_recorder recorder(res);
+		const auto read_file_cb = [&recorder](const log_manifest_entry&) { recorder.file++; };
+		if (batch_size == 0)
+			{ batch_size = std::max<std::size_t>(manifest.size(), 1); }
+		for (std::size_t first = 0; first < manifest.size(); first += batch_size)
+		{
+			std::vector batch(manifest.begin() + first, manifest.begin() + std::min(first + batch_size, manifest.size()));
+			if (journal != nullptr)
+				{ res.ctx = parse_log_file_events<false, line_format>(std::move(batch), options.timezone, read_file_cb, std::move(res.ctx), recorder, *journal); }
+			else
+				{ res.ctx = parse_log_file_events<false, line_format>(std::move(batch), options.timezone, read_file_cb, std::move(res.ctx), recorder); }
+		}
+		res.duration = std::chrono::steady_clock::now() - start;
+		return res;
+	}
+
+	// print how `res` differs from the legacy engine's result
+	// @return whether it is the same
+	bool compare(std::string_view engine, const engine_result& legacy, const engine_result& res, const std::vector<log_manifest_entry>& manifest)
+	{
+		const double secs = std::chrono::duration<double>(res.duration).count();
+		const std::size_t num_events = std::min(legacy.events.size(), res.events.size());
+		std::size_t i = 0;
+		while (i < num_events && legacy.events[i].same_as(res.events[i]))
+			{ i++; }
+		if (i != legacy.events.size() || i != res.events.size())
+		{
+			const recorded_event* legacy_event = (i < legacy.events.size()) ? &legacy.events[i] : nullptr;
+			const recorded_event* event = (i < res.events.size()) ? &res.events[i] : nullptr;
+			// the legacy engine knows the line, otherwise the file is all there is to go by
+			const recorded_event& at = (legacy_event != nullptr) ? *legacy_event : *event;
+			const std::size_t file = (legacy_event != nullptr && event != nullptr) ? std::min(legacy_event->file, event->file) : at.file;
+			const std::string location = (legacy_event != nullptr && legacy_event->file == file)
+				? std::format("{}, line {}", manifest[file].path.filename().string(), legacy_event->line) : manifest[file].path.filename().string();
+			std::cout << std::format("{:<10}DIFFERS at event {} in {}\n          legacy: {}\n          {}: {}\n", engine, i, location, describe(legacy_event),
+				engine, describe(event));
+			return false;
+		}
+		if (const auto difference = data_difference(legacy.data, res.data))
+		{
+			std::cout << std::format("{:<10}DIFFERS in log data after the same events: {}\n", engine, difference.value());
+			return false;
+		}
+		if (const auto difference = ctx_difference(legacy.ctx, res.ctx))
+		{
+			std::cout << std::format("{:<10}DIFFERS in the final parse context: {}\n", engine, difference.value());
+			return false;
+		}
+		std::cout << std::format("{:<10}same ({} events, {} players, {:.3f} s)\n", engine, res.events.size(), res.data.size(), secs);
+		return true;
+	}
+
+	template<log_format_policy line_format>
+	[[nodiscard]] bool run_diff(const diff_options& options)
+	{
+		const auto manifest = scan_logs_dir(options.logs_dir);
+		const engine_result legacy = parse_legacy<line_format>(manifest, options);
+		std::cout << std::format("{} files, legacy engine: {} events, {} players, {:.3f} s\n", manifest.size(), legacy.events.size(), legacy.data.size(),
+			std::chrono::duration<double>(legacy.duration).count());
+
+		bool same = compare("pipeline", legacy, parse_batched<line_format>(manifest, options, 0, nullptr), manifest);
+
+		const std::filesystem::path journal_path = std::filesystem::temp_directory_path() / "parse_diff_journal.bin";
+		std::error_code ec;
+		std::filesystem::remove(journal_path, ec);
+		{
+			event_journal journal(journal_path, options.format);
+			same = compare("batched", legacy, parse_batched<line_format>(manifest, options, options.batch_size, &journal), manifest) && same;
+		}
+		{
+			event_journal journal(journal_path, options.format);
+			same = compare("journal", legacy, parse_batched<line_format>(manifest, options, options.batch_size, &journal), manifest) && same;
+		}
+		std::filesystem::remove(journal_path, ec);
+		return same;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	diff_options options;
+	bool valid = (argc >= 2 && argc % 2 == 0);
+	if (valid)
+		{ options.logs_dir = argv[1]; }
+	try
+	{
+		options.timezone = std::chrono::current_zone();
+		for (int i = 2; valid && i + 1 < argc; i += 2)
+		{
+			const std::string_view name = argv[i], value = argv[i + 1];
+			if (name == "--format")
+			{
+				const auto format = parse_log_format(value);
+				valid = format.has_value();
+				options.format = format.value_or(log_format::vanilla);
+			}
+			else if (name == "--timezone")
+				{ options.timezone = std::chrono::locate_zone(value); }
+			else if (name == "--batch")
+				{ valid = std::from_chars(value.data(), value.data() + value.size(), options.batch_size).ptr == value.data() + value.size() && options.batch_size != 0; }
+			else
+				{ valid = false; }
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << std::format("Invalid timezone: {}\n", e.what());
+		return 2;
+	}
+	if (!valid || !std::filesystem::is_directory(options.logs_dir))
+	{
+		std::cerr << "usage: parse_diff <logs dir> [--format vanilla|paper|forge] [--timezone name] [--batch files]\n";
+		return 2;
+	}
+	// every engine would print the same parsing warnings
+	get_logger().set_min_severity(log_severity::fatal);
+
+	const bool same = with_log_format(options.format, [&]<typename line_format>(line_format) { return run_diff<line_format>(options); });
+	return same ? 0 : 1;
+}
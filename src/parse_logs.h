@@ -3,26 +3,47 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <chrono>
+#include <concepts>
+#include <condition_variable>
 #include <filesystem>
-#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <optional>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <ranges>
 #include <span>
 #include <sstream>
 #include <stdexcept>
+#include <charconv>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <libdeflate.h>
 
+#include "line_splitter.h"
+#include "log_bundle.h"
+#include "log_codec.h"
+#include "logger.h"
+#include "mapped_file.h"
+#include "memory_census.h"
+#include "resource_governor.h"
+#include "small_vector.h"
+#include "tracing.h"
+#include "uring_reader.h"
+#include "uuid_kernels.h"
+
 // for some reason rpcdce.h has this
 #ifdef uuid_t
 #undef uuid_t
@@ -31,7 +52,8 @@
 // pair of join time (time point) and play time (duration)
 using play_session = std::pair<std::chrono::system_clock::time_point, std::chrono::system_clock::duration>;
 // pair of play sessions and total play time (duration)
-using playtime_info = std::pair<std::vector<play_session>, std::chrono::system_clock::duration>;
+// most players only ever joined once or twice, so their sessions are kept inline (see small_vector)
+using playtime_info = std::pair<small_vector<play_session, 2>, std::chrono::system_clock::duration>;
 struct uuid_t  // formatter specialization needs user-defined type so std::pair technically doesn't work
 {
 	std::uint64_t first, second;
@@ -44,6 +66,75 @@ struct uuid_t  // formatter specialization needs user-defined type so std::pair
 	friend bool operator==(uuid_t lhs, uuid_t rhs) = default;
 };
 
+namespace detail
+{
+	inline constexpr std::uint64_t uint64_phi = 0x9e3779b97f4a7c15; // 2^64 / phi (golden ratio), rounded down to odd
+
+	inline std::uint64_t hash_rrmxmx(std::uint64_t x, std::uint64_t gamma = uint64_phi)
+	{
+		x += gamma;
+		x ^= std::rotr(x, 49) ^ std::rotr(x, 24);
+		x *= 0x9FB21C651E98DF25ULL;
+		x ^= x >> 28;
+		x *= 0x9FB21C651E98DF25ULL;
+		return x ^ (x >> 28);
+	}
+
+	inline std::uint64_t hash_combine(std::uint64_t lhs, std::uint64_t rhs)
+	{
+		return hash_rrmxmx(hash_rrmxmx(lhs) + rhs);
+	}
+
+	// uuid index that stores values elsewhere (which must not move while they are in it), without searching a tree for them
+	// open addressing with linear probing, with load factor at most 1/2. uuids are random already, but hashing also spreads made up ones
+	template<typename T>
+	class uuid_index
+	{
+	private:
+		std::vector<std::pair<uuid_t, T*>> slots;  // value is null if empty. size is 0 or a power of 2
+		std::size_t count = 0;
+
+		[[nodiscard]] static std::size_t hash(uuid_t uuid) noexcept
+			{ return static_cast<std::size_t>(hash_combine(uuid.first, uuid.second)); }
+
+		// @return slot containing `uuid`, or the empty slot where it would go
+		[[nodiscard]] std::size_t find_slot(uuid_t uuid) const noexcept
+		{
+			const std::size_t mask = slots.size() - 1;
+			for (std::size_t i = hash(uuid) & mask; ; i = (i + 1) & mask)
+			{
+				if (slots[i].second == nullptr || slots[i].first == uuid)
+					{ return i; }
+			}
+		}
+
+		void grow()
+		{
+			std::vector<std::pair<uuid_t, T*>> old(std::max<std::size_t>(slots.size() * 2, 64));
+			std::swap(old, slots);
+			for (const auto& slot : old)
+			{
+				if (slot.second != nullptr)
+					{ slots[find_slot(slot.first)] = slot; }
+			}
+		}
+
+	public:
+		// @return value of `uuid`, or nullptr if it isn't in the index
+		[[nodiscard]] T* find(uuid_t uuid) const noexcept
+			{ return slots.empty() ? nullptr : slots[find_slot(uuid)].second; }
+
+		// @param value  of `uuid`, which isn't in the index
+		void insert(uuid_t uuid, T* value)
+		{
+			if ((count + 1) * 2 > slots.size())
+				{ grow(); }
+			slots[find_slot(uuid)] = { uuid, value };
+			count++;
+		}
+	};
+}
+
 template<>
 struct std::formatter<uuid_t, char>
 {
@@ -57,42 +148,25 @@ struct std::formatter<uuid_t, char>
 
 	auto format(uuid_t uuid, std::format_context& context) const
 	{
-		static constexpr std::array<char, 16> hex_digits = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
 		std::array<char, 36> chars;
+#ifdef UUID_KERNELS_SIMD
+		const std::uint64_t halves[2] = { uuid.first, uuid.second };
+		detail::uuid_hex_encode(halves, chars.data());
+#else
+		static constexpr std::array<char, 16> hex_digits = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
 		auto it = chars.begin();
-		for (std::size_t i = 0; i < 8; i++)
-		{
-			*it = hex_digits[(uuid.first >> (i * 4)) & 0xF];
-			it++;
-		}
-		*it = '-';
-		it++;
-		for (std::size_t i = 8; i < 12; i++)
-		{
-			*it = hex_digits[(uuid.first >> (i * 4)) & 0xF];
-			it++;
-		}
-		*it = '-';
-		it++;
-		for (std::size_t i = 12; i < 16; i++)
-		{
-			*it = hex_digits[(uuid.first >> (i * 4)) & 0xF];
-			it++;
-		}
-		*it = '-';
-		it++;
-		for (std::size_t i = 0; i < 4; i++)
+		// digit i of the uuid is nibble i of first (i < 16) or second (i >= 16)
+		for (std::size_t i = 0; i < 32; i++)
 		{
-			*it = hex_digits[(uuid.second >> (i * 4)) & 0xF];
-			it++;
-		}
-		*it = '-';
-		it++;
-		for (std::size_t i = 4; i < 16; i++)
-		{
-			*it = hex_digits[(uuid.second >> (i * 4)) & 0xF];
+			if (i == 8 || i == 12 || i == 16 || i == 20)
+			{
+				*it = '-';
+				it++;
+			}
+			*it = hex_digits[((i < 16 ? uuid.first : uuid.second) >> ((i % 16) * 4)) & 0xF];
 			it++;
 		}
+#endif
 		return std::ranges::copy(chars, context.out()).out;
 	}
 };
@@ -100,10 +174,26 @@ struct std::formatter<uuid_t, char>
 namespace detail
 {
 	// @return value or empty optional if uuid has invalid format
-	[[nodiscard]] constexpr std::optional<uuid_t> parse_uuid(std::span<char, 36> str)
+	[[nodiscard]] constexpr std::optional<uuid_t> parse_uuid(std::span<const char, 36> str)
 	{
-		uuid_t uuid{0, 0};
-		constexpr auto hex_digit_to_uint64 = [](char c) -> std::uint64_t
+		// xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
+		for (std::size_t i : { 8, 13, 18, 23 })
+		{
+			if (str[i] != '-')
+				{ return {}; }
+		}
+
+#ifdef UUID_KERNELS_SIMD
+		if !consteval
+		{
+			std::uint64_t halves[2];
+			if (!uuid_hex_decode(str.data(), halves))
+				{ return {}; }
+			return uuid_t{ halves[0], halves[1] };
+		}
+#endif
+
+		constexpr auto hex_digit_value = [](char c) -> int
 		{
 			static_assert('a' + 1 == 'b' && 'b' + 1 == 'c' && 'c' + 1 == 'd' && 'd' + 1 == 'e' && 'e' + 1 == 'f', "lowercase a-f characters not in order, panic!!!");
 			static_assert('A' + 1 == 'B' && 'B' + 1 == 'C' && 'C' + 1 == 'D' && 'D' + 1 == 'E' && 'E' + 1 == 'F', "uppercase A-F characters not in order, panic!!!");
@@ -116,540 +206,2043 @@ namespace detail
 			return -1;
 		};
 
-		// xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
-		for (std::size_t i : { 8, 13, 18, 23})
-		{
-			if (str[i] != '-')
-				{ return {}; }
-		}
-		std::array<char, 32> arr{};
-		std::copy_n(str.begin(), 8, arr.begin());
-		std::copy_n(str.begin() + 9, 4, arr.begin() + 8);
-		std::copy_n(str.begin() + 14, 4, arr.begin() + 12);
-		std::copy_n(str.begin() + 19, 4, arr.begin() + 16);
-		std::copy_n(str.begin() + 24, 12, arr.begin() + 20);
-
-		auto it = arr.cbegin();
-		for (std::size_t i = 0; i < 16; i++)
-		{
-			const auto val = hex_digit_to_uint64(*it) << (i * 4);
-			if (val == -1)
-				{ return {}; }
-			uuid.first += val;
-			it++;
-		}
-		for (std::size_t i = 0; i < 16; i++)
+		// digit i of the uuid is nibble i of first (i < 16) or second (i >= 16)
+		uuid_t uuid{0, 0};
+		std::size_t digit_ind = 0;
+		for (std::size_t i = 0; i < 36; i++)
 		{
-			const auto val = hex_digit_to_uint64(*it) << (i * 4);
+			if (i == 8 || i == 13 || i == 18 || i == 23)
+				{ continue; }
+			const int val = hex_digit_value(str[i]);
 			if (val == -1)
 				{ return {}; }
-			uuid.second += val;
-			it++;
+			auto& half = (digit_ind < 16) ? uuid.first : uuid.second;
+			half |= static_cast<std::uint64_t>(val) << ((digit_ind % 16) * 4);
+			digit_ind++;
 		}
-
 		return uuid;
 	}
-	
-	struct file_read_ctx_t
-	{
-		struct libdeflate_decompressor_deleter
-		{
-			void operator()(libdeflate_decompressor* ptr)
-				{ libdeflate_free_decompressor(ptr); }
-		};
-
-		// used internally by reader:
-		std::unique_ptr<std::istream> fin;  // ifstream or istringstream for gzipped
-		std::vector<std::pair<std::filesystem::path, bool>> paths;  // pair of path and whether the file is a .gz
-		std::size_t path_ind = 0;
-		// updated/initialized by consumer, used by reader:
-		std::unique_ptr<libdeflate_decompressor, libdeflate_decompressor_deleter> decompressor;
-		// updated by reader, to be used by consumer:
-		std::chrono::system_clock::time_point date_tp;  // date assocated with log file (midnight on the log date)
-		std::size_t line = 0;  // line number in current file
-	};
-}
-
-// get time for midnight of the date `p` was last modified (in local time)
-inline std::chrono::system_clock::time_point file_modification_date(const std::filesystem::path& p, const std::chrono::time_zone* target_tz)
-{
-	auto last_write_time = std::chrono::clock_cast<std::chrono::system_clock>(std::filesystem::last_write_time(p));
-	auto write_time_local = target_tz->to_local(last_write_time);
-	write_time_local = std::chrono::floor<std::chrono::days>(write_time_local);
-	return target_tz->to_sys(write_time_local);
 }
 
 namespace detail
 {
-	// @return pair of line data and whether a new file was opened. string will be empty if all lines in all files have been exhausted
-	//         (empty lines will be skipped otherwise)
-	template<bool skip_latest_log>
-	inline std::pair<std::string, bool> get_next_line(file_read_ctx_t& ctx, const std::chrono::time_zone* target_tz)
-	{
-		using namespace std::string_view_literals;
-		if (!ctx.fin || !*(ctx.fin))
-		{
-			if (ctx.path_ind == ctx.paths.size())
-				{ return { {}, false }; }
-			ctx.fin.reset();
-			ctx.line = 0;
-			const auto& [path, is_gz] = ctx.paths[ctx.path_ind];
-			ctx.path_ind++;
-
-			std::string path_filename = path.filename().string();
-			if (!skip_latest_log && path_filename == "latest.log"sv)
-				{ ctx.date_tp = file_modification_date(path, target_tz); }
-			else
-			{
-				std::istringstream path_ss(path_filename);
-				std::chrono::local_time<std::chrono::days> local_tp;
-				if (!std::chrono::from_stream(path_ss, "%4Y-%2m-%2d", local_tp))
-				{
-					std::cout << "WARNING: File name " << path_filename << " has unexpected format" << std::endl;
-					return get_next_line<skip_latest_log>(ctx, target_tz);  // skip to next path
-				}
-				// TODO: handle exception for nonexistent times (or specify non-throwing overload)
-				ctx.date_tp = std::chrono::locate_zone("UTC")->to_sys(local_tp);
-			}
-			
-			if (is_gz)
-			{
-				std::ifstream fin(path, std::ios::binary);
-				const auto size = std::filesystem::file_size(path);
-				std::vector<char> data(size);
-				fin.read(data.data(), size);
-				std::string out_data;
-				libdeflate_result res;
-				out_data.resize_and_overwrite(16777216, [&ctx, &data, &res](char* buf, std::size_t buf_size)
-				{
-					std::size_t out_bytes_used;
-					res = libdeflate_gzip_decompress(ctx.decompressor.get(), data.data(), data.size(), buf, buf_size, &out_bytes_used);
-					return (res == LIBDEFLATE_SUCCESS) ? out_bytes_used : 0;
-				});
-				if (res != LIBDEFLATE_SUCCESS)
-				{
-					switch (res)
-					{
-					case LIBDEFLATE_BAD_DATA:
-						std::cerr << "ERROR: Libdeflate bad data error while decompressing " << path_filename << std::endl;
-						break;
-					case LIBDEFLATE_INSUFFICIENT_SPACE:
-						std::cerr << "ERROR: Libdeflate insufficient space (>16 MiB) error while decompressing " << path_filename << std::endl;
-						break;
-					default:
-						std::cerr << "ERROR: Libdeflate error while decompressing " << path_filename << std::endl;
-						break;
-					}
-					return get_next_line<skip_latest_log>(ctx, target_tz);  // skip to next path
-				}
-				ctx.fin = std::make_unique<std::istringstream>(std::move(out_data));
-			}
-			else
-				{ ctx.fin = std::make_unique<std::ifstream>(path); }
-			return { get_next_line<skip_latest_log>(ctx, target_tz).first, true };
-		}
-		std::string s;
-		std::getline(*(ctx.fin), s);
-		ctx.line++;
-		if (s.empty())
-			{ return get_next_line<skip_latest_log>(ctx, target_tz); }  // skip to next line
-		return { s, false };
-	}
+	class log_bundle;
 }
 
-// return a string of the filename with .log or .log.gz extension removed
-// filename MUST end with .log or .log.gz (check before calling this!)
-[[nodiscard]] inline std::string log_filename_no_ext(const std::pair<std::filesystem::path, bool>& p)
+// when the players logged in an archived log file joined and left, recorded when it is parsed (see archive_summary_collector)
+// so the files with sessions in a time range are found without reading any of them
+struct archive_summary
 {
-	auto p_str = p.first.filename().string();
-	// ".log.gz" -> 7, ".log" -> 4
-	p_str.resize(p_str.size() - (p.second ? 7 : 4));
-	return p_str;
-}
+	std::chrono::system_clock::time_point first = std::chrono::system_clock::time_point::max();
+	std::chrono::system_clock::time_point last = std::chrono::system_clock::time_point::min();
+	std::uint32_t players = 0;  // who joined or left in the file
 
-namespace detail
+	// @return whether nobody joined or left in the file, or it wasn't summarized
+	[[nodiscard]] bool empty() const noexcept
+		{ return first > last; }
+};
+
+// what parsing a log file cost, to find the archives that dominate reading history (e.g. days of a modded server's spam)
+struct file_ingest_stats
 {
-	struct single_player_info
-	{
-		std::optional<uuid_t> uuid;
-		std::optional<std::chrono::system_clock::time_point> join_time;
-	};
-}
+	std::uintmax_t compressed_bytes = 0;  // read, the same as bytes if the file isn't compressed
+	std::uintmax_t bytes = 0;  // of its lines
+	std::size_t lines = 0;
+	std::size_t events = 0;  // lines that matched an event
+	std::chrono::nanoseconds decompress_time{};
+	std::chrono::nanoseconds scan_time{};  // finding the events in its lines, possibly on another thread
+	std::chrono::nanoseconds apply_time{};  // applying the events in order
+	std::uint64_t warnings = 0;  // logged while applying its events
+	bool cached = false;  // its scan came from a scan cache, so it wasn't read (only lines, events and the apply stats are set)
 
-// yes, this needs to be a sorted map (see create_graph)
-using log_data_t = std::map<uuid_t, std::pair<std::vector<std::string>, playtime_info>>;
+	[[nodiscard]] std::chrono::nanoseconds total_time() const noexcept
+		{ return decompress_time + scan_time + apply_time; }
+};
 
-struct parse_ctx_t
+// log file in the logs directory, with everything needed from its name and metadata
+struct log_manifest_entry
 {
-	std::string cur_filename;
-	std::chrono::system_clock::time_point date_tp;
-	std::size_t line = 0;
-	std::unordered_map<std::string, detail::single_player_info> player_info;
-	bool server_stopped = false;
+	std::filesystem::path path;
+	std::chrono::year_month_day date;  // date in file name (unused for latest.log)
+	unsigned int index = 0;  // number after the date in file name, e.g. 2 for yyyy-mm-dd-2.log (unused for latest.log)
+	log_codec codec = log_codec::none;
+	bool is_latest = false;  // whether this is latest.log
+	std::uintmax_t size = 0;
+	std::filesystem::file_time_type mtime;
+	// set if the file is in a backup bundle in the logs directory (see detail::log_bundle), whose path is then followed by the file's name in path
+	std::shared_ptr<detail::log_bundle> bundle;
+	detail::bundle_member_location bundle_location;
+	archive_summary summary;  // of an archive whose data is in history
+	file_ingest_stats ingest;  // of the last time it was parsed in this process, if it was (see parse_log_file_events)
 };
 
+// return a string of the filename with .log, .log.gz, .log.zst or .log.xz extension removed
+[[nodiscard]] inline std::string log_filename_no_ext(const log_manifest_entry& entry)
+{
+	auto p_str = entry.path.filename().string();
+	p_str.resize(p_str.size() - detail::log_extension(entry.codec).size());
+	return p_str;
+}
+
 namespace detail
 {
-	// @tparam file_start_warn  whether to warn when clearing a player (used when clearing players on start)
-	// @return whether someone left
-	template<bool file_start_warn = false>
-	inline bool clear_all_players(parse_ctx_t& ctx, log_data_t& data, std::chrono::system_clock::time_point leave_time)
+	// parse file name of the form yyyy-mm-dd-#.log, or with the extension of a compressed log (e.g. yyyy-mm-dd-#.log.gz)
+	// date is not validated (check with ok())
+	// @return pair of date and number after the date, or empty optional if file name has unexpected format
+	[[nodiscard]] inline std::optional<std::pair<std::chrono::year_month_day, unsigned int>> parse_log_filename(std::string_view filename, log_codec codec)
 	{
-		bool any = false;
-		for (auto& [cur_name, cur_info] : ctx.player_info)
+		const auto ext = log_extension(codec);
+		if (!filename.ends_with(ext))
+			{ return {}; }
+		filename.remove_suffix(ext.size());
+		// yyyy-mm-dd-# (at least one digit after the date)
+		if (filename.size() < 12 || filename[4] != '-' || filename[7] != '-' || filename[10] != '-')
+			{ return {}; }
+		const auto parse_num = [filename](std::size_t first, std::size_t last, unsigned int& out)
 		{
-			auto& [uuid, join_time] = cur_info;
-			if (uuid && join_time)
-			{
-				auto& [names, play_info] = data[uuid.value()];
-				if (names.empty() || names.back() != cur_name)
-					{ names.emplace_back(cur_name); }
-				const auto playtime = leave_time - join_time.value();
-				auto& [play_sessions, total_playtime] = play_info;
-				play_sessions.emplace_back(join_time.value(), playtime);
-				total_playtime += playtime;
-				join_time = {};
-
-				if constexpr (file_start_warn)
-				{
-					std::cout << std::format("WARNING: Player {} never left before server started in file {}, assuming leave time is {:%F %T}",
-						cur_name, ctx.cur_filename, std::chrono::round<std::chrono::seconds>(leave_time)) << std::endl;
-				}
-				any = true;
-			}
-		}
-		return any;
+			const auto res = std::from_chars(filename.data() + first, filename.data() + last, out);
+			return res.ec == std::errc() && res.ptr == filename.data() + last;
+		};
+		unsigned int y, m, d, index;
+		if (!parse_num(0, 4, y) || !parse_num(5, 7, m) || !parse_num(8, 10, d) || !parse_num(11, filename.size(), index))
+			{ return {}; }
+		return std::make_pair(std::chrono::year(y) / std::chrono::month(m) / std::chrono::day(d), index);
 	}
 }
 
-struct line_parse_results
-{
-	// whether a valid line with a timestamp was found. line may or may not have been parsed
-	bool read_valid_line;
-	// whether any player has joined or left (could be multiple)
-	bool player_join_left;
-};
-
-// @tparam strip_ending_cr  whether to remove all trailing CR (\r) characters
-// @param line  string containing line data
-// @param ctx  parse context from previous parsing
-// @param data  data output where new data will be added to
-// @param clear_before  whether to clear all players on first timestamp before parsing contents (used when parsing a new file)
-// @return whether a valid line with a timestamp was found. line may or may not have been parsed
-template<bool strip_ending_cr = true>
-inline line_parse_results parse_line(std::string line, parse_ctx_t& ctx, log_data_t& data, bool clear_before = false)
+// @return manifest entry for `entry`, or empty optional if it isn't a log file
+[[nodiscard]] inline std::optional<log_manifest_entry> make_log_manifest_entry(const std::filesystem::directory_entry& entry)
 {
 	using namespace std::string_view_literals;
-	if constexpr (strip_ending_cr)
+	if (!entry.is_regular_file())
+		{ return {}; }
+	const auto& path = entry.path();
+	const auto filename = path.filename().string();
+	const auto codec = detail::log_codec_of(filename);
+	if (!codec)
+		{ return {}; }
+	log_manifest_entry cur{ .path = path, .date = {}, .index = 0, .codec = codec.value(), .is_latest = false, .size = entry.file_size(), .mtime = entry.last_write_time() };
+	if (filename == "latest.log"sv)
+		{ cur.is_latest = true; }
+	else
 	{
-		while (line.ends_with('\r'))
-			{ line = line.substr(0, line.size() - 1); }
+		const auto parsed = detail::parse_log_filename(filename, cur.codec);
+		if (!parsed)
+			{ return {}; }
+		if (!parsed->first.ok())
+		{
+			log_message(log_severity::warning, std::format("File name {} has unexpected format", filename), log_type::unexpected_file_name);
+			return {};
+		}
+		std::tie(cur.date, cur.index) = parsed.value();
+		if (!detail::log_codec_supported(cur.codec))
+		{
+			log_message(log_severity::warning, std::format("Skipping {}, this build can't decompress {} (see the QC_ZSTD and QC_XZ cmake options)", filename,
+				detail::log_codec_names[static_cast<std::size_t>(cur.codec)]), log_type::unexpected_file_name);
+			return {};
+		}
 	}
-	std::istringstream ss(std::move(line));
-	std::chrono::system_clock::duration time_offset;
-	if (!std::chrono::from_stream(ss, "[%2H:%2M:%2S]", time_offset))
-		{ return { false, false }; }
-	const auto cur_time = ctx.date_tp + time_offset;
-		
-	char c;
-	ss >> c;
-	if (c != '[' || !ss.good())
-		{ return { false, false }; }
-	ss.ignore(std::numeric_limits<std::streamsize>::max(), ']');
-	ss >> std::noskipws >> c >> std::skipws;
-	if (c != ':' || !ss.good())
-		{ return { false, false }; }
-
-	bool players_changed = false;
-	if (clear_before)
-		{ players_changed = detail::clear_all_players<true>(ctx, data, cur_time); }
-		
-	std::string str1, str2, str3, str4;
-	ss >> str1 >> str2;
+	return cur;
+}
 
-	if (!ss)
-		{ return { true, players_changed }; }
-	// sometimes this is issued but not "Stopping the server" if the server crashes
-	if (ss.eof() && str1 == "Stopping"sv && str2 == "server"sv)
+namespace detail
+{
+	struct libdeflate_decompressor_deleter
 	{
-		bool players_changed2 = detail::clear_all_players(ctx, data, cur_time);
-		ctx.server_stopped = true;
-		return { true, players_changed || players_changed2 };
-	}
+		void operator()(libdeflate_decompressor* ptr)
+			{ libdeflate_free_decompressor(ptr); }
+	};
 
-	ss >> str3;
-		
-	if (!ss)
-		{ return { true, players_changed }; }
-	if (ctx.server_stopped)
+	// decompress gzip data (possibly with multiple members) into `out`
+	// output buffer is sized from the ISIZE trailer and grown if that was too small (ISIZE is mod 2^32 and only covers the last member)
+	// trailing data that isn't another gzip member (e.g. zero padding) is ignored
+	// @return LIBDEFLATE_SUCCESS, or the error for the member that failed to decompress
+	// `out` keeps its capacity, so reusing the same string between files avoids reallocating
+	inline libdeflate_result gzip_decompress(libdeflate_decompressor* decompressor, std::string_view in, std::string& out)
 	{
-		if (str1 == "Starting"sv && str2 == "minecraft"sv && str3 == "server"sv)
+		out.clear();  // don't copy old contents if the buffer needs to grow
+		std::size_t capacity = 0;
+		if (in.size() >= 4)
 		{
-			ss >> str1 >> str2;
-			// not going to verify version string
-			if (ss.eof() && str1 == "version"sv)
-				{ ctx.server_stopped = false; }
+			// last 4 bytes, little endian
+			const auto* isize = reinterpret_cast<const unsigned char*>(in.data() + in.size() - 4);
+			capacity = static_cast<std::size_t>(isize[0]) | (static_cast<std::size_t>(isize[1]) << 8) |
+				(static_cast<std::size_t>(isize[2]) << 16) | (static_cast<std::size_t>(isize[3]) << 24);
 		}
-		return { true, players_changed };
-	}
-	if (ss.eof() && str1 == "Stopping"sv && str2 == "the"sv && str3 == "server"sv)
-	{
-		bool players_changed2 = detail::clear_all_players(ctx, data, cur_time);
-		ctx.server_stopped = true;
-		return { true, players_changed || players_changed2 };
+		// hint is wrong if it wrapped around, any log compresses to less than its size anyway
+		capacity = std::max(capacity, in.size());
+
+		std::size_t in_pos = 0, out_size = 0;
+		while (true)
+		{
+			// contents before out_size are preserved when growing
+			out.resize_and_overwrite(capacity, [](char*, std::size_t buf_size) { return buf_size; });
+			std::size_t in_used, out_used;
+			const auto res = libdeflate_gzip_decompress_ex(decompressor, in.data() + in_pos, in.size() - in_pos,
+				out.data() + out_size, capacity - out_size, &in_used, &out_used);
+			if (res == LIBDEFLATE_INSUFFICIENT_SPACE)
+			{
+				capacity *= 2;
+				continue;
+			}
+			if (res != LIBDEFLATE_SUCCESS)
+			{
+				out.resize(out_size);
+				return res;
+			}
+			in_pos += in_used;
+			out_size += out_used;
+			// check for gzip magic bytes of another member
+			if (in.size() - in_pos < 2 || in[in_pos] != '\x1f' || in[in_pos + 1] != '\x8b')
+				{ break; }
+			if (out_size == capacity)
+				{ capacity *= 2; }
+		}
+		out.resize(out_size);
+		return LIBDEFLATE_SUCCESS;
 	}
-		
-	ss >> str4;
-		
-	// UUID of player xxx is xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
-	// xxx joined the game
-	// xxx (formerly known as yyy) joined the game
-	// xxx left the game
-		
-	const auto player_joined = [&](const std::string& player_name)
+
+	// decoders of one thread for every codec (see log_codec), created when first used and reused between files, since they can't be shared between threads
+	class log_decompressor
 	{
-		auto& [uuid, join_time] = ctx.player_info[player_name];
-		if (!uuid)
+	private:
+		std::unique_ptr<libdeflate_decompressor, libdeflate_decompressor_deleter> deflate;
+#ifdef QC_USE_ZSTD
+		std::unique_ptr<ZSTD_DCtx, zstd_dctx_deleter> zstd;
+#endif
+
+	public:
+		// for gzip, and the raw deflate of zip bundles
+		[[nodiscard]] libdeflate_decompressor* get_deflate()
 		{
-			std::cout << "WARNING: UUID not found for player " << player_name << " in file " << ctx.cur_filename << ", line " << ctx.line
-				<< " (expected UUID message before join message)" << std::endl;
+			if (!deflate)
+				{ deflate.reset(libdeflate_alloc_decompressor()); }
+			return deflate.get();
 		}
-		if (join_time)
+
+		// decompress `in` into `out`, which keeps its capacity (see gzip_decompress)
+		// @param codec  not log_codec::none
+		// @return LIBDEFLATE_SUCCESS, or the error it failed with (LIBDEFLATE_BAD_DATA for codecs other than gzip, and those this build can't read)
+		[[nodiscard]] libdeflate_result decompress(log_codec codec, std::string_view in, std::string& out)
 		{
-			std::cout << "WARNING: Player " << player_name << " appears to have joined multiple times without leaving in file " << ctx.cur_filename << ", line " << ctx.line
-				<< " (ignore if server crashed while players were online)" << std::endl;
+			switch (codec)
+			{
+			case log_codec::gzip:
+				return gzip_decompress(get_deflate(), in, out);
+#ifdef QC_USE_ZSTD
+			case log_codec::zstd:
+				if (!zstd)
+					{ zstd.reset(ZSTD_createDCtx()); }
+				return zstd_decompress(zstd.get(), in, out);
+#endif
+#ifdef QC_USE_XZ
+			case log_codec::xz:
+				return xz_decompress(in, out);
+#endif
+			default:
+				out.clear();
+				return LIBDEFLATE_BAD_DATA;
+			}
 		}
-		join_time = cur_time;
 	};
-	// @return true on success
-	const auto player_left = [&](const std::string& player_name)
+
+	// read and decompress entire compressed file into `out`
+	// @param compressed  buffer for compressed file contents, reused between calls
+	// @return LIBDEFLATE_SUCCESS, or the error it failed to decompress with
+	inline libdeflate_result read_compressed_file(log_decompressor& decompressor, const log_manifest_entry& file, std::string& compressed, std::string& out)
 	{
-		auto& [uuid, join_time] = ctx.player_info[player_name];
-		if (!uuid)
-		{
-			std::cerr << "ERROR: UUID not found for player " << player_name << " in file " << ctx.cur_filename << ", line " << ctx.line << std::endl;
-			return false;
-		}
-		if (!join_time)
+		// a file that couldn't be read completely fails to decompress
+		read_file_once(file.path, file.size, compressed);
+		return decompressor.decompress(file.codec, compressed, out);
+	}
+
+	// a tar, tar.gz or zip of log files in the logs directory (e.g. a backup of old logs), whose members are parsed like the files next to it
+	// without being extracted. its contents are loaded when a member is first read and kept until release, so members are read from memory:
+	// a tar or zip is mapped, and a tar.gz is decompressed whole, since libdeflate can't decompress a stream
+	class log_bundle
+	{
+	private:
+		struct contents_t
 		{
-			std::cerr << "ERROR: Join time not found for player " << player_name << " in file " << ctx.cur_filename << ", line " << ctx.line << std::endl;
-			return false;
-		}
+			mapped_file mapping;
+			std::string decompressed;  // of a tar.gz
+			std::string_view data;
+		};
 
-		auto& [names, play_info] = data[uuid.value()];
-		if (names.empty() || names.back() != player_name)
-			{ names.emplace_back(player_name); }
+		std::filesystem::path path;
+		bundle_kind kind;
+		std::mutex mutex;
+		std::shared_ptr<const contents_t> contents;  // null until loaded
 
-		const auto leave_time = cur_time;
-		const auto playtime = leave_time - join_time.value();
-		auto& [play_sessions, total_playtime] = play_info;
-		play_sessions.emplace_back(join_time.value(), playtime);
-		total_playtime += playtime;
-		join_time = {};
-		return true;
-	};
-		
-	if (!ss)
-		{ return { true, players_changed }; }
-	if (str1 == "UUID"sv && str2 == "of"sv && str3 == "player"sv)
-	{
-		// str4 is player name
-		ss >> str1 >> str2;
-		if (ss.eof() && str1 == "is"sv && str2.size() == 36)
+	public:
+		log_bundle(std::filesystem::path path, bundle_kind kind) : path(std::move(path)), kind(kind) {}
+
+		[[nodiscard]] const std::filesystem::path& get_path() const noexcept
+			{ return path; }
+		[[nodiscard]] bundle_kind get_kind() const noexcept
+			{ return kind; }
+
+		// load the contents if they aren't already. members may be read on several threads at once
+		// @return contents of the bundle (decompressed, for tar.gz), which stay valid as long as the pointer is kept, or null on error
+		[[nodiscard]] std::shared_ptr<const std::string_view> load(libdeflate_decompressor* decompressor)
 		{
-			auto uuid = detail::parse_uuid(std::span<char, 36>(str2));
-			if (!uuid)
+			std::scoped_lock lock(mutex);
+			if (!contents)
 			{
-				std::cerr << "ERROR: UUID parsing failed for " << str2 << "(player " << str4 << ") in file " << ctx.cur_filename << ", line " << ctx.line << std::endl;
-				return { true, players_changed };
+				QC_TRACE_SCOPE("load bundle", path.filename().string());
+				auto cur = std::make_shared<contents_t>();
+				if (kind == bundle_kind::tar_gz)
+				{
+					std::string compressed;
+					std::error_code ec;
+					const auto size = std::filesystem::file_size(path, ec);
+					if (ec || !read_file_once(path, size, compressed) ||
+						gzip_decompress(decompressor, compressed, cur->decompressed) != LIBDEFLATE_SUCCESS)
+						{ return nullptr; }
+					cur->data = cur->decompressed;
+				}
+				else
+				{
+					// members are read in the order they are in the file, but not necessarily all of them
+					if (!cur->mapping.open(path))
+						{ return nullptr; }
+					cur->data = cur->mapping.data();
+				}
+				contents = std::move(cur);
 			}
-			ctx.player_info[str4].uuid = uuid.value();
+			return std::shared_ptr<const std::string_view>(contents, &contents->data);
 		}
-		return { true, players_changed };
-	}
-	else if (ss.eof() && str3 == "the"sv && str4 == "game"sv)
-	{
-		// str1 is player name
-		if (str2 == "joined"sv)
+
+		// stop keeping the contents once no more members are about to be read (readers that still have them keep them until they are done)
+		void release()
 		{
-			player_joined(str1);
-			return { true, true };
+			std::scoped_lock lock(mutex);
+			contents.reset();
 		}
-		else if (str2 == "left"sv)
+	};
+
+	// add the log files in a bundle to `manifest`, named like the files in the logs directory (members in subdirectories are included)
+	// a tar.gz is decompressed to find them, and again when they are read, so its contents aren't kept in the meantime
+	// @param path  of the bundle
+	inline void add_bundle_entries(const std::filesystem::path& path, bundle_kind kind, std::vector<log_manifest_entry>& manifest)
+	{
+		QC_TRACE_SCOPE("add_bundle_entries", path.filename().string());
+		auto bundle = std::make_shared<log_bundle>(path, kind);
+		std::unique_ptr<libdeflate_decompressor, libdeflate_decompressor_deleter> decompressor(libdeflate_alloc_decompressor());
+		const auto data = bundle->load(decompressor.get());
+		std::vector<bundle_member> members;
+		if (!data || !((kind == bundle_kind::zip) ? list_zip_members(*data, members) : list_tar_members(*data, members)))
 		{
-			bool players_changed2 = player_left(str1);
-			return { true, players_changed || players_changed2 };
+			log_message(log_severity::error, std::format("Could not read bundle {}{}", path.filename().string(),
+				members.empty() ? std::string() : std::format(", only using the {} files before the error", members.size())));
 		}
-		return { true, players_changed };
-	}
-	else if (str2 == "(formerly"sv && str3 == "known"sv && str4 == "as"sv)
-	{
-		// don't care about the former name
-		ss >> str2 >> str2 >> str3 >> str4;
-		if (ss.eof() && str2 == "joined"sv && str3 == "the"sv && str4 == "game"sv)
+		for (bundle_member& member : members)
 		{
-			player_joined(str1);
-			return { true, true };
+			const std::string_view filename = std::string_view(member.name).substr(member.name.rfind('/') + 1);
+			const auto codec = log_codec_of(filename);
+			const auto parsed = codec ? parse_log_filename(filename, codec.value()) : std::nullopt;
+			if (!parsed || !parsed->first.ok() || !log_codec_supported(codec.value()))
+				{ continue; }
+			manifest.push_back({ .path = path / filename, .date = parsed->first, .index = parsed->second, .codec = codec.value(), .is_latest = false,
+				.size = member.location.size, .mtime = std::chrono::clock_cast<std::chrono::file_clock>(std::chrono::sys_seconds(std::chrono::seconds(member.mtime))),
+				.bundle = bundle, .bundle_location = member.location });
 		}
-		return { true, players_changed };
-	}
-	return { true, players_changed };
-}
-
-// @return whether players have join/left
-inline bool parse_lines(std::string lines, parse_ctx_t& ctx, log_data_t& data)
-{
-	std::string_view line;
-	std::size_t pos = 0;
-	bool players_changed = false;
-	while (true)
-	{
-		std::size_t new_pos = lines.find('\n', pos);
-		line = std::string_view(lines).substr(pos, ((new_pos == std::string::npos) ? lines.size() : new_pos) - pos);
-		if (parse_line(std::string(line), ctx, data).player_join_left)
-			{ players_changed = true; }
-		if (new_pos == std::string::npos)
-			{ break; }
-		pos = new_pos + 1;
+		bundle->release();
 	}
-	return players_changed;
 }
 
-// @tparam save_ctx  whether to save parse context. if false, players still online when the log was last written will "leave" at current system time
-// @param read_file_cb  callback after a file has been completely read and parsed. should accept const std::pair<std::filesystem::path, bool>& as singlular parameter
-// @return pair of log data and parse context if save_ctx is true; log data otherwise
-template<bool skip_latest_log = false, bool save_ctx = false>
-[[nodiscard]] inline std::conditional_t<save_ctx, std::pair<log_data_t, parse_ctx_t>, log_data_t>
-	parse_logs(const std::filesystem::path& logs_dir, const std::chrono::time_zone* target_tz, auto&& read_file_cb)
+// find log files (yyyy-mm-dd-#.log, compressed ones like yyyy-mm-dd-#.log.gz, and latest.log) in `logs_dir`, and those in bundles of them there (see detail::log_bundle)
+// file names are only parsed once here, everything else uses the manifest entries
+// @tparam skip_latest_log  whether to leave out latest.log
+// @return entries sorted by date (ascending), with latest.log last and duplicates removed
+template<bool skip_latest_log = false>
+[[nodiscard]] inline std::vector<log_manifest_entry> scan_logs_dir(const std::filesystem::path& logs_dir)
 {
-	using namespace std::string_view_literals;
-	detail::file_read_ctx_t read_ctx;
-	read_ctx.decompressor.reset(libdeflate_alloc_decompressor());
+	QC_TRACE_SCOPE("scan_logs_dir");
+	std::vector<log_manifest_entry> manifest;
 	for (const auto& entry : std::filesystem::directory_iterator(logs_dir))
 	{
-		if (!entry.is_regular_file())
-			{ continue; }
-		const auto& path = entry.path();
-		const auto ext = path.extension();
-		if (ext != ".gz"sv && ext != ".log"sv)
+		if (const auto kind = detail::bundle_kind_of(entry.path().filename().string()); kind && entry.is_regular_file())
+		{
+			detail::add_bundle_entries(entry.path(), kind.value(), manifest);
+			continue;
+		}
+		auto cur = make_log_manifest_entry(entry);
+		if (!cur || (skip_latest_log && cur->is_latest))
 			{ continue; }
-		read_ctx.paths.emplace_back(path, (ext == ".gz"sv));
+		manifest.emplace_back(std::move(cur.value()));
 	}
-	if (read_ctx.paths.empty())
-		{ return {}; }
-	// yyyy-mm-dd-##.log(.gz) OR latest.log
-	std::erase_if(read_ctx.paths, [](const std::pair<std::filesystem::path, bool>& p)
+	// files in the directory come before the same files in bundles, so they are the ones kept
+	const auto sort_key = [](const log_manifest_entry& entry)
+		{ return std::make_tuple(entry.is_latest, entry.date, entry.index, entry.bundle != nullptr, entry.codec); };
+	std::ranges::sort(manifest, {}, sort_key);
+	// duplicates are the same log both compressed and uncompressed, or both extracted and in a bundle
+	const auto removed_subrange = std::ranges::unique(manifest, [](const auto& lhs, const auto& rhs)
 	{
-		static constexpr auto is_digit = [](char c) { return ('0' <= c) && (c <= '9'); };
-
-		const auto& [path, is_gz] = p;
-		const auto p_str = path.filename().string();
-		if constexpr (!skip_latest_log)
-		{
-			if (p_str == "latest.log"sv)
-				{ return false; }
-		}
-
-		// yyyy, mm, dd, and other digits (must be at least one)
-		for (std::size_t i : { 0, 1, 2, 3, 5, 6, 8, 9, 11 })
+		if (!lhs.is_latest && !rhs.is_latest && lhs.date == rhs.date && lhs.index == rhs.index)
 		{
-			if (!is_digit(p_str[i]))
-				{ return true; }
-		}
-		for (std::size_t i : { 4, 7, 10 })
-		{
-			if (p_str[i] != '-')
-				{ return true; }
+			log_message(log_severity::warning, std::format("duplicate log file found: {}, removing", log_filename_no_ext(lhs)));
+			return true;
 		}
-		std::size_t ind = 12;
-		while (is_digit(p_str[ind]))
-			{ ind++; }
-		return (std::string_view(p_str.begin() + ind, p_str.end()) != (is_gz ? ".log.gz"sv : ".log"sv));
+		return false;
 	});
-	// sort by date, and latest.log last (ascending)
-	std::ranges::sort(read_ctx.paths, [](const auto& lhs, const auto& rhs)
-	{
-		static constexpr auto is_digit = [](char c) { return ('0' <= c) && (c <= '9'); };
+	manifest.erase(removed_subrange.begin(), removed_subrange.end());
+	return manifest;
+}
 
-		const auto lhs_str = lhs.first.filename().string();
-		const auto rhs_str = rhs.first.filename().string();
-		
-		if constexpr (!skip_latest_log)
-		{
-			if (lhs_str == "latest.log"sv)
-				{ return false; }
-			if (rhs_str == "latest.log"sv)
-				{ return true; }
-		}
 
-		// yyyy-mm-dd (first 10 chars)
-		const std::strong_ordering cmp_res = std::lexicographical_compare_three_way(lhs_str.cbegin(), lhs_str.cbegin() + 10, rhs_str.cbegin(), rhs_str.cbegin() + 10);
-		if (cmp_res != std::strong_ordering::equal)
-			{ return std::is_lt(cmp_res); }
-		
-		auto lhs_ind = 12, rhs_ind = 12;
-		while (is_digit(lhs_str[lhs_ind]))
-			{ lhs_ind++; }
-		while (is_digit(rhs_str[rhs_ind]))
-			{ rhs_ind++; }
-		unsigned int lhs_num, rhs_num;
-		std::from_chars(lhs_str.data() + 11, lhs_str.data() + lhs_ind, lhs_num);
-		std::from_chars(rhs_str.data() + 11, rhs_str.data() + rhs_ind, rhs_num);
-		return lhs_num < rhs_num;
-	});
-	const auto removed_subrange = std::ranges::unique(read_ctx.paths, [](const auto& lhs, const auto& rhs)
-	{
-		if (lhs == rhs)
-		{
-			std::cout << "WARNING: duplicate log file found: " << lhs << ", removing" << std::endl;
-			return true;
-		}
+// get time for midnight of the date of `file_time` (in local time)
+inline std::chrono::system_clock::time_point file_modification_date(std::filesystem::file_time_type file_time, const std::chrono::time_zone* target_tz)
+{
+	auto last_write_time = std::chrono::clock_cast<std::chrono::system_clock>(file_time);
+	auto write_time_local = target_tz->to_local(last_write_time);
+	write_time_local = std::chrono::floor<std::chrono::days>(write_time_local);
+	return target_tz->to_sys(write_time_local);
+}
+
+// get time for midnight of the date `p` was last modified (in local time)
+inline std::chrono::system_clock::time_point file_modification_date(const std::filesystem::path& p, const std::chrono::time_zone* target_tz)
+	{ return file_modification_date(std::filesystem::last_write_time(p), target_tz); }
+
+namespace detail
+{
+	struct single_player_info
+	{
+		std::optional<uuid_t> uuid;
+		std::optional<std::chrono::system_clock::time_point> join_time;
+	};
+
+	// player names interned to dense 32-bit ids, with the info for each player stored contiguously by id
+	// looking up a name never allocates, names are only copied the first time they are seen
+	// info is only modified through setters, so the set of online players can be kept up to date
+	class player_table
+	{
+	private:
+		std::vector<std::string> names;  // indexed by id
+		std::vector<std::size_t> name_hashes;  // indexed by id
+		std::vector<single_player_info> player_infos;  // indexed by id
+		std::vector<std::uint32_t> online_ids;  // sorted ids of players with a join time
+		// open addressing with linear probing, holds id + 1 (or 0 if empty). size is 0 or a power of 2
+		std::vector<std::uint32_t> slots;
+
+		[[nodiscard]] static std::size_t hash(std::string_view name) noexcept
+			{ return std::hash<std::string_view>{}(name); }
+
+		// @return slot containing `name`, or the empty slot where it would go
+		[[nodiscard]] std::size_t find_slot(std::string_view name, std::size_t name_hash) const noexcept
+		{
+			const std::size_t mask = slots.size() - 1;
+			for (std::size_t i = name_hash & mask; ; i = (i + 1) & mask)
+			{
+				const std::uint32_t slot = slots[i];
+				if (slot == 0 || (name_hashes[slot - 1] == name_hash && names[slot - 1] == name))
+					{ return i; }
+			}
+		}
+
+		// @param num_slots  power of 2, more than names.size()
+		void rehash(std::size_t num_slots)
+		{
+			slots.assign(num_slots, 0);
+			const std::size_t mask = slots.size() - 1;
+			for (std::uint32_t id = 0; id < names.size(); id++)
+			{
+				std::size_t i = name_hashes[id] & mask;
+				while (slots[i] != 0)
+					{ i = (i + 1) & mask; }
+				slots[i] = id + 1;
+			}
+		}
+
+		void grow()
+			{ rehash(std::max<std::size_t>(slots.size() * 2, 16)); }
+
+	public:
+		// @return id of `name`, or empty optional if it hasn't been seen
+		[[nodiscard]] std::optional<std::uint32_t> find(std::string_view name) const noexcept
+		{
+			if (slots.empty())
+				{ return {}; }
+			const std::uint32_t slot = slots[find_slot(name, hash(name))];
+			if (slot == 0)
+				{ return {}; }
+			return slot - 1;
+		}
+
+		// @return id of `name`, adding it if it hasn't been seen
+		std::uint32_t intern(std::string_view name)
+		{
+			// keep load factor at most 1/2
+			if ((names.size() + 1) * 2 > slots.size())
+				{ grow(); }
+			const std::size_t name_hash = hash(name);
+			std::uint32_t& slot = slots[find_slot(name, name_hash)];
+			if (slot == 0)
+			{
+				names.emplace_back(name);
+				name_hashes.push_back(name_hash);
+				player_infos.emplace_back();
+				slot = static_cast<std::uint32_t>(names.size());
+			}
+			return slot - 1;
+		}
+
+		void set_uuid(std::uint32_t id, uuid_t uuid) noexcept
+			{ player_infos[id].uuid = uuid; }
+
+		// set join time, or clear it if the player left
+		void set_join_time(std::uint32_t id, std::optional<std::chrono::system_clock::time_point> join_time)
+		{
+			auto& cur_join_time = player_infos[id].join_time;
+			if (join_time.has_value() != cur_join_time.has_value())
+			{
+				// few players are online at once, so a sorted vector is cheap to update
+				const auto it = std::ranges::lower_bound(online_ids, id);
+				if (join_time)
+					{ online_ids.insert(it, id); }
+				else
+					{ online_ids.erase(it); }
+			}
+			cur_join_time = join_time;
+		}
+
+		[[nodiscard]] const std::string& name(std::uint32_t id) const noexcept
+			{ return names[id]; }
+
+		// @return info of all players, indexed by id
+		[[nodiscard]] std::span<const single_player_info> infos() const noexcept
+			{ return player_infos; }
+
+		// @return ids of players that have a join time (are online), in ascending order
+		[[nodiscard]] std::span<const std::uint32_t> online() const noexcept
+			{ return online_ids; }
+
+		[[nodiscard]] std::size_t size() const noexcept
+			{ return names.size(); }
+
+		// remove everyone who isn't online, so the table is as large as the number of players online rather than everyone ever seen.
+		// ids of online players change, but stay in the same order
+		// a player's uuid is logged every time they join, so it is only needed until they leave
+		void remove_offline()
+		{
+			if (online_ids.size() == names.size())
+				{ return; }
+			std::vector<std::string> online_names;
+			std::vector<std::size_t> online_hashes;
+			std::vector<single_player_info> online_infos;
+			online_names.reserve(online_ids.size());
+			online_hashes.reserve(online_ids.size());
+			online_infos.reserve(online_ids.size());
+			for (std::uint32_t& id : online_ids)
+			{
+				online_names.push_back(std::move(names[id]));
+				online_hashes.push_back(name_hashes[id]);
+				online_infos.push_back(player_infos[id]);
+				id = static_cast<std::uint32_t>(online_names.size() - 1);
+			}
+			names = std::move(online_names);
+			name_hashes = std::move(online_hashes);
+			player_infos = std::move(online_infos);
+			if (names.empty())
+				{ slots = std::vector<std::uint32_t>(); }
+			else
+				{ rehash(std::bit_ceil(std::max<std::size_t>(names.size() * 2 + 1, 16))); }
+		}
+
+		// @return memory used by the table, players are everyone seen
+		[[nodiscard]] memory_usage memory_used() const noexcept
+		{
+			memory_usage res = strings_memory(names);
+			res.bytes += vector_heap_bytes(name_hashes) + vector_heap_bytes(player_infos) + vector_heap_bytes(online_ids) + vector_heap_bytes(slots);
+			res.players = names.size();
+			return res;
+		}
+	};
+}
+
+// yes, this needs to be a sorted map (see create_graph)
+// names are almost always just one, which is kept inline like the sessions of playtime_info
+using log_data_t = std::map<uuid_t, std::pair<small_vector<std::string, 1>, playtime_info>>;
+// log_data_t allocating from a memory resource, for bulk ingest where data is only added to and then compacted into a session_store
+// (see session_history::commit), so it can come from an arena (std::pmr::monotonic_buffer_resource) that is released all at once.
+// nothing may be removed from it while a session_aggregator adds to it
+using pmr_log_data_t = std::pmr::map<uuid_t, std::pair<std::pmr::vector<std::pmr::string>,
+	std::pair<std::pmr::vector<play_session>, std::chrono::system_clock::duration>>>;
+
+template<typename T>
+concept log_data_like = std::same_as<T, log_data_t> || std::same_as<T, pmr_log_data_t>;
+
+// uuids of player names known from outside the logs (e.g. the server's usercache.json), for players whose uuid line isn't in the files parsed
+using known_uuids_t = std::map<std::string, uuid_t, std::less<>>;
+
+struct parse_ctx_t
+{
+	std::string cur_filename;
+	std::chrono::system_clock::time_point date_tp;
+	std::size_t line = 0;
+	detail::player_table player_info;
+	bool server_stopped = false;
+	// last decoded timestamp (seconds since midnight, or -1 if none), so consecutive lines in the same second reuse the time point
+	int last_line_secs = -1;
+	std::chrono::system_clock::time_point last_line_date_tp, last_line_tp;
+	// bindings used when a player joins or leaves without a uuid, so parsing can start after their uuid was logged (null if there are none)
+	std::shared_ptr<const known_uuids_t> known_uuids;
+};
+
+// @return memory used by `data` (see memory_usage)
+template<log_data_like data_t>
+[[nodiscard]] inline memory_usage memory_used(const data_t& data) noexcept
+{
+	memory_usage res{ .bytes = sizeof(data) + data.size() * (sizeof(typename data_t::value_type) + detail::tree_node_overhead), .players = data.size() };
+	for (const auto& [uuid, player_data] : data)
+	{
+		res += detail::strings_memory(player_data.first);
+		res.bytes += detail::vector_heap_bytes(player_data.second.first);
+		res.sessions += player_data.second.first.size();
+	}
+	return res;
+}
+
+// @return memory used by `ctx` (see memory_usage), with all players ever seen
+[[nodiscard]] inline memory_usage memory_used(const parse_ctx_t& ctx) noexcept
+{
+	memory_usage res = ctx.player_info.memory_used();
+	const std::size_t filename_bytes = detail::string_heap_bytes(ctx.cur_filename);
+	res.bytes += sizeof(ctx) + filename_bytes;
+	res.string_bytes += filename_bytes;
+	return res;
+}
+
+enum class log_event_type : std::uint8_t
+{
+	join,
+	leave,  // including players that never left before the server stopped (or started again)
+	uuid_bind,  // uuid of a player's name is known
+	server_stop,
+	server_start,
+	lag  // server fell behind on ticks
+};
+
+// something that changed while parsing. players that join and leave make sessions (see session_aggregator),
+// other statistics can be gathered from the same events without parsing again (see parse_events)
+struct log_event
+{
+	log_event_type type;
+	std::chrono::system_clock::time_point time;
+	std::string_view player;  // name, for join, leave and uuid_bind. only valid during the call it is passed to
+	std::optional<uuid_t> uuid;  // set for leave and uuid_bind, and for join if it is known
+	std::chrono::system_clock::time_point join_time;  // for leave, start of the session
+	std::chrono::milliseconds behind{};  // for lag, how far behind the server was
+};
+
+// adds the sessions of players who leave to log data
+// a player who joins again less than `merge_gap` after their last session in `data` ended (e.g. reconnecting after a crash or timeout)
+// continues that session instead of starting a new one. the gap counts as playtime, so totals are always the sum of session lengths
+template<log_data_like data_t = log_data_t>
+class session_aggregator
+{
+private:
+	data_t& data;
+	std::chrono::system_clock::duration merge_gap;
+	// pmr_log_data_t is only added to, so its players are found through an index of their entries (tree nodes don't move) instead of
+	// a tree search for every session. entries added to it by anything else are still found in the tree
+	detail::uuid_index<typename data_t::mapped_type> index;
+
+	[[nodiscard]] typename data_t::mapped_type& player_data(uuid_t uuid)
+	{
+		if constexpr (std::same_as<data_t, pmr_log_data_t>)
+		{
+			if (auto* found = index.find(uuid))
+				{ return *found; }
+			auto& res = data[uuid];
+			index.insert(uuid, &res);
+			return res;
+		}
+		else
+			{ return data[uuid]; }
+	}
+
+public:
+	// @param merge_gap  zero to never merge sessions
+	explicit session_aggregator(data_t& data, std::chrono::system_clock::duration merge_gap = {}) noexcept : data(data), merge_gap(merge_gap) {}
+
+	void operator()(const log_event& event)
+	{
+		if (event.type != log_event_type::leave)
+			{ return; }
+		auto& [names, play_info] = player_data(event.uuid.value());
+		if (names.empty() || names.back() != event.player)
+			{ names.emplace_back(event.player); }
+		auto& [play_sessions, total_playtime] = play_info;
+		if (!play_sessions.empty())
+		{
+			auto& [last_start, last_length] = play_sessions.back();
+			const auto gap = event.join_time - (last_start + last_length);
+			if (gap >= std::chrono::system_clock::duration::zero() && gap < merge_gap)
+			{
+				const auto added = event.time - (last_start + last_length);
+				last_length += added;
+				total_playtime += added;
+				return;
+			}
+		}
+		const auto playtime = event.time - event.join_time;
+		play_sessions.emplace_back(event.join_time, playtime);
+		total_playtime += playtime;
+	}
+};
+
+// @return consumer of log events that passes them to each of `consumers` (which must outlive it), in order
+[[nodiscard]] inline auto combine_consumers(auto&... consumers)
+	{ return [&consumers...](const log_event& event) { (consumers(event), ...); }; }
+
+namespace detail
+{
+	// give player `id` their uuid from ctx.known_uuids if their uuid line wasn't parsed
+	inline void bind_known_uuid(parse_ctx_t& ctx, std::uint32_t id)
+	{
+		if (!ctx.known_uuids || ctx.player_info.infos()[id].uuid)
+			{ return; }
+		if (const auto it = ctx.known_uuids->find(ctx.player_info.name(id)); it != ctx.known_uuids->end())
+			{ ctx.player_info.set_uuid(id, it->second); }
+	}
+
+	// @tparam file_start_warn  whether to warn when clearing a player (used when clearing players on start)
+	// @param consumer  receives a leave event for each player cleared
+	// @return whether someone left
+	template<bool file_start_warn = false>
+	inline bool clear_all_players(parse_ctx_t& ctx, std::chrono::system_clock::time_point leave_time, auto&& consumer)
+	{
+		bool any = false;
+		// copied since clearing players modifies it
+		const std::vector<std::uint32_t> online_ids(ctx.player_info.online().begin(), ctx.player_info.online().end());
+		for (const std::uint32_t id : online_ids)
+		{
+			const auto& [uuid, join_time] = ctx.player_info.infos()[id];
+			if (uuid)
+			{
+				const auto& cur_name = ctx.player_info.name(id);
+				consumer(log_event{ log_event_type::leave, leave_time, cur_name, uuid, join_time.value() });
+				ctx.player_info.set_join_time(id, std::nullopt);
+
+				if constexpr (file_start_warn)
+				{
+					log_message(log_severity::warning, std::format("Player {} never left before server started in file {}, assuming leave time is {:%F %T}",
+						cur_name, ctx.cur_filename, std::chrono::round<std::chrono::seconds>(leave_time)), log_type::never_left);
+				}
+				any = true;
+			}
+		}
+		return any;
+	}
+
+	// @tparam file_start_warn  see above
+	// @return whether someone left
+	template<bool file_start_warn = false>
+	inline bool clear_all_players(parse_ctx_t& ctx, log_data_t& data, std::chrono::system_clock::time_point leave_time)
+		{ return clear_all_players<file_start_warn>(ctx, leave_time, session_aggregator(data)); }
+
+	// @param list  names separated by ", ", as the server lists them (see line_event_type::player_list)
+	// @return the names, views into `list`
+	[[nodiscard]] inline std::vector<std::string_view> split_player_list(std::string_view list)
+	{
+		std::vector<std::string_view> res;
+		while (!list.empty())
+		{
+			const std::size_t comma = std::min(list.find(','), list.size());
+			std::string_view name = list.substr(0, comma);
+			name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+			name.remove_suffix(name.size() - (name.find_last_not_of(' ') + 1));
+			if (!name.empty())
+				{ res.push_back(name); }
+			list.remove_prefix(std::min(comma + 1, list.size()));
+		}
+		return res;
+	}
+
+	// make the online players exactly `listed`, for when the server said who is online (its /list output, in the log or over rcon)
+	// players who aren't listed leave and those who aren't online join at `time`, since their own lines were missed (e.g. before the log starts)
+	// @param where  where the list is from, for warnings (e.g. "in the player list in file x, line y")
+	// @param consumer  receives what changed (see log_event)
+	// @return whether someone joined or left
+	inline bool reconcile_online_players(parse_ctx_t& ctx, std::span<const std::string_view> listed, std::chrono::system_clock::time_point time,
+		std::string_view where, auto&& consumer)
+	{
+		bool any = false;
+		// copied since clearing players modifies it
+		const std::vector<std::uint32_t> online_ids(ctx.player_info.online().begin(), ctx.player_info.online().end());
+		for (const std::uint32_t id : online_ids)
+		{
+			const std::string& cur_name = ctx.player_info.name(id);
+			if (std::ranges::find(listed, std::string_view(cur_name)) != listed.end())
+				{ continue; }
+			log_message(log_severity::warning, std::format("Player {} isn't {}, assuming they left at {:%F %T}", cur_name, where,
+				std::chrono::round<std::chrono::seconds>(time)), log_type::player_list_mismatch);
+			const auto& [uuid, join_time] = ctx.player_info.infos()[id];
+			if (uuid)
+				{ consumer(log_event{ log_event_type::leave, time, cur_name, uuid, join_time.value() }); }
+			ctx.player_info.set_join_time(id, std::nullopt);
+			any = true;
+		}
+		for (const std::string_view name : listed)
+		{
+			const std::uint32_t id = ctx.player_info.intern(name);
+			if (ctx.player_info.infos()[id].join_time)
+				{ continue; }
+			bind_known_uuid(ctx, id);
+			log_message(log_severity::warning, std::format("Player {} is {} without having joined, assuming they joined at {:%F %T}", name, where,
+				std::chrono::round<std::chrono::seconds>(time)), log_type::player_list_mismatch);
+			ctx.player_info.set_join_time(id, time);
+			consumer(log_event{ log_event_type::join, time, ctx.player_info.name(id), ctx.player_info.infos()[id].uuid, {} });
+			any = true;
+		}
+		return any;
+	}
+}
+
+struct line_parse_results
+{
+	// whether a valid line with a timestamp was found. line may or may not have been parsed
+	// only reliable if clear_before was set, otherwise irrelevant lines are rejected before their timestamp is checked
+	bool read_valid_line;
+	// whether any player has joined or left (could be multiple)
+	bool player_join_left;
+};
+
+namespace detail
+{
+	// decode the [HH:MM:SS] timestamp at the start of `str`
+	// all characters are validated together, so there is only one branch on the result
+	// @tparam end  character after the seconds, e.g. ' ' for "[HH:MM:SS LEVEL]"
+	// @return seconds since midnight, or -1 if `str` doesn't start with a valid timestamp
+	template<char end = ']'>
+	[[nodiscard]] constexpr int parse_timestamp(std::string_view str) noexcept
+	{
+		if (str.size() < 10)
+			{ return -1; }
+		// wraps around for characters below '0', so a single comparison checks both bounds
+		const auto digit = [str](std::size_t i) { return static_cast<unsigned int>(static_cast<unsigned char>(str[i])) - '0'; };
+		const unsigned int h1 = digit(1), h2 = digit(2), m1 = digit(4), m2 = digit(5), s1 = digit(7), s2 = digit(8);
+		const unsigned int hours = h1 * 10 + h2, minutes = m1 * 10 + m2, seconds = s1 * 10 + s2;
+		const bool valid = (str[0] == '[') & (str[3] == ':') & (str[6] == ':') & (str[9] == end) &
+			(h1 <= 9) & (h2 <= 9) & (m1 <= 9) & (m2 <= 9) & (s1 <= 9) & (s2 <= 9) &
+			(hours <= 23) & (minutes <= 59) & (seconds <= 60);
+		return valid ? static_cast<int>(hours * 3600 + minutes * 60 + seconds) : -1;
+	}
+	static_assert(parse_timestamp("[00:00:00]") == 0 && parse_timestamp("[23:59:60] x") == 86400 && parse_timestamp("[01:02:03]") == 3723);
+	static_assert(parse_timestamp("[24:00:00]") == -1 && parse_timestamp("[0a:00:00]") == -1 && parse_timestamp("(00:00:00]") == -1 && parse_timestamp("[00:00:0") == -1);
+	static_assert(parse_timestamp<' '>("[01:02:03 INFO]") == 3723 && parse_timestamp<' '>("[01:02:03]") == -1);
+
+	// @return position after the "[...]" group starting at `pos` (after whitespace), or npos if there isn't one
+	[[nodiscard]] constexpr std::size_t skip_bracket_group(std::string_view line, std::size_t pos) noexcept
+	{
+		using namespace std::string_view_literals;
+		pos = line.find_first_not_of(" \t\n\v\f\r"sv, pos);
+		if (pos == std::string_view::npos || line[pos] != '[')
+			{ return std::string_view::npos; }
+		pos = line.find(']', pos + 1);
+		return (pos == std::string_view::npos) ? pos : pos + 1;
+	}
+}
+
+// start of a log line, before the message
+struct log_line_prefix
+{
+	int secs;  // seconds since midnight
+	std::size_t message_pos;  // in the line
+};
+
+// log line layouts, used as the format policy of the parsing functions (see log_format_policy)
+// each only checks for its own layout, so no detection has to be done for each line
+
+// [HH:MM:SS] [Server thread/INFO]: message
+struct vanilla_log_format
+{
+	[[nodiscard]] static constexpr std::optional<log_line_prefix> parse_prefix(std::string_view line) noexcept
+	{
+		const int secs = detail::parse_timestamp(line);
+		if (secs == -1)
+			{ return {}; }
+		const std::size_t pos = detail::skip_bracket_group(line, 10);
+		if (pos >= line.size() || line[pos] != ':')
+			{ return {}; }
+		return log_line_prefix{ secs, pos + 1 };
+	}
+};
+
+// [HH:MM:SS INFO]: message (Paper, Spigot and Bukkit)
+struct paper_log_format
+{
+	[[nodiscard]] static constexpr std::optional<log_line_prefix> parse_prefix(std::string_view line) noexcept
+	{
+		const int secs = detail::parse_timestamp<' '>(line);
+		if (secs == -1)
+			{ return {}; }
+		const std::size_t pos = line.find(']', 10);
+		if (pos == std::string_view::npos || pos + 1 == line.size() || line[pos + 1] != ':')
+			{ return {}; }
+		return log_line_prefix{ secs, pos + 2 };
+	}
+};
+
+// [HH:MM:SS] [Server thread/INFO] [minecraft/DedicatedServer]: message
+struct forge_log_format
+{
+	[[nodiscard]] static constexpr std::optional<log_line_prefix> parse_prefix(std::string_view line) noexcept
+	{
+		const int secs = detail::parse_timestamp(line);
+		if (secs == -1)
+			{ return {}; }
+		std::size_t pos = detail::skip_bracket_group(line, 10);
+		if (pos >= line.size() || line[pos] != ' ')
+			{ return {}; }
+		pos = detail::skip_bracket_group(line, pos);
+		if (pos >= line.size() || line[pos] != ':')
+			{ return {}; }
+		return log_line_prefix{ secs, pos + 1 };
+	}
+};
+
+static_assert(vanilla_log_format::parse_prefix("[01:02:03] [Server thread/INFO]: x")->message_pos == 32 && !vanilla_log_format::parse_prefix("[01:02:03 INFO]: x"));
+static_assert(paper_log_format::parse_prefix("[01:02:03 INFO]: x")->message_pos == 16 && !paper_log_format::parse_prefix("[01:02:03] [Server thread/INFO]: x"));
+static_assert(forge_log_format::parse_prefix("[01:02:03] [Server thread/INFO] [minecraft/DedicatedServer]: x")->message_pos == 60 &&
+	!forge_log_format::parse_prefix("[01:02:03] [Server thread/INFO]: x"));
+
+template<typename T>
+concept log_format_policy = requires(std::string_view line)
+{
+	{ T::parse_prefix(line) } -> std::same_as<std::optional<log_line_prefix>>;
+};
+
+// log line layout chosen at runtime (e.g. from config), see with_log_format
+enum class log_format : std::uint8_t
+{
+	vanilla,
+	paper,
+	forge
+};
+
+inline constexpr std::array<std::string_view, 3> log_format_names = { "vanilla", "paper", "forge" };  // indexed by log_format
+
+// @return format named `name` (see log_format_names), or empty optional if there is none
+[[nodiscard]] inline std::optional<log_format> parse_log_format(std::string_view name) noexcept
+{
+	const auto it = std::ranges::find(log_format_names, name);
+	if (it == log_format_names.end())
+		{ return {}; }
+	return static_cast<log_format>(it - log_format_names.begin());
+}
+
+// call `func` with the policy of `format`, so the parsing functions it calls are specialized for it
+// @return what `func` returns
+inline decltype(auto) with_log_format(log_format format, auto&& func)
+{
+	switch (format)
+	{
+	case log_format::paper:
+		return func(paper_log_format());
+	case log_format::forge:
+		return func(forge_log_format());
+	default:
+		return func(vanilla_log_format());
+	}
+}
+
+namespace detail
+{
+
+	// @param secs  seconds since midnight, from parse_timestamp
+	// @return time point of a line with timestamp `secs` in the current file
+	inline std::chrono::system_clock::time_point line_time(parse_ctx_t& ctx, int secs)
+	{
+		if (secs != ctx.last_line_secs || ctx.date_tp != ctx.last_line_date_tp)
+		{
+			ctx.last_line_secs = secs;
+			ctx.last_line_date_tp = ctx.date_tp;
+			ctx.last_line_tp = ctx.date_tp + std::chrono::seconds(secs);
+		}
+		return ctx.last_line_tp;
+	}
+
+	// splits a line into whitespace-separated tokens (same whitespace as std::isspace in the C locale)
+	// mirrors the semantics of extracting std::strings with operator>>, without copying anything
+	class line_tokenizer
+	{
+	private:
+		std::string_view str;
+		std::size_t pos = 0;
+
+		static constexpr bool is_space(char c)
+			{ return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; }
+
+	public:
+		constexpr explicit line_tokenizer(std::string_view str, std::size_t pos = 0) : str(str), pos(pos) {}
+
+		// skip whitespace and read the next token
+		// @return token, or empty string_view if there are no more tokens
+		constexpr std::string_view next()
+		{
+			while (pos < str.size() && is_space(str[pos]))
+				{ pos++; }
+			const std::size_t begin = pos;
+			while (pos < str.size() && !is_space(str[pos]))
+				{ pos++; }
+			return str.substr(begin, pos - begin);
+		}
+
+		// @return whether the end of the line has been reached (no more characters, including whitespace)
+		[[nodiscard]] constexpr bool eof() const noexcept
+			{ return pos == str.size(); }
+	};
+
+	// what a line does. it only depends on the line itself, what it does to the parse context is in apply_line_event
+	enum class line_event_type : std::uint8_t
+	{
+		none,  // valid line that doesn't do anything by itself
+		stopping_server,  // "Stopping server", sometimes issued without "Stopping the server" if the server crashes
+		stopping_the_server,
+		starting_server,  // "Starting minecraft server version x"
+		uuid,  // "UUID of player `name` is `uuid`"
+		invalid_uuid,  // same, but `text` isn't a valid uuid
+		joined,  // "`name` joined the game" or "`name` (formerly known as x) joined the game"
+		left,  // "`name` left the game"
+		player_list,  // "There are x of a max of y players online: `text`" (the output of /list), where `text` is the names separated by ", "
+		lag  // "Can't keep up! Is the server overloaded? Running `text`ms or x ticks behind", or the older message with "skipping x tick(s)"
+	};
+
+	struct line_event
+	{
+		line_event_type type;
+		int secs;  // see parse_timestamp
+		std::string_view name;  // of the player
+		std::string_view text;  // invalid uuid, or milliseconds behind
+		uuid_t uuid{};
+	};
+
+	// a message get_line_event recognizes, as its whitespace-separated tokens (all of them, with nothing after the last)
+	// "{name}" is the player's name, "{uuid}" their uuid (a line with another 36 character token there is invalid_uuid, with it as the text),
+	// "{text}" is kept as the event's text, "{}" is any token, and every other token must be the same
+	// characters after a placeholder must end the token, and aren't part of what is kept (e.g. "{text}ms" keeps "25" of "25ms")
+	// "{list}" can only be the last token, and is the rest of the message (any number of tokens, or none), kept as the text
+	struct message_pattern
+	{
+		line_event_type type;
+		std::string_view message;
+	};
+
+	// adding one costs nothing for lines that match none (see message_dispatcher). each must contain one of relevant_words,
+	// and ones with the same number of tokens must have their first literal token in the same place, which doesn't compile otherwise
+	inline constexpr std::array message_patterns = {
+		message_pattern{ line_event_type::stopping_server, "Stopping server" },
+		message_pattern{ line_event_type::stopping_the_server, "Stopping the server" },
+		message_pattern{ line_event_type::starting_server, "Starting minecraft server version {}" },  // not going to verify version string
+		message_pattern{ line_event_type::uuid, "UUID of player {name} is {uuid}" },
+		message_pattern{ line_event_type::joined, "{name} joined the game" },
+		message_pattern{ line_event_type::joined, "{name} (formerly known as {}) joined the game" },  // don't care about the former name
+		message_pattern{ line_event_type::left, "{name} left the game" },
+		message_pattern{ line_event_type::player_list, "There are {} of a max of {} players online: {list}" },
+		message_pattern{ line_event_type::lag, "Can't keep up! Is the server overloaded? Running {text}ms or {} ticks behind" },
+		message_pattern{ line_event_type::lag, "Can't keep up! Did the system time change, or is the server overloaded? Running {text}ms behind, skipping {} tick(s)" }
+	};
+
+	// every message in message_patterns contains one of these, so lines without any can be skipped (see may_be_relevant)
+	inline constexpr std::array<std::string_view, 6> relevant_words = { "UUID", "game", "Stopping", "Starting", "Can't", "There" };
+
+	// message_patterns split into tokens, with a perfect hash table of them by their number of tokens and first literal token, made at compile time
+	// a message is split into tokens once, and the only pattern it can be is found with one hash and then checked (see match_message),
+	// so matching a line takes the same time however many patterns there are
+	class message_dispatcher
+	{
+	public:
+		static constexpr std::size_t max_tokens = 20;
+
+		enum class token_kind : std::uint8_t
+		{
+			literal,
+			name,
+			uuid,
+			text,
+			any,
+			list
+		};
+
+		struct pattern_t
+		{
+			line_event_type type = line_event_type::none;
+			std::size_t num_tokens = 0;
+			std::size_t key_pos = max_tokens;  // of the first literal token
+			std::array<std::string_view, max_tokens> tokens{};  // literal tokens, and what must follow placeholders
+			std::array<token_kind, max_tokens> kinds{};
+		};
+
+	private:
+		static constexpr std::size_t table_size = std::bit_ceil(message_patterns.size() * 2);
+		static constexpr std::uint8_t empty_slot = 0xff;
+
+		std::array<pattern_t, message_patterns.size()> patterns{};
+		std::array<std::size_t, max_tokens + 1> key_pos_of{};  // key_pos of the patterns with i tokens, max_tokens if there are none
+		std::array<std::uint8_t, table_size> table{};  // index in patterns, by hash
+		std::array<std::uint8_t, message_patterns.size()> list_patterns{};  // indices in patterns of those ending with {list}
+		std::size_t num_list_patterns = 0;
+		std::uint64_t seed = 0;
+
+		// from the key's length and first and last characters, which is enough to tell the patterns apart and much cheaper than hashing all of it
+		[[nodiscard]] static constexpr std::size_t slot(std::uint64_t seed, std::size_t num_tokens, std::string_view key) noexcept
+		{
+			const std::uint64_t x = (static_cast<std::uint64_t>(static_cast<unsigned char>(key.front())) << 24)
+				| (static_cast<std::uint64_t>(static_cast<unsigned char>(key.back())) << 16) | ((key.size() & 0xff) << 8) | num_tokens;
+			return static_cast<std::size_t>(((x + seed) * 0x9e3779b97f4a7c15) >> 32) % table_size;
+		}
+
+	public:
+		// fails to compile (by throwing) if a pattern isn't valid
+		consteval message_dispatcher()
+		{
+			key_pos_of.fill(max_tokens);
+			for (std::size_t i = 0; i < message_patterns.size(); i++)
+			{
+				pattern_t& pattern = patterns[i];
+				pattern.type = message_patterns[i].type;
+				bool relevant = false;
+				line_tokenizer tokens(message_patterns[i].message);
+				for (std::string_view token = tokens.next(); !token.empty(); token = tokens.next())
+				{
+					if (pattern.num_tokens == max_tokens)
+						{ throw "message pattern has more than max_tokens tokens"; }
+					const std::string_view placeholder = token.substr(0, token.starts_with('{') ? token.find('}') + 1 : 0);
+					const token_kind kind = (placeholder == "{name}") ? token_kind::name : (placeholder == "{uuid}") ? token_kind::uuid :
+						(placeholder == "{text}") ? token_kind::text : (placeholder == "{}") ? token_kind::any : (placeholder == "{list}") ? token_kind::list :
+						token_kind::literal;
+					if (kind == token_kind::literal && !placeholder.empty())
+						{ throw "unknown placeholder in message pattern"; }
+					if (pattern.num_tokens != 0 && pattern.kinds[pattern.num_tokens - 1] == token_kind::list)
+						{ throw "{list} isn't the last token of message pattern"; }
+					if (kind == token_kind::list && token != placeholder)
+						{ throw "characters after {list} in message pattern"; }
+					if (kind == token_kind::literal && pattern.key_pos == max_tokens)
+						{ pattern.key_pos = pattern.num_tokens; }
+					relevant = relevant || std::ranges::any_of(relevant_words, [token](std::string_view word) { return token.find(word) != std::string_view::npos; });
+					pattern.tokens[pattern.num_tokens] = (kind == token_kind::literal) ? token : token.substr(placeholder.size());
+					pattern.kinds[pattern.num_tokens] = kind;
+					pattern.num_tokens++;
+				}
+				if (pattern.key_pos == max_tokens)
+					{ throw "message pattern has no literal token"; }
+				if (!relevant)
+					{ throw "message pattern contains none of relevant_words"; }
+				if (key_pos_of[pattern.num_tokens] != max_tokens && key_pos_of[pattern.num_tokens] != pattern.key_pos)
+					{ throw "message patterns with the same number of tokens have their first literal token in different places"; }
+				key_pos_of[pattern.num_tokens] = pattern.key_pos;
+				if (pattern.kinds[pattern.num_tokens - 1] == token_kind::list)
+					{ list_patterns[num_list_patterns++] = static_cast<std::uint8_t>(i); }
+				for (std::size_t j = 0; j < i; j++)
+				{
+					if (patterns[j].num_tokens == pattern.num_tokens && patterns[j].tokens[pattern.key_pos] == pattern.tokens[pattern.key_pos])
+						{ throw "message patterns with the same number of tokens have the same first literal token"; }
+				}
+			}
+			// the first seed that puts every pattern in its own slot
+			for (;; seed++)
+			{
+				if (seed == 10000)
+					{ throw "no perfect hash of message patterns found"; }
+				table.fill(empty_slot);
+				bool collided = false;
+				for (std::size_t i = 0; i < patterns.size() && !collided; i++)
+				{
+					const std::size_t cur = slot(seed, patterns[i].num_tokens, patterns[i].tokens[patterns[i].key_pos]);
+					collided = (table[cur] != empty_slot);
+					table[cur] = static_cast<std::uint8_t>(i);
+				}
+				if (!collided)
+					{ break; }
+			}
+		}
+
+		[[nodiscard]] constexpr const pattern_t& get(std::size_t ind) const noexcept
+			{ return patterns[ind]; }
+
+		// @param tokens  of a message, which ends at the last one
+		// @return index of the only pattern the message can be (its other tokens still have to be checked), or nullopt if there is none
+		[[nodiscard]] constexpr std::optional<std::size_t> find(std::span<const std::string_view> tokens) const noexcept
+		{
+			if (tokens.size() > max_tokens || key_pos_of[tokens.size()] == max_tokens)
+				{ return std::nullopt; }
+			const std::string_view key = tokens[key_pos_of[tokens.size()]];
+			const std::uint8_t ind = table[slot(seed, tokens.size(), key)];
+			// the slot only hashes part of the key, so another key can share it (e.g. a list that makes a message as long as a pattern)
+			if (ind == empty_slot || patterns[ind].num_tokens != tokens.size() || patterns[ind].tokens[patterns[ind].key_pos] != key)
+				{ return std::nullopt; }
+			return ind;
+		}
+
+		// for messages that find can't be, which only ones ending with a list can (e.g. they have more than max_tokens tokens)
+		// @param tokens  at the start of a message, which has at least one more token before its list
+		// @return index of the pattern ending with {list} the message can be (its tokens still have to be checked), or nullopt if there is none
+		[[nodiscard]] constexpr std::optional<std::size_t> find_list(std::span<const std::string_view> tokens) const noexcept
+		{
+			for (std::size_t i = 0; i < num_list_patterns; i++)
+			{
+				const pattern_t& pattern = patterns[list_patterns[i]];
+				if (tokens.size() + 1 >= pattern.num_tokens && tokens[pattern.key_pos] == pattern.tokens[pattern.key_pos])
+					{ return list_patterns[i]; }
+			}
+			return std::nullopt;
+		}
+	};
+
+	inline constexpr message_dispatcher message_dispatch;
+	static_assert(message_dispatch.get(message_dispatch.find(std::array<std::string_view, 4>{ "x", "left", "the", "game" }).value()).type == line_event_type::left);
+	static_assert(!message_dispatch.find(std::array<std::string_view, 3>{ "x", "left", "the" }));
+	static_assert(message_dispatch.get(message_dispatch.find_list(std::array<std::string_view, 10>{ "There", "are", "0", "of", "a", "max", "of", "20", "players", "online:" })
+		.value()).type == line_event_type::player_list);
+	// as many tokens as a "Can't keep up!" message, whose key has the same slot
+	static_assert(!message_dispatch.find(std::array<std::string_view, 13>{ "There", "are", "3", "of", "a", "max", "of", "20", "players", "online:", "a,", "b,", "c" }));
+	static_assert(message_dispatch.get(message_dispatch.find_list(std::array<std::string_view, 13>{ "There", "are", "3", "of", "a", "max", "of", "20", "players", "online:",
+		"a,", "b,", "c" }).value()).type == line_event_type::player_list);
+
+	// @tparam ind, pos  pattern in message_patterns and token of it, which are constants so the comparison is specialized for them
+	// @param[out] event  what the token is kept in, if it is a placeholder
+	// @return whether `token` matches
+	template<std::size_t ind, std::size_t pos>
+	[[nodiscard]] inline bool match_token(std::string_view token, line_event& event)
+	{
+		using kinds = message_dispatcher::token_kind;
+		constexpr kinds kind = message_dispatch.get(ind).kinds[pos];
+		constexpr std::string_view pattern_token = message_dispatch.get(ind).tokens[pos];
+		if constexpr (kind == kinds::literal)
+			{ return token == pattern_token; }
+		else
+		{
+			// what follows the placeholder
+			if constexpr (!pattern_token.empty())
+			{
+				if (token.size() <= pattern_token.size() || !token.ends_with(pattern_token))
+					{ return false; }
+				token.remove_suffix(pattern_token.size());
+			}
+			if constexpr (kind == kinds::name)
+				{ event.name = token; }
+			else if constexpr (kind == kinds::text || kind == kinds::list)
+				{ event.text = token; }
+			else if constexpr (kind == kinds::uuid)
+			{
+				if (token.size() != 36)
+					{ return false; }
+				if (const auto uuid = detail::parse_uuid(std::span<const char, 36>(token.data(), 36)))
+					{ event.uuid = uuid.value(); }
+				else
+				{
+					event.type = line_event_type::invalid_uuid;
+					event.text = token;
+				}
+			}
+			return true;
+		}
+	}
+
+	// @tparam ind  pattern in message_patterns
+	// @param tokens  of a message, as many as the pattern has
+	// @param event  of the line, with the type none
+	// @return event of the message if it matches the pattern, otherwise `event`
+	template<std::size_t ind>
+	[[nodiscard]] inline line_event match_message(std::span<const std::string_view> tokens, const line_event& event)
+	{
+		line_event res = event;
+		res.type = message_dispatch.get(ind).type;
+		const bool matched = [&]<std::size_t... pos>(std::index_sequence<pos...>)
+			{ return (match_token<ind, pos>(tokens[pos], res) && ...); }(std::make_index_sequence<message_dispatch.get(ind).num_tokens>());
+		return matched ? res : event;
+	}
+
+	// match_message of each pattern, by index
+	inline constexpr auto message_matchers = []<std::size_t... ind>(std::index_sequence<ind...>)
+		{ return std::array{ &match_message<ind>... }; }(std::make_index_sequence<message_patterns.size()>());
+
+	// cheap check for whether parse_line could do anything with `line` other than validating its timestamp
+	// every line it acts on contains one of relevant_words, so false positives are possible but false negatives are not
+	[[nodiscard]] inline bool may_be_relevant(std::string_view line) noexcept
+	{
+		static_assert(std::ranges::all_of(relevant_words, [](std::string_view word) { return std::string_view("UgSCT").find(word[0]) != std::string_view::npos; }),
+			"the first letters of relevant_words are what is searched for");
+		const char* const last = line.data() + line.size();
+		for (const char* it = find_any_of<'U', 'g', 'S', 'C', 'T'>(line.data(), last); it != last; it = find_any_of<'U', 'g', 'S', 'C', 'T'>(it + 1, last))
+		{
+			const std::string_view rest(it, last - it);
+			if (std::ranges::any_of(relevant_words, [rest](std::string_view word) { return rest.starts_with(word); }))
+				{ return true; }
+		}
 		return false;
-	}, log_filename_no_ext);
-	read_ctx.paths.erase(removed_subrange.begin(), removed_subrange.end());
+	}
+
+	// @tparam line_format  layout of the line before the message
+	// @param line  without trailing CR
+	// @return what `line` does (see message_patterns), or empty optional if it isn't a valid line with a timestamp
+	template<log_format_policy line_format>
+	[[nodiscard]] inline std::optional<line_event> get_line_event(std::string_view line)
+	{
+		const auto prefix = line_format::parse_prefix(line);
+		if (!prefix)
+			{ return {}; }
+
+		const line_event event{ line_event_type::none, prefix->secs, {}, {} };
+		line_tokenizer tokenizer(line, prefix->message_pos);
+		std::array<std::string_view, message_dispatcher::max_tokens> tokens;
+		std::size_t num_tokens = 0;
+		bool complete = true;  // all tokens were read, with nothing after the last, not even whitespace
+		while (!tokenizer.eof())
+		{
+			const std::string_view token = tokenizer.next();
+			if (token.empty() || num_tokens == tokens.size())
+			{
+				complete = false;
+				break;
+			}
+			tokens[num_tokens++] = token;
+		}
+		if (complete)
+		{
+			// a message that isn't the pattern can still end with a list
+			if (const auto ind = message_dispatch.find(std::span(tokens.data(), num_tokens)))
+			{
+				if (const line_event res = message_matchers[ind.value()](std::span(tokens.data(), num_tokens), event); res.type != line_event_type::none)
+					{ return res; }
+			}
+		}
+
+		const auto ind = message_dispatch.find_list(std::span(tokens.data(), num_tokens));
+		if (!ind)
+			{ return event; }
+		// the list is the rest of the message after the token before it
+		const std::size_t list_pos = message_dispatch.get(ind.value()).num_tokens - 1;
+		const std::string_view before = tokens[list_pos - 1];
+		std::string_view list = line.substr(static_cast<std::size_t>(before.data() + before.size() - line.data()));
+		list.remove_prefix(std::min(list.find_first_not_of(" \t"), list.size()));
+		list.remove_suffix(list.size() - (list.find_last_not_of(" \t") + 1));
+		tokens[list_pos] = list;
+		return message_matchers[ind.value()](std::span(tokens.data(), list_pos + 1), event);
+	}
+}
+
+namespace detail
+{
+	// apply what a line does to the parse context (see get_line_event). ctx.line and ctx.cur_filename are used for warnings
+	// @param clear_before  see parse_line
+	// @param consumer  receives what changed (see log_event)
+	// @return see parse_line
+	inline line_parse_results apply_line_event(const line_event& event, parse_ctx_t& ctx, bool clear_before, auto&& consumer)
+	{
+		const auto cur_time = line_time(ctx, event.secs);
+		bool players_changed = false;
+		if (clear_before)
+			{ players_changed = clear_all_players<true>(ctx, cur_time, consumer); }
+
+		const auto stop_server = [&]()
+		{
+			bool players_changed2 = clear_all_players(ctx, cur_time, consumer);
+			ctx.server_stopped = true;
+			consumer(log_event{ log_event_type::server_stop, cur_time, {}, {}, {} });
+			return line_parse_results{ true, players_changed || players_changed2 };
+		};
+		if (event.type == line_event_type::stopping_server)
+			{ return stop_server(); }
+		if (ctx.server_stopped)
+		{
+			if (event.type == line_event_type::starting_server)
+			{
+				ctx.server_stopped = false;
+				consumer(log_event{ log_event_type::server_start, cur_time, {}, {}, {} });
+			}
+			return { true, players_changed };
+		}
+
+		const std::string_view player_name = event.name;
+		switch (event.type)
+		{
+		case line_event_type::stopping_the_server:
+			return stop_server();
+		case line_event_type::starting_server:
+			// started again without having stopped, so it crashed (see uptime_collector)
+			consumer(log_event{ log_event_type::server_start, cur_time, {}, {}, {} });
+			return { true, players_changed };
+		case line_event_type::uuid:
+		{
+			const std::uint32_t id = ctx.player_info.intern(player_name);
+			ctx.player_info.set_uuid(id, event.uuid);
+			consumer(log_event{ log_event_type::uuid_bind, cur_time, ctx.player_info.name(id), event.uuid, {} });
+			return { true, players_changed };
+		}
+		case line_event_type::invalid_uuid:
+			log_message(log_severity::error, std::format("UUID parsing failed for {}(player {}) in file {}, line {}", event.text, player_name, ctx.cur_filename, ctx.line), log_type::uuid_parse_failed);
+			return { true, players_changed };
+		case line_event_type::joined:
+		{
+			const std::uint32_t id = ctx.player_info.intern(player_name);
+			bind_known_uuid(ctx, id);
+			const auto& [uuid, join_time] = ctx.player_info.infos()[id];
+			if (!uuid)
+			{
+				log_message(log_severity::warning, std::format("UUID not found for player {} in file {}, line {} (expected UUID message before join message)",
+					player_name, ctx.cur_filename, ctx.line), log_type::uuid_not_found);
+			}
+			if (join_time)
+			{
+				log_message(log_severity::warning, std::format("Player {} appears to have joined multiple times without leaving in file {}, line {} (ignore if server crashed while players were online)",
+					player_name, ctx.cur_filename, ctx.line), log_type::joined_multiple_times);
+			}
+			ctx.player_info.set_join_time(id, cur_time);
+			consumer(log_event{ log_event_type::join, cur_time, ctx.player_info.name(id), uuid, {} });
+			return { true, true };
+		}
+		case line_event_type::lag:
+		{
+			std::uint32_t ms;
+			const auto [end, ec] = std::from_chars(event.text.data(), event.text.data() + event.text.size(), ms);
+			if (ec == std::errc() && end == event.text.data() + event.text.size())
+				{ consumer(log_event{ log_event_type::lag, cur_time, {}, {}, {}, std::chrono::milliseconds(ms) }); }
+			return { true, players_changed };
+		}
+		case line_event_type::player_list:
+		{
+			const bool changed = reconcile_online_players(ctx, split_player_list(event.text), cur_time,
+				std::format("in the player list in file {}, line {}", ctx.cur_filename, ctx.line), consumer);
+			return { true, players_changed || changed };
+		}
+		case line_event_type::left:
+		{
+			const std::uint32_t id = ctx.player_info.intern(player_name);
+			bind_known_uuid(ctx, id);
+			const auto& [uuid, join_time] = ctx.player_info.infos()[id];
+			if (!uuid)
+			{
+				log_message(log_severity::error, std::format("UUID not found for player {} in file {}, line {}", player_name, ctx.cur_filename, ctx.line), log_type::uuid_not_found);
+				return { true, players_changed };
+			}
+			if (!join_time)
+			{
+				log_message(log_severity::error, std::format("Join time not found for player {} in file {}, line {}", player_name, ctx.cur_filename, ctx.line), log_type::join_time_not_found);
+				return { true, players_changed };
+			}
+
+			consumer(log_event{ log_event_type::leave, cur_time, ctx.player_info.name(id), uuid, join_time.value() });
+			ctx.player_info.set_join_time(id, std::nullopt);
+			return { true, true };
+		}
+		default:
+			return { true, players_changed };
+		}
+	}
+
+	inline line_parse_results apply_line_event(const line_event& event, parse_ctx_t& ctx, log_data_t& data, bool clear_before)
+		{ return apply_line_event(event, ctx, clear_before, session_aggregator(data)); }
+}
+
+// @tparam strip_ending_cr  whether to remove all trailing CR (\r) characters
+// @tparam line_format  layout of log lines (see log_format_policy)
+// @param line  string containing line data
+// @param ctx  parse context from previous parsing
+// @param data  data output where new data will be added to
+// @param clear_before  whether to clear all players on first timestamp before parsing contents (used when parsing a new file)
+// @return whether a valid line with a timestamp was found. line may or may not have been parsed
+template<bool strip_ending_cr = true, log_format_policy line_format = vanilla_log_format>
+inline line_parse_results parse_line(std::string_view line, parse_ctx_t& ctx, log_data_t& data, bool clear_before = false)
+{
+	// the first timestamp still needs to be found if players will be cleared
+	if (!clear_before && !detail::may_be_relevant(line))
+		{ return { false, false }; }
+	if constexpr (strip_ending_cr)
+	{
+		while (line.ends_with('\r'))
+			{ line.remove_suffix(1); }
+	}
+
+	const auto event = detail::get_line_event<line_format>(line);
+	if (!event)
+		{ return { false, false }; }
+	return detail::apply_line_event(event.value(), ctx, data, clear_before);
+}
+
+namespace detail
+{
+	// events of the lines of one log file. they only depend on the file, so files can be scanned in parallel and applied in order (see parse_log_files)
+	struct file_scan_t
+	{
+		libdeflate_result res = LIBDEFLATE_SUCCESS;  // of decompressing, if the file is compressed (see log_decompressor). nothing else is set if it failed
+		std::string error;  // what was thrown while reading or scanning the file on a scan_pipeline worker, res isn't LIBDEFLATE_SUCCESS if set
+		bool mapped = true;  // false if the file couldn't be mapped and was read normally
+		std::size_t num_lines = 0;  // line number of the last non-empty line, 0 if there are none
+		std::vector<std::pair<std::size_t, line_event>> events;  // line number and event of each line that may do something, views are into storage
+		std::vector<char> storage;  // vector so views stay valid when it's moved
+		// for file_ingest_stats, only set by scan_log_file
+		std::uintmax_t compressed_bytes = 0, bytes = 0;
+		std::chrono::nanoseconds decompress_time{}, scan_time{};
+	};
+
+	// copy what the events refer to into scan.storage, so whatever they referred to before can be discarded
+	inline void copy_to_storage(file_scan_t& scan)
+	{
+		std::size_t storage_size = 0;
+		for (const auto& [line, event] : scan.events)
+			{ storage_size += event.name.size() + event.text.size(); }
+		scan.storage.resize(storage_size);
+		char* it = scan.storage.data();
+		const auto move_to_storage = [&it](std::string_view& str)
+		{
+			char* const begin = it;
+			it = std::ranges::copy(str, it).out;
+			str = std::string_view(begin, it);
+		};
+		for (auto& [line, event] : scan.events)
+		{
+			move_to_storage(event.name);
+			move_to_storage(event.text);
+		}
+	}
+
+	// find the events of the lines in `data`, copying what they refer to so `data` can be discarded afterwards
+	// lines are skipped the same way as in parse_line. the first valid line is kept even if it does nothing,
+	// since players are cleared at it if the file starts a new run of the server (see clear_before)
+	// @return number of lines in `data`, including empty ones
+	template<log_format_policy line_format>
+	inline std::size_t scan_lines(std::string_view data, file_scan_t& out)
+	{
+		out.events.clear();
+		out.num_lines = 0;
+		bool found_valid = false;
+		std::size_t line_num = 0;
+		for (std::string_view line : line_range(data))
+		{
+			line_num++;
+			if (line.empty())
+				{ continue; }
+			out.num_lines = line_num;
+			if (found_valid && !may_be_relevant(line))
+				{ continue; }
+			while (line.ends_with('\r'))
+				{ line.remove_suffix(1); }
+			const auto event = get_line_event<line_format>(line);
+			if (!event || (found_valid && event->type == line_event_type::none))
+				{ continue; }
+			found_valid = true;
+			out.events.emplace_back(line_num, event.value());
+		}
+		copy_to_storage(out);
+		return line_num;
+	}
+
+	inline constexpr std::size_t parallel_scan_min_chunk = 1 << 20;  // smallest part of a buffer scanned on its own thread
+
+	// scan_lines, with large buffers split into chunks at line boundaries that are scanned on separate threads
+	// chunks are scanned independently since events only depend on their own line, then joined in order
+	// (only the first valid line of the whole buffer is kept if it does nothing), so the result is the same
+	template<log_format_policy line_format>
+	inline void scan_lines_parallel(std::string_view data, file_scan_t& out)
+	{
+		const std::size_t num_chunks = std::min<std::size_t>(parse_thread_count(), data.size() / parallel_scan_min_chunk);
+		if (num_chunks <= 1)
+		{
+			scan_lines<line_format>(data, out);
+			return;
+		}
+
+		std::vector<std::string_view> chunks;
+		const char* chunk_begin = data.data();
+		const char* const data_end = data.data() + data.size();
+		for (std::size_t i = 1; i <= num_chunks && chunk_begin != data_end; i++)
+		{
+			// each chunk ends after a line ending, the last one at the end of data
+			const char* chunk_end = data_end;
+			if (i != num_chunks)
+			{
+				chunk_end = find_newline(std::max(chunk_begin, data.data() + data.size() / num_chunks * i), data_end);
+				chunk_end = (chunk_end == data_end) ? data_end : chunk_end + 1;
+			}
+			chunks.emplace_back(chunk_begin, chunk_end);
+			chunk_begin = chunk_end;
+		}
+		std::vector<file_scan_t> scans(chunks.size());
+		std::vector<std::size_t> chunk_lines(chunks.size());
+		{
+			std::vector<std::jthread> threads;
+			for (std::size_t i = 1; i < chunks.size(); i++)
+			{
+				threads.emplace_back([&chunks, &scans, &chunk_lines, i]()
+				{
+					enter_parse_thread();
+					chunk_lines[i] = scan_lines<line_format>(chunks[i], scans[i]);
+				});
+			}
+			chunk_lines[0] = scan_lines<line_format>(chunks[0], scans[0]);
+		}
+
+		std::size_t storage_size = 0;
+		for (const file_scan_t& scan : scans)
+			{ storage_size += scan.storage.size(); }
+		out.events.clear();
+		out.storage.resize(storage_size);
+		out.num_lines = 0;
+		std::size_t line_offset = 0, storage_offset = 0;
+		for (std::size_t i = 0; i < scans.size(); i++)
+		{
+			const file_scan_t& scan = scans[i];
+			std::ranges::copy(scan.storage, out.storage.begin() + storage_offset);
+			const auto rebase = [&](std::string_view str)
+				{ return str.empty() ? str : std::string_view(out.storage.data() + storage_offset + (str.data() - scan.storage.data()), str.size()); };
+			for (const auto& [line, event] : scan.events)
+			{
+				if (!out.events.empty() && event.type == line_event_type::none)
+					{ continue; }  // was the first valid line of its chunk
+				line_event cur = event;
+				cur.name = rebase(event.name);
+				cur.text = rebase(event.text);
+				out.events.emplace_back(line_offset + line, cur);
+			}
+			if (scan.num_lines != 0)
+				{ out.num_lines = line_offset + scan.num_lines; }
+			line_offset += chunk_lines[i];
+			storage_offset += scan.storage.size();
+		}
+	}
+
+	// read a log file and find the events of its lines
+	// @param compressed  contents of a compressed file if have_compressed is true, otherwise a buffer for them
+	// @param decompressed, mapping  backing storage for the contents. they, and compressed, can be reused between calls to avoid reallocating
+	template<log_format_policy line_format>
+	inline void scan_log_file(const log_manifest_entry& file, log_decompressor& decompressor, std::string& compressed, bool have_compressed,
+		std::string& decompressed, mapped_file& mapping, file_scan_t& out)
+	{
+		QC_TRACE_SCOPE("scan_log_file", file.path.filename().string());
+		out.res = LIBDEFLATE_SUCCESS;
+		out.mapped = true;
+		out.compressed_bytes = out.bytes = 0;
+		out.decompress_time = out.scan_time = {};
+		const auto start = std::chrono::steady_clock::now();
+		const auto fail = [&out](libdeflate_result res)
+		{
+			out.res = res;
+			out.events.clear();
+			out.num_lines = 0;
+		};
+		std::shared_ptr<const std::string_view> bundle_data;  // kept while the file is scanned, if it is in a bundle
+		std::string_view data;
+		if (file.bundle)
+		{
+			bundle_data = file.bundle->load(decompressor.get_deflate());
+			const auto member = bundle_data ? read_bundle_member(*bundle_data, file.bundle_location, decompressor.get_deflate(), compressed) : std::nullopt;
+			if (!member)
+				{ return fail(LIBDEFLATE_BAD_DATA); }
+			data = member.value();
+			out.compressed_bytes = data.size();
+			if (file.codec != log_codec::none)
+			{
+				if (const auto res = decompressor.decompress(file.codec, data, decompressed); res != LIBDEFLATE_SUCCESS)
+					{ return fail(res); }
+				data = decompressed;
+			}
+		}
+		else if (file.codec != log_codec::none)
+		{
+			if (const auto res = have_compressed ? decompressor.decompress(file.codec, compressed, decompressed) : read_compressed_file(decompressor, file, compressed, decompressed);
+				res != LIBDEFLATE_SUCCESS)
+				{ return fail(res); }
+			data = decompressed;
+			out.compressed_bytes = compressed.size();
+		}
+		// logs are only read again if history is parsed again, so they aren't kept in the page cache (see mapped_file::open)
+		else if (mapping.open(file.path, true))
+			{ data = mapping.data(); }
+		else
+		{
+			out.mapped = false;
+			read_file_once(file.path, file.size, decompressed);
+			data = decompressed;
+		}
+		if (out.compressed_bytes == 0)
+			{ out.compressed_bytes = data.size(); }
+		out.bytes = data.size();
+		// reading a file that isn't compressed is part of scanning it, since it's mapped
+		const auto scan_start = std::chrono::steady_clock::now();
+		if (file.codec != log_codec::none)
+			{ out.decompress_time = scan_start - start; }
+		scan_lines_parallel<line_format>(data, out);
+		out.scan_time = std::chrono::steady_clock::now() - (file.codec != log_codec::none ? scan_start : start);
+		mapping.close();
+	}
+
+	// scan cache that doesn't cache anything (see parse_log_file_events for what a scan cache does, and event_journal for one that does)
+	struct no_scan_cache
+	{
+		[[nodiscard]] static bool contains(const log_manifest_entry&) noexcept
+			{ return false; }
+		[[nodiscard]] static bool find(const log_manifest_entry&, file_scan_t&) noexcept
+			{ return false; }
+		static void add(const log_manifest_entry&, const file_scan_t&) noexcept
+			{}
+	};
+
+	// reads, decompresses and scans the files in `manifest` on worker threads ahead of the (single-threaded) consumer
+	// each worker has its own decompressor since they can't be shared between threads
+	// results must be taken in the same order as `manifest`, and the consumer applies them in that order, so parsing is unaffected
+	template<log_format_policy line_format>
+	class scan_pipeline
+	{
+	private:
+		struct result_t
+		{
+			file_scan_t scan;
+			bool ready = false;
+#ifdef URING_READER_AVAILABLE
+			std::string compressed;  // read ahead by reader_loop (only for compressed files)
+			bool read_done = false;  // set once reader_loop has tried to read compressed
+			bool read_ok = false;  // if false, the worker reads the file itself
+#endif
+		};
+
+		const std::vector<log_manifest_entry>& manifest;
+		std::vector<result_t> results;  // for each file in manifest
+		std::size_t window;  // max number of files scanned ahead of next_take
+		std::size_t next_job = 0, next_take = 0;  // indices into manifest
+		bool stopping = false;
+		std::mutex mutex;
+		std::condition_variable job_cv, result_cv;
+		std::vector<std::jthread> workers;
+#ifdef URING_READER_AVAILABLE
+		// if set, compressed files are read ahead in batches on reader instead of by each worker
+		std::unique_ptr<uring_file_reader> uring;
+		std::jthread reader;
+
+		void reader_loop()
+		{
+			enter_parse_thread();
+			std::vector<std::string> buffers;
+			std::vector<uring_file_reader::request_t> requests;
+			std::vector<std::size_t> request_inds;  // index into manifest of each request
+			std::size_t next_read = 0;  // index into manifest
+			// compressed files are small, so they can be read further ahead than they are scanned
+			// waiting for room for a whole batch keeps the batches full
+			const std::size_t read_window = window + uring_file_reader::max_batch;
+			while (true)
+			{
+				std::size_t end;
+				{
+					std::unique_lock lock(mutex);
+					job_cv.wait(lock, [this, next_read, read_window]()
+					{
+						return stopping || next_read == manifest.size() ||
+							next_read + std::min(uring_file_reader::max_batch, manifest.size() - next_read) <= next_take + read_window;
+					});
+					if (stopping || next_read == manifest.size())
+						{ return; }
+					end = std::min(manifest.size(), next_take + read_window);
+				}
+				// plain files are mapped by the workers instead, and files in bundles are read from the bundle
+				request_inds.clear();
+				for (std::size_t i = next_read; i < end; i++)
+				{
+					if (manifest[i].codec != log_codec::none && !manifest[i].bundle)
+						{ request_inds.push_back(i); }
+				}
+				buffers.resize(request_inds.size());
+				requests.clear();
+				for (std::size_t i = 0; i < request_inds.size(); i++)
+				{
+					const auto& file = manifest[request_inds[i]];
+					requests.push_back({ .path = &file.path, .size = file.size, .out = &buffers[i] });
+				}
+				if (!requests.empty())
+					{ uring->read_files(requests); }
+				{
+					std::scoped_lock lock(mutex);
+					for (std::size_t i = next_read; i < end; i++)
+						{ results[i].read_done = true; }
+					for (std::size_t i = 0; i < request_inds.size(); i++)
+					{
+						results[request_inds[i]].compressed = std::move(buffers[i]);
+						results[request_inds[i]].read_ok = requests[i].ok;
+					}
+				}
+				job_cv.notify_all();
+				next_read = end;
+			}
+		}
+#endif
+
+		void worker_loop()
+		{
+			enter_parse_thread();
+			log_decompressor decompressor;
+			std::string compressed, decompressed;
+			mapped_file mapping;
+			while (true)
+			{
+				std::size_t job;
+				bool read_ok = false;  // compressed was already read
+				{
+					std::unique_lock lock(mutex);
+					job_cv.wait(lock, [this]() { return stopping || next_job == manifest.size() || next_job < next_take + window; });
+					if (stopping || next_job == manifest.size())
+						{ return; }
+					job = next_job;
+					next_job++;
+#ifdef URING_READER_AVAILABLE
+					if (uring)
+					{
+						job_cv.wait(lock, [this, job]() { return stopping || results[job].read_done; });
+						if (stopping)
+							{ return; }
+						read_ok = results[job].read_ok;
+						if (read_ok)
+							{ compressed = std::move(results[job].compressed); }
+					}
+#endif
+				}
+				file_scan_t scan;
+				// an exception would terminate the process on this thread, so it only fails this file
+				try
+					{ scan_log_file<line_format>(manifest[job], decompressor, compressed, read_ok, decompressed, mapping, scan); }
+				catch (const std::exception& e)
+				{
+					mapping.close();
+					scan = {};
+					scan.res = LIBDEFLATE_BAD_DATA;
+					scan.error = e.what();
+				}
+				{
+					std::scoped_lock lock(mutex);
+					results[job].scan = std::move(scan);
+					results[job].ready = true;
+				}
+				result_cv.notify_all();
+			}
+		}
+
+	public:
+		// @param manifest  log files to read, must outlive this object
+		// @param num_workers  number of scanning threads
+		scan_pipeline(const std::vector<log_manifest_entry>& manifest, std::size_t num_workers) : manifest(manifest), window(num_workers * 2)
+		{
+			results.resize(manifest.size());
+#ifdef URING_READER_AVAILABLE
+			if (std::ranges::any_of(manifest, [](const log_manifest_entry& entry) { return entry.codec != log_codec::none; }))
+			{
+				uring = std::make_unique<uring_file_reader>();
+				if (uring->valid())
+					{ reader = std::jthread([this]() { reader_loop(); }); }
+				else
+					{ uring.reset(); }
+			}
+#endif
+			for (std::size_t i = 0; i < num_workers; i++)
+				{ workers.emplace_back([this]() { worker_loop(); }); }
+		}
+		scan_pipeline(const scan_pipeline&) = delete;
+		scan_pipeline& operator=(const scan_pipeline&) = delete;
+		~scan_pipeline()
+		{
+			{
+				std::scoped_lock lock(mutex);
+				stopping = true;
+			}
+			job_cv.notify_all();
+			// jthreads are joined on destruction
+		}
+
+		// wait for the scan of manifest[ind], which must be the file after the one taken last
+		// @param out  receives the scan
+		void take(std::size_t ind, file_scan_t& out)
+		{
+			{
+				std::unique_lock lock(mutex);
+				result_cv.wait(lock, [this, ind]() { return results[ind].ready; });
+				out = std::move(results[ind].scan);
+				results[ind] = {};
+				next_take = ind + 1;
+			}
+			job_cv.notify_all();
+		}
+	};
+}
+
+// parse lines, passing what changes to `consumer`, so any statistic can be gathered from them in the same pass
+// (see session_aggregator for sessions, and combine_consumers for gathering several)
+// a lot of lines at once (e.g. reading a large latest.log on startup) are scanned in parallel, and only the events are applied here
+// @tparam line_format  layout of log lines (see log_format_policy)
+// @param consumer  called with each log_event, in order
+// @return whether players have joined/left
+template<log_format_policy line_format = vanilla_log_format>
+inline bool parse_events(std::string_view lines, parse_ctx_t& ctx, auto&& consumer)
+{
+	QC_TRACE_SCOPE("parse_events", std::format("{} bytes", lines.size()));
+	bool players_changed = false;
+	if (lines.size() >= 2 * detail::parallel_scan_min_chunk && detail::parse_thread_count() > 1)
+	{
+		detail::file_scan_t scan;
+		detail::scan_lines_parallel<line_format>(lines, scan);
+		for (const auto& [line, event] : scan.events)
+		{
+			if (detail::apply_line_event(event, ctx, false, consumer).player_join_left)
+				{ players_changed = true; }
+		}
+		return players_changed;
+	}
+
+	for (std::string_view line : detail::line_range(lines))
+	{
+		// same as parse_line
+		if (!detail::may_be_relevant(line))
+			{ continue; }
+		while (line.ends_with('\r'))
+			{ line.remove_suffix(1); }
+		if (const auto event = detail::get_line_event<line_format>(line); event && detail::apply_line_event(event.value(), ctx, false, consumer).player_join_left)
+			{ players_changed = true; }
+	}
+	return players_changed;
+}
+
+// @param merge_gap  see session_aggregator
+// @return whether players have join/left
+template<log_format_policy line_format = vanilla_log_format>
+inline bool parse_lines(std::string_view lines, parse_ctx_t& ctx, log_data_t& data, std::chrono::system_clock::duration merge_gap = {})
+	{ return parse_events<line_format>(lines, ctx, session_aggregator(data, merge_gap)); }
+
+// parse log files in order, continuing from a previous parse context, passing what changes to `consumer` (see parse_events)
+// files are read and scanned for the lines that matter in parallel (see detail::scan_pipeline), then what those lines do is applied in order,
+// so the result is the same as parsing them one after another
+// @tparam line_format  layout of log lines (see log_format_policy)
+// @param manifest  files to parse, sorted and without duplicates (see scan_logs_dir)
+// @param read_file_cb  callback after a file has been completely read and parsed. should accept const log_manifest_entry& as singlular parameter,
+//                     whose ingest has what parsing it cost
+// @param ctx  parse context after parsing the files before `manifest`, or empty context to start from scratch
+// @param consumer  called with each log_event, in order
+// @param scan_cache  scans of files that don't need to be read again (see detail::no_scan_cache for its functions). files it contains aren't read,
+//                    and the scans of files that were read successfully are added to it
+// @return parse context after the files. players still online are left online
+template<bool skip_latest_log = false, log_format_policy line_format = vanilla_log_format>
+inline parse_ctx_t parse_log_file_events(std::vector<log_manifest_entry> manifest, const std::chrono::time_zone* target_tz, auto&& read_file_cb,
+	parse_ctx_t ctx, auto&& consumer, auto&& scan_cache)
+{
 	// TODO: verify no gaps, e.g. 2000-01-01-2, 2000-01-01-4 (missing 2000-01-01-1, 2000-01-01,3)
-	
+	QC_TRACE_SCOPE("parse_log_file_events", std::format("{} files", manifest.size()));
+
+	std::vector<bool> cached(manifest.size());
+	std::vector<log_manifest_entry> to_scan;
+	for (std::size_t i = 0; i < manifest.size(); i++)
+	{
+		cached[i] = scan_cache.contains(manifest[i]);
+		if (!cached[i])
+			{ to_scan.push_back(manifest[i]); }
+	}
+
+	// a single file is scanned on this thread, as are files the cache failed to give
+	std::unique_ptr<detail::scan_pipeline<line_format>> pipeline;
+	detail::log_decompressor decompressor;
+	if (to_scan.size() > 1)
+	{
+		const std::size_t num_workers = std::min<std::size_t>(detail::parse_thread_count(), to_scan.size());
+		pipeline = std::make_unique<detail::scan_pipeline<line_format>>(to_scan, num_workers);
+	}
+	std::string compressed, decompressed;
+	detail::mapped_file mapping;
+
+	detail::file_scan_t scan;
+	std::size_t next_scan = 0;  // index into to_scan
+	bool clear_before = false;
+	std::chrono::system_clock::time_point last_tp = ctx.date_tp;
+	for (std::size_t i = 0; i < manifest.size(); i++)
+	{
+		auto& file = manifest[i];
+		const auto filename = file.path.filename().string();
+		QC_TRACE_SCOPE("file", filename);
+		file.ingest = {};
+		bool scanned = true;
+		if (cached[i] && scan_cache.find(file, scan))
+			{ scanned = false; }
+		else if (!cached[i] && pipeline)
+		{
+			QC_TRACE_SCOPE("wait for scan");
+			pipeline->take(next_scan++, scan);
+		}
+		else
+			{ detail::scan_log_file<line_format>(file, decompressor, compressed, false, decompressed, mapping, scan); }
+
+		if (scan.res != LIBDEFLATE_SUCCESS)
+		{
+			if (!scan.error.empty())
+				{ log_message(log_severity::error, std::format("Could not read {}: {}", filename, scan.error)); }
+			else if (scan.res == LIBDEFLATE_BAD_DATA)
+				{ log_message(log_severity::error, "Bad data error while decompressing " + filename); }
+			else
+				{ log_message(log_severity::error, "Error while decompressing " + filename); }
+		}
+		else
+		{
+			if (!scan.mapped)
+				{ log_message(log_severity::warning, std::format("Could not map file {}, reading normally", filename)); }
+			if (scanned)
+			{
+				scan_cache.add(file, scan);
+				file.ingest.compressed_bytes = scan.compressed_bytes;
+				file.ingest.bytes = scan.bytes;
+				file.ingest.decompress_time = scan.decompress_time;
+				file.ingest.scan_time = scan.scan_time;
+			}
+			file.ingest.cached = !scanned;
+			file.ingest.lines = scan.num_lines;
+			file.ingest.events = scan.events.size();
+			// files without lines are skipped as if they weren't there
+			if (scan.num_lines != 0)
+			{
+				ctx.cur_filename = filename;
+				// a player's uuid is logged in the same file they join in, so those of players who left aren't needed anymore
+				ctx.player_info.remove_offline();
+				ctx.date_tp = (!skip_latest_log && file.is_latest) ? file_modification_date(file.mtime, target_tz) : std::chrono::sys_days(file.date);
+				// the server has only necessarily restarted if the date is the same (e.g. 2000-01-01-1 and 2000-01-01-2),
+				// otherwise the logs may have just been a continuation of the previous day
+				if (ctx.date_tp == last_tp)
+					{ clear_before = true; }
+				last_tp = ctx.date_tp;
+
+				QC_TRACE_SCOPE("apply events");
+				const auto apply_start = std::chrono::steady_clock::now();
+				const std::uint64_t warnings_before = logger::thread_warnings();
+				for (const auto& [line, event] : scan.events)
+				{
+					ctx.line = line;
+					if (detail::apply_line_event(event, ctx, clear_before, consumer).read_valid_line)
+						{ clear_before = false; }
+				}
+				ctx.line = scan.num_lines;
+				file.ingest.apply_time = std::chrono::steady_clock::now() - apply_start;
+				file.ingest.warnings = logger::thread_warnings() - warnings_before;
+			}
+		}
+		read_file_cb(file);
+		// the next file isn't in the same bundle, so it isn't needed until its files are parsed again (if they ever are)
+		if (file.bundle && (i + 1 == manifest.size() || manifest[i + 1].bundle != file.bundle))
+			{ file.bundle->release(); }
+	}
+	return ctx;
+}
+template<bool skip_latest_log = false, log_format_policy line_format = vanilla_log_format>
+inline parse_ctx_t parse_log_file_events(std::vector<log_manifest_entry> manifest, const std::chrono::time_zone* target_tz, auto&& read_file_cb,
+	parse_ctx_t ctx, auto&& consumer)
+	{ return parse_log_file_events<skip_latest_log, line_format>(std::move(manifest), target_tz, read_file_cb, std::move(ctx), consumer, detail::no_scan_cache()); }
+
+// parse log files in order, continuing from a previous parse context
+// @tparam save_ctx  whether to save parse context. if false, players still online when the log was last written will "leave" at current system time
+// @tparam line_format  layout of log lines (see log_format_policy)
+// @param manifest  files to parse, sorted and without duplicates (see scan_logs_dir)
+// @param read_file_cb  callback after a file has been completely read and parsed. should accept const log_manifest_entry& as singlular parameter
+// @param ctx  parse context after parsing the files before `manifest`, or empty context to start from scratch
+// @return pair of log data and parse context if save_ctx is true; log data otherwise. log data only includes what was added by `manifest`
+template<bool skip_latest_log = false, bool save_ctx = false, log_format_policy line_format = vanilla_log_format>
+[[nodiscard]] inline std::conditional_t<save_ctx, std::pair<log_data_t, parse_ctx_t>, log_data_t>
+	parse_log_files(std::vector<log_manifest_entry> manifest, const std::chrono::time_zone* target_tz, auto&& read_file_cb, parse_ctx_t ctx = {})
+{
 	log_data_t info;
-	
-	parse_ctx_t ctx;
-	
-	const auto get_cur_file = [&read_ctx]() -> const auto& { return read_ctx.paths[read_ctx.path_ind - 1]; };
-	const auto get_prev_file = [&read_ctx]() -> const auto& { return read_ctx.paths[read_ctx.path_ind - 2]; };
-	const auto get_cur_filename = [&get_cur_file]() { return get_cur_file().first.filename().string(); };
-
-	bool server_stopped = false, clear_before = false;
-	std::chrono::system_clock::time_point last_tp;
-	while (true)
-	{
-		const auto [s, file_is_new] = detail::get_next_line<skip_latest_log>(read_ctx, target_tz);
-		if (s.empty())
-		{
-			if (read_ctx.paths.size() > 0)
-				{ read_file_cb(get_cur_file()); }
-			break;
-		}
-		
-		if (file_is_new)
-		{
-			ctx.cur_filename = get_cur_filename();
-			ctx.date_tp = read_ctx.date_tp;
-			// the server has only necessarily restarted if the date is the same (e.g. 2000-01-01-1 and 2000-01-01-2),
-			// otherwise the logs may have just been a continuation of the previous day
-			if (ctx.date_tp == last_tp)
-				{ clear_before = true; }
-			last_tp = ctx.date_tp;
-		}
-		ctx.line = read_ctx.line;
-
-		if (parse_line(std::move(s), ctx, info, clear_before).read_valid_line)
-			{ clear_before = false; }
-		
-		if (file_is_new && read_ctx.path_ind > 1)
-			{ read_file_cb(get_prev_file()); }
-	}
-	
+	ctx = parse_log_file_events<skip_latest_log, line_format>(std::move(manifest), target_tz, read_file_cb, std::move(ctx), session_aggregator(info));
 	if constexpr (save_ctx)
-		{ return { info, ctx }; }
+		{ return { std::move(info), std::move(ctx) }; }
 	else
 	{
 		// add players that are still online
@@ -659,8 +2252,16 @@ template<bool skip_latest_log = false, bool save_ctx = false>
 		return info;
 	}
 }
-template<bool skip_latest_log = false, bool save_ctx = false>
+// @tparam save_ctx  whether to save parse context. if false, players still online when the log was last written will "leave" at current system time
+// @tparam line_format  layout of log lines (see log_format_policy)
+// @param read_file_cb  callback after a file has been completely read and parsed. should accept const log_manifest_entry& as singlular parameter
+// @return pair of log data and parse context if save_ctx is true; log data otherwise
+template<bool skip_latest_log = false, bool save_ctx = false, log_format_policy line_format = vanilla_log_format>
+[[nodiscard]] inline std::conditional_t<save_ctx, std::pair<log_data_t, parse_ctx_t>, log_data_t>
+	parse_logs(const std::filesystem::path& logs_dir, const std::chrono::time_zone* target_tz, auto&& read_file_cb)
+	{ return parse_log_files<skip_latest_log, save_ctx, line_format>(scan_logs_dir<skip_latest_log>(logs_dir), target_tz, read_file_cb); }
+template<bool skip_latest_log = false, bool save_ctx = false, log_format_policy line_format = vanilla_log_format>
 [[nodiscard]] inline decltype(auto) parse_logs(const std::filesystem::path& logs_dir, const std::chrono::time_zone* target_tz)
-	{ return parse_logs<skip_latest_log, save_ctx>(logs_dir, target_tz, [](auto&&) {}); }
+	{ return parse_logs<skip_latest_log, save_ctx, line_format>(logs_dir, target_tz, [](auto&&) {}); }
 
 #endif
@@ -0,0 +1,215 @@
+#ifndef PLAYER_GRAPH_H
+#define PLAYER_GRAPH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "graph_writer.h"
+#include "parse_logs.h"
+#include "playtime_graph.h"
+#include "session_store.h"
+#include "text_metrics.h"
+
+/*
+SVG layout:
+ ____________________________________________________
+|              |                           |  total  |
+|              |                           |  play   |
+|    dates     |   sessions on each day    |  time   |
+|              |                           |  each   |
+|              |                           |  day    |
+|______________|___________________________|_________|
+|                   hours of the day                 |
+|____________________________________________________|
+|                      caption                       |
+|____________________________________________________|
+*/
+
+inline constexpr std::size_t player_graph_max_days = 62;  // most recent days shown
+
+// @return uuid of the player who has or had `name` (ignoring case), or empty optional if nobody did
+//         newer data is checked first, so a name that changed hands is of the player who had it last
+// recent data only has players who played since the last commit, so it is gone through; history uses the index of each segment
+inline std::optional<uuid_t> find_player(const session_history& history, const log_data_t& recent, std::string_view name, graph_render_ctx& render_ctx)
+{
+	const std::string folded = player_name_index::fold_case(name);
+	std::optional<uuid_t> former;  // had the name before
+	for (const auto& [uuid, data] : recent)
+	{
+		const auto& names = data.first;
+		if (!names.empty() && player_name_index::fold_case(names.back()) == folded)
+			{ return uuid; }
+		if (!former && std::ranges::any_of(names, [&folded](const std::string& cur) { return player_name_index::fold_case(cur) == folded; }))
+			{ former = uuid; }
+	}
+	if (former)
+		{ return former; }
+
+	const auto segments = history.get_segments();
+	for (auto it = segments.rbegin(); it != segments.rend(); it++)
+	{
+		if (const auto ind = render_ctx.get_name_index(*it)->find(**it, name))
+			{ return (*it)->uuid(ind.value()); }
+	}
+	return {};
+}
+
+namespace detail
+{
+	// sessions of a player on one day
+	struct player_day
+	{
+		std::chrono::local_days day;
+		std::chrono::system_clock::duration total{};
+		std::vector<std::pair<double, double>> bars;  // start and length of each session as fractions of the day
+	};
+
+	// @return days that row has sessions on, oldest first. sessions spanning midnight are split between the days
+	inline std::vector<player_day> get_player_days(const graph_row& row, const std::chrono::time_zone* target_tz)
+	{
+		std::map<std::chrono::local_days, player_day> days;
+		constexpr std::chrono::duration<double> day_length = std::chrono::days(1);
+		row.for_each_session([&](const play_session& session)
+		{
+			const auto end = session.first + session.second;
+			for (auto cur = session.first; cur < end;)
+			{
+				const auto local = target_tz->to_local(cur);
+				const auto day = std::chrono::floor<std::chrono::days>(local);
+				const std::chrono::system_clock::time_point midnight = target_tz->to_sys(day + std::chrono::days(1), std::chrono::choose::earliest);
+				const auto next = std::min(end, midnight);
+				player_day& cur_day = days[day];
+				cur_day.day = day;
+				cur_day.total += next - cur;
+				cur_day.bars.emplace_back((local - day) / day_length, (next - cur) / day_length);
+				cur = next;
+			}
+		});
+
+		std::vector<player_day> res;
+		res.reserve(days.size());
+		for (auto& [day, cur_day] : days)
+		{
+			std::ranges::sort(cur_day.bars);
+			res.push_back(std::move(cur_day));
+		}
+		return res;
+	}
+
+	// @param days  days shown, oldest first
+	// @param caption  shown below the graph
+	inline void draw_player_graph(auto& writer, std::span<const player_day> days, std::string_view bar_color, std::string_view color, std::string_view caption)
+	{
+		// text sizes are what lunasvg would give as the bounding box of the text
+		auto& metrics = text_metrics::get();
+		const auto date_label = [](const player_day& cur_day) { return std::format("{:%m/%d/%Y}", cur_day.day); };
+		const auto total_label = [](const player_day& cur_day) { return std::format("{:%H:%M:%S}", std::chrono::round<std::chrono::seconds>(cur_day.total)); };
+
+		text_bounds date_bounds, total_bounds;
+		for (const player_day& cur_day : days)
+		{
+			date_bounds.add(-svg_pad, metrics.text_width(date_label(cur_day), svg_fontsize), text_anchor::end);
+			total_bounds.add(0, metrics.text_width(total_label(cur_day), svg_fontsize), text_anchor::end);
+		}
+		const double text_width = std::ceil(date_bounds.get_width() / 2.5) * 2.5;  // round up to multiple of 2.5
+		const double data_area_width = svg_width - (text_width + svg_pad);
+		const double bars_width = data_area_width - (total_bounds.get_width() + svg_pad);
+		const double data_height = svg_bar_stride * static_cast<double>(days.size());
+		const double hours_height = svg_pad + svg_date_fontsize;
+
+		writer.begin(svg_width + 2 * svg_side_pad, data_height + 2 * hours_height + 2 * svg_side_pad, -(text_width + svg_pad) - svg_side_pad, -svg_side_pad);
+
+		std::vector<std::pair<double, double>> bars;  // x and width of each bar in the current row, reused
+		for (std::size_t ind = 0; ind < days.size(); ind++)
+		{
+			const player_day& cur_day = days[ind];
+			const double y = svg_bar_stride * static_cast<double>(ind);
+			writer.text(-svg_pad, y + svg_bar_height / 2, svg_fontsize, true, color, text_anchor::end, text_baseline::middle, date_label(cur_day));
+			writer.text(data_area_width, y + svg_bar_height / 2, svg_fontsize, true, color, text_anchor::end, text_baseline::middle, total_label(cur_day));
+
+			// merged like add_data_bars
+			bars.clear();
+			for (const auto& [start, length] : cur_day.bars)
+			{
+				const double x = start * bars_width, width = length * bars_width;
+				if (!bars.empty() && x - (bars.back().first + bars.back().second) < svg_min_bar_gap)
+					{ bars.back().second = std::max(bars.back().second, x + width - bars.back().first); }
+				else
+					{ bars.emplace_back(x, width); }
+			}
+			writer.bar_row(y, svg_bar_height, bar_color, bars);
+		}
+
+		// hours (x-axis)
+		writer.line(0, data_height, bars_width, data_height, color, 2);
+		for (int hour = 0; hour < 24; hour += 3)
+		{
+			writer.text(bars_width * hour / 24, data_height + svg_pad, svg_date_fontsize, false, color, text_anchor::middle, text_baseline::hanging,
+				std::format("{:02}:00", hour));
+		}
+
+		writer.text(bars_width / 2, data_height + hours_height + svg_pad, svg_date_fontsize, false, color, text_anchor::middle, text_baseline::hanging, caption);
+	}
+}
+
+// graph of one player's sessions on each day they played, with the total playtime of each day, in the graph time zone
+// only that player's sessions in options.range are gone through (see session_store::overlapping_sessions), so it doesn't depend on the size of history
+// at most player_graph_max_days days are shown (the most recent ones). options.row_limit is unused
+// the data is read in place, so it must not be modified while the graph is created
+// @param uuid  of the player (see find_player)
+// @tparam return_svg  whether to return svg data
+// @tparam render_to_png  whether to return rendered png data
+// @throws std::runtime_error if png rendering fails
+// @return pair of svg and png data if return_svg and render_to_png are both true, otherwise return single string containing data
+template<bool return_svg = true, bool render_to_png = false>
+inline auto create_player_graph(const session_history& history, const log_data_t& recent, const parse_ctx_t& parse_ctx, uuid_t uuid, const graph_options& options = {})
+{
+	static_assert(return_svg || render_to_png, "Graph must be either saved to svg or png");
+
+	std::optional<graph_render_ctx> temp_render_ctx;
+	graph_render_ctx& render_ctx = options.render_ctx ? *options.render_ctx : temp_render_ctx.emplace();
+	detail::graph_row row{ uuid, options.range };
+	for (const auto& segment : history.get_segments())
+	{
+		if (const auto ind = segment->find(uuid))
+			{ row.add(*segment, ind.value()); }
+	}
+	if (const auto it = recent.find(uuid); it != recent.end())
+		{ row.add(it->second); }
+	for (const std::uint32_t id : parse_ctx.player_info.online())
+	{
+		const auto& [cur_uuid, join_time] = parse_ctx.player_info.infos()[id];
+		if (cur_uuid == uuid)
+		{
+			row.name = parse_ctx.player_info.name(id);
+			const play_session session(join_time.value(), std::chrono::system_clock::now() - join_time.value());
+			if (row.range.overlaps(session))
+				{ row.online_session = row.range.clip(session); }
+		}
+	}
+
+	std::vector<detail::player_day> days = detail::get_player_days(row, render_ctx.get_timezone());
+	std::chrono::system_clock::duration total{};
+	for (const detail::player_day& cur_day : days)
+		{ total += cur_day.total; }
+	std::string caption = std::format("{}: {:%H:%M:%S} on {} days", row.name, std::chrono::round<std::chrono::seconds>(total), days.size());
+	if (days.size() > player_graph_max_days)
+	{
+		days.erase(days.begin(), days.end() - player_graph_max_days);
+		caption += std::format(" (last {} shown)", player_graph_max_days);
+	}
+	return detail::write_graph<return_svg, render_to_png>(options, [&](auto& writer)
+		{ detail::draw_player_graph(writer, days, render_ctx.get_color(uuid), options.color, caption); });
+}
+
+#endif
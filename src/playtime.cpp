@@ -1,32 +1,607 @@
 #include "playtime_graph.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "file_watcher.h"
 #include "parse_logs.h"
+#include "player_graph.h"
+#include "presence_index.h"
+#include "session_export.h"
+#include "snapshot.h"
+
+// what is made and where from, see the usage message in main
+struct cli_options
+{
+	std::filesystem::path logs_dir = "logs";
+	std::string_view logs_timezone = "UTC";  // of the timestamps in the logs
+	std::string_view graph_timezone = graph_render_ctx::default_timezone;  // for dates in graphs and --from/--to
+	std::filesystem::path snapshot;  // read instead of the logs if not empty
+	std::filesystem::path out_dir = ".";
+	std::optional<std::chrono::local_days> from, to;  // inclusive
+	std::string_view format;  // empty for the default of the mode
+	bool light = true, dark = false;  // themes
+	std::size_t row_limit = 0;
+	bool batch_months = false, batch_players = false;
+	unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::filesystem::path export_output;  // export sessions to this instead of making graphs if not empty
+	std::size_t retention_months = 0;  // print the retention of this many monthly cohorts instead of making graphs if not 0
+	// keep making the graphs whose sessions changed when latest.log changes, once it hasn't for this long (see watch_logs)
+	std::optional<std::chrono::seconds> watch;
+};
+
+// sessions to make graphs of, only read once parsed so any number of renders can use them at once
+struct graph_source
+{
+	session_history history;  // from the snapshot
+	log_data_t recent;  // from the logs
+	parse_ctx_t ctx;  // always empty, players online when the logs end aren't shown as online now
+};
+
+// a graph to make, in each format and theme asked for
+struct graph_job
+{
+	std::string name;  // of the output files, without theme suffix and extension
+	time_range range;
+	std::optional<uuid_t> player;  // create_player_graph of this player instead of everyone
+};
+
+// @return false if the export couldn't be written
+static bool export_sessions(const log_data_t& data, const std::filesystem::path& output, export_format format, const time_range& range)
+{
+	std::ofstream fout(output, std::ios::binary);
+	if (!fout)
+	{
+		log_message(log_severity::fatal, std::format("Could not open {}", output.string()));
+		return false;
+	}
+	session_exporter exporter(format, [&fout](std::string_view part) { return static_cast<bool>(fout.write(part.data(), static_cast<std::streamsize>(part.size()))); });
+	exporter.add(data, range);
+	if (!exporter.finish() || !fout.flush())
+	{
+		log_message(log_severity::fatal, std::format("Could not write {}", output.string()));
+		return false;
+	}
+	log_message(log_severity::info, std::format("Exported {} sessions to {}", exporter.size(), output.string()));
+	return true;
+}
+
+// calls fn(uuid, session) for each session in `source`
+static void for_each_session(const graph_source& source, auto&& fn)
+{
+	for (const auto& segment : source.history.get_segments())
+	{
+		for (std::size_t i = 0; i < segment->size(); i++)
+		{
+			segment->for_each_session(i, time_range{}, [&](const play_session& session) { fn(segment->uuid(i), session); });
+		}
+	}
+	for (const auto& [uuid, player] : source.recent)
+	{
+		for (const play_session& session : player.second.first)
+			{ fn(uuid, session); }
+	}
+}
 
-int main()
+// @return the graph of everyone in `range`, and with batch_months one for each month there are sessions in, and with batch_players one for each player
+static std::vector<graph_job> get_graph_jobs(const graph_source& source, const cli_options& options, const time_range& range, const std::chrono::time_zone* timezone)
 {
-	const auto res = parse_logs("logs", std::chrono::locate_zone("UTC"));
+	std::vector<graph_job> jobs{ { "graph", range, std::nullopt } };
+	if (!options.batch_months && !options.batch_players)
+		{ return jobs; }
+
+	std::optional<play_session> bounds;  // from the first start to the last end of the sessions in range
+	std::vector<uuid_t> players;
+	for_each_session(source, [&](uuid_t uuid, const play_session& session)
+	{
+		if (!range.overlaps(session))
+			{ return; }
+		const play_session clipped = range.clip(session);
+		if (!bounds)
+			{ bounds = clipped; }
+		const auto begin = std::min(bounds->first, clipped.first);
+		const auto end = std::max(bounds->first + bounds->second, clipped.first + clipped.second);
+		bounds = play_session(begin, end - begin);
+		players.push_back(uuid);
+	});
+	if (!bounds)
+		{ return jobs; }
 
-	if (res.empty())
+	if (options.batch_months)
+	{
+		using namespace std::chrono;
+		const year_month_day first_day(floor<days>(timezone->to_local(bounds->first)));
+		const year_month_day last_day(floor<days>(timezone->to_local(bounds->first + bounds->second)));
+		for (year_month month = first_day.year() / first_day.month(); month <= last_day.year() / last_day.month(); month += months(1))
+		{
+			const time_range month_range = days_range(local_days(month / 1), local_days(month / last), timezone);
+			jobs.push_back({ std::format("playtime-{}-{:02}", static_cast<int>(month.year()), static_cast<unsigned int>(month.month())), { std::max(month_range.begin, range.begin), std::min(month_range.end, range.end) }, std::nullopt });
+		}
+	}
+	if (options.batch_players)
+	{
+		std::ranges::sort(players);
+		const auto [last, end] = std::ranges::unique(players);
+		players.erase(last, end);
+		// by uuid, since names change
+		for (const uuid_t uuid : players)
+			{ jobs.push_back({ std::format("player-{}", uuid), range, uuid }); }
+	}
+	return jobs;
+}
+
+// @return svg and png data of the graph of `job`, empty for the formats that weren't asked for
+// @throws std::runtime_error if png rendering fails
+static std::pair<std::string, std::string> render_graph(const graph_source& source, const graph_job& job, const graph_options& options, bool svg, bool png)
+{
+	const auto render = [&]<bool return_svg, bool render_to_png>()
+	{
+		if (job.player)
+			{ return create_player_graph<return_svg, render_to_png>(source.history, source.recent, source.ctx, job.player.value(), options); }
+		return create_graph<return_svg, render_to_png>(source.history, source.recent, source.ctx, options);
+	};
+	if (svg && png)
+		{ return render.template operator()<true, true>(); }
+	if (svg)
+		{ return { render.template operator()<true, false>(), {} }; }
+	return { {}, render.template operator()<false, true>() };
+}
+
+// write to a temporary file that is renamed over `path`, so a web server never serves a partly written graph
+// @return false if the file couldn't be written
+static bool write_file(const std::filesystem::path& path, std::string_view data)
+{
+	auto temp_path = path;
+	temp_path += ".tmp";
+	{
+		std::ofstream fout(temp_path, std::ios::binary);
+		if (!fout.write(data.data(), static_cast<std::streamsize>(data.size())) || !fout.flush())
+		{
+			log_message(log_severity::error, std::format("Could not write {}", temp_path.string()));
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		log_message(log_severity::error, std::format("Could not replace {}: {}", path.string(), ec.message()));
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+	return true;
+}
+
+// render every job in each theme on options.threads threads, which share `source` and `render_ctx` (see graph_render_ctx)
+// @return false if any graph couldn't be made
+static bool make_graphs(const graph_source& source, std::span<const graph_job> jobs, const cli_options& options, graph_render_ctx& render_ctx)
+{
+	const bool svg = (options.format != "png"), png = (options.format != "svg");
+	std::vector<std::pair<const graph_job*, bool>> renders;  // job and whether it is dark
+	for (const graph_job& job : jobs)
+	{
+		if (options.light)
+			{ renders.emplace_back(&job, false); }
+		if (options.dark)
+			{ renders.emplace_back(&job, true); }
+	}
+
+	std::atomic<std::size_t> next = 0;
+	std::atomic<bool> failed = false;
+	const auto worker = [&]()
+	{
+		for (std::size_t i = next++; i < renders.size(); i = next++)
+		{
+			const auto [job, dark] = renders[i];
+			graph_options render_options;
+			render_options.color = dark ? "white" : "black";
+			render_options.render_ctx = &render_ctx;
+			render_options.row_limit = options.row_limit;
+			render_options.range = job->range;
+			const auto path = options.out_dir / (job->name + (dark ? "-dark" : ""));
+			try
+			{
+				const auto [svg_data, png_data] = render_graph(source, *job, render_options, svg, png);
+				if ((svg && !write_file(path.string() + ".svg", svg_data)) || (png && !write_file(path.string() + ".png", png_data)))
+					{ failed = true; }
+			}
+			catch (const std::runtime_error& e)
+			{
+				log_message(log_severity::error, std::format("Could not make {}: {}", path.string(), e.what()));
+				failed = true;
+			}
+		}
+	};
+	{
+		std::vector<std::jthread> threads;
+		for (unsigned int i = 1; i < std::min<std::size_t>(options.threads, renders.size()); i++)
+			{ threads.emplace_back(worker); }
+		worker();
+	}
+	if (renders.size() > 1)
+		{ log_message(log_severity::info, std::format("Made {} graphs in {}", renders.size(), options.out_dir.string())); }
+	return !failed;
+}
+
+// sessions read by --watch, and where it got to in the logs
+struct watch_state
+{
+	graph_source source;  // archived sessions in history, and those of latest.log when it was last parsed
+	std::vector<log_manifest_entry> read_manifest;  // archives in source.history, in order
+	parse_ctx_t ctx;  // after the archives in read_manifest
+};
+
+// whose sessions changed since the graphs were last made, and when those sessions were
+struct graph_changes
+{
+	bool all = false;  // everything was read again, so every graph is made again
+	std::vector<uuid_t> players;  // sorted
+	std::chrono::system_clock::time_point first = std::chrono::system_clock::time_point::max(), last = std::chrono::system_clock::time_point::min();
+
+	void add(uuid_t uuid, std::span<const play_session> sessions)
+	{
+		players.push_back(uuid);
+		for (const auto& [start, duration] : sessions)
+		{
+			first = std::min(first, start);
+			last = std::max(last, start + duration);
+		}
+	}
+};
+
+// read what was added to the logs since the last update: archives that aren't in history yet are parsed once and committed to it,
+// and latest.log is parsed again (from the context after the archives), which is all that has to be read however long the history is
+// @return whose sessions changed
+static graph_changes update_watched_logs(watch_state& state, const cli_options& options, const std::chrono::time_zone* logs_timezone)
+{
+	graph_changes changes;
+	auto manifest = scan_logs_dir(options.logs_dir);
+	std::optional<log_manifest_entry> latest;
+	if (!manifest.empty() && manifest.back().is_latest)
+	{
+		latest = std::move(manifest.back());
+		manifest.pop_back();
+	}
+	if (!snapshot_coverage(state.read_manifest, manifest))
 	{
-		std::cerr << "FATAL ERROR: log parsing returned empty" << std::endl;
+		if (!state.read_manifest.empty())
+			{ log_message(log_severity::warning, "Archived logs were changed, reading all of them again"); }
+		state = watch_state();
+		changes.all = true;
+	}
+	if (state.read_manifest.size() != manifest.size())
+	{
+		const std::size_t num_new = manifest.size() - state.read_manifest.size();
+		auto [data, ctx] = parse_log_files<true, true>(std::vector(manifest.end() - static_cast<std::ptrdiff_t>(num_new), manifest.end()), logs_timezone,
+			[](auto&&) {}, std::move(state.ctx));
+		for (const auto& [uuid, player] : data)
+			{ changes.add(uuid, player.second.first); }
+		state.source.history.commit(data);
+		state.ctx = std::move(ctx);
+		state.read_manifest = std::move(manifest);
+		log_message(log_severity::info, std::format("Read {} new archived log files", num_new));
+	}
+
+	// players still online leave now, like without --watch
+	log_data_t recent = latest ? parse_log_files(std::vector{ std::move(latest.value()) }, logs_timezone, [](auto&&) {}, state.ctx) : log_data_t();
+	// sessions that are gone changed too, e.g. those of latest.log once it is archived
+	for (const auto& [uuid, player] : recent)
+	{
+		const auto it = state.source.recent.find(uuid);
+		if (it == state.source.recent.end())
+			{ changes.add(uuid, player.second.first); }
+		else if (it->second.second.first != player.second.first)
+		{
+			changes.add(uuid, player.second.first);
+			changes.add(uuid, it->second.second.first);
+		}
+	}
+	for (const auto& [uuid, player] : state.source.recent)
+	{
+		if (!recent.contains(uuid))
+			{ changes.add(uuid, player.second.first); }
+	}
+	state.source.recent = std::move(recent);
+
+	std::ranges::sort(changes.players);
+	const auto [last, end] = std::ranges::unique(changes.players);
+	changes.players.erase(last, end);
+	return changes;
+}
+
+// @return the jobs whose graphs `changes` changes: those of players whose sessions changed, and the others whose range has changed sessions
+[[nodiscard]] static std::vector<graph_job> changed_jobs(std::vector<graph_job> jobs, const graph_changes& changes)
+{
+	if (changes.all)
+		{ return jobs; }
+	std::erase_if(jobs, [&changes](const graph_job& job)
+	{
+		if (job.player)
+			{ return !std::ranges::binary_search(changes.players, job.player.value()); }
+		return !(changes.first < job.range.end && changes.last > job.range.begin);
+	});
+	return jobs;
+}
+
+// make the graphs, then make those whose sessions changed again whenever latest.log changes (it is written to, or archived and created again),
+// waiting until it has been left alone for options.watch first. reading continues from options.snapshot if there is one
+// @return false once watching fails
+static bool watch_logs(const cli_options& options, const std::chrono::time_zone* logs_timezone, const std::chrono::time_zone* graph_timezone)
+{
+	watch_state state;
+	if (!options.snapshot.empty())
+	{
+		if (auto snapshot = load_snapshot(options.snapshot, options.logs_dir))
+		{
+			state.source.history = std::move(snapshot->history);
+			state.read_manifest = std::move(snapshot->manifest);
+			state.ctx = std::move(snapshot->ctx);
+		}
+		else
+			{ log_message(log_severity::warning, std::format("Could not load snapshot {}, reading all logs", options.snapshot.string())); }
+	}
+
+	const std::string dir = options.logs_dir.string();
+	const std::string file = "latest.log";
+#ifdef _WIN32
+	bool notify_on_last_write = false;
+#define FILE_WATCHER_USER_DATA &notify_on_last_write
+#else
+#define FILE_WATCHER_USER_DATA nullptr
+#endif
+	auto watcher = file_watcher_init(dir.c_str(), file.c_str(), file.size(), FILE_WATCHER_USER_DATA);
+#undef FILE_WATCHER_USER_DATA
+	if (!watcher.has_value)
+	{
+		log_message(log_severity::fatal, std::format("Could not watch {}", (options.logs_dir / file).string()));
+		return false;
+	}
+
+	graph_render_ctx render_ctx(graph_timezone);
+	const time_range range = days_range(options.from, options.to, graph_timezone);
+	std::error_code ec;
+	std::filesystem::create_directories(options.out_dir, ec);
+	// reads all events there are, which are only a sign to update
+	// @return -1 on error, otherwise whether there were any
+	const auto drain_events = [&watcher]()
+	{
+		int any = 0;
+		for (;;)
+		{
+			const auto res = file_watcher_poll(&watcher);
+			if (res.state == -1)
+				{ return -1; }
+			if (res.state == 0)
+				{ return any; }
+			if (res.state == 1)
+			{
+				std::free(res.moved_to);
+				any = 1;
+			}
+		}
+	};
+	bool first = true;
+	for (;;)
+	{
+		graph_changes changes = update_watched_logs(state, options, logs_timezone);
+		changes.all = changes.all || first;
+		first = false;
+		const auto jobs = changed_jobs(get_graph_jobs(state.source, options, range, graph_timezone), changes);
+		// a graph that couldn't be written is tried again on the next change
+		if (!jobs.empty())
+			{ make_graphs(state.source, jobs, options, render_ctx); }
+
+		int events = 0;
+		while (events == 0)
+		{
+			events = drain_events();
+			if (events == 0 && file_watcher_wait(&watcher, -1) == -1)
+				{ events = -1; }
+		}
+		// the server writes a few lines at a time, and archiving latest.log is a rename, a compression and a create
+		while (events == 1)
+		{
+			std::this_thread::sleep_for(options.watch.value());
+			events = drain_events();
+		}
+		if (events == -1)
+			{ break; }
+	}
+	log_message(log_severity::fatal, std::format("Watching {} failed", (options.logs_dir / file).string()));
+	file_watcher_cleanup(&watcher);
+	return false;
+}
+
+// print the retention table of the last `num_months` monthly cohorts (see presence_index::retention)
+// @param to  last day counted, or the last day anyone was online if empty
+// @return false if nobody was online
+static bool print_retention(const graph_source& source, std::size_t num_months, std::optional<std::chrono::local_days> to, const std::chrono::time_zone* timezone)
+{
+	const presence_index index(source.history.get_segments(), timezone);
+	const presence_index::recent_t recent = index.get_recent(source.recent, source.ctx, std::chrono::system_clock::now());
+	const auto until = to ? to : index.last_day(recent);
+	if (!until)
+	{
+		log_message(log_severity::fatal, "Nobody was online");
+		return false;
+	}
+	const std::chrono::year_month_day until_date(until.value());
+	const std::chrono::year_month last = until_date.year() / until_date.month();
+	const auto cohorts = index.retention(last - std::chrono::months(static_cast<int>(num_months) - 1), last, until.value(), recent);
+	std::cout << format_retention(cohorts) << '\n';
+	return true;
+}
+
+// @return options from the command line, or empty optional if they aren't valid
+static std::optional<cli_options> parse_cli_options(int argc, char** argv)
+{
+	cli_options options;
+	if (argc % 2 == 0)
+		{ return std::nullopt; }
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string_view name = argv[i], value = argv[i + 1];
+		bool valid = true;
+		if (name == "--logs")
+			{ options.logs_dir = value; }
+		else if (name == "--logs-timezone")
+			{ options.logs_timezone = value; }
+		else if (name == "--graph-timezone")
+			{ options.graph_timezone = value; }
+		else if (name == "--snapshot")
+			{ options.snapshot = value; }
+		else if (name == "--out")
+			{ options.out_dir = value; }
+		else if (name == "--export")
+			{ options.export_output = value; }
+		else if (name == "--format")
+			{ options.format = value; }
+		else if (name == "--from" || name == "--to")
+		{
+			const auto date = parse_date(value);
+			valid = date.has_value();
+			(name == "--from" ? options.from : options.to) = date;
+		}
+		else if (name == "--theme")
+		{
+			valid = (value == "light" || value == "dark" || value == "both");
+			options.light = (value != "dark");
+			options.dark = (value != "light");
+		}
+		else if (name == "--limit" || name == "--threads" || name == "--retention" || name == "--watch")
+		{
+			std::size_t num;
+			const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), num);
+			valid = (ec == std::errc() && ptr == value.data() + value.size());
+			if (name == "--limit")
+				{ options.row_limit = num; }
+			else if (name == "--retention")
+				{ options.retention_months = std::clamp<std::size_t>(num, 1, 1200); }
+			else if (name == "--watch")
+				{ options.watch = std::chrono::seconds(std::min<std::size_t>(num, 3600)); }
+			else
+				{ options.threads = static_cast<unsigned int>(std::clamp<std::size_t>(num, 1, 256)); }
+		}
+		else if (name == "--batch")
+		{
+			for (const auto part : std::views::split(value, ','))
+			{
+				const std::string_view kind(part.begin(), part.end());
+				if (kind == "months")
+					{ options.batch_months = true; }
+				else if (kind == "players")
+					{ options.batch_players = true; }
+				else
+					{ valid = false; }
+			}
+		}
+		else
+			{ valid = false; }
+		if (!valid)
+			{ return std::nullopt; }
+	}
+	if (!options.export_output.empty() ? (!options.format.empty() && !parse_export_format(options.format))
+		: (!options.format.empty() && options.format != "svg" && options.format != "png" && options.format != "both"))
+		{ return std::nullopt; }
+	// only graphs are made again
+	if (options.watch && (!options.export_output.empty() || options.retention_months != 0))
+		{ return std::nullopt; }
+	return options;
+}
+
+int main(int argc, char** argv)
+{
+	const auto options = parse_cli_options(argc, argv);
+	if (!options)
+	{
+		std::cerr << "usage: playtime_graphs [--logs dir] [--logs-timezone tz] [--snapshot file] [--graph-timezone tz] [--from yyyy-mm-dd] [--to yyyy-mm-dd]\n"
+			"                       [--out dir] [--format svg|png|both] [--theme light|dark|both] [--limit rows] [--batch months,players] [--threads n]\n"
+			"                       [--watch seconds]\n"
+			"       playtime_graphs [--logs dir] [--logs-timezone tz] [--from yyyy-mm-dd] [--to yyyy-mm-dd] --export file [--format csv|ndjson|arrow]\n"
+			"       playtime_graphs [--logs dir] [--logs-timezone tz] [--snapshot file] [--graph-timezone tz] [--to yyyy-mm-dd] --retention months\n"
+			"       makes graph.svg and graph.png of the logs (./logs in UTC by default) or a snapshot, and with --batch one for each month\n"
+			"       (playtime-yyyy-mm) and each player (player-uuid) too, rendered in parallel. dark themed ones end with -dark\n"
+			"       with --watch it keeps running, and makes the graphs whose sessions changed again once latest.log hasn't changed for that long\n"
+			"       or exports the sessions instead (gzip compressed csv by default). dates are in the graph time zone (UTC for exports)\n"
+			"       or prints how many of the players first online in each of the last months (up to --to or the end of the logs) played in each month after\n";
+		return 1;
+	}
+
+	const std::chrono::time_zone* logs_timezone;
+	const std::chrono::time_zone* graph_timezone;
+	try
+	{
+		logs_timezone = std::chrono::locate_zone(options->logs_timezone);
+		graph_timezone = std::chrono::locate_zone(options->graph_timezone);
+	}
+	catch (const std::runtime_error& e)
+	{
+		log_message(log_severity::fatal, std::format("Unknown time zone: {}", e.what()));
+		return 1;
+	}
+
+	if (options->watch)
+	{
+		try
+			{ return watch_logs(*options, logs_timezone, graph_timezone) ? 0 : -1; }
+		catch (const std::runtime_error& e)
+		{
+			log_message(log_severity::error, e.what());
+			return -1;
+		}
+	}
+
+	graph_source source;
+	if (!options->snapshot.empty())
+	{
+		auto snapshot = load_snapshot(options->snapshot, options->logs_dir);
+		if (!snapshot)
+		{
+			log_message(log_severity::fatal, std::format("Could not load snapshot {}", options->snapshot.string()));
+			return -1;
+		}
+		source.history = std::move(snapshot->history);
+	}
+	else
+		{ source.recent = parse_logs(options->logs_dir, logs_timezone); }
+
+	if (source.recent.empty() && source.history.get_segments().empty())
+	{
+		log_message(log_severity::fatal, "log parsing returned empty");
 		return -1;
 	}
 
 	try
 	{
-		const auto [svg_data, png_data] = create_graph<true, true>(res);
-		
-		std::ofstream fout("graph.svg");
-		fout << svg_data;
-		fout.close();
-		
-		fout.open("graph.png", std::ios::binary);
-		fout << png_data;
-		fout.close();
+		if (!options->export_output.empty())
+		{
+			const log_data_t data = options->snapshot.empty() ? std::move(source.recent) : source.history.merged()->to_log_data();
+			const auto format = parse_export_format(options->format).value_or(export_format::csv);
+			return export_sessions(data, options->export_output, format, days_range(options->from, options->to, std::chrono::locate_zone("UTC"))) ? 0 : -1;
+		}
+
+		if (options->retention_months != 0)
+			{ return print_retention(source, options->retention_months, options->to, graph_timezone) ? 0 : -1; }
+
+		graph_render_ctx render_ctx(graph_timezone);
+		const time_range range = days_range(options->from, options->to, graph_timezone);
+		const auto jobs = get_graph_jobs(source, *options, range, graph_timezone);
+		std::error_code ec;
+		std::filesystem::create_directories(options->out_dir, ec);
+		if (!make_graphs(source, jobs, *options, render_ctx))
+			{ return -1; }
+#ifdef QC_TRACING
+		if (!write_chrome_trace("trace.json"))
+			{ log_message(log_severity::error, "Could not write trace.json"); }
+#endif
 	}
 	catch (const std::runtime_error& e)
 	{
-		std::cerr << "ERROR: " << e.what() << std::endl;
+		log_message(log_severity::error, e.what());
 		return -1;
 	}
 }
@@ -3,15 +3,30 @@
 
 #include <algorithm>
 #include <bit>
+#include <chrono>
 #include <cmath>
 #include <format>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
-#include <lunasvg.h>
-
+#include "graph_writer.h"
+#include "kway_merge.h"
 #include "parse_logs.h"
+#include "render_arena.h"
+#include "session_store.h"
+#include "text_metrics.h"
+#include "tracing.h"
 
 /*
 SVG layout:
@@ -35,26 +50,42 @@ inline constexpr double svg_bar_height = 25;
 inline constexpr double svg_bar_stride = 50;
 inline constexpr double svg_pad = svg_bar_height / 2;
 inline constexpr double svg_side_pad = 15;
+// gaps between a player's sessions narrower than this aren't visible (less than a pixel in the png), so those sessions are drawn as one bar
+inline constexpr double svg_min_bar_gap = 1 / detail::png_graph_writer::scale;
+inline constexpr std::string_view svg_others_color = "#808080";  // bars of the row combining players past the row limit
 
-namespace detail
-{
-	inline constexpr std::uint64_t uint64_phi = 0x9e3779b97f4a7c15; // 2^64 / phi (golden ratio), rounded down to odd
-
-	inline std::uint64_t hash_rrmxmx(std::uint64_t x, std::uint64_t gamma = uint64_phi)
-	{
-		x += gamma;
-		x ^= std::rotr(x, 49) ^ std::rotr(x, 24);
-		x *= 0x9FB21C651E98DF25ULL;
-		x ^= x >> 28;
-		x *= 0x9FB21C651E98DF25ULL;
-		return x ^ (x >> 28);
-	}
+class graph_render_ctx;
 
-	inline std::uint64_t hash_combine(std::uint64_t lhs, std::uint64_t rhs)
-	{
-		return hash_rrmxmx(hash_rrmxmx(lhs) + rhs);
-	}
+// output options for create_graph
+struct graph_options
+{
+	// text and axis color, or adaptive_color for an svg that can be shown in either theme, or a png whose other layers can be shared by both
+	std::string_view color = "black";
+	std::string_view theme_color = "black";  // what adaptive_color is drawn as in a png
+	bool row_paths = true;  // whether each row of bars in the svg is one <path> (otherwise one <rect> per bar)
+	int png_compression_level = 6;  // libdeflate level (0-12), higher is smaller but slower
+	// state shared between renders (colors and time zone). if null, a temporary one with the default time zone is used
+	graph_render_ctx* render_ctx = nullptr;
+	// maximum number of player rows (0 for no limit). players with less playtime are combined into one more row after them
+	std::size_t row_limit = 0;
+	time_range range;  // only sessions in this are shown and counted in totals (clipped to it), and only players with any
+	// largest png to return (e.g. discord's attachment limit), 0 for no limit. a png that wouldn't fit is rendered at a smaller scale,
+	// or an svg is returned instead if it doesn't fit at any (see graph_size_estimator). not used when both are returned
+	std::size_t png_max_bytes = 0;
+	// most memory rasterizing the png may take (see graph_size_estimator::surface_bytes), 0 for no limit. like png_max_bytes, a png that
+	// wouldn't fit is rendered at a smaller scale, or an svg is returned instead. not used when both are returned
+	std::size_t png_max_surface_bytes = 0;
+	float png_scale = 0;  // pixels per svg unit, 0 for png_graph_writer::scale. e.g. 1 for a quick preview (see png_max_bytes)
+	// if not null and only the png is returned, receives it downsampled by each of png_graph_writer::variant_divisors as well, from the same
+	// rasterization. left empty if the png was made smaller to fit png_max_bytes or png_max_surface_bytes, or an svg was returned instead
+	std::vector<std::string>* png_variants = nullptr;
+	// identifies everything about a png besides its theme, so it can start from the layer drawn for the other theme (see png_layer_cache,
+	// needs render_ctx and color = adaptive_color). 0 to not share it, e.g. if the graph depends on the time it is rendered at
+	std::uint64_t layer_key = 0;
+};
 
+namespace detail
+{
 	// assumes s != 0
 	// @return rgb values in 0-255
 	inline std::tuple<int, int, int> hsl2rgb(double h, double s, double l)
@@ -81,45 +112,382 @@ namespace detail
 		const auto [red, green, blue] = hsl2rgb(hue, saturation, lightness);
 		return std::format("#{:02X}{:02X}{:02X}", red, green, blue);
 	}
+}
 
-	// @throws std::runtime_error if svg loading fails
-	inline lunasvg::Box get_svg_bbox(std::string_view svg_data)
+// state that stays the same between renders, so it isn't recalculated for every graph
+// can be used by several renders at once
+class graph_render_ctx
+{
+private:
+	const std::chrono::time_zone* timezone;
+	std::mutex colors_mutex;
+	std::map<uuid_t, std::string> colors;  // from get_rgb_hex_from_uuid, only added to
+	detail::segment_cache<daily_playtime> daily_playtimes;
+	detail::segment_cache<weekly_playtime> weekly_playtimes;
+	detail::segment_cache<player_name_index> name_indices;
+	detail::segment_cache<std::vector<online_players::event>> online_events;  // of each segment
+	detail::history_cache<online_players> online_history;
+	detail::png_layer_cache png_layers;
+
+public:
+	static constexpr std::string_view default_timezone = "US/Pacific";
+
+	// @param timezone  time zone for date labels
+	explicit graph_render_ctx(const std::chrono::time_zone* timezone) : timezone(timezone) {}
+	// @throws std::runtime_error if the default time zone can't be found
+	graph_render_ctx() : graph_render_ctx(std::chrono::locate_zone(default_timezone)) {}
+
+	[[nodiscard]] const std::chrono::time_zone* get_timezone() const noexcept
+		{ return timezone; }
+
+	// shared layers of pngs rendered in one theme, for rendering them in the other (see graph_options::layer_key)
+	[[nodiscard]] detail::png_layer_cache& get_png_layers() noexcept
+		{ return png_layers; }
+
+	// @return bar color of a player, valid for the lifetime of this
+	[[nodiscard]] std::string_view get_color(uuid_t uuid)
 	{
-		const auto svg_doc = lunasvg::Document::loadFromData(svg_data.data(), svg_data.size());
-		if (!svg_doc)
-			{ throw std::runtime_error(std::format("Temporary SVG Document loading failed. SVG data:\n{}", svg_data)); }
-		return svg_doc->boundingBox();
+		const std::lock_guard lock(colors_mutex);
+		auto it = colors.find(uuid);
+		if (it == colors.end())
+			{ it = colors.emplace(uuid, detail::get_rgb_hex_from_uuid(uuid)).first; }
+		return it->second;
 	}
 
-	// @return data height
-	template<typename Duration, typename Duration2>
-	inline double add_player_names(auto&& add, const auto& log_info, std::chrono::sys_time<Duration>& first_time, std::chrono::sys_time<Duration2>& last_time, std::string_view color)
+	// @return playtime per day of a history segment in the time zone, calculated the first time the segment is used
+	[[nodiscard]] std::shared_ptr<const daily_playtime> get_daily_playtime(const std::shared_ptr<const session_store>& segment)
+		{ return daily_playtimes.get(segment, [&]() { return daily_playtime(*segment, timezone); }); }
+
+	// @return playtime per hour of the week of a history segment in the time zone, calculated the first time the segment is used
+	[[nodiscard]] std::shared_ptr<const weekly_playtime> get_weekly_playtime(const std::shared_ptr<const session_store>& segment)
+		{ return weekly_playtimes.get(segment, [&]() { return weekly_playtime(*segment, timezone); }); }
+
+	// @return index of the names of a history segment, made the first time the segment is used
+	[[nodiscard]] std::shared_ptr<const player_name_index> get_name_index(const std::shared_ptr<const session_store>& segment)
+		{ return name_indices.get(segment, [&]() { return player_name_index(*segment); }); }
+
+	// @param segments  all history segments, oldest first
+	// @return players online over time in history. the joins and leaves of each segment are sorted the first time it is used,
+	//         and the step function is only made again when the segments change, from a k-way merge of them (the segments of all servers,
+	//         for the merged view, so concurrency across servers is one pass over them)
+	[[nodiscard]] std::shared_ptr<const online_players> get_online_players(std::span<const std::shared_ptr<const session_store>> segments)
 	{
-		std::size_t ind = 0;
-		double data_height = 0;
-		for (const auto& [_, info] : log_info)
+		return online_history.get(segments, [&]() { return make_online_players(segments); });
+	}
+
+	// @return players online over time in history, made from the sorted joins and leaves of each segment without replacing the step function
+	//         get_online_players keeps, e.g. for a graph of each server that doesn't replace that of all of them
+	[[nodiscard]] online_players make_online_players(std::span<const std::shared_ptr<const session_store>> segments)
+	{
+		std::vector<std::shared_ptr<const std::vector<online_players::event>>> segment_events;
+		std::vector<std::span<const online_players::event>> runs;
+		segment_events.reserve(segments.size());
+		runs.reserve(segments.size());
+		for (const auto& segment : segments)
+			{ runs.emplace_back(*segment_events.emplace_back(online_events.get(segment, [&]() { return online_players::get_events(*segment); }))); }
+		return online_players(kway_merge(runs));
+	}
+};
+
+namespace detail
+{
+	// a player's row in the graph
+	// it refers to the data it was made from instead of copying it, so that data must outlive it
+	// its vectors use the allocator it was made with (e.g. a render_arena's), which a row moved from it keeps
+	struct graph_row
+	{
+		using allocator_type = std::pmr::polymorphic_allocator<>;
+
+		// sessions from one source: either a log_data_t player or a player of a session_store
+		struct part
+		{
+			const playtime_info::first_type* sessions = nullptr;  // from log data
+			const session_store* store = nullptr;
+			std::size_t player_ind = 0;
+			std::size_t first = 0, last = 0;  // indices of sessions that can be in the range
+		};
+
+		uuid_t uuid;
+		time_range range;  // sessions are clipped to this
+		std::string_view name;  // latest name
+		std::chrono::system_clock::duration total{};  // in the range
+		std::size_t num_sessions = 0;  // in the range
+		std::pmr::vector<part> parts;  // oldest first
+		// session of an online player, since they haven't left yet (which ends at the time the graph is created)
+		std::optional<play_session> online_session;
+		// for the row combining players past the row limit: when any of them were online (sorted and not overlapping)
+		std::pmr::vector<play_session> combined_sessions;
+		bool is_combined = false;
+
+		explicit graph_row(allocator_type alloc = {}) : parts(alloc), combined_sessions(alloc) {}
+		graph_row(uuid_t uuid, const time_range& range, allocator_type alloc = {}) : uuid(uuid), range(range), parts(alloc), combined_sessions(alloc) {}
+		graph_row(const graph_row& other, allocator_type alloc) :
+			uuid(other.uuid), range(other.range), name(other.name), total(other.total), num_sessions(other.num_sessions), parts(other.parts, alloc),
+			online_session(other.online_session), combined_sessions(other.combined_sessions, alloc), is_combined(other.is_combined) {}
+		graph_row(graph_row&& other, allocator_type alloc) :
+			uuid(other.uuid), range(other.range), name(other.name), total(other.total), num_sessions(other.num_sessions), parts(std::move(other.parts), alloc),
+			online_session(other.online_session), combined_sessions(std::move(other.combined_sessions), alloc), is_combined(other.is_combined) {}
+		graph_row(const graph_row& other) : graph_row(other, allocator_type()) {}
+		graph_row(graph_row&&) = default;
+		graph_row& operator=(const graph_row&) = default;
+		graph_row& operator=(graph_row&&) = default;
+
+		[[nodiscard]] allocator_type get_allocator() const noexcept
+			{ return parts.get_allocator(); }
+
+		// sessions in recent data are checked one by one, there are few of them
+		void add(const log_data_t::mapped_type& data)
+		{
+			const auto& [names, play_info] = data;
+			if (!names.empty())
+				{ name = names.back(); }
+			const auto& sessions = play_info.first;
+			part& cur_part = parts.emplace_back(&sessions, nullptr, 0, 0, sessions.size());
+			if (range.unbounded())
+			{
+				total += play_info.second;
+				num_sessions += sessions.size();
+				return;
+			}
+			// narrow to the sessions in the range
+			while (cur_part.first < cur_part.last && !range.overlaps(sessions[cur_part.first]))
+				{ cur_part.first++; }
+			while (cur_part.last > cur_part.first && !range.overlaps(sessions[cur_part.last - 1]))
+				{ cur_part.last--; }
+			add_in_range(cur_part);
+		}
+
+		// @param days  if the range is whole days, playtime per day of `store` and the days (in the time zone of the playtimes),
+		//              so the total doesn't need to go through sessions. num_sessions is then the sessions that can be in the range
+		void add(const session_store& store, std::size_t player_ind,
+			std::optional<std::pair<const daily_playtime*, std::pair<std::chrono::local_days, std::chrono::local_days>>> days = std::nullopt)
 		{
-			const auto& [names, play_info] = info;
-			add(std::format("<text x=\"{}\" y=\"{}\" font-size=\"{}\" font-family=\"monospace\" fill=\"{}\" text-anchor=\"end\" dominant-baseline=\"middle\">{}</text>\n",
-				-svg_pad, svg_bar_height / 2 + svg_bar_stride * ind, svg_fontsize, color, names.back()));
-			data_height += svg_bar_stride;
+			const auto names = store.player_names(player_ind);
+			if (!names.empty())
+				{ name = names.back(); }
+			const auto [first, last] = store.overlapping_sessions(player_ind, range);
+			const part& cur_part = parts.emplace_back(nullptr, &store, player_ind, first, last);
+			if (range.unbounded())
+			{
+				total += store.total_playtime(player_ind);
+				num_sessions += last - first;
+			}
+			else if (days)
+			{
+				const auto& [playtimes, day_range] = days.value();
+				total += playtimes->playtime(player_ind, day_range.first, day_range.second);
+				num_sessions += last - first;
+			}
+			else
+				{ add_in_range(cur_part); }
+		}
+
+		// call f(play_session) for each session (clipped to the range), in the order they started
+		// the parts of a player who played on several servers overlap in time, so they are merged (see kway_merge) instead of gone through one after another
+		void for_each_session(auto&& f) const
+		{
+			const auto visit = [this, &f](const play_session& session)
+			{
+				if (range.overlaps(session))
+					{ f(range.clip(session)); }
+			};
+			if (parts.size() == 1)
+				{ for_each_part_session(parts.front(), visit); }
+			else if (!parts.empty())
+			{
+				std::pmr::vector<decltype(part_sessions(parts.front()))> runs(get_allocator());
+				runs.reserve(parts.size());
+				for (const part& cur_part : parts)
+					{ runs.push_back(part_sessions(cur_part)); }
+				for (const play_session& session : kway_merge(runs, std::ranges::less(), &play_session::first))
+					{ visit(session); }
+			}
+			for (const play_session& session : combined_sessions)
+				{ f(session); }
+			if (online_session)
+				{ f(online_session.value()); }
+		}
+
+	private:
+		[[nodiscard]] static play_session part_session(const part& cur_part, std::size_t i)
+			{ return (cur_part.sessions != nullptr) ? (*cur_part.sessions)[i] : cur_part.store->session(cur_part.player_ind, i); }
+
+		// @return view of the sessions of a part, in order
+		[[nodiscard]] static auto part_sessions(const part& cur_part)
+		{
+			return std::views::iota(cur_part.first, cur_part.last)
+				| std::views::transform([&cur_part](std::size_t i) { return part_session(cur_part, i); });
+		}
+
+		static void for_each_part_session(const part& cur_part, auto&& f)
+		{
+			for (std::size_t i = cur_part.first; i < cur_part.last; i++)
+				{ f(part_session(cur_part, i)); }
+		}
+
+		void add_in_range(const part& cur_part)
+		{
+			for_each_part_session(cur_part, [this](const play_session& session)
+			{
+				if (range.overlaps(session))
+				{
+					total += range.clip(session).second;
+					num_sessions++;
+				}
+			});
+		}
+	};
+
+	using graph_rows = std::pmr::vector<graph_row>;
+
+	// @param segments  sessions from history, oldest first (see session_history)
+	// @param recent  sessions newer than all segments
+	// @param range  only sessions in this are included (clipped to it)
+	// @param render_ctx  if the range is whole days in its time zone, totals in history come from playtime per day
+	// @param memory  of the rows, and what is used while making them (e.g. a render_arena's)
+	// @return rows of all players, sorted by uuid
+	inline graph_rows get_graph_rows(std::span<const std::shared_ptr<const session_store>> segments, const log_data_t& recent, const time_range& range,
+		graph_render_ctx& render_ctx, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+	{
+		QC_TRACE_SCOPE("get_graph_rows");
+		const auto day_range = range.unbounded() ? std::nullopt : daily_playtime::whole_days(range, render_ctx.get_timezone());
+		graph_rows parts(memory);  // one for each player in each source
+		for (const auto& segment : segments)
+		{
+			const auto playtimes = day_range ? render_ctx.get_daily_playtime(segment) : nullptr;
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				graph_row& part = parts.emplace_back(segment->uuid(i), range);
+				if (playtimes)
+					{ part.add(*segment, i, std::make_pair(playtimes.get(), day_range.value())); }
+				else
+					{ part.add(*segment, i); }
+			}
+		}
+		for (const auto& [uuid, data] : recent)
+			{ parts.emplace_back(uuid, range).add(data); }
+		// keep the order of sources for each player
+		std::ranges::stable_sort(parts, {}, &graph_row::uuid);
+
+		graph_rows rows(memory);
+		for (graph_row& part : parts)
+		{
+			if (rows.empty() || rows.back().uuid != part.uuid)
+			{
+				rows.push_back(std::move(part));
+				continue;
+			}
+			graph_row& row = rows.back();
+			if (!part.name.empty())
+				{ row.name = part.name; }
+			row.total += part.total;
+			row.num_sessions += part.num_sessions;
+			row.parts.insert(row.parts.end(), part.parts.begin(), part.parts.end());
+		}
+		return rows;
+	}
+
+	// make currently online players leave at `now`, by adding a session to their rows
+	// @param rows  sorted by uuid. a player who is online for the first time has no sessions yet (they are only added when players leave),
+	//              so they get a row of their own
+	// @param range  of the rows (see get_graph_rows)
+	inline void add_online_sessions(graph_rows& rows, const parse_ctx_t& parse_ctx, const time_range& range, std::chrono::system_clock::time_point now)
+	{
+		for (const std::uint32_t id : parse_ctx.player_info.online())
+		{
+			const auto& [uuid, join_time] = parse_ctx.player_info.infos()[id];
+			if (uuid)
+			{
+				auto it = std::ranges::lower_bound(rows, uuid.value(), {}, &graph_row::uuid);
+				if (it == rows.end() || it->uuid != uuid.value())
+					{ it = rows.emplace(it, uuid.value(), range); }
+				it->name = parse_ctx.player_info.name(id);
+				const play_session session(join_time.value(), now - join_time.value());
+				if (it->range.overlaps(session))
+				{
+					it->online_session = it->range.clip(session);
+					it->total += it->online_session->second;
+					it->num_sessions++;
+				}
+			}
+		}
+	}
+
+	// remove rows of players without sessions in the range, if it is bounded (otherwise all players are shown)
+	inline void remove_empty_rows(graph_rows& rows)
+	{
+		std::erase_if(rows, [](const graph_row& row) { return !row.range.unbounded() && row.num_sessions == 0; });
+	}
+
+	// sort rows for the graph, most playtime first
+	inline void sort_graph_rows(std::span<graph_row> rows)
+		{ std::ranges::sort(rows, std::ranges::greater(), &graph_row::total); }
 
-			for (const auto& [time, dur] : play_info.first)
+	// sort rows for the graph like sort_graph_rows, keeping at most `limit` of them
+	// the rest are replaced by one row after them, with their total playtime and bars for when any of them were online
+	// @param limit  0 for no limit
+	// @param combined_name  storage for the name of the combined row, which must outlive the rows
+	inline void select_graph_rows(graph_rows& rows, std::size_t limit, std::string& combined_name)
+	{
+		if (limit == 0 || rows.size() <= limit)
+		{
+			sort_graph_rows(rows);
+			return;
+		}
+		// only the rows that are shown need to be in order
+		const auto shown_end = rows.begin() + static_cast<std::ptrdiff_t>(limit);
+		std::ranges::partial_sort(rows, shown_end, std::ranges::greater(), &graph_row::total);
+
+		graph_row combined(rows.get_allocator());
+		combined.is_combined = true;
+		std::pmr::vector<play_session>& sessions = combined.combined_sessions;
+		for (auto it = shown_end; it != rows.end(); ++it)
+		{
+			combined.total += it->total;
+			it->for_each_session([&sessions](const play_session& session) { sessions.push_back(session); });
+		}
+		std::ranges::sort(sessions, {}, &play_session::first);
+		// merge overlapping sessions
+		std::size_t num_merged = 0;
+		for (const play_session& session : sessions)
+		{
+			if (num_merged != 0)
 			{
-				first_time = std::min(first_time, time);
-				last_time = std::max(last_time, time + dur);
+				auto& [time, dur] = sessions[num_merged - 1];
+				if (session.first <= time + dur)
+				{
+					dur = std::max(dur, session.first + session.second - time);
+					continue;
+				}
 			}
+			sessions[num_merged] = session;
+			num_merged++;
+		}
+		sessions.resize(num_merged);
+
+		combined_name = std::format("{} others", rows.size() - limit);
+		combined.name = combined_name;
+		rows.erase(shown_end, rows.end());
+		rows.push_back(std::move(combined));
+	}
+
+	inline void add_player_names(auto& writer, std::span<const graph_row> rows, std::string_view color)
+	{
+		std::size_t ind = 0;
+		for (const graph_row& row : rows)
+		{
+			writer.text(-svg_pad, svg_bar_height / 2 + svg_bar_stride * ind, svg_fontsize, true, color, text_anchor::end, text_baseline::middle, row.name);
 			ind++;
 		}
-		return data_height;
 	}
 
+	// call f(x, text) for each date label (x is the center of the label)
 	// @return x coordinate of center of rightmost date, or -1 if no dates were present
+	// @param target_tz  time zone of the dates
 	template<typename Duration, typename Duration2>
-	inline double add_dates(auto&& add, std::chrono::sys_time<Duration> first_time, std::chrono::sys_time<Duration2> last_time,
-		double data_height, double data_area_width, std::string_view color)
+	inline double for_each_date(auto&& f, std::chrono::sys_time<Duration> first_time, std::chrono::sys_time<Duration2> last_time, double data_area_width,
+		const std::chrono::time_zone* target_tz)
 	{
-		const auto* target_tz = std::chrono::locate_zone("US/Pacific");
 		const auto first_time_local = target_tz->to_local(first_time);
 		const auto last_time_local = target_tz->to_local(last_time);
 		const auto first_day = std::chrono::ceil<std::chrono::days>(first_time_local);
@@ -135,203 +503,324 @@ namespace detail
 			if (cur_date > last_day)
 				{ break; }
 			const double cur_x = (cur_date - first_time_local) / total_dur * data_area_width;
-			add(std::format("<text x=\"{}\" y=\"{}\" font-size=\"{}\" fill=\"{}\" text-anchor=\"middle\" dominant-baseline=\"hanging\">{:%m/%d/%Y}</text>\n",
-				cur_x, data_height + svg_pad, svg_date_fontsize, color, cur_date));
+			f(cur_x, std::format("{:%m/%d/%Y}", cur_date));
 			last_date_x = cur_x;
 		}
 		return last_date_x;
 	}
 
-	inline void add_data_labels(auto&& add, const auto& log_info, double data_area_width, std::string_view color)
+	template<typename Duration, typename Duration2>
+	inline void add_dates(auto& writer, std::chrono::sys_time<Duration> first_time, std::chrono::sys_time<Duration2> last_time,
+		double data_height, double data_area_width, std::string_view color, const std::chrono::time_zone* target_tz)
+	{
+		for_each_date([&](double x, std::string_view date)
+			{ writer.text(x, data_height + svg_pad, svg_date_fontsize, false, color, text_anchor::middle, text_baseline::hanging, date); },
+			first_time, last_time, data_area_width, target_tz);
+	}
+
+	// @return text of the total playtime label of a player
+	inline std::string get_data_label(const graph_row& row)
+		{ return std::format("{:%H:%M:%S}", std::chrono::round<std::chrono::seconds>(row.total)); }
+
+	inline void add_data_labels(auto& writer, std::span<const graph_row> rows, double data_area_width, std::string_view color)
 	{
 		std::size_t ind = 0;
-		for (const auto& [_, info] : log_info)
+		for (const graph_row& row : rows)
 		{
-			add(std::format("<text x=\"{}\" y=\"{}\" font-size=\"{}\" font-family=\"monospace\" fill=\"{}\" text-anchor=\"end\" dominant-baseline=\"middle\">{:%H:%M:%S}</text>",
-				data_area_width, svg_bar_height / 2 + svg_bar_stride * ind, svg_fontsize, color, std::chrono::round<std::chrono::seconds>(info.second.second)));
+			writer.text(data_area_width, svg_bar_height / 2 + svg_bar_stride * ind, svg_fontsize, true, color, text_anchor::end, text_baseline::middle, get_data_label(row));
 			ind++;
 		}
 	}
 
+	// each player's sessions are merged into as few bars as look the same, so the number of bars depends on the width and not the number of sessions
 	template<typename Duration, typename Duration2>
-	inline void add_data_bars(auto&& add, const auto& log_info, std::chrono::sys_time<Duration> first_time, std::chrono::sys_time<Duration2> last_time, double data_area_width)
+	inline void add_data_bars(auto& writer, std::span<const graph_row> rows, std::chrono::sys_time<Duration> first_time, std::chrono::sys_time<Duration2> last_time, double data_area_width,
+		graph_render_ctx& render_ctx)
 	{
 		std::size_t ind = 0;
 		const std::chrono::duration<double> total_dur = last_time - first_time;
-		for (const auto& [uuid, info] : log_info)
+		// x and width of each bar in the current row, reused
+		std::pmr::vector<std::pair<double, double>> bars(rows.empty() ? graph_row::allocator_type() : rows.front().get_allocator());
+		for (const graph_row& row : rows)
 		{
-			const auto& [_, play_info] = info;
-			const std::string color = get_rgb_hex_from_uuid(uuid);
+			const std::string_view color = row.is_combined ? svg_others_color : render_ctx.get_color(row.uuid);
 
-			for (const auto& [time, dur] : play_info.first)
+			bars.clear();
+			row.for_each_session([&](const play_session& session)
 			{
-				add(std::format("<rect x=\"{}\" y=\"{}\" width=\"{}\" height=\"{}\" fill=\"{}\"/>\n",
-					(time - first_time) / total_dur * data_area_width, svg_bar_stride * ind, dur / total_dur * data_area_width, svg_bar_height, color));
-			}
+				const auto& [time, dur] = session;
+				const double x = (time - first_time) / total_dur * data_area_width;
+				const double width = dur / total_dur * data_area_width;
+				if (!bars.empty())
+				{
+					auto& [bar_x, bar_width] = bars.back();
+					if (x >= bar_x && x - (bar_x + bar_width) < svg_min_bar_gap)
+					{
+						bar_width = std::max(bar_width, x + width - bar_x);
+						return;
+					}
+				}
+				bars.emplace_back(x, width);
+			});
+			writer.bar_row(svg_bar_stride * ind, svg_bar_height, color, bars);
 			ind++;
 		}
 	}
-	
-	// pointer to temporary buffer for png data when rendering svg to png
-	// (lunasvg png callback is c function pointer so capturing lambda wouldn't work)
-	inline std::string* png_data_ptr = nullptr;
 
-	// @param log_info  sorted/ordered vector
-	template<bool return_svg, bool render_to_png>
-	inline auto create_graph(const auto& log_info, std::string_view color, std::chrono::system_clock::time_point now = std::chrono::system_clock::now())
+	// calculate size for date labels (x-axis), which are at most `width` apart
+	// the width is shrunk so the last date fits in it, since its label is centered on it
+	// @return new width, and height of the date labels (0 if there are none)
+	template<typename Duration, typename Duration2>
+	inline std::pair<double, double> fit_date_labels(double width, std::chrono::sys_time<Duration> first_time, std::chrono::sys_time<Duration2> last_time,
+		const std::chrono::time_zone* target_tz)
 	{
-		// we will delay adding the <svg> to our main svg_data because the viewBox needs to be calculated
-		std::string svg_data;
-		// these are just placeholders for bbox calculation so we don't actually need to specify a size
-		constexpr std::string_view placeholder_svg_header = "<svg xmlns=\"http://www.w3.org/2000/svg\">\n", svg_footer = "</svg>";
-		std::string placeholder_svg(placeholder_svg_header);
-		std::chrono::system_clock::time_point first_time = now, last_time;
-
-		const auto reset_placeholder_svg = [&]() { placeholder_svg = std::string(placeholder_svg_header); };
-
-
-		// y-axis
-		const double data_height = detail::add_player_names([&](std::string_view cur_line) { svg_data += cur_line; placeholder_svg += cur_line; },
-			log_info, first_time, last_time, color);
-
-		double text_width;
+		auto& metrics = text_metrics::get();
+		// measure width first so we know how much to shrink our data area by
+		text_bounds bounds;
+		const double last_date_x = detail::for_each_date([&](double x, std::string_view date)
+			{ bounds.add(x, metrics.text_width(date, svg_date_fontsize), text_anchor::middle); },
+			first_time, last_time, width, target_tz);
+		if (last_date_x == -1)
+			{ return { width, 0 }; }
+
+		const double right = bounds.get_right();
+		if (right > width)
 		{
-			placeholder_svg += svg_footer;
-			const auto [x, y, w, h] = detail::get_svg_bbox(placeholder_svg);
-			text_width = std::ceil(w / 2.5) * 2.5;  // round up to multiple of 2.5
-			reset_placeholder_svg();
+			const double last_date_half_width = right - last_date_x;
+			// last_date_x * mult + last_date_half_width = width
+			width *= (width - last_date_half_width) / last_date_x;
+			width = std::floor(width / 2.5) * 2.5;  // round down to multiple of 2.5
 		}
+		// all dates are on one line
+		return { std::ceil(width / 2.5) * 2.5, svg_pad + svg_date_fontsize };  // round up to multiple of 2.5
+	}
 
-		double data_area_width = svg_width - (text_width + svg_pad);
+	// sizes and positions of the graph parts (see SVG layout above)
+	struct graph_layout
+	{
+		std::chrono::system_clock::time_point first_time, last_time;
+		double data_height;
+		double text_width;  // player names
+		double axis_width;  // x-axis line
+		double data_area_width;  // data bars and data labels
+		double date_height;  // 0 if there are no dates (and no x-axis line)
+		double data_labels_width;
+	};
 
-		// calculate size for date labels (x-axis)
-		double date_height = 0;
-		{
-			// TODO: specify target time zone in config or something
-			// measure width first so we know how much to shrink our data area by
-			const double last_date_x = detail::add_dates([&](std::string_view cur_line) { placeholder_svg += cur_line; },
-				first_time, last_time, data_height, data_area_width, color);
+	// @param target_tz  time zone of the dates
+	inline graph_layout get_graph_layout(std::span<const graph_row> rows, std::chrono::system_clock::time_point now, const std::chrono::time_zone* target_tz)
+	{
+		graph_layout layout{};
+		layout.first_time = now;
+		// text sizes are what lunasvg would give as the bounding box of the text
+		auto& metrics = text_metrics::get();
 
-			if (last_date_x != -1)
+		// y-axis
+		{
+			text_bounds bounds;
+			for (const graph_row& row : rows)
 			{
-				svg_data += std::format("<line x1=\"0\" y1=\"{0}\" x2=\"{1}\" y2=\"{0}\" stroke=\"{2}\" stroke-width=\"2\"/>\n", data_height, data_area_width, color);
+				bounds.add(-svg_pad, metrics.text_width(row.name, svg_fontsize), text_anchor::end);
+				layout.data_height += svg_bar_stride;
 
-				placeholder_svg += svg_footer;
-				const auto [x, y, w, h] = detail::get_svg_bbox(placeholder_svg);
-				if (x + w > data_area_width)
+				row.for_each_session([&layout](const play_session& session)
 				{
-					const double last_date_half_width = (x + w) - last_date_x;
-					// last_date_x * mult + last_date_half_width = data_area_width
-					data_area_width *= (data_area_width - last_date_half_width) / last_date_x;
-					data_area_width = std::floor(data_area_width / 2.5) * 2.5;  // round down to multiple of 2.5
-				}
-				reset_placeholder_svg();
-
-				date_height = svg_pad + h;
-				data_area_width = std::ceil(data_area_width / 2.5) * 2.5;  // round up to multiple of 2.5
+					const auto& [time, dur] = session;
+					layout.first_time = std::min(layout.first_time, time);
+					layout.last_time = std::max(layout.last_time, time + dur);
+				});
 			}
-
+			layout.text_width = std::ceil(bounds.get_width() / 2.5) * 2.5;  // round up to multiple of 2.5
 		}
 
+		layout.axis_width = svg_width - (layout.text_width + svg_pad);
+		std::tie(layout.data_area_width, layout.date_height) = fit_date_labels(layout.axis_width, layout.first_time, layout.last_time, target_tz);
+		const double data_area_width = layout.data_area_width;
 
-		svg_data = std::format("<svg width=\"{0}\" height=\"{1}\" viewBox=\"{2} {3} {0} {1}\" xmlns=\"http://www.w3.org/2000/svg\">\n",
-			svg_width + 2 * svg_side_pad, data_height + date_height + 2 * svg_side_pad, -(text_width + svg_pad) - svg_side_pad, -svg_side_pad) + svg_data;
-
-		double data_labels_width;
 		{
-			detail::add_data_labels([&](std::string_view cur_line) { placeholder_svg += cur_line; }, log_info, data_area_width, color);
-			placeholder_svg += svg_footer;
-			const auto [x, y, w, h] = detail::get_svg_bbox(placeholder_svg);
-			data_labels_width = w;
+			text_bounds bounds;
+			for (const graph_row& row : rows)
+				{ bounds.add(data_area_width, metrics.text_width(get_data_label(row), svg_fontsize), text_anchor::end); }
+			layout.data_labels_width = bounds.get_width();
 		}
+		return layout;
+	}
+
+	// @param writer  svg_graph_writer or png_graph_writer
+	inline void draw_graph(auto& writer, std::span<const graph_row> rows, const graph_layout& layout, std::string_view color, graph_render_ctx& render_ctx)
+	{
+		writer.begin(svg_width + 2 * svg_side_pad, layout.data_height + layout.date_height + 2 * svg_side_pad,
+			-(layout.text_width + svg_pad) - svg_side_pad, -svg_side_pad);
+
+		// y-axis
+		detail::add_player_names(writer, rows, color);
 
-		// actually add x-axis labels
-		detail::add_dates([&](std::string_view cur_line) { svg_data += cur_line; }, first_time, last_time,
-			data_height, data_area_width - (data_labels_width + svg_pad), color);
+		// x-axis
+		if (layout.date_height != 0)
+			{ writer.line(0, layout.data_height, layout.axis_width, layout.data_height, color, 2); }
+		const double bars_width = layout.data_area_width - (layout.data_labels_width + svg_pad);
+		detail::add_dates(writer, layout.first_time, layout.last_time, layout.data_height, bars_width, color, render_ctx.get_timezone());
 
 		// add data labels (hhh:mm:ss)
-		detail::add_data_labels([&](std::string_view cur_line) { svg_data += cur_line; }, log_info, data_area_width, color);
+		detail::add_data_labels(writer, rows, layout.data_area_width, color);
 
 		// data bars
-		detail::add_data_bars([&](std::string_view cur_line) { svg_data += cur_line; }, log_info, first_time, last_time, data_area_width - (data_labels_width + svg_pad));
-
-		svg_data += svg_footer;
+		detail::add_data_bars(writer, rows, layout.first_time, layout.last_time, bars_width, render_ctx);
+	}
 
+	// draw a graph with draw(writer) for each format that is returned (see create_graph)
+	// the png is drawn directly, the svg is only created if it is returned
+	template<bool return_svg, bool render_to_png>
+	inline auto write_graph(const graph_options& options, auto&& draw)
+	{
+		// counted first so the document is allocated once. counting costs much less than formatting the numbers
+		const auto make_svg = [&]()
+		{
+			QC_TRACE_SCOPE("write svg");
+			graph_size_estimator estimator;
+			draw(estimator);
+			svg_graph_writer writer(options.row_paths, options.color == adaptive_color, estimator.svg_bytes(options.row_paths));
+			draw(writer);
+			return writer.finish();
+		};
 
 		if constexpr (render_to_png)
 		{
-			const auto svg_doc = lunasvg::Document::loadFromData(svg_data.data(), svg_data.size());
-			if (!svg_doc)
-				{ throw std::runtime_error(std::format("SVG Document loading failed. SVG data:\n{}", svg_data)); }
-			const auto svg_bmp = svg_doc->renderToBitmap(svg_doc->width() * 2, svg_doc->height() * 2);
-			if (svg_bmp.isNull())
-				{ throw std::runtime_error("SVG rendering to bitmap failed."); }
-		
-			// expects function pointer so capturing lambda won't work
+			// the scale is chosen before rasterizing, so a render is only done if its result can be used
+			float scale = (options.png_scale > 0) ? options.png_scale : png_graph_writer::scale;
+			if constexpr (!return_svg)
+			{
+				if (options.png_max_bytes != 0 || options.png_max_surface_bytes != 0)
+				{
+					graph_size_estimator estimator;
+					draw(estimator);
+					if (options.png_max_surface_bytes != 0)
+						{ scale = estimator.fit_surface_scale(options.png_max_surface_bytes, scale); }
+					if (scale != 0 && options.png_max_bytes != 0)
+						{ scale = estimator.fit_scale(options.png_max_bytes, scale); }
+					if (scale == 0)
+						{ return make_svg(); }
+				}
+			}
 			std::string png_data;
-			detail::png_data_ptr = &png_data;
-			const auto b = svg_bmp.writeToPng([](void* /*unused*/, void* data, int size) { (*detail::png_data_ptr).append(static_cast<const char*>(data), size); }, nullptr);
-			detail::png_data_ptr = nullptr;  // for sanity, I guess
-			if (!b)
-				{ throw std::runtime_error("Bitmap writing to PNG failed."); }
-		
+			{
+				const render_arena::scope arena;
+				png_graph_writer writer(options.png_compression_level, scale, options.theme_color, arena.resource());
+				{
+					QC_TRACE_SCOPE("rasterize png");
+					// the layers are drawn in the other order than when drawing everything at once, but labels and bars don't overlap
+					const bool share_layer = (options.layer_key != 0 && options.render_ctx != nullptr && options.color == adaptive_color);
+					const std::uint64_t layer_key = hash_combine(options.layer_key, std::bit_cast<std::uint32_t>(scale));
+					const auto layer = share_layer ? options.render_ctx->get_png_layers().find(layer_key) : nullptr;
+					if (layer)
+					{
+						writer.set_base(layer.get());
+						writer.set_layer(png_graph_writer::layer::theme);
+						draw(writer);
+					}
+					else if (share_layer)
+					{
+						writer.set_layer(png_graph_writer::layer::shared);
+						draw(writer);
+						options.render_ctx->get_png_layers().insert(layer_key, writer.copy_surface());
+						writer.set_layer(png_graph_writer::layer::theme);
+						draw(writer);
+					}
+					else
+						{ draw(writer); }
+					writer.rasterize();
+				}
+				QC_TRACE_SCOPE("encode png");
+				if (!return_svg && options.png_variants != nullptr && scale == png_graph_writer::scale)
+					{ png_data = writer.finish(*options.png_variants); }
+				else
+					{ png_data = writer.finish(); }
+			}
+
 			if constexpr (return_svg)  // svg and png
-				{ return std::make_pair(svg_data, png_data); }
+				{ return std::make_pair(make_svg(), png_data); }
+			else if (options.png_max_bytes != 0 && png_data.size() > options.png_max_bytes)  // estimated too small
+			{
+				if (options.png_variants != nullptr)
+					{ options.png_variants->clear(); }
+				return make_svg();
+			}
 			else  // png only
 				{ return png_data; }
 		}
 		else  // svg only
-			{ return svg_data; }
+			{ return make_svg(); }
+	}
+
+	// the bars are rasterized once per version of the data and reused by the other theme, which only draws its labels over them
+	// (see graph_options::layer_key). they aren't reused by later versions: the time axis spans the data, and ends at `now` while
+	// players are online, so every bar moves
+	// @param rows  in the order they are shown (see sort_graph_rows)
+	template<bool return_svg, bool render_to_png>
+	inline auto create_graph(std::span<const graph_row> rows, const graph_options& options, graph_render_ctx& render_ctx,
+		std::chrono::system_clock::time_point now = std::chrono::system_clock::now())
+	{
+		const graph_layout layout = [&]()
+		{
+			QC_TRACE_SCOPE("get_graph_layout");
+			return get_graph_layout(rows, now, render_ctx.get_timezone());
+		}();
+		return write_graph<return_svg, render_to_png>(options, [&](auto& writer) { draw_graph(writer, rows, layout, options.color, render_ctx); });
 	}
 }
 
 // @tparam return_svg  whether to return svg data
 // @tparam render_to_png  whether to return rendered png data
-// @throws std::runtime_error if bounding box calculation or png rendering fails
+// @throws std::runtime_error if png rendering fails
 // @return pair of svg and png data if return_svg and render_to_png are both true, otherwise return single string containing data
 template<bool return_svg = true, bool render_to_png = false>
-inline auto create_graph(const log_data_t& parse_data, std::string_view color = "black")
+inline auto create_graph(const log_data_t& parse_data, const graph_options& options = {})
 {
 	static_assert(return_svg || render_to_png, "Graph must be either saved to svg or png");
-	
-	std::vector<std::pair<log_data_t::key_type, log_data_t::mapped_type>> log_info(parse_data.begin(), parse_data.end());
-	std::ranges::sort(log_info, std::ranges::greater(), [](const auto& elem) { return elem.second.second.second; });
-	return detail::create_graph<return_svg, render_to_png>(log_info, color);
+
+	std::string combined_name;
+	std::optional<graph_render_ctx> temp_render_ctx;
+	graph_render_ctx& render_ctx = options.render_ctx ? *options.render_ctx : temp_render_ctx.emplace();
+	const detail::render_arena::scope arena;
+	detail::graph_rows rows = detail::get_graph_rows({}, parse_data, options.range, render_ctx, arena.resource());
+	detail::remove_empty_rows(rows);
+	{
+		QC_TRACE_SCOPE("select_graph_rows");
+		detail::select_graph_rows(rows, options.row_limit, combined_name);
+	}
+	return detail::create_graph<return_svg, render_to_png>(rows, options, render_ctx);
 }
 
+// same as above, for data split into committed history and data that has not been committed yet
 // this overload will ensure currently online players are accounted for; the graph will extend to the current time (when the function is called)
-// @tparam return_svg  whether to return svg data
-// @tparam render_to_png  whether to return rendered png data
-// @throws std::runtime_error if trying to remove unknown player, bounding box calculation fails, or png rendering fails
-// @return pair of svg and png data if return_svg and render_to_png are both true, otherwise return single string containing data
+// the data is read in place, so it must not be modified while the graph is created
+// @param history  sessions from log files that have been fully read
+// @param recent  sessions parsed since history was last committed to
+// @throws std::runtime_error if an online player has no sessions or png rendering fails
 template<bool return_svg = true, bool render_to_png = false>
-inline auto create_graph(const log_data_t& parse_data, const parse_ctx_t& parse_ctx, std::string_view color = "black")
+inline auto create_graph(const session_history& history, const log_data_t& recent, const parse_ctx_t& parse_ctx, const graph_options& options = {})
 {
 	static_assert(return_svg || render_to_png, "Graph must be either saved to svg or png");
 
-	std::vector<std::pair<log_data_t::key_type, log_data_t::mapped_type>> log_info(parse_data.begin(), parse_data.end());
-	// make currently online players leave
+	std::string combined_name;
+	std::optional<graph_render_ctx> temp_render_ctx;
+	graph_render_ctx& render_ctx = options.render_ctx ? *options.render_ctx : temp_render_ctx.emplace();
+	// the rows and everything drawn from them are freed when the graph is made (see render_arena)
+	const detail::render_arena::scope arena;
+	detail::graph_rows rows = detail::get_graph_rows(history.get_segments(), recent, options.range, render_ctx, arena.resource());
 	const auto now = std::chrono::system_clock::now();
-	for (const auto& [cur_name, cur_info] : parse_ctx.player_info)
+	detail::add_online_sessions(rows, parse_ctx, options.range, now);
+	detail::remove_empty_rows(rows);
 	{
-		const auto& [uuid, join_time] = cur_info;
-		if (uuid && join_time)
-		{
-			// log_info should already be sorted by uuid since parse_data is a sorted map
-			const auto it = std::ranges::lower_bound(log_info, uuid.value(), {}, [](const auto& elem) { return elem.first; });
-			if (it == log_info.end())
-				{ throw std::runtime_error(std::format("Could not find UUID {} in parse_data while creating graph", uuid.value())); }
-			auto& [names, play_info] = (*it).second;
-			if (names.empty() || names.back() != cur_name)
-				{ names.emplace_back(cur_name); }
-			const auto playtime = now - join_time.value();
-			auto& [play_sessions, total_playtime] = play_info;
-			play_sessions.emplace_back(join_time.value(), playtime);
-			total_playtime += playtime;
-		}
+		QC_TRACE_SCOPE("select_graph_rows");
+		detail::select_graph_rows(rows, options.row_limit, combined_name);
 	}
-	std::ranges::sort(log_info, std::ranges::greater(), [](const auto& elem) { return elem.second.second.second; });
-	return detail::create_graph<return_svg, render_to_png>(log_info, color, now);
+	return detail::create_graph<return_svg, render_to_png>(rows, options, render_ctx, now);
 }
 
+// same as above, without history
+template<bool return_svg = true, bool render_to_png = false>
+inline auto create_graph(const log_data_t& parse_data, const parse_ctx_t& parse_ctx, const graph_options& options = {})
+	{ return create_graph<return_svg, render_to_png>(session_history(), parse_data, parse_ctx, options); }
+
 #endif
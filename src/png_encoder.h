@@ -0,0 +1,772 @@
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <libdeflate.h>
+#include <plutovg.h>
+
+#include "resource_governor.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_ENCODER_SSE2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define PNG_ENCODER_NEON
+#include <arm_neon.h>
+#endif
+
+// png encoder for rendered graphs, compressing with libdeflate
+// graphs only have a few flat colors (plus antialiasing), so an indexed-color (palette) image is written when there are at most 256 colors
+
+namespace detail
+{
+	// pixel buffers for rasterizing and encoding pngs, reused between renders
+	// a large graph is tens of MB at 2x. allocating that for every render maps new pages, faults and zeroes them, and unmaps them
+	// again right after encoding, which also fragments the heap of a long running process
+	// buffers are kept at the largest size recently asked for, so they fit the next render of the same graphs
+	class pixel_buffer_pool
+	{
+	public:
+		// a buffer taken from the pool, returned to it when destroyed
+		class buffer
+		{
+		private:
+			friend class pixel_buffer_pool;
+			std::unique_ptr<unsigned char[]> data_;
+			std::size_t capacity = 0;
+
+		public:
+			buffer() = default;
+			buffer(buffer&&) = default;
+			buffer& operator=(buffer&& other) noexcept
+			{
+				if (this != &other)
+				{
+					get().release(std::move(*this));
+					data_ = std::move(other.data_);
+					capacity = other.capacity;
+				}
+				return *this;
+			}
+			~buffer()
+				{ get().release(std::move(*this)); }
+
+			// contents are whatever the last user left
+			[[nodiscard]] unsigned char* data() const noexcept
+				{ return data_.get(); }
+		};
+
+	private:
+		static constexpr std::size_t max_pooled = 4;  // a surface and an rgba copy for each of the two render threads
+		static constexpr std::size_t recent_count = 16;  // requests the size is remembered for
+
+		std::mutex mutex;
+		std::vector<std::pair<std::unique_ptr<unsigned char[]>, std::size_t>> pooled;  // data and capacity
+		std::array<std::size_t, recent_count> recent{};  // sizes of the last requests
+		std::size_t next_recent = 0;
+
+		void release(buffer&& buf)
+		{
+			if (!buf.data_)
+				{ return; }
+			std::unique_ptr<unsigned char[]> data = std::move(buf.data_);
+			std::scoped_lock lock(mutex);
+			// a buffer for a graph that hasn't been rendered lately is freed rather than kept at that size
+			if (pooled.size() < max_pooled && buf.capacity <= std::ranges::max(recent))
+				{ pooled.emplace_back(std::move(data), buf.capacity); }
+		}
+
+	public:
+		[[nodiscard]] static pixel_buffer_pool& get()
+		{
+			static pixel_buffer_pool instance;
+			return instance;
+		}
+
+		// @return buffer of at least `size` bytes, with unspecified contents
+		[[nodiscard]] buffer acquire(std::size_t size)
+		{
+			buffer res;
+			{
+				std::scoped_lock lock(mutex);
+				recent[next_recent] = size;
+				next_recent = (next_recent + 1) % recent_count;
+				// the smallest one that fits
+				auto best = pooled.end();
+				for (auto it = pooled.begin(); it != pooled.end(); ++it)
+				{
+					if (it->second >= size && (best == pooled.end() || it->second < best->second))
+						{ best = it; }
+				}
+				if (best != pooled.end())
+				{
+					std::tie(res.data_, res.capacity) = std::move(*best);
+					pooled.erase(best);
+					return res;
+				}
+				// a larger graph rendered recently will likely be rendered again, so this one is made big enough for it too
+				size = std::max(size, std::ranges::max(recent));
+			}
+			res.data_ = std::make_unique_for_overwrite<unsigned char[]>(size);
+			res.capacity = size;
+			return res;
+		}
+
+		// @return bytes of the buffers in the pool (not the ones in use)
+		[[nodiscard]] std::size_t pooled_bytes()
+		{
+			std::scoped_lock lock(mutex);
+			std::size_t res = 0;
+			for (const auto& [data, capacity] : pooled)
+				{ res += capacity; }
+			return res;
+		}
+	};
+
+	// threads that help rasterize and filter the bands of a large image in parallel (see run)
+	// they are kept between renders instead of started for each one, so their thread-local caches (font faces, label sprites) are too
+	class band_pool
+	{
+	private:
+		struct job_t
+		{
+			const std::function<void(std::size_t)>& func;
+			std::size_t count;
+			std::size_t next = 0;  // band to start next
+			std::size_t done = 0;
+			std::exception_ptr error;  // of the first band that threw
+		};
+
+		static constexpr unsigned max_threads = 7;
+
+		std::mutex mutex;
+		std::condition_variable job_cv, done_cv;
+		std::deque<job_t*> jobs;  // with bands that haven't been started
+		bool stopping = false;
+		std::vector<std::jthread> workers;
+
+		band_pool()
+		{
+			const unsigned num_threads = std::min(std::max(std::thread::hardware_concurrency(), 1u) - 1, max_threads);
+			for (unsigned i = 0; i < num_threads; i++)
+				{ workers.emplace_back([this]() { worker_loop(); }); }
+		}
+
+		// run bands of `job` until none are left to start. `lock` is held except while running a band
+		void run_bands(job_t& job, std::unique_lock<std::mutex>& lock)
+		{
+			while (job.next < job.count)
+			{
+				const std::size_t band = job.next++;
+				if (job.next == job.count)
+					{ std::erase(jobs, &job); }
+				lock.unlock();
+				std::exception_ptr error;
+				try
+					{ job.func(band); }
+				catch (...)
+					{ error = std::current_exception(); }
+				lock.lock();
+				if (error && !job.error)
+					{ job.error = error; }
+				if (++job.done == job.count)
+					{ done_cv.notify_all(); }
+			}
+		}
+
+		void worker_loop()
+		{
+			enter_render_thread();
+			std::unique_lock lock(mutex);
+			while (true)
+			{
+				job_cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping)
+					{ return; }
+				run_bands(*jobs.front(), lock);
+			}
+		}
+
+	public:
+		band_pool(const band_pool&) = delete;
+		band_pool& operator=(const band_pool&) = delete;
+		~band_pool()
+		{
+			{
+				std::scoped_lock lock(mutex);
+				stopping = true;
+			}
+			job_cv.notify_all();
+		}
+
+		[[nodiscard]] static band_pool& get()
+		{
+			static band_pool instance;
+			return instance;
+		}
+
+		// @return number of bands to split `rows` into: each at least `min_rows`, and at most one for each thread and the caller
+		[[nodiscard]] std::size_t bands_for(int rows, int min_rows) const noexcept
+			{ return std::clamp(static_cast<std::size_t>(std::max(rows / min_rows, 1)), std::size_t(1), workers.size() + 1); }
+
+		// @return first row of `band` and the row after it, when `rows` are split into `count` bands
+		[[nodiscard]] static std::pair<int, int> band_rows(int rows, std::size_t band, std::size_t count) noexcept
+		{
+			const auto row = [rows, count](std::size_t i) { return static_cast<int>(static_cast<std::size_t>(rows) * i / count); };
+			return { row(band), row(band + 1) };
+		}
+
+		// call `func` with each band index in [0, count), on the calling thread and any idle pool threads, and wait for all of them
+		// the caller runs bands too, so this finishes even if every pool thread is busy with another image
+		// @throws the first exception a band threw
+		void run(std::size_t count, const std::function<void(std::size_t)>& func)
+		{
+			if (count == 0)
+				{ return; }
+			job_t job{ func, count };
+			std::unique_lock lock(mutex);
+			if (count > 1)
+			{
+				jobs.push_back(&job);
+				job_cv.notify_all();
+			}
+			run_bands(job, lock);
+			done_cv.wait(lock, [&job]() { return job.done == job.count; });
+			if (job.error)
+				{ std::rethrow_exception(job.error); }
+		}
+	};
+
+	struct libdeflate_compressor_deleter
+	{
+		void operator()(libdeflate_compressor* compressor) const noexcept
+			{ libdeflate_free_compressor(compressor); }
+	};
+
+	struct plutovg_surface_deleter
+	{
+		void operator()(plutovg_surface_t* surface) const noexcept
+			{ plutovg_surface_destroy(surface); }
+	};
+	using surface_ptr = std::unique_ptr<plutovg_surface_t, plutovg_surface_deleter>;
+
+	// box filter each 2x2 block of `surface` into one pixel (an odd last row or column is dropped)
+	// premultiplied channels can be averaged directly. rows are averaged first, then columns, each rounding up like _mm_avg_epu8,
+	// so the vectorized and scalar loops give the same result
+	// @throws std::runtime_error if the surface can't be created
+	// @return surface of half the width and height (at least 1x1)
+	inline surface_ptr downsample_surface_half(const plutovg_surface_t* surface)
+	{
+		const int width = std::max(plutovg_surface_get_width(surface) / 2, 1), height = std::max(plutovg_surface_get_height(surface) / 2, 1);
+		surface_ptr res(plutovg_surface_create(width, height));
+		if (!res)
+			{ throw std::runtime_error("Graph surface creation failed."); }
+		// a 1 pixel wide or high surface is only "downsampled" to itself along that side
+		const int src_width = plutovg_surface_get_width(surface), src_height = plutovg_surface_get_height(surface);
+		const int src_stride = plutovg_surface_get_stride(surface), dest_stride = plutovg_surface_get_stride(res.get());
+		const unsigned char* src = plutovg_surface_get_data(surface);
+		unsigned char* dest = plutovg_surface_get_data(res.get());
+		const auto avg = [](unsigned a, unsigned b) { return static_cast<unsigned char>((a + b + 1) / 2); };
+		for (int y = 0; y < height; y++)
+		{
+			const unsigned char* row0 = src + static_cast<std::size_t>(src_stride) * std::min(2 * y, src_height - 1);
+			const unsigned char* row1 = src + static_cast<std::size_t>(src_stride) * std::min(2 * y + 1, src_height - 1);
+			unsigned char* out = dest + static_cast<std::size_t>(dest_stride) * y;
+			int x = 0;
+			if (src_width >= 2)
+			{
+#if defined(PNG_ENCODER_SSE2)
+				// 8 pixels of each row to 4
+				for (; x + 4 <= width; x += 4)
+				{
+					const __m128i lo = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x)),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x)));
+					const __m128i hi = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x + 16)),
+						_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x + 16)));
+					const __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+					const __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x), _mm_avg_epu8(_mm_castps_si128(even), _mm_castps_si128(odd)));
+				}
+#elif defined(PNG_ENCODER_NEON)
+				for (; x + 4 <= width; x += 4)
+				{
+					const uint8x16_t lo = vrhaddq_u8(vld1q_u8(row0 + 8 * x), vld1q_u8(row1 + 8 * x));
+					const uint8x16_t hi = vrhaddq_u8(vld1q_u8(row0 + 8 * x + 16), vld1q_u8(row1 + 8 * x + 16));
+					const uint32x4x2_t pixels = vuzpq_u32(vreinterpretq_u32_u8(lo), vreinterpretq_u32_u8(hi));
+					vst1q_u8(out + 4 * x, vrhaddq_u8(vreinterpretq_u8_u32(pixels.val[0]), vreinterpretq_u8_u32(pixels.val[1])));
+				}
+#endif
+			}
+			for (; x < width; x++)
+			{
+				const int left = std::min(2 * x, src_width - 1), right = std::min(2 * x + 1, src_width - 1);
+				for (int c = 0; c < 4; c++)
+					{ out[4 * x + c] = avg(avg(row0[4 * left + c], row1[4 * left + c]), avg(row0[4 * right + c], row1[4 * right + c])); }
+			}
+		}
+		return res;
+	}
+
+	// pixels of a row or column that a rectangle covers the same fraction of
+	struct pixel_span
+	{
+		int begin, end;
+		float coverage;
+	};
+
+	// the pixels covered by [begin, end) along one axis, clipped to [0, limit): a partially covered pixel at each end, and fully covered ones between
+	// @param out  spans are appended to it. a partially covered pixel shared with its last span (adjacent rectangles) gets the sum
+	//   of both coverages, like the non-zero fill of both as one path
+	template<typename Allocator>
+	inline void append_pixel_spans(float begin, float end, int limit, std::vector<pixel_span, Allocator>& out)
+	{
+		if (!(begin < end))
+			{ return; }  // also NaN
+		begin = std::clamp(begin, 0.f, static_cast<float>(limit));
+		end = std::clamp(end, begin, static_cast<float>(limit));
+		const auto add = [&out](int span_begin, int span_end, float coverage)
+		{
+			if (span_begin >= span_end || coverage <= 0)
+				{ return; }
+			if (span_end == span_begin + 1 && !out.empty() && out.back().begin == span_begin && out.back().end == span_end)
+				{ out.back().coverage = std::min(out.back().coverage + coverage, 1.f); }
+			else
+				{ out.emplace_back(span_begin, span_end, std::min(coverage, 1.f)); }
+		};
+		const int full_begin = static_cast<int>(std::ceil(begin)), full_end = static_cast<int>(std::floor(end));
+		if (full_begin > full_end)  // within one pixel
+		{
+			add(full_end, full_begin, end - begin);
+			return;
+		}
+		add(full_begin - 1, full_begin, static_cast<float>(full_begin) - begin);
+		add(full_begin, full_end, 1);
+		add(full_end, full_end + 1, end - static_cast<float>(full_end));
+	}
+
+	// multiply each channel of premultiplied argb `x` by `a`/255, like plutovg
+	[[nodiscard]] constexpr std::uint32_t byte_mul(std::uint32_t x, std::uint32_t a) noexcept
+	{
+		std::uint32_t t = (x & 0xff00ff) * a;
+		t = ((t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8) & 0xff00ff;
+		x = ((x >> 8) & 0xff00ff) * a;
+		x = (x + ((x >> 8) & 0xff00ff) + 0x800080) & 0xff00ff00;
+		return x | t;
+	}
+
+	// premultiplied argb of `color`, like plutovg fills it
+	[[nodiscard]] inline std::uint32_t premultiply_color(const plutovg_color_t& color) noexcept
+	{
+		const auto alpha = static_cast<std::uint32_t>(std::lround(color.a * 255));
+		const auto channel = [alpha](float c) { return static_cast<std::uint32_t>(std::lround(c * static_cast<float>(alpha))); };
+		return (alpha << 24) | (channel(color.r) << 16) | (channel(color.g) << 8) | channel(color.b);
+	}
+
+	// fill axis-aligned rectangles directly instead of through plutovg's rasterizer, which builds and sorts the cells of a path
+	// each pixel in `rows` x `columns` is blended (source over) with `color` times the product of their coverage, the same as
+	// plutovg's antialiasing of the rectangles' edges. fully covered pixels of an opaque color are only stored
+	// @param color  premultiplied argb (see premultiply_color)
+	inline void fill_pixel_spans(plutovg_surface_t* surface, std::uint32_t color, std::span<const pixel_span> rows, std::span<const pixel_span> columns)
+	{
+		const int stride = plutovg_surface_get_stride(surface);
+		unsigned char* data = plutovg_surface_get_data(surface);
+#if defined(PNG_ENCODER_SSE2)
+		const __m128i fill = _mm_set1_epi32(static_cast<int>(color));
+#elif defined(PNG_ENCODER_NEON)
+		const uint32x4_t fill = vdupq_n_u32(color);
+#endif
+		for (const pixel_span& row_span : rows)
+		{
+			for (int y = row_span.begin; y < row_span.end; y++)
+			{
+				auto* row = reinterpret_cast<std::uint32_t*>(data + static_cast<std::size_t>(stride) * y);
+				for (const pixel_span& column_span : columns)
+				{
+					const auto alpha = static_cast<std::uint32_t>(std::lround(row_span.coverage * column_span.coverage * 255));
+					int x = column_span.begin;
+					if (alpha == 255 && (color >> 24) == 255)
+					{
+#if defined(PNG_ENCODER_SSE2)
+						for (; x + 4 <= column_span.end; x += 4)
+							{ _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), fill); }
+#elif defined(PNG_ENCODER_NEON)
+						for (; x + 4 <= column_span.end; x += 4)
+							{ vst1q_u32(row + x, fill); }
+#endif
+						for (; x < column_span.end; x++)
+							{ row[x] = color; }
+					}
+					else if (alpha != 0)
+					{
+						const std::uint32_t src = (alpha == 255) ? color : byte_mul(color, alpha);
+						const std::uint32_t inv_alpha = 255 - (src >> 24);
+						for (; x < column_span.end; x++)
+							{ row[x] = src + byte_mul(row[x], inv_alpha); }
+					}
+				}
+			}
+		}
+	}
+
+	// blend `color` into `surface` with the coverage of each pixel of `mask`, like plutovg's fill (source over)
+	// @param color  premultiplied argb (see premultiply_color)
+	// @param mask  `width` x `height` coverage values, placed with its top left pixel at (left, top) and clipped to the surface
+	inline void blend_mask(plutovg_surface_t* surface, std::uint32_t color, std::span<const std::uint8_t> mask, int width, int height, int left, int top)
+	{
+		const int stride = plutovg_surface_get_stride(surface);
+		unsigned char* data = plutovg_surface_get_data(surface);
+		const int x_begin = std::max(left, 0), x_end = std::min(left + width, plutovg_surface_get_width(surface));
+		const int y_begin = std::max(top, 0), y_end = std::min(top + height, plutovg_surface_get_height(surface));
+		const bool opaque = (color >> 24) == 255;
+		for (int y = y_begin; y < y_end; y++)
+		{
+			auto* row = reinterpret_cast<std::uint32_t*>(data + static_cast<std::size_t>(stride) * y);
+			const std::uint8_t* mask_row = mask.data() + static_cast<std::size_t>(width) * (y - top) - left;
+			for (int x = x_begin; x < x_end; x++)
+			{
+				const std::uint32_t alpha = mask_row[x];
+				if (alpha == 255 && opaque)
+					{ row[x] = color; }
+				else if (alpha != 0)
+				{
+					const std::uint32_t src = byte_mul(color, alpha);
+					row[x] = src + byte_mul(row[x], 255 - (src >> 24));
+				}
+			}
+		}
+	}
+
+	inline void png_append_u32(std::string& out, std::uint32_t val)
+	{
+		const std::array<char, 4> bytes = { static_cast<char>(val >> 24), static_cast<char>(val >> 16), static_cast<char>(val >> 8), static_cast<char>(val) };
+		out.append(bytes.data(), bytes.size());
+	}
+
+	// @param type  4 character chunk type
+	inline void png_append_chunk(std::string& out, std::string_view type, std::string_view data)
+	{
+		png_append_u32(out, static_cast<std::uint32_t>(data.size()));
+		out += type;
+		out += data;
+		const std::uint32_t type_crc = libdeflate_crc32(0, type.data(), type.size());
+		// libdeflate_crc32 returns 0 for a null buffer (the data of an empty chunk such as IEND) rather than the crc it's given
+		png_append_u32(out, data.empty() ? type_crc : libdeflate_crc32(type_crc, data.data(), data.size()));
+	}
+
+	// apply the png filter that gives the smallest sum of absolute (signed) differences to this row,
+	// which is the heuristic recommended by the png spec for truecolor images
+	// @param prev  previous unfiltered row (all zero for the first row)
+	// @param scratch  at least `size` bytes
+	// @param out  filter type followed by the filtered row
+	inline void png_filter_row(const unsigned char* row, const unsigned char* prev, std::size_t size, std::size_t bpp, unsigned char* scratch, unsigned char* out)
+	{
+		// without branches (p - a = b - c, etc.)
+		const auto paeth = [](int a, int b, int c)
+		{
+			const int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+			const int bc = (pb <= pc) ? b : c;
+			return (pa <= pb && pa <= pc) ? a : bc;
+		};
+		// each filter is a separate loop so they can be vectorized
+		const auto apply = [&](int filter, unsigned char* dest)
+		{
+			switch (filter)
+			{
+			case 0:
+				std::memcpy(dest, row, size);
+				break;
+			case 1:
+				std::memcpy(dest, row, bpp);
+				for (std::size_t i = bpp; i < size; i++)
+					{ dest[i] = row[i] - row[i - bpp]; }
+				break;
+			case 2:
+				for (std::size_t i = 0; i < size; i++)
+					{ dest[i] = row[i] - prev[i]; }
+				break;
+			case 3:
+				for (std::size_t i = 0; i < bpp; i++)
+					{ dest[i] = row[i] - prev[i] / 2; }
+				for (std::size_t i = bpp; i < size; i++)
+					{ dest[i] = row[i] - (row[i - bpp] + prev[i]) / 2; }
+				break;
+			default:
+				for (std::size_t i = 0; i < bpp; i++)
+					{ dest[i] = row[i] - prev[i]; }
+				for (std::size_t i = bpp; i < size; i++)
+					{ dest[i] = row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]); }
+				break;
+			}
+			std::uint64_t sum = 0;
+			for (std::size_t i = 0; i < size; i++)
+				{ sum += std::abs(static_cast<signed char>(dest[i])); }
+			return sum;
+		};
+
+		int best_filter = 0;
+		std::uint64_t best_sum = apply(0, out + 1);
+		for (int filter = 1; filter < 5; filter++)
+		{
+			const std::uint64_t sum = apply(filter, scratch);
+			if (sum < best_sum)
+			{
+				best_sum = sum;
+				best_filter = filter;
+				std::memcpy(out + 1, scratch, size);
+			}
+		}
+		out[0] = static_cast<unsigned char>(best_filter);
+	}
+
+	// @param rgba  non-premultiplied rgba pixels, `stride` bytes per row
+	// @return colors (as rgba bytes in memory order) and index of each color, or empty if there are more than 256 colors
+	//         colors that aren't opaque are first, so the tRNS chunk can stop after them
+	inline std::vector<std::uint32_t> png_find_palette(const unsigned char* rgba, int width, int height, int stride, std::unordered_map<std::uint32_t, std::uint8_t>& indices)
+	{
+		std::vector<std::uint32_t> colors;
+		indices.clear();
+		for (int y = 0; y < height; y++)
+		{
+			const unsigned char* row = rgba + static_cast<std::size_t>(stride) * y;
+			std::uint32_t last = 0;
+			bool has_last = false;
+			for (int x = 0; x < width; x++)
+			{
+				std::uint32_t color;
+				std::memcpy(&color, row + 4 * x, 4);
+				if (has_last && color == last)
+					{ continue; }  // usually in long runs
+				last = color;
+				has_last = true;
+				if (indices.contains(color))
+					{ continue; }
+				if (colors.size() == 256)
+					{ return {}; }
+				indices.emplace(color, 0);
+				colors.push_back(color);
+			}
+		}
+		std::ranges::stable_partition(colors, [](std::uint32_t color) { return reinterpret_cast<const unsigned char*>(&color)[3] != 255; });
+		for (std::size_t i = 0; i < colors.size(); i++)
+			{ indices[colors[i]] = static_cast<std::uint8_t>(i); }
+		return colors;
+	}
+
+	// @param level  libdeflate compression level (0-12)
+	// @throws std::runtime_error if compression fails
+	// @return zlib stream of `data`, for an IDAT (or fdAT) chunk
+	inline std::string png_compress(std::span<const unsigned char> data, int level)
+	{
+		const std::unique_ptr<libdeflate_compressor, libdeflate_compressor_deleter> compressor(libdeflate_alloc_compressor(std::clamp(level, 0, 12)));
+		if (!compressor)
+			{ throw std::runtime_error("PNG compressor allocation failed."); }
+		std::string compressed(libdeflate_zlib_compress_bound(compressor.get(), data.size()), '\0');
+		const std::size_t compressed_size = libdeflate_zlib_compress(compressor.get(), data.data(), data.size(), compressed.data(), compressed.size());
+		if (compressed_size == 0)
+			{ throw std::runtime_error("PNG compression failed."); }
+		compressed.resize(compressed_size);
+		return compressed;
+	}
+
+	inline constexpr int png_min_band_rows = 256;  // smaller images aren't split into bands (see band_pool)
+
+	// @param level  libdeflate compression level (0-12, higher is smaller and slower)
+	// @throws std::runtime_error if compression fails
+	// @return png data
+	inline std::string encode_png(const plutovg_surface_t* surface, int level)
+	{
+		const int width = plutovg_surface_get_width(surface);
+		const int height = plutovg_surface_get_height(surface);
+		const int stride = plutovg_surface_get_stride(surface);
+		const std::size_t src_size = static_cast<std::size_t>(stride) * height;
+		// conversion and filtering of each row only depends on the surface, so bands of a large image are done in parallel
+		band_pool& bands = band_pool::get();
+		const std::size_t num_bands = bands.bands_for(height, png_min_band_rows);
+		// surfaces are premultiplied argb, png isn't premultiplied
+		pixel_buffer_pool::buffer rgba = pixel_buffer_pool::get().acquire(src_size);
+		bands.run(num_bands, [&](std::size_t band)
+		{
+			const auto [begin, end] = band_pool::band_rows(height, band, num_bands);
+			const std::size_t offset = static_cast<std::size_t>(stride) * begin;
+			plutovg_convert_argb_to_rgba(rgba.data() + offset, plutovg_surface_get_data(surface) + offset, width, end - begin, stride);
+		});
+
+		std::unordered_map<std::uint32_t, std::uint8_t> indices;
+		const std::vector<std::uint32_t> palette = png_find_palette(rgba.data(), width, height, stride, indices);
+		const bool indexed = !palette.empty();
+		const int bit_depth = !indexed ? 8 : (palette.size() <= 2) ? 1 : (palette.size() <= 4) ? 2 : (palette.size() <= 16) ? 4 : 8;
+		const std::size_t row_size = indexed ? (static_cast<std::size_t>(width) * bit_depth + 7) / 8 : static_cast<std::size_t>(width) * 4;
+
+		// filter type followed by filtered data for each row
+		std::vector<unsigned char> filtered((row_size + 1) * height);
+		const std::vector<unsigned char> zero_row(row_size);
+		bands.run(num_bands, [&](std::size_t band)
+		{
+			const auto [begin, end] = band_pool::band_rows(height, band, num_bands);
+			if (indexed)
+			{
+				// the spec recommends no filtering for palette images, since indices don't have meaningful differences
+				const int pixels_per_byte = 8 / bit_depth;
+				for (int y = begin; y < end; y++)
+				{
+					const unsigned char* row = rgba.data() + static_cast<std::size_t>(stride) * y;
+					unsigned char* out = filtered.data() + (row_size + 1) * y + 1;
+					for (int x = 0; x < width; x++)
+					{
+						std::uint32_t color;
+						std::memcpy(&color, row + 4 * x, 4);
+						const int shift = 8 - bit_depth * (x % pixels_per_byte + 1);
+						out[x / pixels_per_byte] |= static_cast<unsigned char>(indices.find(color)->second << shift);
+					}
+				}
+			}
+			else
+			{
+				std::vector<unsigned char> scratch(row_size);
+				for (int y = begin; y < end; y++)
+				{
+					const unsigned char* row = rgba.data() + static_cast<std::size_t>(stride) * y;
+					const unsigned char* prev = (y == 0) ? zero_row.data() : row - stride;
+					png_filter_row(row, prev, row_size, 4, scratch.data(), filtered.data() + (row_size + 1) * y);
+				}
+			}
+		});
+		rgba = {};  // back to the pool for the next encode
+		const std::string compressed = png_compress(filtered, level);
+
+		std::string png = "\x89PNG\r\n\x1a\n";
+		std::string ihdr;
+		png_append_u32(ihdr, static_cast<std::uint32_t>(width));
+		png_append_u32(ihdr, static_cast<std::uint32_t>(height));
+		ihdr += static_cast<char>(bit_depth);
+		ihdr += static_cast<char>(indexed ? 3 : 6);  // color type: indexed or rgba
+		ihdr.append(3, '\0');  // compression, filter, and interlace methods
+		png_append_chunk(png, "IHDR", ihdr);
+		if (indexed)
+		{
+			std::string plte, trns;
+			for (const std::uint32_t color : palette)
+			{
+				const auto* bytes = reinterpret_cast<const char*>(&color);
+				plte.append(bytes, 3);
+				if (static_cast<unsigned char>(bytes[3]) != 255)
+					{ trns += bytes[3]; }
+			}
+			png_append_chunk(png, "PLTE", plte);
+			if (!trns.empty())
+				{ png_append_chunk(png, "tRNS", trns); }
+		}
+		png_append_chunk(png, "IDAT", compressed);
+		png_append_chunk(png, "IEND", {});
+		return png;
+	}
+
+	// animated png, written a frame at a time. a frame is only the rectangle of the image that changed since the one before,
+	// which replaces what was there, so the time and size of each frame depend on how much changed rather than on the size of the image
+	// frames are truecolor, since a palette would have to be shared by all of them
+	class apng_encoder
+	{
+	private:
+		std::string png = "\x89PNG\r\n\x1a\n";
+		int level;
+		std::uint32_t frames_added = 0;
+		std::uint32_t sequence = 0;  // of the next fcTL or fdAT chunk
+
+	public:
+		// @param num_frames  that will be added
+		// @param level  see encode_png
+		// @param num_plays  times the animation is played, 0 to loop it forever
+		apng_encoder(int width, int height, std::uint32_t num_frames, int level, std::uint32_t num_plays = 0) : level(level)
+		{
+			std::string ihdr;
+			png_append_u32(ihdr, static_cast<std::uint32_t>(width));
+			png_append_u32(ihdr, static_cast<std::uint32_t>(height));
+			ihdr += static_cast<char>(8);
+			ihdr += static_cast<char>(6);  // color type: rgba
+			ihdr.append(3, '\0');  // compression, filter, and interlace methods
+			png_append_chunk(png, "IHDR", ihdr);
+			std::string actl;
+			png_append_u32(actl, num_frames);
+			png_append_u32(actl, num_plays);
+			png_append_chunk(png, "acTL", actl);
+		}
+
+		// add the rectangle of `surface` (the size of the image) at `left`, `top` as the next frame. the first one must be all of it
+		// @param delay_ms  how long the frame is shown
+		// @throws std::runtime_error if compression fails
+		void add_frame(const plutovg_surface_t* surface, int left, int top, int frame_width, int frame_height, std::uint16_t delay_ms)
+		{
+			const int stride = plutovg_surface_get_stride(surface);
+			const std::size_t row_size = static_cast<std::size_t>(frame_width) * 4;
+			// surfaces are premultiplied argb, png isn't premultiplied
+			pixel_buffer_pool::buffer rgba = pixel_buffer_pool::get().acquire(static_cast<std::size_t>(stride) * frame_height);
+			plutovg_convert_argb_to_rgba(rgba.data(), plutovg_surface_get_data(surface) + static_cast<std::size_t>(stride) * top + static_cast<std::size_t>(left) * 4,
+				frame_width, frame_height, stride);
+			std::vector<unsigned char> filtered((row_size + 1) * frame_height);
+			const std::vector<unsigned char> zero_row(row_size);
+			std::vector<unsigned char> scratch(row_size);
+			for (int y = 0; y < frame_height; y++)
+			{
+				const unsigned char* row = rgba.data() + static_cast<std::size_t>(stride) * y;
+				png_filter_row(row, (y == 0) ? zero_row.data() : row - stride, row_size, 4, scratch.data(), filtered.data() + (row_size + 1) * y);
+			}
+			rgba = {};
+			const std::string compressed = png_compress(filtered, level);
+
+			std::string fctl;
+			png_append_u32(fctl, sequence++);
+			for (const int n : { frame_width, frame_height, left, top })
+				{ png_append_u32(fctl, static_cast<std::uint32_t>(n)); }
+			const std::array<char, 6> delay = { static_cast<char>(delay_ms >> 8), static_cast<char>(delay_ms), 0x03, static_cast<char>(0xe8),  // ms / 1000
+				0, 0 };  // dispose op none, blend op source
+			fctl.append(delay.data(), delay.size());
+			png_append_chunk(png, "fcTL", fctl);
+			if (frames_added++ == 0)
+				{ png_append_chunk(png, "IDAT", compressed); }
+			else
+			{
+				std::string fdat;
+				png_append_u32(fdat, sequence++);
+				fdat += compressed;
+				png_append_chunk(png, "fdAT", fdat);
+			}
+		}
+
+		// @return bytes written so far
+		[[nodiscard]] std::size_t size() const noexcept
+			{ return png.size(); }
+
+		// all frames must have been added
+		// @return png data
+		[[nodiscard]] std::string finish()
+		{
+			png_append_chunk(png, "IEND", {});
+			return std::move(png);
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,565 @@
+#ifndef PRESENCE_INDEX_H
+#define PRESENCE_INDEX_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parse_logs.h"
+#include "session_store.h"
+
+// set of player ids, compressed like a roaring bitmap: ids are split into containers of 2^16 ids, and each container is a sorted array
+// of the low bits of its ids, or a bitmap of all of its ids if there are too many for the array to be smaller
+// the players of a day are a small part of everyone in history, so most containers are short arrays, and unions and intersections
+// of them are merges, or ORs and ANDs of whole words for bitmaps
+class player_bitmap
+{
+public:
+	static constexpr std::size_t container_bits = 16;
+	static constexpr std::size_t bitmap_words = (std::size_t(1) << container_bits) / 64;
+	// arrays of more ids than this would take more memory than a bitmap
+	static constexpr std::size_t max_array_size = bitmap_words * sizeof(std::uint64_t) / sizeof(std::uint16_t);
+
+private:
+	struct container_t
+	{
+		std::uint32_t key;  // ids >> container_bits
+		std::vector<std::uint16_t> values;  // sorted low bits of the ids, if it isn't a bitmap
+		std::vector<std::uint64_t> words;  // bitmap_words words, if it is a bitmap (then values is empty)
+		std::uint32_t cardinality;
+
+		[[nodiscard]] bool is_bitmap() const noexcept
+			{ return !words.empty(); }
+		[[nodiscard]] bool contains(std::uint16_t value) const noexcept
+		{
+			if (is_bitmap())
+				{ return (words[value / 64] >> (value % 64)) & 1; }
+			return std::ranges::binary_search(values, value);
+		}
+	};
+
+	std::vector<container_t> containers;  // sorted by key, none are empty
+
+	// @param words  bitmap_words words
+	// @return container of the set bits of words, as an array if there aren't too many, or nullopt if there are none
+	[[nodiscard]] static std::optional<container_t> make_container(std::uint32_t key, std::span<const std::uint64_t> words)
+	{
+		std::uint32_t count = 0;
+		for (const std::uint64_t word : words)
+			{ count += std::popcount(word); }
+		if (count == 0)
+			{ return std::nullopt; }
+		container_t res{ key, {}, {}, count };
+		if (count > max_array_size)
+		{
+			res.words.assign(words.begin(), words.end());
+			return res;
+		}
+		res.values.reserve(count);
+		for (std::size_t i = 0; i < words.size(); i++)
+		{
+			for (std::uint64_t word = words[i]; word != 0; word &= word - 1)
+				{ res.values.push_back(static_cast<std::uint16_t>(i * 64 + std::countr_zero(word))); }
+		}
+		return res;
+	}
+
+	static void add_to_bitmap(std::span<std::uint64_t> words, const container_t& container) noexcept
+	{
+		if (container.is_bitmap())
+		{
+			for (std::size_t i = 0; i < bitmap_words; i++)
+				{ words[i] |= container.words[i]; }
+		}
+		else
+		{
+			for (const std::uint16_t value : container.values)
+				{ words[value / 64] |= std::uint64_t(1) << (value % 64); }
+		}
+	}
+
+	// @return ids in either of two containers with the same key
+	[[nodiscard]] static std::optional<container_t> unite(const container_t& lhs, const container_t& rhs)
+	{
+		if (!lhs.is_bitmap() && !rhs.is_bitmap() && lhs.values.size() + rhs.values.size() <= max_array_size)
+		{
+			container_t res{ lhs.key, {}, {}, 0 };
+			res.values.reserve(lhs.values.size() + rhs.values.size());
+			std::ranges::set_union(lhs.values, rhs.values, std::back_inserter(res.values));
+			res.cardinality = static_cast<std::uint32_t>(res.values.size());
+			return res;
+		}
+		std::array<std::uint64_t, bitmap_words> words{};
+		add_to_bitmap(words, lhs);
+		add_to_bitmap(words, rhs);
+		return make_container(lhs.key, words);
+	}
+
+	// @return ids in both of two containers with the same key, or nullopt if there are none
+	[[nodiscard]] static std::optional<container_t> intersect(const container_t& lhs, const container_t& rhs)
+	{
+		if (lhs.is_bitmap() && rhs.is_bitmap())
+		{
+			std::array<std::uint64_t, bitmap_words> words;
+			for (std::size_t i = 0; i < bitmap_words; i++)
+				{ words[i] = lhs.words[i] & rhs.words[i]; }
+			return make_container(lhs.key, words);
+		}
+		container_t res{ lhs.key, {}, {}, 0 };
+		if (!lhs.is_bitmap() && !rhs.is_bitmap())
+			{ std::ranges::set_intersection(lhs.values, rhs.values, std::back_inserter(res.values)); }
+		else
+		{
+			// an intersection is never larger than the array, so it is one too
+			const container_t& array = lhs.is_bitmap() ? rhs : lhs;
+			const container_t& bitmap = lhs.is_bitmap() ? lhs : rhs;
+			std::ranges::copy_if(array.values, std::back_inserter(res.values), [&bitmap](std::uint16_t value) { return bitmap.contains(value); });
+		}
+		if (res.values.empty())
+			{ return std::nullopt; }
+		res.cardinality = static_cast<std::uint32_t>(res.values.size());
+		return res;
+	}
+
+public:
+	player_bitmap() = default;
+
+	// @param ids  sorted and unique
+	explicit player_bitmap(std::span<const std::uint32_t> ids)
+	{
+		for (auto it = ids.begin(); it != ids.end();)
+		{
+			const std::uint32_t key = *it >> container_bits;
+			const auto end = std::find_if(it, ids.end(), [key](std::uint32_t id) { return (id >> container_bits) != key; });
+			container_t& container = containers.emplace_back(container_t{ key, {}, {}, static_cast<std::uint32_t>(end - it) });
+			const auto low_bits = [](std::uint32_t id) { return static_cast<std::uint16_t>(id); };
+			if (container.cardinality > max_array_size)
+			{
+				container.words.resize(bitmap_words);
+				for (const std::uint16_t value : std::span(it, end) | std::views::transform(low_bits))
+					{ container.words[value / 64] |= std::uint64_t(1) << (value % 64); }
+			}
+			else
+				{ std::ranges::transform(it, end, std::back_inserter(container.values), low_bits); }
+			it = end;
+		}
+	}
+
+	// @return ids in this or `other`
+	[[nodiscard]] player_bitmap united(const player_bitmap& other) const
+	{
+		player_bitmap res;
+		auto it1 = containers.begin(), it2 = other.containers.begin();
+		while (it1 != containers.end() || it2 != other.containers.end())
+		{
+			if (it2 == other.containers.end() || (it1 != containers.end() && it1->key < it2->key))
+				{ res.containers.push_back(*it1++); }
+			else if (it1 == containers.end() || it2->key < it1->key)
+				{ res.containers.push_back(*it2++); }
+			else
+			{
+				// the union of two non-empty containers is never empty
+				res.containers.push_back(unite(*it1++, *it2++).value());
+			}
+		}
+		return res;
+	}
+
+	// @return ids in both this and `other`
+	[[nodiscard]] player_bitmap intersected(const player_bitmap& other) const
+	{
+		player_bitmap res;
+		for (auto it1 = containers.begin(), it2 = other.containers.begin(); it1 != containers.end() && it2 != other.containers.end();)
+		{
+			if (it1->key < it2->key)
+				{ ++it1; }
+			else if (it2->key < it1->key)
+				{ ++it2; }
+			else if (auto container = intersect(*it1++, *it2++))
+				{ res.containers.push_back(std::move(container.value())); }
+		}
+		return res;
+	}
+
+	[[nodiscard]] bool contains(std::uint32_t id) const noexcept
+	{
+		const auto it = std::ranges::lower_bound(containers, id >> container_bits, {}, &container_t::key);
+		return it != containers.end() && it->key == (id >> container_bits) && it->contains(static_cast<std::uint16_t>(id));
+	}
+
+	// @return number of ids
+	[[nodiscard]] std::size_t size() const noexcept
+	{
+		std::size_t count = 0;
+		for (const container_t& container : containers)
+			{ count += container.cardinality; }
+		return count;
+	}
+
+	[[nodiscard]] bool empty() const noexcept
+		{ return containers.empty(); }
+
+	// call f(id) for each id, in order
+	void for_each(auto&& f) const
+	{
+		for (const container_t& container : containers)
+		{
+			const std::uint32_t high = container.key << container_bits;
+			if (!container.is_bitmap())
+			{
+				for (const std::uint16_t value : container.values)
+					{ f(high | value); }
+				continue;
+			}
+			for (std::size_t i = 0; i < bitmap_words; i++)
+			{
+				for (std::uint64_t word = container.words[i]; word != 0; word &= word - 1)
+					{ f(high | static_cast<std::uint32_t>(i * 64 + static_cast<std::size_t>(std::countr_zero(word)))); }
+			}
+		}
+	}
+};
+
+// players first online in a month, and how many of them were online in that month and each one after it (see presence_index::retention)
+struct cohort_retention
+{
+	std::chrono::year_month month;
+	std::size_t size;  // players first online in month
+	std::vector<std::size_t> active;  // players of the cohort online in month + i, up to the last month asked for
+};
+
+// local days on which each player in history was online, made once for each set of history segments (see detail::history_cache)
+// players are interned (their id is the index of their uuid in history, sorted), and each day has a player_bitmap of the players with a session
+// overlapping it, so the players of a week or month are a union of a few bitmaps instead of a scan of every session
+// whole weeks also have a bitmap, so months (and years) are unions of a handful, and players are grouped by the day they were first online for cohorts
+// days of recent data and online players are added when querying (see get_recent), like the leaderboard does with their playtime
+class presence_index
+{
+public:
+	// days of players in data that isn't in history yet
+	struct recent_t
+	{
+		std::vector<uuid_t> new_uuids;  // sorted, of players who aren't in history, whose ids follow those of the players in history
+		std::chrono::local_days first_day{};
+		std::vector<player_bitmap> days;  // players online on first_day + i
+		std::vector<std::pair<std::int32_t, std::uint32_t>> first_online;  // (first day online, id) of players not online in history, sorted
+	};
+
+private:
+	static constexpr std::int32_t never_online = std::numeric_limits<std::int32_t>::max();
+
+	const std::chrono::time_zone* timezone;
+	std::vector<uuid_t> uuids;  // sorted, the index of a uuid is its id
+	std::chrono::local_days first_day{};
+	std::vector<player_bitmap> days;  // players online on first_day + i
+	std::vector<player_bitmap> weeks;  // players online on first_day + 7i to first_day + 7i + 6, only of whole weeks
+	std::vector<std::int32_t> first_online_of;  // local day since the epoch each id was first online, never_online if it wasn't
+	std::vector<std::pair<std::int32_t, std::uint32_t>> by_first_online;  // (first day online, id) of players online in history, sorted
+
+	// @return bitmap of `day` in `bitmaps` of days from `first`, or nullptr if it isn't one of them
+	[[nodiscard]] static const player_bitmap* day_in(std::chrono::local_days day, std::chrono::local_days first, const std::vector<player_bitmap>& bitmaps) noexcept
+	{
+		const auto ind = (day - first).count();
+		return (ind >= 0 && static_cast<std::size_t>(ind) < bitmaps.size()) ? &bitmaps[static_cast<std::size_t>(ind)] : nullptr;
+	}
+
+	// call `f` with each local day `session` overlaps (the day it starts on if it is empty)
+	// @param zone  timezone, or a tz_offset_table of it
+	static void for_each_day(const play_session& session, const auto& zone, auto&& f)
+	{
+		const auto end = session.first + session.second;
+		auto day = std::chrono::floor<std::chrono::days>(zone.to_local(session.first));
+		f(day);
+		// midnight at the end of each day, until the session ends by it
+		while (zone.to_sys(day + std::chrono::days(1), std::chrono::choose::earliest) < end)
+		{
+			day += std::chrono::days(1);
+			f(day);
+		}
+	}
+
+	// @param day_ids  of (day, id), sorted and unique
+	// @param[out] out_first_day, out_days  bitmap of the ids of each day, from the first day to the last
+	static void make_days(std::span<const std::pair<std::int32_t, std::uint32_t>> day_ids, std::chrono::local_days& out_first_day,
+		std::vector<player_bitmap>& out_days)
+	{
+		if (day_ids.empty())
+			{ return; }
+		out_first_day = std::chrono::local_days(std::chrono::days(day_ids.front().first));
+		out_days.resize(static_cast<std::size_t>(day_ids.back().first - day_ids.front().first) + 1);
+		std::vector<std::uint32_t> ids;  // reused
+		for (auto it = day_ids.begin(); it != day_ids.end();)
+		{
+			const std::int32_t day = it->first;
+			ids.clear();
+			for (; it != day_ids.end() && it->first == day; ++it)
+				{ ids.push_back(it->second); }
+			out_days[static_cast<std::size_t>(day - day_ids.front().first)] = player_bitmap(ids);
+		}
+	}
+
+	// @return players online on `day`, in history or recent data
+	[[nodiscard]] player_bitmap on(std::chrono::local_days day, const recent_t& recent) const
+	{
+		const player_bitmap* history_day = day_in(day, first_day, days);
+		const player_bitmap* recent_day = day_in(day, recent.first_day, recent.days);
+		if (history_day != nullptr && recent_day != nullptr)
+			{ return history_day->united(*recent_day); }
+		if (history_day != nullptr || recent_day != nullptr)
+			{ return (history_day != nullptr) ? *history_day : *recent_day; }
+		return {};
+	}
+
+public:
+	// @param timezone  which days are local to
+	presence_index(std::span<const std::shared_ptr<const session_store>> segments, const std::chrono::time_zone* timezone) : timezone(timezone)
+	{
+		for (const auto& segment : segments)
+		{
+			for (std::size_t i = 0; i < segment->size(); i++)
+				{ uuids.push_back(segment->uuid(i)); }
+		}
+		std::ranges::sort(uuids);
+		uuids.erase(std::ranges::unique(uuids).begin(), uuids.end());
+
+		std::vector<std::pair<std::int32_t, std::uint32_t>> day_ids;
+		for (const auto& segment : segments)
+		{
+			const tz_offset_table zone = segment->offset_table(timezone);
+			for (std::size_t i = 0; i < segment->size(); i++)
+			{
+				const std::uint32_t id = find(segment->uuid(i), {}).value();
+				segment->for_each_session(i, time_range{}, [&](const play_session& session)
+				{
+					for_each_day(session, zone, [&day_ids, id](std::chrono::local_days day)
+						{ day_ids.emplace_back(static_cast<std::int32_t>(day.time_since_epoch().count()), id); });
+				});
+			}
+		}
+		std::ranges::sort(day_ids);
+		day_ids.erase(std::ranges::unique(day_ids).begin(), day_ids.end());
+		make_days(day_ids, first_day, days);
+
+		for (std::size_t i = 0; i + 7 <= days.size(); i += 7)
+		{
+			player_bitmap week = days[i];
+			for (std::size_t j = i + 1; j < i + 7; j++)
+				{ week = week.united(days[j]); }
+			weeks.push_back(std::move(week));
+		}
+		// sorted by day, so the first of each id is its first day
+		first_online_of.assign(uuids.size(), never_online);
+		for (const auto& [day, id] : day_ids)
+		{
+			if (first_online_of[id] == never_online)
+			{
+				first_online_of[id] = day;
+				by_first_online.emplace_back(day, id);
+			}
+		}
+	}
+
+	// @param recent, parse_ctx  data that isn't in history yet, for recent sessions and online players
+	// @param now  end of the sessions of online players
+	// @return days of the players in them, for the other queries
+	[[nodiscard]] recent_t get_recent(const log_data_t& recent, const parse_ctx_t& parse_ctx, std::chrono::system_clock::time_point now) const
+	{
+		std::vector<std::pair<uuid_t, play_session>> sessions;
+		for (const auto& [uuid, data] : recent)
+		{
+			for (const play_session& session : data.second.first)
+				{ sessions.emplace_back(uuid, session); }
+		}
+		for (const std::uint32_t id : parse_ctx.player_info.online())
+		{
+			const auto& [uuid, join_time] = parse_ctx.player_info.infos()[id];
+			if (uuid)
+				{ sessions.emplace_back(uuid.value(), play_session(join_time.value(), now - join_time.value())); }
+		}
+
+		recent_t res;
+		for (const auto& [uuid, session] : sessions)
+		{
+			if (!std::ranges::binary_search(uuids, uuid))
+				{ res.new_uuids.push_back(uuid); }
+		}
+		std::ranges::sort(res.new_uuids);
+		res.new_uuids.erase(std::ranges::unique(res.new_uuids).begin(), res.new_uuids.end());
+
+		std::vector<std::pair<std::int32_t, std::uint32_t>> day_ids;
+		for (const auto& [uuid, session] : sessions)
+		{
+			const std::uint32_t id = find(uuid, res).value();
+			for_each_day(session, *timezone, [&day_ids, id](std::chrono::local_days day)
+				{ day_ids.emplace_back(static_cast<std::int32_t>(day.time_since_epoch().count()), id); });
+		}
+		std::ranges::sort(day_ids);
+		day_ids.erase(std::ranges::unique(day_ids).begin(), day_ids.end());
+		make_days(day_ids, res.first_day, res.days);
+		// sorted by day, so the first of each id is its first day
+		std::vector<bool> seen(uuids.size() + res.new_uuids.size());
+		for (const auto& [day, id] : day_ids)
+		{
+			if (!seen[id] && (id >= first_online_of.size() || first_online_of[id] == never_online))
+				{ res.first_online.emplace_back(day, id); }
+			seen[id] = true;
+		}
+		return res;
+	}
+
+	// @return id of a player in history or `recent`, or nullopt if they haven't played
+	[[nodiscard]] std::optional<std::uint32_t> find(uuid_t uuid, const recent_t& recent) const noexcept
+	{
+		if (const auto it = std::ranges::lower_bound(uuids, uuid); it != uuids.end() && *it == uuid)
+			{ return static_cast<std::uint32_t>(it - uuids.begin()); }
+		if (const auto it = std::ranges::lower_bound(recent.new_uuids, uuid); it != recent.new_uuids.end() && *it == uuid)
+			{ return static_cast<std::uint32_t>(uuids.size() + (it - recent.new_uuids.begin())); }
+		return std::nullopt;
+	}
+
+	// @param id  of a player in history or `recent` (see find)
+	[[nodiscard]] uuid_t uuid(std::uint32_t id, const recent_t& recent) const noexcept
+		{ return (id < uuids.size()) ? uuids[id] : recent.new_uuids[id - uuids.size()]; }
+
+	// @return players online on any day of [first, last]
+	[[nodiscard]] player_bitmap any_day(std::chrono::local_days first, std::chrono::local_days last, const recent_t& recent) const
+	{
+		player_bitmap res;
+		for (auto day = first; day <= last;)
+		{
+			// a week at a time where a whole one is in the range
+			if (const auto ind = (day - first_day).count(); ind >= 0 && ind % 7 == 0 && static_cast<std::size_t>(ind / 7) < weeks.size()
+				&& day + std::chrono::days(6) <= last)
+			{
+				res = res.united(weeks[static_cast<std::size_t>(ind / 7)]);
+				day += std::chrono::days(7);
+				continue;
+			}
+			if (const player_bitmap* bitmap = day_in(day, first_day, days))
+				{ res = res.united(*bitmap); }
+			day += std::chrono::days(1);
+		}
+		for (auto day = std::max(first, recent.first_day); day <= last; day += std::chrono::days(1))
+		{
+			const player_bitmap* bitmap = day_in(day, recent.first_day, recent.days);
+			if (bitmap == nullptr)
+				{ break; }
+			res = res.united(*bitmap);
+		}
+		return res;
+	}
+
+	// @return players online on every day of [first, last]
+	[[nodiscard]] player_bitmap every_day(std::chrono::local_days first, std::chrono::local_days last, const recent_t& recent) const
+	{
+		if (last < first)
+			{ return {}; }
+		player_bitmap res = on(first, recent);
+		for (auto day = first + std::chrono::days(1); day <= last && !res.empty(); day += std::chrono::days(1))
+			{ res = res.intersected(on(day, recent)); }
+		return res;
+	}
+
+	// @return number of consecutive days up to and including `last` that the player was online on, 0 if they weren't on `last`
+	[[nodiscard]] std::size_t streak(std::uint32_t id, std::chrono::local_days last, const recent_t& recent) const
+	{
+		const auto online_on = [&](const std::chrono::local_days day)
+		{
+			const player_bitmap* history_day = day_in(day, first_day, days);
+			const player_bitmap* recent_day = day_in(day, recent.first_day, recent.days);
+			return (history_day != nullptr && history_day->contains(id)) || (recent_day != nullptr && recent_day->contains(id));
+		};
+		std::size_t count = 0;
+		for (auto day = last; online_on(day); day -= std::chrono::days(1))
+			{ count++; }
+		return count;
+	}
+
+	// @return last day anyone was online on, or nullopt if nobody was
+	[[nodiscard]] std::optional<std::chrono::local_days> last_day(const recent_t& recent) const noexcept
+	{
+		if (days.empty() && recent.days.empty())
+			{ return std::nullopt; }
+		if (recent.days.empty())
+			{ return first_day + std::chrono::days(days.size() - 1); }
+		const auto recent_last = recent.first_day + std::chrono::days(recent.days.size() - 1);
+		return days.empty() ? recent_last : std::max(recent_last, first_day + std::chrono::days(days.size() - 1));
+	}
+
+	// @return players who were first online on a day of [first, last]
+	[[nodiscard]] player_bitmap first_online(std::chrono::local_days first, std::chrono::local_days last, const recent_t& recent) const
+	{
+		std::vector<std::uint32_t> ids;
+		const auto add = [&ids, first, last](std::span<const std::pair<std::int32_t, std::uint32_t>> by_day)
+		{
+			const auto begin = std::ranges::lower_bound(by_day, static_cast<std::int32_t>(first.time_since_epoch().count()), {},
+				&std::pair<std::int32_t, std::uint32_t>::first);
+			const auto end = std::ranges::upper_bound(by_day, static_cast<std::int32_t>(last.time_since_epoch().count()), {},
+				&std::pair<std::int32_t, std::uint32_t>::first);
+			for (auto it = begin; it < end; ++it)
+				{ ids.push_back(it->second); }
+		};
+		add(by_first_online);
+		add(recent.first_online);
+		std::ranges::sort(ids);
+		return player_bitmap(ids);
+	}
+
+	// retention of the players who were first online in each month of [first, last], as the share of each cohort that was online in each later month
+	// the players of each month are made once and intersected with every cohort, so it is a few hundred bitmap operations even for years of history
+	// @param until  last day counted, e.g. today, so the last month is only the part of it until then
+	// @return cohort of each month, oldest first. cohort i has an active count for each month from its own to until's
+	[[nodiscard]] std::vector<cohort_retention> retention(std::chrono::year_month first, std::chrono::year_month last, std::chrono::local_days until,
+		const recent_t& recent) const
+	{
+		const std::chrono::year_month_day until_date(until);
+		const std::chrono::year_month until_month = until_date.year() / until_date.month();
+		last = std::min(last, until_month);
+		std::vector<player_bitmap> months;  // players online in first + i
+		for (auto month = first; month <= until_month; month += std::chrono::months(1))
+			{ months.push_back(any_day(std::chrono::local_days(month / 1), std::min(until, std::chrono::local_days(month / std::chrono::last)), recent)); }
+
+		std::vector<cohort_retention> res;
+		for (auto month = first; month <= last; month += std::chrono::months(1))
+		{
+			const player_bitmap cohort = first_online(std::chrono::local_days(month / 1), std::chrono::local_days(month / std::chrono::last), recent);
+			cohort_retention& cur = res.emplace_back(cohort_retention{ month, cohort.size(), {} });
+			for (std::size_t i = res.size() - 1; i < months.size(); i++)
+				{ cur.active.push_back(cohort.intersected(months[i]).size()); }
+		}
+		return res;
+	}
+};
+
+// @return table of each cohort's size and the percentage of it online in each month after its first (+1, +2, ...), for a monospace font
+[[nodiscard]] inline std::string format_retention(std::span<const cohort_retention> cohorts)
+{
+	std::size_t num_months = 0;
+	for (const cohort_retention& cohort : cohorts)
+		{ num_months = std::max(num_months, cohort.active.size()); }
+	std::string res = "Cohort   Players";
+	for (std::size_t i = 1; i < num_months; i++)
+		{ res += std::format(" {:>4}", std::format("+{}", i)); }
+	for (const cohort_retention& cohort : cohorts)
+	{
+		res += std::format("\n{:%Y-%m}  {:>7}", cohort.month, cohort.size);
+		for (std::size_t i = 1; i < cohort.active.size(); i++)
+			{ res += (cohort.size == 0) ? "    -" : std::format(" {:>3}%", cohort.active[i] * 100 / cohort.size); }
+	}
+	return res;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef PRESENCE_SCHEDULER_H
+#define PRESENCE_SCHEDULER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <dpp/dpp.h>
+
+#include "coalescing_timer.h"
+#include "metrics.h"
+
+// sends status changes from a dpp timer instead of immediately, so a burst of player count changes
+// (e.g. everyone reconnecting after a server restart) becomes a single presence update
+// with the latest status, and updates never exceed what discord allows
+class presence_scheduler
+{
+private:
+	// discord throttles presence updates beyond about 5 per minute
+	static constexpr std::size_t max_updates = 5;
+	static constexpr std::chrono::seconds budget_period{ 60 };
+
+	dpp::cluster& bot;
+	// guarded by the timer's mutex
+	std::optional<std::string> pending;  // latest status not sent yet
+	std::optional<std::string> sent;  // last status sent
+	std::deque<std::chrono::steady_clock::time_point> send_times;  // within the last budget_period
+	coalescing_timer timer;  // running while something is pending, last so it's destroyed first
+
+	[[nodiscard]] static dpp::presence make_presence(const std::string& status)
+	{
+		if (status.empty())
+			{ return dpp::presence(dpp::ps_online, dpp::activity()); }
+		return dpp::presence(dpp::ps_online, dpp::at_game, status);
+	}
+
+	bool tick()
+	{
+		const auto now = std::chrono::steady_clock::now();
+		while (!send_times.empty() && now - send_times.front() >= budget_period)
+			{ send_times.pop_front(); }
+		if (pending && pending != sent)
+		{
+			if (send_times.size() >= max_updates)
+				{ return true; }  // try again next tick
+			bot.set_presence(make_presence(pending.value()));
+			bot.log(dpp::loglevel::ll_info, "changing presence");
+			get_metrics().presence_updates.add();
+			send_times.push_back(now);
+			sent = std::move(pending);
+		}
+		pending.reset();
+		return false;  // nothing left to send, the timer is started again by the next change
+	}
+
+public:
+	// @param window  seconds to wait for more changes before sending (at least 1)
+	presence_scheduler(dpp::cluster& bot, std::uint64_t window) :
+		bot(bot), timer(bot, window, [this](std::unique_lock<std::mutex>&) { return tick(); }) {}
+	presence_scheduler(const presence_scheduler&) = delete;
+	presence_scheduler& operator=(const presence_scheduler&) = delete;
+
+	// @param status  activity to show (game being played), or empty for none
+	void set(std::string status)
+	{
+		const auto lock = timer.lock();
+		pending = std::move(status);
+		timer.start(lock);
+	}
+};
+
+#endif
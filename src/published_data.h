@@ -0,0 +1,45 @@
+#ifndef PUBLISHED_DATA_H
+#define PUBLISHED_DATA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lag_series.h"
+#include "memory_census.h"
+#include "parse_logs.h"
+#include "session_store.h"
+#include "uptime_series.h"
+
+// immutable copy of parsed data, published by the log reading loop for slash command handlers
+// (or received from the primary on a replica, see replication_client)
+// history segments are shared, so only the latest.log data and parse context are actually copied
+struct published_data_t
+{
+	session_history history;
+	log_data_t recent;
+	parse_ctx_t ctx;
+	std::uint64_t generation;  // incremented whenever player sessions change, for caching things computed from them
+	// archived log files in history so far, and how many there are. they differ while the initial parse is running
+	std::size_t files_loaded, files_total;
+	memory_usage checkpoint_memory;  // of the latest.log checkpoints, which only the log reading loop can read
+	// how far behind the server (or each server) was, shared like history: that of the history, then that of latest.log
+	std::vector<std::shared_ptr<const lag_series>> lag;
+	// when the server was up, shared like lag: that of the history, then that of latest.log. empty for all servers merged, whose servers
+	// were each up at different times (see merge_published_data)
+	std::vector<std::shared_ptr<const uptime_series>> uptime;
+	// name and data of each server it was merged from, for graphs with a part for each (see create_servers_graph). empty for a server
+	std::vector<std::pair<std::string, std::shared_ptr<const published_data_t>>> servers;
+
+	[[nodiscard]] bool loading() const noexcept
+		{ return files_loaded != files_total; }
+	// @return note for replies while history is incomplete, or empty string once it is complete
+	[[nodiscard]] std::string loading_note() const
+		{ return loading() ? std::format("*History still loading: {}/{} log files*", files_loaded, files_total) : std::string(); }
+};
+
+#endif
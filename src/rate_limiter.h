@@ -0,0 +1,89 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// token buckets for many keys (e.g. users or channels), without locks
+// each bucket is one atomic in a fixed table, stored as the time it will be full again (generic cell rate algorithm), so taking tokens
+// is a single compare and swap. keys that hash to the same slot while both are limited share a bucket, which only makes the limit stricter
+class rate_limiter
+{
+private:
+	// a slot is the key's tag in the high bits and the time its bucket is full in ms since `epoch` in the rest
+	static constexpr unsigned time_bits = 40;  // about 34 years
+	static constexpr std::uint64_t time_mask = (std::uint64_t(1) << time_bits) - 1;
+
+	std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	std::size_t slot_mask;
+	std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+
+	[[nodiscard]] static std::uint64_t mix(std::uint64_t key)
+	{
+		// splitmix64 finalizer, since snowflakes differ mostly in their low and middle bits
+		key ^= key >> 30;
+		key *= 0xbf58476d1ce4e5b9;
+		key ^= key >> 27;
+		key *= 0x94d049bb133111eb;
+		key ^= key >> 31;
+		return key;
+	}
+
+	[[nodiscard]] std::uint64_t now_ms() const
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count());
+	}
+
+public:
+	// @param num_slots  number of buckets, rounded up to a power of 2
+	rate_limiter(std::size_t num_slots = 1024) : slot_mask(std::bit_ceil(num_slots) - 1), slots(std::make_unique<std::atomic<std::uint64_t>[]>(slot_mask + 1)) {}
+
+	// take `cost` tokens from the bucket of `key`, which holds `burst` tokens and gets one back every `interval`
+	// @param cost  at most `burst`, or it can never be taken
+	// @return 0 if they were taken, otherwise how long until they can be (and nothing is taken)
+	[[nodiscard]] std::chrono::milliseconds try_take(std::uint64_t key, double cost, double burst, std::chrono::milliseconds interval)
+	{
+		const std::uint64_t hash = mix(key);
+		const std::uint64_t tag = hash & ~time_mask;
+		std::atomic<std::uint64_t>& slot = slots[hash & slot_mask];
+		const std::uint64_t now = now_ms();
+		const auto cost_ms = static_cast<std::uint64_t>(std::llround(cost * static_cast<double>(interval.count())));
+		const auto burst_ms = static_cast<std::uint64_t>(std::llround(burst * static_cast<double>(interval.count())));
+
+		std::uint64_t cur = slot.load(std::memory_order_relaxed);
+		while (true)
+		{
+			// a full bucket of another key is free to take over
+			const std::uint64_t full_tp = cur & time_mask;
+			const std::uint64_t start = (full_tp > now) ? full_tp : now;
+			if (start + cost_ms > now + burst_ms)
+				{ return std::chrono::milliseconds(start + cost_ms - now - burst_ms); }
+			if (slot.compare_exchange_weak(cur, tag | ((start + cost_ms) & time_mask), std::memory_order_relaxed))
+				{ return std::chrono::milliseconds(0); }
+		}
+	}
+
+	// give back tokens taken by try_take, e.g. when the work they were for wasn't done
+	void refund(std::uint64_t key, double cost, std::chrono::milliseconds interval)
+	{
+		const std::uint64_t hash = mix(key);
+		std::atomic<std::uint64_t>& slot = slots[hash & slot_mask];
+		const auto cost_ms = static_cast<std::uint64_t>(std::llround(cost * static_cast<double>(interval.count())));
+
+		std::uint64_t cur = slot.load(std::memory_order_relaxed);
+		while (true)
+		{
+			const std::uint64_t full_tp = cur & time_mask;
+			const std::uint64_t refunded = (full_tp > cost_ms) ? full_tp - cost_ms : 0;
+			if (slot.compare_exchange_weak(cur, (cur & ~time_mask) | refunded, std::memory_order_relaxed))
+				{ return; }
+		}
+	}
+};
+
+#endif
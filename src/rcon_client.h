@@ -0,0 +1,189 @@
+#ifndef RCON_CLIENT_H
+#define RCON_CLIENT_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "net_socket.h"
+
+// a connection to a minecraft server's rcon port (source rcon protocol), to ask it who is online (/list) instead of working it out from latest.log
+// enabled in the server with enable-rcon, rcon.port and rcon.password in server.properties
+// packets are: little endian int32 size of the rest, int32 request id, int32 type, body, two null bytes
+namespace detail
+{
+	inline constexpr std::int32_t rcon_type_response = 0;
+	inline constexpr std::int32_t rcon_type_command = 2;  // also the type of the response to rcon_type_auth
+	inline constexpr std::int32_t rcon_type_auth = 3;
+	// longest body the server sends in one packet, longer responses are split
+	inline constexpr std::size_t rcon_max_response_body = 4096;
+	// the server also has a limit on what it receives, commands are short
+	inline constexpr std::size_t rcon_max_request_body = 1446;
+
+	struct rcon_packet
+	{
+		std::int32_t id;
+		std::int32_t type;
+		std::string body;
+	};
+
+	[[nodiscard]] inline std::string encode_rcon_packet(std::int32_t id, std::int32_t type, std::string_view body)
+	{
+		std::string res;
+		const auto append_int = [&res](std::int32_t x)
+		{
+			const auto u = static_cast<std::uint32_t>(x);
+			for (int shift = 0; shift < 32; shift += 8)
+				{ res.push_back(static_cast<char>((u >> shift) & 0xff)); }
+		};
+		append_int(static_cast<std::int32_t>(body.size() + 10));
+		append_int(id);
+		append_int(type);
+		res.append(body);
+		res.append(2, '\0');
+		return res;
+	}
+
+	// read exactly `size` bytes, waiting at most `timeout_ms` for each part of them
+	// @return false if the peer hung up or sent nothing in time
+	[[nodiscard]] inline bool recv_exact(socket_t s, char* out, std::size_t size, int timeout_ms)
+	{
+		while (size != 0)
+		{
+			if (poll_socket(s, timeout_ms) <= 0)
+				{ return false; }
+			const auto num_read = recv(s, out, static_cast<int>(size), 0);
+			if (num_read <= 0)
+				{ return false; }
+			out += num_read;
+			size -= static_cast<std::size_t>(num_read);
+		}
+		return true;
+	}
+
+	// @return packet, or nullopt if the peer hung up, sent nothing in time, or sent something that isn't a packet
+	[[nodiscard]] inline std::optional<rcon_packet> read_rcon_packet(socket_t s, int timeout_ms)
+	{
+		const auto decode_int = [](const char* p)
+		{
+			std::uint32_t u = 0;
+			for (int i = 3; i >= 0; i--)
+				{ u = (u << 8) | static_cast<unsigned char>(p[i]); }
+			return static_cast<std::int32_t>(u);
+		};
+		std::array<char, 12> header;
+		if (!recv_exact(s, header.data(), header.size(), timeout_ms))
+			{ return std::nullopt; }
+		const std::int32_t size = decode_int(header.data());
+		if (size < 10 || static_cast<std::size_t>(size) > rcon_max_response_body + 10)
+			{ return std::nullopt; }
+		rcon_packet res{ decode_int(header.data() + 4), decode_int(header.data() + 8), std::string(static_cast<std::size_t>(size) - 8, '\0') };
+		if (!recv_exact(s, res.body.data(), res.body.size(), timeout_ms))
+			{ return std::nullopt; }
+		// without the null bytes
+		res.body.resize(res.body.size() - 2);
+		if (const auto null_pos = res.body.find('\0'); null_pos != std::string::npos)
+			{ res.body.resize(null_pos); }
+		return res;
+	}
+}
+
+class rcon_client
+{
+private:
+	using socket_t = detail::socket_t;
+
+	socket_t s = detail::invalid_socket;
+	int timeout_ms;
+	std::int32_t next_id = 1;
+
+	rcon_client(socket_t s, int timeout_ms) noexcept : s(s), timeout_ms(timeout_ms) {}
+
+public:
+	rcon_client(const rcon_client&) = delete;
+	rcon_client& operator=(const rcon_client&) = delete;
+	rcon_client(rcon_client&& other) noexcept : s(std::exchange(other.s, detail::invalid_socket)), timeout_ms(other.timeout_ms), next_id(other.next_id) {}
+	~rcon_client()
+	{
+		if (s != detail::invalid_socket)
+		{
+			detail::close_socket(s);
+			detail::cleanup_sockets();
+		}
+	}
+
+	// @param address  ipv4 address of the server
+	// @param timeout_ms  for each response
+	// @return client that is logged in, or nullopt if the server can't be reached, doesn't respond in time, or the password is wrong
+	[[nodiscard]] static std::optional<rcon_client> connect(const std::string& address, std::uint16_t port, std::string_view password, int timeout_ms)
+	{
+		if (!detail::init_sockets())
+			{ return std::nullopt; }
+		rcon_client client(detail::connect_socket(address, port), timeout_ms);
+		if (client.s == detail::invalid_socket)
+		{
+			detail::cleanup_sockets();
+			return std::nullopt;
+		}
+		const std::int32_t id = client.next_id++;
+		if (!detail::send_all(client.s, detail::encode_rcon_packet(id, detail::rcon_type_auth, password)))
+			{ return std::nullopt; }
+		// some servers send an empty response before the result of logging in
+		while (true)
+		{
+			const auto packet = detail::read_rcon_packet(client.s, timeout_ms);
+			// the id is -1 if the password is wrong
+			if (!packet || packet->id != id)
+				{ return std::nullopt; }
+			if (packet->type == detail::rcon_type_command)
+				{ return client; }
+		}
+	}
+
+	// run a command in the server's console
+	// @param command  without the leading slash (e.g. "list")
+	// @return what the command output, or nullopt if the connection was lost or the server didn't respond in time
+	[[nodiscard]] std::optional<std::string> command(std::string_view command)
+	{
+		if (command.size() > detail::rcon_max_request_body)
+			{ return std::nullopt; }
+		const std::int32_t id = next_id++;
+		if (!detail::send_all(s, detail::encode_rcon_packet(id, detail::rcon_type_command, command)))
+			{ return std::nullopt; }
+		std::string res;
+		while (true)
+		{
+			const auto packet = detail::read_rcon_packet(s, timeout_ms);
+			if (!packet)
+				{ return std::nullopt; }
+			if (packet->id != id || packet->type != detail::rcon_type_response)
+				{ continue; }  // a late response to an earlier command
+			res += packet->body;
+			// the server has no way to say the response is complete, but only splits it into full packets
+			if (packet->body.size() < detail::rcon_max_response_body)
+				{ return res; }
+		}
+	}
+
+	// @return names of the players online, separated by ", " (see detail::split_player_list), or nullopt if /list failed
+	[[nodiscard]] std::optional<std::string> list_players()
+	{
+		// "There are x of a max of y players online: a, b", or with older servers "There are x/y players online:" and the names on the next line
+		auto res = command("list");
+		if (!res)
+			{ return std::nullopt; }
+		const std::size_t colon = res->find(':');
+		if (colon == std::string::npos)
+			{ return std::nullopt; }
+		res->erase(0, std::min(res->find_first_not_of(" \t\r\n", colon + 1), res->size()));
+		res->erase(std::min(res->find_last_not_of(" \t\r\n") + 1, res->size()));
+		return res;
+	}
+};
+
+#endif
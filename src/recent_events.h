@@ -0,0 +1,138 @@
+#ifndef RECENT_EVENTS_H
+#define RECENT_EVENTS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "parse_logs.h"
+
+// a join, leave, server start or server stop, as kept by recent_event_ring
+struct recent_event
+{
+	static constexpr std::size_t max_name_size = 24;  // longer names are cut (minecraft's are at most 16 characters)
+
+	log_event_type type;
+	std::chrono::system_clock::time_point time;
+	std::array<char, max_name_size> name_data{};
+	std::uint8_t name_size = 0;
+
+	// @return name of the player, empty for server starts and stops
+	[[nodiscard]] std::string_view name() const noexcept
+		{ return std::string_view(name_data.data(), name_size); }
+};
+
+// the last `capacity` events of a server, for /recent. the log reading loop writes them and commands read them at the same time without locks:
+// each slot is a seqlock whose sequence number is odd while it's being written, so a reader copies a slot and keeps the copy only if the number
+// was even and didn't change. readers never wait for the writer, and the writer never waits at all
+// there must only be one writer, since the slot after the last one written is taken without a read-modify-write
+class recent_event_ring
+{
+public:
+	static constexpr std::size_t capacity = 256;
+
+private:
+	static constexpr std::size_t name_words = recent_event::max_name_size / sizeof(std::uint64_t);
+
+	// fields are atomics of their own (read and written relaxed), so copying a slot that is being written is a stale read rather than a data race
+	struct slot
+	{
+		std::atomic<std::uint64_t> seq = 0;  // 2 * (index of the event) + 2 once it's written, odd while writing
+		std::atomic<std::int64_t> time = 0;  // system_clock ticks
+		std::atomic<std::uint32_t> type_size = 0;  // type, and the size of the name shifted by 8
+		std::array<std::atomic<std::uint64_t>, name_words> name{};
+	};
+
+	std::array<slot, capacity> slots;
+	std::atomic<std::uint64_t> written = 0;  // events written, the last capacity of which are in slots
+	std::chrono::system_clock::time_point last_time = std::chrono::system_clock::time_point::min();  // of the last event written, only used by the writer
+
+public:
+	// add an event, which replaces the oldest one once the ring is full
+	void push(log_event_type type, std::chrono::system_clock::time_point time, std::string_view name) noexcept
+	{
+		const std::uint64_t ind = written.load(std::memory_order_relaxed);
+		slot& cur = slots[ind % capacity];
+		cur.seq.store(2 * ind + 1, std::memory_order_relaxed);
+		// readers that see a field written below also see that the slot is being written
+		std::atomic_thread_fence(std::memory_order_release);
+
+		name = name.substr(0, recent_event::max_name_size);
+		std::array<std::uint64_t, name_words> words{};
+		std::memcpy(words.data(), name.data(), name.size());
+		cur.time.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+		cur.type_size.store(static_cast<std::uint32_t>(type) | static_cast<std::uint32_t>(name.size() << 8), std::memory_order_relaxed);
+		for (std::size_t i = 0; i < name_words; i++)
+			{ cur.name[i].store(words[i], std::memory_order_relaxed); }
+
+		cur.seq.store(2 * ind + 2, std::memory_order_release);
+		written.store(ind + 1, std::memory_order_release);
+		last_time = time;
+	}
+
+	// @return time of the last event pushed, only for the writer (see recent_event_collector::replay)
+	[[nodiscard]] std::chrono::system_clock::time_point last_pushed() const noexcept
+		{ return last_time; }
+
+	// copy the events, newest first, stopping at the first one older than `since`
+	// events being overwritten while this reads them are left out, so what is returned is always whole events in order
+	// @return at most capacity events
+	[[nodiscard]] std::vector<recent_event> read(std::chrono::system_clock::time_point since) const
+	{
+		std::vector<recent_event> res;
+		const std::uint64_t end = written.load(std::memory_order_acquire);
+		const std::uint64_t begin = end - std::min<std::uint64_t>(end, capacity);
+		for (std::uint64_t ind = end; ind-- > begin;)
+		{
+			const slot& cur = slots[ind % capacity];
+			const std::uint64_t seq = cur.seq.load(std::memory_order_acquire);
+			if (seq != 2 * ind + 2)
+				{ break; }  // the writer got to it, so it and the ones before are gone
+			recent_event event;
+			event.time = std::chrono::system_clock::time_point(std::chrono::system_clock::duration(cur.time.load(std::memory_order_relaxed)));
+			const std::uint32_t type_size = cur.type_size.load(std::memory_order_relaxed);
+			std::array<std::uint64_t, name_words> words;
+			for (std::size_t i = 0; i < name_words; i++)
+				{ words[i] = cur.name[i].load(std::memory_order_relaxed); }
+			// the fields must be read before the sequence number is checked again
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (cur.seq.load(std::memory_order_relaxed) != seq)
+				{ break; }
+			if (event.time < since)
+				{ break; }
+			event.type = static_cast<log_event_type>(type_size & 0xff);
+			event.name_size = static_cast<std::uint8_t>(type_size >> 8);
+			std::memcpy(event.name_data.data(), words.data(), event.name_data.size());
+			res.push_back(event);
+		}
+		return res;
+	}
+};
+
+// consumer of log events (see combine_consumers) that pushes joins, leaves, server starts and stops to a ring
+struct recent_event_collector
+{
+	recent_event_ring* ring;
+	// events until this were pushed before the log was read again (see replay), so they're skipped
+	std::chrono::system_clock::time_point skip_until = std::chrono::system_clock::time_point::min();
+
+	// the log is about to be read again from an earlier point (e.g. after a rollback)
+	// events at the time of the last one pushed are all skipped, even those that weren't pushed yet
+	void replay() noexcept
+		{ skip_until = ring->last_pushed(); }
+
+	void operator()(const log_event& event) const noexcept
+	{
+		if (event.type == log_event_type::uuid_bind || event.type == log_event_type::lag || event.time <= skip_until)
+			{ return; }
+		ring->push(event.type, event.time, event.player);
+	}
+};
+
+#endif
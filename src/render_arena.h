@@ -0,0 +1,116 @@
+#ifndef RENDER_ARENA_H
+#define RENDER_ARENA_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace detail
+{
+	// memory for what a render allocates and frees again before it returns (graph rows, the elements a png writer records, ...)
+	// each thread keeps a buffer for it between renders, which a render takes memory from by moving a pointer, and gives back all at once
+	// when it's done. so renders don't allocate from the global heap once the buffer is as large as they need, and renders on
+	// several threads don't contend on the allocator
+	class render_arena
+	{
+	private:
+		static constexpr std::size_t initial_bytes = 64 << 10;
+		static constexpr std::size_t max_kept_bytes = 16 << 20;  // a larger buffer isn't kept after the render that needed it
+
+		// where the arena gets memory once its buffer is used up, which counts how much it needed
+		class overflow_resource : public std::pmr::memory_resource
+		{
+		public:
+			std::size_t bytes = 0;
+
+		private:
+			void* do_allocate(std::size_t size, std::size_t alignment) override
+			{
+				bytes += size;
+				return std::pmr::new_delete_resource()->allocate(size, alignment);
+			}
+			void do_deallocate(void* ptr, std::size_t size, std::size_t alignment) override
+				{ std::pmr::new_delete_resource()->deallocate(ptr, size, alignment); }
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+				{ return this == &other; }
+		};
+
+		std::unique_ptr<std::byte[]> buffer;
+		std::size_t buffer_size = 0;
+		overflow_resource overflow;
+		std::optional<std::pmr::monotonic_buffer_resource> resource;  // while a scope exists
+		std::size_t num_scopes = 0;
+
+		render_arena() = default;
+
+		[[nodiscard]] static render_arena& get()
+		{
+			thread_local render_arena instance;
+			return instance;
+		}
+
+		std::pmr::memory_resource* enter()
+		{
+			if (num_scopes++ == 0)
+			{
+				if (!buffer)
+				{
+					buffer_size = initial_bytes;
+					buffer = std::make_unique_for_overwrite<std::byte[]>(buffer_size);
+				}
+				resource.emplace(buffer.get(), buffer_size, &overflow);
+			}
+			return &resource.value();
+		}
+
+		void leave() noexcept
+		{
+			if (--num_scopes != 0)
+				{ return; }
+			resource.reset();
+			// the next render most likely needs about as much, so the buffer grows to fit all of this one
+			if (overflow.bytes != 0)
+			{
+				const std::size_t needed = std::bit_ceil(buffer_size + overflow.bytes);
+				buffer.reset();
+				buffer_size = 0;
+				if (needed <= max_kept_bytes)
+				{
+					buffer_size = needed;
+					buffer = std::unique_ptr<std::byte[]>(new (std::nothrow) std::byte[buffer_size]);
+					if (!buffer)
+						{ buffer_size = 0; }
+				}
+				overflow.bytes = 0;
+			}
+		}
+
+	public:
+		render_arena(const render_arena&) = delete;
+		render_arena& operator=(const render_arena&) = delete;
+
+		// the calling thread's arena, for as long as this exists. scopes can be nested (e.g. a graph rendered as part of another),
+		// and the memory is only given back when the outermost one is destroyed, so nothing allocated from it may outlive that
+		class scope
+		{
+		private:
+			std::pmr::memory_resource* memory;
+
+		public:
+			scope() : memory(get().enter()) {}
+			scope(const scope&) = delete;
+			scope& operator=(const scope&) = delete;
+			~scope()
+				{ get().leave(); }
+
+			// @return resource to allocate from, only on this thread
+			[[nodiscard]] std::pmr::memory_resource* resource() const noexcept
+				{ return memory; }
+		};
+	};
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef RENDER_EXECUTOR_H
+#define RENDER_EXECUTOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// runs graph renders on its own threads, so a slow render doesn't hold up the threads handling discord events
+// the queue is bounded so a burst of commands can't pile up unbounded work (or memory)
+class render_executor
+{
+public:
+	// called with expired = true instead of running if the job's deadline passed before it was started
+	// (or the executor was destroyed first), so the submitter is always notified exactly once
+	using job_t = std::function<void(bool expired)>;
+
+private:
+	struct queued_job
+	{
+		std::chrono::steady_clock::time_point deadline;
+		job_t job;
+	};
+
+	std::size_t max_queued;  // max number of jobs waiting to be started (not counting running ones)
+	std::deque<queued_job> jobs;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable job_cv;
+	std::vector<std::jthread> workers;
+
+	void worker_loop(const std::function<void()>& thread_init)
+	{
+		if (thread_init)
+			{ thread_init(); }
+		while (true)
+		{
+			queued_job cur;
+			{
+				std::unique_lock lock(mutex);
+				job_cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping)
+					{ return; }
+				cur = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			// a render can't be interrupted once started, so expiry is only checked here
+			cur.job(std::chrono::steady_clock::now() >= cur.deadline);
+		}
+	}
+
+public:
+	// @param num_workers  number of render threads
+	// @param max_queued  max number of jobs waiting for a thread
+	// @param thread_init  called on each render thread before it runs any job (e.g. to load per-thread caches), may be empty
+	render_executor(std::size_t num_workers, std::size_t max_queued, std::function<void()> thread_init = {}) : max_queued(max_queued)
+	{
+		for (std::size_t i = 0; i < num_workers; i++)
+			{ workers.emplace_back([this, thread_init]() { worker_loop(thread_init); }); }
+	}
+	render_executor(const render_executor&) = delete;
+	render_executor& operator=(const render_executor&) = delete;
+	~render_executor()
+	{
+		std::deque<queued_job> cancelled;
+		{
+			std::scoped_lock lock(mutex);
+			stopping = true;
+			cancelled = std::move(jobs);
+		}
+		job_cv.notify_all();
+		for (auto& [deadline, job] : cancelled)
+			{ job(true); }
+		// jthreads are joined on destruction
+	}
+
+	// queue `job` to be run on a render thread
+	// @param deadline  time after which the result is useless (e.g. the interaction token expired)
+	// @return false if the queue is full, in which case `job` is not called at all
+	[[nodiscard]] bool submit(std::chrono::steady_clock::time_point deadline, job_t job)
+	{
+		{
+			std::scoped_lock lock(mutex);
+			if (stopping || jobs.size() >= max_queued)
+				{ return false; }
+			jobs.emplace_back(deadline, std::move(job));
+		}
+		job_cv.notify_one();
+		return true;
+	}
+};
+
+#endif
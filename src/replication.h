@@ -0,0 +1,545 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include "binary_io.h"
+#include "handoff.h"
+#include "logger.h"
+#include "net_socket.h"
+#include "published_data.h"
+#include "snapshot.h"
+
+// serving queries and renders from other processes (e.g. the http server on another host), so that load isn't on the host of the minecraft server
+// the bot that reads the logs (the primary) listens for replicas (replication_publisher). a replica connects to it (replication_client) and gets the
+// published data of each server, then an update each time it is published again, and serves from that instead of reading logs
+// an update only has the history segments the replica doesn't have yet: segments never change (see session_history), and the primary's are
+// kept in order, so the replica keeps the ones it already has and adds the new ones. latest.log's data and the parse context are small and sent whole
+// replicas may be on other hosts, so the bot token is never sent: the primary sends a challenge with a random nonce on each connection,
+// and only a replica that answers with the challenge's HMAC keyed with the bot token (so a process with the config) gets the data
+// protocol: primary sends "QCV2REPL <version> <byte order> <nonce>", replica sends the hex HMAC-SHA256 of that line, then the primary sends updates, each an update_header and a payload of
+// server name, generation, files loaded and total, segments kept and new segments (session_store::write), lag and uptime series (each either kept or new),
+// then the parse context (as in a snapshot) and latest.log's sessions (as in a resume point)
+namespace detail
+{
+	inline constexpr std::string_view replication_hello = "QCV2REPL";
+	// increment when the layout of updates (or anything they have, e.g. session_store) changes
+	inline constexpr std::uint32_t replication_version = 3;
+	inline constexpr std::size_t replication_nonce_size = 16;
+
+	struct replication_update_header
+	{
+		std::uint64_t payload_size;
+	};
+
+	// @return start of the challenge line, which a replica checks to be of the same version and byte order
+	[[nodiscard]] inline std::string replication_hello_prefix()
+		{ return std::format("{} {} {:08x} ", replication_hello, replication_version, snapshot_byte_order); }
+
+	// @return challenge line a primary sends to a new replica (without the newline), nullopt if there's no randomness for the nonce
+	[[nodiscard]] inline std::optional<std::string> replication_challenge_line()
+	{
+		std::array<unsigned char, replication_nonce_size> nonce;
+		if (RAND_bytes(nonce.data(), static_cast<int>(nonce.size())) != 1)
+			{ return std::nullopt; }
+		std::string line = replication_hello_prefix();
+		for (const unsigned char byte : nonce)
+			{ line += std::format("{:02x}", byte); }
+		return line;
+	}
+
+	// @return response to `challenge` a replica with `token` sends, and a primary with it expects (without the newline)
+	[[nodiscard]] inline std::string replication_response(std::string_view token, std::string_view challenge)
+	{
+		std::array<unsigned char, EVP_MAX_MD_SIZE> mac;
+		unsigned int mac_size = 0;
+		HMAC(EVP_sha256(), token.data(), static_cast<int>(token.size()), reinterpret_cast<const unsigned char*>(challenge.data()), challenge.size(),
+			mac.data(), &mac_size);
+		std::string res;
+		for (unsigned int i = 0; i < mac_size; i++)
+			{ res += std::format("{:02x}", mac[i]); }
+		return res;
+	}
+
+	// write series shared between versions of the data (lag or uptime), each either kept from what the replica has (the same object) or in full
+	// @param prev  the series of what the replica has, null if it has nothing
+	template<typename series_t>
+	void write_shared_series(binary_writer& writer, const std::vector<std::shared_ptr<const series_t>>* prev, const std::vector<std::shared_ptr<const series_t>>& cur)
+	{
+		writer.write<std::uint64_t>(cur.size());
+		for (std::size_t i = 0; i < cur.size(); i++)
+		{
+			const bool kept = (prev && i < prev->size() && (*prev)[i] == cur[i]);
+			writer.write<std::uint8_t>(kept);
+			if (!kept)
+				{ cur[i]->write(writer); }
+		}
+	}
+
+	// read what write_shared_series wrote
+	// @return true on success
+	template<typename series_t>
+	[[nodiscard]] bool read_shared_series(binary_reader& reader, const std::vector<std::shared_ptr<const series_t>>* prev, std::vector<std::shared_ptr<const series_t>>& res)
+	{
+		std::uint64_t num;
+		if (!reader.read(num) || num > reader.remaining())
+			{ return false; }
+		res.resize(num);
+		for (std::size_t i = 0; i < res.size(); i++)
+		{
+			std::uint8_t kept;
+			if (!reader.read(kept))
+				{ return false; }
+			if (kept)
+			{
+				if (!prev || i >= prev->size())
+					{ return false; }
+				res[i] = (*prev)[i];
+				continue;
+			}
+			auto series = std::make_shared<series_t>();
+			if (!series->read(reader))
+				{ return false; }
+			res[i] = std::move(series);
+		}
+		return true;
+	}
+
+	// write the update that makes `prev` (what the replica has, null if it has nothing) into `cur`, with its header, to `out`
+	inline void write_replication_update(std::string& out, std::string_view server_name, const published_data_t* prev, const published_data_t& cur)
+	{
+		const std::size_t header_offset = out.size();
+		out.resize(header_offset + sizeof(replication_update_header));
+		// written to its own string, since columns are aligned relative to the start of the payload
+		std::string payload;
+		binary_writer writer(payload);
+		writer.write_string(server_name);
+		writer.write<std::uint64_t>(cur.generation);
+		writer.write<std::uint64_t>(cur.files_loaded);
+		writer.write<std::uint64_t>(cur.files_total);
+
+		const auto segments = cur.history.get_segments();
+		const auto prev_segments = prev ? prev->history.get_segments() : decltype(segments)();
+		const std::size_t num_kept = static_cast<std::size_t>(std::ranges::mismatch(segments, prev_segments).in1 - segments.begin());
+		writer.write<std::uint64_t>(num_kept);
+		writer.write<std::uint64_t>(segments.size() - num_kept);
+		for (std::size_t i = num_kept; i < segments.size(); i++)
+			{ segments[i]->write(writer); }
+
+		write_shared_series(writer, prev ? &prev->lag : nullptr, cur.lag);
+		write_shared_series(writer, prev ? &prev->uptime : nullptr, cur.uptime);
+		// the manifest and format aren't needed to serve from
+		write_snapshot_metadata(writer, {}, log_format::vanilla, cur.ctx);
+		write_log_data(writer, cur.recent);
+
+		const replication_update_header header{ payload.size() };
+		std::memcpy(out.data() + header_offset, &header, sizeof(header));
+		out += payload;
+	}
+
+	// read an update written by write_replication_update, after its server name has been read from `reader`
+	// @param prev  what the primary made the update from, null if there was nothing
+	// @param backing  holds the payload, which the new segments view
+	// @return data after the update, or nullopt if it is malformed or doesn't go with `prev`
+	[[nodiscard]] inline std::optional<published_data_t> read_replication_update(binary_reader& reader, const published_data_t* prev,
+		std::shared_ptr<const void> backing)
+	{
+		published_data_t res{};
+		std::uint64_t files_loaded, files_total, num_kept, num_new;
+		if (!reader.read(res.generation) || !reader.read(files_loaded) || !reader.read(files_total) || !reader.read(num_kept) || !reader.read(num_new) ||
+			num_kept > (prev ? prev->history.get_segments().size() : 0) || num_new > reader.remaining())
+			{ return std::nullopt; }
+		res.files_loaded = static_cast<std::size_t>(files_loaded);
+		res.files_total = static_cast<std::size_t>(files_total);
+
+		std::vector<std::shared_ptr<const session_store>> segments;
+		segments.reserve(num_kept + num_new);
+		if (prev)
+			{ segments.assign(prev->history.get_segments().begin(), prev->history.get_segments().begin() + static_cast<std::ptrdiff_t>(num_kept)); }
+		for (std::uint64_t i = 0; i < num_new; i++)
+		{
+			session_store segment;
+			if (!segment.read(reader, backing))
+				{ return std::nullopt; }
+			segments.push_back(std::make_shared<const session_store>(std::move(segment)));
+		}
+		res.history = session_history(std::move(segments));
+
+		if (!read_shared_series(reader, prev ? &prev->lag : nullptr, res.lag) || !read_shared_series(reader, prev ? &prev->uptime : nullptr, res.uptime))
+			{ return std::nullopt; }
+
+		std::vector<log_manifest_entry> manifest;
+		log_format format;
+		if (!read_snapshot_metadata(reader, {}, manifest, format, res.ctx) || !read_log_data(reader, res.recent) || reader.remaining() != 0)
+			{ return std::nullopt; }
+		return res;
+	}
+}
+
+// on the primary: sends the published data of its servers to replicas that connect, and updates whenever it is published again
+// replicas are sent to on one thread, without blocking, and only get the latest data once they have taken what was sent before,
+// so a slow replica skips versions instead of holding up the others (or making the bot queue every version for it)
+class replication_publisher
+{
+public:
+	// @return name (empty if it is the only one) and latest published data (null if there is none yet) of each server
+	using get_published_t = std::function<std::vector<std::pair<std::string, std::shared_ptr<const published_data_t>>>()>;
+
+private:
+	using socket_t = detail::socket_t;
+	static constexpr int poll_ms = 250;  // how often published data is checked for changes
+	static constexpr std::chrono::seconds response_timeout{ 5 };  // for a new replica to answer the challenge
+	static constexpr std::size_t max_response_size = 256;
+	static constexpr std::size_t max_replicas = 16;  // more connections (including those not answered yet) are closed right away
+
+	struct replica_t
+	{
+		socket_t socket;
+		std::string expected;  // response to the challenge, empty once it was answered
+		std::string in;  // of the response, received so far
+		std::chrono::steady_clock::time_point deadline;  // to answer by
+		std::string out;  // not sent yet, from out_offset
+		std::size_t out_offset = 0;
+		std::map<std::string, std::shared_ptr<const published_data_t>, std::less<>> sent;  // latest data sent of each server
+	};
+
+	std::string token;
+	get_published_t get_published;
+	socket_t listener = detail::invalid_socket;
+	std::vector<replica_t> replicas;
+	std::vector<detail::pollfd_t> poll_fds;  // listener, then replicas
+	std::atomic<bool> stopping = false;
+	std::thread thread;
+
+	void accept_replica()
+	{
+		const socket_t client = accept(listener, nullptr, nullptr);
+		if (client == detail::invalid_socket)
+			{ return; }
+		if (replicas.size() >= max_replicas)
+		{
+			log_message(log_severity::warning, std::format("Refusing a replica, there are already {}", max_replicas));
+			detail::close_socket(client);
+			return;
+		}
+		// the response is read by run() like everything else, so a replica that doesn't answer doesn't hold up the others
+		const auto challenge = detail::replication_challenge_line();
+		if (!challenge || !detail::set_nonblocking(client))
+		{
+			log_message(log_severity::error, "Could not send a challenge to a replica");
+			detail::close_socket(client);
+			return;
+		}
+		replicas.push_back({ .socket = client, .expected = detail::replication_response(token, challenge.value()),
+			.deadline = std::chrono::steady_clock::now() + response_timeout, .out = challenge.value() + "\n" });
+	}
+
+	// read the response to the challenge of a replica that hasn't answered it yet, once it's complete the replica gets data
+	// @return false if the response is wrong or late, or the replica hung up
+	[[nodiscard]] static bool authenticate(replica_t& replica, short revents)
+	{
+		if (revents & POLLIN)
+		{
+			std::array<char, max_response_size> buf;
+			const auto num_received = recv(replica.socket, buf.data(), static_cast<int>(buf.size()), 0);
+			if (num_received <= 0)
+				{ return false; }
+			replica.in.append(buf.data(), static_cast<std::size_t>(num_received));
+		}
+		else if (revents & (POLLERR | POLLHUP))
+			{ return false; }
+		const auto end = replica.in.find('\n');
+		if (end == std::string::npos)
+			{ return replica.in.size() < max_response_size && std::chrono::steady_clock::now() < replica.deadline; }
+		// replicas send nothing after the response. compared in constant time, so timing doesn't tell how much of a guess was right
+		if (end + 1 != replica.in.size() || end != replica.expected.size() || CRYPTO_memcmp(replica.in.data(), replica.expected.data(), end) != 0)
+		{
+			log_message(log_severity::warning, "Refusing a replica that didn't answer the challenge with the bot's token (is it using another config or version?)");
+			return false;
+		}
+		log_message(log_severity::info, "A replica connected, sending it the published data");
+		replica.expected.clear();
+		replica.in.clear();
+		return true;
+	}
+
+	// queue updates for the servers whose data changed since it was last sent to `replica`
+	void queue_updates(replica_t& replica, const std::vector<std::pair<std::string, std::shared_ptr<const published_data_t>>>& published)
+	{
+		for (const auto& [name, data] : published)
+		{
+			if (!data)
+				{ continue; }
+			auto& sent = replica.sent[name];
+			if (sent == data)
+				{ continue; }
+			detail::write_replication_update(replica.out, name, sent.get(), *data);
+			sent = data;
+		}
+	}
+
+	// @return false if the replica hung up
+	[[nodiscard]] static bool flush(replica_t& replica)
+	{
+		while (replica.out_offset < replica.out.size())
+		{
+			const auto sent = detail::send_some(replica.socket, std::string_view(replica.out).substr(replica.out_offset));
+			if (!sent)
+				{ return false; }
+			if (sent.value() == 0)
+				{ return true; }
+			replica.out_offset += sent.value();
+		}
+		replica.out.clear();
+		replica.out_offset = 0;
+		return true;
+	}
+
+	void run()
+	{
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			poll_fds.resize(replicas.size() + 1);
+			poll_fds[0] = { .fd = listener, .events = POLLIN };
+			for (std::size_t i = 0; i < replicas.size(); i++)
+			{
+				// replicas send nothing after the response to the challenge, so readable means they hung up
+				poll_fds[i + 1] = { .fd = replicas[i].socket, .events = static_cast<short>(POLLIN | (replicas[i].out.empty() ? 0 : POLLOUT)) };
+			}
+			if (detail::poll_sockets(poll_fds.data(), poll_fds.size(), poll_ms) < 0)
+				{ continue; }
+
+			const auto published = get_published();
+			for (std::size_t i = replicas.size(); i-- > 0;)
+			{
+				replica_t& replica = replicas[i];
+				const bool authenticated = replica.expected.empty();
+				bool ok;
+				if (!authenticated)
+					{ ok = flush(replica) && authenticate(replica, poll_fds[i + 1].revents); }
+				else
+				{
+					ok = !(poll_fds[i + 1].revents & (POLLIN | POLLERR | POLLHUP));
+					if (ok && replica.out.empty())
+						{ queue_updates(replica, published); }
+					ok = ok && flush(replica);
+				}
+				if (!ok)
+				{
+					if (authenticated)
+						{ log_message(log_severity::info, "A replica disconnected"); }
+					detail::close_socket(replica.socket);
+					replicas.erase(replicas.begin() + static_cast<std::ptrdiff_t>(i));
+				}
+			}
+			if (poll_fds[0].revents & POLLIN)
+				{ accept_replica(); }
+		}
+	}
+
+	void cleanup() noexcept
+	{
+		for (const replica_t& replica : replicas)
+			{ detail::close_socket(replica.socket); }
+		replicas.clear();
+		if (listener != detail::invalid_socket)
+		{
+			detail::close_socket(listener);
+			listener = detail::invalid_socket;
+		}
+		detail::cleanup_sockets();
+	}
+
+public:
+	// @param token  bot token, which replicas have to have
+	// @param get_published  called on the publisher's thread
+	// @throws std::runtime_error if `address`:`port` can't be listened on
+	replication_publisher(const std::string& address, std::uint16_t port, std::string token, get_published_t get_published) :
+		token(std::move(token)), get_published(std::move(get_published))
+	{
+		if (!detail::init_sockets())
+			{ throw std::runtime_error("Could not initialize sockets for replication"); }
+		listener = detail::bind_socket(address, port, SOCK_STREAM);
+		if (listener == detail::invalid_socket)
+		{
+			cleanup();
+			throw std::runtime_error(std::format("Could not listen for replicas on {}:{}", address, port));
+		}
+		log_message(log_severity::info, std::format("Listening for replicas on {}:{}", address, port));
+		thread = std::thread([this]() { run(); });
+	}
+	replication_publisher(const replication_publisher&) = delete;
+	replication_publisher& operator=(const replication_publisher&) = delete;
+	~replication_publisher()
+	{
+		stopping = true;
+		if (thread.joinable())
+			{ thread.join(); }
+		cleanup();
+	}
+};
+
+// on a replica: receives the published data of the primary's servers, and reconnects whenever the connection is lost
+// until the first connection, nothing is published, after that the latest data received stays published while reconnecting
+class replication_client
+{
+public:
+	// called on the client's thread with each server's data as it is received
+	using on_update_t = std::function<void(std::string_view server_name, std::shared_ptr<const published_data_t> data)>;
+
+private:
+	using socket_t = detail::socket_t;
+	static constexpr int stop_check_ms = 500;  // how often the thread checks whether to stop while waiting
+	static constexpr std::chrono::seconds retry_delay{ 5 };
+	static constexpr int challenge_timeout_ms = 5000;  // for the primary to send the challenge
+	// an update larger than this is treated as corrupt, since the payload is allocated before it's received.
+	// the first update of a server has its whole history, at 20 bytes per session (see session_store::write), so this allows some 50 million
+	static constexpr std::uint64_t max_payload_size = std::uint64_t(1) << 30;
+
+	std::string address;
+	std::uint16_t port;
+	std::string token;
+	on_update_t on_update;
+	std::atomic<bool> stopping = false;
+	std::thread thread;
+
+	// read exactly `size` bytes into `out`
+	// @return false if the primary hung up, or stopping was set
+	[[nodiscard]] bool read_exact(socket_t s, char* out, std::size_t size) const
+	{
+		std::size_t received = 0;
+		while (received < size)
+		{
+			if (stopping.load(std::memory_order_relaxed))
+				{ return false; }
+			const int res = detail::poll_socket(s, stop_check_ms);
+			if (res == 0)
+				{ continue; }
+			const int chunk = static_cast<int>(std::min<std::size_t>(size - received, 1 << 20));
+			const auto num_received = (res > 0) ? recv(s, out + received, chunk, 0) : -1;
+			if (num_received <= 0)
+				{ return false; }
+			received += static_cast<std::size_t>(num_received);
+		}
+		return true;
+	}
+
+	// receive updates until the connection is lost
+	// @param latest  data of each server after the updates received so far on this connection
+	void receive(socket_t s, std::map<std::string, std::shared_ptr<const published_data_t>, std::less<>>& latest) const
+	{
+		while (true)
+		{
+			detail::replication_update_header header;
+			if (!read_exact(s, reinterpret_cast<char*>(&header), sizeof(header)))
+				{ return; }
+			if (header.payload_size > max_payload_size)
+			{
+				log_message(log_severity::error, std::format("Replication update of {} bytes is too large, reconnecting", header.payload_size));
+				return;
+			}
+			// new segments view the payload, so it is kept as long as they are
+			auto payload = std::make_shared<std::string>();
+			payload->resize_and_overwrite(header.payload_size, [](char*, std::size_t size) { return size; });
+			if (!read_exact(s, payload->data(), payload->size()))
+				{ return; }
+
+			detail::binary_reader reader(*payload);
+			std::string server_name;
+			if (!reader.read_string(server_name))
+			{
+				log_message(log_severity::error, "Malformed replication update, reconnecting");
+				return;
+			}
+			auto& cur = latest[server_name];
+			auto data = detail::read_replication_update(reader, cur.get(), payload);
+			if (!data)
+			{
+				log_message(log_severity::error, "Malformed replication update, reconnecting");
+				return;
+			}
+			cur = std::make_shared<const published_data_t>(std::move(data.value()));
+			on_update(server_name, cur);
+		}
+	}
+
+	void run()
+	{
+		bool connected_before = false;
+		while (!stopping.load(std::memory_order_relaxed))
+		{
+			const socket_t s = detail::connect_socket(address, port);
+			const auto challenge = (s != detail::invalid_socket) ? detail::read_handoff_line(s, challenge_timeout_ms) : std::nullopt;
+			if (challenge && !challenge->starts_with(detail::replication_hello_prefix()))
+			{
+				log_message(log_severity::error, std::format("The primary at {}:{} is of another version or byte order, retrying in {}", address, port, retry_delay));
+			}
+			else if (challenge && detail::send_all(s, detail::replication_response(token, challenge.value()) + "\n"))
+			{
+				log_message(log_severity::info, std::format("Replicating from {}:{}", address, port));
+				connected_before = true;
+				// the primary sends everything again on a new connection
+				std::map<std::string, std::shared_ptr<const published_data_t>, std::less<>> latest;
+				receive(s, latest);
+				if (!stopping.load(std::memory_order_relaxed))
+				{
+					log_message(log_severity::warning, std::format("Lost the connection to the primary at {}:{} (is it running with the same bot token and version?), "
+						"retrying in {}", address, port, retry_delay));
+				}
+			}
+			else if (!connected_before)
+				{ log_message(log_severity::warning, std::format("Could not connect to the primary at {}:{}, retrying in {}", address, port, retry_delay)); }
+			if (s != detail::invalid_socket)
+				{ detail::close_socket(s); }
+			const auto retry_tp = std::chrono::steady_clock::now() + retry_delay;
+			while (!stopping.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < retry_tp)
+				{ std::this_thread::sleep_for(std::chrono::milliseconds(stop_check_ms)); }
+		}
+	}
+
+public:
+	// @param address  ipv4 address of the primary
+	// @param port  that the primary's replication_publisher listens on
+	// @param token  bot token, the same as the primary's
+	// @throws std::runtime_error if sockets can't be used
+	replication_client(std::string address, std::uint16_t port, std::string token, on_update_t on_update) :
+		address(std::move(address)), port(port), token(std::move(token)), on_update(std::move(on_update))
+	{
+		if (!detail::init_sockets())
+			{ throw std::runtime_error("Could not initialize sockets for replication"); }
+		thread = std::thread([this]() { run(); });
+	}
+	replication_client(const replication_client&) = delete;
+	replication_client& operator=(const replication_client&) = delete;
+	~replication_client()
+	{
+		stopping = true;
+		if (thread.joinable())
+			{ thread.join(); }
+		detail::cleanup_sockets();
+	}
+};
+
+#endif
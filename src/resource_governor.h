@@ -0,0 +1,144 @@
+#ifndef RESOURCE_GOVERNOR_H
+#define RESOURCE_GOVERNOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#undef WIN32_LEAN_AND_MEAN
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#elif defined(__FreeBSD__)
+#include <sys/param.h>
+#include <sys/cpuset.h>
+#include <sys/rtprio.h>
+#endif
+
+// how much of the machine the bot's background work may take, since it usually runs next to the minecraft server, whose tick loop
+// shouldn't lose cores to bursts of parsing (reading history at startup) or rendering
+// set once at startup before anything is parsed or rendered, then only read by the threads doing that work
+struct resource_limits_t
+{
+	unsigned parse_threads = 0;  // threads scanning logs in parallel, 0 for one per core
+	std::vector<unsigned> parse_cpus;  // cpus the scanning threads run on, empty for any
+	bool parse_background = false;  // run the scanning threads at the lowest priority, so they only use otherwise idle cpu time
+	std::vector<unsigned> render_cpus;  // cpus graphs are rendered on (render threads and png_encoder's band_pool), empty for any
+};
+
+namespace detail
+{
+	[[nodiscard]] inline resource_limits_t& resource_limits_storage() noexcept
+	{
+		static resource_limits_t limits;
+		return limits;
+	}
+
+	// restrict the calling thread to `cpus` (indices as numbered by the os), threads it starts afterwards inherit it on linux and freebsd
+	// not supported on macos, which has no affinity, only hints
+	// @return false if it couldn't be set (e.g. none of the cpus exist), in which case the thread can run on any
+	inline bool set_thread_affinity(std::span<const unsigned> cpus) noexcept
+	{
+		if (cpus.empty())
+			{ return true; }
+#ifdef _WIN32
+		// only the thread's processor group (the first 64 cpus unless it was moved)
+		DWORD_PTR mask = 0;
+		for (const unsigned cpu : cpus)
+		{
+			if (cpu < sizeof(DWORD_PTR) * 8)
+				{ mask |= DWORD_PTR(1) << cpu; }
+		}
+		return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (const unsigned cpu : cpus)
+		{
+			if (cpu < CPU_SETSIZE)
+				{ CPU_SET(cpu, &set); }
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(__FreeBSD__)
+		cpuset_t set;
+		CPU_ZERO(&set);
+		for (const unsigned cpu : cpus)
+		{
+			if (cpu < CPU_SETSIZE)
+				{ CPU_SET(cpu, &set); }
+		}
+		return cpuset_setaffinity(CPU_LEVEL_WHICH, CPU_WHICH_TID, -1, sizeof(set), &set) == 0;
+#else
+		return false;
+#endif
+	}
+
+	// lower the calling thread's cpu (and where possible io) priority so it only runs when nothing else wants to. can't be undone,
+	// so only for threads that do nothing else (e.g. scan_pipeline's workers)
+	// linux: SCHED_IDLE and the idle io class, or nice 19 if that isn't allowed. windows: background mode. macos: background qos
+	// @return false if the priority couldn't be lowered
+	inline bool set_thread_background() noexcept
+	{
+#ifdef _WIN32
+		return SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN) != 0;
+#elif defined(__linux__)
+		// ioprio_set(IOPRIO_WHO_PROCESS, this thread, IOPRIO_CLASS_IDLE), which glibc has no wrapper for
+		constexpr int ioprio_who_process = 1, ioprio_class_idle = 3, ioprio_class_shift = 13;
+		syscall(SYS_ioprio_set, ioprio_who_process, 0, ioprio_class_idle << ioprio_class_shift);
+		const sched_param param{};
+		if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) == 0)
+			{ return true; }
+		// per thread on linux, unlike posix
+		return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19) == 0;
+#elif defined(__APPLE__)
+		return pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0) == 0;
+#elif defined(__FreeBSD__)
+		rtprio prio{ RTP_PRIO_IDLE, RTP_PRIO_MAX };
+		return rtprio_thread(RTP_SET, 0, &prio) == 0;
+#else
+		return false;
+#endif
+	}
+
+	// @return number of threads to scan logs on, at least 1
+	[[nodiscard]] inline unsigned parse_thread_count() noexcept
+	{
+		const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+		const unsigned limit = resource_limits_storage().parse_threads;
+		return (limit == 0) ? cores : std::min(limit, cores);
+	}
+
+	// called at the start of each thread that only scans logs
+	inline void enter_parse_thread() noexcept
+	{
+		const resource_limits_t& limits = resource_limits_storage();
+		set_thread_affinity(limits.parse_cpus);
+		if (limits.parse_background)
+			{ set_thread_background(); }
+	}
+
+	// called at the start of each thread that renders graphs
+	inline void enter_render_thread() noexcept
+		{ set_thread_affinity(resource_limits_storage().render_cpus); }
+}
+
+// must be called before anything is parsed or rendered, since the threads doing that read the limits without synchronization
+inline void set_resource_limits(resource_limits_t limits)
+	{ detail::resource_limits_storage() = std::move(limits); }
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef SAMPLING_PROFILER_H
+#define SAMPLING_PROFILER_H
+
+// samples the stacks of the running threads with SIGPROF for a while, and writes them as folded stacks for a flame graph
+// (e.g. flamegraph.pl or speedscope), to see where a running bot spends its time without attaching perf
+// only used if QC_PROFILER is defined (see the QC_PROFILER cmake option), on linux
+// SAMPLING_PROFILER_AVAILABLE is only defined if it is used
+// nothing is installed while it isn't profiling, so it costs nothing until it is asked to
+
+#if defined(__linux__) && defined(QC_PROFILER)
+#define SAMPLING_PROFILER_AVAILABLE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+
+namespace detail
+{
+	class sampling_profiler
+	{
+	public:
+		static constexpr std::size_t max_depth = 64;  // frames of a sample, deeper ones are cut off at the root
+		static constexpr std::size_t max_samples = 1 << 15;  // about 17 MB, allocated while profiling
+
+		struct result_t
+		{
+			std::string folded;  // a line for each stack, "root;...;leaf count", most samples first
+			std::size_t samples;
+			std::size_t dropped;  // taken after the buffer was full
+		};
+
+	private:
+		struct sample_t
+		{
+			std::array<void*, max_depth> frames;
+			std::atomic<int> depth;  // 0 until the sample is complete
+		};
+
+		// the signal handler can't allocate or lock, so it writes samples here, claimed with taken
+		// set while profiling, so the handler finds it without anything that isn't async-signal-safe
+		static inline std::atomic<sample_t*> buffer = nullptr;
+		static inline std::atomic<std::size_t> capacity = 0;  // of buffer
+		static inline std::atomic<std::size_t> taken = 0;
+
+		std::mutex mutex;  // only one profile at a time, since SIGPROF and its timer are per process
+
+		static void on_signal(int /*signal*/)
+		{
+			sample_t* const samples = buffer.load(std::memory_order_acquire);
+			if (samples == nullptr)
+				{ return; }
+			const std::size_t index = taken.fetch_add(1, std::memory_order_relaxed);
+			if (index >= capacity.load(std::memory_order_relaxed))
+				{ return; }
+			sample_t& sample = samples[index];
+			const int depth = backtrace(sample.frames.data(), static_cast<int>(max_depth));
+			sample.depth.store(std::max(depth, 1), std::memory_order_release);
+		}
+
+		// @return name of the function at `address`, or the module and offset if it has no symbol (e.g. a static function)
+		[[nodiscard]] static std::string symbolize(void* address)
+		{
+			Dl_info info;
+			if (dladdr(address, &info) == 0)
+				{ return std::format("{}", address); }
+			std::string res;
+			if (info.dli_sname != nullptr)
+			{
+				int status = 0;
+				const std::unique_ptr<char, decltype(&std::free)> demangled(abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status), &std::free);
+				res = (status == 0) ? demangled.get() : info.dli_sname;
+			}
+			else
+			{
+				const std::string_view module = (info.dli_fname != nullptr) ? info.dli_fname : "?";
+				res = std::format("{}+{:#x}", module.substr(module.rfind('/') + 1),
+					reinterpret_cast<std::uintptr_t>(address) - reinterpret_cast<std::uintptr_t>(info.dli_fbase));
+			}
+			// ; separates frames in the folded format
+			std::ranges::replace(res, ';', ':');
+			return res;
+		}
+
+	public:
+		[[nodiscard]] static sampling_profiler& get()
+		{
+			static sampling_profiler instance;
+			return instance;
+		}
+
+		// sample the running threads `frequency` times per second of cpu time (of each core that is busy) for `duration`, blocking the calling thread
+		// @return folded stacks, or nullopt if another profile is running
+		[[nodiscard]] std::optional<result_t> profile(std::chrono::seconds duration, unsigned frequency = 99)
+		{
+			std::unique_lock lock(mutex, std::try_to_lock);
+			if (!lock.owns_lock())
+				{ return {}; }
+			// the timer counts the cpu time of all threads, so each busy core adds `frequency` samples per second
+			const std::size_t num_samples = std::min<std::size_t>(max_samples,
+				static_cast<std::size_t>(frequency) * static_cast<std::size_t>(duration.count()) * std::max(std::thread::hardware_concurrency(), 1u));
+			const auto samples = std::make_unique<sample_t[]>(num_samples);
+			// the first backtrace loads libgcc's unwinder, which allocates, so it isn't done in the signal handler
+			std::array<void*, 1> warmup;
+			backtrace(warmup.data(), static_cast<int>(warmup.size()));
+			taken = 0;
+			capacity = num_samples;
+			buffer.store(samples.get(), std::memory_order_release);
+
+			struct sigaction action{};
+			action.sa_handler = on_signal;
+			action.sa_flags = SA_RESTART;
+			sigemptyset(&action.sa_mask);
+			struct sigaction old_action;
+			sigaction(SIGPROF, &action, &old_action);
+			const long interval_us = std::max(1'000'000L / std::max(frequency, 1u), 1L);
+			itimerval timer{ .it_interval = { .tv_sec = 0, .tv_usec = interval_us }, .it_value = { .tv_sec = 0, .tv_usec = interval_us } };
+			itimerval old_timer;
+			setitimer(ITIMER_PROF, &timer, &old_timer);
+
+			std::this_thread::sleep_for(duration);
+
+			setitimer(ITIMER_PROF, &old_timer, nullptr);
+			// a signal that was already pending is still handled, and finds no buffer
+			buffer.store(nullptr, std::memory_order_release);
+			sigaction(SIGPROF, &old_action, nullptr);
+			// a handler that got the buffer before it was cleared may still be writing its sample, which has depth 0 until it's done
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+			const std::size_t num_taken = std::min(taken.load(), num_samples);
+			std::unordered_map<void*, std::string> names;
+			std::unordered_map<std::string, std::size_t> stacks;
+			std::size_t complete = 0;
+			for (std::size_t i = 0; i < num_taken; i++)
+			{
+				const sample_t& sample = samples[i];
+				const int depth = sample.depth.load(std::memory_order_acquire);
+				if (depth == 0)
+					{ continue; }
+				complete++;
+				// the innermost frames are the handler and the signal trampoline
+				constexpr int skipped = 2;
+				std::string stack;
+				for (int j = depth - 1; j >= std::min(skipped, depth - 1); j--)
+				{
+					auto it = names.find(sample.frames[j]);
+					if (it == names.end())
+						{ it = names.emplace(sample.frames[j], symbolize(sample.frames[j])).first; }
+					if (!stack.empty())
+						{ stack += ';'; }
+					stack += it->second;
+				}
+				stacks[std::move(stack)]++;
+			}
+
+			std::vector<std::pair<std::string, std::size_t>> sorted(std::make_move_iterator(stacks.begin()), std::make_move_iterator(stacks.end()));
+			std::ranges::sort(sorted, std::ranges::greater(), &decltype(sorted)::value_type::second);
+			result_t res{ .folded = {}, .samples = complete, .dropped = taken.load() - num_taken };
+			for (const auto& [stack, count] : sorted)
+				{ res.folded += std::format("{} {}\n", stack, count); }
+			return res;
+		}
+	};
+}
+
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef SEGMENT_SPILL_H
+#define SEGMENT_SPILL_H
+
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "binary_io.h"
+#include "logger.h"
+#include "mapped_file.h"
+#include "session_store.h"
+
+// keeps the history segments in memory under a budget by moving the oldest ones into files (see config_t::history_memory_bytes)
+// history is then a hot tier of the newest segments, which are merged as they are committed to, and a cold tier of segments written once and mapped.
+// a spilled segment is read like a loaded snapshot (see session_store::read): players and time ranges are found through its index,
+// and only the pages that are used are read in, which the kernel drops again under memory pressure. sessions of latest.log and who is online
+// aren't in history, so they always stay in memory
+// the files are only read by the process that wrote them, so they have no header, and files left by a previous process are removed
+class segment_spill
+{
+private:
+	static constexpr std::string_view file_prefix = "segment-";
+
+	std::filesystem::path dir;
+	std::uint64_t max_bytes;
+	std::uint64_t next_file = 0;
+	// files written, with the mapping of each. a file is removed once nothing views it (windows can't remove a mapped file)
+	std::vector<std::pair<std::weak_ptr<const detail::mapped_file>, std::filesystem::path>> files;
+
+	void remove_unused()
+	{
+		std::erase_if(files, [](const auto& file)
+		{
+			std::error_code ec;
+			return file.first.expired() && std::filesystem::remove(file.second, ec);
+		});
+	}
+
+	// write `segment` to a new file in dir and map it
+	// @return copy of segment viewing the file, or null on error (an error will be printed)
+	[[nodiscard]] std::shared_ptr<const session_store> spill_segment(const session_store& segment)
+	{
+		std::string data;
+		detail::binary_writer writer(data);
+		segment.write(writer);
+		const std::filesystem::path path = dir / std::format("{}{}.bin", file_prefix, next_file++);
+		{
+			std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+			fout.write(data.data(), data.size());
+			fout.close();
+			if (!fout)
+			{
+				log_message(log_severity::error, "Could not write history segment to " + path.string());
+				return nullptr;
+			}
+		}
+		data = std::string();
+
+		auto file = std::make_shared<detail::mapped_file>();
+		auto res = std::make_shared<session_store>();
+		const bool opened = file->open(path) && !file->data().empty();
+		// alignment is relative to the start of the file, as it was for the writer
+		detail::binary_reader reader(file->data());
+		if (!opened || !res->read(reader, file))
+		{
+			log_message(log_severity::error, "Could not map history segment " + path.string());
+			std::error_code ec;
+			std::filesystem::remove(path, ec);
+			return nullptr;
+		}
+		files.emplace_back(std::move(file), path);
+		return res;
+	}
+
+public:
+	// @param dir  created if it doesn't exist
+	// @param max_bytes  memory the segments in memory may use (see session_history::memory_used)
+	segment_spill(std::filesystem::path dir, std::uint64_t max_bytes) : dir(std::move(dir)), max_bytes(max_bytes)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(this->dir, ec);
+		for (const auto& entry : std::filesystem::directory_iterator(this->dir, ec))
+		{
+			if (entry.path().filename().string().starts_with(file_prefix))
+				{ std::filesystem::remove(entry.path(), ec); }
+		}
+	}
+	segment_spill(const segment_spill&) = delete;
+	segment_spill& operator=(const segment_spill&) = delete;
+
+	// write the oldest segments of `history` that are in memory to files until the rest use at most max_bytes,
+	// and remove the files of segments that are gone
+	// the segments are replaced, so values cached for them are made again
+	// @return whether anything changed
+	bool apply(session_history& history)
+	{
+		remove_unused();
+		std::uint64_t used = history.memory_used().bytes;
+		if (used <= max_bytes)
+			{ return false; }
+		return history.replace_segments([&](const session_store& segment) -> std::shared_ptr<const session_store>
+		{
+			if (used <= max_bytes || segment.mapped())
+				{ return nullptr; }
+			auto res = spill_segment(segment);
+			if (res)
+				{ used -= segment.memory_used().bytes - res->memory_used().bytes; }
+			return res;
+		});
+	}
+};
+
+#endif
@@ -0,0 +1,346 @@
+#ifndef SESSION_BLOCKS_H
+#define SESSION_BLOCKS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "memory_census.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SESSION_BLOCKS_SSE2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define SESSION_BLOCKS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace detail
+{
+	// values are bit packed in 4 interleaved lanes: value i is in lane i % 4, and word w of a lane is word w * 4 + lane,
+	// so a group of 4 values is unpacked at once with the same shifts for each lane
+	// (the layout of SIMD-BP128, see Lemire and Boytsov, "Decoding billions of integers per second through vectorization")
+
+	// @return number of words `count` values of `bits` bits are packed into
+	[[nodiscard]] constexpr std::size_t packed_words(std::size_t count, unsigned int bits) noexcept
+		{ return ((count + 3) / 4 * bits + 31) / 32 * 4; }
+
+	static_assert(packed_words(128, 32) == 128);
+	static_assert(packed_words(128, 5) == 20);
+	static_assert(packed_words(3, 5) == 4);
+	static_assert(packed_words(5, 0) == 0);
+
+	// append `count` values packed with `bits` bits each (which they must fit in) to `out`
+	inline void pack_lanes(const std::uint32_t* values, std::size_t count, unsigned int bits, std::vector<std::uint32_t>& out)
+	{
+		const std::size_t base = out.size();
+		out.resize(base + packed_words(count, bits), 0);
+		if (bits == 0)
+			{ return; }
+		for (std::size_t i = 0; i < count; i++)
+		{
+			const std::size_t lane = i % 4, bit_pos = i / 4 * bits, word = bit_pos / 32, shift = bit_pos % 32;
+			out[base + word * 4 + lane] |= values[i] << shift;
+			if (shift + bits > 32)
+				{ out[base + (word + 1) * 4 + lane] |= values[i] >> (32 - shift); }
+		}
+	}
+
+	// unpack what pack_lanes packed
+	// @param out  receives the values, rounded up to a multiple of 4 (the values after `count` are 0)
+	inline void unpack_lanes(const std::uint32_t* in, std::size_t count, unsigned int bits, std::uint32_t* out) noexcept
+	{
+		const std::size_t groups = (count + 3) / 4;
+		if (bits == 0)
+		{
+			std::fill_n(out, groups * 4, 0);
+			return;
+		}
+		const std::uint32_t mask = (bits == 32) ? std::numeric_limits<std::uint32_t>::max() : (std::uint32_t(1) << bits) - 1;
+		for (std::size_t group = 0; group < groups; group++)
+		{
+			const std::size_t bit_pos = group * bits, word = bit_pos / 32, shift = bit_pos % 32;
+			const bool straddles = (shift + bits > 32);
+#if defined(SESSION_BLOCKS_SSE2)
+			__m128i vals = _mm_srl_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + word * 4)), _mm_cvtsi32_si128(static_cast<int>(shift)));
+			if (straddles)
+			{
+				const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (word + 1) * 4));
+				vals = _mm_or_si128(vals, _mm_sll_epi32(next, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + group * 4), _mm_and_si128(vals, _mm_set1_epi32(static_cast<int>(mask))));
+#elif defined(SESSION_BLOCKS_NEON)
+			// shifting by a negative amount shifts right
+			uint32x4_t vals = vshlq_u32(vld1q_u32(in + word * 4), vdupq_n_s32(-static_cast<int>(shift)));
+			if (straddles)
+				{ vals = vorrq_u32(vals, vshlq_u32(vld1q_u32(in + (word + 1) * 4), vdupq_n_s32(static_cast<int>(32 - shift)))); }
+			vst1q_u32(out + group * 4, vandq_u32(vals, vdupq_n_u32(mask)));
+#else
+			for (std::size_t lane = 0; lane < 4; lane++)
+			{
+				std::uint32_t val = in[word * 4 + lane] >> shift;
+				if (straddles)
+					{ val |= in[(word + 1) * 4 + lane] << (32 - shift); }
+				out[group * 4 + lane] = val & mask;
+			}
+#endif
+		}
+	}
+}
+
+// the session columns of a session_store compressed into blocks of up to 128 sessions of a player (see session_store::compressed)
+// starts are stored as the difference from the session before (zigzag encoded, since sessions aren't always in order) and durations
+// as the difference from the shortest in the block, each bit packed with as many bits as the largest needs. sessions are decoded
+// a block at a time, and scans skip the blocks that their headers rule out
+// times are seconds after the store's base_time, like its columns
+class session_blocks
+{
+public:
+	static constexpr std::size_t block_size = 128;
+
+	struct block_header
+	{
+		std::int64_t max_end;
+		std::int64_t prefix_max_end;  // latest end of this block and the player's blocks before it
+		std::uint32_t data_offset;  // index of the packed starts in words, the durations follow them
+		std::uint32_t min_start, max_start;
+		std::uint32_t suffix_min_start;  // earliest start of this block and the player's blocks after it
+		std::int32_t min_duration, max_duration;
+		std::uint8_t count;  // sessions, 1 to block_size (stored minus 1)
+		std::uint8_t start_bits, duration_bits;
+	};
+
+	// sessions of a block, as they are in the columns
+	struct decoded_block
+	{
+		std::array<std::uint32_t, block_size> starts;
+		std::array<std::int32_t, block_size> durations;
+		std::size_t count;
+	};
+
+private:
+	// blocks of player i are [block_offsets[i], block_offsets[i + 1]) of blocks
+	std::vector<std::uint32_t> block_offsets{ 0 };
+	std::vector<block_header> blocks;
+	std::vector<std::uint32_t> words;
+	// identifies the contents in the cache of session(), which copies share. 0 for none
+	std::uint64_t id = 0;
+
+	[[nodiscard]] static std::uint64_t next_id() noexcept
+	{
+		static std::atomic<std::uint64_t> counter = 0;
+		return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	void decode(const block_header& block, decoded_block& out) const noexcept
+	{
+		const std::size_t count = std::size_t(block.count) + 1;
+		std::array<std::uint32_t, block_size> durations;
+		detail::unpack_lanes(words.data() + block.data_offset, count, block.start_bits, out.starts.data());
+		detail::unpack_lanes(words.data() + block.data_offset + detail::packed_words(count, block.start_bits), count, block.duration_bits, durations.data());
+		// unsigned arithmetic wraps around, so every difference of two starts can be undone
+		std::uint32_t start = block.min_start;
+		for (std::size_t i = 0; i < count; i++)
+		{
+			start += (out.starts[i] >> 1) ^ (0 - (out.starts[i] & 1));
+			out.starts[i] = start;
+		}
+		for (std::size_t i = 0; i < count; i++)
+			{ out.durations[i] = static_cast<std::int32_t>(durations[i] + static_cast<std::uint32_t>(block.min_duration)); }
+		out.count = count;
+	}
+
+public:
+	session_blocks() = default;
+	// @param offsets  sessions of player i are [offsets[i], offsets[i + 1]) of starts and durations
+	session_blocks(std::span<const std::uint32_t> offsets, std::span<const std::uint32_t> starts, std::span<const std::int32_t> durations) : id(next_id())
+	{
+		block_offsets.reserve(offsets.size());
+		std::array<std::uint32_t, block_size> packed;
+		for (std::size_t i = 0; i + 1 < offsets.size(); i++)
+		{
+			const std::size_t first_block = blocks.size();
+			for (std::size_t first = offsets[i]; first < offsets[i + 1]; first += block_size)
+			{
+				const std::size_t count = std::min<std::size_t>(block_size, offsets[i + 1] - first);
+				block_header block{ .max_end = std::numeric_limits<std::int64_t>::min(), .prefix_max_end = 0, .data_offset = static_cast<std::uint32_t>(words.size()),
+					.min_start = std::numeric_limits<std::uint32_t>::max(), .max_start = 0, .suffix_min_start = 0,
+					.min_duration = std::numeric_limits<std::int32_t>::max(), .max_duration = std::numeric_limits<std::int32_t>::min(),
+					.count = static_cast<std::uint8_t>(count - 1), .start_bits = 0, .duration_bits = 0 };
+				for (std::size_t j = first; j < first + count; j++)
+				{
+					block.min_start = std::min(block.min_start, starts[j]);
+					block.max_start = std::max(block.max_start, starts[j]);
+					block.min_duration = std::min(block.min_duration, durations[j]);
+					block.max_duration = std::max(block.max_duration, durations[j]);
+					block.max_end = std::max(block.max_end, std::int64_t(starts[j]) + durations[j]);
+				}
+				// the first start is the difference from the earliest, which it is when sessions are in order
+				std::uint32_t prev = block.min_start, all_bits = 0;
+				for (std::size_t j = 0; j < count; j++)
+				{
+					const auto diff = static_cast<std::int32_t>(starts[first + j] - prev);
+					packed[j] = (static_cast<std::uint32_t>(diff) << 1) ^ static_cast<std::uint32_t>(diff >> 31);
+					prev = starts[first + j];
+					all_bits |= packed[j];
+				}
+				block.start_bits = static_cast<std::uint8_t>(std::bit_width(all_bits));
+				detail::pack_lanes(packed.data(), count, block.start_bits, words);
+				all_bits = 0;
+				for (std::size_t j = 0; j < count; j++)
+				{
+					packed[j] = static_cast<std::uint32_t>(durations[first + j]) - static_cast<std::uint32_t>(block.min_duration);
+					all_bits |= packed[j];
+				}
+				block.duration_bits = static_cast<std::uint8_t>(std::bit_width(all_bits));
+				detail::pack_lanes(packed.data(), count, block.duration_bits, words);
+				blocks.push_back(block);
+			}
+			std::int64_t max_end = std::numeric_limits<std::int64_t>::min();
+			for (std::size_t b = first_block; b < blocks.size(); b++)
+			{
+				max_end = std::max(max_end, blocks[b].max_end);
+				blocks[b].prefix_max_end = max_end;
+			}
+			std::uint32_t min_start = std::numeric_limits<std::uint32_t>::max();
+			for (std::size_t b = blocks.size(); b-- > first_block;)
+			{
+				min_start = std::min(min_start, blocks[b].min_start);
+				blocks[b].suffix_min_start = min_start;
+			}
+			block_offsets.push_back(static_cast<std::uint32_t>(blocks.size()));
+		}
+		blocks.shrink_to_fit();
+		words.shrink_to_fit();
+	}
+
+	// @return headers of the blocks of player, whose sessions are in order
+	[[nodiscard]] std::span<const block_header> player_blocks(std::size_t player_ind) const noexcept
+		{ return std::span(blocks).subspan(block_offsets[player_ind], block_offsets[player_ind + 1] - block_offsets[player_ind]); }
+
+	// @return session of player (start and duration), decoding its block unless it was one of the last a thread decoded
+	//         (sessions are mostly read in order, but maybe of several players at once, e.g. merged by kway_merge)
+	[[nodiscard]] std::pair<std::uint32_t, std::int32_t> session(std::size_t player_ind, std::size_t session_ind) const noexcept
+	{
+		struct cached_block
+		{
+			std::uint64_t id = 0;
+			std::size_t block = 0;
+			decoded_block sessions;
+		};
+		struct block_cache
+		{
+			std::array<cached_block, 16> entries;
+			std::size_t last = 0, next = 0;  // last used, and next to be replaced
+		};
+		thread_local block_cache cache;
+
+		const std::size_t block = block_offsets[player_ind] + session_ind / block_size;
+		const auto matches = [this, block](const cached_block& entry) { return entry.id == id && entry.block == block; };
+		if (!matches(cache.entries[cache.last]))
+		{
+			const auto it = std::ranges::find_if(cache.entries, matches);
+			if (it != cache.entries.end())
+				{ cache.last = static_cast<std::size_t>(it - cache.entries.begin()); }
+			else
+			{
+				cache.last = cache.next;
+				cache.next = (cache.next + 1) % cache.entries.size();
+				cached_block& entry = cache.entries[cache.last];
+				decode(blocks[block], entry.sessions);
+				entry.id = id;
+				entry.block = block;
+			}
+		}
+		const decoded_block& sessions = cache.entries[cache.last].sessions;
+		return { sessions.starts[session_ind % block_size], sessions.durations[session_ind % block_size] };
+	}
+
+	// find sessions of a player in a time range like session_store::overlapping_sessions, with binary searches over the headers
+	// and at most 2 blocks decoded at each end
+	// @param begin, end  sessions that end after begin and start before end are in the result
+	[[nodiscard]] std::pair<std::size_t, std::size_t> overlapping(std::size_t player_ind, std::int64_t begin, std::int64_t end) const noexcept
+	{
+		const std::span<const block_header> player = player_blocks(player_ind);
+		decoded_block sessions;
+		// first session whose latest end up to it is after begin
+		std::size_t first = 0;
+		const std::size_t first_block = std::ranges::partition_point(player, [begin](const block_header& block) { return block.prefix_max_end <= begin; }) - player.begin();
+		if (first_block == player.size())
+			{ first = (player.empty() ? 0 : (player.size() - 1) * block_size + player.back().count + 1); }
+		else
+		{
+			decode(player[first_block], sessions);
+			std::int64_t max_end = (first_block == 0) ? std::numeric_limits<std::int64_t>::min() : player[first_block - 1].prefix_max_end;
+			std::size_t i = 0;
+			for (; i < sessions.count; i++)
+			{
+				max_end = std::max(max_end, std::int64_t(sessions.starts[i]) + sessions.durations[i]);
+				if (max_end > begin)
+					{ break; }
+			}
+			first = first_block * block_size + i;
+		}
+		// first session whose earliest start from it on is at or after end
+		std::size_t last = 0;
+		const std::size_t last_block = std::ranges::partition_point(player, [end](const block_header& block) { return block.suffix_min_start < end; }) - player.begin();
+		if (last_block != 0)
+		{
+			const block_header& block = player[last_block - 1];
+			decode(block, sessions);
+			std::int64_t min_start = (last_block == player.size()) ? std::numeric_limits<std::int64_t>::max() : player[last_block].suffix_min_start;
+			last = (last_block - 1) * block_size + sessions.count;
+			for (std::size_t i = sessions.count; i-- > 0;)
+			{
+				min_start = std::min<std::int64_t>(min_start, sessions.starts[i]);
+				if (min_start < end)
+					{ break; }
+				last = (last_block - 1) * block_size + i;
+			}
+		}
+		return { first, std::max(first, last) };
+	}
+
+	// call f(const std::uint32_t* starts, const std::int32_t* durations, std::size_t count) with the decoded sessions of each block of player
+	// that may_match(const block_header&) returns true for, in order
+	template<typename MayMatch, typename F>
+	void for_each_block(std::size_t player_ind, MayMatch&& may_match, F&& f) const
+	{
+		decoded_block sessions;
+		for (const block_header& block : player_blocks(player_ind))
+		{
+			if (!may_match(block))
+				{ continue; }
+			decode(block, sessions);
+			f(sessions.starts.data(), sessions.durations.data(), sessions.count);
+		}
+	}
+
+	// append the sessions of all players, in order, to columns
+	void decode_all(std::vector<std::uint32_t>& starts, std::vector<std::int32_t>& durations) const
+	{
+		decoded_block sessions;
+		for (const block_header& block : blocks)
+		{
+			decode(block, sessions);
+			starts.insert(starts.end(), sessions.starts.begin(), sessions.starts.begin() + static_cast<std::ptrdiff_t>(sessions.count));
+			durations.insert(durations.end(), sessions.durations.begin(), sessions.durations.begin() + static_cast<std::ptrdiff_t>(sessions.count));
+		}
+	}
+
+	// @return headers of all blocks, players' after each other
+	[[nodiscard]] std::span<const block_header> get_blocks() const noexcept
+		{ return blocks; }
+
+	[[nodiscard]] std::size_t heap_bytes() const noexcept
+		{ return detail::vector_heap_bytes(block_offsets) + detail::vector_heap_bytes(blocks) + detail::vector_heap_bytes(words); }
+};
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef SESSION_EXPORT_H
+#define SESSION_EXPORT_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <libdeflate.h>
+
+#include "arrow_ipc.h"
+#include "parse_logs.h"
+#include "session_store.h"
+
+enum class export_format : std::uint8_t
+{
+	csv,  // with a header row
+	ndjson,  // a json object on each line
+	arrow  // arrow ipc file with a column for each field, which analytics tools read without parsing (see arrow_file_writer). not compressed
+};
+
+// @return format named `name` (csv, ndjson or arrow), or empty optional if there is none
+[[nodiscard]] constexpr std::optional<export_format> parse_export_format(std::string_view name) noexcept
+{
+	if (name == "csv")
+		{ return export_format::csv; }
+	if (name == "ndjson")
+		{ return export_format::ndjson; }
+	if (name == "arrow")
+		{ return export_format::arrow; }
+	return std::nullopt;
+}
+
+// @return name of a file exported in `format`
+[[nodiscard]] constexpr std::string_view export_filename(export_format format) noexcept
+{
+	return (format == export_format::csv) ? "sessions.csv.gz" : (format == export_format::ndjson) ? "sessions.ndjson.gz" : "sessions.arrow";
+}
+
+// @return media type of a file exported in `format`
+[[nodiscard]] constexpr std::string_view export_content_type(export_format format) noexcept
+	{ return (format == export_format::arrow) ? "application/vnd.apache.arrow.file" : "application/gzip"; }
+
+namespace detail
+{
+	// append `str` as a csv field, quoted only if it has to be
+	constexpr void append_csv_field(std::string& out, std::string_view str)
+	{
+		if (str.find_first_of(",\"\r\n") == std::string_view::npos)
+		{
+			out += str;
+			return;
+		}
+		out += '"';
+		for (const char c : str)
+		{
+			if (c == '"')
+				{ out += '"'; }
+			out += c;
+		}
+		out += '"';
+	}
+	static_assert([]() { std::string out; append_csv_field(out, "Steve"); append_csv_field(out, "a,\"b\""); return out; }() == "Steve\"a,\"\"b\"\"\"");
+
+	// append `str` as a json string, with quotes
+	constexpr void append_json_string(std::string& out, std::string_view str)
+	{
+		constexpr std::string_view hex = "0123456789abcdef";
+		out += '"';
+		for (const char c : str)
+		{
+			if (c == '"' || c == '\\')
+			{
+				out += '\\';
+				out += c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20)
+			{
+				out += "\\u00";
+				out += hex[static_cast<unsigned char>(c) >> 4];
+				out += hex[static_cast<unsigned char>(c) & 0xf];
+			}
+			else
+				{ out += c; }
+		}
+		out += '"';
+	}
+	static_assert([]() { std::string out; append_json_string(out, "a\"\\\n"); return out; }() == "\"a\\\"\\\\\\u000a\"");
+
+	// @return the 16 bytes of `uuid` in the order it is written (see std::formatter<uuid_t>)
+	[[nodiscard]] constexpr std::array<char, 16> uuid_bytes(uuid_t uuid) noexcept
+	{
+		// digit i of the uuid is nibble i of first (i < 16) or second (i >= 16)
+		const auto digit = [uuid](std::size_t i) { return ((i < 16 ? uuid.first : uuid.second) >> ((i % 16) * 4)) & 0xF; };
+		std::array<char, 16> res;
+		for (std::size_t i = 0; i < res.size(); i++)
+			{ res[i] = static_cast<char>((digit(2 * i) << 4) | digit(2 * i + 1)); }
+		return res;
+	}
+	static_assert(uuid_bytes(uuid_t{ 0x21, 0 })[0] == 0x12);
+}
+
+// writes sessions as gzip compressed csv or ndjson, a row for each session: uuid, name, start and end (utc, iso 8601) and length in seconds
+// rows go into a buffer that is compressed as its own gzip member whenever it fills up, and gzip readers read concatenated members as one file,
+// so memory use doesn't depend on how many sessions there are (libdeflate only compresses whole buffers, it can't stream)
+// arrow has the same columns (start and end as timestamps), and a record batch is written whenever batch_rows rows are added
+// rows are grouped by player (in each session_store), not sorted by time
+class session_exporter
+{
+private:
+	static constexpr std::size_t chunk_size = 1 << 20;  // of uncompressed rows
+	static constexpr std::size_t batch_rows = 1 << 16;  // of an arrow record batch
+	static constexpr std::array<arrow_field, 5> arrow_fields = { { { "uuid", arrow_type::uuid }, { "name", arrow_type::utf8 },
+		{ "start", arrow_type::timestamp_seconds }, { "end", arrow_type::timestamp_seconds }, { "seconds", arrow_type::int64 } } };
+
+	// columns of the rows of the next record batch
+	struct arrow_columns
+	{
+		std::string uuids;
+		std::vector<std::int32_t> name_offsets{ 0 };
+		std::string names;
+		std::vector<std::int64_t> starts, ends, seconds;
+	};
+
+	export_format format;
+	std::function<bool(std::string_view)> sink;
+	std::unique_ptr<libdeflate_compressor, decltype(&libdeflate_free_compressor)> compressor;
+	std::string rows;
+	std::string compressed;
+	std::optional<arrow_file_writer> arrow;
+	arrow_columns columns;
+	std::uint64_t num_rows = 0;
+	bool failed = false;
+
+	// @return view of the bytes of `values`
+	template<typename T>
+	[[nodiscard]] static std::string_view bytes(const std::vector<T>& values) noexcept
+		{ return { reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T) }; }
+
+	void flush_batch()
+	{
+		const std::size_t num_batch_rows = columns.starts.size();
+		if (num_batch_rows == 0 || failed)
+			{ return; }
+		const std::array<std::string_view, 6> buffers = { columns.uuids, bytes(columns.name_offsets), columns.names, bytes(columns.starts),
+			bytes(columns.ends), bytes(columns.seconds) };
+		arrow->write_batch(static_cast<std::int64_t>(num_batch_rows), buffers);
+		columns = arrow_columns();
+	}
+
+	void flush()
+	{
+		if (format == export_format::arrow)
+		{
+			flush_batch();
+			return;
+		}
+		if (rows.empty() || failed)
+			{ return; }
+		compressed.resize(libdeflate_gzip_compress_bound(compressor.get(), rows.size()));
+		compressed.resize(libdeflate_gzip_compress(compressor.get(), rows.data(), rows.size(), compressed.data(), compressed.size()));
+		failed = !sink(compressed);
+		rows.clear();
+	}
+
+public:
+	// @param sink  called with each part of the compressed output, in order. returns false to stop (e.g. on a write error), which finish reports
+	// @throws std::runtime_error if the compressor can't be allocated
+	session_exporter(export_format format, std::function<bool(std::string_view)> sink)
+		: format(format), sink(std::move(sink)),
+		compressor((format == export_format::arrow) ? nullptr : libdeflate_alloc_compressor(6), &libdeflate_free_compressor)
+	{
+		if (format == export_format::arrow)
+		{
+			arrow.emplace(arrow_fields, [this](std::string_view part)
+			{
+				if (!failed)
+					{ failed = !this->sink(part); }
+				return !failed;
+			});
+			return;
+		}
+		if (!compressor)
+			{ throw std::runtime_error("Could not allocate compressor for the export"); }
+		rows.reserve(chunk_size + 256);
+		if (format == export_format::csv)
+			{ rows += "uuid,name,start,end,seconds\n"; }
+	}
+	session_exporter(const session_exporter&) = delete;
+	session_exporter& operator=(const session_exporter&) = delete;
+
+	void add(uuid_t uuid, std::string_view name, const play_session& session)
+	{
+		const auto start = std::chrono::floor<std::chrono::seconds>(session.first);
+		const auto length = std::chrono::floor<std::chrono::seconds>(session.second);
+		if (format == export_format::arrow)
+		{
+			const auto uuid_data = detail::uuid_bytes(uuid);
+			columns.uuids.append(uuid_data.data(), uuid_data.size());
+			columns.names += name;
+			columns.name_offsets.push_back(static_cast<std::int32_t>(columns.names.size()));
+			columns.starts.push_back(start.time_since_epoch().count());
+			columns.ends.push_back((start + length).time_since_epoch().count());
+			columns.seconds.push_back(length.count());
+			num_rows++;
+			if (columns.starts.size() == batch_rows)
+				{ flush_batch(); }
+			return;
+		}
+		if (format == export_format::csv)
+		{
+			std::format_to(std::back_inserter(rows), "{},", uuid);
+			detail::append_csv_field(rows, name);
+			std::format_to(std::back_inserter(rows), ",{:%FT%TZ},{:%FT%TZ},{}\n", start, start + length, length.count());
+		}
+		else
+		{
+			std::format_to(std::back_inserter(rows), "{{\"uuid\":\"{}\",\"name\":", uuid);
+			detail::append_json_string(rows, name);
+			std::format_to(std::back_inserter(rows), ",\"start\":\"{:%FT%TZ}\",\"end\":\"{:%FT%TZ}\",\"seconds\":{}}}\n", start, start + length, length.count());
+		}
+		num_rows++;
+		if (rows.size() >= chunk_size)
+			{ flush(); }
+	}
+
+	// add the sessions in `store` that overlap `range`, with each player's latest name in it
+	void add(const session_store& store, const time_range& range)
+	{
+		for (std::size_t i = 0; i < store.size() && !failed; i++)
+		{
+			const auto names = store.player_names(i);
+			const std::string_view name = names.empty() ? std::string_view() : std::string_view(names.back());
+			store.for_each_session(i, range, [&](const play_session& session) { add(store.uuid(i), name, session); });
+		}
+	}
+
+	// add the sessions in `data` that overlap `range`
+	void add(const log_data_t& data, const time_range& range)
+	{
+		for (const auto& [uuid, player] : data)
+		{
+			const auto& [names, play_info] = player;
+			const std::string_view name = names.empty() ? std::string_view() : std::string_view(names.back());
+			for (const play_session& session : play_info.first)
+			{
+				if (failed)
+					{ return; }
+				if (range.overlaps(session))
+					{ add(uuid, name, session); }
+			}
+		}
+	}
+
+	// compress and write the rest (or the last record batch and the footer of an arrow file)
+	// @return false if the sink stopped the export
+	[[nodiscard]] bool finish()
+	{
+		flush();
+		if (arrow && !failed)
+			{ static_cast<void>(arrow->finish()); }
+		return !failed;
+	}
+
+	// @return rows added, not counting the csv header
+	[[nodiscard]] std::uint64_t size() const noexcept
+		{ return num_rows; }
+};
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef SESSION_LENGTHS_H
+#define SESSION_LENGTHS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numbers>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "parse_logs.h"
+#include "session_store.h"
+
+// mergeable sketch of a distribution of durations (a merging t-digest): values are grouped into centroids (their mean and count),
+// which are smaller the closer they are to either end, so quantiles are accurate to a fraction of a percent with at most about
+// `compression` centroids however many values were added. sketches of parts of the values are merged into the sketch of all of them
+class duration_digest
+{
+private:
+	static constexpr double compression = 100;
+	// unmerged centroids kept before merging them, a multiple of compression so merging is amortized
+	static constexpr std::size_t max_unmerged = 5 * static_cast<std::size_t>(compression);
+
+	struct centroid
+	{
+		double mean;  // seconds
+		double weight;
+	};
+
+	std::vector<centroid> centroids;  // sorted by mean up to num_merged, then in the order they were added
+	std::size_t num_merged = 0;
+	double total_weight = 0;
+	double min = std::numeric_limits<double>::infinity(), max = -std::numeric_limits<double>::infinity();
+
+	// k1 scale function of the t-digest paper, which makes centroids smaller near q = 0 and 1
+	[[nodiscard]] static double scale(double q) noexcept
+		{ return compression / (2 * std::numbers::pi) * std::asin(2 * q - 1); }
+	[[nodiscard]] static double scale_inverse(double k) noexcept
+	{
+		if (k >= compression / 4)
+			{ return 1; }
+		return (std::sin(k * 2 * std::numbers::pi / compression) + 1) / 2;
+	}
+
+	// merge unmerged centroids (and merged ones where the scale function allows)
+	void compress()
+	{
+		if (num_merged == centroids.size())
+			{ return; }
+		std::ranges::sort(centroids, {}, &centroid::mean);
+		std::size_t out = 0;
+		double weight_before = 0;  // of the centroids before out
+		double q_limit = scale_inverse(scale(0) + 1);
+		for (std::size_t i = 1; i < centroids.size(); i++)
+		{
+			centroid& cur = centroids[out];
+			const centroid& next = centroids[i];
+			if ((weight_before + cur.weight + next.weight) / total_weight <= q_limit)
+			{
+				cur.mean += (next.mean - cur.mean) * next.weight / (cur.weight + next.weight);
+				cur.weight += next.weight;
+			}
+			else
+			{
+				weight_before += cur.weight;
+				q_limit = scale_inverse(scale(weight_before / total_weight) + 1);
+				centroids[++out] = next;
+			}
+		}
+		centroids.resize(out + 1);
+		num_merged = centroids.size();
+	}
+
+public:
+	void add(std::chrono::seconds duration)
+	{
+		const double value = static_cast<double>(duration.count());
+		centroids.push_back({ value, 1 });
+		total_weight++;
+		min = std::min(min, value);
+		max = std::max(max, value);
+		if (centroids.size() - num_merged > max_unmerged)
+			{ compress(); }
+	}
+
+	void merge(const duration_digest& other)
+	{
+		if (other.total_weight == 0)
+			{ return; }
+		centroids.insert(centroids.end(), other.centroids.begin(), other.centroids.end());
+		total_weight += other.total_weight;
+		min = std::min(min, other.min);
+		max = std::max(max, other.max);
+		if (centroids.size() - num_merged > max_unmerged)
+			{ compress(); }
+	}
+
+	// finish adding values, so the sketch takes as little memory as it can
+	void shrink()
+	{
+		compress();
+		centroids.shrink_to_fit();
+	}
+
+	[[nodiscard]] bool empty() const noexcept
+		{ return total_weight == 0; }
+	// @return number of values added
+	[[nodiscard]] std::size_t size() const noexcept
+		{ return static_cast<std::size_t>(total_weight); }
+
+	// @param q  in [0, 1]
+	// @return estimate of the q quantile, interpolated between the means of the centroids around it (and the smallest and largest value
+	//         at the ends), or 0 if nothing was added
+	[[nodiscard]] std::chrono::seconds quantile(double q)
+	{
+		if (empty())
+			{ return std::chrono::seconds(0); }
+		compress();
+		// each centroid's mean is taken to be at the middle of its weight
+		const double target = std::clamp(q, 0.0, 1.0) * total_weight;
+		double prev_pos = 0, prev_value = min, pos = 0;
+		for (const centroid& c : centroids)
+		{
+			const double center = pos + c.weight / 2;
+			if (target < center)
+			{
+				const double t = (center == prev_pos) ? 0 : (target - prev_pos) / (center - prev_pos);
+				return std::chrono::seconds(std::llround(prev_value + (c.mean - prev_value) * t));
+			}
+			prev_pos = center;
+			prev_value = c.mean;
+			pos += c.weight;
+		}
+		const double t = (total_weight == prev_pos) ? 1 : (target - prev_pos) / (total_weight - prev_pos);
+		return std::chrono::seconds(std::llround(prev_value + (max - prev_value) * t));
+	}
+};
+
+// sketches of the lengths of a history segment's sessions, of each player and of everyone, for each month (in a time zone) they started in,
+// made once for each segment (see detail::segment_cache), since segments never change
+// sessions with a negative length (from logs with wrong dates) aren't counted
+class session_length_digests
+{
+public:
+	// months since January 1970
+	[[nodiscard]] static std::int32_t month_of(std::chrono::local_days day) noexcept
+	{
+		const std::chrono::year_month_day ymd(day);
+		return (static_cast<int>(ymd.year()) - 1970) * 12 + static_cast<std::int32_t>(static_cast<unsigned int>(ymd.month())) - 1;
+	}
+	// @return midnight at the start of `month` (see month_of) in `timezone`
+	[[nodiscard]] static std::chrono::system_clock::time_point month_start(std::int32_t month, const std::chrono::time_zone* timezone)
+	{
+		const auto ym = std::chrono::year(1970 + month / 12) / std::chrono::month(static_cast<unsigned int>(month % 12) + 1);
+		return timezone->to_sys(std::chrono::local_days(ym / std::chrono::day(1)), std::chrono::choose::earliest);
+	}
+
+private:
+	using month_digests = std::vector<std::pair<std::int32_t, duration_digest>>;  // sorted by month
+
+	std::vector<month_digests> players;  // of each player of the segment, by index
+	month_digests everyone;
+
+	// merge the digests of months [first, last) in `digests` into `out`
+	static void merge_months(const month_digests& digests, std::int32_t first, std::int32_t last, duration_digest& out)
+	{
+		auto it = std::ranges::lower_bound(digests, first, {}, &month_digests::value_type::first);
+		for (; it != digests.end() && it->first < last; ++it)
+			{ out.merge(it->second); }
+	}
+
+public:
+	// @param timezone  which months are local to
+	session_length_digests(const session_store& store, const std::chrono::time_zone* timezone) : players(store.size())
+	{
+		const tz_offset_table zone = store.offset_table(timezone);
+		std::vector<std::pair<std::int32_t, std::chrono::seconds>> lengths;  // (month, length) of a player's sessions, reused
+		for (std::size_t i = 0; i < store.size(); i++)
+		{
+			lengths.clear();
+			store.for_each_session(i, time_range{}, [&](const play_session& session)
+			{
+				if (session.second >= std::chrono::system_clock::duration::zero())
+				{
+					lengths.emplace_back(month_of(std::chrono::floor<std::chrono::days>(zone.to_local(session.first))),
+						std::chrono::duration_cast<std::chrono::seconds>(session.second));
+				}
+			});
+			std::ranges::sort(lengths);
+			for (const auto& [month, length] : lengths)
+			{
+				if (players[i].empty() || players[i].back().first != month)
+					{ players[i].emplace_back(month, duration_digest()); }
+				players[i].back().second.add(length);
+			}
+			for (auto& [month, digest] : players[i])
+			{
+				digest.shrink();
+				auto it = std::ranges::lower_bound(everyone, month, {}, &month_digests::value_type::first);
+				if (it == everyone.end() || it->first != month)
+					{ it = everyone.emplace(it, month, duration_digest()); }
+				it->second.merge(digest);
+			}
+		}
+		for (auto& digest : everyone | std::views::values)
+			{ digest.shrink(); }
+	}
+
+	// merge the sketches of months [first, last) of a player of the segment (or everyone if nullopt) into `out`
+	void merge_into(std::optional<std::size_t> player_ind, std::int32_t first, std::int32_t last, duration_digest& out) const
+		{ merge_months(player_ind ? players[player_ind.value()] : everyone, first, last, out); }
+};
+
+// lengths of the sessions that started in a range
+struct session_length_stats
+{
+	std::size_t sessions = 0;
+	std::chrono::seconds median{}, p90{};
+};
+
+// @param digests_of  returns the session_length_digests of a segment: std::shared_ptr<const session_length_digests>(const std::shared_ptr<const session_store>&)
+// @param timezone  of the digests' months
+// @param recent  sessions newer than history, which are added directly
+// @param player  whose sessions to count, everyone's if nullopt
+// @return lengths of the sessions that started in `range` and have ended. months wholly in `range` come from the digests,
+//         and only the sessions of the parts of months at its ends are gone through
+[[nodiscard]] inline session_length_stats get_session_lengths(std::span<const std::shared_ptr<const session_store>> segments, auto&& digests_of,
+	const std::chrono::time_zone* timezone, const log_data_t& recent, const time_range& range, std::optional<uuid_t> player)
+{
+	// whole months [first_month, last_month)
+	constexpr std::int32_t no_month_limit = std::numeric_limits<std::int32_t>::max() / 2;
+	std::int32_t first_month = -no_month_limit, last_month = no_month_limit;
+	std::vector<time_range> partial;  // parts of months in range
+	if (range.begin != std::chrono::system_clock::time_point::min())
+	{
+		first_month = session_length_digests::month_of(std::chrono::floor<std::chrono::days>(timezone->to_local(range.begin)));
+		if (session_length_digests::month_start(first_month, timezone) < range.begin)
+			{ first_month++; }
+	}
+	if (range.end != std::chrono::system_clock::time_point::max())
+		{ last_month = session_length_digests::month_of(std::chrono::floor<std::chrono::days>(timezone->to_local(range.end))); }
+	if (first_month >= last_month)
+		{ partial.push_back(range); }
+	else
+	{
+		if (range.begin != std::chrono::system_clock::time_point::min())
+			{ partial.push_back({ range.begin, session_length_digests::month_start(first_month, timezone) }); }
+		if (range.end != std::chrono::system_clock::time_point::max())
+			{ partial.push_back({ session_length_digests::month_start(last_month, timezone), range.end }); }
+	}
+
+	duration_digest res;
+	const auto add = [&res](const play_session& session)
+	{
+		if (session.second >= std::chrono::system_clock::duration::zero())
+			{ res.add(std::chrono::duration_cast<std::chrono::seconds>(session.second)); }
+	};
+	for (const auto& segment : segments)
+	{
+		std::optional<std::size_t> player_ind;
+		if (player)
+		{
+			player_ind = segment->find(player.value());
+			if (!player_ind)
+				{ continue; }
+		}
+		if (first_month < last_month)
+			{ digests_of(segment)->merge_into(player_ind, first_month, last_month, res); }
+		const auto add_partial = [&](std::size_t i)
+		{
+			for (const time_range& part : partial)
+			{
+				// a session that starts at part.begin and has no length ends there, so it doesn't overlap the part but a second more
+				const time_range around{ part.begin - std::chrono::seconds(1), part.end };
+				segment->for_each_session(i, around, [&](const play_session& session)
+				{
+					if (session.first >= part.begin && session.first < part.end)
+						{ add(session); }
+				});
+			}
+		};
+		if (player_ind)
+			{ add_partial(player_ind.value()); }
+		else
+		{
+			for (std::size_t i = 0; i < segment->size(); i++)
+				{ add_partial(i); }
+		}
+	}
+
+	// recent data is small, so its sessions are all checked
+	const auto add_recent = [&](const log_data_t::mapped_type& player_data)
+	{
+		for (const play_session& session : player_data.second.first)
+		{
+			if (range.unbounded() || (session.first >= range.begin && session.first < range.end))
+				{ add(session); }
+		}
+	};
+	if (player)
+	{
+		if (const auto it = recent.find(player.value()); it != recent.end())
+			{ add_recent(it->second); }
+	}
+	else
+	{
+		for (const auto& player_data : recent | std::views::values)
+			{ add_recent(player_data); }
+	}
+	return { res.size(), res.quantile(0.5), res.quantile(0.9) };
+}
+
+#endif
@@ -0,0 +1,455 @@
+#ifndef SESSION_QUERY_H
+#define SESSION_QUERY_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parse_logs.h"
+#include "session_store.h"
+#include "tz_table.h"
+
+// filters and aggregates over the columns of history segments, so a new statistic is a session_query instead of loops of its own:
+// the sessions that match a session_filter are counted, summed and their longest found, for everything or grouped by player, day or hour
+// sessions are gone through a block of a segment's columns at a time, with branch free loops the compiler vectorizes, and blocks
+// whose min/max headers (see session_zone_map) rule them out are skipped. the sessions of compressed segments (see session_store::compressed)
+// are decoded a block at a time instead, skipping blocks by the headers they have already. segments with a lot of sessions are split into
+// ranges of players that are scanned on threads of their own
+
+// which sessions a session_query counts. times are compared to the second, which is the resolution of sessions in history
+struct session_filter
+{
+	time_range overlapping;  // sessions with part in it, all of them by default
+	bool clip = false;  // count only the part in `overlapping` (see time_range::clip), e.g. for playtime in a range
+	time_range started;  // sessions that start in it
+	time_range ended;  // sessions that end in it
+	// inclusive bounds of the length of the whole session, before clipping
+	std::chrono::seconds min_duration = std::chrono::seconds::min(), max_duration = std::chrono::seconds::max();
+	std::optional<std::vector<uuid_t>> players;  // sessions of only these players (sorted), or of everyone if empty optional
+};
+
+enum class session_grouping : std::uint8_t
+{
+	none,
+	player,
+	day,  // that the session starts on (after clipping), not split between days
+	hour  // of the day that the session starts in (after clipping)
+};
+
+// what a session_query finds about the sessions of a group
+struct session_aggregate
+{
+	std::uint64_t count = 0;
+	std::int64_t total_seconds = 0;
+	std::int64_t max_seconds = 0;  // longest session, 0 if there are none
+
+	void add(const session_aggregate& other) noexcept
+	{
+		count += other.count;
+		total_seconds += other.total_seconds;
+		max_seconds = std::max(max_seconds, other.max_seconds);
+	}
+
+	[[nodiscard]] bool operator==(const session_aggregate&) const = default;
+};
+
+struct session_query
+{
+	session_filter filter;
+	session_grouping group = session_grouping::none;
+	const std::chrono::time_zone* timezone = nullptr;  // days and hours are local to it, must be set for them
+	unsigned threads = 1;  // that a segment with many sessions is split between
+};
+
+struct session_query_result
+{
+	session_aggregate total;
+	// groups that have matching sessions: players by uuid, or days or hours (since the epoch, in local time) in order
+	std::vector<std::pair<uuid_t, session_aggregate>> players;
+	std::vector<std::pair<std::int64_t, session_aggregate>> buckets;
+};
+
+// headers of blocks of a segment's sessions (as they are in its columns, across players): the smallest and largest start, end and length,
+// which a query compares with its filter to skip blocks none of whose sessions can match
+// made once for each segment (see detail::segment_cache), since segments never change. a compressed segment has none, it has headers of its own
+class session_zone_map
+{
+public:
+	static constexpr std::size_t block_size = 256;
+
+	struct block_header
+	{
+		std::int64_t min_start, max_start, min_end, max_end;  // seconds after the store's base_time
+		std::int32_t min_duration, max_duration;
+	};
+
+private:
+	std::vector<block_header> blocks;  // block b is sessions [b * block_size, (b + 1) * block_size)
+
+public:
+	session_zone_map() = default;
+	explicit session_zone_map(const session_store& store)
+	{
+		const auto columns = store.columns();
+		blocks.reserve((columns.starts.size() + block_size - 1) / block_size);
+		for (std::size_t first = 0; first < columns.starts.size(); first += block_size)
+		{
+			block_header block{ std::numeric_limits<std::int64_t>::max(), std::numeric_limits<std::int64_t>::min(), std::numeric_limits<std::int64_t>::max(),
+				std::numeric_limits<std::int64_t>::min(), std::numeric_limits<std::int32_t>::max(), std::numeric_limits<std::int32_t>::min() };
+			for (std::size_t j = first; j < std::min(first + block_size, columns.starts.size()); j++)
+			{
+				const std::int64_t start = columns.starts[j], end = start + columns.durations[j];
+				block.min_start = std::min(block.min_start, start);
+				block.max_start = std::max(block.max_start, start);
+				block.min_end = std::min(block.min_end, end);
+				block.max_end = std::max(block.max_end, end);
+				block.min_duration = std::min(block.min_duration, columns.durations[j]);
+				block.max_duration = std::max(block.max_duration, columns.durations[j]);
+			}
+			blocks.push_back(block);
+		}
+	}
+
+	[[nodiscard]] std::span<const block_header> get_blocks() const noexcept
+		{ return blocks; }
+};
+
+namespace detail
+{
+	// session_filter in seconds after a base time, as half-open bounds of integers the columns are compared with directly
+	struct compiled_filter
+	{
+		static constexpr std::int64_t unbounded = std::numeric_limits<std::int64_t>::max() / 4;
+
+		std::int64_t overlap_begin, overlap_end;  // end > overlap_begin and start < overlap_end
+		std::int64_t start_begin, start_end;
+		std::int64_t end_begin, end_end;
+		std::int64_t min_duration, max_duration;  // inclusive
+
+		compiled_filter(const session_filter& filter, std::chrono::sys_seconds base_time) noexcept
+		{
+			using clock = std::chrono::system_clock;
+			const auto rel = [base_time](clock::time_point tp, bool round_up)
+			{
+				if (tp == clock::time_point::min())
+					{ return -unbounded; }
+				if (tp == clock::time_point::max())
+					{ return unbounded; }
+				const auto secs = round_up ? std::chrono::ceil<std::chrono::seconds>(tp) : std::chrono::floor<std::chrono::seconds>(tp);
+				return std::clamp<std::int64_t>((secs - base_time).count(), -unbounded, unbounded);
+			};
+			overlap_begin = rel(filter.overlapping.begin, false);
+			overlap_end = rel(filter.overlapping.end, true);
+			start_begin = rel(filter.started.begin, true);
+			start_end = rel(filter.started.end, true);
+			end_begin = rel(filter.ended.begin, true);
+			end_end = rel(filter.ended.end, true);
+			min_duration = std::clamp<std::int64_t>(filter.min_duration.count(), -unbounded, unbounded);
+			max_duration = std::clamp<std::int64_t>(filter.max_duration.count(), -unbounded, unbounded);
+		}
+
+		[[nodiscard]] bool matches(std::int64_t start, std::int64_t duration) const noexcept
+		{
+			const std::int64_t end = start + duration;
+			// & instead of && so there are no branches
+			return (end > overlap_begin) & (start < overlap_end) & (start >= start_begin) & (start < start_end) & (end >= end_begin) & (end < end_end)
+				& (duration >= min_duration) & (duration <= max_duration);
+		}
+
+		// @return whether a session of the block can match
+		[[nodiscard]] bool may_match(const session_zone_map::block_header& block) const noexcept
+		{
+			return block.max_end > overlap_begin && block.min_start < overlap_end && block.max_start >= start_begin && block.min_start < start_end
+				&& block.max_end >= end_begin && block.min_end < end_end && block.max_duration >= min_duration && block.min_duration <= max_duration;
+		}
+
+		// @return counted length of a matching session
+		template<bool clip>
+		[[nodiscard]] std::int64_t length(std::int64_t start, std::int64_t duration) const noexcept
+			{ return clip ? std::min(start + duration, overlap_end) - std::max(start, overlap_begin) : duration; }
+	};
+
+	// add the matching sessions [first, last) of the columns to `out`, without branches so the loop is vectorized
+	template<bool clip>
+	inline void aggregate_sessions(const compiled_filter& filter, const std::uint32_t* starts, const std::int32_t* durations, std::size_t first, std::size_t last,
+		session_aggregate& out) noexcept
+	{
+		std::uint64_t count = 0;
+		std::int64_t total = 0, longest = out.max_seconds;
+		for (std::size_t j = first; j < last; j++)
+		{
+			const std::int64_t start = starts[j], duration = durations[j];
+			const bool match = filter.matches(start, duration);
+			const std::int64_t len = filter.length<clip>(start, duration);
+			count += match;
+			total += match ? len : 0;
+			longest = std::max(longest, match ? len : longest);
+		}
+		out.count += count;
+		out.total_seconds += total;
+		out.max_seconds = longest;
+	}
+
+	// result of scanning part of a segment, which are combined into a session_query_result
+	struct partial_query_result
+	{
+		session_aggregate total;
+		std::vector<std::pair<uuid_t, session_aggregate>> players;  // sorted by uuid
+		std::map<std::int64_t, session_aggregate> buckets;
+	};
+
+	// scan the sessions of players [first_player, last_player) of `store` (or those of them in `player_inds`, which is sorted)
+	// @param zone  offsets of query.timezone over the store's sessions, for day and hour groups
+	template<bool clip>
+	inline void scan_players(const session_store& store, const session_zone_map* zones, const session_query& query, const compiled_filter& filter,
+		const tz_offset_table* zone, std::optional<std::span<const std::size_t>> player_inds, std::size_t first_player, std::size_t last_player,
+		partial_query_result& out)
+	{
+		const auto columns = store.columns();
+		const auto blocks = zones ? zones->get_blocks() : std::span<const session_zone_map::block_header>();
+		const auto bucket_of = [&](std::int64_t start)
+		{
+			const std::int64_t begin = clip ? std::max(start, filter.overlap_begin) : start;
+			const auto local = zone->to_local(columns.base_time + std::chrono::seconds(begin));
+			return (query.group == session_grouping::day) ? std::chrono::floor<std::chrono::days>(local).time_since_epoch().count() :
+				std::chrono::floor<std::chrono::hours>(local).time_since_epoch().count();
+		};
+
+		// add the matching sessions [begin, end) of columns
+		const auto add_sessions = [&](const std::uint32_t* starts, const std::int32_t* durations, std::size_t begin, std::size_t end, session_aggregate& player_total)
+		{
+			if (query.group == session_grouping::day || query.group == session_grouping::hour)
+			{
+				for (std::size_t j = begin; j < end; j++)
+				{
+					if (filter.matches(starts[j], durations[j]))
+					{
+						const std::int64_t len = filter.length<clip>(starts[j], durations[j]);
+						out.buckets[bucket_of(starts[j])].add({ 1, len, len });
+					}
+				}
+			}
+			aggregate_sessions<clip>(filter, starts, durations, begin, end, player_total);
+		};
+		const auto finish_player = [&](std::size_t player_ind, const session_aggregate& player_total)
+		{
+			out.total.add(player_total);
+			if (query.group == session_grouping::player && player_total.count != 0)
+				{ out.players.emplace_back(store.uuid(player_ind), player_total); }
+		};
+
+		// sessions [first, last) of one player, a block at a time
+		const auto scan = [&](std::size_t player_ind, std::size_t first, std::size_t last)
+		{
+			session_aggregate player_total;
+			for (std::size_t begin = first; begin < last;)
+			{
+				const std::size_t block = begin / session_zone_map::block_size;
+				const std::size_t end = std::min(last, (block + 1) * session_zone_map::block_size);
+				if (blocks.empty() || filter.may_match(blocks[block]))
+					{ add_sessions(columns.starts.data(), columns.durations.data(), begin, end, player_total); }
+				begin = end;
+			}
+			finish_player(player_ind, player_total);
+		};
+
+		if (const session_blocks* compressed = store.compressed_blocks())
+		{
+			// blocks are of one player, so players are scanned one by one even if they don't matter
+			const auto scan_compressed = [&](std::size_t player_ind)
+			{
+				session_aggregate player_total;
+				const auto may_match = [&filter](const session_blocks::block_header& block)
+				{
+					// sessions end no earlier than the shortest one after the earliest start
+					return filter.may_match({ block.min_start, block.max_start, std::int64_t(block.min_start) + block.min_duration, block.max_end,
+						block.min_duration, block.max_duration });
+				};
+				compressed->for_each_block(player_ind, may_match, [&](const std::uint32_t* starts, const std::int32_t* durations, std::size_t count)
+					{ add_sessions(starts, durations, 0, count, player_total); });
+				finish_player(player_ind, player_total);
+			};
+			if (player_inds)
+			{
+				for (const std::size_t i : player_inds.value())
+				{
+					if (i >= first_player && i < last_player)
+						{ scan_compressed(i); }
+				}
+			}
+			else
+			{
+				for (std::size_t i = first_player; i < last_player; i++)
+					{ scan_compressed(i); }
+			}
+		}
+		else if (player_inds)
+		{
+			for (const std::size_t i : player_inds.value())
+			{
+				if (i >= first_player && i < last_player)
+					{ scan(i, columns.offsets[i], columns.offsets[i + 1]); }
+			}
+		}
+		else if (query.group == session_grouping::player)
+		{
+			for (std::size_t i = first_player; i < last_player; i++)
+				{ scan(i, columns.offsets[i], columns.offsets[i + 1]); }
+		}
+		else
+		{
+			// players don't matter, so their sessions are one range
+			scan(first_player, columns.offsets[first_player], columns.offsets[last_player]);
+		}
+	}
+
+	// sessions in a segment before it is split between threads
+	inline constexpr std::size_t parallel_query_min_sessions = 1 << 16;
+
+	// scan a segment, on query.threads threads if it has enough sessions
+	template<bool clip>
+	inline partial_query_result scan_segment(const session_store& store, const session_zone_map* zones, const session_query& query)
+	{
+		const compiled_filter filter(query.filter, store.columns().base_time);
+		std::optional<std::vector<std::size_t>> player_inds;
+		if (query.filter.players)
+		{
+			player_inds.emplace();
+			for (const uuid_t uuid : query.filter.players.value())
+			{
+				if (const auto ind = store.find(uuid))
+					{ player_inds->push_back(ind.value()); }
+			}
+			std::ranges::sort(player_inds.value());
+		}
+		const auto inds = player_inds ? std::optional<std::span<const std::size_t>>(player_inds.value()) : std::nullopt;
+		std::optional<tz_offset_table> zone;
+		if (query.group == session_grouping::day || query.group == session_grouping::hour)
+			{ zone.emplace(store.offset_table(query.timezone)); }
+		const tz_offset_table* const zone_ptr = zone ? &zone.value() : nullptr;
+
+		const std::size_t num_parts = std::min<std::size_t>({ std::max(query.threads, 1u), store.total_sessions() / parallel_query_min_sessions + 1, store.size() });
+		if (num_parts <= 1)
+		{
+			partial_query_result res;
+			if (!store.empty())
+				{ scan_players<clip>(store, zones, query, filter, zone_ptr, inds, 0, store.size(), res); }
+			return res;
+		}
+		// ranges of players with about as many sessions each
+		const auto offsets = store.columns().offsets;
+		std::vector<std::size_t> bounds{ 0 };
+		for (std::size_t i = 1; i < num_parts; i++)
+		{
+			const std::size_t target = store.total_sessions() * i / num_parts;
+			const std::size_t bound = std::ranges::lower_bound(offsets, target) - offsets.begin();
+			bounds.push_back(std::clamp(bound, bounds.back(), store.size()));
+		}
+		bounds.push_back(store.size());
+		std::vector<partial_query_result> parts(num_parts);
+		{
+			std::vector<std::jthread> threads;
+			for (std::size_t i = 1; i < num_parts; i++)
+			{
+				threads.emplace_back([&, i]()
+				{
+					if (bounds[i] < bounds[i + 1])
+						{ scan_players<clip>(store, zones, query, filter, zone_ptr, inds, bounds[i], bounds[i + 1], parts[i]); }
+				});
+			}
+			if (bounds[0] < bounds[1])
+				{ scan_players<clip>(store, zones, query, filter, zone_ptr, inds, bounds[0], bounds[1], parts[0]); }
+		}
+		// player ranges are in order, so their players stay sorted
+		partial_query_result res = std::move(parts[0]);
+		for (std::size_t i = 1; i < num_parts; i++)
+		{
+			res.total.add(parts[i].total);
+			res.players.insert(res.players.end(), parts[i].players.begin(), parts[i].players.end());
+			for (const auto& [key, aggregate] : parts[i].buckets)
+				{ res.buckets[key].add(aggregate); }
+		}
+		return res;
+	}
+}
+
+// run `query` over history and the sessions of latest.log. sessions of players who are online haven't ended, so they aren't counted
+// @param zone_map_of  returns the session_zone_map of a segment, or null to scan all of it:
+//                     std::shared_ptr<const session_zone_map>(const std::shared_ptr<const session_store>&)
+// @param recent  sessions newer than history, which are few so they are checked one by one
+[[nodiscard]] inline session_query_result run_session_query(std::span<const std::shared_ptr<const session_store>> segments, auto&& zone_map_of,
+	const log_data_t& recent, const session_query& query)
+{
+	std::vector<detail::partial_query_result> parts;
+	parts.reserve(segments.size() + 1);
+	for (const auto& segment : segments)
+	{
+		const std::shared_ptr<const session_zone_map> zones = zone_map_of(segment);
+		parts.push_back(query.filter.clip ? detail::scan_segment<true>(*segment, zones.get(), query) : detail::scan_segment<false>(*segment, zones.get(), query));
+	}
+
+	detail::partial_query_result& recent_part = parts.emplace_back();
+	const detail::compiled_filter filter(query.filter, std::chrono::sys_seconds());
+	std::optional<tz_offset_table> zone;
+	if (query.group == session_grouping::day || query.group == session_grouping::hour)
+		{ zone.emplace(query.timezone, std::chrono::system_clock::time_point(), std::chrono::system_clock::time_point() - std::chrono::seconds(1)); }
+	for (const auto& [uuid, player_data] : recent)
+	{
+		if (query.filter.players && !std::ranges::binary_search(query.filter.players.value(), uuid))
+			{ continue; }
+		session_aggregate player_total;
+		for (const auto& [start, duration] : player_data.second.first)
+		{
+			const std::int64_t start_s = std::chrono::floor<std::chrono::seconds>(start).time_since_epoch().count();
+			const std::int64_t duration_s = std::chrono::duration_cast<std::chrono::seconds>(duration).count();
+			if (!filter.matches(start_s, duration_s))
+				{ continue; }
+			const std::int64_t len = query.filter.clip ? filter.length<true>(start_s, duration_s) : duration_s;
+			player_total.add({ 1, len, len });
+			if (zone)
+			{
+				const auto local = zone->to_local(std::chrono::sys_seconds(std::chrono::seconds(query.filter.clip ? std::max(start_s, filter.overlap_begin) : start_s)));
+				const std::int64_t key = (query.group == session_grouping::day) ? std::chrono::floor<std::chrono::days>(local).time_since_epoch().count() :
+					std::chrono::floor<std::chrono::hours>(local).time_since_epoch().count();
+				recent_part.buckets[key].add({ 1, len, len });
+			}
+		}
+		recent_part.total.add(player_total);
+		if (query.group == session_grouping::player && player_total.count != 0)
+			{ recent_part.players.emplace_back(uuid, player_total); }
+	}
+
+	// a player's sessions can be in several segments (and in several servers' segments, for the merged view)
+	session_query_result res;
+	std::map<std::int64_t, session_aggregate> buckets;
+	for (detail::partial_query_result& part : parts)
+	{
+		res.total.add(part.total);
+		res.players.insert(res.players.end(), part.players.begin(), part.players.end());
+		for (const auto& [key, aggregate] : part.buckets)
+			{ buckets[key].add(aggregate); }
+	}
+	std::ranges::sort(res.players, {}, &std::pair<uuid_t, session_aggregate>::first);
+	std::size_t num_players = 0;
+	for (const auto& [uuid, aggregate] : res.players)
+	{
+		if (num_players != 0 && res.players[num_players - 1].first == uuid)
+			{ res.players[num_players - 1].second.add(aggregate); }
+		else
+			{ res.players[num_players++] = { uuid, aggregate }; }
+	}
+	res.players.resize(num_players);
+	res.buckets.assign(buckets.begin(), buckets.end());
+	return res;
+}
+
+#endif
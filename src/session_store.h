@@ -0,0 +1,1450 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "binary_io.h"
+#include "parse_logs.h"
+#include "session_blocks.h"
+#include "tz_table.h"
+
+// half-open range of time [begin, end), unbounded by default
+struct time_range
+{
+	std::chrono::system_clock::time_point begin = std::chrono::system_clock::time_point::min();
+	std::chrono::system_clock::time_point end = std::chrono::system_clock::time_point::max();
+
+	[[nodiscard]] bool unbounded() const noexcept
+		{ return begin == std::chrono::system_clock::time_point::min() && end == std::chrono::system_clock::time_point::max(); }
+
+	// @return whether part of the session is in the range (all sessions are if it is unbounded)
+	[[nodiscard]] bool overlaps(const play_session& session) const noexcept
+		{ return session.first < end && session.first + session.second > begin; }
+
+	// @return part of `session` in the range, assuming it overlaps
+	[[nodiscard]] play_session clip(const play_session& session) const noexcept
+	{
+		const auto start = std::max(session.first, begin);
+		const auto session_end = std::min(session.first + session.second, end);
+		return { start, session_end - start };
+	}
+
+	[[nodiscard]] bool operator==(const time_range&) const = default;
+};
+
+// parse a date of the form yyyy-mm-dd
+// @return date, or empty optional if it isn't a valid date
+[[nodiscard]] inline std::optional<std::chrono::local_days> parse_date(std::string_view str)
+{
+	if (str.size() != 10 || str[4] != '-' || str[7] != '-')
+		{ return {}; }
+	const auto parse_num = [str](std::size_t first, std::size_t last, unsigned int& out)
+	{
+		const auto res = std::from_chars(str.data() + first, str.data() + last, out);
+		return res.ec == std::errc() && res.ptr == str.data() + last;
+	};
+	unsigned int y, m, d;
+	if (!parse_num(0, 4, y) || !parse_num(5, 7, m) || !parse_num(8, 10, d))
+		{ return {}; }
+	const auto date = std::chrono::year(static_cast<int>(y)) / std::chrono::month(m) / std::chrono::day(d);
+	if (!date.ok())
+		{ return {}; }
+	return std::chrono::local_days(date);
+}
+
+// parse a time of the form yyyy-mm-dd hh:mm (or with T instead of the space) in `timezone`, or a number of seconds since the epoch
+// @return time (the earliest if it is ambiguous because of dst), or empty optional if it isn't a valid time
+[[nodiscard]] inline std::optional<std::chrono::system_clock::time_point> parse_date_time(std::string_view str, const std::chrono::time_zone* timezone)
+{
+	std::int64_t seconds = 0;
+	if (const auto res = std::from_chars(str.data(), str.data() + str.size(), seconds); res.ec == std::errc() && res.ptr == str.data() + str.size())
+	{
+		// system_clock can't represent much more than this
+		if (seconds < 0 || seconds > 10'000'000'000)
+			{ return {}; }
+		return std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+	}
+	if (str.size() != 16 || (str[10] != ' ' && str[10] != 'T') || str[13] != ':')
+		{ return {}; }
+	const auto date = parse_date(str.substr(0, 10));
+	unsigned int h = 0, m = 0;
+	const auto parse_num = [str](std::size_t first, unsigned int& out)
+	{
+		const auto res = std::from_chars(str.data() + first, str.data() + first + 2, out);
+		return res.ec == std::errc() && res.ptr == str.data() + first + 2;
+	};
+	if (!date || !parse_num(11, h) || !parse_num(14, m) || h > 23 || m > 59)
+		{ return {}; }
+	return timezone->to_sys(date.value() + std::chrono::hours(h) + std::chrono::minutes(m), std::chrono::choose::earliest);
+}
+
+// @param first, last  dates in `timezone`, unbounded if empty
+// @return from midnight at the start of `first` to midnight at the end of `last` (choose in case midnight is skipped by dst)
+[[nodiscard]] inline time_range days_range(std::optional<std::chrono::local_days> first, std::optional<std::chrono::local_days> last,
+	const std::chrono::time_zone* timezone)
+{
+	time_range res;
+	if (first)
+		{ res.begin = timezone->to_sys(first.value(), std::chrono::choose::earliest); }
+	if (last)
+		{ res.end = timezone->to_sys(last.value() + std::chrono::days(1), std::chrono::choose::earliest); }
+	return res;
+}
+
+namespace detail
+{
+	// column of a session_store: either a vector of its own, or a view of a mapped snapshot the store keeps mapped (see session_store::read)
+	template<typename T>
+	class store_column
+	{
+	private:
+		std::vector<T> owned;
+		std::span<const T> view;  // of owned, unless it is empty
+
+	public:
+		store_column() = default;
+		store_column(std::vector<T> vals) noexcept : owned(std::move(vals)), view(owned) {}
+		explicit store_column(std::span<const T> mapped) noexcept : view(mapped) {}
+		store_column(const store_column& other) : owned(other.owned), view(other.owned.empty() ? other.view : std::span<const T>(owned)) {}
+		// moving a vector keeps its elements where they are, so the view stays valid
+		store_column(store_column&& other) noexcept : owned(std::move(other.owned)), view(std::exchange(other.view, {})) {}
+		store_column& operator=(store_column other) noexcept
+		{
+			owned = std::move(other.owned);
+			view = std::exchange(other.view, {});
+			return *this;
+		}
+
+		[[nodiscard]] const T& operator[](std::size_t i) const noexcept
+			{ return view[i]; }
+		[[nodiscard]] std::size_t size() const noexcept
+			{ return view.size(); }
+		[[nodiscard]] bool empty() const noexcept
+			{ return view.empty(); }
+		[[nodiscard]] const T* data() const noexcept
+			{ return view.data(); }
+		[[nodiscard]] auto begin() const noexcept
+			{ return view.begin(); }
+		[[nodiscard]] auto end() const noexcept
+			{ return view.end(); }
+		[[nodiscard]] const T& back() const noexcept
+			{ return view.back(); }
+		[[nodiscard]] std::span<const T> span() const noexcept
+			{ return view; }
+
+		// @return bytes allocated for the column, none if it is mapped
+		[[nodiscard]] std::size_t heap_bytes() const noexcept
+			{ return vector_heap_bytes(owned); }
+	};
+}
+
+// compact, columnar version of log_data_t for data that is no longer being added to
+// players are sorted by uuid, and their sessions and names are ranges in arrays shared by all players
+// session times have one second resolution (anything smaller is truncated), which is all logs have anyway
+// a store read from a snapshot views the mapped file instead of copying it (see read), and copies only share the mapping
+// a compressed store (see compressed) has its sessions in session_blocks instead of columns
+class session_store
+{
+private:
+	std::chrono::sys_seconds base_time{};  // earliest join time, session start times are relative to this
+	detail::store_column<uuid_t> uuids;  // sorted
+	// sessions of uuids[i] are [session_offsets[i], session_offsets[i + 1]), in the order they were added
+	detail::store_column<std::uint32_t> session_offsets = std::vector<std::uint32_t>{ 0 };
+	detail::store_column<std::uint32_t> start_seconds;  // seconds after base_time
+	// signed since a session can end before it starts if the log dates were off
+	detail::store_column<std::int32_t> duration_seconds;
+	// names of uuids[i] are [name_offsets[i], name_offsets[i + 1]), oldest first
+	detail::store_column<std::uint32_t> name_offsets = std::vector<std::uint32_t>{ 0 };
+	// characters of name i are [name_char_offsets[i], name_char_offsets[i + 1]) of name_chars
+	detail::store_column<std::uint32_t> name_char_offsets = std::vector<std::uint32_t>{ 0 };
+	detail::store_column<char> name_chars;
+	// index for finding sessions in a time range (see overlapping_sessions), calculated from the columns above
+	// for each session of a player: the latest end (relative to base_time) of it and the sessions before it,
+	// and the earliest start of it and the sessions after it. both are sorted even if sessions aren't in order
+	detail::store_column<std::int64_t> max_end_seconds;
+	detail::store_column<std::uint32_t> min_start_seconds;
+	// the sessions if the store is compressed, when the session columns and the index are empty
+	std::optional<session_blocks> compressed_sessions;
+	std::shared_ptr<const void> mapping;  // that columns view, if any
+
+	template<typename T>
+	[[nodiscard]] static T checked_cast(std::int64_t val)
+	{
+		if (val < std::numeric_limits<T>::min() || val > std::numeric_limits<T>::max())
+			{ throw std::runtime_error("Session time is out of range of session store"); }
+		return static_cast<T>(val);
+	}
+
+	void build_index()
+	{
+		std::vector<std::int64_t> max_ends(start_seconds.size());
+		std::vector<std::uint32_t> min_starts(start_seconds.size());
+		for (std::size_t i = 0; i < uuids.size(); i++)
+		{
+			const std::uint32_t first = session_offsets[i], last = session_offsets[i + 1];
+			std::int64_t max_end = std::numeric_limits<std::int64_t>::min();
+			for (std::uint32_t j = first; j < last; j++)
+			{
+				max_end = std::max(max_end, std::int64_t(start_seconds[j]) + duration_seconds[j]);
+				max_ends[j] = max_end;
+			}
+			std::uint32_t min_start = std::numeric_limits<std::uint32_t>::max();
+			for (std::uint32_t j = last; j-- > first;)
+			{
+				min_start = std::min(min_start, start_seconds[j]);
+				min_starts[j] = min_start;
+			}
+		}
+		max_end_seconds = std::move(max_ends);
+		min_start_seconds = std::move(min_starts);
+	}
+
+	[[nodiscard]] std::string_view name(std::size_t name_ind) const noexcept
+		{ return { name_chars.data() + name_char_offsets[name_ind], name_char_offsets[name_ind + 1] - name_char_offsets[name_ind] }; }
+
+	// @return `tp` in seconds after base_time, rounded down or up, or far outside the sessions if it is the earliest or latest time point
+	[[nodiscard]] std::int64_t relative_seconds(std::chrono::system_clock::time_point tp, bool round_up) const noexcept
+	{
+		constexpr std::int64_t unbounded = std::numeric_limits<std::int64_t>::max() / 4;
+		if (tp == std::chrono::system_clock::time_point::min())
+			{ return -unbounded; }
+		if (tp == std::chrono::system_clock::time_point::max())
+			{ return unbounded; }
+		return ((round_up ? std::chrono::ceil<std::chrono::seconds>(tp) : std::chrono::floor<std::chrono::seconds>(tp)) - base_time).count();
+	}
+
+	// call f(const std::uint32_t* starts, const std::int32_t* durations, std::size_t count) with all sessions of player, in order,
+	// at once from the columns or a block at a time if the store is compressed
+	template<typename F>
+	void for_each_column_block(std::size_t player_ind, F&& f) const
+	{
+		if (compressed_sessions)
+			{ compressed_sessions->for_each_block(player_ind, [](const session_blocks::block_header&) { return true; }, f); }
+		else
+			{ f(start_seconds.data() + session_offsets[player_ind], duration_seconds.data() + session_offsets[player_ind], num_sessions(player_ind)); }
+	}
+
+	// @return copy of the players and their names, without sessions
+	[[nodiscard]] session_store copy_players() const
+	{
+		session_store res;
+		res.base_time = base_time;
+		res.uuids = uuids;
+		res.session_offsets = session_offsets;
+		res.name_offsets = name_offsets;
+		res.name_char_offsets = name_char_offsets;
+		res.name_chars = name_chars;
+		res.mapping = mapping;
+		return res;
+	}
+
+	// @return copy of a compressed store with its sessions in columns again
+	[[nodiscard]] session_store decompressed() const
+	{
+		session_store res = copy_players();
+		std::vector<std::uint32_t> starts;
+		std::vector<std::int32_t> durations;
+		starts.reserve(total_sessions());
+		durations.reserve(total_sessions());
+		compressed_sessions->decode_all(starts, durations);
+		res.start_seconds = std::move(starts);
+		res.duration_seconds = std::move(durations);
+		res.build_index();
+		return res;
+	}
+
+public:
+	session_store() = default;
+	template<log_data_like data_t>
+	explicit session_store(const data_t& data)
+		{ merge(data); }
+
+	// combine `stores` as if each was merged after the ones before it (see merge), in one pass over their columns
+	// only the result is allocated, unlike copying the first and merging the rest into it (which makes a log_data_t of each, and new columns for each)
+	// @throws std::runtime_error if sessions span more than ~136 years
+	explicit session_store(std::span<const session_store* const> stores)
+	{
+		std::size_t num_sessions = 0, num_names = 0, num_chars = 0, max_players = 0;
+		std::chrono::sys_seconds new_base = std::chrono::sys_seconds::max();
+		for (const session_store* store : stores)
+		{
+			if (store->total_sessions() != 0)
+				{ new_base = std::min(new_base, store->base_time); }
+			max_players += store->uuids.size();
+			num_sessions += store->total_sessions();
+			num_names += store->name_char_offsets.size() - 1;  // may be more than needed, if names continue from an earlier store's
+			num_chars += store->name_chars.size();
+		}
+		if (new_base == std::chrono::sys_seconds::max())
+			{ new_base = {}; }  // no sessions at all
+		std::vector<uuid_t> new_uuids;
+		std::vector<std::uint32_t> new_session_offsets{ 0 }, new_start_seconds, new_name_offsets{ 0 }, new_name_char_offsets{ 0 };
+		std::vector<std::int32_t> new_duration_seconds;
+		std::vector<char> new_name_chars;
+		new_uuids.reserve(max_players);
+		new_session_offsets.reserve(max_players + 1);
+		new_name_offsets.reserve(max_players + 1);
+		new_start_seconds.reserve(num_sessions);
+		new_duration_seconds.reserve(num_sessions);
+		new_name_char_offsets.reserve(num_names + 1);
+		new_name_chars.reserve(num_chars);
+
+		// all are sorted by uuid. the stores are few, so the next uuid is found by looking at each
+		std::vector<std::size_t> inds(stores.size(), 0);
+		while (true)
+		{
+			std::optional<uuid_t> next;
+			for (std::size_t k = 0; k < stores.size(); k++)
+			{
+				if (inds[k] < stores[k]->uuids.size() && (!next || stores[k]->uuids[inds[k]] < next.value()))
+					{ next = stores[k]->uuids[inds[k]]; }
+			}
+			if (!next)
+				{ break; }
+			const std::uint32_t first_name = static_cast<std::uint32_t>(new_name_char_offsets.size() - 1);
+			for (std::size_t k = 0; k < stores.size(); k++)
+			{
+				const session_store& store = *stores[k];
+				const std::size_t i = inds[k];
+				if (i == store.uuids.size() || store.uuids[i] != next.value())
+					{ continue; }
+				const std::int64_t shift = (store.base_time - new_base).count();
+				store.for_each_column_block(i, [&](const std::uint32_t* starts, const std::int32_t* durations, std::size_t count)
+				{
+					for (std::size_t j = 0; j < count; j++)
+					{
+						new_start_seconds.push_back(checked_cast<std::uint32_t>(starts[j] + shift));
+						new_duration_seconds.push_back(durations[j]);
+					}
+				});
+				std::uint32_t name_ind = store.name_offsets[i];
+				// a store doesn't repeat the latest name of the ones before it (see merge)
+				const std::size_t num_new_names = new_name_char_offsets.size() - 1;
+				if (num_new_names > first_name && name_ind < store.name_offsets[i + 1] &&
+					store.name(name_ind) == std::string_view(new_name_chars).substr(new_name_char_offsets[num_new_names - 1]))
+					{ name_ind++; }
+				for (; name_ind < store.name_offsets[i + 1]; name_ind++)
+				{
+					const std::string_view cur_name = store.name(name_ind);
+					new_name_chars.insert(new_name_chars.end(), cur_name.begin(), cur_name.end());
+					new_name_char_offsets.push_back(checked_cast<std::uint32_t>(static_cast<std::int64_t>(new_name_chars.size())));
+				}
+				inds[k]++;
+			}
+			new_uuids.push_back(next.value());
+			new_session_offsets.push_back(static_cast<std::uint32_t>(new_start_seconds.size()));
+			new_name_offsets.push_back(static_cast<std::uint32_t>(new_name_char_offsets.size() - 1));
+		}
+
+		base_time = new_base;
+		uuids = std::move(new_uuids);
+		session_offsets = std::move(new_session_offsets);
+		start_seconds = std::move(new_start_seconds);
+		duration_seconds = std::move(new_duration_seconds);
+		name_offsets = std::move(new_name_offsets);
+		name_char_offsets = std::move(new_name_char_offsets);
+		name_chars = std::move(new_name_chars);
+		build_index();
+	}
+
+	// add the names and sessions in `data`, as if they were parsed after everything already in the store
+	// the columns are made with the exact capacity they need, since the store isn't added to again until the next merge
+	// @throws std::runtime_error if sessions span more than ~136 years
+	template<log_data_like data_t>
+	void merge(const data_t& data)
+	{
+		if (data.empty())
+			{ return; }
+
+		// rebase start times if anything in data starts earlier
+		std::chrono::sys_seconds new_base = (total_sessions() == 0 ? std::chrono::sys_seconds::max() : base_time);
+		for (const auto& [uuid, player_data] : data)
+		{
+			for (const auto& [start, duration] : player_data.second.first)
+				{ new_base = std::min(new_base, std::chrono::floor<std::chrono::seconds>(start)); }
+		}
+		if (new_base == std::chrono::sys_seconds::max())
+			{ new_base = base_time; }  // no sessions at all
+		const std::int64_t shift = (base_time - new_base).count();
+
+		std::size_t num_players = uuids.size(), num_sessions = total_sessions(), num_names = name_char_offsets.size() - 1, num_chars = name_chars.size();
+		for (const auto& [uuid, player_data] : data)
+		{
+			num_players += !std::ranges::binary_search(uuids, uuid);
+			num_sessions += player_data.second.first.size();
+			num_names += player_data.first.size();  // may be one more than needed, if a name continues from the existing ones
+			for (const auto& name : player_data.first)
+				{ num_chars += std::string_view(name).size(); }
+		}
+		std::vector<uuid_t> new_uuids;
+		std::vector<std::uint32_t> new_session_offsets{ 0 }, new_start_seconds, new_name_offsets{ 0 }, new_name_char_offsets{ 0 };
+		std::vector<std::int32_t> new_duration_seconds;
+		std::vector<char> new_name_chars;
+		new_uuids.reserve(num_players);
+		new_session_offsets.reserve(num_players + 1);
+		new_name_offsets.reserve(num_players + 1);
+		new_start_seconds.reserve(num_sessions);
+		new_duration_seconds.reserve(num_sessions);
+		new_name_char_offsets.reserve(num_names + 1);
+		new_name_chars.reserve(num_chars);
+
+		const auto add_name = [&](std::string_view name)
+		{
+			new_name_chars.insert(new_name_chars.end(), name.begin(), name.end());
+			new_name_char_offsets.push_back(checked_cast<std::uint32_t>(static_cast<std::int64_t>(new_name_chars.size())));
+		};
+
+		const auto copy_existing = [&](std::size_t i)
+		{
+			for_each_column_block(i, [&](const std::uint32_t* starts, const std::int32_t* durations, std::size_t count)
+			{
+				for (std::size_t j = 0; j < count; j++)
+				{
+					new_start_seconds.push_back(checked_cast<std::uint32_t>(starts[j] + shift));
+					new_duration_seconds.push_back(durations[j]);
+				}
+			});
+			for (std::uint32_t j = name_offsets[i]; j < name_offsets[i + 1]; j++)
+				{ add_name(name(j)); }
+		};
+		const auto copy_new = [&](const typename data_t::mapped_type& player_data, bool has_existing)
+		{
+			const auto& [player_names, play_info] = player_data;
+			for (const auto& [start, duration] : play_info.first)
+			{
+				new_start_seconds.push_back(checked_cast<std::uint32_t>((std::chrono::floor<std::chrono::seconds>(start) - new_base).count()));
+				new_duration_seconds.push_back(checked_cast<std::int32_t>(std::chrono::duration_cast<std::chrono::seconds>(duration).count()));
+			}
+			auto name_it = player_names.begin();
+			// parse_line doesn't repeat the latest name, so neither should this
+			const std::size_t num_new_names = new_name_char_offsets.size() - 1;
+			if (has_existing && name_it != player_names.end() && num_new_names > new_name_offsets.back() &&
+				std::string_view(*name_it) == std::string_view(new_name_chars).substr(new_name_char_offsets[num_new_names - 1]))
+				{ name_it++; }
+			for (; name_it != player_names.end(); name_it++)
+				{ add_name(*name_it); }
+		};
+		const auto finish_player = [&](uuid_t uuid)
+		{
+			new_uuids.push_back(uuid);
+			new_session_offsets.push_back(static_cast<std::uint32_t>(new_start_seconds.size()));
+			new_name_offsets.push_back(static_cast<std::uint32_t>(new_name_char_offsets.size() - 1));
+		};
+
+		// both are sorted by uuid
+		std::size_t i = 0;
+		auto data_it = data.begin();
+		while (i < uuids.size() || data_it != data.end())
+		{
+			if (data_it == data.end() || (i < uuids.size() && uuids[i] < data_it->first))
+			{
+				copy_existing(i);
+				finish_player(uuids[i]);
+				i++;
+			}
+			else if (i == uuids.size() || data_it->first < uuids[i])
+			{
+				copy_new(data_it->second, false);
+				finish_player(data_it->first);
+				data_it++;
+			}
+			else
+			{
+				copy_existing(i);
+				copy_new(data_it->second, true);
+				finish_player(uuids[i]);
+				i++;
+				data_it++;
+			}
+		}
+
+		base_time = new_base;
+		uuids = std::move(new_uuids);
+		session_offsets = std::move(new_session_offsets);
+		start_seconds = std::move(new_start_seconds);
+		duration_seconds = std::move(new_duration_seconds);
+		name_offsets = std::move(new_name_offsets);
+		name_char_offsets = std::move(new_name_char_offsets);
+		name_chars = std::move(new_name_chars);
+		compressed_sessions.reset();
+		mapping.reset();
+		build_index();
+	}
+
+	// @return number of players
+	[[nodiscard]] std::size_t size() const noexcept
+		{ return uuids.size(); }
+	[[nodiscard]] bool empty() const noexcept
+		{ return uuids.empty(); }
+
+	[[nodiscard]] uuid_t uuid(std::size_t player_ind) const noexcept
+		{ return uuids[player_ind]; }
+
+	// @return index of player, or empty optional if they have no sessions here
+	[[nodiscard]] std::optional<std::size_t> find(uuid_t uuid) const noexcept
+	{
+		const auto it = std::ranges::lower_bound(uuids, uuid);
+		if (it == uuids.end() || *it != uuid)
+			{ return {}; }
+		return it - uuids.begin();
+	}
+
+	// @return names of player as string_views, oldest first
+	[[nodiscard]] auto player_names(std::size_t player_ind) const noexcept
+		{ return std::views::iota(name_offsets[player_ind], name_offsets[player_ind + 1]) | std::views::transform([this](std::uint32_t i) { return name(i); }); }
+
+	// @return number of sessions of all players
+	[[nodiscard]] std::size_t total_sessions() const noexcept
+		{ return session_offsets.back(); }
+
+	// @return number of sessions of player
+	[[nodiscard]] std::size_t num_sessions(std::size_t player_ind) const noexcept
+		{ return session_offsets[player_ind + 1] - session_offsets[player_ind]; }
+
+	// @param session_ind  index of session of player, less than num_sessions(player_ind)
+	[[nodiscard]] play_session session(std::size_t player_ind, std::size_t session_ind) const noexcept
+	{
+		if (compressed_sessions)
+		{
+			const auto [start, duration] = compressed_sessions->session(player_ind, session_ind);
+			return { base_time + std::chrono::seconds(start), std::chrono::seconds(duration) };
+		}
+		const std::size_t ind = session_offsets[player_ind] + session_ind;
+		return { base_time + std::chrono::seconds(start_seconds[ind]), std::chrono::seconds(duration_seconds[ind]) };
+	}
+
+	// @return earliest and latest start of the sessions, or empty optional if there are none
+	[[nodiscard]] std::optional<std::pair<std::chrono::sys_seconds, std::chrono::sys_seconds>> start_span() const noexcept
+	{
+		if (total_sessions() == 0)
+			{ return {}; }
+		if (compressed_sessions)
+			{ return std::pair(base_time, base_time + std::chrono::seconds(std::ranges::max(compressed_sessions->get_blocks(), {}, &session_blocks::block_header::max_start).max_start)); }
+		return std::pair(base_time, base_time + std::chrono::seconds(std::ranges::max(start_seconds)));
+	}
+
+	// @return table of the offsets of `timezone` from the earliest start to the latest end of the sessions (see tz_offset_table),
+	//         for converting their times
+	[[nodiscard]] tz_offset_table offset_table(const std::chrono::time_zone* timezone) const
+	{
+		std::int64_t first = std::numeric_limits<std::int64_t>::max(), last = std::numeric_limits<std::int64_t>::min();
+		// a compressed store's headers bound the times, which is close enough for a table of offsets
+		for (const session_blocks::block_header& block : compressed_sessions ? compressed_sessions->get_blocks() : std::span<const session_blocks::block_header>())
+		{
+			first = std::min({ first, static_cast<std::int64_t>(block.min_start), static_cast<std::int64_t>(block.min_start) + block.min_duration });
+			last = std::max({ last, static_cast<std::int64_t>(block.max_start), block.max_end });
+		}
+		for (std::size_t i = 0; i < start_seconds.size(); i++)
+		{
+			first = std::min({ first, static_cast<std::int64_t>(start_seconds[i]), static_cast<std::int64_t>(start_seconds[i]) + duration_seconds[i] });
+			last = std::max({ last, static_cast<std::int64_t>(start_seconds[i]), static_cast<std::int64_t>(start_seconds[i]) + duration_seconds[i] });
+		}
+		if (first > last)
+			{ return tz_offset_table(timezone, base_time, base_time - std::chrono::seconds(1)); }
+		return tz_offset_table(timezone, base_time + std::chrono::seconds(first), base_time + std::chrono::seconds(last));
+	}
+
+	// find sessions of a player in a time range with binary searches, without going through all of them
+	// @return range [first, last) of session indices of the player containing all sessions that overlap `range`.
+	//         sessions in it can still be outside `range` if the player's sessions aren't in order, so they must be checked
+	[[nodiscard]] std::pair<std::size_t, std::size_t> overlapping_sessions(std::size_t player_ind, const time_range& range) const
+	{
+		const std::uint32_t offset = session_offsets[player_ind];
+		const std::size_t count = num_sessions(player_ind);
+		if (range.unbounded())
+			{ return { 0, count }; }
+		if (compressed_sessions)
+			{ return compressed_sessions->overlapping(player_ind, relative_seconds(range.begin, false), relative_seconds(range.end, true)); }
+		// sessions before first end before range.begin, and sessions from last start after range.end
+		const std::span<const std::int64_t> max_ends(max_end_seconds.data() + offset, count);
+		const std::span<const std::uint32_t> min_starts(min_start_seconds.data() + offset, count);
+		const std::size_t first = std::ranges::partition_point(max_ends, [this, &range](std::int64_t end)
+			{ return base_time + std::chrono::seconds(end) <= range.begin; }) - max_ends.begin();
+		const std::size_t last = std::ranges::partition_point(min_starts, [this, &range](std::uint32_t start)
+			{ return base_time + std::chrono::seconds(start) < range.end; }) - min_starts.begin();
+		return { first, std::max(first, last) };
+	}
+
+	[[nodiscard]] std::chrono::system_clock::duration total_playtime(std::size_t player_ind) const noexcept
+	{
+		std::int64_t total = 0;
+		for_each_column_block(player_ind, [&total](const std::uint32_t*, const std::int32_t* durations, std::size_t count)
+		{
+			for (std::size_t j = 0; j < count; j++)
+				{ total += durations[j]; }
+		});
+		return std::chrono::seconds(total);
+	}
+
+	// call f(const play_session&) with each session of player that overlaps `range` (all of them if it is unbounded), in order
+	// sessions of a compressed store are decoded a block at a time, and the blocks that end before the range or start after it are skipped
+	template<typename F>
+	void for_each_session(std::size_t player_ind, const time_range& range, F&& f) const
+	{
+		if (compressed_sessions)
+		{
+			const std::int64_t begin = relative_seconds(range.begin, false), end = relative_seconds(range.end, true);
+			compressed_sessions->for_each_block(player_ind, [begin, end](const session_blocks::block_header& block) { return block.max_end > begin && block.min_start < end; },
+				[&](const std::uint32_t* starts, const std::int32_t* durations, std::size_t count)
+			{
+				for (std::size_t j = 0; j < count; j++)
+				{
+					const play_session session(base_time + std::chrono::seconds(starts[j]), std::chrono::seconds(durations[j]));
+					if (range.overlaps(session))
+						{ f(session); }
+				}
+			});
+			return;
+		}
+		const auto [first, last] = overlapping_sessions(player_ind, range);
+		for (std::size_t j = first; j < last; j++)
+		{
+			if (const play_session cur = session(player_ind, j); range.overlaps(cur))
+				{ f(cur); }
+		}
+	}
+
+	// columns of the sessions, for scans that go through all of them at once (see session_query)
+	// starts and durations are empty if the store is compressed, whose sessions are scanned through compressed_blocks
+	struct session_columns
+	{
+		std::chrono::sys_seconds base_time;  // starts are relative to it
+		std::span<const std::uint32_t> offsets;  // sessions of player i are [offsets[i], offsets[i + 1])
+		std::span<const std::uint32_t> starts;  // seconds after base_time
+		std::span<const std::int32_t> durations;  // seconds
+	};
+	[[nodiscard]] session_columns columns() const noexcept
+		{ return { base_time, session_offsets.span(), start_seconds.span(), duration_seconds.span() }; }
+
+	// @return copy whose sessions are compressed into blocks (see session_blocks), which takes a few times less memory
+	//         they are decoded a block at a time whenever they are read, so it's for segments that are mostly scanned (see session_history::compress)
+	[[nodiscard]] session_store compressed() const
+	{
+		if (compressed_sessions)
+			{ return *this; }
+		session_store res = copy_players();
+		res.compressed_sessions.emplace(session_offsets.span(), start_seconds.span(), duration_seconds.span());
+		return res;
+	}
+
+	// @return the sessions if the store is compressed (see compressed), or null if they are in columns
+	[[nodiscard]] const session_blocks* compressed_blocks() const noexcept
+		{ return compressed_sessions ? &compressed_sessions.value() : nullptr; }
+
+	// @return whether the columns view a mapped file (see read) instead of memory of their own
+	[[nodiscard]] bool mapped() const noexcept
+		{ return mapping != nullptr; }
+
+	// @return memory used by the store (see memory_usage). columns viewing a mapped snapshot aren't counted, since they are in the page cache
+	[[nodiscard]] memory_usage memory_used() const noexcept
+	{
+		memory_usage res;
+		res.string_bytes = name_chars.heap_bytes();
+		res.bytes = sizeof(*this) + uuids.heap_bytes() + session_offsets.heap_bytes() + start_seconds.heap_bytes() + duration_seconds.heap_bytes() +
+			name_offsets.heap_bytes() + name_char_offsets.heap_bytes() + name_chars.heap_bytes() + max_end_seconds.heap_bytes() + min_start_seconds.heap_bytes() +
+			(compressed_sessions ? compressed_sessions->heap_bytes() : 0);
+		res.players = uuids.size();
+		res.sessions = total_sessions();
+		return res;
+	}
+
+	// @return detail::fnv1a hash of the players, their names and their sessions, which is the same for equal stores (e.g. after a restart)
+	//         and for a store and its compressed copy
+	[[nodiscard]] std::uint64_t content_hash() const
+	{
+		if (compressed_sessions)
+			{ return decompressed().content_hash(); }
+		const auto bytes = [](const auto& column)
+			{ return std::string_view(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(*column.data())); };
+		const std::int64_t base = base_time.time_since_epoch().count();
+		std::uint64_t hash = detail::fnv1a(std::string_view(reinterpret_cast<const char*>(&base), sizeof(base)));
+		// the index is calculated from these
+		for (const std::string_view column : { bytes(uuids), bytes(session_offsets), bytes(start_seconds), bytes(duration_seconds), bytes(name_offsets),
+			bytes(name_char_offsets), bytes(name_chars) })
+			{ hash = detail::fnv1a(column, hash); }
+		return hash;
+	}
+
+	// write every column (including the index) aligned, so it can be read in place (see read). a compressed store is written decompressed
+	void write(detail::binary_writer& writer) const
+	{
+		if (compressed_sessions)
+		{
+			decompressed().write(writer);
+			return;
+		}
+		writer.write<std::int64_t>(base_time.time_since_epoch().count());
+		writer.write_aligned_span(uuids.span());
+		writer.write_aligned_span(session_offsets.span());
+		writer.write_aligned_span(start_seconds.span());
+		writer.write_aligned_span(duration_seconds.span());
+		writer.write_aligned_span(max_end_seconds.span());
+		writer.write_aligned_span(min_start_seconds.span());
+		writer.write_aligned_span(name_offsets.span());
+		writer.write_aligned_span(name_char_offsets.span());
+		writer.write_aligned_span(name_chars.span());
+	}
+
+	// read data written by write() without copying it: the columns view what `reader` reads
+	// only what accessors need to stay in bounds is checked (offsets, not session times), so this doesn't go through every session
+	// @param backing  keeps what `reader` reads alive (e.g. a mapped file) for as long as the store or a copy of it views it
+	// @return true on success, false if the data is malformed (contents are unspecified in this case)
+	bool read(detail::binary_reader& reader, std::shared_ptr<const void> backing)
+	{
+		std::int64_t base_time_count;
+		std::span<const uuid_t> uuids_view;
+		std::span<const std::uint32_t> session_offsets_view, start_seconds_view, min_start_seconds_view, name_offsets_view, name_char_offsets_view;
+		std::span<const std::int32_t> duration_seconds_view;
+		std::span<const std::int64_t> max_end_seconds_view;
+		std::span<const char> name_chars_view;
+		if (!reader.read(base_time_count) || !reader.read_view(uuids_view) || !reader.read_view(session_offsets_view) || !reader.read_view(start_seconds_view) ||
+			!reader.read_view(duration_seconds_view) || !reader.read_view(max_end_seconds_view) || !reader.read_view(min_start_seconds_view) ||
+			!reader.read_view(name_offsets_view) || !reader.read_view(name_char_offsets_view) || !reader.read_view(name_chars_view))
+			{ return false; }
+
+		// make sure offsets are in range so accessors don't need to check
+		const auto valid_offsets = [](std::span<const std::uint32_t> offsets, std::size_t count, std::size_t max)
+			{ return offsets.size() == count + 1 && offsets.front() == 0 && offsets.back() == max && std::ranges::is_sorted(offsets); };
+		const std::size_t num_sessions = start_seconds_view.size();
+		if (!std::ranges::is_sorted(uuids_view) || duration_seconds_view.size() != num_sessions || max_end_seconds_view.size() != num_sessions ||
+			min_start_seconds_view.size() != num_sessions || !valid_offsets(session_offsets_view, uuids_view.size(), num_sessions) ||
+			name_char_offsets_view.empty() || !valid_offsets(name_offsets_view, uuids_view.size(), name_char_offsets_view.size() - 1) ||
+			!valid_offsets(name_char_offsets_view, name_char_offsets_view.size() - 1, name_chars_view.size()))
+			{ return false; }
+		base_time = std::chrono::sys_seconds(std::chrono::seconds(base_time_count));
+		uuids = detail::store_column(uuids_view);
+		session_offsets = detail::store_column(session_offsets_view);
+		start_seconds = detail::store_column(start_seconds_view);
+		duration_seconds = detail::store_column(duration_seconds_view);
+		max_end_seconds = detail::store_column(max_end_seconds_view);
+		min_start_seconds = detail::store_column(min_start_seconds_view);
+		name_offsets = detail::store_column(name_offsets_view);
+		name_char_offsets = detail::store_column(name_char_offsets_view);
+		name_chars = detail::store_column(name_chars_view);
+		compressed_sessions.reset();
+		mapping = std::move(backing);
+		return true;
+	}
+
+	// @return expanded copy for code that works on log_data_t
+	[[nodiscard]] log_data_t to_log_data() const
+	{
+		log_data_t data;
+		for (std::size_t i = 0; i < uuids.size(); i++)
+		{
+			auto& [player_names_vec, play_info] = data.emplace_hint(data.end(), uuids[i], log_data_t::mapped_type{})->second;
+			for (const std::string_view cur_name : player_names(i))
+				{ player_names_vec.emplace_back(cur_name); }
+			auto& [play_sessions, total] = play_info;
+			play_sessions.reserve(num_sessions(i));
+			for (std::size_t j = 0; j < num_sessions(i); j++)
+				{ play_sessions.push_back(session(i, j)); }
+			total = total_playtime(i);
+		}
+		return data;
+	}
+
+	// @return whether session j of a player continues session j - 1, because it started less than `merge_gap` after that one ended (see session_aggregator)
+	[[nodiscard]] bool continues_session(std::size_t player_ind, std::size_t session_ind, std::chrono::system_clock::duration merge_gap) const noexcept
+	{
+		if (session_ind == 0)
+			{ return false; }
+		const auto [prev_start, prev_length] = session(player_ind, session_ind - 1);
+		const auto gap = session(player_ind, session_ind).first - (prev_start + prev_length);
+		return gap >= std::chrono::system_clock::duration::zero() && gap < merge_gap;
+	}
+
+	// @return copy where sessions are merged like session_aggregator does while parsing, for sessions that were parsed without it (or with a smaller gap)
+	[[nodiscard]] session_store compacted(std::chrono::system_clock::duration merge_gap) const
+	{
+		log_data_t data;
+		for (std::size_t i = 0; i < uuids.size(); i++)
+		{
+			auto& [player_names_vec, play_info] = data.emplace_hint(data.end(), uuids[i], log_data_t::mapped_type{})->second;
+			for (const std::string_view cur_name : player_names(i))
+				{ player_names_vec.emplace_back(cur_name); }
+			auto& [play_sessions, total] = play_info;
+			for (std::size_t j = 0; j < num_sessions(i); j++)
+			{
+				const auto cur = session(i, j);
+				if (continues_session(i, j, merge_gap))
+					{ play_sessions.back().second = cur.first + cur.second - play_sessions.back().first; }
+				else
+					{ play_sessions.push_back(cur); }
+			}
+			for (const auto& [start, duration] : play_sessions)
+				{ total += duration; }
+		}
+		return session_store(data);
+	}
+
+	// @return whether compacted(merge_gap) would change anything
+	[[nodiscard]] bool needs_compaction(std::chrono::system_clock::duration merge_gap) const noexcept
+	{
+		for (std::size_t i = 0; i < uuids.size(); i++)
+		{
+			for (std::size_t j = 1; j < num_sessions(i); j++)
+			{
+				if (continues_session(i, j, merge_gap))
+					{ return true; }
+			}
+		}
+		return false;
+	}
+
+	// @return copy where the sessions of each player are in order of their start, e.g. after merging stores that weren't parsed in order
+	[[nodiscard]] session_store sorted() const
+	{
+		log_data_t data = to_log_data();
+		for (auto& player_data : data | std::views::values)
+			{ std::ranges::stable_sort(player_data.second.first, {}, &play_session::first); }
+		return session_store(data);
+	}
+
+	// @return copy where the sessions of each player that end by `cutoff` are replaced by one session for each day they played on (in `timezone`),
+	//         starting at midnight and as long as they played that day. sessions spanning midnight are split between the days like in daily_playtime,
+	//         so total and daily playtime stay the same, but the times of day are lost. newer sessions are kept as they are, after the rolled up ones
+	[[nodiscard]] session_store rolled_up(std::chrono::system_clock::time_point cutoff, const std::chrono::time_zone* timezone) const
+	{
+		const tz_offset_table zone = offset_table(timezone);
+		const auto local_day = [&zone](std::chrono::system_clock::time_point tp)
+			{ return std::chrono::floor<std::chrono::days>(zone.to_local(tp)); };
+		log_data_t data;
+		std::map<std::chrono::local_days, std::chrono::system_clock::duration> days;  // playtime on each day, reused
+		std::vector<play_session> kept;  // reused
+		for (std::size_t i = 0; i < uuids.size(); i++)
+		{
+			auto& [player_names_vec, play_info] = data.emplace_hint(data.end(), uuids[i], log_data_t::mapped_type{})->second;
+			for (const std::string_view cur_name : player_names(i))
+				{ player_names_vec.emplace_back(cur_name); }
+			days.clear();
+			kept.clear();
+			for (std::size_t j = 0; j < num_sessions(i); j++)
+			{
+				const auto [start, duration] = session(i, j);
+				const auto end = start + duration;
+				if (end > cutoff)
+					{ kept.push_back(session(i, j)); }
+				else if (duration <= std::chrono::system_clock::duration::zero())
+					{ days[local_day(start)] += duration; }
+				else
+				{
+					for (auto cur = start; cur < end;)
+					{
+						const auto day = local_day(cur);
+						const std::chrono::system_clock::time_point midnight = zone.to_sys(day + std::chrono::days(1), std::chrono::choose::earliest);
+						const auto next = std::min(end, midnight);
+						days[day] += next - cur;
+						cur = next;
+					}
+				}
+			}
+			auto& [play_sessions, total] = play_info;
+			for (const auto& [day, playtime] : days)
+			{
+				if (playtime != std::chrono::system_clock::duration::zero())
+					{ play_sessions.emplace_back(zone.to_sys(day, std::chrono::choose::earliest), playtime); }
+			}
+			play_sessions.insert(play_sessions.end(), kept.begin(), kept.end());
+			total = total_playtime(i);
+		}
+		return session_store(data);
+	}
+
+	// @return whether rolled_up(cutoff, timezone) would change anything,
+	//         which is when a player has sessions ending by `cutoff` that aren't already one from midnight for each day
+	[[nodiscard]] bool needs_roll_up(std::chrono::system_clock::time_point cutoff, const std::chrono::time_zone* timezone) const
+	{
+		const tz_offset_table zone = offset_table(timezone);
+		for (std::size_t i = 0; i < uuids.size(); i++)
+		{
+			std::optional<std::chrono::local_days> prev_day;
+			for (std::size_t j = 0; j < num_sessions(i); j++)
+			{
+				const auto [start, duration] = session(i, j);
+				if (start + duration > cutoff)
+					{ continue; }
+				const auto day = std::chrono::floor<std::chrono::days>(zone.to_local(start));
+				if (start != zone.to_sys(day, std::chrono::choose::earliest) || duration == std::chrono::system_clock::duration::zero() ||
+					start + duration > zone.to_sys(day + std::chrono::days(1), std::chrono::choose::earliest) || (prev_day && day <= prev_day.value()))
+					{ return true; }
+				prev_day = day;
+			}
+		}
+		return false;
+	}
+};
+
+// players of a session_store by all names they have had, ignoring case, so finding a player is a binary search
+class player_name_index
+{
+private:
+	std::vector<std::pair<std::string, std::uint32_t>> entries;  // folded name and player index, sorted
+
+public:
+	explicit player_name_index(const session_store& store)
+	{
+		for (std::size_t i = 0; i < store.size(); i++)
+		{
+			for (const std::string_view name : store.player_names(i))
+				{ entries.emplace_back(fold_case(name), static_cast<std::uint32_t>(i)); }
+		}
+		std::ranges::sort(entries);
+		const auto [first, last] = std::ranges::unique(entries);
+		entries.erase(first, last);
+	}
+
+	// minecraft names are ascii letters, digits, and underscores, so only ascii is folded
+	[[nodiscard]] static std::string fold_case(std::string_view name)
+	{
+		std::string res(name);
+		for (char& c : res)
+		{
+			if (c >= 'A' && c <= 'Z')
+				{ c = static_cast<char>(c - 'A' + 'a'); }
+		}
+		return res;
+	}
+
+	// @param store  that this was made from
+	// @return index of the player who has `name` now, or otherwise of a player who had it before (empty optional if nobody did)
+	[[nodiscard]] std::optional<std::size_t> find(const session_store& store, std::string_view name) const
+	{
+		const std::string folded = fold_case(name);
+		const auto [first, last] = std::ranges::equal_range(entries, folded, {}, &std::pair<std::string, std::uint32_t>::first);
+		if (first == last)
+			{ return {}; }
+		for (auto it = first; it != last; it++)
+		{
+			const auto names = store.player_names(it->second);
+			if (!names.empty() && fold_case(names.back()) == folded)
+				{ return it->second; }
+		}
+		return first->second;
+	}
+};
+
+// playtime of each player of a session_store on each day in a time zone, with prefix sums,
+// so the playtime in a range of whole days is two binary searches per player instead of going through their sessions
+// sessions that span midnight are split between the days. sessions with negative durations count on the day they start
+class daily_playtime
+{
+private:
+	const std::chrono::time_zone* timezone;
+	// days of player i are [day_offsets[i], day_offsets[i + 1]) of days and cumulative_seconds, sorted
+	std::vector<std::uint32_t> day_offsets{ 0 };
+	std::vector<std::int32_t> days;  // local days since epoch on which the player played
+	std::vector<std::int64_t> cumulative_seconds;  // playtime on days up to and including days[j] (for that player)
+
+	// @return playtime of player (starting at `offset`) on days before `day`
+	[[nodiscard]] std::int64_t playtime_before(std::uint32_t offset, std::uint32_t end, std::chrono::local_days day) const noexcept
+	{
+		const auto first = days.begin() + offset;
+		const auto it = std::lower_bound(first, days.begin() + end, day.time_since_epoch().count(), [](std::int64_t a, std::int64_t b) { return a < b; });
+		return (it == first) ? 0 : cumulative_seconds[it - days.begin() - 1];
+	}
+
+public:
+	daily_playtime(const session_store& store, const std::chrono::time_zone* timezone) : timezone(timezone)
+	{
+		day_offsets.reserve(store.size() + 1);
+		std::vector<std::pair<std::int32_t, std::int64_t>> player_days;  // day and seconds played then, reused
+		const tz_offset_table zone = store.offset_table(timezone);
+		const auto local_day = [&zone](std::chrono::system_clock::time_point tp)
+			{ return std::chrono::floor<std::chrono::days>(zone.to_local(tp)); };
+		const auto add = [&player_days](std::chrono::local_days day, std::chrono::system_clock::duration dur)
+		{
+			player_days.emplace_back(static_cast<std::int32_t>(day.time_since_epoch().count()),
+				std::chrono::duration_cast<std::chrono::seconds>(dur).count());
+		};
+		for (std::size_t i = 0; i < store.size(); i++)
+		{
+			player_days.clear();
+			for (std::size_t j = 0; j < store.num_sessions(i); j++)
+			{
+				const auto [start, duration] = store.session(i, j);
+				if (duration <= std::chrono::system_clock::duration::zero())
+				{
+					add(local_day(start), duration);
+					continue;
+				}
+				const auto end = start + duration;
+				for (auto cur = start; cur < end;)
+				{
+					const auto day = local_day(cur);
+					const std::chrono::system_clock::time_point midnight = zone.to_sys(day + std::chrono::days(1), std::chrono::choose::earliest);
+					const auto next = std::min(end, midnight);
+					add(day, next - cur);
+					cur = next;
+				}
+			}
+			std::ranges::sort(player_days, {}, &std::pair<std::int32_t, std::int64_t>::first);
+			std::int64_t cumulative = 0;
+			for (const auto& [day, seconds] : player_days)
+			{
+				cumulative += seconds;
+				if (days.size() > day_offsets.back() && days.back() == day)
+					{ cumulative_seconds.back() = cumulative; }
+				else
+				{
+					days.push_back(day);
+					cumulative_seconds.push_back(cumulative);
+				}
+			}
+			day_offsets.push_back(static_cast<std::uint32_t>(days.size()));
+		}
+	}
+
+	[[nodiscard]] const std::chrono::time_zone* get_timezone() const noexcept
+		{ return timezone; }
+
+	// @return days [first, last) covered by `range`, or empty optional if it doesn't start and end at midnight (unbounded ends are fine)
+	[[nodiscard]] static std::optional<std::pair<std::chrono::local_days, std::chrono::local_days>> whole_days(const time_range& range, const std::chrono::time_zone* timezone)
+	{
+		// @return whether `tp` is midnight
+		const auto to_day = [timezone](std::chrono::system_clock::time_point tp, std::chrono::local_days& day)
+		{
+			const auto local = timezone->to_local(tp);
+			day = std::chrono::floor<std::chrono::days>(local);
+			return day == local;
+		};
+		std::pair<std::chrono::local_days, std::chrono::local_days> res{ std::chrono::local_days(std::chrono::days::min()), std::chrono::local_days(std::chrono::days::max()) };
+		if (range.begin != std::chrono::system_clock::time_point::min() && !to_day(range.begin, res.first))
+			{ return {}; }
+		if (range.end != std::chrono::system_clock::time_point::max() && !to_day(range.end, res.second))
+			{ return {}; }
+		return res;
+	}
+
+	// @return playtime of player on days [first, last)
+	[[nodiscard]] std::chrono::seconds playtime(std::size_t player_ind, std::chrono::local_days first, std::chrono::local_days last) const noexcept
+	{
+		const std::uint32_t offset = day_offsets[player_ind], end = day_offsets[player_ind + 1];
+		return std::chrono::seconds(playtime_before(offset, end, last) - playtime_before(offset, end, first));
+	}
+};
+
+// playtime of all players in each hour of the week in a time zone, for how many players are usually online then
+// unlike daily_playtime, the 168 sums are all that is kept, so segments and recent sessions are combined by adding them
+class weekly_playtime
+{
+public:
+	static constexpr std::size_t num_hours = 7 * 24;
+
+private:
+	const std::chrono::time_zone* timezone;
+	std::array<std::int64_t, num_hours> seconds{};  // hours are weekday (0 is Sunday) * 24 + hour
+	// earliest start and latest end of the sessions
+	std::chrono::sys_seconds first_time = std::chrono::sys_seconds::max(), last_time = std::chrono::sys_seconds::min();
+
+	// add with `zone` converting to local time, which is `timezone` or a tz_offset_table of it
+	void add(const play_session& session, const auto& zone)
+	{
+		const auto start = std::chrono::floor<std::chrono::seconds>(session.first);
+		const auto end = std::chrono::floor<std::chrono::seconds>(session.first + session.second);
+		if (end <= start)
+			{ return; }
+		first_time = std::min(first_time, start);
+		last_time = std::max(last_time, end);
+		for (auto cur = start; cur < end;)
+		{
+			const auto local = zone.to_local(cur);
+			// time until the next hour, so offsets that aren't whole hours still split at local hours
+			const auto next = std::min(end, cur + (std::chrono::floor<std::chrono::hours>(local) + std::chrono::hours(1) - local));
+			seconds[hour_of_week(local)] += (next - cur).count();
+			cur = next;
+		}
+	}
+
+public:
+	explicit weekly_playtime(const std::chrono::time_zone* timezone) : timezone(timezone) {}
+	weekly_playtime(const session_store& store, const std::chrono::time_zone* timezone) : timezone(timezone)
+	{
+		// every hour of every session is converted
+		const tz_offset_table zone = store.offset_table(timezone);
+		for (std::size_t i = 0; i < store.size(); i++)
+		{
+			for (std::size_t j = 0; j < store.num_sessions(i); j++)
+				{ add(store.session(i, j), zone); }
+		}
+	}
+
+	// @return hour of the week that `local` is in
+	[[nodiscard]] static std::size_t hour_of_week(std::chrono::local_seconds local) noexcept
+	{
+		const auto day = std::chrono::floor<std::chrono::days>(local);
+		return std::chrono::weekday(day).c_encoding() * 24 + static_cast<std::size_t>(std::chrono::floor<std::chrono::hours>(local - day).count());
+	}
+
+	// add a session, split between the hours it was in. sessions with durations that aren't positive are skipped
+	void add(const play_session& session)
+		{ add(session, *timezone); }
+
+	// @param other  in the same time zone
+	weekly_playtime& operator+=(const weekly_playtime& other) noexcept
+	{
+		for (std::size_t i = 0; i < num_hours; i++)
+			{ seconds[i] += other.seconds[i]; }
+		first_time = std::min(first_time, other.first_time);
+		last_time = std::max(last_time, other.last_time);
+		return *this;
+	}
+
+	[[nodiscard]] const std::chrono::time_zone* get_timezone() const noexcept
+		{ return timezone; }
+
+	// @return whether no sessions were added
+	[[nodiscard]] bool empty() const noexcept
+		{ return first_time > last_time; }
+
+	// @return average number of players online in hour `hour` of the week (see seconds), over the weeks from the first to the last session
+	[[nodiscard]] double average_online(std::size_t hour) const
+	{
+		if (empty())
+			{ return 0; }
+		// the hours of the week that were in that time, counting the first and last ones
+		const auto first_hour = std::chrono::floor<std::chrono::hours>(timezone->to_local(first_time));
+		const auto last_hour = std::chrono::floor<std::chrono::hours>(timezone->to_local(last_time - std::chrono::seconds(1)));
+		const auto total_hours = static_cast<std::size_t>((last_hour - first_hour).count() + 1);
+		const std::size_t from_first = (hour + num_hours - hour_of_week(first_hour)) % num_hours;
+		const std::size_t occurrences = total_hours / num_hours + (from_first < total_hours % num_hours ? 1 : 0);
+		return (occurrences == 0) ? 0 : static_cast<double>(seconds[hour]) / (3600.0 * static_cast<double>(occurrences));
+	}
+};
+
+// number of players online over time as a step function, built by sweeping over the joins and leaves of sessions in order
+// every session counts, so a player in overlapping sessions is counted more than once. sessions with durations that aren't positive are skipped
+class online_players
+{
+public:
+	// time (seconds since epoch) and change in the number of players online
+	using event = std::pair<std::int64_t, std::int32_t>;
+
+private:
+	std::vector<std::int64_t> times;  // when the number changes, sorted
+	std::vector<std::int32_t> counts;  // players online from times[i] until times[i + 1]
+
+public:
+	online_players() = default;
+	// @param events  sorted, e.g. the events of several segments as they are merged (see kway_merge)
+	template<std::ranges::input_range R>
+	explicit online_players(R&& events)
+	{
+		std::int32_t count = 0;
+		for (const auto& [time, delta] : events)
+		{
+			count += delta;
+			if (!times.empty() && times.back() == time)
+				{ counts.back() = count; }
+			else
+			{
+				times.push_back(time);
+				counts.push_back(count);
+			}
+		}
+	}
+
+	// add the join and leave of a session to (unsorted) events
+	static void add_events(std::vector<event>& events, const play_session& session)
+	{
+		const auto& [start, duration] = session;
+		if (duration <= std::chrono::system_clock::duration::zero())
+			{ return; }
+		const auto to_seconds = [](std::chrono::system_clock::time_point tp)
+			{ return std::chrono::floor<std::chrono::seconds>(tp).time_since_epoch().count(); };
+		events.emplace_back(to_seconds(start), 1);
+		events.emplace_back(to_seconds(start + duration), -1);
+	}
+
+	// @return joins and leaves of all sessions of `store`, sorted
+	[[nodiscard]] static std::vector<event> get_events(const session_store& store)
+	{
+		std::vector<event> events;
+		events.reserve(store.total_sessions() * 2);
+		for (std::size_t i = 0; i < store.size(); i++)
+		{
+			for (std::size_t j = 0; j < store.num_sessions(i); j++)
+				{ add_events(events, store.session(i, j)); }
+		}
+		std::ranges::sort(events);
+		return events;
+	}
+
+	// @return number of changes
+	[[nodiscard]] std::size_t size() const noexcept
+		{ return times.size(); }
+	[[nodiscard]] bool empty() const noexcept
+		{ return times.empty(); }
+
+	// @return time of change i (seconds since epoch)
+	[[nodiscard]] std::int64_t time(std::size_t i) const noexcept
+		{ return times[i]; }
+	// @return players online after change i
+	[[nodiscard]] std::int32_t count(std::size_t i) const noexcept
+		{ return counts[i]; }
+
+	// @return index of first change after `time`
+	[[nodiscard]] std::size_t upper_bound(std::int64_t time) const noexcept
+		{ return std::ranges::upper_bound(times, time) - times.begin(); }
+};
+
+// sessions from log files that have been fully read, as a list of immutable segments (oldest first)
+// copies share segments, and committing only creates a segment for the new data, so checkpoints don't copy the whole history
+// segments are merged when a newer one gets close to the size of the one before it, so there are O(log n) of them
+class session_history
+{
+private:
+	std::vector<std::shared_ptr<const session_store>> segments;
+
+public:
+	session_history() = default;
+	explicit session_history(session_store store)
+	{
+		if (!store.empty())
+			{ segments.push_back(std::make_shared<const session_store>(std::move(store))); }
+	}
+	// @param segments  of another history (see get_segments), e.g. received from a primary (see replication_client)
+	explicit session_history(std::vector<std::shared_ptr<const session_store>> segments) : segments(std::move(segments)) {}
+
+	// add `data` as newer than everything already committed
+	template<log_data_like data_t>
+	void commit(const data_t& data)
+	{
+		if (data.empty())
+			{ return; }
+		std::shared_ptr<const session_store> segment = std::make_shared<const session_store>(data);
+		// a mapped segment (a loaded snapshot, or spilled by segment_spill) would be copied into memory by merging it
+		while (!segments.empty() && !segments.back()->mapped() && segments.back()->total_sessions() <= segment->total_sessions() * 2)
+		{
+			const std::array<const session_store*, 2> parts = { segments.back().get(), segment.get() };
+			segment = std::make_shared<const session_store>(std::span<const session_store* const>(parts));
+			segments.pop_back();
+		}
+		segments.push_back(std::move(segment));
+	}
+
+	// add `data` among the segments by the time of its sessions instead of as the newest, e.g. an archive that was put in the logs directory late
+	// segments are in time order, so only those with sessions starting during `data`'s are merged with it (sorted, and with reconnect bursts
+	// split between it and them merged), and the rest are kept as they are. with none, it becomes a segment of its own between them
+	// @param merge_gap  see session_aggregator
+	template<log_data_like data_t>
+	void insert(const data_t& data, std::chrono::system_clock::duration merge_gap)
+	{
+		auto segment = std::make_shared<const session_store>(data);
+		const auto span = segment->start_span();
+		if (!span)
+			{ return; }
+		std::vector<std::optional<std::pair<std::chrono::sys_seconds, std::chrono::sys_seconds>>> spans;
+		spans.reserve(segments.size());
+		for (const auto& cur : segments)
+			{ spans.push_back(cur->start_span()); }
+		// [first, last) are the segments whose sessions start while data's do
+		std::size_t first = 0;
+		while (first < segments.size() && (!spans[first] || spans[first]->second < span->first))
+			{ first++; }
+		std::size_t last = first;
+		while (last < segments.size() && (!spans[last] || spans[last]->first <= span->second))
+			{ last++; }
+		if (first == last)
+		{
+			segments.insert(segments.begin() + static_cast<std::ptrdiff_t>(first), std::move(segment));
+			return;
+		}
+		// data goes before the first segment that starts after it, so names are still oldest first as far as possible
+		std::vector<const session_store*> parts;
+		parts.reserve(last - first + 1);
+		for (std::size_t i = first; i < last; i++)
+		{
+			if (parts.size() == i - first && spans[i] && spans[i]->first > span->first)
+				{ parts.push_back(segment.get()); }
+			parts.push_back(segments[i].get());
+		}
+		if (parts.size() == last - first)
+			{ parts.push_back(segment.get()); }
+		session_store merged = session_store(std::span<const session_store* const>(parts)).sorted();
+		if (merged.needs_compaction(merge_gap))
+			{ merged = merged.compacted(merge_gap); }
+		segments.erase(segments.begin() + static_cast<std::ptrdiff_t>(first + 1), segments.begin() + static_cast<std::ptrdiff_t>(last));
+		segments[first] = std::make_shared<const session_store>(std::move(merged));
+	}
+
+	// roll up the old sessions of segments that have any (see session_store::rolled_up), so memory use doesn't grow with every session
+	// the segments are replaced, so values cached for them are made again
+	// @return whether anything changed
+	bool roll_up(std::chrono::system_clock::time_point cutoff, const std::chrono::time_zone* timezone)
+	{
+		bool changed = false;
+		for (auto& segment : segments)
+		{
+			if (segment->needs_roll_up(cutoff, timezone))
+			{
+				segment = std::make_shared<const session_store>(segment->rolled_up(cutoff, timezone));
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	// merge reconnect bursts in segments that have any (see session_store::compacted), for sessions parsed before merge_gap was set
+	// only sessions within a segment are merged, a burst split between two segments is kept
+	// @return whether anything changed
+	bool compact(std::chrono::system_clock::duration merge_gap)
+	{
+		bool changed = false;
+		for (auto& segment : segments)
+		{
+			if (segment->needs_compaction(merge_gap))
+			{
+				segment = std::make_shared<const session_store>(segment->compacted(merge_gap));
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	// compress the segments in memory except the newest (see session_store::compressed), which is merged with the data committed next
+	// mapped segments are left as they are, since compressing them would copy their sessions into memory
+	// the segments are replaced, so values cached for them are made again
+	// @return whether anything changed
+	bool compress()
+	{
+		bool changed = false;
+		for (std::size_t i = 0; i + 1 < segments.size(); i++)
+		{
+			if (!segments[i]->mapped() && !segments[i]->compressed_blocks())
+			{
+				segments[i] = std::make_shared<const session_store>(segments[i]->compressed());
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	// replace segments, oldest first, with what `replace` returns for them (e.g. a copy in a file, see segment_spill)
+	// @param replace  std::shared_ptr<const session_store>(const session_store&), returns null to keep the segment
+	// @return whether anything changed
+	bool replace_segments(auto&& replace)
+	{
+		bool changed = false;
+		for (auto& segment : segments)
+		{
+			if (auto replacement = replace(std::as_const(*segment)))
+			{
+				segment = std::move(replacement);
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	// add the segments of `other` (e.g. another server's history) after these, sharing them instead of copying their sessions
+	// they aren't merged with these, so the segments are only oldest first within each history
+	void add_segments(const session_history& other)
+		{ segments.insert(segments.end(), other.segments.begin(), other.segments.end()); }
+
+	// @return all segments combined into one store, which is the only segment if there is one (so nothing is copied)
+	[[nodiscard]] std::shared_ptr<const session_store> merged() const
+	{
+		if (segments.empty())
+			{ return std::make_shared<const session_store>(); }
+		if (segments.size() == 1)
+			{ return segments.front(); }
+		std::vector<const session_store*> parts;
+		parts.reserve(segments.size());
+		for (const auto& segment : segments)
+			{ parts.push_back(segment.get()); }
+		return std::make_shared<const session_store>(std::span<const session_store* const>(parts));
+	}
+
+	[[nodiscard]] std::span<const std::shared_ptr<const session_store>> get_segments() const noexcept
+		{ return segments; }
+
+	// @return memory used by all segments (see memory_usage). a player in several segments is counted in each
+	[[nodiscard]] memory_usage memory_used() const noexcept
+	{
+		memory_usage res{ .bytes = detail::vector_heap_bytes(segments) };
+		for (const auto& segment : segments)
+			{ res += segment->memory_used(); }
+		return res;
+	}
+};
+
+namespace detail
+{
+	// values calculated from history segments, which never change. entries are removed once their segment is gone
+	template<typename T>
+	class segment_cache
+	{
+	private:
+		std::mutex mutex;
+		std::map<const session_store*, std::pair<std::weak_ptr<const session_store>, std::shared_ptr<const T>>> entries;
+
+	public:
+		// @param make  returns the value of `segment`, called the first time the segment is used
+		[[nodiscard]] std::shared_ptr<const T> get(const std::shared_ptr<const session_store>& segment, auto&& make)
+		{
+			{
+				const std::lock_guard lock(mutex);
+				const auto it = entries.find(segment.get());
+				// a segment that is still alive can't share its address with another one
+				if (it != entries.end() && !it->second.first.expired())
+					{ return it->second.second; }
+			}
+			// calculated without the lock so other renders aren't held up
+			auto res = std::make_shared<const T>(make());
+			const std::lock_guard lock(mutex);
+			std::erase_if(entries, [](const auto& entry) { return entry.second.first.expired(); });
+			entries.insert_or_assign(segment.get(), std::make_pair(std::weak_ptr(segment), res));
+			return res;
+		}
+	};
+
+	// a value calculated from all history segments, which is only calculated again when the segments change
+	template<typename T>
+	class history_cache
+	{
+	private:
+		std::mutex mutex;
+		std::vector<std::weak_ptr<const session_store>> segments;  // that value was made from
+		std::shared_ptr<const T> value;
+
+	public:
+		// @param cur_segments  all history segments, oldest first (see session_history::get_segments)
+		// @param make  returns the value of cur_segments, called when they aren't the segments of the cached value
+		[[nodiscard]] std::shared_ptr<const T> get(std::span<const std::shared_ptr<const session_store>> cur_segments, auto&& make)
+		{
+			// weak_ptrs keep their control block, so one that is equivalent to a segment can't be of an older segment that had its address
+			const auto same_owner = [](const std::weak_ptr<const session_store>& lhs, const std::shared_ptr<const session_store>& rhs)
+				{ return !lhs.owner_before(rhs) && !rhs.owner_before(lhs); };
+			{
+				const std::lock_guard lock(mutex);
+				if (value && std::ranges::equal(segments, cur_segments, same_owner))
+					{ return value; }
+			}
+			// calculated without the lock so other users aren't held up
+			auto res = std::make_shared<const T>(make());
+			const std::lock_guard lock(mutex);
+			segments.assign(cur_segments.begin(), cur_segments.end());
+			value = res;
+			return res;
+		}
+	};
+}
+
+#endif
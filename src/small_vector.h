@@ -0,0 +1,287 @@
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <algorithm>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// vector that keeps up to N elements in itself, and moves them to the heap once there are more
+// most players in log_data_t only joined once or twice, so their names and sessions fit inline and cost no allocations
+// (see log_data_t). the interface is the part of std::vector's used here, with contiguous iterators
+// @tparam T  element type, whose move constructor mustn't throw
+template<typename T, std::size_t N>
+class small_vector
+{
+	static_assert(N > 0);
+	static_assert(std::is_nothrow_move_constructible_v<T>);
+
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = T&;
+	using const_reference = const T&;
+	using pointer = T*;
+	using const_pointer = const T*;
+	using iterator = T*;
+	using const_iterator = const T*;
+
+private:
+	// on the heap once capacity is over N, inline otherwise
+	union storage_t
+	{
+		T* heap;
+		alignas(T) std::byte buffer[N * sizeof(T)];
+	} storage;
+	std::uint32_t count = 0;
+	std::uint32_t cap = N;
+
+	[[nodiscard]] bool on_heap() const noexcept
+		{ return cap > N; }
+
+	// move the elements into `new_cap` elements on the heap (at least N + 1)
+	void reallocate(std::size_t new_cap)
+	{
+		T* const new_data = std::allocator<T>().allocate(new_cap);
+		std::uninitialized_move(begin(), end(), new_data);
+		std::destroy(begin(), end());
+		release();
+		storage.heap = new_data;
+		cap = static_cast<std::uint32_t>(new_cap);
+	}
+
+	// free the heap allocation, if there is one (the elements must have been destroyed)
+	void release() noexcept
+	{
+		if (on_heap())
+			{ std::allocator<T>().deallocate(storage.heap, cap); }
+		cap = N;
+	}
+
+	void grow_for(std::size_t new_count)
+	{
+		if (new_count > cap)
+			{ reallocate(std::max<std::size_t>(new_count, 2 * static_cast<std::size_t>(cap))); }
+	}
+
+	// take the elements of `other`, which is left empty. this must be empty and inline
+	void steal(small_vector& other) noexcept
+	{
+		if (other.on_heap())
+		{
+			storage.heap = other.storage.heap;
+			cap = other.cap;
+			other.cap = N;
+		}
+		else
+		{
+			std::uninitialized_move(other.begin(), other.end(), data());
+			std::destroy(other.begin(), other.end());
+		}
+		count = other.count;
+		other.count = 0;
+	}
+
+public:
+	small_vector() noexcept {}
+	small_vector(std::initializer_list<T> init)
+		: small_vector(init.begin(), init.end()) {}
+	template<std::input_iterator It>
+	small_vector(It first, It last)
+		{ insert(end(), first, last); }
+	small_vector(const small_vector& other)
+		: small_vector(other.begin(), other.end()) {}
+	small_vector(small_vector&& other) noexcept
+		{ steal(other); }
+	~small_vector()
+	{
+		clear();
+		release();
+	}
+
+	small_vector& operator=(const small_vector& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			insert(end(), other.begin(), other.end());
+		}
+		return *this;
+	}
+	small_vector& operator=(small_vector&& other) noexcept
+	{
+		if (this != &other)
+		{
+			clear();
+			release();
+			steal(other);
+		}
+		return *this;
+	}
+
+	[[nodiscard]] T* data() noexcept
+		{ return on_heap() ? storage.heap : std::launder(reinterpret_cast<T*>(storage.buffer)); }
+	[[nodiscard]] const T* data() const noexcept
+		{ return on_heap() ? storage.heap : std::launder(reinterpret_cast<const T*>(storage.buffer)); }
+	[[nodiscard]] size_type size() const noexcept
+		{ return count; }
+	[[nodiscard]] bool empty() const noexcept
+		{ return count == 0; }
+	[[nodiscard]] size_type capacity() const noexcept
+		{ return cap; }
+	// @return bytes allocated for the elements, 0 while they are inline (see detail::vector_heap_bytes)
+	[[nodiscard]] size_type heap_bytes() const noexcept
+		{ return on_heap() ? cap * sizeof(T) : 0; }
+
+	[[nodiscard]] iterator begin() noexcept
+		{ return data(); }
+	[[nodiscard]] iterator end() noexcept
+		{ return data() + count; }
+	[[nodiscard]] const_iterator begin() const noexcept
+		{ return data(); }
+	[[nodiscard]] const_iterator end() const noexcept
+		{ return data() + count; }
+	[[nodiscard]] const_iterator cbegin() const noexcept
+		{ return begin(); }
+	[[nodiscard]] const_iterator cend() const noexcept
+		{ return end(); }
+	[[nodiscard]] std::reverse_iterator<iterator> rbegin() noexcept
+		{ return std::reverse_iterator(end()); }
+	[[nodiscard]] std::reverse_iterator<iterator> rend() noexcept
+		{ return std::reverse_iterator(begin()); }
+	[[nodiscard]] std::reverse_iterator<const_iterator> rbegin() const noexcept
+		{ return std::reverse_iterator(end()); }
+	[[nodiscard]] std::reverse_iterator<const_iterator> rend() const noexcept
+		{ return std::reverse_iterator(begin()); }
+
+	[[nodiscard]] T& operator[](size_type i) noexcept
+		{ return data()[i]; }
+	[[nodiscard]] const T& operator[](size_type i) const noexcept
+		{ return data()[i]; }
+	[[nodiscard]] T& front() noexcept
+		{ return data()[0]; }
+	[[nodiscard]] const T& front() const noexcept
+		{ return data()[0]; }
+	[[nodiscard]] T& back() noexcept
+		{ return data()[count - 1]; }
+	[[nodiscard]] const T& back() const noexcept
+		{ return data()[count - 1]; }
+
+	void reserve(size_type new_cap)
+	{
+		if (new_cap > cap)
+			{ reallocate(new_cap); }
+	}
+
+	// remove elements after the first `new_count`, or add value initialized ones until there are that many
+	void resize(size_type new_count)
+	{
+		if (new_count < count)
+		{
+			std::destroy(begin() + new_count, end());
+			count = static_cast<std::uint32_t>(new_count);
+			return;
+		}
+		reserve(new_count);
+		std::uninitialized_value_construct(end(), begin() + new_count);
+		count = static_cast<std::uint32_t>(new_count);
+	}
+
+	template<typename... Args>
+	T& emplace_back(Args&&... args)
+	{
+		if (count == cap)
+		{
+			// the arguments may be elements, which have to be read before they move
+			T value(std::forward<Args>(args)...);
+			grow_for(count + 1);
+			std::construct_at(data() + count, std::move(value));
+		}
+		else
+			{ std::construct_at(data() + count, std::forward<Args>(args)...); }
+		return data()[count++];
+	}
+	void push_back(const T& value)
+		{ emplace_back(value); }
+	void push_back(T&& value)
+		{ emplace_back(std::move(value)); }
+	void pop_back() noexcept
+		{ std::destroy_at(data() + --count); }
+
+	// insert [first, last) before `pos`
+	// @return iterator to the first inserted element
+	template<std::input_iterator It>
+	iterator insert(const_iterator pos, It first, It last)
+	{
+		const size_type offset = static_cast<size_type>(pos - begin());
+		const size_type old_count = count;
+		for (; first != last; ++first)
+			{ emplace_back(*first); }
+		std::rotate(begin() + offset, begin() + old_count, end());
+		return begin() + offset;
+	}
+	iterator insert(const_iterator pos, T value)
+	{
+		const size_type offset = static_cast<size_type>(pos - begin());
+		emplace_back(std::move(value));
+		std::rotate(begin() + offset, end() - 1, end());
+		return begin() + offset;
+	}
+
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		const auto offset = first - begin();
+		iterator it = begin() + offset;
+		const iterator new_end = std::move(it + (last - first), end(), it);
+		std::destroy(new_end, end());
+		count = static_cast<std::uint32_t>(new_end - begin());
+		return it;
+	}
+	iterator erase(const_iterator pos)
+		{ return erase(pos, pos + 1); }
+
+	void clear() noexcept
+	{
+		std::destroy(begin(), end());
+		count = 0;
+	}
+
+	// move the elements back inline if they fit, or into an allocation of just their size
+	void shrink_to_fit()
+	{
+		if (!on_heap() || count == cap)
+			{ return; }
+		if (count > N)
+		{
+			reallocate(count);
+			return;
+		}
+		T* const heap = storage.heap;
+		const std::uint32_t heap_cap = cap;
+		cap = N;
+		std::uninitialized_move(heap, heap + count, data());
+		std::destroy(heap, heap + count);
+		std::allocator<T>().deallocate(heap, heap_cap);
+	}
+
+	void swap(small_vector& other) noexcept
+	{
+		small_vector temp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(temp);
+	}
+
+	[[nodiscard]] friend bool operator==(const small_vector& lhs, const small_vector& rhs)
+		{ return std::ranges::equal(lhs, rhs); }
+	[[nodiscard]] friend auto operator<=>(const small_vector& lhs, const small_vector& rhs)
+		{ return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(), rhs.begin(), rhs.end()); }
+};
+
+#endif
@@ -0,0 +1,631 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "binary_io.h"
+#include "file_writer.h"
+#include "lag_series.h"
+#include "logger.h"
+#include "mapped_file.h"
+#include "parse_logs.h"
+#include "session_store.h"
+#include "uptime_series.h"
+
+// on-disk copy of everything parsed from archived logs, so they don't need to be parsed again on startup
+// it is a base file and segment files next to it (the base's path with .1, .2, ... appended), each of which adds the log files archived since
+// the file before it (see append_snapshot_segment). rotating latest.log then writes only what it adds, and the base is only written again when
+// the segments are compacted into it (see compact_snapshot), which can be done in the background. every file is written to a temporary file
+// that is renamed over it, so a crash never leaves a partly written base or segment
+// layout of each file: header, then payload of sequence number, manifest, log format, parse context, lag and uptime series, and session store
+// the session store's columns are aligned so the loaded history views them in the mapped file instead of copying them (see session_store::read),
+// which makes loading cost the same however long the history is, and lets processes loading the same snapshot share its pages.
+// only the payload before the base's session store is checksummed, since checksumming the columns would read all of them. segments are small,
+// so all of theirs is
+struct snapshot_t
+{
+	std::vector<log_manifest_entry> manifest;  // log files that have been parsed, in order
+	log_format format = log_format::vanilla;  // of the log files
+	session_history history;  // the base's sessions, then each segment's
+	parse_ctx_t ctx;  // parse context after the last file in manifest
+	lag_series lag;  // of the files in manifest
+	uptime_series uptime;  // of the files in manifest
+	std::uint64_t next_segment = 1;  // sequence number of the segment to append next
+	std::size_t num_segments = 0;  // segments loaded after the base
+};
+
+// segments a snapshot may have before they are compacted into its base (see compact_snapshot)
+inline constexpr std::size_t snapshot_compaction_segments = 16;
+
+namespace detail
+{
+	inline constexpr std::string_view snapshot_magic = "QCV2SNAP";
+	// increment when the layout (or anything it stores, e.g. session_store) changes
+	inline constexpr std::uint32_t snapshot_version = 8;
+	// to detect snapshots written on a machine with a different byte order
+	inline constexpr std::uint32_t snapshot_byte_order = 0x01020304;
+
+	struct snapshot_header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		std::uint64_t payload_size;
+		std::uint64_t checksummed_size;  // of the payload before the session store, or all of it
+		std::uint64_t payload_checksum;  // of those bytes
+	};
+
+	// what one file of a snapshot has (see snapshot_t)
+	struct snapshot_file
+	{
+		std::uint64_t sequence;  // of a segment, or of the segment after a base
+		std::vector<log_manifest_entry> manifest;  // log files up to the last one the file adds
+		log_format format;
+		session_store sessions;  // of the files the file adds
+		parse_ctx_t ctx;  // after the last file in manifest
+		lag_series lag;  // of the files the file adds
+		uptime_series uptime;  // of the files the file adds
+	};
+
+	// @return path of segment `sequence` of the snapshot at `path`
+	[[nodiscard]] inline std::filesystem::path snapshot_segment_path(const std::filesystem::path& path, std::uint64_t sequence)
+	{
+		auto res = path;
+		res += std::format(".{}", sequence);
+		return res;
+	}
+
+	// @return sequence number and path of each segment file of the snapshot at `path`, in no particular order
+	[[nodiscard]] inline std::vector<std::pair<std::uint64_t, std::filesystem::path>> snapshot_segment_files(const std::filesystem::path& path)
+	{
+		std::vector<std::pair<std::uint64_t, std::filesystem::path>> res;
+		const std::string prefix = path.filename().string() + ".";
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(path.parent_path().empty() ? std::filesystem::path(".") : path.parent_path(), ec))
+		{
+			const std::string filename = entry.path().filename().string();
+			std::uint64_t sequence;
+			if (filename.starts_with(prefix) &&
+				std::from_chars(filename.data() + prefix.size(), filename.data() + filename.size(), sequence) == std::from_chars_result{ filename.data() + filename.size(), std::errc() })
+				{ res.emplace_back(sequence, entry.path()); }
+		}
+		return res;
+	}
+
+	// remove the segment files of the snapshot at `path` that are numbered below `sequence`, which its base replaces
+	inline void remove_snapshot_segments(const std::filesystem::path& path, std::uint64_t sequence)
+	{
+		for (const auto& [cur_sequence, segment_path] : snapshot_segment_files(path))
+		{
+			std::error_code ec;
+			if (cur_sequence < sequence)
+				{ std::filesystem::remove(segment_path, ec); }
+		}
+	}
+
+	[[nodiscard]] inline std::uint64_t snapshot_checksum(std::string_view data) noexcept
+		{ return fnv1a(data); }
+
+	inline void write_time_point(binary_writer& writer, std::chrono::system_clock::time_point tp)
+		{ writer.write<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count()); }
+	inline bool read_time_point(binary_reader& reader, std::chrono::system_clock::time_point& tp)
+	{
+		std::int64_t count;
+		if (!reader.read(count))
+			{ return false; }
+		tp = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(count)));
+		return true;
+	}
+
+	// write the payload before the session store
+	inline void write_snapshot_metadata(binary_writer& writer, std::span<const log_manifest_entry> manifest, log_format format, const parse_ctx_t& ctx)
+	{
+		writer.write<std::uint64_t>(manifest.size());
+		for (const auto& entry : manifest)
+		{
+			writer.write_string(entry.path.filename().string());
+			writer.write<std::int32_t>(static_cast<int>(entry.date.year()));
+			writer.write<std::uint32_t>(static_cast<unsigned int>(entry.date.month()));
+			writer.write<std::uint32_t>(static_cast<unsigned int>(entry.date.day()));
+			writer.write<std::uint32_t>(entry.index);
+			writer.write(entry.codec);
+			writer.write<std::uint8_t>(entry.is_latest);
+			writer.write<std::uint64_t>(entry.size);
+			writer.write<std::int64_t>(entry.mtime.time_since_epoch().count());
+			// an empty summary's times don't fit in nanoseconds everywhere
+			writer.write(entry.summary.players);
+			if (entry.summary.players != 0)
+			{
+				write_time_point(writer, entry.summary.first);
+				write_time_point(writer, entry.summary.last);
+			}
+		}
+		writer.write(format);
+
+		writer.write_string(ctx.cur_filename);
+		write_time_point(writer, ctx.date_tp);
+		writer.write<std::uint64_t>(ctx.line);
+		writer.write<std::uint8_t>(ctx.server_stopped);
+		writer.write<std::uint64_t>(ctx.player_info.size());
+		for (std::uint32_t id = 0; id < ctx.player_info.size(); id++)
+		{
+			const auto& [uuid, join_time] = ctx.player_info.infos()[id];
+			writer.write_string(ctx.player_info.name(id));
+			writer.write<std::uint8_t>(uuid.has_value());
+			if (uuid)
+				{ writer.write(uuid.value()); }
+			writer.write<std::uint8_t>(join_time.has_value());
+			if (join_time)
+				{ write_time_point(writer, join_time.value()); }
+		}
+	}
+
+	// read what write_snapshot_metadata wrote
+	// @param logs_dir  directory the manifest files are in
+	// @return true on success
+	[[nodiscard]] inline bool read_snapshot_metadata(binary_reader& reader, const std::filesystem::path& logs_dir, std::vector<log_manifest_entry>& manifest,
+		log_format& format, parse_ctx_t& ctx)
+	{
+		std::uint64_t manifest_size;
+		if (!reader.read(manifest_size) || manifest_size > reader.remaining())
+			{ return false; }
+		manifest.resize(manifest_size);
+		for (auto& entry : manifest)
+		{
+			std::string filename;
+			std::int32_t year;
+			std::uint32_t month, day;
+			std::uint8_t is_latest;
+			std::int64_t mtime_count;
+			if (!reader.read_string(filename) || !reader.read(year) || !reader.read(month) || !reader.read(day) || !reader.read(entry.index) ||
+				!reader.read(entry.codec) || static_cast<std::size_t>(entry.codec) >= detail::log_codec_extensions.size() || !reader.read(is_latest) || !reader.read(entry.size) || !reader.read(mtime_count) ||
+				!reader.read(entry.summary.players) ||
+				(entry.summary.players != 0 && (!read_time_point(reader, entry.summary.first) || !read_time_point(reader, entry.summary.last))))
+				{ return false; }
+			entry.path = logs_dir / filename;
+			entry.date = std::chrono::year(year) / std::chrono::month(month) / std::chrono::day(day);
+			entry.is_latest = is_latest;
+			entry.mtime = std::filesystem::file_time_type(std::filesystem::file_time_type::duration(mtime_count));
+		}
+
+		if (!reader.read(format) || static_cast<std::size_t>(format) >= log_format_names.size())
+			{ return false; }
+
+		std::uint64_t line, num_players;
+		std::uint8_t server_stopped;
+		if (!reader.read_string(ctx.cur_filename) || !read_time_point(reader, ctx.date_tp) || !reader.read(line) || !reader.read(server_stopped) ||
+			!reader.read(num_players) || num_players > reader.remaining())
+			{ return false; }
+		ctx.line = line;
+		ctx.server_stopped = server_stopped;
+		for (std::uint64_t i = 0; i < num_players; i++)
+		{
+			std::string name;
+			std::uint8_t has_uuid, has_join_time;
+			if (!reader.read_string(name) || !reader.read(has_uuid))
+				{ return false; }
+			const std::uint32_t id = ctx.player_info.intern(name);
+			if (has_uuid)
+			{
+				uuid_t uuid;
+				if (!reader.read(uuid))
+					{ return false; }
+				ctx.player_info.set_uuid(id, uuid);
+			}
+			if (!reader.read(has_join_time))
+				{ return false; }
+			if (has_join_time)
+			{
+				std::chrono::system_clock::time_point join_time;
+				if (!read_time_point(reader, join_time))
+					{ return false; }
+				ctx.player_info.set_join_time(id, join_time);
+			}
+		}
+		return reader.ok();
+	}
+
+	// @param logs_dir  directory the manifest files are in
+	// @param checksummed_size  bytes of the payload before the session store, or all of it
+	// @param file  that the session store will view
+	[[nodiscard]] inline std::optional<snapshot_file> read_snapshot_payload(binary_reader& reader, const std::filesystem::path& logs_dir,
+		std::uint64_t checksummed_size, std::shared_ptr<const mapped_file> file)
+	{
+		const std::size_t payload_size = reader.remaining();
+		snapshot_file res;
+		if (!reader.read(res.sequence) || !read_snapshot_metadata(reader, logs_dir, res.manifest, res.format, res.ctx) || !res.lag.read(reader) || !res.uptime.read(reader) ||
+			(payload_size - reader.remaining() != checksummed_size && checksummed_size != payload_size) ||
+			!res.sessions.read(reader, std::move(file)) || reader.remaining() != 0)
+			{ return {}; }
+		return res;
+	}
+
+	// load a file written by write_snapshot_file
+	// @return its contents, or empty optional if it doesn't exist or is invalid (a warning will be printed if it is invalid)
+	[[nodiscard]] inline std::optional<snapshot_file> load_snapshot_file(const std::filesystem::path& path, const std::filesystem::path& logs_dir)
+	{
+		std::error_code ec;
+		if (!std::filesystem::exists(path, ec))
+			{ return {}; }
+
+		// shared with the loaded history, which views it
+		auto file = std::make_shared<mapped_file>();
+		if (!file->open(path))
+		{
+			log_message(log_severity::warning, std::format("Could not open snapshot {}, ignoring it", path.string()));
+			return {};
+		}
+		const std::string_view data = file->data();
+		snapshot_header header;
+		if (data.size() < sizeof(header))
+		{
+			log_message(log_severity::warning, std::format("Snapshot {} is truncated, ignoring it", path.string()));
+			return {};
+		}
+		std::memcpy(&header, data.data(), sizeof(header));
+		const std::string_view payload = data.substr(sizeof(header));
+		if (std::string_view(header.magic, sizeof(header.magic)) != snapshot_magic || header.byte_order != snapshot_byte_order)
+		{
+			log_message(log_severity::warning, std::format("{} is not a snapshot for this platform, ignoring it", path.string()));
+			return {};
+		}
+		if (header.version != snapshot_version)
+		{
+			log_message(log_severity::warning, std::format("Snapshot {} has version {} (expected {}), ignoring it", path.string(), header.version, snapshot_version));
+			return {};
+		}
+		if (header.payload_size != payload.size() || header.checksummed_size > payload.size() ||
+			header.payload_checksum != snapshot_checksum(payload.substr(0, header.checksummed_size)))
+		{
+			log_message(log_severity::warning, std::format("Snapshot {} is corrupted, ignoring it", path.string()));
+			return {};
+		}
+
+		// alignment is relative to the start of the file, as it was for the writer
+		binary_reader reader(payload, data.data());
+		auto res = read_snapshot_payload(reader, logs_dir, header.checksummed_size, std::move(file));
+		if (!res)
+			{ log_message(log_severity::warning, std::format("Snapshot {} is malformed, ignoring it", path.string())); }
+		return res;
+	}
+
+	// @param sequence  see snapshot_file
+	// @param checksum_sessions  whether the session store is checksummed too
+	// @return contents of a file of a snapshot
+	[[nodiscard]] inline std::string serialize_snapshot_file(std::uint64_t sequence, std::span<const log_manifest_entry> manifest, log_format format,
+		const session_store& sessions, const parse_ctx_t& ctx, const lag_series& lag, const uptime_series& uptime, bool checksum_sessions)
+	{
+		std::string data(sizeof(snapshot_header), '\0');
+		binary_writer writer(data);
+		writer.write(sequence);
+		write_snapshot_metadata(writer, manifest, format, ctx);
+		lag.write(writer);
+		uptime.write(writer);
+		std::size_t checksummed_size = data.size() - sizeof(snapshot_header);
+		sessions.write(writer);
+		if (checksum_sessions)
+			{ checksummed_size = data.size() - sizeof(snapshot_header); }
+
+		const std::string_view payload = std::string_view(data).substr(sizeof(snapshot_header));
+		snapshot_header header{};
+		std::memcpy(header.magic, snapshot_magic.data(), sizeof(header.magic));
+		header.version = snapshot_version;
+		header.byte_order = snapshot_byte_order;
+		header.payload_size = payload.size();
+		header.checksummed_size = checksummed_size;
+		header.payload_checksum = snapshot_checksum(payload.substr(0, checksummed_size));
+		std::memcpy(data.data(), &header, sizeof(header));
+		return data;
+	}
+
+	// write a file of a snapshot to `path`, replacing it atomically and durably (see replace_file)
+	// @return true on success (an error will be printed on failure)
+	inline bool write_snapshot_file(const std::filesystem::path& path, std::uint64_t sequence, std::span<const log_manifest_entry> manifest, log_format format,
+		const session_store& sessions, const parse_ctx_t& ctx, const lag_series& lag, const uptime_series& uptime, bool checksum_sessions)
+		{ return replace_file(path, serialize_snapshot_file(sequence, manifest, format, sessions, ctx, lag, uptime, checksum_sessions)); }
+}
+
+// check whether a snapshot can be used for the log files currently in the logs directory
+// files are matched by the date and number in their name. an archive that was compressed since it was read is the same one, since log4j
+// renames latest.log to yyyy-mm-dd-#.log (which is what is read when it's moved) and only compresses it after
+// @param manifest  current log files (see scan_logs_dir)
+// @return number of files at the start of `manifest` that the snapshot covers,
+//         or empty optional if it doesn't match (something was changed or removed)
+[[nodiscard]] inline std::optional<std::size_t> snapshot_coverage(std::span<const log_manifest_entry> snapshot_manifest, std::span<const log_manifest_entry> manifest)
+{
+	if (snapshot_manifest.size() > manifest.size())
+		{ return {}; }
+	for (std::size_t i = 0; i < snapshot_manifest.size(); i++)
+	{
+		const auto& lhs = snapshot_manifest[i];
+		const auto& rhs = manifest[i];
+		const bool compressed_since = lhs.codec == log_codec::none && rhs.codec != log_codec::none;
+		if (lhs.is_latest != rhs.is_latest || lhs.date != rhs.date || lhs.index != rhs.index ||
+			(!compressed_since && (lhs.path.filename() != rhs.path.filename() || lhs.size != rhs.size || lhs.mtime != rhs.mtime)))
+			{ return {}; }
+	}
+	return snapshot_manifest.size();
+}
+
+// load snapshot written by save_snapshot, with the segments appended to it since (see append_snapshot_segment)
+// @param logs_dir  directory the log files in the snapshot were read from
+// @return snapshot, or empty optional if it doesn't exist or is invalid (a warning will be printed if it is invalid)
+[[nodiscard]] inline std::optional<snapshot_t> load_snapshot(const std::filesystem::path& path, const std::filesystem::path& logs_dir)
+{
+	auto base = detail::load_snapshot_file(path, logs_dir);
+	if (!base)
+		{ return {}; }
+	std::optional<snapshot_t> snapshot(std::in_place, std::move(base->manifest), base->format, session_history(std::move(base->sessions)), std::move(base->ctx),
+		std::move(base->lag), std::move(base->uptime), base->sequence, 0);
+	for (;; snapshot->next_segment++)
+	{
+		const auto segment_path = detail::snapshot_segment_path(path, snapshot->next_segment);
+		std::error_code ec;
+		if (!std::filesystem::exists(segment_path, ec))
+			{ break; }
+		auto segment = detail::load_snapshot_file(segment_path, logs_dir);
+		// e.g. a segment of another snapshot that was copied here
+		if (!segment || segment->sequence != snapshot->next_segment || segment->format != snapshot->format || segment->manifest.size() <= snapshot->manifest.size() ||
+			snapshot_coverage(snapshot->manifest, segment->manifest) != snapshot->manifest.size())
+		{
+			log_message(log_severity::warning, std::format("Snapshot segment {} does not continue snapshot {}, ignoring it and the segments after it",
+				segment_path.string(), path.string()));
+			break;
+		}
+		snapshot->manifest = std::move(segment->manifest);
+		snapshot->history.add_segments(session_history(std::move(segment->sessions)));
+		snapshot->ctx = std::move(segment->ctx);
+		snapshot->lag.append(segment->lag);
+		snapshot->uptime.append(segment->uptime);
+		snapshot->num_segments++;
+	}
+	return snapshot;
+}
+
+// write snapshot to `path` as a base without segments, replacing it atomically (through a temporary file that is renamed over it)
+// segments it had are removed, and ignored if that fails or is interrupted
+// @param lag  of the files in `manifest`
+// @param uptime  of the files in `manifest`
+// @return sequence number of the segment to append next (see append_snapshot_segment), or empty optional on failure (an error will be printed)
+inline std::optional<std::uint64_t> save_snapshot(const std::filesystem::path& path, std::span<const log_manifest_entry> manifest, log_format format,
+	const session_store& history, const parse_ctx_t& ctx, const lag_series& lag, const uptime_series& uptime)
+{
+	std::uint64_t sequence = 1;
+	for (const auto& segment : detail::snapshot_segment_files(path))
+		{ sequence = std::max(sequence, segment.first + 1); }
+	if (!detail::write_snapshot_file(path, sequence, manifest, format, history, ctx, lag, uptime, false))
+		{ return {}; }
+	detail::remove_snapshot_segments(path, sequence);
+	return sequence;
+}
+
+// add the sessions of newly archived log files to the snapshot at `path` as a segment, without reading or writing what it already has
+// @param sequence  of the segment, the snapshot's next_segment (see snapshot_t and save_snapshot)
+// @param manifest  log files the snapshot will cover: the ones it covers now, then the new ones
+// @param data  parsed from the new files
+// @param ctx  parse context after the new files
+// @param lag  of the new files
+// @param uptime  of the new files
+// @return true on success (an error will be printed on failure)
+inline bool append_snapshot_segment(const std::filesystem::path& path, std::uint64_t sequence, std::span<const log_manifest_entry> manifest,
+	log_format format, const log_data_t& data, const parse_ctx_t& ctx, const lag_series& lag, const uptime_series& uptime)
+{
+	return detail::write_snapshot_file(detail::snapshot_segment_path(path, sequence), sequence, manifest, format, session_store(data), ctx, lag, uptime, true);
+}
+// like append_snapshot_segment, but only the segment's contents are made on the calling thread, and `writer` writes them
+// files saved with save_snapshot or compact_snapshot after this should flush `writer` first, so the segment is on disk
+// @param callback  called with whether the segment was written (see durable_file_writer::callback_t)
+inline void queue_snapshot_segment(durable_file_writer& writer, const std::filesystem::path& path, std::uint64_t sequence, std::span<const log_manifest_entry> manifest,
+	log_format format, const log_data_t& data, const parse_ctx_t& ctx, const lag_series& lag, const uptime_series& uptime, durable_file_writer::callback_t callback)
+{
+	writer.write(detail::snapshot_segment_path(path, sequence), detail::serialize_snapshot_file(sequence, manifest, format, session_store(data), ctx, lag, uptime, true),
+		std::move(callback));
+}
+
+// merge the segments of the snapshot at `path` into its base. segments appended while this runs are kept, so it can run on another thread
+// than the one appending them (but not at the same time as save_snapshot)
+// reads and writes the whole snapshot, but a crash at any point leaves either the old base and its segments or the new one
+// @return true on success or if there was nothing to compact (a warning or error will be printed on failure)
+inline bool compact_snapshot(const std::filesystem::path& path, const std::filesystem::path& logs_dir)
+{
+	const auto snapshot = load_snapshot(path, logs_dir);
+	if (!snapshot)
+		{ return false; }
+	if (snapshot->num_segments == 0)
+		{ return true; }
+	if (!detail::write_snapshot_file(path, snapshot->next_segment, snapshot->manifest, snapshot->format, *snapshot->history.merged(), snapshot->ctx,
+		snapshot->lag, snapshot->uptime, false))
+		{ return false; }
+	detail::remove_snapshot_segments(path, snapshot->next_segment);
+	return true;
+}
+
+// where reading latest.log got to, so a restart continues from there instead of parsing all of it again
+// (which would cost more the longer the minecraft server has been running)
+// layout: header (same as a snapshot's, all of the payload is checksummed), then payload of the archives' manifest, log format,
+// parse context, position in latest.log, and the sessions, lag and uptime parsed from it
+struct latest_log_resume_t
+{
+	// bytes at the end of the prefix that are checked to be unchanged, instead of all of it, so resuming costs the same however long it is
+	static constexpr std::uint64_t tail_size = 1 << 16;
+
+	std::vector<log_manifest_entry> manifest;  // archived log files parsed before latest.log, in order
+	log_format format = log_format::vanilla;
+	parse_ctx_t ctx;  // parse context after the prefix
+	std::pair<std::uint64_t, std::uint64_t> file_id;  // of latest.log (see log_tailer::identity)
+	std::uint64_t offset;  // end of the prefix of latest.log that was parsed, always at the end of a line
+	std::uint64_t prefix_hash;  // detail::fnv1a hash of the prefix (see log_tailer::parsed_hash)
+	std::uint64_t tail_hash;  // detail::fnv1a hash of the last tail_size bytes of the prefix (or all of it if it is shorter)
+	log_data_t data;  // sessions parsed from the prefix, which aren't in history yet
+	lag_series lag;  // parsed from the prefix
+	uptime_series uptime;  // parsed from the prefix
+};
+
+namespace detail
+{
+	inline constexpr std::string_view resume_magic = "QCV2TAIL";
+	// increment when the layout changes
+	inline constexpr std::uint32_t resume_version = 4;
+
+	inline void write_duration(binary_writer& writer, std::chrono::system_clock::duration duration)
+		{ writer.write<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()); }
+	inline bool read_duration(binary_reader& reader, std::chrono::system_clock::duration& duration)
+	{
+		std::int64_t count;
+		if (!reader.read(count))
+			{ return false; }
+		duration = std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(count));
+		return true;
+	}
+
+	inline void write_log_data(binary_writer& writer, const log_data_t& data)
+	{
+		writer.write<std::uint64_t>(data.size());
+		for (const auto& [uuid, player_data] : data)
+		{
+			writer.write(uuid);
+			writer.write<std::uint64_t>(player_data.first.size());
+			for (const std::string& name : player_data.first)
+				{ writer.write_string(name); }
+			writer.write<std::uint64_t>(player_data.second.first.size());
+			for (const auto& [start, duration] : player_data.second.first)
+			{
+				write_time_point(writer, start);
+				write_duration(writer, duration);
+			}
+			write_duration(writer, player_data.second.second);
+		}
+	}
+
+	// read what write_log_data wrote
+	// @return true on success
+	[[nodiscard]] inline bool read_log_data(binary_reader& reader, log_data_t& data)
+	{
+		std::uint64_t num_players;
+		if (!reader.read(num_players) || num_players > reader.remaining())
+			{ return false; }
+		for (std::uint64_t i = 0; i < num_players; i++)
+		{
+			uuid_t uuid;
+			std::uint64_t num_names, num_sessions;
+			if (!reader.read(uuid) || !reader.read(num_names) || num_names > reader.remaining())
+				{ return false; }
+			auto& [names, playtime] = data[uuid];
+			names.resize(num_names);
+			for (auto& name : names)
+			{
+				if (!reader.read_string(name))
+					{ return false; }
+			}
+			if (!reader.read(num_sessions) || num_sessions > reader.remaining())
+				{ return false; }
+			playtime.first.resize(num_sessions);
+			for (auto& [start, duration] : playtime.first)
+			{
+				if (!read_time_point(reader, start) || !read_duration(reader, duration))
+					{ return false; }
+			}
+			if (!read_duration(reader, playtime.second))
+				{ return false; }
+		}
+		return true;
+	}
+}
+
+// load what save_latest_log_resume saved
+// @param logs_dir  directory of latest.log and the archives
+// @return resume point, or empty optional if it doesn't exist or is invalid (a warning will be printed if it is invalid)
+[[nodiscard]] inline std::optional<latest_log_resume_t> load_latest_log_resume(const std::filesystem::path& path, const std::filesystem::path& logs_dir)
+{
+	std::error_code ec;
+	if (!std::filesystem::exists(path, ec))
+		{ return {}; }
+	// small (only sessions since latest.log was created), so it is read instead of mapped
+	std::ifstream fin(path, std::ios::binary);
+	const std::string data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+	detail::snapshot_header header;
+	if (!fin.is_open() || data.size() < sizeof(header))
+	{
+		log_message(log_severity::warning, std::format("Could not read latest.log resume point {}, ignoring it", path.string()));
+		return {};
+	}
+	std::memcpy(&header, data.data(), sizeof(header));
+	const std::string_view payload = std::string_view(data).substr(sizeof(header));
+	if (std::string_view(header.magic, sizeof(header.magic)) != detail::resume_magic || header.byte_order != detail::snapshot_byte_order ||
+		header.version != detail::resume_version || header.payload_size != payload.size() || header.checksummed_size != payload.size() ||
+		header.payload_checksum != detail::snapshot_checksum(payload))
+	{
+		log_message(log_severity::warning, std::format("latest.log resume point {} is corrupted or from another version, ignoring it", path.string()));
+		return {};
+	}
+
+	detail::binary_reader reader(payload);
+	latest_log_resume_t resume;
+	if (!detail::read_snapshot_metadata(reader, logs_dir, resume.manifest, resume.format, resume.ctx) || !reader.read(resume.file_id.first) ||
+		!reader.read(resume.file_id.second) || !reader.read(resume.offset) || !reader.read(resume.prefix_hash) || !reader.read(resume.tail_hash) ||
+		!detail::read_log_data(reader, resume.data) || !resume.lag.read(reader) || !resume.uptime.read(reader) || reader.remaining() != 0)
+	{
+		log_message(log_severity::warning, std::format("latest.log resume point {} is malformed, ignoring it", path.string()));
+		return {};
+	}
+	return resume;
+}
+
+namespace detail
+{
+	// @return contents of a latest.log resume point file
+	[[nodiscard]] inline std::string serialize_latest_log_resume(const latest_log_resume_t& resume)
+	{
+		std::string data(sizeof(snapshot_header), '\0');
+		binary_writer writer(data);
+		write_snapshot_metadata(writer, resume.manifest, resume.format, resume.ctx);
+		writer.write(resume.file_id.first);
+		writer.write(resume.file_id.second);
+		writer.write(resume.offset);
+		writer.write(resume.prefix_hash);
+		writer.write(resume.tail_hash);
+		write_log_data(writer, resume.data);
+		resume.lag.write(writer);
+		resume.uptime.write(writer);
+
+		const std::string_view payload = std::string_view(data).substr(sizeof(snapshot_header));
+		snapshot_header header{};
+		std::memcpy(header.magic, resume_magic.data(), sizeof(header.magic));
+		header.version = resume_version;
+		header.byte_order = snapshot_byte_order;
+		header.payload_size = payload.size();
+		header.checksummed_size = payload.size();
+		header.payload_checksum = snapshot_checksum(payload);
+		std::memcpy(data.data(), &header, sizeof(header));
+		return data;
+	}
+}
+
+// save where reading latest.log got to, replacing it atomically and durably (see detail::replace_file)
+// @return true on success (an error will be printed on failure)
+inline bool save_latest_log_resume(const std::filesystem::path& path, const latest_log_resume_t& resume)
+	{ return detail::replace_file(path, detail::serialize_latest_log_resume(resume)); }
+// like save_latest_log_resume, but only its contents are made on the calling thread, and `writer` writes them
+// @param callback  called with whether it was saved (see durable_file_writer::callback_t)
+inline void queue_latest_log_resume(durable_file_writer& writer, const std::filesystem::path& path, const latest_log_resume_t& resume,
+	durable_file_writer::callback_t callback)
+	{ writer.write(path, detail::serialize_latest_log_resume(resume), std::move(callback)); }
+
+#endif
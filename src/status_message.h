@@ -0,0 +1,170 @@
+#ifndef STATUS_MESSAGE_H
+#define STATUS_MESSAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <dpp/dpp.h>
+
+#include "coalescing_timer.h"
+#include "logger.h"
+
+// keeps a pinned message in a channel with the players online, edited from a dpp timer a while after they change instead of for every change,
+// so a burst of joins (e.g. everyone reconnecting after a server restart) is a single edit. it's only edited when its content changes,
+// and only one request is in flight at a time, so edits never pile up in dpp's rate limit bucket of the channel
+// the bot's own pinned message in the channel is reused after a restart, so restarting doesn't post a new one
+class status_message
+{
+public:
+	// @return content of the message, nullopt if it can't be made yet (e.g. no data has been published)
+	using content_t = std::function<std::optional<std::string>()>;
+
+private:
+	static constexpr std::size_t max_message_size = 2000;  // discord's limit for message content
+
+	dpp::cluster& bot;
+	dpp::snowflake channel_id;
+	content_t make_content;
+	// guarded by the timer's mutex
+	bool changed = true;  // content may differ from sent
+	bool sending = false;  // a request hasn't been answered yet
+	bool found = false;  // the pins of the channel were looked through for an earlier message
+	dpp::snowflake message_id;  // 0 until the message is found or posted
+	std::string sent;  // content of the message
+	coalescing_timer timer;  // running while something is changed or being sent, last so it's destroyed first
+
+	// look through the channel's pins for a message the bot posted before, then send the content
+	void find_message()
+	{
+		bot.channel_pins_get(channel_id, timer.guard([this](const dpp::confirmation_callback_t& res)
+		{
+			sending = false;
+			if (res.is_error())
+			{
+				log_message(log_severity::error, std::format("Could not get the pins of the status message's channel: {}", res.get_error().human_readable));
+				return;  // try again next tick
+			}
+			found = true;
+			for (const auto& [id, message] : std::get<dpp::message_map>(res.value))
+			{
+				if (message.author.id == bot.me.id)
+				{
+					message_id = id;
+					sent = message.content;
+					break;
+				}
+			}
+		}));
+	}
+
+	void send(std::string content)
+	{
+		const auto on_error = [](std::string_view what, const dpp::confirmation_callback_t& res)
+			{ log_message(log_severity::error, std::format("Could not {} the status message: {}", what, res.get_error().human_readable)); };
+		// names are from the logs, so they mustn't ping anyone
+		dpp::message message(channel_id, content);
+		message.set_allowed_mentions();
+		if (message_id != 0)
+		{
+			message.id = message_id;
+			bot.message_edit(message, timer.guard([this, content, on_error](const dpp::confirmation_callback_t& res)
+			{
+				sending = false;
+				if (!res.is_error())
+					{ sent = content; }
+				else
+				{
+					// tried again next tick. an unknown message was deleted, so a new one is posted
+					changed = true;
+					if (res.get_error().code == 10008)
+						{ message_id = 0; }
+					else
+						{ on_error("edit", res); }
+				}
+			}));
+			return;
+		}
+		bot.message_create(message, timer.guard([this, content, on_error](const dpp::confirmation_callback_t& res)
+		{
+			if (res.is_error())
+			{
+				on_error("post", res);
+				sending = false;
+				changed = true;  // try again next tick
+				return;
+			}
+			const dpp::snowflake id = std::get<dpp::message>(res.value).id;
+			bot.message_pin(channel_id, id, timer.guard([this, id, content, on_error](const dpp::confirmation_callback_t& res)
+			{
+				// an unpinned message still works until a restart, after which another is posted
+				if (res.is_error())
+					{ on_error("pin", res); }
+				sending = false;
+				message_id = id;
+				sent = content;
+			}));
+		}));
+	}
+
+	bool tick(std::unique_lock<std::mutex>& lock)
+	{
+		if (sending)
+			{ return true; }  // try again next tick
+		if (bot.me.id == 0)
+			{ return true; }  // not connected yet, its own messages can't be told apart
+		if (!found)
+		{
+			sending = true;
+			find_message();
+			return true;
+		}
+		if (!changed)
+			{ return false; }  // nothing left to send, the timer is started again by the next change
+		// made without the lock, since it reads the published data of every server
+		changed = false;
+		lock.unlock();
+		std::optional<std::string> content = make_content();
+		lock.lock();
+		if (!content)
+		{
+			changed = true;
+			return true;
+		}
+		if (content->size() > max_message_size)
+		{
+			content->resize(max_message_size - 3);
+			content.value() += "...";
+		}
+		if (message_id != 0 && content == sent)
+			{ return true; }
+		sending = true;
+		send(std::move(content.value()));
+		return true;
+	}
+
+public:
+	// @param window  seconds to wait for more changes before editing (at least 1)
+	// @param make_content  called from the timer's thread
+	status_message(dpp::cluster& bot, dpp::snowflake channel_id, std::uint64_t window, content_t make_content) :
+		bot(bot), channel_id(channel_id), make_content(std::move(make_content)),
+		timer(bot, window, [this](std::unique_lock<std::mutex>& lock) { return tick(lock); })
+		{ timer.start(timer.lock()); }
+	status_message(const status_message&) = delete;
+	status_message& operator=(const status_message&) = delete;
+
+	// the players online may have changed, so the message is made again next tick
+	void update()
+	{
+		const auto lock = timer.lock();
+		changed = true;
+		timer.start(lock);
+	}
+};
+
+#endif
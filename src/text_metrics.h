@@ -0,0 +1,232 @@
+#ifndef TEXT_METRICS_H
+#define TEXT_METRICS_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <plutovg.h>
+
+namespace detail
+{
+	// measures text the same way lunasvg lays it out (sum of glyph advances, in float), without parsing an svg
+	// by default this uses the font lunasvg falls back to when a font family isn't registered (no fonts are registered,
+	// so this is the font for all text in the graph, including font-family="monospace")
+	// plutovg font faces aren't thread safe (glyphs are loaded lazily), so like lunasvg's font cache there is one per thread,
+	// all made from the same font file, which is only read once (see load_font)
+	class text_metrics
+	{
+	private:
+		// contents of the font file, read once for the whole process
+		struct font_file
+		{
+			std::once_flag once;
+			std::string data;  // empty if it couldn't be read
+		};
+
+		// advance widths of ascii characters for one font size
+		struct size_cache
+		{
+			float size;
+			std::array<float, 128> advances;
+		};
+
+		plutovg_font_face_t* face = nullptr;
+		std::vector<size_cache> caches;  // only a couple of sizes are used
+
+		[[nodiscard]] static font_file& get_font_file()
+		{
+			static font_file instance;
+			return instance;
+		}
+
+		// @return contents of the file, or empty if it can't be read
+		[[nodiscard]] static std::string read_font_file(const std::string& path)
+		{
+			std::ifstream fin(path, std::ios::binary);
+			if (!fin)
+				{ return {}; }
+			return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+		}
+
+		// @param path  font file, or empty for the font lunasvg falls back to. only used by the first call
+		// @return contents of the font file, empty if it couldn't be read
+		[[nodiscard]] static const std::string& get_font_data(const std::string& path)
+		{
+			font_file& font = get_font_file();
+			std::call_once(font.once, [&]()
+			{
+				if (!path.empty())
+				{
+					font.data = read_font_file(path);
+					return;
+				}
+				// same as lunasvg's regular fallback fonts. when more than one exists, lunasvg uses the last one
+				static constexpr const char* filenames[] = {
+#if defined(_WIN32)
+					"C:/Windows/Fonts/arial.ttf",
+#elif defined(__APPLE__)
+					"/Library/Fonts/Arial.ttf",
+					"/System/Library/Fonts/Supplemental/Arial.ttf",
+#elif defined(__linux__)
+					"/usr/share/fonts/dejavu/DejaVuSans.ttf",
+					"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+#endif
+					nullptr
+				};
+				for (std::size_t i = std::size(filenames) - 1; i-- > 0 && font.data.empty();)
+					{ font.data = read_font_file(filenames[i]); }
+			});
+			return font.data;
+		}
+
+		text_metrics()
+		{
+			// the default font if load_font wasn't called
+			const std::string& data = get_font_data({});
+			// the data outlives every face, so it isn't copied or freed by plutovg
+			if (!data.empty())
+				{ face = plutovg_font_face_load_from_data(data.data(), static_cast<unsigned int>(data.size()), 0, nullptr, nullptr); }
+		}
+
+		[[nodiscard]] float advance(const size_cache& cache, plutovg_codepoint_t codepoint) const
+		{
+			if (codepoint < cache.advances.size())
+				{ return cache.advances[codepoint]; }
+			float advance_width;
+			plutovg_font_face_get_glyph_metrics(face, cache.size, codepoint, &advance_width, nullptr, nullptr);
+			return advance_width;
+		}
+
+		[[nodiscard]] const size_cache& get_cache(float size)
+		{
+			const auto it = std::ranges::find(caches, size, &size_cache::size);
+			if (it != caches.end())
+				{ return *it; }
+			size_cache& cache = caches.emplace_back(size);
+			for (std::size_t i = 0; i < cache.advances.size(); i++)
+				{ plutovg_font_face_get_glyph_metrics(face, size, static_cast<plutovg_codepoint_t>(i), &cache.advances[i], nullptr, nullptr); }
+			return cache;
+		}
+
+	public:
+		text_metrics(const text_metrics&) = delete;
+		text_metrics& operator=(const text_metrics&) = delete;
+		~text_metrics() { plutovg_font_face_destroy(face); }
+
+		[[nodiscard]] static text_metrics& get()
+		{
+			thread_local text_metrics instance;
+			return instance;
+		}
+
+
+		// read the font every thread's face is made from, so no thread looks for or reads a font file while rendering
+		// only the first call (or the first text_metrics made) reads a file, later ones don't change the font
+		// @param path  font file, or empty for the font lunasvg falls back to
+		// @return whether there is a font
+		static bool load_font(const std::string& path)
+			{ return !get_font_data(path).empty(); }
+
+		// load the glyphs of ascii characters at each of `sizes` into this thread's face, so the first render on it is as fast as later ones
+		void warm(std::span<const float> sizes)
+		{
+			if (face == nullptr)
+				{ return; }
+			for (const float size : sizes)
+				{ std::ignore = get_cache(size); }
+			std::ignore = ascent(1);
+			std::ignore = x_height(1);
+		}
+
+		// @return font face used for all text, or null if the font couldn't be loaded
+		[[nodiscard]] plutovg_font_face_t* get_face() const noexcept
+			{ return face; }
+
+		// @return distance from the baseline to the top of the font
+		[[nodiscard]] float ascent(float size) const
+		{
+			float res = 0;
+			if (face != nullptr && size > 0)
+				{ plutovg_font_face_get_metrics(face, size, &res, nullptr, nullptr, nullptr); }
+			return res;
+		}
+
+		// @return height of 'x' (for dominant-baseline="middle")
+		[[nodiscard]] float x_height(float size) const
+		{
+			plutovg_rect_t extents{};
+			if (face != nullptr && size > 0)
+				{ plutovg_font_face_get_glyph_metrics(face, size, 'x', nullptr, nullptr, &extents); }
+			return extents.h;
+		}
+
+		// @param text  utf-8 text content of a <text> element (whitespace is collapsed like lunasvg does)
+		// @return width lunasvg gives the text, or 0 if there is no font (also like lunasvg)
+		[[nodiscard]] float text_width(std::string_view text, float size)
+		{
+			if (face == nullptr || size <= 0)
+				{ return 0; }
+			const size_cache& cache = get_cache(size);
+			float width = 0;
+			plutovg_codepoint_t last = ' ';
+			plutovg_text_iterator_t it;
+			plutovg_text_iterator_init(&it, text.data(), static_cast<int>(text.size()), PLUTOVG_TEXT_ENCODING_UTF8);
+			while (plutovg_text_iterator_has_next(&it))
+			{
+				plutovg_codepoint_t codepoint = plutovg_text_iterator_next(&it);
+				if (codepoint == '\t' || codepoint == '\n' || codepoint == '\r')
+					{ codepoint = ' '; }
+				if (codepoint == ' ' && last == ' ')
+					{ continue; }
+				width += advance(cache, codepoint);
+				last = codepoint;
+			}
+			return width;
+		}
+	};
+
+	// text-anchor
+	enum class text_anchor { start, middle, end };
+
+	// horizontal extent of several <text> elements, calculated like lunasvg's bounding box (in float)
+	class text_bounds
+	{
+	private:
+		float left = std::numeric_limits<float>::infinity();
+		float right = -std::numeric_limits<float>::infinity();
+
+	public:
+		// @param x  x attribute of the text
+		// @param width  from text_metrics::text_width
+		void add(double x, float width, text_anchor anchor)
+		{
+			float cur_left = static_cast<float>(x);
+			if (anchor == text_anchor::middle)
+				{ cur_left -= width / 2.f; }
+			else if (anchor == text_anchor::end)
+				{ cur_left -= width; }
+			left = std::min(left, cur_left);
+			right = std::max(right, cur_left + width);
+		}
+
+		// @return whether nothing was added
+		[[nodiscard]] bool empty() const noexcept
+			{ return left > right; }
+		[[nodiscard]] double get_right() const noexcept
+			{ return empty() ? 0 : right; }
+		[[nodiscard]] double get_width() const noexcept
+			{ return empty() ? 0 : right - left; }
+	};
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef TIMELAPSE_GRAPH_H
+#define TIMELAPSE_GRAPH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <plutovg.h>
+
+#include "graph_writer.h"
+#include "online_graph.h"
+#include "png_encoder.h"
+#include "presence_index.h"
+#include "session_store.h"
+#include "text_metrics.h"
+
+// animated version of the players online graph: the axes are drawn once, then each frame adds the bars of the next step of time,
+// with a cursor and a label of when it is, how many were online then and how many played that day
+// frames after the first are only the rectangle that changed (see detail::apng_encoder), so rendering and encoding them costs about
+// as much as the bars they add instead of a whole graph each
+
+inline constexpr float timelapse_pixel_scale = 1;  // like the 1x variant of a graph, there are a lot of frames
+inline constexpr std::uint16_t timelapse_frame_ms = 100;
+inline constexpr std::uint16_t timelapse_last_frame_ms = 3000;  // before it loops
+inline constexpr std::size_t timelapse_max_frames = 336;
+
+struct timelapse_options
+{
+	std::string_view theme_color = "black";  // of text and axes
+	int png_compression_level = 6;  // see graph_options
+	// state shared between renders (the online players of history and the time zone). if null, a temporary one with the default time zone is used
+	graph_render_ctx* render_ctx = nullptr;
+	time_range range;  // shown one step at a time, must be bounded
+	std::chrono::seconds step = std::chrono::hours(1);  // of each frame
+	std::size_t max_bytes = 0;  // largest file to return, 0 for no limit
+};
+
+namespace detail
+{
+	// rectangle of pixels [left, right) x [top, bottom)
+	struct pixel_rect
+	{
+		int left = 0, top = 0, right = 0, bottom = 0;
+
+		[[nodiscard]] bool empty() const noexcept
+			{ return left >= right || top >= bottom; }
+
+		void unite(const pixel_rect& other) noexcept
+		{
+			if (other.empty())
+				{ return; }
+			if (empty())
+			{
+				*this = other;
+				return;
+			}
+			left = std::min(left, other.left);
+			top = std::min(top, other.top);
+			right = std::max(right, other.right);
+			bottom = std::max(bottom, other.bottom);
+		}
+
+		[[nodiscard]] pixel_rect clipped(int width, int height) const noexcept
+			{ return { std::max(left, 0), std::max(top, 0), std::min(right, width), std::min(bottom, height) }; }
+	};
+
+	// copy `rect` of `src` to the same place in `dest`, which is the same size
+	inline void copy_pixel_rect(plutovg_surface_t* dest, const plutovg_surface_t* src, const pixel_rect& rect)
+	{
+		const int stride = plutovg_surface_get_stride(dest);
+		for (int y = rect.top; y < rect.bottom; y++)
+		{
+			const std::size_t offset = static_cast<std::size_t>(stride) * y + static_cast<std::size_t>(rect.left) * 4;
+			std::memcpy(plutovg_surface_get_data(dest) + offset, plutovg_surface_get_data(src) + offset, static_cast<std::size_t>(rect.right - rect.left) * 4);
+		}
+	}
+}
+
+// @param presence  of history, in the time zone of the graph, for the players of each day
+// @param presence_recent  of the recent data (see presence_index::get_recent)
+// @throws std::runtime_error if a surface can't be created or png encoding fails
+// @return animated png, or an empty string if it would be larger than options.max_bytes
+inline std::string create_timelapse(const session_history& history, const log_data_t& recent, const parse_ctx_t& parse_ctx, const presence_index& presence,
+	const presence_index::recent_t& presence_recent, const timelapse_options& options)
+{
+	using namespace detail;
+	std::optional<graph_render_ctx> temp_render_ctx;
+	graph_render_ctx& render_ctx = options.render_ctx ? *options.render_ctx : temp_render_ctx.emplace();
+	const std::chrono::time_zone* timezone = render_ctx.get_timezone();
+	const auto history_players = render_ctx.get_online_players(history.get_segments());
+	const auto recent_events = get_recent_online_events(recent, parse_ctx, std::chrono::system_clock::now());
+	const online_layout layout = get_online_layout(*history_players, recent_events, options.range, timezone);
+
+	// the axes, labels and dates, which every frame shares
+	surface_ptr base;
+	{
+		online_layout axes = layout;
+		axes.max_counts.clear();
+		png_graph_writer writer(options.png_compression_level, timelapse_pixel_scale, options.theme_color);
+		draw_online_graph(writer, axes, adaptive_color, timezone);
+		base = writer.copy_surface();
+	}
+	const int width = plutovg_surface_get_width(base.get()), height = plutovg_surface_get_height(base.get());
+	// bars (on the axes) of the frames so far, and the frame itself, which also has the cursor and label
+	const surface_ptr bars(plutovg_surface_create(width, height)), frame(plutovg_surface_create(width, height));
+	if (!bars || !frame)
+		{ throw std::runtime_error("Graph surface creation failed."); }
+	copy_pixel_rect(bars.get(), base.get(), { 0, 0, width, height });
+
+	// pixel position of the data area, and the columns of the layout each column of pixels covers
+	const float origin_x = static_cast<float>(layout.text_width + svg_pad + svg_side_pad) * timelapse_pixel_scale;
+	const float origin_y = static_cast<float>(layout.header_height + svg_side_pad) * timelapse_pixel_scale;
+	const int data_left = static_cast<int>(std::lround(origin_x)), data_top = static_cast<int>(std::lround(origin_y));
+	const int axis_top = static_cast<int>(std::lround(origin_y + static_cast<float>(svg_online_height - 1) * timelapse_pixel_scale));  // the x-axis is drawn over
+	const auto num_columns = static_cast<std::size_t>(std::floor(layout.data_area_width * timelapse_pixel_scale));
+	const auto column_max = [&](std::size_t column)
+	{
+		const std::size_t first = column * layout.max_counts.size() / num_columns, last = std::max(first + 1, (column + 1) * layout.max_counts.size() / num_columns);
+		return *std::max_element(layout.max_counts.begin() + static_cast<std::ptrdiff_t>(first),
+			layout.max_counts.begin() + static_cast<std::ptrdiff_t>(std::min(last, layout.max_counts.size())));
+	};
+	const auto parse = [](std::string_view color)
+	{
+		plutovg_color_t c;
+		if (plutovg_color_parse(&c, color.data(), static_cast<int>(color.size())) == 0)
+			{ plutovg_color_init_rgb(&c, 0, 0, 0); }
+		return premultiply_color(c);
+	};
+	const std::uint32_t bar_color = parse(svg_online_color), text_color = parse(options.theme_color);
+
+	// draw the bar of `column`, antialiased at the top like the polygon of the graph
+	// @return its pixels
+	const auto draw_bar = [&](std::size_t column)
+	{
+		const int x = data_left + static_cast<int>(column);
+		const double top = origin_y + svg_online_height * timelapse_pixel_scale * (1 - static_cast<double>(column_max(column)) / layout.y_max);
+		const int full_top = static_cast<int>(std::ceil(top));
+		const int stride = plutovg_surface_get_stride(bars.get());
+		unsigned char* data = plutovg_surface_get_data(bars.get());
+		for (int y = full_top; y < axis_top; y++)
+			{ reinterpret_cast<std::uint32_t*>(data + static_cast<std::size_t>(stride) * y)[x] = bar_color; }
+		if (const double coverage = full_top - top; coverage > 0 && full_top - 1 >= data_top && full_top - 1 < axis_top)
+		{
+			std::uint32_t& pixel = reinterpret_cast<std::uint32_t*>(data + static_cast<std::size_t>(stride) * (full_top - 1))[x];
+			const std::uint32_t src = byte_mul(bar_color, static_cast<std::uint32_t>(std::lround(coverage * 255)));
+			pixel = src + byte_mul(pixel, 255 - (src >> 24));
+		}
+		return pixel_rect{ x, std::max(full_top - 1, data_top), x + 1, axis_top };
+	};
+
+	// players online on a day, counted once for each day shown
+	std::map<std::chrono::local_days, std::size_t> day_players;
+	const auto players_on = [&](std::chrono::local_days day)
+	{
+		const auto it = day_players.find(day);
+		if (it != day_players.end())
+			{ return it->second; }
+		return day_players.emplace(day, presence.any_day(day, day, presence_recent).size()).first->second;
+	};
+
+	// cursor at a column and the label of a frame over it, which is drawn on the frame after the bars under it are copied
+	struct overlay_t
+	{
+		pixel_rect rect;  // of all of it
+		std::optional<int> cursor_x;
+		const label_sprite_cache::sprite* label = nullptr;  // only valid until the next sprite is found
+		int label_left = 0, label_top = 0;
+	};
+	// @return overlay of the frame up to `time`, the cursor at `column`
+	const auto place_overlay = [&](std::size_t column, std::chrono::sys_seconds time, std::int32_t online)
+	{
+		overlay_t res;
+		if (column < num_columns)
+		{
+			res.cursor_x = data_left + static_cast<int>(column);
+			res.rect = { res.cursor_x.value(), data_top, res.cursor_x.value() + 1, axis_top };
+		}
+		text_metrics& metrics = text_metrics::get();
+		if (metrics.get_face() == nullptr)
+			{ return res; }
+		const auto local_time = std::chrono::floor<std::chrono::minutes>(timezone->to_local(time));
+		const std::string label = std::format("{:%a %m/%d %H:%M}: {} online, {} played that day", local_time, online,
+			players_on(std::chrono::floor<std::chrono::days>(local_time)));
+		// centered above the cursor but kept inside the graph, like the peak label
+		const float font_size = static_cast<float>(svg_date_fontsize);
+		const double half_width = metrics.text_width(label, font_size) / 2;
+		const double cursor_x = static_cast<double>(column) / timelapse_pixel_scale;
+		const double label_x = std::clamp(cursor_x, half_width - (layout.text_width + svg_pad), layout.axis_width - half_width) - half_width;
+		const float pixel_x = static_cast<float>(label_x) * timelapse_pixel_scale + origin_x;
+		const float pixel_y = (static_cast<float>(-layout.header_height) + metrics.ascent(font_size) * 8.f / 10.f) * timelapse_pixel_scale + origin_y;
+		const float floor_x = std::floor(pixel_x), floor_y = std::floor(pixel_y);
+		res.label = &label_sprite_cache::get().find(label, font_size * timelapse_pixel_scale, pixel_x - floor_x, pixel_y - floor_y);
+		res.label_left = static_cast<int>(floor_x) + res.label->left;
+		res.label_top = static_cast<int>(floor_y) + res.label->top;
+		res.rect.unite({ res.label_left, res.label_top, res.label_left + res.label->width, res.label_top + res.label->height });
+		res.rect = res.rect.clipped(width, height);
+		return res;
+	};
+	const auto draw_overlay = [&](const overlay_t& overlay)
+	{
+		if (overlay.cursor_x)
+		{
+			const int stride = plutovg_surface_get_stride(frame.get());
+			unsigned char* data = plutovg_surface_get_data(frame.get());
+			for (int y = data_top; y < axis_top; y++)
+				{ reinterpret_cast<std::uint32_t*>(data + static_cast<std::size_t>(stride) * y)[overlay.cursor_x.value()] = text_color; }
+		}
+		if (overlay.label != nullptr)
+			{ blend_mask(frame.get(), text_color, overlay.label->mask, overlay.label->width, overlay.label->height, overlay.label_left, overlay.label_top); }
+	};
+
+	const auto first = layout.first_time, last = layout.last_time;
+	const std::size_t num_frames = (last <= first) ? 1 : std::min<std::size_t>(timelapse_max_frames,
+		static_cast<std::size_t>((last - first + options.step - std::chrono::seconds(1)) / options.step));
+	const double column_seconds = (num_columns == 0) ? 1 : static_cast<double>((last - first).count()) / static_cast<double>(num_columns);
+	const std::size_t total_columns = layout.max_counts.empty() ? 0 : num_columns;
+	apng_encoder encoder(width, height, static_cast<std::uint32_t>(num_frames), options.png_compression_level);
+	std::size_t columns_done = 0;
+	pixel_rect last_overlay;  // which the next frame covers with the bars under it
+	for (std::size_t i = 0; i < num_frames; i++)
+	{
+		const auto frame_begin = first + options.step * static_cast<std::int64_t>(i);
+		const std::size_t columns = (i + 1 == num_frames) ? total_columns : std::min(total_columns,
+			static_cast<std::size_t>(std::ceil(static_cast<double>((frame_begin + options.step - first).count()) / column_seconds)));
+		pixel_rect changed = last_overlay;
+		std::int32_t online = 0;  // most at once during the frame's step
+		for (std::size_t column = columns_done; column < columns; column++)
+		{
+			changed.unite(draw_bar(column));
+			online = std::max(online, column_max(column));
+		}
+		columns_done = columns;
+		const overlay_t overlay = place_overlay(columns, std::min(frame_begin + options.step, last), online);  // the time at the cursor
+		changed.unite(overlay.rect);
+		if (i == 0)
+			{ changed = { 0, 0, width, height }; }
+		if (changed.empty())
+			{ changed = { 0, 0, 1, 1 }; }  // a frame can't be empty
+		copy_pixel_rect(frame.get(), bars.get(), changed);
+		draw_overlay(overlay);
+		last_overlay = overlay.rect;
+		encoder.add_frame(frame.get(), changed.left, changed.top, changed.right - changed.left, changed.bottom - changed.top,
+			(i + 1 == num_frames) ? timelapse_last_frame_ms : timelapse_frame_ms);
+		if (options.max_bytes != 0 && encoder.size() > options.max_bytes)
+			{ return std::string(); }
+	}
+	return encoder.finish();
+}
+
+#endif
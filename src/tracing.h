@@ -0,0 +1,188 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+// scoped spans of where time goes, written as a chrome trace (open it in chrome://tracing or ui.perfetto.dev)
+// spans are only recorded when built with QC_TRACING (the QC_TRACING cmake option), otherwise QC_TRACE_SCOPE compiles to nothing
+
+#ifdef QC_TRACING
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace detail
+{
+	// the last `max_events` spans each thread finished, so a long-running bot keeps bounded memory
+	class trace_recorder
+	{
+	public:
+		struct event
+		{
+			const char* name;  // string literal
+			std::string arg;  // e.g. a file name, empty for none
+			std::uint32_t tid;
+			std::chrono::steady_clock::time_point start;
+			std::chrono::steady_clock::duration duration;
+		};
+
+	private:
+		static constexpr std::size_t max_events = 1 << 16;  // per thread
+
+		struct thread_buffer
+		{
+			std::mutex mutex;  // only contended while the trace is written
+			std::vector<event> events;  // ring buffer once full
+			std::size_t next = 0;  // oldest event once full
+		};
+
+		const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		std::mutex mutex;
+		// kept after their threads exit, so their spans are still written
+		std::vector<std::shared_ptr<thread_buffer>> buffers;
+		std::uint32_t next_tid = 1;
+
+		struct thread_state
+		{
+			std::shared_ptr<thread_buffer> buffer;
+			std::uint32_t tid;
+		};
+
+		thread_state& get_thread_state()
+		{
+			thread_local thread_state state = [this]()
+			{
+				std::scoped_lock lock(mutex);
+				return thread_state{ buffers.emplace_back(std::make_shared<thread_buffer>()), next_tid++ };
+			}();
+			return state;
+		}
+
+		static void append_json_string(std::string& out, std::string_view str)
+		{
+			out += '"';
+			for (const char c : str)
+			{
+				if (c == '"' || c == '\\')
+					{ out += '\\'; }
+				if (static_cast<unsigned char>(c) < 0x20)
+					{ out += std::format("\\u{:04x}", static_cast<unsigned>(c)); }
+				else
+					{ out += c; }
+			}
+			out += '"';
+		}
+
+	public:
+		[[nodiscard]] static trace_recorder& get()
+		{
+			static trace_recorder instance;
+			return instance;
+		}
+
+		// @return id of the calling thread in the trace
+		[[nodiscard]] std::uint32_t thread_id()
+			{ return get_thread_state().tid; }
+
+		void add(event&& e)
+		{
+			thread_buffer& buffer = *get_thread_state().buffer;
+			std::scoped_lock lock(buffer.mutex);
+			if (buffer.events.size() < max_events)
+				{ buffer.events.push_back(std::move(e)); }
+			else
+			{
+				buffer.events[buffer.next] = std::move(e);
+				buffer.next = (buffer.next + 1) % max_events;
+			}
+		}
+
+		// @return recorded spans in the chrome trace event format
+		[[nodiscard]] std::string to_json()
+		{
+			std::vector<std::shared_ptr<thread_buffer>> cur_buffers;
+			{
+				std::scoped_lock lock(mutex);
+				cur_buffers = buffers;
+			}
+			std::string out = "{\"traceEvents\":[";
+			bool first = true;
+			for (const auto& buffer : cur_buffers)
+			{
+				std::scoped_lock lock(buffer->mutex);
+				for (const event& e : buffer->events)
+				{
+					out += first ? "\n" : ",\n";
+					first = false;
+					out += "{\"name\":";
+					append_json_string(out, e.name);
+					out += std::format(",\"cat\":\"qc\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}", e.tid,
+						std::chrono::duration<double, std::micro>(e.start - epoch).count(), std::chrono::duration<double, std::micro>(e.duration).count());
+					if (!e.arg.empty())
+					{
+						out += ",\"args\":{\"detail\":";
+						append_json_string(out, e.arg);
+						out += '}';
+					}
+					out += '}';
+				}
+			}
+			out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+			return out;
+		}
+	};
+}
+
+// records the time from its construction to its destruction
+// it can end on another thread than it started on (e.g. in a coroutine), it is shown on the thread it started on
+class trace_span
+{
+private:
+	detail::trace_recorder::event e;
+
+public:
+	// @param name  must be a string literal (or otherwise outlive the recorder)
+	// @param arg  shown with the span, e.g. which file it was for
+	explicit trace_span(const char* name, std::string arg = {})
+		: e{ name, std::move(arg), detail::trace_recorder::get().thread_id(), std::chrono::steady_clock::now(), {} } {}
+	trace_span(const trace_span&) = delete;
+	trace_span& operator=(const trace_span&) = delete;
+	~trace_span()
+	{
+		e.duration = std::chrono::steady_clock::now() - e.start;
+		detail::trace_recorder::get().add(std::move(e));
+	}
+};
+
+// @return recorded spans as chrome trace json
+[[nodiscard]] inline std::string get_chrome_trace()
+	{ return detail::trace_recorder::get().to_json(); }
+
+// @return whether the file could be written
+inline bool write_chrome_trace(const std::string& path)
+{
+	std::ofstream fout(path, std::ios::binary);
+	fout << get_chrome_trace();
+	return static_cast<bool>(fout);
+}
+
+#define QC_TRACE_CONCAT_IMPL(a, b) a##b
+#define QC_TRACE_CONCAT(a, b) QC_TRACE_CONCAT_IMPL(a, b)
+// span until the end of the scope: QC_TRACE_SCOPE("name") or QC_TRACE_SCOPE("name", arg string)
+#define QC_TRACE_SCOPE(...) const trace_span QC_TRACE_CONCAT(qc_trace_span_, __LINE__)(__VA_ARGS__)
+
+#else
+
+// the arguments aren't evaluated
+#define QC_TRACE_SCOPE(...) static_cast<void>(0)
+
+#endif
+
+#endif
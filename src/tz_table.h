@@ -0,0 +1,118 @@
+#ifndef TZ_TABLE_H
+#define TZ_TABLE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace detail
+{
+	// @return number of elements of `sorted` that are at most `x` (like std::upper_bound), with a binary search whose steps are conditional moves,
+	//         since which way it goes is unpredictable
+	[[nodiscard]] inline std::size_t count_not_greater(std::span<const std::int64_t> sorted, std::int64_t x) noexcept
+	{
+		if (sorted.empty())
+			{ return 0; }
+		const std::int64_t* base = sorted.data();
+		std::size_t n = sorted.size();
+		while (n > 1)
+		{
+			const std::size_t half = n / 2;
+			base = (base[half - 1] <= x) ? base + half : base;
+			n -= half;
+		}
+		return static_cast<std::size_t>(base - sorted.data()) + (*base <= x ? 1 : 0);
+	}
+}
+
+// utc offsets of a time zone over a range of time, as a sorted table of when they change, so converting many times in that range
+// (e.g. splitting every session at local midnight) is a search of a few integers instead of a tzdb lookup that builds a sys_info each time
+// to_local and to_sys work like those of std::chrono::time_zone, so code can convert with either one, and times outside the range
+// are converted by the time zone, so results are always the same as its
+class tz_offset_table
+{
+private:
+	// a day is longer than any change of offset, so a local time that far into the range can't also be in the interval before it
+	static constexpr std::int64_t max_offset_change = 24 * 60 * 60;
+
+	const std::chrono::time_zone* timezone;
+	// seconds since epoch the offset changes at, sorted. offsets[i] (in seconds) is from transitions[i - 1] until transitions[i]
+	std::vector<std::int64_t> transitions;
+	std::vector<std::int32_t> offsets;
+	// local time the interval of offsets[i] ends at (transitions[i] + offsets[i]), sorted as well since transitions are months apart
+	std::vector<std::int64_t> local_ends;
+	// utc and local times (seconds since epoch) the table converts, [begin, end)
+	std::int64_t cover_begin = 0, cover_end = 0, local_cover_begin = 0, local_cover_end = 0;
+
+public:
+	// @param first, last  times the table must cover (an empty range covers nothing, so everything is converted by `timezone`)
+	tz_offset_table(const std::chrono::time_zone* timezone, std::chrono::system_clock::time_point first, std::chrono::system_clock::time_point last) :
+		timezone(timezone)
+	{
+		const auto first_s = std::chrono::floor<std::chrono::seconds>(first), last_s = std::chrono::ceil<std::chrono::seconds>(last);
+		if (first_s > last_s)
+		{
+			offsets.push_back(0);
+			return;
+		}
+		auto info = timezone->get_info(first_s);
+		offsets.push_back(static_cast<std::int32_t>(info.offset.count()));
+		// intervals can differ only in abbreviation or daylight saving (e.g. double summer time), those aren't transitions here
+		while (info.end <= last_s)
+		{
+			const auto next = timezone->get_info(info.end);
+			if (next.offset.count() != offsets.back())
+			{
+				transitions.push_back(info.end.time_since_epoch().count());
+				local_ends.push_back(transitions.back() + offsets.back());
+				offsets.push_back(static_cast<std::int32_t>(next.offset.count()));
+			}
+			info = next;
+		}
+		cover_begin = first_s.time_since_epoch().count();
+		cover_end = last_s.time_since_epoch().count() + 1;
+		local_cover_begin = cover_begin + offsets.front() + max_offset_change;
+		local_cover_end = cover_end + offsets.back();
+	}
+
+	[[nodiscard]] const std::chrono::time_zone* get_timezone() const noexcept
+		{ return timezone; }
+
+	// @return `tp` in local time, as std::chrono::time_zone::to_local
+	template<typename Duration>
+	[[nodiscard]] std::chrono::local_time<std::common_type_t<Duration, std::chrono::seconds>> to_local(const std::chrono::sys_time<Duration>& tp) const
+	{
+		const std::int64_t t = std::chrono::floor<std::chrono::seconds>(tp).time_since_epoch().count();
+		if (t < cover_begin || t >= cover_end)
+			{ return timezone->to_local(tp); }
+		const std::chrono::seconds offset(offsets[detail::count_not_greater(transitions, t)]);
+		return std::chrono::local_time<std::common_type_t<Duration, std::chrono::seconds>>(tp.time_since_epoch() + offset);
+	}
+
+	// @return `tp` in utc, as std::chrono::time_zone::to_sys: with `z` choosing which if it is ambiguous, and the time the offset changes
+	//         if it doesn't exist
+	template<typename Duration>
+	[[nodiscard]] std::chrono::sys_time<std::common_type_t<Duration, std::chrono::seconds>> to_sys(const std::chrono::local_time<Duration>& tp,
+		std::chrono::choose z) const
+	{
+		using res_t = std::chrono::sys_time<std::common_type_t<Duration, std::chrono::seconds>>;
+		const std::int64_t l = std::chrono::floor<std::chrono::seconds>(tp).time_since_epoch().count();
+		if (l < local_cover_begin || l >= local_cover_end)
+			{ return timezone->to_sys(tp, z); }
+		// earliest interval that doesn't end by `tp`
+		std::size_t i = detail::count_not_greater(local_ends, l);
+		// it only contains `tp` if it doesn't start after it, otherwise `tp` is skipped over by the change before it
+		if (i != 0 && l < transitions[i - 1] + offsets[i])
+			{ return res_t(std::chrono::seconds(transitions[i - 1])); }
+		// ambiguous if the next one starts by `tp` too
+		if (z == std::chrono::choose::latest && i < transitions.size() && l >= transitions[i] + offsets[i + 1])
+			{ i++; }
+		return res_t(tp.time_since_epoch() - std::chrono::seconds(offsets[i]));
+	}
+};
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef UPTIME_SERIES_H
+#define UPTIME_SERIES_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "binary_io.h"
+#include "parse_logs.h"
+#include "session_store.h"
+
+// when the server was up, from its start and stop lines (see log_event_type::server_start and server_stop)
+// kept as the periods it was up in, in columns of 25 bytes a period (a server starts a few times a day at most), with how long it was up
+// before each, so how long it was up in any range is found with binary searches instead of reading every period (see get_uptime)
+class uptime_series
+{
+public:
+	// end of the period the server is still up in
+	static constexpr std::int64_t open_end = std::numeric_limits<std::int64_t>::max();
+
+private:
+	std::vector<std::int64_t> starts, ends;  // seconds since epoch, sorted. only the last period can be open
+	std::vector<std::int64_t> up_before{ 0 };  // seconds up in the closed periods before each one, and in all of them after the last
+	std::vector<std::uint8_t> crashes;  // whether each closed period ended without a stop line (see uptime_collector)
+	std::int64_t seen = std::numeric_limits<std::int64_t>::min();  // seconds since epoch of the last event that shows the server was up
+
+public:
+	// add a period after the others
+	// @param end  open_end if the server is still up
+	void add(std::int64_t start, std::int64_t end, bool crashed = false)
+	{
+		starts.push_back(start);
+		ends.push_back(end);
+		crashes.push_back(crashed);
+		up_before.push_back(up_before.back() + ((end == open_end) ? 0 : end - start));
+	}
+
+	// end the last period, which must be open
+	void close(std::int64_t end, bool crashed)
+	{
+		ends.back() = std::max(end, starts.back());
+		crashes.back() = crashed;
+		up_before.back() += ends.back() - starts.back();
+	}
+
+	// the server was up at `time`
+	void see(std::int64_t time) noexcept
+		{ seen = std::max(seen, time); }
+
+	// add the periods of `other` after these. if the server was still up in the last period and `other` starts with the end of it
+	// (see uptime_collector), that replaces it
+	void append(const uptime_series& other)
+	{
+		if (open() && !other.empty() && other.starts.front() == starts.back())
+		{
+			starts.pop_back();
+			ends.pop_back();
+			crashes.pop_back();
+			up_before.pop_back();
+		}
+		for (std::size_t i = 0; i < other.size(); i++)
+			{ add(other.starts[i], other.ends[i], other.crashes[i]); }
+		see(other.seen);
+	}
+
+	void clear() noexcept
+	{
+		starts.clear();
+		ends.clear();
+		up_before.assign(1, 0);
+		crashes.clear();
+		seen = std::numeric_limits<std::int64_t>::min();
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept
+		{ return starts.size(); }
+	[[nodiscard]] bool empty() const noexcept
+		{ return starts.empty(); }
+	// @return whether the server is still up in the last period
+	[[nodiscard]] bool open() const noexcept
+		{ return !ends.empty() && ends.back() == open_end; }
+	// @return seconds since epoch period `i` started at
+	[[nodiscard]] std::int64_t start(std::size_t i) const noexcept
+		{ return starts[i]; }
+	// @return seconds since epoch period `i` ended at, or open_end
+	[[nodiscard]] std::int64_t end(std::size_t i) const noexcept
+		{ return ends[i]; }
+	[[nodiscard]] bool crashed(std::size_t i) const noexcept
+		{ return crashes[i] != 0; }
+	// @return seconds up in the closed periods before period `i` (or in all of them, for size())
+	[[nodiscard]] std::int64_t up_until(std::size_t i) const noexcept
+		{ return up_before[i]; }
+	// @return seconds since epoch of the last event that shows the server was up, or the minimum if there was none
+	[[nodiscard]] std::int64_t last_seen() const noexcept
+		{ return seen; }
+
+	[[nodiscard]] std::size_t memory_used() const noexcept
+	{
+		return (starts.capacity() + ends.capacity() + up_before.capacity()) * sizeof(std::int64_t) + crashes.capacity() * sizeof(std::uint8_t);
+	}
+
+	void write(detail::binary_writer& writer) const
+	{
+		writer.write_span(std::span(starts));
+		writer.write_span(std::span(ends));
+		writer.write_span(std::span(crashes));
+		writer.write<std::int64_t>(seen);
+	}
+
+	// read what write wrote
+	// @return true on success
+	[[nodiscard]] bool read(detail::binary_reader& reader)
+	{
+		std::vector<std::int64_t> read_starts, read_ends;
+		std::vector<std::uint8_t> read_crashes;
+		std::int64_t read_seen;
+		if (!reader.read_vector(read_starts) || !reader.read_vector(read_ends) || !reader.read_vector(read_crashes) || !reader.read(read_seen) ||
+			read_ends.size() != read_starts.size() || read_crashes.size() != read_starts.size())
+			{ return false; }
+		clear();
+		for (std::size_t i = 0; i < read_starts.size(); i++)
+		{
+			// sorted and not overlapping, so the binary searches of get_uptime work
+			if (read_ends[i] < read_starts[i] || (i != 0 && read_starts[i] < read_ends[i - 1]) || (read_ends[i] == open_end && i + 1 != read_starts.size()))
+				{ return false; }
+			add(read_starts[i], read_ends[i], read_crashes[i] != 0);
+		}
+		seen = read_seen;
+		return true;
+	}
+};
+
+// adds when the server was up to a series, as a log event consumer (see parse_events)
+// the server is up from a start line until a stop line. one that starts again without having stopped crashed, and is taken to have gone down
+// at the last join or lag line before (nothing in between tells when). logs that begin while it is up start a period at their first event
+class uptime_collector
+{
+private:
+	uptime_series& series;
+	// of what was parsed before, which the series continues (e.g. history, for latest.log), or null
+	const std::shared_ptr<const uptime_series>* before;
+
+	[[nodiscard]] const uptime_series* before_series() const noexcept
+		{ return (before && *before) ? before->get() : nullptr; }
+
+	// @return start of the period the server is up in, which may be in the series before
+	[[nodiscard]] std::optional<std::int64_t> open_start() const noexcept
+	{
+		const uptime_series* cur = series.empty() ? before_series() : &series;
+		if (!cur || !cur->open())
+			{ return std::nullopt; }
+		return cur->start(cur->size() - 1);
+	}
+
+	void close(std::int64_t start, std::int64_t end, bool crashed)
+	{
+		if (series.empty())
+			{ series.add(start, end, crashed); }  // replaces the open period of the series before once appended to it
+		else
+			{ series.close(end, crashed); }
+	}
+
+public:
+	explicit uptime_collector(uptime_series& series, const std::shared_ptr<const uptime_series>* before = nullptr) noexcept : series(series), before(before) {}
+
+	void operator()(const log_event& event)
+	{
+		const std::int64_t time = std::chrono::floor<std::chrono::seconds>(event.time).time_since_epoch().count();
+		const auto start = open_start();
+		if (event.type == log_event_type::server_start)
+		{
+			if (start)
+			{
+				const uptime_series* prev = before_series();
+				const std::int64_t seen = std::max(series.last_seen(), prev ? prev->last_seen() : std::numeric_limits<std::int64_t>::min());
+				close(start.value(), std::clamp(seen, start.value(), time), true);
+			}
+			series.add(time, uptime_series::open_end);
+			return;
+		}
+		if (event.type == log_event_type::server_stop)
+		{
+			if (start)
+				{ close(start.value(), time, false); }
+			return;
+		}
+		if (!start)
+			{ series.add(time, uptime_series::open_end); }
+		// players still online are made to leave when a file starts, at its first line, which may be after a crash
+		if (event.type != log_event_type::leave)
+			{ series.see(time); }
+	}
+};
+
+// how a server was up in a range
+struct uptime_summary
+{
+	time_range known;  // part of the range after the server was first seen up, which the rest is of
+	std::chrono::seconds up{}, down{};
+	std::size_t starts = 0;  // times it started in the range
+	std::size_t crashes = 0;  // times it went down without stopping in the range
+	std::chrono::seconds longest{};  // longest it was up for without going down, of the part of it in the range
+
+	// @return fraction of the known range the server was up for, or 0 if nothing of it is known
+	[[nodiscard]] double availability() const noexcept
+	{
+		const auto total = up + down;
+		return (total == std::chrono::seconds::zero()) ? 0.0 : static_cast<double>(up.count()) / static_cast<double>(total.count());
+	}
+};
+
+namespace detail
+{
+	// @param series  of one server, in order: that of history, then that of latest.log
+	// @return periods of each of `series` that aren't replaced by the next one's (see uptime_series::append)
+	[[nodiscard]] inline std::vector<std::size_t> uptime_sizes(std::span<const std::shared_ptr<const uptime_series>> series)
+	{
+		std::vector<std::size_t> res;
+		res.reserve(series.size());
+		for (std::size_t i = 0; i < series.size(); i++)
+		{
+			const uptime_series& cur = *series[i];
+			const bool replaced = cur.open() && i + 1 < series.size() && !series[i + 1]->empty() && series[i + 1]->start(0) == cur.start(cur.size() - 1);
+			res.push_back(cur.size() - (replaced ? 1 : 0));
+		}
+		return res;
+	}
+}
+
+// @param series  of one server, in order: that of history, then that of latest.log
+// @param now  end of the period the server is still up in, if it is
+// @return how the server was up in `range`
+[[nodiscard]] inline uptime_summary get_uptime(std::span<const std::shared_ptr<const uptime_series>> series, time_range range, std::chrono::sys_seconds now)
+{
+	const auto to_seconds = [](std::chrono::system_clock::time_point tp) { return std::chrono::floor<std::chrono::seconds>(tp).time_since_epoch().count(); };
+	const std::int64_t now_secs = now.time_since_epoch().count();
+	const std::int64_t end = std::min(to_seconds(range.end), now_secs);
+	std::int64_t begin = to_seconds(range.begin);
+	uptime_summary res;
+	const std::vector<std::size_t> sizes = detail::uptime_sizes(series);
+	const auto first = std::ranges::find_if(sizes, [](std::size_t size) { return size != 0; });
+	if (first == sizes.end())
+		{ return res; }
+	begin = std::max(begin, series[static_cast<std::size_t>(first - sizes.begin())]->start(0));
+	if (begin >= end)
+		{ return res; }
+	res.known = { std::chrono::system_clock::time_point(std::chrono::seconds(begin)), std::chrono::system_clock::time_point(std::chrono::seconds(end)) };
+
+	std::int64_t up = 0;
+	for (std::size_t k = 0; k < series.size(); k++)
+	{
+		const uptime_series& cur = *series[k];
+		// periods that end after the range begins, until the first that starts after it ends
+		const auto period_end = [&](std::size_t i) { return std::min(cur.end(i), now_secs); };
+		const auto indices = std::views::iota(std::size_t(0), sizes[k]);
+		const std::size_t i = *std::ranges::partition_point(indices, [&](std::size_t p) { return period_end(p) <= begin; });
+		const std::size_t j = *std::ranges::partition_point(indices, [&](std::size_t p) { return cur.start(p) < end; });
+		if (i >= j)
+			{ continue; }
+		const auto clipped = [&](std::size_t p) { return std::max<std::int64_t>(std::min(period_end(p), end) - std::max(cur.start(p), begin), 0); };
+		// the periods between the first and the last are closed and entirely in the range
+		up += clipped(i) + ((j - 1 > i) ? clipped(j - 1) + cur.up_until(j - 1) - cur.up_until(i + 1) : 0);
+		// there are only a few periods in a range (a server starts a few times a day), so these are counted one by one
+		for (std::size_t p = i; p < j; p++)
+		{
+			if (cur.start(p) >= begin)
+				{ res.starts++; }
+			if (cur.crashed(p) && cur.end(p) < end)
+				{ res.crashes++; }
+			res.longest = std::max(res.longest, std::chrono::seconds(clipped(p)));
+		}
+	}
+	res.up = std::chrono::seconds(up);
+	res.down = std::chrono::seconds(end - begin - up);
+	return res;
+}
+
+// @param series  of one server, in order: that of history, then that of latest.log
+// @param now  end of the period the server is still up in, if it is
+// @return times in `range` (after the server was first seen up) it was down, in order
+[[nodiscard]] inline std::vector<time_range> get_downtime(std::span<const std::shared_ptr<const uptime_series>> series, time_range range,
+	std::chrono::sys_seconds now)
+{
+	const auto to_time = [](std::int64_t secs) { return std::chrono::system_clock::time_point(std::chrono::seconds(secs)); };
+	const std::int64_t begin = std::chrono::floor<std::chrono::seconds>(range.begin).time_since_epoch().count();
+	const std::vector<std::size_t> sizes = detail::uptime_sizes(series);
+	std::vector<time_range> res;
+	std::optional<std::int64_t> prev_end;  // of the period before
+	for (std::size_t k = 0; k < series.size(); k++)
+	{
+		const uptime_series& cur = *series[k];
+		// from the last period that ends before the range, so the time down until the first one in it is found too
+		const auto indices = std::views::iota(std::size_t(0), sizes[k]);
+		std::size_t i = *std::ranges::partition_point(indices, [&](std::size_t p) { return cur.end(p) <= begin; });
+		if (i != 0)
+			{ i--; }
+		for (; i < sizes[k] && to_time(cur.start(i)) < range.end; i++)
+		{
+			if (prev_end && prev_end.value() < cur.start(i))
+			{
+				const time_range down{ std::max(to_time(prev_end.value()), range.begin), std::min(to_time(cur.start(i)), range.end) };
+				if (down.begin < down.end)
+					{ res.push_back(down); }
+			}
+			prev_end = cur.end(i);
+		}
+	}
+	// down since the last period
+	if (prev_end && prev_end.value() != uptime_series::open_end)
+	{
+		const time_range down{ std::max(to_time(prev_end.value()), range.begin), std::min(std::chrono::system_clock::time_point(now), range.end) };
+		if (down.begin < down.end)
+			{ res.push_back(down); }
+	}
+	return res;
+}
+
+#endif
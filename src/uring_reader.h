@@ -0,0 +1,272 @@
+#ifndef URING_READER_H
+#define URING_READER_H
+
+// reads many whole files with io_uring, so a batch of files takes a couple of syscalls instead of several per file
+// only used if QC_USE_IO_URING is defined (see the QC_IO_URING cmake option), on linux
+// URING_READER_AVAILABLE is only defined if it is used
+
+#if defined(__linux__) && defined(QC_USE_IO_URING)
+#define URING_READER_AVAILABLE
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+namespace detail
+{
+	// minimal io_uring setup (without liburing) for reading files
+	class uring_file_reader
+	{
+	public:
+		struct request_t
+		{
+			const std::filesystem::path* path;
+			std::uint64_t size;  // expected size of the file (a file that has grown since is only read up to it)
+			std::string* out;  // receives the contents
+			// set to whether the file was read. files that weren't should be read normally
+			// (e.g. the kernel doesn't support an operation, or the file is too large)
+			bool ok = false;
+		};
+
+		static constexpr unsigned num_entries = 64;
+		static constexpr std::size_t max_batch = num_entries / 3;  // files read together (read, drop_cached and close for each)
+
+	private:
+		static constexpr std::uint64_t close_flag = std::uint64_t(1) << 63;  // in user_data of close requests
+		static constexpr std::uint64_t fadvise_flag = std::uint64_t(1) << 62;  // in user_data of requests to drop files from the page cache
+		static constexpr std::uint64_t max_read_size = 1 << 30;  // larger files are read normally
+
+		int ring_fd = -1;
+		void* sq_ptr = MAP_FAILED;
+		void* cq_ptr = MAP_FAILED;
+		std::size_t sq_ptr_size = 0, cq_ptr_size = 0;
+		io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		std::size_t sqes_size = 0;
+		unsigned* sq_tail;
+		unsigned sq_mask;
+		unsigned* sq_array;
+		unsigned* cq_head;
+		unsigned* cq_tail;
+		unsigned cq_mask;
+		io_uring_cqe* cqes;
+		unsigned pending = 0;  // sqes added since the last submit
+
+		template<typename T>
+		[[nodiscard]] static T* ring_offset(void* ptr, std::uint32_t offset) noexcept
+			{ return reinterpret_cast<T*>(static_cast<char*>(ptr) + offset); }
+
+		[[nodiscard]] io_uring_sqe& next_sqe() noexcept
+		{
+			const unsigned tail = *sq_tail + pending;
+			const unsigned ind = tail & sq_mask;
+			sq_array[ind] = ind;
+			pending++;
+			io_uring_sqe& sqe = sqes[ind];
+			sqe = {};
+			return sqe;
+		}
+
+		// submit added sqes and wait for `wait_count` completions, calling on_cqe(user_data, res) for each
+		// @return false on error
+		template<typename F>
+		[[nodiscard]] bool submit_and_wait(unsigned wait_count, F&& on_cqe)
+		{
+			std::atomic_ref<unsigned>(*sq_tail).store(*sq_tail + pending, std::memory_order_release);
+			unsigned to_submit = pending;
+			pending = 0;
+			while (wait_count > 0 || to_submit > 0)
+			{
+				// reap what is available first
+				unsigned head = *cq_head;
+				const unsigned tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+				for (; head != tail && wait_count > 0; head++, wait_count--)
+				{
+					const io_uring_cqe& cqe = cqes[head & cq_mask];
+					on_cqe(cqe.user_data, cqe.res);
+				}
+				std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+				if (wait_count == 0 && to_submit == 0)
+					{ break; }
+				const long res = syscall(__NR_io_uring_enter, ring_fd, to_submit, (wait_count > 0) ? 1u : 0u, IORING_ENTER_GETEVENTS, nullptr, 0);
+				if (res == -1)
+				{
+					if (errno == EINTR)
+						{ continue; }
+					return false;
+				}
+				to_submit -= static_cast<unsigned>(res);
+			}
+			return true;
+		}
+
+		// read a batch of at most max_batch files
+		void read_batch(std::span<request_t> requests)
+		{
+			// open all of them, then read and close all of them
+			std::vector<int> fds(requests.size(), -1);
+			unsigned num_opens = 0;
+			for (std::size_t i = 0; i < requests.size(); i++)
+			{
+				if (requests[i].size > max_read_size)
+					{ continue; }
+				io_uring_sqe& sqe = next_sqe();
+				sqe.opcode = IORING_OP_OPENAT;
+				sqe.fd = AT_FDCWD;
+				sqe.addr = reinterpret_cast<std::uintptr_t>(requests[i].path->c_str());
+				sqe.open_flags = O_RDONLY | O_CLOEXEC;
+				sqe.user_data = i;
+				num_opens++;
+			}
+			if (!submit_and_wait(num_opens, [&fds](std::uint64_t i, std::int32_t res) { fds[i] = res; }))
+			{
+				for (int fd : fds)
+				{
+					if (fd >= 0)
+						{ ::close(fd); }
+				}
+				return;
+			}
+
+			unsigned num_requests = 0;
+			for (std::size_t i = 0; i < requests.size(); i++)
+			{
+				if (fds[i] < 0)
+					{ continue; }
+				requests[i].out->resize(requests[i].size);
+				io_uring_sqe& read_sqe = next_sqe();
+				read_sqe.opcode = IORING_OP_READ;
+				read_sqe.flags = IOSQE_IO_LINK;  // close after reading
+				read_sqe.fd = fds[i];
+				read_sqe.addr = reinterpret_cast<std::uintptr_t>(requests[i].out->data());
+				read_sqe.len = static_cast<std::uint32_t>(requests[i].size);
+				read_sqe.off = 0;
+				read_sqe.user_data = i;
+				// like drop_cached, since the files are only read once
+				io_uring_sqe& fadvise_sqe = next_sqe();
+				fadvise_sqe.opcode = IORING_OP_FADVISE;
+				fadvise_sqe.flags = IOSQE_IO_LINK;
+				fadvise_sqe.fd = fds[i];
+				fadvise_sqe.fadvise_advice = POSIX_FADV_DONTNEED;
+				fadvise_sqe.user_data = i | fadvise_flag;
+				io_uring_sqe& close_sqe = next_sqe();
+				close_sqe.opcode = IORING_OP_CLOSE;
+				close_sqe.fd = fds[i];
+				close_sqe.user_data = i | close_flag;
+				num_requests += 3;
+			}
+			const bool submitted = submit_and_wait(num_requests, [&](std::uint64_t user_data, std::int32_t res)
+			{
+				const std::size_t i = user_data & ~(close_flag | fadvise_flag);
+				// dropping is only a hint, nothing is done with its result (if it failed, close is cancelled)
+				if (user_data & close_flag)
+				{
+					// the link is broken (close is cancelled) if the read failed or was short, or dropping failed
+					if (res == -ECANCELED)
+					{
+						drop_cached(fds[i]);
+						::close(fds[i]);
+					}
+				}
+				// the file may have changed since its size was found, the reader handles short or truncated files
+				else if (!(user_data & fadvise_flag) && res >= 0)
+				{
+					requests[i].out->resize(static_cast<std::size_t>(res));
+					requests[i].ok = true;
+				}
+			});
+			if (!submitted)
+			{
+				// completions that weren't reaped can't be known, so nothing from this batch is trusted
+				// (fds may be leaked, but the ring is broken at this point anyway)
+				for (auto& request : requests)
+					{ request.ok = false; }
+			}
+		}
+
+		void close() noexcept
+		{
+			if (sqes != MAP_FAILED)
+				{ munmap(sqes, sqes_size); }
+			if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+				{ munmap(cq_ptr, cq_ptr_size); }
+			if (sq_ptr != MAP_FAILED)
+				{ munmap(sq_ptr, sq_ptr_size); }
+			if (ring_fd != -1)
+				{ ::close(ring_fd); }
+			sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+			sq_ptr = cq_ptr = MAP_FAILED;
+			ring_fd = -1;
+		}
+
+	public:
+		uring_file_reader()
+		{
+			io_uring_params params{};
+			ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, num_entries, &params));
+			if (ring_fd == -1)
+				{ return; }  // not supported by the kernel (or disabled)
+			sq_ptr_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cq_ptr_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+			if (single_mmap)
+				{ sq_ptr_size = cq_ptr_size = std::max(sq_ptr_size, cq_ptr_size); }
+			sq_ptr = mmap(nullptr, sq_ptr_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+			if (sq_ptr == MAP_FAILED)
+			{
+				close();
+				return;
+			}
+			cq_ptr = single_mmap ? sq_ptr : mmap(nullptr, cq_ptr_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+			sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+			sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+			if (cq_ptr == MAP_FAILED || sqes == MAP_FAILED)
+			{
+				close();
+				return;
+			}
+			sq_tail = ring_offset<unsigned>(sq_ptr, params.sq_off.tail);
+			sq_mask = *ring_offset<unsigned>(sq_ptr, params.sq_off.ring_mask);
+			sq_array = ring_offset<unsigned>(sq_ptr, params.sq_off.array);
+			cq_head = ring_offset<unsigned>(cq_ptr, params.cq_off.head);
+			cq_tail = ring_offset<unsigned>(cq_ptr, params.cq_off.tail);
+			cq_mask = *ring_offset<unsigned>(cq_ptr, params.cq_off.ring_mask);
+			cqes = ring_offset<io_uring_cqe>(cq_ptr, params.cq_off.cqes);
+		}
+		uring_file_reader(const uring_file_reader&) = delete;
+		uring_file_reader& operator=(const uring_file_reader&) = delete;
+		~uring_file_reader() { close(); }
+
+		// @return false if io_uring couldn't be set up (e.g. old kernel or blocked by seccomp), in which case files must be read normally
+		[[nodiscard]] bool valid() const noexcept
+			{ return ring_fd != -1; }
+
+		// read the entire contents of each requested file
+		void read_files(std::span<request_t> requests)
+		{
+			for (auto& request : requests)
+				{ request.ok = false; }
+			if (!valid())
+				{ return; }
+			for (std::size_t begin = 0; begin < requests.size(); begin += max_batch)
+				{ read_batch(requests.subspan(begin, std::min(max_batch, requests.size() - begin))); }
+		}
+	};
+}
+
+#endif
+
+#endif
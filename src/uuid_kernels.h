@@ -0,0 +1,138 @@
+#ifndef UUID_KERNELS_H
+#define UUID_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// vectorized conversion between the canonical 8-4-4-4-12 uuid string and two 64-bit halves
+// the 32 hex digits are stored with the first digit in the lowest nibble of the first half
+// UUID_KERNELS_SIMD is only defined if one of these implementations is available
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define UUID_KERNELS_SIMD
+#define UUID_KERNELS_SSSE3
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define UUID_KERNELS_SIMD
+#define UUID_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef UUID_KERNELS_SIMD
+namespace detail
+{
+	// positions of the 32 hex digits in the 36 character string
+	//  0-7   -> 0-7
+	//  8-11  -> 9-12
+	//  12-15 -> 14-17
+	//  16-19 -> 19-22
+	//  20-31 -> 24-35
+
+	// @param str  36 characters, dashes are not checked
+	// @param out  first and second half of decoded uuid, only written on success
+	// @return false if any of the 32 digits are not hex
+	inline bool uuid_hex_decode(const char* str, std::uint64_t (&out)[2]) noexcept
+	{
+#if defined(UUID_KERNELS_SSSE3)
+		// bytes 0-15, 16-31, and 20-35
+		const __m128i chunk0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
+		const __m128i chunk1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + 16));
+		const __m128i chunk2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + 20));
+		// gather hex digits, lanes with the high bit set in the shuffle mask become 0
+		const __m128i digits_lo = _mm_or_si128(
+			_mm_shuffle_epi8(chunk0, _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 14, 15, -1, -1)),
+			_mm_shuffle_epi8(chunk1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 1)));
+		const __m128i digits_hi = _mm_or_si128(
+			_mm_shuffle_epi8(chunk1, _mm_setr_epi8(3, 4, 5, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+			_mm_shuffle_epi8(chunk2, _mm_setr_epi8(-1, -1, -1, -1, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)));
+
+		bool valid = true;
+		const auto to_nibbles = [&valid](__m128i c)
+		{
+			// unsigned x <= n  <=>  min(x, n) == x
+			const __m128i num = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+			const __m128i is_num = _mm_cmpeq_epi8(_mm_min_epu8(num, _mm_set1_epi8(9)), num);
+			const __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+			const __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+			valid &= (_mm_movemask_epi8(_mm_or_si128(is_num, is_alpha)) == 0xFFFF);
+			return _mm_or_si128(_mm_and_si128(is_num, num), _mm_andnot_si128(is_num, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+		};
+		// (low nibble, high nibble) pairs -> bytes
+		const auto to_bytes = [](__m128i n)
+		{
+			const __m128i combined = _mm_or_si128(n, _mm_srli_epi16(n, 4));
+			return _mm_and_si128(combined, _mm_set1_epi16(0x00FF));
+		};
+		const __m128i bytes = _mm_packus_epi16(to_bytes(to_nibbles(digits_lo)), to_bytes(to_nibbles(digits_hi)));
+		if (!valid)
+			{ return false; }
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), bytes);
+#elif defined(UUID_KERNELS_NEON)
+		const uint8x16x2_t table_lo = { vld1q_u8(reinterpret_cast<const std::uint8_t*>(str)), vld1q_u8(reinterpret_cast<const std::uint8_t*>(str + 16)) };
+		const uint8x16x2_t table_hi = { vld1q_u8(reinterpret_cast<const std::uint8_t*>(str + 16)), vld1q_u8(reinterpret_cast<const std::uint8_t*>(str + 20)) };
+		static constexpr std::uint8_t ind_lo[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 14, 15, 16, 17 };
+		static constexpr std::uint8_t ind_hi[16] = { 3, 4, 5, 6, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31 };
+		const uint8x16_t digits_lo = vqtbl2q_u8(table_lo, vld1q_u8(ind_lo));
+		const uint8x16_t digits_hi = vqtbl2q_u8(table_hi, vld1q_u8(ind_hi));
+
+		bool valid = true;
+		const auto to_nibbles = [&valid](uint8x16_t c)
+		{
+			const uint8x16_t num = vsubq_u8(c, vdupq_n_u8('0'));
+			const uint8x16_t is_num = vcleq_u8(num, vdupq_n_u8(9));
+			const uint8x16_t alpha = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+			const uint8x16_t is_alpha = vcleq_u8(alpha, vdupq_n_u8(5));
+			valid &= (vminvq_u8(vorrq_u8(is_num, is_alpha)) == 0xFF);
+			return vbslq_u8(is_num, num, vaddq_u8(alpha, vdupq_n_u8(10)));
+		};
+		// (low nibble, high nibble) pairs -> bytes
+		const auto to_bytes = [](uint8x16_t n)
+		{
+			const uint16x8_t pairs = vreinterpretq_u16_u8(n);
+			return vmovn_u16(vorrq_u16(pairs, vshrq_n_u16(pairs, 4)));
+		};
+		const uint8x16_t bytes = vcombine_u8(to_bytes(to_nibbles(digits_lo)), to_bytes(to_nibbles(digits_hi)));
+		if (!valid)
+			{ return false; }
+		vst1q_u8(reinterpret_cast<std::uint8_t*>(out), bytes);
+#endif
+		return true;
+	}
+
+	// @param out  36 characters, lowercase hex with dashes
+	inline void uuid_hex_encode(const std::uint64_t (&in)[2], char* out) noexcept
+	{
+		alignas(16) char digits[32];
+#if defined(UUID_KERNELS_SSSE3)
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		const __m128i lo = _mm_and_si128(bytes, _mm_set1_epi8(0x0F));
+		const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0F));
+		const __m128i hex_digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+		// low nibble comes first
+		_mm_store_si128(reinterpret_cast<__m128i*>(digits), _mm_shuffle_epi8(hex_digits, _mm_unpacklo_epi8(lo, hi)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(digits + 16), _mm_shuffle_epi8(hex_digits, _mm_unpackhi_epi8(lo, hi)));
+#elif defined(UUID_KERNELS_NEON)
+		const uint8x16_t bytes = vld1q_u8(reinterpret_cast<const std::uint8_t*>(in));
+		const uint8x16_t lo = vandq_u8(bytes, vdupq_n_u8(0x0F));
+		const uint8x16_t hi = vshrq_n_u8(bytes, 4);
+		static constexpr std::uint8_t hex_digits_arr[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+		const uint8x16_t hex_digits = vld1q_u8(hex_digits_arr);
+		// low nibble comes first
+		vst1q_u8(reinterpret_cast<std::uint8_t*>(digits), vqtbl1q_u8(hex_digits, vzip1q_u8(lo, hi)));
+		vst1q_u8(reinterpret_cast<std::uint8_t*>(digits + 16), vqtbl1q_u8(hex_digits, vzip2q_u8(lo, hi)));
+#endif
+		std::memcpy(out, digits, 8);
+		out[8] = '-';
+		std::memcpy(out + 9, digits + 8, 4);
+		out[13] = '-';
+		std::memcpy(out + 14, digits + 12, 4);
+		out[18] = '-';
+		std::memcpy(out + 19, digits + 16, 4);
+		out[23] = '-';
+		std::memcpy(out + 24, digits + 20, 12);
+	}
+}
+#endif
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// the parts of the websocket protocol (rfc 6455) the http server needs to push messages to browsers (see live_feed)
+namespace detail
+{
+	enum class websocket_opcode : std::uint8_t
+	{
+		continuation = 0x0,
+		text = 0x1,
+		binary = 0x2,
+		close = 0x8,
+		ping = 0x9,
+		pong = 0xa
+	};
+
+	// only used for the handshake, which needs sha-1 whatever its weaknesses
+	[[nodiscard]] constexpr std::array<std::uint8_t, 20> sha1(std::string_view data) noexcept
+	{
+		std::uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+		const auto rotl = [](std::uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+		const std::uint64_t bit_length = static_cast<std::uint64_t>(data.size()) * 8;
+		// the data, then a 1 bit, zeros and the length, in 64 byte blocks
+		const std::size_t padded_size = (data.size() + 8) / 64 * 64 + 64;
+		for (std::size_t block = 0; block < padded_size; block += 64)
+		{
+			std::uint32_t w[80]{};
+			for (std::size_t i = 0; i < 64; i++)
+			{
+				const std::size_t pos = block + i;
+				std::uint8_t byte = 0;
+				if (pos < data.size())
+					{ byte = static_cast<std::uint8_t>(data[pos]); }
+				else if (pos == data.size())
+					{ byte = 0x80; }
+				else if (pos >= padded_size - 8)
+					{ byte = static_cast<std::uint8_t>(bit_length >> ((padded_size - 1 - pos) * 8)); }
+				w[i / 4] |= static_cast<std::uint32_t>(byte) << ((3 - i % 4) * 8);
+			}
+			for (int i = 16; i < 80; i++)
+				{ w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1); }
+			std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+			for (int i = 0; i < 80; i++)
+			{
+				const std::uint32_t f = (i < 20) ? ((b & c) | (~b & d)) : (i < 40) ? (b ^ c ^ d) : (i < 60) ? ((b & c) | (b & d) | (c & d)) : (b ^ c ^ d);
+				const std::uint32_t k = (i < 20) ? 0x5a827999 : (i < 40) ? 0x6ed9eba1 : (i < 60) ? 0x8f1bbcdc : 0xca62c1d6;
+				const std::uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+				e = d;
+				d = c;
+				c = rotl(b, 30);
+				b = a;
+				a = temp;
+			}
+			h[0] += a;
+			h[1] += b;
+			h[2] += c;
+			h[3] += d;
+			h[4] += e;
+		}
+		std::array<std::uint8_t, 20> res{};
+		for (std::size_t i = 0; i < res.size(); i++)
+			{ res[i] = static_cast<std::uint8_t>(h[i / 4] >> ((3 - i % 4) * 8)); }
+		return res;
+	}
+	static_assert(sha1("abc")[0] == 0xa9 && sha1("abc")[1] == 0x99 && sha1("abc")[19] == 0x9d);
+	static_assert(sha1("")[0] == 0xda && sha1("")[19] == 0x09);
+
+	[[nodiscard]] constexpr std::string base64_encode(std::string_view data)
+	{
+		constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string res;
+		for (std::size_t i = 0; i < data.size(); i += 3)
+		{
+			std::uint32_t bits = static_cast<std::uint32_t>(static_cast<std::uint8_t>(data[i])) << 16;
+			if (i + 1 < data.size())
+				{ bits |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(data[i + 1])) << 8; }
+			if (i + 2 < data.size())
+				{ bits |= static_cast<std::uint8_t>(data[i + 2]); }
+			res += alphabet[(bits >> 18) & 63];
+			res += alphabet[(bits >> 12) & 63];
+			res += (i + 1 < data.size()) ? alphabet[(bits >> 6) & 63] : '=';
+			res += (i + 2 < data.size()) ? alphabet[bits & 63] : '=';
+		}
+		return res;
+	}
+	static_assert(base64_encode("") == "" && base64_encode("f") == "Zg==" && base64_encode("fo") == "Zm8=" && base64_encode("foobar") == "Zm9vYmFy");
+
+	// @param key  Sec-WebSocket-Key the client sent
+	// @return Sec-WebSocket-Accept to answer it with
+	[[nodiscard]] constexpr std::string websocket_accept_key(std::string_view key)
+	{
+		const std::string hashed = std::string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+		const auto digest = sha1(hashed);
+		std::string digest_str;
+		for (const std::uint8_t byte : digest)
+			{ digest_str += static_cast<char>(byte); }
+		return base64_encode(digest_str);
+	}
+	static_assert(websocket_accept_key("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");  // from the rfc
+
+	// @return unmasked frame with all of `payload`, as sent by servers
+	[[nodiscard]] inline std::string websocket_frame(websocket_opcode opcode, std::string_view payload)
+	{
+		std::string res;
+		res += static_cast<char>(0x80 | static_cast<std::uint8_t>(opcode));
+		if (payload.size() < 126)
+			{ res += static_cast<char>(payload.size()); }
+		else
+		{
+			const int length_bytes = (payload.size() <= 0xffff) ? 2 : 8;
+			res += static_cast<char>((length_bytes == 2) ? 126 : 127);
+			for (int i = length_bytes - 1; i >= 0; i--)
+				{ res += static_cast<char>(static_cast<std::uint64_t>(payload.size()) >> (i * 8)); }
+		}
+		res += payload;
+		return res;
+	}
+
+	struct websocket_frame_header
+	{
+		websocket_opcode opcode;
+		bool fin;
+		std::uint64_t payload_size;
+		std::size_t header_size;  // including the mask
+		std::array<std::uint8_t, 4> mask;  // zeros if the frame isn't masked
+		bool masked;
+	};
+
+	// @return header at the start of `data`, or empty optional if it isn't complete yet
+	[[nodiscard]] constexpr std::optional<websocket_frame_header> parse_websocket_frame_header(std::string_view data) noexcept
+	{
+		if (data.size() < 2)
+			{ return std::nullopt; }
+		websocket_frame_header res{};
+		res.fin = (static_cast<std::uint8_t>(data[0]) & 0x80) != 0;
+		res.opcode = static_cast<websocket_opcode>(static_cast<std::uint8_t>(data[0]) & 0x0f);
+		res.masked = (static_cast<std::uint8_t>(data[1]) & 0x80) != 0;
+		res.payload_size = static_cast<std::uint8_t>(data[1]) & 0x7f;
+		res.header_size = 2;
+		if (res.payload_size >= 126)
+		{
+			const std::size_t length_bytes = (res.payload_size == 126) ? 2 : 8;
+			if (data.size() < 2 + length_bytes)
+				{ return std::nullopt; }
+			res.payload_size = 0;
+			for (std::size_t i = 0; i < length_bytes; i++)
+				{ res.payload_size = (res.payload_size << 8) | static_cast<std::uint8_t>(data[2 + i]); }
+			res.header_size += length_bytes;
+		}
+		if (res.masked)
+		{
+			if (data.size() < res.header_size + 4)
+				{ return std::nullopt; }
+			for (std::size_t i = 0; i < 4; i++)
+				{ res.mask[i] = static_cast<std::uint8_t>(data[res.header_size + i]); }
+			res.header_size += 4;
+		}
+		return res;
+	}
+	static_assert(parse_websocket_frame_header("\x89\x80\x01\x02\x03\x04")->opcode == websocket_opcode::ping);
+	static_assert(parse_websocket_frame_header("\x89\x80\x01\x02\x03\x04")->header_size == 6);
+	static_assert(parse_websocket_frame_header(std::string_view("\x81\x7e\x01\x00", 4))->payload_size == 256);
+	static_assert(!parse_websocket_frame_header(std::string_view("\x81\xfe\x01\x00\x01", 5)).has_value());  // no mask yet
+}
+
+#endif